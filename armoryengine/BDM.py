@@ -28,6 +28,7 @@ BDMPhase_Balance = 6
 BDMPhase_SearchHashes = 7
 BDMPhase_ResolveHashes = 8
 BDMPhase_Completed = 9
+BDMPhase_Verification = 10
 
 
 BDM_OFFLINE = 'Offline'
@@ -289,6 +290,11 @@ class BlockDataManager(object):
       progressNumeric = notifProto.progress.progress_numeric
       walletVec = notifProto.progress.id
 
+      #background integrity checks run while the db is ready, they are
+      #not a scan
+      if phase == BDMPhase_Verification:
+         return
+
       try:
          if len(walletVec) == 0:
             self.progressPhase = phase
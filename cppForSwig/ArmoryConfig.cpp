@@ -73,7 +73,12 @@ void Armory::Config::printHelp(void)
 --rescanSSH                delete balance and txcount data and rescan it.
                            Much faster than rescan or rebuild.
 --checkchain               builds db (no scanning) with full txhints, then
-                           verifies all tx (consensus and sigs).
+                           verifies all tx (consensus and sigs) on the
+                           integrity check thread and exits.
+--check-txhints            checks all tx hashes resolve through the txhints db.
+                           Runs in the background once the db is ready
+--verify-rate              caps the block data throughput of --checkchain and
+                           --check-txhints, in MB/s. Unlimited by default
 --datadir                  path to the operation folder
 --dbdir                    path to folder containing the database files.
                            If empty, a new db will be created there
@@ -83,6 +88,13 @@ void Armory::Config::printHelp(void)
                            base amount, ~400MB). Defaults at 50.
                            Can't be lower than 1.
                            Can be changed in between processes
+--stream-blocks            scans read blocks into a pool of fixed size buffers
+                           instead of mapping whole blk files. Bounds address
+                           space and page cache use, for 32-bit builds and
+                           low memory systems. Always on for 32-bit builds
+--no-block-filters         scans parse every block instead of skipping the ones
+                           whose script filter misses the scanned addresses.
+                           Filters are still built and kept up to date
 --thread-count             defines how many processing threads can be used during
                            db builds and scans. Defaults to maximum available CPU
                            threads. Can't be lower than 1. Can be changed in
@@ -116,7 +128,15 @@ void Armory::Config::printHelp(void)
                            always auth'ed), both sides need to enable public
                            channels for the handshake to succeed)   
 --offline                  Do not seek to connect with the ArmoryDB blockchain
-                           service)";
+                           service
+--client-write-limit       MB of outbound data a client connection can have
+                           pending. Past that, progress and node status
+                           notifications to that client are coalesced or
+                           dropped. Connections with 4 times that pending are
+                           closed. Defaults to 64
+--listen-threads           number of threads serving client sockets. Defaults
+                           to a quarter of the available CPU threads, capped
+                           at 8)";
 
    cerr << helpMsg << endl;
 }
@@ -509,12 +529,18 @@ SOCKET_SERVICE DBSettings::service_ = SERVICE_WEBSOCKET;
 unsigned DBSettings::ramUsage_ = 4;
 unsigned DBSettings::threadCount_ = thread::hardware_concurrency();
 unsigned DBSettings::zcThreadCount_ = DEFAULT_ZCTHREAD_COUNT;
+unsigned DBSettings::verifyRate_ = 0;
 
 bool DBSettings::reportProgress_ = true;
 bool DBSettings::checkChain_ = false;
 bool DBSettings::clearMempool_ = false;
 bool DBSettings::checkTxHints_ = false;
 
+//32-bit builds can't map much of the blk files at once
+bool DBSettings::streamBlocks_ = sizeof(void*) < 8;
+
+bool DBSettings::blockFilters_ = true;
+
 ////////////////////////////////////////////////////////////////////////////////
 void DBSettings::processArgs(const map<string, string>& args)
 {
@@ -543,6 +569,14 @@ void DBSettings::processArgs(const map<string, string>& args)
    if (iter != args.end())
       checkTxHints_ = true;
 
+   iter = args.find("stream-blocks");
+   if (iter != args.end())
+      streamBlocks_ = true;
+
+   iter = args.find("no-block-filters");
+   if (iter != args.end())
+      blockFilters_ = false;
+
    //db type
    iter = args.find("db-type");
    if (iter != args.end())
@@ -616,6 +650,22 @@ void DBSettings::processArgs(const map<string, string>& args)
       if (val > 0)
          zcThreadCount_ = val;
    }
+
+   iter = args.find("verify-rate");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         verifyRate_ = val;
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -659,10 +709,13 @@ void DBSettings::reset()
    ramUsage_ = 4;
    threadCount_ = thread::hardware_concurrency();
    zcThreadCount_ = DEFAULT_ZCTHREAD_COUNT;
+   verifyRate_ = 0;
 
    reportProgress_ = true;  
    checkChain_ = false;
    clearMempool_ = false;
+   streamBlocks_ = sizeof(void*) < 8;
+   blockFilters_ = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -684,6 +737,8 @@ bool NetworkSettings::useCookie_ = false;
 bool NetworkSettings::ephemeralPeers_;
 bool NetworkSettings::oneWayAuth_ = false;
 bool NetworkSettings::offline_ = false;
+unsigned NetworkSettings::clientWriteLimit_ = 64;
+unsigned NetworkSettings::listenThreads_ = 0;
 
 string NetworkSettings::cookie_;
 BinaryData NetworkSettings::uiPublicKey_;
@@ -766,6 +821,39 @@ void NetworkSettings::processArgs(const map<string, string>& args,
    if (iter != args.end())
       offline_ = true;
 
+   //outbound backpressure
+   iter = args.find("client-write-limit");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         clientWriteLimit_ = val;
+   }
+
+   iter = args.find("listen-threads");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         listenThreads_ = val;
+   }
+
    //ui pubkey
    iter = args.find("uiPubKey");
    if (iter != args.end())
@@ -958,6 +1046,16 @@ void NetworkSettings::injectUiPubkey(BinaryData& pubkey)
    uiPublicKey_ = move(pubkey);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+unsigned NetworkSettings::listenThreads()
+{
+   if (listenThreads_ > 0)
+      return listenThreads_;
+
+   auto count = thread::hardware_concurrency() / 4;
+   return max(1U, min(8U, count));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void NetworkSettings::reset()
 {
@@ -978,6 +1076,8 @@ void NetworkSettings::reset()
    ephemeralPeers_ = false;
    oneWayAuth_ = false;
    offline_ = false;
+   clientWriteLimit_ = 64;
+   listenThreads_ = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -122,11 +122,14 @@ namespace Armory
          static unsigned ramUsage_;
          static unsigned threadCount_;
          static unsigned zcThreadCount_;
+         static unsigned verifyRate_;
 
          static bool reportProgress_;
          static bool checkChain_;
          static bool clearMempool_;
          static bool checkTxHints_;
+         static bool streamBlocks_;
+         static bool blockFilters_;
 
       private:
          static void processArgs(const std::map<std::string, std::string>&);
@@ -155,11 +158,20 @@ namespace Armory
          static unsigned ramUsage(void) { return ramUsage_; }
          static unsigned zcThreadCount(void) { return zcThreadCount_; }
 
+         //integrity check throughput cap in MB/s, 0 for none
+         static unsigned verifyRate(void) { return verifyRate_; }
+
          static bool checkChain(void) { return checkChain_; }
          static BDM_INIT_MODE initMode(void) { return initMode_; }
          static bool clearMempool(void) { return clearMempool_; }
          static bool reportProgress(void) { return reportProgress_; }
          static bool checkTxHints(void) { return checkTxHints_; }
+
+         //scans read blocks into pooled buffers instead of mapping blk files
+         static bool streamBlocks(void) { return streamBlocks_; }
+
+         //scans skip blocks whose script filter misses the tracked addresses
+         static bool blockFilters(void) { return blockFilters_; }
       };
 
       //////////////////////////////////////////////////////////////////////////
@@ -192,6 +204,10 @@ namespace Armory
          static bool offline_;
          static std::string cookie_;
 
+         //MB of outbound data a client can have pending
+         static unsigned clientWriteLimit_;
+         static unsigned listenThreads_;
+
          static BinaryData uiPublicKey_;
 
       private:
@@ -220,6 +236,8 @@ namespace Armory
          static bool ephemeralPeers(void) { return ephemeralPeers_; }
          static bool oneWayAuth(void) { return oneWayAuth_; }
          static bool isOffline(void) { return offline_; }
+         static unsigned clientWriteLimit(void) { return clientWriteLimit_; }
+         static unsigned listenThreads(void);
 
          static BinaryData uiPublicKey(void) { return uiPublicKey_; }
          static void injectUiPubkey(BinaryData&);
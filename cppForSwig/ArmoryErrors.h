@@ -39,6 +39,10 @@ enum class ArmoryErrorCodes : int
     //getTxBatchByHash
     GetTxBatchError_Invalid = 50001, //response isn't flagged as valid
     GetTxBatchError_CallMap = 50002, //mismatch between result and call map
+
+    //client cache
+    ClientCache_Dropped = 60001, //request dropped before its reply arrived
+    ClientCache_Evicted = 60002, //cached tx evicted while fetching its height
 };
 
 #endif
\ No newline at end of file
@@ -88,6 +88,23 @@ shared_ptr<BlockDataViewer> BlockDataViewer::getNewBDV(const string& addr,
    shared_ptr<BlockDataViewer> bdvSharedPtr;
    bdvSharedPtr.reset(bdvPtr);
 
+   //flush orphaned chain data from the cache on reorgs
+   if (callbackPtr != nullptr)
+   {
+      weak_ptr<ClientCache> cacheWeak = bdvPtr->cache_;
+      auto newBlockLbd = [cacheWeak](unsigned, unsigned branchHeight)->void
+      {
+         if (branchHeight == UINT32_MAX)
+            return;
+
+         auto cachePtr = cacheWeak.lock();
+         if (cachePtr != nullptr)
+            cachePtr->reorg(branchHeight);
+      };
+
+      callbackPtr->setNewBlockLambda(newBlockLbd);
+   }
+
    return bdvSharedPtr;
 }
 
@@ -354,6 +371,11 @@ void BlockDataViewer::getTxByHash(
    catch(NoMatch&)
    {}
 
+   //piggy back on the request in flight for this hash, if any
+   BinaryData hashKey(bdRef);
+   if (!cache_->addPendingTx(hashKey, callback))
+      return;
+
    auto payload = make_payload(Methods::getTxByHash);
    auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
    command->set_hash(bdRef.getPtr(), bdRef.getSize());
@@ -361,7 +383,7 @@ void BlockDataViewer::getTxByHash(
 
    auto read_payload = make_shared<Socket_ReadPayload>();
    read_payload->callbackReturn_ =
-      make_unique<CallbackReturn_Tx>(cache_, txHash, callback);
+      make_unique<CallbackReturn_Tx>(cache_, hashKey);
    sock_->pushPayload(move(payload), read_payload);
 }
 
@@ -448,8 +470,8 @@ void BlockDataViewer::getRawHeaderForTxHash(const BinaryData& txHash,
 
    try
    {
-      auto& height = cache_->getHeightForTxHash(txHash);
-      auto& rawHeader = cache_->getRawHeader(height);
+      auto height = cache_->getHeightForTxHash(txHash);
+      auto rawHeader = cache_->getRawHeader(height);
       callback(rawHeader);
       return;
    }
@@ -473,13 +495,16 @@ void BlockDataViewer::getHeaderByHeight(unsigned height,
 {
    try
    {
-      auto& rawHeader = cache_->getRawHeader(height);
+      auto rawHeader = cache_->getRawHeader(height);
       callback(rawHeader);
       return;
    }
    catch(NoMatch&)
    { }
 
+   if (!cache_->addPendingHeader(height, callback))
+      return;
+
    auto payload = make_payload(Methods::getHeaderByHeight);
    auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
    command->set_height(height);
@@ -488,7 +513,7 @@ void BlockDataViewer::getHeaderByHeight(unsigned height,
    auto read_payload = make_shared<Socket_ReadPayload>();
    read_payload->callbackReturn_ =
       make_unique<CallbackReturn_RawHeader>(
-         cache_, height, txhash, callback);
+         cache_, height, txhash, nullptr);
    sock_->pushPayload(move(payload), read_payload);
 }
 
@@ -703,6 +728,23 @@ void LedgerDelegate::getHistoryPage(uint32_t id,
    sock_->pushPayload(move(payload), read_payload);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void LedgerDelegate::getHistoryFromCursor(const BinaryData& token,
+   unsigned pageSize, function<void(ReturnMessage<LedgerPage>)> callback)
+{
+   auto payload = BlockDataViewer::make_payload(Methods::getHistoryFromCursor);
+   auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
+   command->set_delegateid(delegateID_);
+   command->set_pagesize(pageSize);
+   if (!token.empty())
+      command->set_token(token.getPtr(), token.getSize());
+
+   auto read_payload = make_shared<Socket_ReadPayload>();
+   read_payload->callbackReturn_ =
+      make_unique<CallbackReturn_LedgerPage>(callback);
+   sock_->pushPayload(move(payload), read_payload);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void LedgerDelegate::getPageCount(
    function<void(ReturnMessage<uint64_t>)> callback) const
@@ -729,12 +771,14 @@ AsyncClient::BtcWallet::BtcWallet(const BlockDataViewer& bdv, const string& id)
 
 ///////////////////////////////////////////////////////////////////////////////
 string AsyncClient::BtcWallet::registerAddresses(
-   const vector<BinaryData>& addrVec, bool isNew)
+   const vector<BinaryData>& addrVec, bool isNew, unsigned birthHeight)
 {
    auto payload = BlockDataViewer::make_payload(Methods::registerWallet);
    auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
    command->set_flag(isNew);
    command->set_walletid(walletID_);
+   if (birthHeight != 0)
+      command->set_height(birthHeight);
 
    auto&& registrationId = 
       BtcUtils::fortuna_.generateRandom(REGISTER_ID_LENGH).toHexStr();
@@ -890,6 +934,23 @@ void AsyncClient::BtcWallet::getHistoryPage(uint32_t id,
    sock_->pushPayload(move(payload), read_payload);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void AsyncClient::BtcWallet::getHistoryFromCursor(const BinaryData& token,
+   unsigned pageSize, function<void(ReturnMessage<LedgerPage>)> callback)
+{
+   auto payload = BlockDataViewer::make_payload(Methods::getHistoryFromCursor);
+   auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
+   command->set_walletid(walletID_);
+   command->set_pagesize(pageSize);
+   if (!token.empty())
+      command->set_token(token.getPtr(), token.getSize());
+
+   auto read_payload = make_shared<Socket_ReadPayload>();
+   read_payload->callbackReturn_ =
+      make_unique<CallbackReturn_LedgerPage>(callback);
+   sock_->pushPayload(move(payload), read_payload);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void AsyncClient::BtcWallet::getLedgerEntryForTxHash(
    const BinaryData& txhash, 
@@ -956,12 +1017,14 @@ void Lockbox::getBalancesAndCountFromDB(uint32_t topBlockHeight)
 
 ///////////////////////////////////////////////////////////////////////////////
 string AsyncClient::Lockbox::registerAddresses(
-   const vector<BinaryData>& addrVec, bool isNew)
+   const vector<BinaryData>& addrVec, bool isNew, unsigned birthHeight)
 {
    auto payload = BlockDataViewer::make_payload(Methods::registerLockbox);
    auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
    command->set_flag(isNew);
    command->set_walletid(walletID_);
+   if (birthHeight != 0)
+      command->set_height(birthHeight);
    
    auto&& registrationId = 
       BtcUtils::fortuna_.generateRandom(REGISTER_ID_LENGH).toHexStr();
@@ -1019,7 +1082,7 @@ void ScrAddrObj::getSpendableTxOutList(
 //
 ///////////////////////////////////////////////////////////////////////////////
 AsyncClient::Blockchain::Blockchain(const BlockDataViewer& bdv) :
-   sock_(bdv.sock_), bdvID_(bdv.bdvID_)
+   sock_(bdv.sock_), bdvID_(bdv.bdvID_), cache_(bdv.cache_)
 {}
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1032,7 +1095,7 @@ void AsyncClient::Blockchain::getHeaderByHash(const BinaryData& hash,
 
    auto read_payload = make_shared<Socket_ReadPayload>();
    read_payload->callbackReturn_ =
-      make_unique<CallbackReturn_BlockHeader>(UINT32_MAX, callback);
+      make_unique<CallbackReturn_BlockHeader>(cache_, UINT32_MAX, callback);
    sock_->pushPayload(move(payload), read_payload);
 }
 
@@ -1040,13 +1103,27 @@ void AsyncClient::Blockchain::getHeaderByHash(const BinaryData& hash,
 void AsyncClient::Blockchain::getHeaderByHeight(unsigned height,
    function<void(ReturnMessage<DBClientClasses::BlockHeader>)> callback)
 {
+   try
+   {
+      auto rawHeader = cache_->getRawHeader(height);
+      DBClientClasses::BlockHeader bh(rawHeader, height);
+      ReturnMessage<DBClientClasses::BlockHeader> rm(bh);
+
+      thread thr(callback, move(rm));
+      if (thr.joinable())
+         thr.detach();
+      return;
+   }
+   catch (NoMatch&)
+   {}
+
    auto payload = BlockDataViewer::make_payload(Methods::getHeaderByHeight);
    auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
    command->set_height(height);
    
    auto read_payload = make_shared<Socket_ReadPayload>();
    read_payload->callbackReturn_ =
-      make_unique<CallbackReturn_BlockHeader>(height, callback);
+      make_unique<CallbackReturn_BlockHeader>(cache_, height, callback);
    sock_->pushPayload(move(payload), read_payload);
 }
 
@@ -1151,26 +1228,94 @@ void AsyncClient::BlockDataViewer::getCombinedRBFTxOuts(
    sock_->pushPayload(move(payload), read_payload);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   void requestOutpoints(shared_ptr<SocketPrototype> sock,
+      const set<BinaryData>& addrSet, 
+      unsigned startHeight, unsigned zcIndexCutoff,
+      const BinaryData* token, unsigned pageSize,
+      function<void(ReturnMessage<OutpointBatch>)> callback)
+   {
+      auto payload = BlockDataViewer::make_payload(
+         Methods::getOutpointsForAddresses);
+      auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
+
+      for (auto& id : addrSet)
+         command->add_bindata(id.getCharPtr(), id.getSize());
+
+      command->set_height(startHeight);
+      command->set_zcid(zcIndexCutoff);
+
+      if (token != nullptr)
+      {
+         command->set_pagesize(pageSize);
+         if (!token->empty())
+            command->set_token(token->getCharPtr(), token->getSize());
+      }
+
+      auto read_payload = make_shared<Socket_ReadPayload>();
+      read_payload->callbackReturn_ =
+         make_unique<CallbackReturn_AddrOutpoints>(callback);
+      sock->pushPayload(move(payload), read_payload);
+   }
+
+   void requestOutpointPage(shared_ptr<SocketPrototype> sock,
+      shared_ptr<const set<BinaryData>> addrSet,
+      unsigned startHeight, unsigned zcIndexCutoff,
+      const BinaryData& token, unsigned pageSize,
+      function<void(ReturnMessage<OutpointBatch>)> callback)
+   {
+      auto pageLbd = [sock, addrSet, startHeight, zcIndexCutoff, 
+         pageSize, callback](ReturnMessage<OutpointBatch> msg)->void
+      {
+         OutpointBatch batch;
+         try
+         {
+            batch = msg.get();
+         }
+         catch (ClientMessageError& e)
+         {
+            ReturnMessage<OutpointBatch> rm(e);
+            callback(move(rm));
+            return;
+         }
+
+         //fetch the next page while this one is processed
+         if (!batch.token_.empty())
+         {
+            requestOutpointPage(sock, addrSet, startHeight, zcIndexCutoff, 
+               batch.token_, pageSize, callback);
+         }
+
+         ReturnMessage<OutpointBatch> rm(move(batch));
+         callback(move(rm));
+      };
+
+      requestOutpoints(sock, *addrSet, startHeight, zcIndexCutoff, 
+         &token, pageSize, pageLbd);
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void AsyncClient::BlockDataViewer::getOutpointsForAddresses(
    const std::set<BinaryData>& addrVec, 
    unsigned startHeight, unsigned zcIndexCutoff, 
    std::function<void(ReturnMessage<OutpointBatch>)> callback)
 {
-   auto payload = BlockDataViewer::make_payload(
-      Methods::getOutpointsForAddresses);
-   auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
-
-   for (auto& id : addrVec)
-      command->add_bindata(id.getCharPtr(), id.getSize());
-
-   command->set_height(startHeight);
-   command->set_zcid(zcIndexCutoff);
+   requestOutpoints(sock_, addrVec, startHeight, zcIndexCutoff, 
+      nullptr, 0, callback);
+}
 
-   auto read_payload = make_shared<Socket_ReadPayload>();
-   read_payload->callbackReturn_ =
-      make_unique<CallbackReturn_AddrOutpoints>(callback);
-   sock_->pushPayload(move(payload), read_payload);
+///////////////////////////////////////////////////////////////////////////////
+void AsyncClient::BlockDataViewer::getOutpointsForAddresses(
+   const std::set<BinaryData>& addrVec, 
+   unsigned startHeight, unsigned zcIndexCutoff, unsigned pageSize,
+   std::function<void(ReturnMessage<OutpointBatch>)> callback)
+{
+   auto addrSet = make_shared<const set<BinaryData>>(addrVec);
+   requestOutpointPage(sock_, addrSet, startHeight, zcIndexCutoff,
+      BinaryData(), pageSize, callback);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1191,6 +1336,26 @@ void AsyncClient::BlockDataViewer::getUTXOsForAddress(
    sock_->pushPayload(move(payload), read_payload);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void AsyncClient::BlockDataViewer::getUTXOsForAddresses(
+   const std::set<BinaryData>& addrSet, bool withZc,
+   std::function<void(
+      ReturnMessage<std::map<BinaryData, std::vector<UTXO>>>)> callback)
+{
+   auto payload = BlockDataViewer::make_payload(
+      Methods::getUTXOsForAddresses);
+   auto command = dynamic_cast<BDVCommand*>(payload->message_.get());
+
+   for (auto& addr : addrSet)
+      command->add_bindata(addr.getCharPtr(), addr.getSize());
+   command->set_flag(withZc);
+
+   auto read_payload = make_shared<Socket_ReadPayload>();
+   read_payload->callbackReturn_ =
+      make_unique<CallbackReturn_AddrUTXOs>(callback);
+   sock_->pushPayload(move(payload), read_payload);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // CallbackReturn children
@@ -1306,10 +1471,39 @@ void CallbackReturn_LedgerDelegate::callback(
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   template<typename T, typename CB>
+   void replyToAll(const vector<CB>& callbacks,
+      const ReturnMessage<T>& rm, bool inCaller)
+   {
+      for (auto& callback : callbacks)
+      {
+         if (inCaller)
+         {
+            callback(rm);
+            continue;
+         }
+
+         thread thr(callback, rm);
+         if (thr.joinable())
+            thr.detach();
+      }
+   }
+
+   ClientMessageError droppedRequestError()
+   {
+      return ClientMessageError("request dropped",
+         (int)ArmoryErrorCodes::ClientCache_Dropped);
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void CallbackReturn_Tx::callback(
    const WebSocketMessagePartial& partialMsg)
 {
+   replied_ = true;
    try
    {
       ::Codec_CommonTypes::TxWithMetaData msg;
@@ -1329,37 +1523,47 @@ void CallbackReturn_Tx::callback(
          tx->setRBF(msg.isrbf());
          tx->setTxHeight(msg.height());
          tx->setTxIndex(msg.txindex());
-         cache_->insertTx(txHash_, tx);
+         cache_->insertTx(txHash_, tx, epoch_);
       }
       else
       {
-         auto cachedTx = cache_->getTx_NoConst(txHash_.getRef());
-         cachedTx->setTxHeight(msg.height());
-         cachedTx->setTxIndex(msg.txindex());
-         tx = cachedTx;
+         try
+         {
+            auto cachedTx = cache_->getTx_NoConst(txHash_.getRef());
+            cachedTx->setTxHeight(msg.height());
+            cachedTx->setTxIndex(msg.txindex());
+            tx = cachedTx;
+         }
+         catch (NoMatch&)
+         {
+            throw ClientMessageError("tx evicted from cache",
+               (int)ArmoryErrorCodes::ClientCache_Evicted);
+         }
       }
       
       auto constTx = const_pointer_cast<const Tx>(tx);
       ReturnMessage<TxResult> rm(move(constTx));
-
-      if (runInCaller())
-      {
-         userCallbackLambda_(move(rm));
-      }
-      else
-      {
-         thread thr(userCallbackLambda_, move(rm));
-         if (thr.joinable())
-            thr.detach();
-      }
+      replyToAll(cache_->popPendingTx(txHash_), rm, runInCaller());
    }
    catch (ClientMessageError& e)
    {
       ReturnMessage<TxResult> rm(e);
-      userCallbackLambda_(move(rm));
+      replyToAll(cache_->popPendingTx(txHash_), rm, true);
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+CallbackReturn_Tx::~CallbackReturn_Tx()
+{
+   //never got a reply, release the calls waiting on this request
+   if (replied_)
+      return;
+
+   auto err = droppedRequestError();
+   ReturnMessage<TxResult> rm(err);
+   replyToAll(cache_->popPendingTx(txHash_), rm, false);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void CallbackReturn_TxBatch::callback(
    const WebSocketMessagePartial& partialMsg)
@@ -1409,11 +1613,21 @@ void CallbackReturn_TxBatch::callback(
                for (int y = 0; y<txObj.opid_size(); y++)
                   tx->pushBackOpId(txObj.opid(y));
                
-               cache_->insertTx(txHash, tx);
+               cache_->insertTx(txHash, tx, epoch_);
             }
             else
             {
-               auto txFromCache = cache_->getTx_NoConst(txHash);
+               //evicted since the request went out, report as missing
+               shared_ptr<Tx> txFromCache;
+               try
+               {
+                  txFromCache = cache_->getTx_NoConst(txHash);
+               }
+               catch (NoMatch&)
+               {
+                  continue;
+               }
+
                txFromCache->setTxHeight(txObj.height());
                txFromCache->setTxIndex(txObj.txindex());
 
@@ -1455,6 +1669,19 @@ void CallbackReturn_TxBatch::callback(
 void CallbackReturn_RawHeader::callback(
    const WebSocketMessagePartial& partialMsg)
 {
+   replied_ = true;
+   auto reply = [this](const ReturnMessage<BinaryData>& rm, bool inCaller)
+   {
+      if (txHash_.getSize() == 0)
+      {
+         replyToAll(cache_->popPendingHeaders(height_), rm, inCaller);
+         return;
+      }
+
+      vector<RawHeaderCallback> callbacks{ userCallbackLambda_ };
+      replyToAll(callbacks, rm, inCaller);
+   };
+
    try
    {
       ::Codec_CommonTypes::BinaryData msg;
@@ -1469,32 +1696,42 @@ void CallbackReturn_RawHeader::callback(
          height_ = brr.get_uint32_t();
 
       if (txHash_.getSize() != 0)
-         cache_->insertHeightForTxHash(txHash_, height_);
-      cache_->insertRawHeader(height_, header);
+         cache_->insertHeightForTxHash(txHash_, height_, epoch_);
+      cache_->insertRawHeader(height_, header, epoch_);
 
       ReturnMessage<BinaryData> rm(header);
-
-      if (runInCaller())
-      {
-         userCallbackLambda_(move(rm));
-      }
-      else
-      {
-         thread thr(userCallbackLambda_, move(rm));
-         if (thr.joinable())
-            thr.detach();
-      }
+      reply(rm, runInCaller());
    }
    catch (ClientMessageError& e)
    {
       ReturnMessage<BinaryData> rm(e);
-      userCallbackLambda_(move(rm));
+      reply(rm, true);
    }
    catch (const runtime_error& e)
    {
       ClientMessageError cme(string(e.what()), -1);
       ReturnMessage<BinaryData> rm(cme);
-      userCallbackLambda_(move(rm));
+      reply(rm, true);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+CallbackReturn_RawHeader::~CallbackReturn_RawHeader()
+{
+   if (replied_)
+      return;
+
+   auto err = droppedRequestError();
+   ReturnMessage<BinaryData> rm(err);
+   if (txHash_.getSize() == 0)
+   {
+      replyToAll(cache_->popPendingHeaders(height_), rm, false);
+   }
+   else
+   {
+      thread thr(userCallbackLambda_, rm);
+      if (thr.joinable())
+         thr.detach();
    }
 }
 
@@ -1640,6 +1877,45 @@ void CallbackReturn_VectorLedgerEntry::callback(
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void CallbackReturn_LedgerPage::callback(
+   const WebSocketMessagePartial& partialMsg)
+{
+   try
+   {
+      auto msg = make_shared<::Codec_LedgerEntry::ManyLedgerEntry>();
+      AsyncClient::deserialize(msg.get(), partialMsg);
+
+      LedgerPage page;
+      for (int i = 0; i < msg->values_size(); i++)
+      {
+         LedgerEntry le(msg, i);
+         page.entries_.push_back(move(le));
+      }
+
+      if (msg->has_token())
+         page.token_ = BinaryData::fromString(msg->token());
+
+      ReturnMessage<LedgerPage> rm(page);
+
+      if (runInCaller())
+      {
+         userCallbackLambda_(move(rm));
+      }
+      else
+      {
+         thread thr(userCallbackLambda_, move(rm));
+         if (thr.joinable())
+            thr.detach();
+      }
+   }
+   catch (ClientMessageError& e)
+   {
+      ReturnMessage<LedgerPage> rm(e);
+      userCallbackLambda_(move(rm));
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void CallbackReturn_UINT64::callback(
    const WebSocketMessagePartial& partialMsg)
@@ -1708,6 +1984,46 @@ void CallbackReturn_VectorUTXO::callback(
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void CallbackReturn_AddrUTXOs::callback(
+   const WebSocketMessagePartial& partialMsg)
+{
+   try
+   {
+      ::Codec_Utxo::ManyAddressUtxos msg;
+      AsyncClient::deserialize(&msg, partialMsg);
+
+      map<BinaryData, vector<UTXO>> utxoMap;
+      for (int i = 0; i < msg.addrutxos_size(); i++)
+      {
+         auto& addrUtxos = msg.addrutxos(i);
+         auto& utxovec = utxoMap[BinaryData::fromString(addrUtxos.scraddr())];
+
+         utxovec.reserve(addrUtxos.utxos_size());
+         for (int y = 0; y < addrUtxos.utxos_size(); y++)
+            utxovec.emplace_back(UTXO::fromProtobuf(addrUtxos.utxos(y)));
+      }
+
+      ReturnMessage<map<BinaryData, vector<UTXO>>> rm(utxoMap);
+
+      if (runInCaller())
+      {
+         userCallbackLambda_(move(rm));
+      }
+      else
+      {
+         thread thr(userCallbackLambda_, move(rm));
+         if (thr.joinable())
+            thr.detach();
+      }
+   }
+   catch (ClientMessageError& e)
+   {
+      ReturnMessage<map<BinaryData, vector<UTXO>>> rm(e);
+      userCallbackLambda_(move(rm));
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void CallbackReturn_VectorUINT64::callback(
    const WebSocketMessagePartial& partialMsg)
@@ -1946,6 +2262,11 @@ void CallbackReturn_BlockHeader::callback(
       ref.setRef(str);
 
       DBClientClasses::BlockHeader bh(ref, height_);
+      if (height_ != UINT32_MAX)
+      {
+         cache_->insertRawHeader(
+            height_, ref.getSliceRef(0, HEADER_SIZE), epoch_);
+      }
 
       ReturnMessage<DBClientClasses::BlockHeader> rm(bh);
 
@@ -2095,6 +2416,8 @@ void CallbackReturn_AddrOutpoints::callback(
       OutpointBatch result;
       result.heightCutoff_ = msg.heightcutoff();
       result.zcIndexCutoff_ = msg.zcindexcutoff();
+      if (msg.has_token())
+         result.token_ = BinaryData::fromString(msg.token());
 
       for (int i = 0; i < msg.addroutpoints_size(); i++)
       {
@@ -2206,81 +2529,187 @@ void CallbackReturn_SpentnessData::callback(
 //
 // ClientCache
 //
+///////////////////////////////////////////////////////////////////////////////
+ClientCache::ClientCache(size_t txCount, size_t headerCount) :
+   txMap_(txCount), rawHeaderMap_(headerCount), 
+   txHashToHeightMap_(txCount)
+{}
+
 ///////////////////////////////////////////////////////////////////////////////
 void ClientCache::insertTx(std::shared_ptr<Tx> tx)
 {
-   ReentrantLock(this);
-   txMap_.emplace(tx->getThisHash(), tx);
+   ReentrantLock lock(this);
+   txMap_.put(tx->getThisHash(), tx);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ClientCache::insertTx(const BinaryData& hash, std::shared_ptr<Tx> tx)
+void ClientCache::insertTx(
+   const BinaryData& hash, std::shared_ptr<Tx> tx, unsigned epoch)
 {
-   ReentrantLock(this);
-   txMap_.emplace(hash, tx);
+   ReentrantLock lock(this);
+
+   //reply to a request issued before a reorg, may be stale
+   if (epoch != epoch_)
+      return;
+
+   txMap_.put(hash, tx);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ClientCache::insertRawHeader(unsigned& height, BinaryDataRef header)
+void ClientCache::insertRawHeader(
+   unsigned height, BinaryDataRef header, unsigned epoch)
 {
-   ReentrantLock(this);
-   rawHeaderMap_.insert(make_pair(height, header));
+   ReentrantLock lock(this);
+   if (epoch != epoch_)
+      return;
+
+   rawHeaderMap_.put(height, header);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ClientCache::insertHeightForTxHash(BinaryData& hash, unsigned& height)
+void ClientCache::insertHeightForTxHash(
+   const BinaryData& hash, unsigned height, unsigned epoch)
 {
-   ReentrantLock(this);
-   txHashToHeightMap_.insert(make_pair(hash, height));
+   ReentrantLock lock(this);
+   if (epoch != epoch_)
+      return;
+
+   txHashToHeightMap_.put(hash, height);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 shared_ptr<const Tx> ClientCache::getTx(const BinaryDataRef& hashRef) const
 {
-   ReentrantLock(this);
-
-   auto iter = txMap_.find(hashRef);
-   if (iter == txMap_.end())
-      throw NoMatch();
+   ReentrantLock lock(this);
 
-   auto constTx = const_pointer_cast<const Tx>(iter->second);
+   auto& tx = txMap_.get(hashRef);
+   auto constTx = const_pointer_cast<const Tx>(tx);
    return constTx;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 shared_ptr<Tx> ClientCache::getTx_NoConst(const BinaryDataRef& hashRef)
 {
-   ReentrantLock(this);
+   ReentrantLock lock(this);
+   return txMap_.get(hashRef);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BinaryData ClientCache::getRawHeader(unsigned height) const
+{
+   ReentrantLock lock(this);
+   return rawHeaderMap_.get(height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned ClientCache::getHeightForTxHash(const BinaryData& hash) const
+{
+   ReentrantLock lock(this);
+   return txHashToHeightMap_.get(hash);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ClientCache::addPendingTx(
+   const BinaryData& hash, const TxCallback& callback)
+{
+   ReentrantLock lock(this);
+
+   auto& callbacks = pendingTx_[hash];
+   callbacks.push_back(callback);
+   return callbacks.size() == 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<TxCallback> ClientCache::popPendingTx(const BinaryData& hash)
+{
+   ReentrantLock lock(this);
+
+   vector<TxCallback> result;
+   auto iter = pendingTx_.find(hash);
+   if (iter == pendingTx_.end())
+      return result;
+
+   result = move(iter->second);
+   pendingTx_.erase(iter);
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ClientCache::addPendingHeader(
+   unsigned height, const RawHeaderCallback& callback)
+{
+   ReentrantLock lock(this);
 
-   auto iter = txMap_.find(hashRef);
-   if (iter == txMap_.end())
-      throw NoMatch();
+   auto& callbacks = pendingHeaders_[height];
+   callbacks.push_back(callback);
+   return callbacks.size() == 1;
+}
 
-   return iter->second;   
+///////////////////////////////////////////////////////////////////////////////
+vector<RawHeaderCallback> ClientCache::popPendingHeaders(unsigned height)
+{
+   ReentrantLock lock(this);
+
+   vector<RawHeaderCallback> result;
+   auto iter = pendingHeaders_.find(height);
+   if (iter == pendingHeaders_.end())
+      return result;
+
+   result = move(iter->second);
+   pendingHeaders_.erase(iter);
+   return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const BinaryData& ClientCache::getRawHeader(const unsigned& height) const
+void ClientCache::reorg(unsigned branchHeight)
 {
-   ReentrantLock(this);
+   ReentrantLock lock(this);
+   ++epoch_;
+
+   /*
+   Everything mined above the branch point is orphaned. Drop the txs outright
+   rather than resetting their height, they may not be in the new branch.
+   Unconfirmed txs are left alone.
+   */
+   txMap_.eraseIf([branchHeight](
+      const BinaryData&, const shared_ptr<Tx>& tx)->bool
+   {
+      auto height = tx->getTxHeight();
+      return height != UINT32_MAX && height > branchHeight;
+   });
 
-   auto iter = rawHeaderMap_.find(height);
-   if (iter == rawHeaderMap_.end())
-      throw NoMatch();
+   rawHeaderMap_.eraseIf([branchHeight](
+      const unsigned& height, const BinaryData&)->bool
+   {
+      return height > branchHeight;
+   });
 
-   return iter->second;
+   txHashToHeightMap_.eraseIf([branchHeight](
+      const BinaryData&, const unsigned& height)->bool
+   {
+      return height > branchHeight;
+   });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const unsigned& ClientCache::getHeightForTxHash(const BinaryData& height) const
+unsigned ClientCache::epoch() const
 {
-   ReentrantLock(this);
+   ReentrantLock lock(this);
+   return epoch_;
+}
 
-   auto iter = txHashToHeightMap_.find(height);
-   if (iter == txHashToHeightMap_.end())
-      throw NoMatch();
+///////////////////////////////////////////////////////////////////////////////
+size_t ClientCache::txCount() const
+{
+   ReentrantLock lock(this);
+   return txMap_.size();
+}
 
-   return iter->second;
+///////////////////////////////////////////////////////////////////////////////
+size_t ClientCache::headerCount() const
+{
+   ReentrantLock lock(this);
+   return rawHeaderMap_.size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
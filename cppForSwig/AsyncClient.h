@@ -14,6 +14,7 @@ Handle codec and socketing for armory client
 #define _ASYNCCLIENT_H
 
 #include <thread>
+#include <list>
 
 #include "StringSockets.h"
 #include "bdmenums.h"
@@ -28,6 +29,10 @@ Handle codec and socketing for armory client
 class WalletManager;
 class WalletContainer;
 
+//entry caps for the client side cache of immutable chain data
+#define CLIENT_CACHE_TX_COUNT       20000
+#define CLIENT_CACHE_HEADER_COUNT   10000
+
 ///////////////////////////////////////////////////////////////////////////////
 struct OutpointData
 {
@@ -54,10 +59,22 @@ struct OutpointBatch
 
    std::map<BinaryData, std::vector<OutpointData>> outpoints_;
 
+   //paged queries only, empty on the last page
+   BinaryData token_;
+
    //debug
    void prettyPrint(void) const;
 };
 
+////
+struct LedgerPage
+{
+   std::vector<DBClientClasses::LedgerEntry> entries_;
+
+   //continuation for the next page, empty on the last page
+   BinaryData token_;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class ClientMessageError : public std::runtime_error
 {
@@ -167,42 +184,152 @@ struct CombinedCounts
 ///////////////////////////////////////////////////////////////////////////////
 namespace AsyncClient
 {
+   class NoMatch
+   {};
+
+   ///////////////////////////////////////////////////////////////////////////////
+   template<typename K, typename V> class LRUCache
+   {
+      /***
+      Bounded map, evicts the least recently used entry once full. 
+      Not thread safe, ClientCache guards it.
+      ***/
+
+   private:
+      typedef std::list<std::pair<K, V>> EntryList;
+
+      const size_t capacity_;
+      EntryList entries_;
+      std::map<K, typename EntryList::iterator> index_;
+
+   public:
+      LRUCache(size_t capacity) :
+         capacity_(capacity)
+      {}
+
+      void put(const K& key, V val)
+      {
+         auto iter = index_.find(key);
+         if (iter != index_.end())
+         {
+            iter->second->second = std::move(val);
+            entries_.splice(entries_.begin(), entries_, iter->second);
+            return;
+         }
+
+         entries_.emplace_front(key, std::move(val));
+         index_.emplace(key, entries_.begin());
+
+         if (entries_.size() > capacity_)
+         {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+         }
+      }
+
+      //throws NoMatch, bumps the entry to most recently used
+      V& get(const K& key)
+      {
+         auto iter = index_.find(key);
+         if (iter == index_.end())
+            throw NoMatch();
+
+         entries_.splice(entries_.begin(), entries_, iter->second);
+         return iter->second->second;
+      }
+
+      bool contains(const K& key) const
+      {
+         return index_.find(key) != index_.end();
+      }
+
+      template<typename Pred> void eraseIf(Pred pred)
+      {
+         auto iter = entries_.begin();
+         while (iter != entries_.end())
+         {
+            if (!pred(iter->first, iter->second))
+            {
+               ++iter;
+               continue;
+            }
+
+            index_.erase(iter->first);
+            iter = entries_.erase(iter);
+         }
+      }
+
+      size_t size(void) const { return entries_.size(); }
+      size_t capacity(void) const { return capacity_; }
+   };
+
+   ///////////////////////////////////////////////////////////////////////////////
+   typedef std::shared_ptr<const Tx> TxResult;
+   typedef std::function<void(ReturnMessage<TxResult>)> TxCallback;
+   typedef std::function<void(ReturnMessage<BinaryData>)> RawHeaderCallback;
+
    ///////////////////////////////////////////////////////////////////////////////
    class ClientCache : public Lockable
    {
+      /***
+      Client side cache for chain data (txs, raw headers, tx hash to height).
+      Entries are bounded by LRU eviction and dropped when a reorg notification
+      orphans the height they were mined at.
+
+      Also tracks in flight getTxByHash and getHeaderByHeight calls, so that 
+      concurrent requests for the same key share a single round trip.
+      ***/
+
       friend struct CallbackReturn_Tx;
       friend struct CallbackReturn_TxBatch;
       
    private:
-      std::map<BinaryData, std::shared_ptr<Tx>> txMap_;
-      std::map<unsigned, BinaryData> rawHeaderMap_;
-      std::map<BinaryData, unsigned> txHashToHeightMap_;
+      //lookups bump entries, hence mutable
+      mutable LRUCache<BinaryData, std::shared_ptr<Tx>> txMap_;
+      mutable LRUCache<unsigned, BinaryData> rawHeaderMap_;
+      mutable LRUCache<BinaryData, unsigned> txHashToHeightMap_;
+
+      std::map<BinaryData, std::vector<TxCallback>> pendingTx_;
+      std::map<unsigned, std::vector<RawHeaderCallback>> pendingHeaders_;
+
+      //bumped on reorgs, replies to requests issued before are not cached
+      unsigned epoch_ = 0;
 
    private:
       std::shared_ptr<Tx> getTx_NoConst(const BinaryDataRef&);
-      void insertTx(const BinaryData&, std::shared_ptr<Tx>);
+      void insertTx(const BinaryData&, std::shared_ptr<Tx>, unsigned epoch);
 
    public:
+      ClientCache(
+         size_t txCount = CLIENT_CACHE_TX_COUNT,
+         size_t headerCount = CLIENT_CACHE_HEADER_COUNT);
+
       void insertTx(std::shared_ptr<Tx>);
-      void insertRawHeader(unsigned&, BinaryDataRef);
-      void insertHeightForTxHash(BinaryData&, unsigned&);
+      void insertRawHeader(unsigned, BinaryDataRef, unsigned epoch);
+      void insertHeightForTxHash(const BinaryData&, unsigned, unsigned epoch);
 
       std::shared_ptr<const Tx> getTx(const BinaryDataRef&) const;
-      const BinaryData& getRawHeader(const unsigned&) const;
-      const unsigned& getHeightForTxHash(const BinaryData&) const;
+      BinaryData getRawHeader(unsigned) const;
+      unsigned getHeightForTxHash(const BinaryData&) const;
+
+      //in flight requests, add returns true if the caller has to send it
+      bool addPendingTx(const BinaryData&, const TxCallback&);
+      std::vector<TxCallback> popPendingTx(const BinaryData&);
+      bool addPendingHeader(unsigned, const RawHeaderCallback&);
+      std::vector<RawHeaderCallback> popPendingHeaders(unsigned);
+
+      //drops all entries above the branch point
+      void reorg(unsigned branchHeight);
+      unsigned epoch(void) const;
+
+      size_t txCount(void) const;
+      size_t headerCount(void) const;
 
       //virtuals
       void initAfterLock(void) {}
       void cleanUpBeforeUnlock(void) {}
    };
 
-   class NoMatch
-   {};
-
-   ///////////////////////////////////////////////////////////////////////////////
-   typedef std::shared_ptr<const Tx> TxResult;
-   typedef std::function<void(ReturnMessage<TxResult>)> TxCallback;
-
    typedef std::map<BinaryData, TxResult> TxBatchResult;
    typedef std::function<void(ReturnMessage<TxBatchResult>)> TxBatchCallback; 
 
@@ -224,6 +351,8 @@ namespace AsyncClient
 
       void getHistoryPage(uint32_t id, 
          std::function<void(ReturnMessage<std::vector<DBClientClasses::LedgerEntry>>)>);
+      void getHistoryFromCursor(const BinaryData& token, unsigned pageSize,
+         std::function<void(ReturnMessage<LedgerPage>)>);
       void getPageCount(std::function<void(ReturnMessage<uint64_t>)>) const;
 
       const std::string& getID(void) const { return delegateID_; }
@@ -308,6 +437,8 @@ namespace AsyncClient
 
       void getHistoryPage(uint32_t id, 
          std::function<void(ReturnMessage<std::vector<DBClientClasses::LedgerEntry>>)>);
+      void getHistoryFromCursor(const BinaryData& token, unsigned pageSize,
+         std::function<void(ReturnMessage<LedgerPage>)>);
       void getLedgerEntryForTxHash(
          const BinaryData& txhash, 
          std::function<void(ReturnMessage<std::shared_ptr<DBClientClasses::LedgerEntry>>)>);
@@ -315,8 +446,10 @@ namespace AsyncClient
       ScrAddrObj getScrAddrObjByKey(const BinaryData&,
          uint64_t, uint64_t, uint64_t, uint32_t);
 
+      //birthHeight: no history below this height, the scan starts there
       virtual std::string registerAddresses(
-         const std::vector<BinaryData>& addrVec, bool isNew);
+         const std::vector<BinaryData>& addrVec, bool isNew, 
+         unsigned birthHeight = 0);
       std::string unregisterAddresses(const std::set<BinaryData>&);
       std::string unregister(void);
 
@@ -351,7 +484,8 @@ namespace AsyncClient
       uint64_t getWltTotalTxnCount(void) const { return txnCount_; }
  
       std::string registerAddresses(
-         const std::vector<BinaryData>& addrVec, bool isNew);
+         const std::vector<BinaryData>& addrVec, bool isNew,
+         unsigned birthHeight = 0);
    };
 
    /////////////////////////////////////////////////////////////////////////////
@@ -360,6 +494,7 @@ namespace AsyncClient
    private:
       const std::shared_ptr<SocketPrototype> sock_;
       const std::string bdvID_;
+      const std::shared_ptr<ClientCache> cache_;
 
    public:
       Blockchain(const BlockDataViewer&);
@@ -495,9 +630,20 @@ namespace AsyncClient
          unsigned startHeight, unsigned zcIndexCutoff,
          std::function<void(ReturnMessage<OutpointBatch>)>);
 
+      //paged, the callback fires once per page, the next page is requested
+      //as soon as the previous one lands
+      void getOutpointsForAddresses(const std::set<BinaryData>&, 
+         unsigned startHeight, unsigned zcIndexCutoff, unsigned pageSize,
+         std::function<void(ReturnMessage<OutpointBatch>)>);
+
       void getUTXOsForAddress(const BinaryData&, bool,
          std::function<void(ReturnMessage<std::vector<UTXO>>)>);
 
+      //one round trip and one db sweep for the whole set
+      void getUTXOsForAddresses(const std::set<BinaryData>&, bool,
+         std::function<void(
+            ReturnMessage<std::map<BinaryData, std::vector<UTXO>>>)>);
+
       void getSpentnessForOutputs(const std::map<BinaryData, std::set<unsigned>>&,
          std::function<void(ReturnMessage<std::map<BinaryData, std::map<
          unsigned, SpentnessResult>>>)>);
@@ -586,17 +732,24 @@ namespace AsyncClient
    ///////////////////////////////////////////////////////////////////////////////
    struct CallbackReturn_Tx : public CallbackReturn_WebSocket
    {
+      /***
+      Replies to all getTxByHash calls pending on txHash_ in the cache.
+      ***/
+
    private:
       std::shared_ptr<ClientCache> cache_;
       BinaryData txHash_;
-      TxCallback userCallbackLambda_;
+      const unsigned epoch_;
+      bool replied_ = false;
 
    public:
       CallbackReturn_Tx(std::shared_ptr<ClientCache> cache,
-         const BinaryData& txHash, const TxCallback& lbd) :
-         cache_(cache), txHash_(txHash), userCallbackLambda_(lbd)
+         const BinaryData& txHash) :
+         cache_(cache), txHash_(txHash), epoch_(cache->epoch())
       {}
 
+      ~CallbackReturn_Tx(void);
+
       //virtual
       void callback(const WebSocketMessagePartial&);
    };
@@ -610,6 +763,7 @@ namespace AsyncClient
       TxBatchResult cachedTx_;
       std::map<BinaryData, bool> callMap_;
       TxBatchCallback userCallbackLambda_;
+      const unsigned epoch_;
 
    public:
       CallbackReturn_TxBatch(
@@ -617,7 +771,7 @@ namespace AsyncClient
          std::map<BinaryData, bool>& callMap, const TxBatchCallback& lbd) :
          cache_(cache), cachedTx_(std::move(cachedTx)),
          callMap_(std::move(callMap)),
-         userCallbackLambda_(lbd)
+         userCallbackLambda_(lbd), epoch_(cache->epoch())
       {}
 
       //virtual
@@ -627,21 +781,31 @@ namespace AsyncClient
    ///////////////////////////////////////////////////////////////////////////////
    struct CallbackReturn_RawHeader : public CallbackReturn_WebSocket
    {
+      /***
+      Lookups by height reply to all getHeaderByHeight calls pending on that
+      height, lookups by tx hash only to userCallbackLambda_.
+      ***/
+
    private:
-      std::function<void(ReturnMessage<BinaryData>)> userCallbackLambda_;
+      RawHeaderCallback userCallbackLambda_;
       std::shared_ptr<ClientCache> cache_;
       BinaryData txHash_;
       unsigned height_;
+      const unsigned epoch_;
+      bool replied_ = false;
 
    public:
       CallbackReturn_RawHeader(
          std::shared_ptr<ClientCache> cache,
          unsigned height, const BinaryData& txHash, 
-         std::function<void(ReturnMessage<BinaryData>)> lbd) :
+         RawHeaderCallback lbd) :
          userCallbackLambda_(lbd),
-         cache_(cache),txHash_(txHash), height_(height)
+         cache_(cache),txHash_(txHash), height_(height),
+         epoch_(cache->epoch())
       {}
 
+      ~CallbackReturn_RawHeader(void);
+
       //virtual
       void callback(const WebSocketMessagePartial&);
    };
@@ -714,6 +878,22 @@ namespace AsyncClient
       void callback(const WebSocketMessagePartial&);
    };
 
+   ///////////////////////////////////////////////////////////////////////////////
+   struct CallbackReturn_LedgerPage : public CallbackReturn_WebSocket
+   {
+   private:
+      std::function<void(ReturnMessage<LedgerPage>)> userCallbackLambda_;
+
+   public:
+      CallbackReturn_LedgerPage(
+         std::function<void(ReturnMessage<LedgerPage>)> lbd) :
+         userCallbackLambda_(lbd)
+      {}
+
+      //virtual
+      void callback(const WebSocketMessagePartial&);
+   };
+
    ///////////////////////////////////////////////////////////////////////////////
    struct CallbackReturn_UINT64 : public CallbackReturn_WebSocket
    {
@@ -746,6 +926,25 @@ namespace AsyncClient
       void callback(const WebSocketMessagePartial&);
    };
 
+   ///////////////////////////////////////////////////////////////////////////////
+   struct CallbackReturn_AddrUTXOs : public CallbackReturn_WebSocket
+   {
+   private:
+      std::function<void(
+         ReturnMessage<std::map<BinaryData, std::vector<UTXO>>>)> 
+         userCallbackLambda_;
+
+   public:
+      CallbackReturn_AddrUTXOs(
+         std::function<void(
+            ReturnMessage<std::map<BinaryData, std::vector<UTXO>>>)> lbd) :
+         userCallbackLambda_(lbd)
+      {}
+
+      //virtual
+      void callback(const WebSocketMessagePartial&);
+   };
+
    ///////////////////////////////////////////////////////////////////////////////
    struct CallbackReturn_VectorUINT64 : public CallbackReturn_WebSocket
    {
@@ -848,12 +1047,16 @@ namespace AsyncClient
    {
    private:
       std::function<void(ReturnMessage<DBClientClasses::BlockHeader>)> userCallbackLambda_;
+      std::shared_ptr<ClientCache> cache_;
       const unsigned height_;
+      const unsigned epoch_;
 
    public:
-      CallbackReturn_BlockHeader(unsigned height, 
+      CallbackReturn_BlockHeader(std::shared_ptr<ClientCache> cache,
+         unsigned height, 
          std::function<void(ReturnMessage<DBClientClasses::BlockHeader>)> lbd) :
-         userCallbackLambda_(lbd), height_(height)
+         userCallbackLambda_(lbd), cache_(cache), height_(height),
+         epoch_(cache->epoch())
       {}
 
       //virtual
@@ -144,6 +144,65 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       throw runtime_error("invalid command for getHistoryPage");
    }
 
+   case Methods::getHistoryFromCursor:
+   {
+      /*
+         in:
+            delegateID or walletID
+            token: continuation from the previous page, empty for the
+               first page
+            pageSize: entry count, defaults to 100, capped at 1000
+         out: Codec_LedgerEntry::ManyLedgerEntry, with the token for the
+            next page, empty once the history is exhausted
+      */
+
+      BinaryData token;
+      if (command->has_token())
+         token = BinaryData::fromString(command->token());
+
+      unsigned pageSize = HISTORYCURSOR_DEFAULT_PAGE_SIZE;
+      if (command->has_pagesize() && command->pagesize() != 0)
+      {
+         pageSize = min<unsigned>(
+            command->pagesize(), HISTORYCURSOR_MAX_PAGE_SIZE);
+      }
+
+      vector<LedgerEntry> leVec;
+      if (command->has_delegateid() && command->delegateid().size() != 0)
+      {
+         auto delegateIter = delegateMap_.find(command->delegateid());
+         if (delegateIter == delegateMap_.end())
+            throw runtime_error("unknown delegate");
+
+         leVec = delegateIter->second.getHistoryFromCursor(token, pageSize);
+      }
+      else if (command->has_walletid() && command->walletid().size() != 0)
+      {
+         auto theWallet = getWalletOrLockbox(command->walletid());
+         if (theWallet == nullptr)
+            throw runtime_error("unknown wallet or lockbox");
+
+         leVec = theWallet->getHistoryFromCursor(token, pageSize);
+      }
+      else
+      {
+         throw runtime_error("invalid command for getHistoryFromCursor");
+      }
+
+      auto response = make_shared<::Codec_LedgerEntry::ManyLedgerEntry>();
+      for (auto& le : leVec)
+      {
+         auto lePtr = response->add_values();
+         le.fillMessage(lePtr);
+      }
+
+      if (token.getSize() > 0)
+         response->set_token(token.getPtr(), token.getSize());
+
+      resultingPayload = response;
+      break;
+   }
+
    case Methods::getPageCountForLedgerDelegate:
    {
       /*
@@ -912,8 +971,7 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       uint32_t blocksToConfirm = command->value();
       auto strat = command->bindata(0);
 
-      auto feeByte = this->bdmPtr_->nodeRPC_->getFeeByte(
-            blocksToConfirm, strat);
+      auto feeByte = this->bdmPtr_->getFeeByte(blocksToConfirm, strat);
 
       auto response = make_shared<::Codec_FeeEstimate::FeeEstimate>();
       response->set_feebyte(feeByte.feeByte_);
@@ -936,7 +994,7 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
          throw runtime_error("invalid command for getFeeSchedule");
 
       auto strat = command->bindata(0);
-      auto feeBytes = this->bdmPtr_->nodeRPC_->getFeeSchedule(strat);
+      auto feeBytes = this->bdmPtr_->getFeeSchedule(strat);
 
       auto response = make_shared<::Codec_FeeEstimate::FeeSchedule>();
       for (auto& feeBytePair : feeBytes)
@@ -1208,6 +1266,12 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       which utxo fetching will be prioritize, i.e. if the first wallet 
       has enough UTXOs to cover value twice over, there will not be any
       UTXOs returned for the other wallets.
+
+      Wallets are walked one at a time for that reason, and each address 
+      pages its own history by height until the value is covered, so there 
+      is no shared sweep to be had here. The txouts are resolved in bulk 
+      per wallet. Use getUTXOsForAddresses to pull the utxos of a flat 
+      address set in one go.
       */
 
       if (!command->has_value())
@@ -1278,6 +1342,12 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       which utxo fetching will be prioritize, i.e. if the first wallet
       has enough UTXOs to cover value twice over, there will not be any
       UTXOs returned for the other wallets.
+
+      Wallets are walked one at a time for that reason, and each address 
+      pages its own history by height until the value is covered, so there 
+      is no shared sweep to be had here. The txouts are resolved in bulk 
+      per wallet. Use getUTXOsForAddresses to pull the utxos of a flat 
+      address set in one go.
       */
 
       vector<string> wltIDs;
@@ -1333,6 +1403,12 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       which utxo fetching will be prioritized, i.e. if the first wallet
       has enough UTXOs to cover value twice over, there will not be any
       UTXOs returned for the other wallets.
+
+      Wallets are walked one at a time for that reason, and each address 
+      pages its own history by height until the value is covered, so there 
+      is no shared sweep to be had here. The txouts are resolved in bulk 
+      per wallet. Use getUTXOsForAddresses to pull the utxos of a flat 
+      address set in one go.
       */
 
       vector<string> wltIDs;
@@ -1379,8 +1455,13 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
    case Methods::getOutpointsForAddresses:
    {
       /*
-      in: set of scrAddr as bindata[]
-      out: outpoints for each address as Codec_Utxo::AddressOutpointsData
+      in: 
+         set of scrAddr as bindata[]
+         optional: pageSize, token (resend the same set along with the token
+         from the previous page)
+      out: 
+         outpoints for each address as Codec_Utxo::AddressOutpointsData,
+         paged calls carry a token until the last page
       */
 
       set<BinaryDataRef> scrAddrSet;
@@ -1409,7 +1490,21 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       }
 
       //this call will update the cutoff values
-      auto&& outpointMap = getAddressOutpoints(scrAddrSet, heightCutOff, zcCutOff);
+      BinaryData token;
+      unsigned pageSize = UINT32_MAX;
+      if (command->has_pagesize() || command->has_token())
+      {
+         token = BinaryData::fromString(command->token());
+         pageSize = command->has_pagesize() ? 
+            command->pagesize() : OUTPOINT_QUERY_PAGE_SIZE;
+         if (pageSize == 0)
+            pageSize = OUTPOINT_QUERY_PAGE_SIZE;
+      }
+
+      auto&& outpointMap = getAddressOutpoints(
+         scrAddrSet, heightCutOff, zcCutOff, token, pageSize);
+      if (!token.empty())
+         response->set_token(token.getPtr(), token.getSize());
 
       //fill in response
       for (auto& addrPair : outpointMap)
@@ -1455,6 +1550,8 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       /*
       in: scrAddr as scraddr
       out: utxos as Codec_Utxo::ManyUtxo
+
+      single address, see getUTXOsForAddresses for many
       */
 
       auto& addr = command->scraddr();
@@ -1478,6 +1575,47 @@ BDVCommandProcessingResultType BDV_Server_Object::processCommand(
       break;
    }
 
+   case Methods::getUTXOsForAddresses:
+   {
+      /*
+      in: set of scrAddr as bindata[]
+      out: utxos per address as Codec_Utxo::ManyAddressUtxos, addresses
+         without utxos are omitted
+      */
+
+      set<BinaryDataRef> scrAddrSet;
+      for (int i = 0; i < command->bindata_size(); i++)
+      {
+         auto& addr = command->bindata(i);
+         if (addr.size() == 0 || addr.size() > 33)
+            throw runtime_error("invalid address for getUTXOsForAddresses");
+
+         BinaryDataRef scrAddr;
+         scrAddr.setRef((const uint8_t*)addr.c_str(), addr.size());
+         scrAddrSet.insert(scrAddr);
+      }
+
+      auto withZc = command->flag();
+      auto&& utxoMap = getUtxosForAddresses(scrAddrSet, withZc);
+
+      auto response = make_shared<::Codec_Utxo::ManyAddressUtxos>();
+      for (auto& utxoPair : utxoMap)
+      {
+         auto addrUtxos = response->add_addrutxos();
+         addrUtxos->set_scraddr(
+            utxoPair.first.getPtr(), utxoPair.first.getSize());
+
+         for (auto& utxo : utxoPair.second)
+         {
+            auto utxoPtr = addrUtxos->add_utxos();
+            utxo.toProtobuf(*utxoPtr);
+         }
+      }
+
+      resultingPayload = response;
+      break;
+   }
+
    case Methods::getSpentnessForOutputs:
    {
       /*
@@ -1820,8 +1958,6 @@ shared_ptr<BDV_Server_Object> Clients::get(const string& id) const
 void BDV_Server_Object::setup()
 {
    started_.store(0, memory_order_relaxed);
-   packetProcess_threadLock_.store(0, memory_order_relaxed);
-   notificationProcess_threadLock_.store(0, memory_order_relaxed);
 
    isReadyPromise_ = make_shared<promise<bool>>();
    isReadyFuture_ = isReadyPromise_->get_future();
@@ -1890,6 +2026,9 @@ void BDV_Server_Object::haltThreads()
       cb_->shutdown();
    if (initT_.joinable())
       initT_.join();
+
+   packetGate_.clear();
+   notificationGate_.clear();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1927,6 +2066,8 @@ void BDV_Server_Object::init()
             BinaryDataRef addrRef; addrRef.setRef(addrStr);
             batch->scrAddrSet_.insert(move(addrRef));
          }
+
+         WalletGroup::setBirthHeights(*batch, *wlt.second.command_);
       }
 
       //callback only serves to wait on the registration event
@@ -1975,18 +2116,32 @@ void BDV_Server_Object::init()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void BDV_Server_Object::processNotification(
+shared_ptr<SerializedCallback> BDV_Server_Object::getSharedCallback(
    shared_ptr<BDV_Notification> notifPtr)
 {
+   //only broadcast notifications without per bdv content qualify
    auto action = notifPtr->action_type();
-   if (action < BDV_Progress)
+   switch (action)
    {
-      //skip all but progress notifications if BDV isn't ready
-      if (isReadyFuture_.wait_for(chrono::seconds(0)) != future_status::ready)
-         return;
+   case BDV_NewBlock:
+   case BDV_NodeStatus:
+      break;
+
+   case BDV_Progress:
+   {
+      if (!notifPtr->bdvID().empty())
+         return nullptr;
+      break;
    }
 
-   scanWallets(notifPtr);
+   default:
+      return nullptr;
+   }
+
+   //first bdv to get here builds it
+   unique_lock<mutex> lock(notifPtr->serializedMu_);
+   if (notifPtr->serialized_ != nullptr)
+      return notifPtr->serialized_;
 
    auto callbackPtr = make_shared<BDVCallback>();
 
@@ -2024,31 +2179,6 @@ void BDV_Server_Object::processNotification(
       break;
    }
 
-   case BDV_Refresh:
-   {
-      auto&& payload =
-         dynamic_pointer_cast<BDV_Notification_Refresh>(notifPtr);
-
-      auto& bdId = payload->refreshID_;
-
-      auto notif = callbackPtr->add_notification();
-      notif->set_type(NotificationType::refresh);
-      auto refresh = notif->mutable_refresh();
-      refresh->set_refreshtype(payload->refresh_);
-      refresh->add_id(bdId.getPtr(), bdId.getSize());
-
-      break;
-   }
-
-   case BDV_ZC:
-   {
-      auto&& payload =
-         dynamic_pointer_cast<BDV_Notification_ZC>(notifPtr);
-      payload->packet_.toProtobufNotification(callbackPtr, payload->leVec_);
-
-      break;
-   }
-
    case BDV_Progress:
    {
       auto&& payload =
@@ -2094,6 +2224,65 @@ void BDV_Server_Object::processNotification(
       break;
    }
 
+   default:
+      return nullptr;
+   }
+
+   notifPtr->serialized_ = make_shared<SerializedCallback>(callbackPtr);
+   return notifPtr->serialized_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BDV_Server_Object::processNotification(
+   shared_ptr<BDV_Notification> notifPtr)
+{
+   auto action = notifPtr->action_type();
+   if (action < BDV_Progress)
+   {
+      //skip all but progress notifications if BDV isn't ready
+      if (isReadyFuture_.wait_for(chrono::seconds(0)) != future_status::ready)
+         return;
+   }
+
+   scanWallets(notifPtr);
+
+   //broadcast payloads are the same for all bdvs
+   auto shared = getSharedCallback(notifPtr);
+   if (shared != nullptr)
+   {
+      cb_->callback(shared);
+      return;
+   }
+
+   auto callbackPtr = make_shared<BDVCallback>();
+
+   switch (action)
+   {
+   case BDV_Refresh:
+   {
+      auto&& payload =
+         dynamic_pointer_cast<BDV_Notification_Refresh>(notifPtr);
+
+      auto& bdId = payload->refreshID_;
+
+      auto notif = callbackPtr->add_notification();
+      notif->set_type(NotificationType::refresh);
+      auto refresh = notif->mutable_refresh();
+      refresh->set_refreshtype(payload->refresh_);
+      refresh->add_id(bdId.getPtr(), bdId.getSize());
+
+      break;
+   }
+
+   case BDV_ZC:
+   {
+      auto&& payload =
+         dynamic_pointer_cast<BDV_Notification_ZC>(notifPtr);
+      payload->packet_.toProtobufNotification(callbackPtr, payload->leVec_);
+
+      break;
+   }
+
    case BDV_Action::BDV_Error:
    {
       auto&& payload =
@@ -2398,14 +2587,14 @@ void Clients::init(BlockDataManagerThread* bdmT,
       bdvMaintenanceLoop();
    };
 
-   auto innerthread = [this](void)->void
+   auto notifPacketLbd = [this](shared_ptr<BDV_Notification_Packet> packet)->void
    {
-      bdvMaintenanceThread();
+      this->processNotificationPacket(move(packet));
    };
 
-   auto parserThread = [this](void)->void
+   auto payloadPacketLbd = [this](shared_ptr<BDV_Payload> payload)->void
    {
-      this->messageParserThread();
+      this->processPayloadPacket(move(payload));
    };
 
    auto unregistrationThread = [this](void)->void
@@ -2427,11 +2616,17 @@ void Clients::init(BlockDataManagerThread* bdmT,
    if (Armory::Config::DBSettings::getDbType() == ARMORY_DB_SUPER &&
       Armory::Config::DBSettings::getServiceType() != SERVICE_UNITTEST)
       innerThreadCount = thread::hardware_concurrency();
-   for (unsigned i = 0; i < innerThreadCount; i++)
-   {
-      controlThreads_.push_back(thread(innerthread));
-      controlThreads_.push_back(thread(parserThread));
-   }
+
+   //notifications and commands are processed on the shared executor,
+   //together they leave a worker to the other subsystems
+   auto& executor = Executor::shared();
+   auto drainCount = innerThreadCount * 2;
+   if (executor.threadCount() > 1)
+      drainCount = min(drainCount, executor.threadCount() - 1);
+   auto drainGroup = make_shared<DrainGroup>(drainCount);
+
+   innerBDVNotifStack_.start(notifPacketLbd, innerThreadCount, drainGroup);
+   packetQueue_.start(payloadPacketLbd, innerThreadCount, drainGroup);
 
    auto callbackPtr = make_unique<ZeroConfCallbacks_BDV>(this);
    bdmT_->bdm()->registerZcCallbacks(move(callbackPtr));
@@ -2482,44 +2677,29 @@ void Clients::bdvMaintenanceLoop()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void Clients::bdvMaintenanceThread()
+void Clients::processNotificationPacket(
+   shared_ptr<BDV_Notification_Packet> notifPtr)
 {
-   while (1)
+   if (notifPtr->bdvPtr_ == nullptr)
    {
-      shared_ptr<BDV_Notification_Packet> notifPtr;
-      try
-      {
-         notifPtr = move(innerBDVNotifStack_.pop_front());
-      }
-      catch (StopBlockingLoop&)
-      {
-         break;
-      }
-
-      if (notifPtr->bdvPtr_ == nullptr)
-      {
-         LOGWARN << "null bdvPtr in notification";
-         continue;
-      }
+      LOGWARN << "null bdvPtr in notification";
+      return;
+   }
 
-      auto bdvPtr = notifPtr->bdvPtr_;
-      unsigned zero = 0;
-      if (!bdvPtr->notificationProcess_threadLock_.compare_exchange_weak(
-         zero, 1))
-      {
-         //Failed to grab lock, there's already a thread processing a payload
-         //for this bdv. Insert the payload back into the queue. Another 
-         //thread will eventually pick it up and successfully grab the lock 
-         if (notifPtr == nullptr)
-            LOGERR << "!!!!!! empty notif at reinsertion";
+   auto bdvPtr = notifPtr->bdvPtr_;
+   if (!notifPtr->ownsGate_ && !bdvPtr->notificationGate_.enter(notifPtr))
+   {
+      //there's already a task processing a notification for this bdv,
+      //the packet is parked on the bdv until that task is done
+      return;
+   }
 
-         innerBDVNotifStack_.push_back(move(notifPtr));
-         continue;
-      }
+   bdvPtr->processNotification(notifPtr->notifPtr_);
 
-      bdvPtr->processNotification(notifPtr->notifPtr_);
-      bdvPtr->notificationProcess_threadLock_.store(0);
-   }
+   //hand the gate to the next parked notification, if any
+   auto nextPacket = bdvPtr->notificationGate_.leave();
+   if (nextPacket != nullptr)
+      innerBDVNotifStack_.push_back(move(nextPacket));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2784,94 +2964,72 @@ void Clients::notificationThread(void) const
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void Clients::messageParserThread(void)
+void Clients::processPayloadPacket(shared_ptr<BDV_Payload> payloadPtr)
 {
-   while (1)
+   //sanity check
+   if (payloadPtr == nullptr)
    {
-      shared_ptr<BDV_Payload> payloadPtr;
-      
-      try
-      {
-         payloadPtr = move(packetQueue_.pop_front());
-      }
-      catch (StopBlockingLoop&)
-      {
-         break;
-      }
-
-      //sanity check
-      if (payloadPtr == nullptr)
-      {
-         LOGERR << "????????? empty payload";
-         continue;
-      }
-
-      if (payloadPtr->bdvPtr_ == nullptr)
-      {
-         LOGERR << "???????? empty bdv ptr";
-         continue;
-      }
-
-      auto bdvPtr = payloadPtr->bdvPtr_;
-      unsigned zero = 0;
-      if (!bdvPtr->packetProcess_threadLock_.compare_exchange_weak(
-            zero, 1, memory_order_relaxed, memory_order_relaxed))
-      {
-         //Failed to grab lock, there's already a thread processing a payload
-         //for this bdv. Insert the payload back into the queue. Another 
-         //thread will eventually pick it up and successfully grab the lock 
-         if(payloadPtr == nullptr)
-            LOGERR << "!!!!!! empty payload at reinsertion";
+      LOGERR << "????????? empty payload";
+      return;
+   }
 
-         packetQueue_.push_back(move(payloadPtr));
-         continue;
-      }
+   if (payloadPtr->bdvPtr_ == nullptr)
+   {
+      LOGERR << "???????? empty bdv ptr";
+      return;
+   }
 
-      /*
-      Grabbed the thread lock, time to process the payload.
+   auto bdvPtr = payloadPtr->bdvPtr_;
+   if (!payloadPtr->ownsGate_ && !bdvPtr->packetGate_.enter(payloadPtr))
+   {
+      //there's already a task processing a payload for this bdv, the
+      //payload is parked on the bdv until that task is done
+      return;
+   }
 
-      However, since the thread lock is only a spin lock with loose ordering
-      semantics (for speed), we need the current thread to be up to date with 
-      all changes previous threads have made to this bdv object, hence acquiring 
-      the object's process mutex
-      */
-      unique_lock<mutex> lock(bdvPtr->processPacketMutex_);
-      auto result = processCommand(payloadPtr);
+   /*
+   Owning the gate, time to process the payload. The process mutex keeps
+   the current thread up to date with all changes previous threads have
+   made to this bdv object.
+   */
+   unique_lock<mutex> lock(bdvPtr->processPacketMutex_);
+   auto result = processCommand(payloadPtr);
 
-      //check if the map has the next message
+   //check if the map has the next message
+   {
+      auto msgIter = bdvPtr->messageMap_.find(
+         bdvPtr->lastValidMessageId_ + 1);
+      
+      if (msgIter != bdvPtr->messageMap_.end() && 
+         msgIter->second.isReady())
       {
-         auto msgIter = bdvPtr->messageMap_.find(
-            bdvPtr->lastValidMessageId_ + 1);
+         /*
+         We have the next message and it is ready, push a packet
+         with no data on the queue to assign this bdv a new processing
+         thread. 
          
-         if (msgIter != bdvPtr->messageMap_.end() && 
-            msgIter->second.isReady())
-         {
-            /*
-            We have the next message and it is ready, push a packet
-            with no data on the queue to assign this bdv a new processing
-            thread. 
-            
-            This is done because we don't want one bdv to hog a thread 
-            constantly if it has a lot of queue up messages. It should
-            complete for a thread like all other bdv objects, regardless
-            of the its message queue depth.
-            */
-            auto flagPacket = make_shared<BDV_Payload>();
-            flagPacket->bdvPtr_ = bdvPtr;
-            flagPacket->bdvID_ = payloadPtr->bdvID_;
-            packetQueue_.push_back(move(flagPacket));
-         }
+         This is done because we don't want one bdv to hog a thread 
+         constantly if it has a lot of queue up messages. It should
+         complete for a thread like all other bdv objects, regardless
+         of the its message queue depth.
+         */
+         auto flagPacket = make_shared<BDV_Payload>();
+         flagPacket->bdvPtr_ = bdvPtr;
+         flagPacket->bdvID_ = payloadPtr->bdvID_;
+         packetQueue_.push_back(move(flagPacket));
       }
-      
-      //release the locks
-      lock.unlock();
-      bdvPtr->packetProcess_threadLock_.store(0);
-
-      //write return value if any
-      if (result != nullptr)
-         WebSocketServer::write(
-            payloadPtr->bdvID_, payloadPtr->messageID_, result);
    }
+   
+   //release the locks, hand the gate to the next parked payload if any
+   lock.unlock();
+   auto nextPayload = bdvPtr->packetGate_.leave();
+   if (nextPayload != nullptr)
+      packetQueue_.push_back(move(nextPayload));
+
+   //write return value if any
+   if (result != nullptr)
+      WebSocketServer::write(
+         payloadPtr->bdvID_, payloadPtr->messageID_, result);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3427,6 +3585,20 @@ shared_ptr<Message> Clients::processUnregisteredCommand(const uint64_t& bdvId,
 Callback::~Callback()
 {}
 
+///////////////////////////////////////////////////////////////////////////////
+SerializedCallback::SerializedCallback(shared_ptr<BDVCallback> msg) :
+   message_(msg)
+{
+   auto payload = make_shared<BinaryData>(msg->ByteSizeLong());
+   if (payload->getSize() > 0 &&
+      !msg->SerializeToArray(payload->getPtr(), payload->getSize()))
+   {
+      throw runtime_error("failed to serialize callback");
+   }
+
+   payload_ = payload;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void WS_Callback::callback(shared_ptr<BDVCallback> command)
 {
@@ -3434,6 +3606,14 @@ void WS_Callback::callback(shared_ptr<BDVCallback> command)
    WebSocketServer::write(bdvID_, WEBSOCKET_CALLBACK_ID, command);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void WS_Callback::callback(shared_ptr<SerializedCallback> command)
+{
+   //payload is already serialized, the socket only encrypts it
+   WebSocketServer::write(bdvID_, WEBSOCKET_CALLBACK_ID, 
+      command->message_, command->payload_);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void UnitTest_Callback::callback(shared_ptr<BDVCallback> command)
 {
@@ -14,6 +14,7 @@
 #include <mutex>
 #include <thread>
 #include <future>
+#include <deque>
 
 #include "BitcoinP2p.h"
 #include "BlockDataViewer.h"
@@ -23,6 +24,7 @@
 #include "BDV_Notification.h"
 #include "BDVCodec.h"
 #include "ZeroConf.h"
+#include "Executor.h"
 #include "Server.h"
 #include "BtcWallet.h"
 #include "ArmoryErrors.h"
@@ -73,6 +75,9 @@ struct BDV_Payload
    std::shared_ptr<BDV_Server_Object> bdvPtr_;
    uint32_t messageID_;
    uint64_t bdvID_;
+
+   //handed the bdv's packet gate on release, see BDV_ProcessGate
+   bool ownsGate_ = false;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -90,6 +95,21 @@ struct BDV_PartialMessage
    static unsigned getMessageId(std::shared_ptr<BDV_Payload>);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+struct SerializedCallback
+{
+   /***
+   Callback shared by all BDVs for a broadcast notification. The message is
+   serialized once, connections only encrypt the payload. Neither may be
+   modified once built.
+   ***/
+
+   std::shared_ptr<::Codec_BDVCommand::BDVCallback> message_;
+   std::shared_ptr<const BinaryData> payload_;
+
+   SerializedCallback(std::shared_ptr<::Codec_BDVCommand::BDVCallback>);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class Callback
 {
@@ -98,6 +118,11 @@ public:
    virtual ~Callback() = 0;
 
    virtual void callback(std::shared_ptr<::Codec_BDVCommand::BDVCallback>) = 0;
+   virtual void callback(std::shared_ptr<SerializedCallback> cb)
+   {
+      callback(cb->message_);
+   }
+
    virtual bool isValid(void) = 0;
    virtual void shutdown(void) = 0;
 };
@@ -114,6 +139,7 @@ public:
    {}
 
    void callback(std::shared_ptr<::Codec_BDVCommand::BDVCallback>);
+   void callback(std::shared_ptr<SerializedCallback>);
    bool isValid(void) { return true; }
    void shutdown(void) {}
 };
@@ -126,6 +152,7 @@ private:
       std::shared_ptr<::Codec_BDVCommand::BDVCallback>> notifQueue_;
 
 public:
+   using Callback::callback;
    void callback(std::shared_ptr<::Codec_BDVCommand::BDVCallback>);
    bool isValid(void) { return true; }
    void shutdown(void) {}
@@ -133,6 +160,69 @@ public:
    std::shared_ptr<::Codec_BDVCommand::BDVCallback> getNotification(void);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+template <typename T> class BDV_ProcessGate
+{
+   /***
+   Serializes the processing of a bdv's packets across executor workers.
+
+   A packet that finds the gate taken is parked on it rather than pushed
+   back on the shared queue, where it would keep bouncing between workers
+   for as long as the owner is busy. Releasing the gate hands it to the
+   oldest parked packet, which the caller reschedules. That packet already
+   owns the gate (ownsGate_) and skips enter().
+   ***/
+
+private:
+   std::mutex mu_;
+   bool busy_ = false;
+   std::deque<T> parked_;
+
+public:
+   //true if the caller now owns the gate, otherwise the packet is parked
+   bool enter(T& packet)
+   {
+      std::unique_lock<std::mutex> lock(mu_);
+      if (busy_)
+      {
+         parked_.push_back(std::move(packet));
+         return false;
+      }
+
+      busy_ = true;
+      return true;
+   }
+
+   //returns the packet the gate was handed to, nullptr if it's free
+   T leave(void)
+   {
+      std::unique_lock<std::mutex> lock(mu_);
+      if (parked_.empty())
+      {
+         busy_ = false;
+         return nullptr;
+      }
+
+      auto packet = std::move(parked_.front());
+      parked_.pop_front();
+      packet->ownsGate_ = true;
+      return packet;
+   }
+
+   //drop parked packets, they hold a ref to the bdv
+   void clear(void)
+   {
+      std::unique_lock<std::mutex> lock(mu_);
+      parked_.clear();
+   }
+
+   size_t parkedCount(void)
+   {
+      std::unique_lock<std::mutex> lock(mu_);
+      return parked_.size();
+   }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class BDV_Server_Object : public BlockDataViewer
 {
@@ -165,8 +255,8 @@ private:
    std::shared_future<bool> isReadyFuture_;
 
    std::function<void(std::unique_ptr<BDV_Notification>)> notifLambda_;
-   std::atomic<unsigned> packetProcess_threadLock_;
-   std::atomic<unsigned> notificationProcess_threadLock_;
+   BDV_ProcessGate<std::shared_ptr<BDV_Payload>> packetGate_;
+   BDV_ProcessGate<std::shared_ptr<BDV_Notification_Packet>> notificationGate_;
 
    std::map<unsigned, BDV_PartialMessage> messageMap_;
 
@@ -199,6 +289,8 @@ public:
 
    const std::string& getID(void) const { return bdvID_; }
    void processNotification(std::shared_ptr<BDV_Notification>);
+   static std::shared_ptr<SerializedCallback> getSharedCallback(
+      std::shared_ptr<BDV_Notification>);
    void init(void);
    void haltThreads(void);
    BDVCommandProcessingResultType processPayload(std::shared_ptr<BDV_Payload>&,
@@ -223,8 +315,14 @@ private:
    std::thread unregThread_;
 
    mutable Armory::Threading::BlockingQueue<std::shared_ptr<BDV_Notification>> outerBDVNotifStack_;
-   Armory::Threading::BlockingQueue<std::shared_ptr<BDV_Notification_Packet>> innerBDVNotifStack_;
-   Armory::Threading::BlockingQueue<std::shared_ptr<BDV_Payload>> packetQueue_;
+   Armory::Threading::DrainQueue<std::shared_ptr<BDV_Notification_Packet>> innerBDVNotifStack_ {
+      Armory::Threading::Executor::shared(),
+      Armory::Threading::ExecutorWorkload_Clients,
+      Armory::Threading::TaskPriority_Interactive };
+   Armory::Threading::DrainQueue<std::shared_ptr<BDV_Payload>> packetQueue_ {
+      Armory::Threading::Executor::shared(),
+      Armory::Threading::ExecutorWorkload_Clients,
+      Armory::Threading::TaskPriority_Interactive };
    Armory::Threading::BlockingQueue<std::string> unregBDVQueue_;
    Armory::Threading::BlockingQueue<RpcBroadcastPacket> rpcBroadcastQueue_;
 
@@ -234,8 +332,8 @@ private:
    void notificationThread(void) const;
    void unregisterAllBDVs(void);
    void bdvMaintenanceLoop(void);
-   void bdvMaintenanceThread(void);
-   void messageParserThread(void);
+   void processNotificationPacket(std::shared_ptr<BDV_Notification_Packet>);
+   void processPayloadPacket(std::shared_ptr<BDV_Payload>);
    void unregisterBDVThread(void);
 
    void broadcastThroughRPC(void);
@@ -172,8 +172,24 @@ try
 
    isReadyPromise.set_value(true);
 
+   //integrity checks run alongside the db, their progress goes out under
+   //its own phase
+   auto verifyProgress = [bdm](BDMPhase phase, double prog,
+      unsigned time, unsigned numericProgress)->void
+   {
+      auto&& notifPtr = make_unique<BDV_Notification_Progress>(
+         phase, prog, time, numericProgress, vector<string>());
+      bdm->notificationStack_.push_back(move(notifPtr));
+   };
+   bdm->startIntegrityCheck(verifyProgress);
+
+   //--checkchain builds the db without scanning it, there is nothing to
+   //serve: wait on the check and exit
    if (DBSettings::checkChain())
+   {
+      bdm->waitOnIntegrityCheck();
       return;
+   }
 
    auto updateChainLambda = [bdm, this]()->void
    {
@@ -205,6 +221,29 @@ try
    bdm->processNode_->registerNodeStatusLambda(updateNodeStatusLambda);
    bdm->nodeRPC_->registerNodeStatusLambda(updateNodeStatusLambda);
 
+   //Blocks announced by the node are fetched and parsed on arrival, the
+   //chain update picks them up ahead of the blk files. Supernode builds its
+   //hints from the blk files and keeps waiting on those.
+   if (DBSettings::getDbType() != ARMORY_DB_SUPER)
+   {
+      auto blockchain = bdm->blockchain();
+      auto blockLambda = [blockchain](unique_ptr<Payload> payload)->void
+      {
+         auto payloadBlock = dynamic_cast<Payload_Block*>(payload.get());
+         if (payloadBlock == nullptr)
+            return;
+
+         auto getID = [blockchain](const BinaryData&)->unsigned int
+         {
+            return blockchain->getNewUniqueID();
+         };
+
+         MemoryBlockStore::shared().add(payloadBlock->moveRawBlock(), getID);
+      };
+
+      bdm->processNode_->registerBlockCallback(blockLambda);
+   }
+
    auto newBlockStack = bdm->processNode_->getInvBlockStack();
    while (pimpl->run)
    {
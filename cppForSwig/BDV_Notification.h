@@ -10,6 +10,7 @@
 #define _BDV_NOTIFICATION_H_
 
 #include <memory>
+#include <mutex>
 
 #include "log.h"
 #include "bdmenums.h"
@@ -19,6 +20,8 @@
 #include "nodeRPC.h"
 #include "ZeroConfNotifications.h"
 
+struct SerializedCallback;
+
 ///////////////////////////////////////////////////////////////////////////////
 struct BDV_Notification
 {
@@ -26,6 +29,12 @@ private:
    //notificaiton with empty ID means broadcast to all bdv
    const std::string bdvID_;
 
+public:
+   //client payload of broadcast notifications, built and serialized by 
+   //the first bdv to process the notification, then shared by the others
+   std::mutex serializedMu_;
+   std::shared_ptr<SerializedCallback> serialized_;
+
 public:
    BDV_Notification(const std::string& id) :
       bdvID_(id)
@@ -170,6 +179,9 @@ struct BDV_Notification_Packet
 {
    std::shared_ptr<BDV_Server_Object> bdvPtr_;
    std::shared_ptr<BDV_Notification> notifPtr_;
+
+   //handed the bdv's notification gate on release
+   bool ownsGate_ = false;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
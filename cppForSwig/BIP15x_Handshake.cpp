@@ -456,9 +456,40 @@ HandshakeState BIP15x_Handshake::clientSideHandshake(
       return HandshakeState::Completed;
    }
 
+   case BIP151_PayloadType::Capabilities:
+   {
+      //server announce, only valid on an authenticated channel
+      if (connPtr->getBIP150State() != BIP150State::SUCCESS)
+         return HandshakeState::Error;
+
+      //answer with the features we want out of the ones offered
+      auto capabilities = deserializeCapabilities(msg) & BIP15X_CAPABILITIES;
+      writeCb(serializeCapabilities(capabilities),
+         BIP151_PayloadType::Capabilities, true);
+      break;
+   }
+
    default:
       return HandshakeState::Error;
    }
 
    return HandshakeState::StepSuccessful;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData BIP15x_Handshake::serializeCapabilities(uint32_t capabilities)
+{
+   BinaryWriter bw;
+   bw.put_uint32_t(capabilities);
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t BIP15x_Handshake::deserializeCapabilities(const BinaryDataRef& msg)
+{
+   if (msg.getSize() != 4)
+      return 0;
+
+   BinaryRefReader brr(msg);
+   return brr.get_uint32_t();
+}
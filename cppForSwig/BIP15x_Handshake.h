@@ -14,6 +14,14 @@
 
 class BIP151Connection;
 
+/*
+Optional protocol features, exchanged once the auth handshake is done: the
+server announces what it supports, the client answers with the subset it
+wants to use. Peers that predate the exchange ignore the announcement.
+*/
+#define BIP15X_CAPABILITY_BATCH 0x00000001
+#define BIP15X_CAPABILITIES BIP15X_CAPABILITY_BATCH
+
 namespace ArmoryAEAD
 {
 enum HandshakeState
@@ -62,6 +70,7 @@ enum class BIP151_PayloadType : uint8_t
    SinglePacket         = 1,
    FragmentHeader       = 2,
    FragmentPacket       = 3,
+   Batch                = 4,
 
    Threshold_Begin      = 100,
    Start                = 101,
@@ -78,6 +87,9 @@ enum class BIP151_PayloadType : uint8_t
    Reply                = 132,
    Propose              = 133,
 
+   Threshold_Ext        = 140,
+   Capabilities         = 141,
+
    Threshold_End        = 150
 };
 
@@ -95,6 +107,10 @@ public:
    static HandshakeState clientSideHandshake(
       BIP151Connection*, const std::string&, BIP151_PayloadType,
       const BinaryDataRef&, const WriteCallback&);
+
+   static BinaryData serializeCapabilities(uint32_t);
+   //returns 0 for invalid payloads
+   static uint32_t deserializeCapabilities(const BinaryDataRef&);
 };
 }; //namespace ArmoryAEAD
 #endif
@@ -108,7 +108,8 @@ const map<string, PayloadType> BitcoinP2P::strToPayload_ = {
    make_pair("pong", Payload_pong),
    make_pair("getdata", Payload_getdata),
    make_pair("tx", Payload_tx),
-   make_pair("reject", Payload_reject)
+   make_pair("reject", Payload_reject),
+   make_pair("block", Payload_block)
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -338,6 +339,11 @@ shared_ptr<Payload::DeserializedPayloads> Payload::deserialize(
                      payloadptr, *length)));
                   break;
 
+               case Payload_block:
+                  payloadVec.push_back(move(make_unique<Payload_Block>(
+                     payloadptr, *length)));
+                  break;
+
                default:
                   payloadVec.push_back(move(make_unique<Payload_Unknown>(
                      payloadptr, *length)));
@@ -681,6 +687,22 @@ void Payload_Tx::deserialize(uint8_t* dataptr, size_t len)
    memcpy(&rawTx_[0], dataptr, len);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+size_t Payload_Block::serialize_inner(uint8_t* dataptr) const
+{
+   if (dataptr == nullptr)
+      return rawBlock_.getSize();
+
+   memcpy(dataptr, rawBlock_.getPtr(), rawBlock_.getSize());
+   return rawBlock_.getSize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Payload_Block::deserialize(uint8_t* dataptr, size_t len)
+{
+   rawBlock_ = BinaryData(dataptr, len);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 size_t Payload_Inv::serialize_inner(uint8_t* dataptr) const
 {
@@ -871,6 +893,13 @@ void BitcoinNodeInterface::registerGetTxCallback(
    getTxDataLambda_ = lbd;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BitcoinNodeInterface::registerBlockCallback(
+   const std::function<void(std::unique_ptr<Payload>)>& lbd)
+{
+   blockDataLambda_ = lbd;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BitcoinNodeInterface::processInvTx(vector<InvEntry> invVec)
 {
@@ -885,6 +914,20 @@ void BitcoinNodeInterface::processGetTx(unique_ptr<Payload> payload)
       getTxDataLambda_(move(payload));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BitcoinNodeInterface::processBlock(unique_ptr<Payload> payload)
+{
+   /*
+   Full block sent in reply to requestBlock. Hand it over to be parsed, then
+   signal the chain update as the block inv would have.
+   */
+
+   if (blockDataLambda_)
+      blockDataLambda_(move(payload));
+
+   processInvBlock(vector<InvEntry>());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BitcoinNodeInterface::requestTx(vector<InvEntry> invVec)
 {
@@ -903,6 +946,29 @@ void BitcoinNodeInterface::requestTx(vector<InvEntry> invVec)
    sendMessage(move(payload));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BitcoinNodeInterface::requestBlock(vector<InvEntry> invVec)
+{
+   /*
+   Send getdata payload to bitcoin node to request full blocks. Node reply
+   will be processed in processBlock
+   */
+
+   for (auto& entry : invVec)
+   {
+      if (entry.invtype_ != Inv_Msg_Block &&
+         entry.invtype_ != Inv_Msg_Witness_Block)
+         throw GetDataException("entry type isnt Inv_Msg_Block");
+
+      //witness data is part of the block as it is written to disk
+      if (isSegWit())
+         entry.invtype_ = Inv_Msg_Witness_Block;
+   }
+
+   auto payload = make_unique<Payload_GetData>(move(invVec));
+   sendMessage(move(payload));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////
 //// BitcoinP2P
@@ -1148,6 +1214,10 @@ void BitcoinP2P::processPayload(vector<unique_ptr<Payload>> payloadVec)
          processReject(move(payload));
          break;
 
+      case Payload_block:
+         processBlock(move(payload));
+         break;
+
       default:
          continue;
       }
@@ -1238,6 +1308,34 @@ void BitcoinP2P::processInv(unique_ptr<Payload> payload)
       case Inv_Msg_Witness_Block:
       case Inv_Msg_Block:
       {
+         if (blockDataLambda_)
+         {
+            //fetch the blocks, the chain update can run off of them
+            //without waiting on the blk files
+            requestBlock(entryVec.second);
+
+            /*
+            The block may be rejected, find the memory store full or never
+            come. Signal the chain update after the usual delay regardless,
+            it picks the blocks up from disk in that case. Delayed off of
+            this thread, it has the node's reply to process. The thread
+            holds on to the queue, not this object.
+            */
+            auto invBlockStack = invBlockStack_;
+            auto invVec = move(entryVec.second);
+            auto fallbackLambda = [invBlockStack, invVec](void)->void
+            {
+               this_thread::sleep_for(chrono::seconds(1));
+               if (invBlockStack != nullptr)
+                  invBlockStack->push_back(vector<InvEntry>(invVec));
+            };
+
+            thread fallbackThr(fallbackLambda);
+            if (fallbackThr.joinable())
+               fallbackThr.detach();
+            break;
+         }
+
          //1 sec delay to make sure data is written on disk
          this_thread::sleep_for(chrono::seconds(1));
          processInvBlock(move(entryVec.second));
@@ -59,6 +59,7 @@ enum PayloadType
    Payload_inv,
    Payload_getdata,
    Payload_reject,
+   Payload_block,
    Payload_unknown
 };
 
@@ -426,6 +427,32 @@ public:
    size_t getSize(void) const { return rawTx_.size(); }
 };
 
+////
+struct Payload_Block : public Payload
+{
+private:
+   BinaryData rawBlock_;
+
+private:
+   size_t serialize_inner(uint8_t*) const;
+
+public:
+   Payload_Block() {}
+
+   Payload_Block(uint8_t* dataptr, size_t len)
+   {
+      deserialize(dataptr, len);
+   }
+
+   void deserialize(uint8_t* dataptr, size_t len);
+
+   PayloadType type(void) const { return Payload_block; }
+   std::string typeStr(void) const { return "block"; }
+
+   const BinaryData& getRawBlock(void) const { return rawBlock_; }
+   BinaryData moveRawBlock(void) { return std::move(rawBlock_); }
+};
+
 ////reject
 class NodeUnitTest;
 struct Payload_Reject : public Payload
@@ -540,10 +567,12 @@ protected:
    //callback lambdas
    std::function<void(std::vector<InvEntry>&)> invTxLambda_;
    std::function<void(std::unique_ptr<Payload>)> getTxDataLambda_;
+   std::function<void(std::unique_ptr<Payload>)> blockDataLambda_;
    std::function<void(void)> nodeStatusLambda_;
 
 protected:
    void processGetTx(std::unique_ptr<Payload>);
+   void processBlock(std::unique_ptr<Payload>);
 
 public:
    struct getDataPayload
@@ -579,8 +608,11 @@ public:
    void registerNodeStatusLambda(std::function<void(void)> lbd);
    void registerGetTxCallback(
       const std::function<void(std::unique_ptr<Payload>)>&);
+   void registerBlockCallback(
+      const std::function<void(std::unique_ptr<Payload>)>&);
 
    void requestTx(std::vector<InvEntry>);
+   void requestBlock(std::vector<InvEntry>);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -95,6 +95,7 @@ void BlockDataViewer::scanWallets(shared_ptr<BDV_Notification> action)
          //reorg
          reorg = true;
          startBlock = reorgState.reorgBranchPoint_->getBlockHeight();
+         scanData.branchPoint_ = startBlock;
       }
       else
       {
@@ -421,6 +422,20 @@ vector<LedgerEntry> BlockDataViewer::getLockboxesHistoryPage(uint32_t pageId,
       updateID_, rebuildLedger, remapWallets);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+vector<LedgerEntry> BlockDataViewer::getWalletsHistoryFromCursor(
+   BinaryData& token, unsigned count)
+{
+   return groups_[group_wallet].getHistoryFromCursor(token, count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vector<LedgerEntry> BlockDataViewer::getLockboxesHistoryFromCursor(
+   BinaryData& token, unsigned count)
+{
+   return groups_[group_lockbox].getHistoryFromCursor(token, count);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockDataViewer::updateWalletsLedgerFilter(
    const vector<string>& walletsList)
@@ -528,7 +543,12 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForWallets()
    auto getPageCount = [this](void)->uint32_t
    { return this->getWalletsPageCount(); };
 
-   return LedgerDelegate(getHist, getBlock, getPageId, getPageCount);
+   auto getFromCursor = [this](BinaryData& token, unsigned count)->
+      vector<LedgerEntry>
+   { return this->getWalletsHistoryFromCursor(token, count); };
+
+   return LedgerDelegate(
+      getHist, getBlock, getPageId, getPageCount, getFromCursor);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -546,7 +566,12 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForLockboxes()
    auto getPageCount = [this](void)->uint32_t
    { return this->getLockboxesPageCount(); };
 
-   return LedgerDelegate(getHist, getBlock, getPageId, getPageCount);
+   auto getFromCursor = [this](BinaryData& token, unsigned count)->
+      vector<LedgerEntry>
+   { return this->getLockboxesHistoryFromCursor(token, count); };
+
+   return LedgerDelegate(
+      getHist, getBlock, getPageId, getPageCount, getFromCursor);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -801,46 +826,121 @@ unique_ptr<BDV_Notification_ZC> BlockDataViewer::createZcNotification(
    return notifPtr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+BinaryData OutpointQueryToken::serialize() const
+{
+   BinaryWriter bw;
+   bw.put_uint8_t(OUTPOINT_QUERY_TOKEN_VERSION);
+   bw.put_uint32_t(heightCutoff_);
+   bw.put_uint32_t(zcCutoff_);
+   bw.put_var_int(lastScrAddr_.getSize());
+   bw.put_BinaryData(lastScrAddr_);
+
+   return bw.getData();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+OutpointQueryToken OutpointQueryToken::deserialize(BinaryDataRef data)
+{
+   BinaryRefReader brr(data);
+   if (brr.get_uint8_t() != OUTPOINT_QUERY_TOKEN_VERSION)
+      throw runtime_error("invalid outpoint query token");
+
+   OutpointQueryToken token;
+   token.heightCutoff_ = brr.get_uint32_t();
+   token.zcCutoff_ = brr.get_uint32_t();
+
+   auto len = brr.get_var_int();
+   if (len == 0 || len > 33 || len != brr.getSizeRemaining())
+      throw runtime_error("invalid outpoint query token");
+   token.lastScrAddr_ = brr.get_BinaryData(len);
+
+   return token;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 map<BinaryData, map<BinaryData, map<unsigned, OpData>>>
 BlockDataViewer::getAddressOutpoints(
    const std::set<BinaryDataRef>& scrAddrSet, 
    unsigned& heightCutoff, unsigned& zcCutoff) const
 {
-   /*wallet agnostic method*/
+   BinaryData token;
+   return getAddressOutpoints(
+      scrAddrSet, heightCutoff, zcCutoff, token, UINT32_MAX);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+map<BinaryData, map<BinaryData, map<unsigned, OpData>>>
+BlockDataViewer::getAddressOutpoints(
+   const std::set<BinaryDataRef>& scrAddrSet, 
+   unsigned& heightCutoff, unsigned& zcCutoff,
+   BinaryData& token, unsigned pageSize) const
+{
+   /*
+   wallet agnostic method
+
+   Pages end on an address boundary, once the addresses covered so far carry 
+   at least pageSize txios. The token carries the position and the cutoffs of
+   the first page: the last page hands those back, so that the next query
+   covers whatever landed while the pages were being fetched.
+   */
 
-   auto topHeight = getTopBlockHeader()->getBlockHeight();
    map<BinaryData, map<BinaryData, map<unsigned, OpData>>> outpointMap;
 
+   OutpointQueryToken state;
+   if (token.empty())
+   {
+      state.heightCutoff_ = getTopBlockHeader()->getBlockHeight();
+      state.zcCutoff_ = zcCutoff;
+
+      auto zcSnapshot = zc_->getSnapshot();
+      if (zcSnapshot != nullptr)
+         state.zcCutoff_ = zcSnapshot->getTopZcID();
+   }
+   else
+   {
+      state = OutpointQueryToken::deserialize(token);
+   }
+
+   auto pageBegin = scrAddrSet.begin();
+   if (!state.lastScrAddr_.empty())
+      pageBegin = scrAddrSet.upper_bound(state.lastScrAddr_.getRef());
+   auto pageEnd = scrAddrSet.end();
+
    //confirmed outputs, skip is heightCutoff is UINT32_MAX
    if (heightCutoff != UINT32_MAX)
    {
-      for (auto& scrAddr : scrAddrSet)
-      {
-         StoredScriptHistory ssh;
-         if (!db_->getStoredScriptHistory(ssh, scrAddr, heightCutoff))
-            continue;
-
-         if (ssh.subHistMap_.empty())
-            continue;
+      auto sshMap = db_->getStoredScriptHistoryBatch(
+         pageBegin, scrAddrSet.end(), heightCutoff, pageSize);
 
-         auto firstPairIter = outpointMap.insert(
-            make_pair(scrAddr, map<BinaryData, map<unsigned, OpData>>()));
+      /*
+      Run decrementally to process spent txios first and ignore the
+      younger, unspent counterparts. Collect the keys to resolve along the 
+      way, then resolve them in key order.
+      */
 
-         auto& opMap = firstPairIter.first->second;
+      struct OutpointEntry
+      {
+         BinaryDataRef scrAddr_;
+         BinaryData outputKey_;
+         const TxIOPair* txio_;
+      };
 
-         /*
-         Run decrementally to process spent txios first and ignore the
-         younger, unspent counterparts.
-         */
+      vector<OutpointEntry> entries;
+      map<BinaryData, StoredTxOut> stxoMap;
+      map<BinaryData, BinaryData> txHashMap;
+      size_t txioCount = 0;
 
+      for (auto& sshPair : sshMap)
+      {
          set<BinaryData> processedKeys;
-         auto rIter = ssh.subHistMap_.rbegin();
-         while (rIter != ssh.subHistMap_.rend())
+         auto rIter = sshPair.second.subHistMap_.rbegin();
+         while (rIter != sshPair.second.subHistMap_.rend())
          {
-            auto& subssh = rIter->second;
-            for (auto& txioPair : subssh.txioMap_)
+            for (auto& txioPair : rIter->second.txioMap_)
             {
+               ++txioCount;
+
                //keep track of processed txios by their output key, 
                //skip if already in set
                auto&& txOutKey = txioPair.second.getDBKeyOfOutput();
@@ -848,39 +948,88 @@ BlockDataViewer::getAddressOutpoints(
                if (!insertIter.second)
                   continue;
 
-               StoredTxOut stxo;
-               if (!db_->getStoredTxOut(stxo, txioPair.second.getDBKeyOfOutput()))
-                  throw runtime_error("failed to grab txout");
-
-               auto&& txHash = txioPair.second.getTxHashOfOutput(db_);
-               auto secondPairIter = opMap.find(txHash);
-               if (secondPairIter == opMap.end())
+               stxoMap.emplace(txOutKey, StoredTxOut());
+               txHashMap.emplace(txOutKey.getSliceCopy(0, 6), BinaryData());
+               if (txioPair.second.hasTxIn())
                {
-                  secondPairIter = opMap.insert(
-                     make_pair(txHash, map<unsigned, OpData>())).first;
+                  txHashMap.emplace(
+                     txioPair.second.getTxRefOfInput().getDBKey(), 
+                     BinaryData());
                }
 
-               auto& idMap = secondPairIter->second;
+               entries.push_back(
+                  { sshPair.first, move(txOutKey), &txioPair.second });
+            }
 
-               OpData opdata;
-               opdata.height_ = stxo.getHeight();
-               opdata.txindex_ = stxo.txIndex_;
-               opdata.value_ = stxo.getValue();
-               opdata.isspent_ = stxo.isSpent();
+            ++rIter;
+         }
+      }
 
-               //if the output is spent, set the spender hash
-               if (stxo.isSpent())
-                  opdata.spenderHash_ = txioPair.second.getTxHashOfInput(db_);
+      //this page is the last one unless the budget ran out
+      if (txioCount >= pageSize && !sshMap.empty())
+         pageEnd = scrAddrSet.upper_bound(sshMap.rbegin()->first);
 
-               idMap.insert(make_pair((unsigned)stxo.txOutIndex_, move(opdata)));
-            }
+      {
+         auto stxoTx = db_->beginTransaction(STXO, LMDB::ReadOnly);
+         for (auto& stxoPair : stxoMap)
+         {
+            if (!db_->getStoredTxOut(stxoPair.second, stxoPair.first))
+               throw runtime_error("failed to grab txout");
+         }
+      }
 
-            ++rIter;
+      {
+         unique_ptr<DbTransaction> hintsTx;
+         if (db_->getDbType() != ARMORY_DB_SUPER)
+            hintsTx = db_->beginTransaction(TXHINTS, LMDB::ReadOnly);
+
+         for (auto& hashPair : txHashMap)
+            hashPair.second = db_->getTxHashForLdbKey(hashPair.first);
+      }
+
+      for (auto& entry : entries)
+      {
+         auto& stxo = stxoMap[entry.outputKey_];
+         auto& txHash = txHashMap[entry.outputKey_.getSliceRef(0, 6)];
+
+         auto& opMap = outpointMap[entry.scrAddr_];
+         auto& idMap = opMap[txHash];
+
+         OpData opdata;
+         opdata.height_ = stxo.getHeight();
+         opdata.txindex_ = stxo.txIndex_;
+         opdata.value_ = stxo.getValue();
+         opdata.isspent_ = stxo.isSpent();
+
+         //if the output is spent, set the spender hash
+         if (stxo.isSpent())
+         {
+            if (entry.txio_->hasTxIn())
+            {
+               opdata.spenderHash_ = txHashMap[
+                  entry.txio_->getTxRefOfInput().getDBKey()];
+            }
+            else
+            {
+               opdata.spenderHash_ = BtcUtils::EmptyHash();
+            }
          }
+
+         idMap.insert(make_pair((unsigned)stxo.txOutIndex_, move(opdata)));
       }
+   }
 
-      //update height cutoff
-      heightCutoff = topHeight;
+   //hand back the cutoffs once the last page is out
+   if (pageEnd == scrAddrSet.end())
+   {
+      token.clear();
+      if (heightCutoff != UINT32_MAX)
+         heightCutoff = state.heightCutoff_;
+   }
+   else
+   {
+      state.lastScrAddr_ = *prev(pageEnd);
+      token = state.serialize();
    }
 
    //zc outpoints, skip if zcCutoff is UINT32_MAX
@@ -890,8 +1039,10 @@ BlockDataViewer::getAddressOutpoints(
       if (zcSnapshot == nullptr)
          return outpointMap;
          
-      for (auto& scrAddr : scrAddrSet)
+      for (auto addrIter = pageBegin; addrIter != pageEnd; ++addrIter)
       {
+         auto& scrAddr = *addrIter;
+
          //NOTE: getTxioMapForScrAddr is semi expensive
          auto txioMapFromSS = zcSnapshot->getTxioMapForScrAddr(scrAddr);
          for (auto& txiopair : txioMapFromSS)
@@ -1004,7 +1155,8 @@ BlockDataViewer::getAddressOutpoints(
       }
 
       //update zc id cutoff
-      zcCutoff = zcSnapshot->getTopZcID();
+      if (token.empty())
+         zcCutoff = state.zcCutoff_;
    }
 
    return outpointMap;
@@ -1016,62 +1168,154 @@ vector<UTXO> BlockDataViewer::getUtxosForAddress(
 {
    /*wallet agnostic method*/
 
-   vector<UTXO> result;
+   set<BinaryDataRef> scrAddrSet;
+   scrAddrSet.insert(scrAddr);
+
+   auto&& utxoMap = getUtxosForAddresses(scrAddrSet, withZc);
+   auto iter = utxoMap.find(scrAddr);
+   if (iter == utxoMap.end())
+      return vector<UTXO>();
+
+   return move(iter->second);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+map<BinaryData, vector<UTXO>> BlockDataViewer::getUtxosForAddresses(
+   const set<BinaryDataRef>& scrAddrSet, bool withZc) const
+{
+   /*
+   wallet agnostic method
+
+   Same sorted SSH/SUBSSH sweep as getAddressOutpoints. The txouts and their
+   tx hashes are then resolved in key order, each under a single read 
+   transaction, instead of one seek per txio and per address.
+   */
+
+   map<BinaryData, vector<UTXO>> result;
 
    //mined utxos
-   StoredScriptHistory ssh;
-   if (db_->getStoredScriptHistory(ssh, scrAddr))
+   auto sshMap = db_->getStoredScriptHistoryBatch(
+      scrAddrSet.begin(), scrAddrSet.end());
+
+   bool isSuper = db_->getDbType() == ARMORY_DB_SUPER;
+   if (isSuper)
+   {
+      //spentness lives in its own db, flag the txios from there
+      auto spentnessTx = db_->beginTransaction(SPENTNESS, LMDB::ReadOnly);
+      for (auto& sshPair : sshMap)
+         db_->getUTXOflags(sshPair.second.subHistMap_);
+   }
+
+   struct UtxoEntry
    {
-      for (auto& subssh : ssh.subHistMap_)
+      BinaryDataRef scrAddr_;
+      BinaryData outputKey_;
+   };
+
+   vector<UtxoEntry> entries;
+   map<BinaryData, StoredTxOut> stxoMap;
+   map<BinaryData, BinaryData> txHashMap;
+
+   for (auto& sshPair : sshMap)
+   {
+      for (auto& subssh : sshPair.second.subHistMap_)
       {
          for (auto& txioPair : subssh.second.txioMap_)
          {
-            if (!txioPair.second.isUTXO())
+            auto& txio = txioPair.second;
+            if (txio.hasTxIn() || (isSuper && !txio.isUTXO()))
                continue;
 
-            StoredTxOut stxo;
-            if (!db_->getStoredTxOut(stxo, txioPair.second.getDBKeyOfOutput()))
-               throw runtime_error("failed to grab txout");
-
-            auto&& txHash = txioPair.second.getTxHashOfOutput(db_);
-            UTXO utxo(stxo.getValue(), stxo.getHeight(), stxo.txIndex_, 
-               stxo.txOutIndex_, txHash, stxo.getScriptRef());
+            auto&& txOutKey = txio.getDBKeyOfOutput();
+            stxoMap.emplace(txOutKey, StoredTxOut());
+            txHashMap.emplace(txOutKey.getSliceCopy(0, 6), BinaryData());
+            entries.push_back({ sshPair.first, move(txOutKey) });
+         }
+      }
+   }
 
-            result.emplace_back(utxo);
+   {
+      auto stxoTx = db_->beginTransaction(STXO, LMDB::ReadOnly);
+      auto iter = stxoMap.begin();
+      while (iter != stxoMap.end())
+      {
+         if (db_->getStoredTxOut(iter->second, iter->first))
+         {
+            ++iter;
+            continue;
          }
+
+         //flagged unspent but missing
+         if (isSuper)
+            throw runtime_error("failed to grab txout");
+
+         //same as getUTXOflags: no txout, not a utxo
+         stxoMap.erase(iter++);
       }
    }
 
+   {
+      unique_ptr<DbTransaction> hintsTx;
+      if (!isSuper)
+         hintsTx = db_->beginTransaction(TXHINTS, LMDB::ReadOnly);
+
+      for (auto& hashPair : txHashMap)
+         hashPair.second = db_->getTxHashForLdbKey(hashPair.first);
+   }
+
+   for (auto& entry : entries)
+   {
+      auto stxoIter = stxoMap.find(entry.outputKey_);
+      if (stxoIter == stxoMap.end())
+         continue;
+
+      auto& stxo = stxoIter->second;
+      if (!isSuper && stxo.spentness_ != TXOUT_UNSPENT)
+         continue;
+
+      auto& txHash = txHashMap[entry.outputKey_.getSliceRef(0, 6)];
+      UTXO utxo(stxo.getValue(), stxo.getHeight(), stxo.txIndex_, 
+         stxo.txOutIndex_, txHash, stxo.getScriptRef());
+
+      result[entry.scrAddr_].emplace_back(utxo);
+   }
+
    if (!withZc)
       return result;
 
    //zc utxos
    auto zcSnapshot = zc_->getSnapshot();
-   auto txioMapFromSS = zcSnapshot->getTxioMapForScrAddr(scrAddr);
+   if (zcSnapshot == nullptr)
+      return result;
 
-   for (auto& txiopair : txioMapFromSS)
+   for (auto& scrAddr : scrAddrSet)
    {
-      //grab txoutref, useful in all but 1 case
-      auto&& txOutRef = txiopair.second->getTxRefOfOutput();
+      auto txioMapFromSS = zcSnapshot->getTxioMapForScrAddr(scrAddr);
 
-      //does this txio have a zc txin, txout or both?
-      if (txiopair.second->hasTxInZC())
-         continue;
+      for (auto& txiopair : txioMapFromSS)
+      {
+         //grab txoutref, useful in all but 1 case
+         auto&& txOutRef = txiopair.second->getTxRefOfOutput();
 
-      //zc txout, grab from snapshot
-      auto txFromSS = zcSnapshot->getTxByKey(txOutRef.getDBKey());
-      if (txFromSS == nullptr)
-         throw runtime_error("can't find zc tx by txiopair output key");
+         //does this txio have a zc txin, txout or both?
+         if (txiopair.second->hasTxInZC())
+            continue;
+
+         //zc txout, grab from snapshot
+         auto txFromSS = zcSnapshot->getTxByKey(txOutRef.getDBKey());
+         if (txFromSS == nullptr)
+            throw runtime_error("can't find zc tx by txiopair output key");
 
-      auto& txHash = txFromSS->getTxHash();
-      auto outputIndex = txiopair.second->getIndexOfOutput();
-      const auto& parsedTxOut = txFromSS->outputs_[outputIndex];
+         auto& txHash = txFromSS->getTxHash();
+         auto outputIndex = txiopair.second->getIndexOfOutput();
+         const auto& parsedTxOut = txFromSS->outputs_[outputIndex];
 
-      //some of these copies can be easily avoided
-      auto&& txOutCopy = txFromSS->tx_.getTxOutCopy(outputIndex);
-      UTXO utxo(parsedTxOut.value_, UINT32_MAX, UINT32_MAX,
-         outputIndex, txHash, txOutCopy.getScript());
-      result.emplace_back(utxo);
+         //some of these copies can be easily avoided
+         auto&& txOutCopy = txFromSS->tx_.getTxOutCopy(outputIndex);
+         UTXO utxo(parsedTxOut.value_, UINT32_MAX, UINT32_MAX,
+            outputIndex, txHash, txOutCopy.getScript());
+         result[scrAddr].emplace_back(utxo);
+      }
    }
 
    return result;
@@ -1294,12 +1538,46 @@ void WalletGroup::registerAddresses(
    batch->scrAddrSet_ = move(scrAddrSet);
    batch->msg_ = msg;
    batch->isNew_ = msg->flag();
+   batch->walletID_ = walletID;
    batch->callback_ = callback;
+   setBirthHeights(*batch, *msg);
 
    saf_->pushAddressBatch(batch);
    theWallet->resetCounters();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void WalletGroup::setBirthHeights(RegistrationBatch& batch,
+   const ::Codec_BDVCommand::BDVCommand& msg)
+{
+   /*
+   The command height is the wallet wide birth height, birthHeights 
+   optionally carries one entry per address in binData. Both are resolved
+   per address so that commands for several wallets can share a batch.
+   */
+
+   bool perAddress = msg.birthheights_size() > 0;
+   if (perAddress && msg.birthheights_size() != msg.bindata_size())
+   {
+      LOGWARN << "birth heights do not match registered addresses, ignoring";
+      perAddress = false;
+   }
+
+   if (!perAddress && !msg.has_height())
+      return;
+
+   for (int i = 0; i < msg.bindata_size(); i++)
+   {
+      auto& scrAddr = msg.bindata(i);
+      if (scrAddr.empty())
+         continue;
+
+      BinaryDataRef scrAddrRef; scrAddrRef.setRef(scrAddr);
+      batch.addrBirthHeights_[scrAddrRef] = perAddress ?
+         msg.birthheights(i) : msg.height();
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool WalletGroup::hasID(const string& ID) const
 {
@@ -1419,10 +1697,8 @@ vector<LedgerEntry> WalletGroup::getHistoryPage(
          unsigned i = 0;
          for (auto& wlt_pair : localWalletMap)
          {
-            auto&& txio_map = wlt_pair.second->getTxioForRange(
+            auto&& ledgerMap = wlt_pair.second->getLedgersForRange(
                startBlock, endBlock);
-            auto&& ledgerMap = wlt_pair.second->updateWalletLedgersFromTxio(
-               txio_map, startBlock, endBlock);
 
             for (auto& ledger : ledgerMap)
             {
@@ -1460,6 +1736,44 @@ vector<LedgerEntry> WalletGroup::getHistoryPage(
    return vle;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+vector<LedgerEntry> WalletGroup::getHistoryFromCursor(
+   BinaryData& token, unsigned count)
+{
+   unique_lock<mutex> mu(globalLedgerLock_);
+   ReadWriteLock::ReadLock rl(lock_);
+
+   map<string, shared_ptr<BtcWallet>> localWalletMap;
+   for (auto& wlt_pair : wallets_)
+   {
+      if (wlt_pair.second->uiFilter_)
+         localWalletMap.insert(wlt_pair);
+   }
+
+   auto getLedgers = [&localWalletMap](
+      uint32_t start, uint32_t end)->map<BinaryData, LedgerEntry>
+   {
+      //wallets can share a tx, key on a counter to keep all entries
+      map<BinaryData, LedgerEntry> result;
+      unsigned i = 0;
+      for (auto& wlt_pair : localWalletMap)
+      {
+         auto&& ledgerMap = wlt_pair.second->getLedgersForRange(start, end);
+         for (auto& ledger : ledgerMap)
+         {
+            BinaryWriter bw;
+            bw.put_uint32_t(i++);
+            result.insert(make_pair(bw.getData(), move(ledger.second)));
+         }
+      }
+
+      return result;
+   };
+
+   return HistoryPager::getPageFromCursor(token, count,
+      hist_.getSSHsummary(), &bdvPtr_->blockchain(), getLedgers);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void WalletGroup::updateLedgerFilter(const vector<string>& walletsList)
 {
@@ -59,6 +59,21 @@ struct OpData
    BinaryData spenderHash_;
 };
 
+#define OUTPOINT_QUERY_TOKEN_VERSION 1
+#define OUTPOINT_QUERY_PAGE_SIZE 50000
+
+////
+struct OutpointQueryToken
+{
+   //resume point and the cutoffs the last page hands back
+   unsigned heightCutoff_ = UINT32_MAX;
+   unsigned zcCutoff_ = UINT32_MAX;
+   BinaryData lastScrAddr_;
+
+   BinaryData serialize(void) const;
+   static OutpointQueryToken deserialize(BinaryDataRef);
+};
+
 class BlockDataViewer
 {
 public:
@@ -116,6 +131,11 @@ public:
       bool rebuildLedger,
       bool remapWallets);
 
+   std::vector<LedgerEntry> getWalletsHistoryFromCursor(
+      BinaryData& token, unsigned);
+   std::vector<LedgerEntry> getLockboxesHistoryFromCursor(
+      BinaryData& token, unsigned);
+
    virtual void flagRefresh(
       BDV_refresh refresh, const BinaryData& refreshId,
       std::unique_ptr<BDV_Notification_ZC> zcPtr) = 0;
@@ -206,10 +226,17 @@ public:
 
    //wallet agnostic methods
    std::vector<UTXO> getUtxosForAddress(const BinaryDataRef&, bool) const;
+   std::map<BinaryData, std::vector<UTXO>> getUtxosForAddresses(
+      const std::set<BinaryDataRef>&, bool) const;
    std::map<BinaryData, std::map<BinaryData, std::map<unsigned, OpData>>>
       getAddressOutpoints(const std::set<BinaryDataRef>&, 
          unsigned&, unsigned&) const;
 
+   //paged, token is empty on the first call and once all pages are out
+   std::map<BinaryData, std::map<BinaryData, std::map<unsigned, OpData>>>
+      getAddressOutpoints(const std::set<BinaryDataRef>&, 
+         unsigned&, unsigned&, BinaryData& token, unsigned pageSize) const;
+
    std::vector<std::pair<StoredTxOut, BinaryDataRef>> getOutputsForOutpoints(
       const std::map<BinaryDataRef, std::set<unsigned>>&, bool) const;
 
@@ -268,6 +295,10 @@ public:
    void registerAddresses(std::shared_ptr<::Codec_BDVCommand::BDVCommand>);
    void unregisterWallet(const std::string& IDstr);
 
+   //birth heights from a registration command, per address
+   static void setBirthHeights(RegistrationBatch&,
+      const ::Codec_BDVCommand::BDVCommand&);
+
    bool hasID(const std::string &ID) const;
    std::shared_ptr<BtcWallet> getWalletByID(const std::string& ID) const;
 
@@ -276,6 +307,7 @@ public:
    size_t getPageCount(void) const { return hist_.getPageCount(); }
    std::vector<LedgerEntry> getHistoryPage(uint32_t pageId, unsigned updateID,
       bool rebuildLedger, bool remapWallets);
+   std::vector<LedgerEntry> getHistoryFromCursor(BinaryData& token, unsigned);
 
 private:   
    std::map<uint32_t, uint32_t> computeWalletsSSHSummary(
@@ -160,8 +160,7 @@ shared_ptr<BlockHeader> BlockData::createBlockHeader() const
    bh.numBlockBytes_ = size_;
    bh.numTx_ = txns_.size();
 
-   bh.blkFileNum_ = fileID_;
-   bh.blkFileOffset_ = offset_;
+   bh.filePos_.set(fileID_, offset_);
    bh.thisHash_ = blockHash_;
    bh.uniqueID_ = uniqueID_;
 
@@ -217,10 +216,38 @@ shared_ptr<BlockDataFileMap> BlockDataLoader::get(const string& filename)
 /////////////////////////////////////////////////////////////////////////////
 shared_ptr<BlockDataFileMap> BlockDataLoader::get(uint32_t fileid)
 {
+   //blocks that aren't in the blk files yet
+   if (MemoryBlockStore::isMemoryFileID(fileid))
+      return MemoryBlockStore::shared().get(fileid);
+
    //don't have this fileid yet, create it
    return getNewBlockDataMap(fileid);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockDataFileMap> BlockDataLoader::getForHeader(
+   const BlockHeader& header, uint64_t& offset)
+{
+   //An in-memory block is released once its header points at the blk
+   //file. Missing it means the header moved, read it again.
+   for (unsigned i = 0; i < 2; i++)
+   {
+      auto pos = header.getBlockFilePos();
+      auto fileMap = get(pos.fileNum_);
+      if (fileMap->getPtr() != nullptr && pos.offset_ <= fileMap->size() &&
+         header.getBlockSize() <= fileMap->size() - pos.offset_)
+      {
+         offset = pos.offset_;
+         return fileMap;
+      }
+
+      if (!MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+         break;
+   }
+
+   throw runtime_error("missing block data");
+}
+
 /////////////////////////////////////////////////////////////////////////////
 uint32_t BlockDataLoader::nameToIntID(const string& filename)
 {
@@ -272,11 +299,24 @@ BlockDataFileMap::BlockDataFileMap(const string& filename)
    }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BlockDataFileMap::BlockDataFileMap(BinaryData&& data) :
+   memoryData_(move(data))
+{
+   useCounter_.store(0, memory_order_relaxed);
+
+   if (memoryData_.getSize() == 0)
+      return;
+
+   fileMap_ = memoryData_.getPtr();
+   size_ = memoryData_.getSize();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 BlockDataFileMap::~BlockDataFileMap()
 {
    //close file mmap
-   if (fileMap_ != nullptr)
+   if (fileMap_ != nullptr && memoryData_.getSize() == 0)
    {
 #ifdef _WIN32
       UnmapViewOfFile(fileMap_);
@@ -286,3 +326,96 @@ BlockDataFileMap::~BlockDataFileMap()
       fileMap_ = nullptr;
    }
 }
+
+/////////////////////////////////////////////////////////////////////////////
+////
+//// MemoryBlockStore
+////
+/////////////////////////////////////////////////////////////////////////////
+uint32_t MemoryBlockStore::add(BinaryData rawBlock,
+   function<unsigned int(const BinaryData&)> getID)
+{
+   Entry entry;
+   entry.fileMap_ = make_shared<BlockDataFileMap>(move(rawBlock));
+   if (entry.fileMap_->getPtr() == nullptr)
+      return UINT32_MAX;
+
+   try
+   {
+      entry.blockData_ = BlockData::deserialize(
+         entry.fileMap_->getPtr(), entry.fileMap_->size(),
+         nullptr, getID, BlockData::CheckHashes::TxFilters);
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "invalid block from node: " << e.what();
+      return UINT32_MAX;
+   }
+
+   unique_lock<mutex> lock(mu_);
+   if (hashToFileID_.find(entry.blockData_->getHash()) != hashToFileID_.end())
+      return UINT32_MAX;
+
+   //past this, blocks wait on the blk files as usual
+   if (blocks_.size() >= MEMORY_BLOCK_MAX_COUNT)
+      return UINT32_MAX;
+
+   auto fileID = nextFileID_++;
+   entry.blockData_->setFileID(fileID);
+   entry.blockData_->setOffset(0);
+
+   hashToFileID_.emplace(entry.blockData_->getHash(), fileID);
+   blocks_.emplace(fileID, move(entry));
+   return fileID;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockDataFileMap> MemoryBlockStore::get(uint32_t fileID) const
+{
+   {
+      unique_lock<mutex> lock(mu_);
+      auto iter = blocks_.find(fileID);
+      if (iter != blocks_.end())
+         return iter->second.fileMap_;
+   }
+
+   return make_shared<BlockDataFileMap>(BinaryData());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+map<uint32_t, shared_ptr<BlockData>> MemoryBlockStore::getBlocks() const
+{
+   map<uint32_t, shared_ptr<BlockData>> result;
+
+   unique_lock<mutex> lock(mu_);
+   for (auto& block : blocks_)
+      result.emplace(block.first, block.second.blockData_);
+
+   return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void MemoryBlockStore::remove(const BinaryData& hash)
+{
+   unique_lock<mutex> lock(mu_);
+   auto iter = hashToFileID_.find(hash);
+   if (iter == hashToFileID_.end())
+      return;
+
+   blocks_.erase(iter->second);
+   hashToFileID_.erase(iter);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+size_t MemoryBlockStore::count() const
+{
+   unique_lock<mutex> lock(mu_);
+   return blocks_.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+MemoryBlockStore& MemoryBlockStore::shared()
+{
+   static MemoryBlockStore store;
+   return store;
+}
@@ -24,11 +24,18 @@
 #include <iomanip>
 
 #include <map>
+#include <functional>
 
 #include "BlockObj.h"
 #include "BinaryData.h"
 
 #define OffsetAndSize std::pair<size_t, size_t>
+
+//file ids for blocks received from the node ahead of the blk files, past
+//the range BlockFiles scans for and the 16 bit file ids the HEADERS db
+//stores, so that they can't be persisted
+#define MEMORY_BLOCK_FILE_ID_BASE 0x10000U
+#define MEMORY_BLOCK_MAX_COUNT 16
 struct BlockHashVector;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -199,6 +206,10 @@ private:
 
    BinaryData blockHash_;
 
+   //what data_ points into, for blocks read into buffers rather than
+   //mapped with their file
+   std::shared_ptr<const void> dataOwner_;
+
 public:
    enum class CheckHashes
    {
@@ -240,6 +251,10 @@ public:
    void setFileID(unsigned fileid) { fileID_ = fileid; }
    void setOffset(size_t offset) { offset_ = offset; }
 
+   //holds on to the data's owner for as long as this block lives
+   void borrow(std::shared_ptr<const void> owner)
+   { dataOwner_ = std::move(owner); }
+
    std::shared_ptr<BlockHeader> createBlockHeader(void) const;
    const BinaryData& getHash(void) const { return blockHash_; }
 
@@ -312,10 +327,14 @@ private:
    uint8_t* fileMap_ = nullptr;
    size_t size_ = 0;
 
+   //backs the map in place of a file for in-memory blocks
+   BinaryData memoryData_;
+
    std::atomic<int> useCounter_;
 
 public:
    BlockDataFileMap(const std::string& filename);
+   BlockDataFileMap(BinaryData&& data);
    ~BlockDataFileMap(void);
 
    const uint8_t* getPtr() const
@@ -351,6 +370,61 @@ public:
 
    std::shared_ptr<BlockDataFileMap> get(const std::string& filename);
    std::shared_ptr<BlockDataFileMap> get(uint32_t fileid);
+
+   //Map holding the header's block, offset is set to the block's position
+   //in it. Follows blocks moved from memory to their blk file. Throws if
+   //the block data isn't available.
+   std::shared_ptr<BlockDataFileMap> getForHeader(
+      const BlockHeader&, uint64_t& offset);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+class MemoryBlockStore
+{
+   /***
+   Blocks the node sent over p2p, parsed as they come in so that the chain
+   update doesn't have to wait on them to hit the blk files.
+
+   Each block is given its own file id, starting at MEMORY_BLOCK_FILE_ID_BASE
+   and never reused. BlockDataLoader serves that id as a file holding the
+   block alone at offset 0. Once the blk file parser comes across the block
+   on disk, its header is moved to the blk file position and the block is
+   released.
+   ***/
+
+private:
+   struct Entry
+   {
+      std::shared_ptr<BlockDataFileMap> fileMap_;
+      std::shared_ptr<BlockData> blockData_;
+   };
+
+   mutable std::mutex mu_;
+   std::map<uint32_t, Entry> blocks_;
+   std::map<BinaryData, uint32_t> hashToFileID_;
+   uint32_t nextFileID_ = MEMORY_BLOCK_FILE_ID_BASE;
+
+public:
+   //Parses and checks the merkle root of a raw block, getID assigns its
+   //unique id. Returns the block's file id, UINT32_MAX if the block is
+   //invalid, already held or the store is full
+   uint32_t add(BinaryData rawBlock,
+      std::function<unsigned int(const BinaryData&)> getID);
+
+   //empty map if the block was released
+   std::shared_ptr<BlockDataFileMap> get(uint32_t fileID) const;
+
+   //parsed blocks by file id, the data stays valid until remove()
+   std::map<uint32_t, std::shared_ptr<BlockData>> getBlocks(void) const;
+
+   void remove(const BinaryData& hash);
+   size_t count(void) const;
+
+   static bool isMemoryFileID(uint32_t fileID)
+   { return fileID >= MEMORY_BLOCK_FILE_ID_BASE; }
+
+   //process wide instance, shared by all BlockDataLoaders
+   static MemoryBlockStore& shared(void);
 };
 
 #endif
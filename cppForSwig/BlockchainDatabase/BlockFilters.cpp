@@ -0,0 +1,369 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "BlockFilters.h"
+#include "BlockDataMap.h"
+#include "TxOutScrRef.h"
+
+using namespace std;
+
+namespace
+{
+   /////////////////////////////////////////////////////////////////////////////
+   uint64_t mulHigh(uint64_t a, uint64_t b)
+   {
+#if defined(__SIZEOF_INT128__)
+      return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+      uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+      uint64_t bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+
+      uint64_t lolo = aLo * bLo;
+      uint64_t hilo = aHi * bLo;
+      uint64_t lohi = aLo * bHi;
+      uint64_t hihi = aHi * bHi;
+
+      uint64_t mid = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+      return hihi + (hilo >> 32) + (mid >> 32);
+#endif
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   inline uint64_t rotl(uint64_t x, int b)
+   {
+      return (x << b) | (x >> (64 - b));
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   class BitWriter
+   {
+   private:
+      BinaryWriter bw_;
+      uint8_t accum_ = 0;
+      unsigned nbits_ = 0;
+
+   public:
+      void write(uint64_t val, unsigned bits)
+      {
+         while (bits > 0)
+         {
+            unsigned take = min(8 - nbits_, bits);
+            uint8_t chunk = (val >> (bits - take)) & ((1U << take) - 1);
+            accum_ |= chunk << (8 - nbits_ - take);
+
+            nbits_ += take;
+            bits -= take;
+
+            if (nbits_ == 8)
+            {
+               bw_.put_uint8_t(accum_);
+               accum_ = 0;
+               nbits_ = 0;
+            }
+         }
+      }
+
+      void golombEncode(uint64_t val)
+      {
+         auto q = val >> GCS_FILTER_P;
+         while (q >= 32)
+         {
+            write(UINT32_MAX, 32);
+            q -= 32;
+         }
+
+         //q ones followed by a zero
+         write(((1ULL << q) - 1) << 1, q + 1);
+         write(val, GCS_FILTER_P);
+      }
+
+      BinaryData finish(void)
+      {
+         if (nbits_ > 0)
+         {
+            bw_.put_uint8_t(accum_);
+            accum_ = 0;
+            nbits_ = 0;
+         }
+
+         return bw_.getData();
+      }
+   };
+
+   /////////////////////////////////////////////////////////////////////////////
+   class BitReader
+   {
+   private:
+      const uint8_t* ptr_;
+      const size_t size_;
+      size_t pos_ = 0;
+
+   public:
+      BitReader(BinaryDataRef bdr) :
+         ptr_(bdr.getPtr()), size_(bdr.getSize())
+      {}
+
+      unsigned readBit(void)
+      {
+         if ((pos_ >> 3) >= size_)
+            throw BlockFilterException("filter stream overrun");
+
+         auto bit = (ptr_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1;
+         ++pos_;
+         return bit;
+      }
+
+      uint64_t readBits(unsigned bits)
+      {
+         uint64_t val = 0;
+         while (bits > 0)
+         {
+            if ((pos_ >> 3) >= size_)
+               throw BlockFilterException("filter stream overrun");
+
+            unsigned offset = pos_ & 7;
+            unsigned take = min(8 - offset, bits);
+            uint8_t byte = ptr_[pos_ >> 3];
+            uint8_t chunk = (byte >> (8 - offset - take)) & ((1U << take) - 1);
+
+            val = (val << take) | chunk;
+            pos_ += take;
+            bits -= take;
+         }
+
+         return val;
+      }
+
+      uint64_t golombDecode(void)
+      {
+         uint64_t q = 0;
+         while (readBit() == 1)
+            ++q;
+
+         return (q << GCS_FILTER_P) | readBits(GCS_FILTER_P);
+      }
+   };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////GolombFilter
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+GolombFilter::GolombFilter(BinaryDataRef blockHash, vector<BinaryData> elements)
+{
+   setKey(blockHash);
+
+   sort(elements.begin(), elements.end());
+   elements.erase(
+      unique(elements.begin(), elements.end()), elements.end());
+
+   if (elements.size() >= UINT32_MAX)
+      throw BlockFilterException("too many filter elements");
+
+   n_ = elements.size();
+   f_ = n_ * GCS_FILTER_M;
+
+   vector<uint64_t> values;
+   values.reserve(n_);
+   for (auto& element : elements)
+      values.push_back(hashToRange(element.getRef()));
+   sort(values.begin(), values.end());
+
+   BitWriter writer;
+   uint64_t last = 0;
+   for (auto& val : values)
+   {
+      writer.golombEncode(val - last);
+      last = val;
+   }
+
+   data_ = writer.finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+GolombFilter::GolombFilter(BinaryDataRef blockHash, BinaryDataRef serialized)
+{
+   setKey(blockHash);
+
+   BinaryRefReader brr(serialized);
+   if (brr.getSizeRemaining() == 0)
+      throw BlockFilterException("empty filter");
+
+   auto count = brr.get_var_int();
+   if (count >= UINT32_MAX)
+      throw BlockFilterException("invalid filter element count");
+
+   n_ = count;
+   f_ = n_ * GCS_FILTER_M;
+   data_ = brr.get_BinaryData(brr.getSizeRemaining());
+
+   if (n_ > 0 && data_.empty())
+      throw BlockFilterException("truncated filter");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void GolombFilter::setKey(BinaryDataRef blockHash)
+{
+   if (blockHash.getSize() < 16)
+      throw BlockFilterException("invalid filter key");
+
+   k0_ = READ_UINT64_LE(blockHash.getPtr());
+   k1_ = READ_UINT64_LE(blockHash.getPtr() + 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t GolombFilter::hashToRange(BinaryDataRef element) const
+{
+   return mulHigh(sipHash(k0_, k1_, element), f_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData GolombFilter::serialize() const
+{
+   BinaryWriter bw;
+   bw.put_var_int(n_);
+   bw.put_BinaryData(data_);
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool GolombFilter::match(BinaryDataRef element) const
+{
+   if (n_ == 0)
+      return false;
+
+   auto target = hashToRange(element);
+
+   BitReader reader(data_.getRef());
+   uint64_t val = 0;
+   for (uint32_t i = 0; i < n_; i++)
+   {
+      val += reader.golombDecode();
+      if (val == target)
+         return true;
+
+      if (val > target)
+         break;
+   }
+
+   return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool GolombFilter::matchAny(const vector<BinaryData>& elements) const
+{
+   if (n_ == 0 || elements.empty())
+      return false;
+
+   vector<uint64_t> targets;
+   targets.reserve(elements.size());
+   for (auto& element : elements)
+      targets.push_back(hashToRange(element.getRef()));
+   sort(targets.begin(), targets.end());
+
+   //walk both sorted sets
+   BitReader reader(data_.getRef());
+   uint64_t val = 0;
+   auto targetIter = targets.begin();
+   for (uint32_t i = 0; i < n_; i++)
+   {
+      val += reader.golombDecode();
+
+      while (*targetIter < val)
+      {
+         ++targetIter;
+         if (targetIter == targets.end())
+            return false;
+      }
+
+      if (*targetIter == val)
+         return true;
+   }
+
+   return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t GolombFilter::sipHash(uint64_t k0, uint64_t k1, BinaryDataRef data)
+{
+   uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+   uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+   uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+   uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+   auto sipRound = [&](void)->void
+   {
+      v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+      v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+      v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+      v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+   };
+
+   auto ptr = data.getPtr();
+   auto len = data.getSize();
+   size_t offset = 0;
+   for (; offset + 8 <= len; offset += 8)
+   {
+      auto m = READ_UINT64_LE(ptr + offset);
+      v3 ^= m;
+      sipRound();
+      sipRound();
+      v0 ^= m;
+   }
+
+   uint64_t b = ((uint64_t)len) << 56;
+   for (unsigned i = 0; offset + i < len; i++)
+      b |= ((uint64_t)ptr[offset + i]) << (8 * i);
+
+   v3 ^= b;
+   sipRound();
+   sipRound();
+   v0 ^= b;
+
+   v2 ^= 0xff;
+   sipRound();
+   sipRound();
+   sipRound();
+   sipRound();
+
+   return v0 ^ v1 ^ v2 ^ v3;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData GolombFilter::buildForBlock(const BlockData& block)
+{
+   vector<BinaryData> elements;
+
+   for (auto& txnPtr : block.getTxns())
+   {
+      const BCTX& txn = *txnPtr;
+      for (auto& txout : txn.txouts_)
+      {
+         BinaryRefReader brr(txn.data_ + txout.first, txout.second);
+         brr.advance(8);
+         auto scriptSize = (unsigned)brr.get_var_int();
+         auto&& scrRef = BtcUtils::getTxOutScrAddrNoCopy(
+            brr.get_BinaryDataRef(scriptSize));
+
+         elements.emplace_back(scrRef.getScrAddr());
+      }
+
+      if (txn.isCoinbase_)
+         continue;
+
+      //outpoint: 32 bytes hash + 4 bytes LE index
+      for (auto& txin : txn.txins_)
+         elements.emplace_back(txn.data_ + txin.first, 36);
+   }
+
+   GolombFilter filter(block.getHash().getRef(), move(elements));
+   return filter.serialize();
+}
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BLOCKFILTERS_H_
+#define _BLOCKFILTERS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include "BinaryData.h"
+
+//BIP158 basic filter parameters
+#define GCS_FILTER_P 19
+#define GCS_FILTER_M 784931ULL
+
+//scans querying more elements than this per block parse every block instead
+#define BLOCKFILTER_QUERY_LIMIT 50000
+
+class BlockData;
+
+////////////////////////////////////////////////////////////////////////////////
+struct BlockFilterException : public std::runtime_error
+{
+   BlockFilterException(const std::string& err) : std::runtime_error(err)
+   {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class GolombFilter
+{
+   /***
+   BIP158 style Golomb-coded set. Elements are hashed with SipHash-2-4
+   keyed by the first 16 bytes of the block hash, mapped to [0, N*M) and
+   stored as sorted, Golomb-Rice coded deltas.
+
+   Block filters carry the scrAddr of every output and the outpoint
+   (hash | LE index) of every non coinbase input in the block. A match is
+   probabilistic: a miss guarantees the block does not carry any of the
+   queried elements, a hit has to be confirmed by parsing the block.
+   ***/
+
+private:
+   uint64_t k0_ = 0;
+   uint64_t k1_ = 0;
+
+   uint32_t n_ = 0;
+   uint64_t f_ = 0;
+
+   BinaryData data_;
+
+private:
+   void setKey(BinaryDataRef);
+   uint64_t hashToRange(BinaryDataRef) const;
+
+public:
+   //build
+   GolombFilter(BinaryDataRef blockHash, std::vector<BinaryData>);
+
+   //read, throws BlockFilterException on malformed data
+   GolombFilter(BinaryDataRef blockHash, BinaryDataRef serialized);
+
+   uint32_t size(void) const { return n_; }
+   BinaryData serialize(void) const;
+
+   bool match(BinaryDataRef) const;
+   bool matchAny(const std::vector<BinaryData>&) const;
+
+   static uint64_t sipHash(uint64_t k0, uint64_t k1, BinaryDataRef);
+   static BinaryData buildForBlock(const BlockData&);
+};
+
+#endif
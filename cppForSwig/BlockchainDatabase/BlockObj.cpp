@@ -39,6 +39,25 @@ void BlockHeader::unserialize(uint8_t const * ptr, uint32_t size)
    numTx_ = UINT32_MAX;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BlockHeader::unserializeWithHash(
+   BinaryDataRef rawHeader, BinaryDataRef hash)
+{
+   if (rawHeader.getSize() < HEADER_SIZE || hash.getSize() != 32)
+      throw BlockDeserializingException();
+   dataCopy_.copyFrom(rawHeader.getPtr(), HEADER_SIZE);
+   thisHash_ = hash;
+   difficultyDbl_ = BtcUtils::convertDiffBitsToDouble( 
+                              BinaryDataRef(dataCopy_.getPtr()+72, 4));
+   isInitialized_ = true;
+   nextHash_ = BinaryData(0);
+   blockHeight_ = UINT32_MAX;
+   difficultySum_ = -1;
+   isMainBranch_ = false;
+   isOrphan_ = true;
+   numTx_ = UINT32_MAX;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockHeader::unserialize(BinaryDataRef const & str) 
 { 
@@ -20,6 +20,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <atomic>
 #include <cassert>
 #include <functional>
 
@@ -33,6 +34,14 @@ class Tx;
 class TxIn;
 class TxOut;
 
+////////////////////////////////////////////////////////////////////////////////
+struct BlockFilePos
+{
+   uint32_t fileNum_ = UINT32_MAX;
+   uint64_t offset_ = SIZE_MAX;
+};
+
+////////////////////////////////////////////////////////////////////////////////
 class BlockHeader
 {
    friend class Blockchain;
@@ -84,8 +93,11 @@ public:
    uint32_t       getNumTx(void) const         { return numTx_; }
 
    const std::string&  getFileName(void) const { return blkFile_; }
-   uint64_t       getOffset(void) const { return blkFileOffset_; }
-   uint32_t       getBlockFileNum(void) const { return blkFileNum_; }
+   uint64_t       getOffset(void) const { return filePos_.get().offset_; }
+   uint32_t       getBlockFileNum(void) const { return filePos_.get().fileNum_; }
+
+   //file and offset read together, use this to locate the block's data
+   BlockFilePos   getBlockFilePos(void) const { return filePos_.get(); }
    /////////////////////////////////////////////////////////////////////////////
    uint8_t const * getPtr(void) const  {
       assert(isInitialized_);
@@ -102,8 +114,12 @@ public:
 
    /////////////////////////////////////////////////////////////////////////////
    void           setBlockFile(std::string filename)     {blkFile_       = filename;}
-   void           setBlockFileNum(uint32_t fnum)    {blkFileNum_    = fnum;}
-   void           setBlockFileOffset(uint64_t offs) {blkFileOffset_ = offs;}
+   void           setBlockFileNum(uint32_t fnum)    {filePos_.setFileNum(fnum);}
+   void           setBlockFileOffset(uint64_t offs) {filePos_.setOffset(offs);}
+
+   //moves a live header to another file, readers see either position
+   void           setBlockFilePos(uint32_t fnum, uint64_t offs)
+   { filePos_.set(fnum, offs); }
 
    /////////////////////////////////////////////////////////////////////////////
    void          pprint(std::ostream & os= std::cout, int nIndent=0, bool pBigendian=true) const;
@@ -112,7 +128,7 @@ public:
    /////////////////////////////////////////////////////////////////////////////
    const BinaryData& serialize(void) const   { return dataCopy_; }
 
-   bool hasFilePos(void) const { return blkFileNum_ != UINT32_MAX; }
+   bool hasFilePos(void) const { return getBlockFileNum() != UINT32_MAX; }
 
    /////////////////////////////////////////////////////////////////////////////
    void unserialize(uint8_t const * ptr, uint32_t size);
@@ -120,6 +136,9 @@ public:
    void unserialize(BinaryDataRef const & str);
    void unserialize(BinaryRefReader & brr);
 
+   //skips hashing, for headers read back from our own storage
+   void unserializeWithHash(BinaryDataRef rawHeader, BinaryDataRef hash);
+
    void unserialize_swigsafe_(BinaryData const & rawHead) { unserialize(rawHead); }
 
    uint8_t getDuplicateID(void) const { return duplicateID_; }
@@ -135,6 +154,77 @@ public:
    unsigned int getThisID(void) const { return uniqueID_; }
    void setUniqueID(unsigned int& ID) { uniqueID_ = ID; }
 
+private:
+   class PackedFilePos
+   {
+      /***
+      Block file number and offset packed in one word. Headers of blocks
+      ingested from memory are moved to their blk file while scans and
+      tx lookups read them, the pair has to change in a single store.
+
+      Offsets are 32 bits, blk files are capped well below 4GB.
+      ***/
+
+   private:
+      std::atomic<uint64_t> packed_;
+
+   private:
+      static uint64_t pack(uint32_t fileNum, uint64_t offset)
+      {
+         if (offset >= UINT32_MAX)
+         {
+            //UINT32_MAX in the low word stands for no offset
+            if (offset != uint64_t(SIZE_MAX) && fileNum != UINT32_MAX)
+               throw std::range_error("block offset out of range");
+
+            offset = UINT32_MAX;
+         }
+
+         return (uint64_t(fileNum) << 32) | offset;
+      }
+
+   public:
+      PackedFilePos(void)
+      { packed_.store(UINT64_MAX, std::memory_order_relaxed); }
+
+      PackedFilePos(const PackedFilePos& rhs)
+      { packed_.store(rhs.packed_.load(std::memory_order_acquire),
+         std::memory_order_relaxed); }
+
+      PackedFilePos& operator=(const PackedFilePos& rhs)
+      {
+         packed_.store(rhs.packed_.load(std::memory_order_acquire),
+            std::memory_order_release);
+         return *this;
+      }
+
+      BlockFilePos get(void) const
+      {
+         auto packed = packed_.load(std::memory_order_acquire);
+
+         BlockFilePos pos;
+         pos.fileNum_ = uint32_t(packed >> 32);
+         if ((packed & UINT32_MAX) != UINT32_MAX)
+            pos.offset_ = packed & UINT32_MAX;
+         return pos;
+      }
+
+      void set(uint32_t fileNum, uint64_t offset)
+      { packed_.store(pack(fileNum, offset), std::memory_order_release); }
+
+      void setFileNum(uint32_t fileNum)
+      {
+         auto pos = get();
+         set(fileNum, pos.offset_);
+      }
+
+      void setOffset(uint64_t offset)
+      {
+         auto pos = get();
+         set(pos.fileNum_, offset);
+      }
+   };
+
 private:
    BinaryData     dataCopy_;
    bool           isInitialized_ = false;
@@ -157,8 +247,7 @@ private:
    double         difficultySum_ = 0.0;
 
    std::string         blkFile_;
-   uint32_t       blkFileNum_ = UINT32_MAX;
-   uint64_t       blkFileOffset_ = SIZE_MAX;
+   PackedFilePos  filePos_;
 
    unsigned int uniqueID_ = UINT32_MAX;
 };
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "BlockStream.h"
+#include "BlockDataMap.h"
+#include "BtcUtils.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+////
+//// BlockBufferPool
+////
+////////////////////////////////////////////////////////////////////////////////
+BlockBufferPool::BlockBufferPool(size_t bufferSize, unsigned maxCount) :
+   bufferSize_(bufferSize), maxCount_(maxCount)
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<vector<uint8_t>> BlockBufferPool::acquire(size_t size)
+{
+   //oversized blocks don't come from nor go back to the pool
+   if (size > bufferSize_)
+      return make_shared<vector<uint8_t>>(size);
+
+   vector<uint8_t>* buffer = nullptr;
+   {
+      unique_lock<mutex> lock(mu_);
+      if (!free_.empty())
+      {
+         buffer = new vector<uint8_t>(move(free_.back()));
+         free_.pop_back();
+      }
+   }
+
+   if (buffer == nullptr)
+      buffer = new vector<uint8_t>(bufferSize_);
+
+   auto self = shared_from_this();
+   return shared_ptr<vector<uint8_t>>(buffer,
+      [self](vector<uint8_t>* ptr)->void
+   {
+      self->release(ptr);
+   });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockBufferPool::release(vector<uint8_t>* buffer)
+{
+   {
+      unique_lock<mutex> lock(mu_);
+      if (free_.size() < maxCount_)
+         free_.emplace_back(move(*buffer));
+   }
+
+   delete buffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t BlockBufferPool::freeCount()
+{
+   unique_lock<mutex> lock(mu_);
+   return free_.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////
+//// BlockStreamReader
+////
+////////////////////////////////////////////////////////////////////////////////
+BlockStreamReader::StreamFile::StreamFile(const string& path)
+{
+#ifdef _WIN32
+   fd_ = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+   fd_ = open(path.c_str(), O_RDONLY);
+#endif
+
+   if (fd_ == -1)
+      throw runtime_error("failed to open " + path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockStreamReader::StreamFile::~StreamFile()
+{
+   if (fd_ == -1)
+      return;
+
+#ifdef _WIN32
+   _close(fd_);
+#else
+   close(fd_);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockStreamReader::StreamFile::readAt(
+   uint8_t* dst, size_t offset, size_t size)
+{
+#ifdef _WIN32
+   //no pread, seek and read under the file's lock
+   unique_lock<mutex> lock(mu_);
+   if (_lseeki64(fd_, offset, SEEK_SET) == -1)
+      throw runtime_error("failed to seek block");
+
+   while (size > 0)
+   {
+      auto count = _read(fd_, dst, (unsigned)min(size, (size_t)INT_MAX));
+      if (count <= 0)
+         throw runtime_error("short block read");
+
+      dst += count;
+      size -= count;
+   }
+#else
+   while (size > 0)
+   {
+      auto count = pread(fd_, dst, size, offset);
+      if (count == -1 && errno == EINTR)
+         continue;
+
+      if (count <= 0)
+         throw runtime_error("short block read");
+
+      dst += count;
+      offset += count;
+      size -= count;
+   }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockStreamReader::BlockStreamReader(const string& path, unsigned poolSize) :
+   path_(path),
+   pool_(make_shared<BlockBufferPool>(BLOCK_STREAM_BUFFER_SIZE, poolSize))
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockStreamReader::StreamFile> BlockStreamReader::getFile(
+   uint32_t fileID)
+{
+   unique_lock<mutex> lock(mu_);
+   auto iter = files_.find(fileID);
+   if (iter != files_.end())
+      return iter->second;
+
+   auto file = make_shared<StreamFile>(
+      BtcUtils::getBlkFilename(path_, fileID));
+   files_.emplace(fileID, file);
+   fileOrder_.push_back(fileID);
+
+   //readers still on an evicted file keep it open until they're done
+   while (fileOrder_.size() > BLOCK_STREAM_OPEN_FILES)
+   {
+      files_.erase(fileOrder_.front());
+      fileOrder_.pop_front();
+   }
+
+   return file;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockSlice BlockStreamReader::read(uint32_t fileID, size_t offset, size_t size)
+{
+   BlockSlice slice;
+   slice.size_ = size;
+
+   if (MemoryBlockStore::isMemoryFileID(fileID))
+   {
+      auto fileMap = MemoryBlockStore::shared().get(fileID);
+      if (fileMap->getPtr() == nullptr || offset + size > fileMap->size())
+         throw runtime_error("missing in-memory block");
+
+      slice.data_ = fileMap->getPtr() + offset;
+      slice.owner_ = fileMap;
+      return slice;
+   }
+
+   auto file = getFile(fileID);
+
+   shared_ptr<vector<uint8_t>> buffer;
+   uint8_t* dst = nullptr;
+   if (size > pool_->bufferSize())
+   {
+      buffer = pool_->acquire(size);
+      dst = buffer->data();
+   }
+   else
+   {
+      //carve the slice out of the current buffer, the read itself
+      //happens outside the lock
+      unique_lock<mutex> lock(mu_);
+      if (current_ == nullptr || used_ + size > current_->size())
+      {
+         current_ = pool_->acquire(size);
+         used_ = 0;
+      }
+
+      buffer = current_;
+      dst = current_->data() + used_;
+      used_ += size;
+   }
+
+   file->readAt(dst, offset, size);
+
+   slice.data_ = dst;
+   slice.owner_ = buffer;
+   return slice;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockSlice BlockStreamReader::read(const BlockHeader& header)
+{
+   //An in-memory block is released once its header points at the blk
+   //file. Missing it means the header moved, read it again.
+   for (unsigned i = 0; i < 2; i++)
+   {
+      auto pos = header.getBlockFilePos();
+      if (!MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+         return read(pos.fileNum_, pos.offset_, header.getBlockSize());
+
+      try
+      {
+         return read(pos.fileNum_, pos.offset_, header.getBlockSize());
+      }
+      catch (runtime_error&)
+      {}
+   }
+
+   throw runtime_error("missing in-memory block");
+}
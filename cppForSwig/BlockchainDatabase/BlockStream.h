@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BLOCKSTREAM_H_
+#define _BLOCKSTREAM_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+
+class BlockHeader;
+
+//blocks are packed back to back in buffers of this size, larger blocks
+//get a buffer of their own
+#define BLOCK_STREAM_BUFFER_SIZE (1024 * 1024 * 8ULL)
+
+//blk files a reader keeps open
+#define BLOCK_STREAM_OPEN_FILES 16
+
+////////////////////////////////////////////////////////////////////////////////
+struct BlockSlice
+{
+   //keeps data_ valid, the buffer or file map it points into
+   std::shared_ptr<const void> owner_;
+
+   const uint8_t* data_ = nullptr;
+   size_t size_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class BlockBufferPool : public std::enable_shared_from_this<BlockBufferPool>
+{
+   /***
+   Fixed size buffers recycled between block reads. Acquiring never waits:
+   an empty pool allocates a new buffer. Released buffers go back to the
+   pool, up to maxCount of them, the rest are freed. How many buffers are in
+   use at once is up to the caller, the scanner bounds it through its batch
+   controller.
+   ***/
+
+private:
+   const size_t bufferSize_;
+   const unsigned maxCount_;
+
+   std::mutex mu_;
+   std::vector<std::vector<uint8_t>> free_;
+
+private:
+   void release(std::vector<uint8_t>*);
+
+public:
+   BlockBufferPool(size_t bufferSize, unsigned maxCount);
+
+   //buffer of at least size bytes, bufferSize unless size is larger
+   std::shared_ptr<std::vector<uint8_t>> acquire(size_t size);
+
+   size_t bufferSize(void) const { return bufferSize_; }
+   size_t freeCount(void);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class BlockStreamReader
+{
+   /***
+   Block source reading blocks off of the blk files with pread, in place of
+   mapping whole files. Each block lands in a slice of a pooled buffer, that
+   the returned BlockSlice holds on to. A buffer goes back to the pool once
+   all its slices are released.
+
+   Memory use follows the blocks held rather than the files they sit in,
+   which keeps 32-bit builds within their address space and spares the
+   page cache on small systems.
+
+   Blocks that aren't in the blk files yet are served from the
+   MemoryBlockStore. Thread safe.
+   ***/
+
+private:
+   struct StreamFile
+   {
+      int fd_ = -1;
+      std::mutex mu_;
+
+      StreamFile(const std::string& path);
+      ~StreamFile(void);
+
+      void readAt(uint8_t* dst, size_t offset, size_t size);
+   };
+
+private:
+   const std::string path_;
+   const std::shared_ptr<BlockBufferPool> pool_;
+
+   std::mutex mu_;
+   std::map<uint32_t, std::shared_ptr<StreamFile>> files_;
+   std::deque<uint32_t> fileOrder_;
+
+   std::shared_ptr<std::vector<uint8_t>> current_;
+   size_t used_ = 0;
+
+private:
+   std::shared_ptr<StreamFile> getFile(uint32_t fileID);
+
+public:
+   //keeps up to poolSize free buffers around
+   BlockStreamReader(const std::string& path, unsigned poolSize);
+
+   //throws if the block can't be read in full
+   BlockSlice read(uint32_t fileID, size_t offset, size_t size);
+
+   //the header's block, follows blocks moved from memory to their blk file
+   BlockSlice read(const BlockHeader&);
+
+   std::shared_ptr<BlockBufferPool> pool(void) const { return pool_; }
+};
+
+#endif
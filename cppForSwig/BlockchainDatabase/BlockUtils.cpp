@@ -20,6 +20,7 @@
 #include "util.h"
 #include "BlockchainScanner.h"
 #include "DatabaseBuilder.h"
+#include "LedgerCache.h"
 #include "gtest/NodeUnitTest.h"
 
 using namespace std;
@@ -218,11 +219,24 @@ void BlockDataManager::openDatabase()
       ss << "DB failed to open, reporting the following error: " << e.what();
       throw runtime_error(ss.str());
    }
+
+   //drop ledger caches of wallets that weren't loaded in a while
+   try
+   {
+      auto count = LedgerCache::collectGarbage(iface_, LEDGERCACHE_EXPIRY);
+      if (count > 0)
+         LOGINFO << "dropped " << count << " stale ledger caches";
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "ledger cache cleanup failed: " << e.what();
+   }
 }
 
 /////////////////////////////////////////////////////////////////////////////
 BlockDataManager::~BlockDataManager()
 {
+   stopIntegrityCheck();
    zeroConfCont_.reset();
    blockFiles_.reset();
    dbBuilder_.reset();
@@ -231,7 +245,23 @@ BlockDataManager::~BlockDataManager()
    scrAddrData_.reset();
    
    if (iface_ != nullptr)
+   {
+      //a fully loaded chain matches the HEADERS db, save it for next start
+      if (BDMstate_ == BDM_ready && blockchain_ != nullptr)
+      {
+         try
+         {
+            HeaderSnapshot::write(
+               HeaderSnapshot::getPath(), *blockchain_, iface_);
+         }
+         catch (exception& e)
+         {
+            LOGWARN << "failed to write header snapshot: " << e.what();
+         }
+      }
+
       iface_->closeDatabases();
+   }
    delete iface_;
 }
 
@@ -339,13 +369,71 @@ void BlockDataManager::loadDiskState(const ProgressCallback &progress,
       *blockFiles_, *this, progress, forceRescanSSH);
    dbBuilder_->init();
 
-   if (DBSettings::checkChain())
-      checkTransactionCount_ = dbBuilder_->getCheckedTxCount();
-
    BDMstate_ = BDM_ready;
    LOGINFO << "BDM is ready";
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BlockDataManager::startIntegrityCheck(const ProgressCallback& progress)
+{
+   if (dbBuilder_ == nullptr ||
+      (!DBSettings::checkChain() && !DBSettings::checkTxHints()))
+      return;
+
+   if (integrityCheckThread_.joinable())
+      throw runtime_error("integrity check already running");
+
+   auto dbBuilder = dbBuilder_;
+   auto checkLambda = [this, dbBuilder, progress](void)->void
+   {
+      if (DBSettings::checkChain())
+      {
+         try
+         {
+            dbBuilder->verifyTransactions(progress);
+         }
+         catch (exception& e)
+         {
+            LOGERR << "chain check failed with error: " << e.what();
+         }
+
+         checkTransactionCount_ = dbBuilder->getCheckedTxCount();
+      }
+
+      if (!DBSettings::checkTxHints())
+         return;
+
+      try
+      {
+         dbBuilder->checkTxHintsIntegrity(progress);
+      }
+      catch (exception& e)
+      {
+         LOGERR << "txhints check failed with error: " << e.what();
+      }
+   };
+
+   integrityCheckThread_ = thread(checkLambda);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockDataManager::waitOnIntegrityCheck()
+{
+   if (integrityCheckThread_.joinable())
+      integrityCheckThread_.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockDataManager::stopIntegrityCheck()
+{
+   if (!integrityCheckThread_.joinable())
+      return;
+
+   if (dbBuilder_ != nullptr)
+      dbBuilder_->haltVerification();
+   integrityCheckThread_.join();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Blockchain::ReorganizationState BlockDataManager::readBlkFileUpdate()
 { 
@@ -429,6 +517,115 @@ CoreRPC::NodeStatus BlockDataManager::getNodeStatus() const
    return nss;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   /*
+   Mempool fee estimates are computed locally from the zc fee histogram.
+   The node's estimatesmartfee result is blended in when available:
+   conservative estimates take the higher of the two, economical ones
+   take the average.
+   */
+   CoreRPC::FeeEstimateResult blendFeeEstimates(
+      float mempoolFeeByte, const CoreRPC::FeeEstimateResult& rpcEstimate,
+      const string& strategy)
+   {
+      CoreRPC::FeeEstimateResult result;
+      if (!rpcEstimate.error_.empty() || rpcEstimate.feeByte_ <= 0.0f)
+      {
+         result.feeByte_ = mempoolFeeByte;
+         return result;
+      }
+
+      result = rpcEstimate;
+      if (strategy == FEE_STRAT_CONSERVATIVE)
+         result.feeByte_ = max(mempoolFeeByte, rpcEstimate.feeByte_);
+      else
+         result.feeByte_ = (mempoolFeeByte + rpcEstimate.feeByte_) / 2.0f;
+
+      return result;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CoreRPC::FeeEstimateResult BlockDataManager::getFeeByte(
+   unsigned confTarget, const string& strategy) const
+{
+   float mempoolFeeByte = -1.0f;
+   if (zeroConfCont_ != nullptr)
+   {
+      mempoolFeeByte = zeroConfCont_->getFeeHistogram()->estimateFeeByte(
+         confTarget, strategy);
+   }
+
+   if (nodeRPC_ == nullptr)
+   {
+      if (mempoolFeeByte < 0.0f)
+         throw CoreRPC::RpcError();
+      
+      CoreRPC::FeeEstimateResult result;
+      result.feeByte_ = mempoolFeeByte;
+      return result;
+   }
+
+   //the rpc estimate is optional
+   CoreRPC::FeeEstimateResult rpcEstimate;
+   try
+   {
+      rpcEstimate = nodeRPC_->getFeeByte(confTarget, strategy);
+   }
+   catch (CoreRPC::RpcError&)
+   {
+      if (mempoolFeeByte < 0.0f)
+         throw;
+
+      rpcEstimate.error_ = "rpc unavailable";
+   }
+
+   if (mempoolFeeByte < 0.0f)
+      return rpcEstimate;
+
+   return blendFeeEstimates(mempoolFeeByte, rpcEstimate, strategy);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+map<unsigned, CoreRPC::FeeEstimateResult> BlockDataManager::getFeeSchedule(
+   const string& strategy) const
+{
+   map<unsigned, float> mempoolSchedule;
+   if (zeroConfCont_ != nullptr)
+   {
+      mempoolSchedule = 
+         zeroConfCont_->getFeeHistogram()->getFeeSchedule(strategy);
+   }
+
+   map<unsigned, CoreRPC::FeeEstimateResult> rpcSchedule;
+   if (nodeRPC_ != nullptr)
+   {
+      try
+      {
+         rpcSchedule = nodeRPC_->getFeeSchedule(strategy);
+      }
+      catch (CoreRPC::RpcError&)
+      {
+         if (mempoolSchedule.empty())
+            throw;
+      }
+   }
+   else if (mempoolSchedule.empty())
+   {
+      throw CoreRPC::RpcError();
+   }
+
+   for (auto& feePair : mempoolSchedule)
+   {
+      auto& entry = rpcSchedule[feePair.first];
+      entry = blendFeeEstimates(feePair.second, entry, strategy);
+   }
+
+   return rpcSchedule;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockDataManager::pollNodeStatus() const
 {
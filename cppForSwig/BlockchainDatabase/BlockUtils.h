@@ -19,7 +19,9 @@
 #include <vector>
 #include <set>
 #include <future>
+#include <thread>
 #include <exception>
+#include <atomic>
 
 #include "Blockchain.h"
 #include "StoredBlockObj.h"
@@ -133,7 +135,8 @@ private:
 
    std::exception_ptr exceptPtr_ = nullptr;
 
-   unsigned checkTransactionCount_ = 0;
+   std::atomic<unsigned> checkTransactionCount_ = { 0 };
+   std::thread integrityCheckThread_;
    
    mutable std::shared_ptr<std::mutex> nodeStatusPollMutex_;
 
@@ -214,6 +217,12 @@ public:
    }
    void shutdownNotifications(void) { notificationStack_.terminate(); }
 
+   //runs the integrity checks enabled in DBSettings on their own thread,
+   //once the db is ready
+   void startIntegrityCheck(const ProgressCallback&);
+   void stopIntegrityCheck(void);
+   void waitOnIntegrityCheck(void);
+
 public:
    bool isRunning(void) const { return BDMstate_ != BDM_offline; }
    void blockUntilReady(void) const;
@@ -222,6 +231,11 @@ public:
    
    unsigned getCheckedTxCount(void) const { return checkTransactionCount_; }
    CoreRPC::NodeStatus getNodeStatus(void) const;
+
+   CoreRPC::FeeEstimateResult getFeeByte(
+      unsigned, const std::string&) const;
+   std::map<unsigned, CoreRPC::FeeEstimateResult> getFeeSchedule(
+      const std::string&) const;
    void registerZcCallbacks(std::unique_ptr<ZeroConfCallbacks> ptr)
    {
       zeroConfCont_->setZeroConfCallbacks(move(ptr));
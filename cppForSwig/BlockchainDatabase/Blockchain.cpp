@@ -39,15 +39,18 @@ Blockchain::Blockchain(const HashString &genesisHash)
 void Blockchain::clear()
 {
    newlyParsedBlocks_.clear();
-   headersByHeight_.clear();
-   headersById_.clear();
-   headerMap_.clear();
-
-   pair<BinaryData, shared_ptr<BlockHeader>> genesisPair;
-   genesisPair.first = genesisHash_;
-   genesisPair.second = make_shared<BlockHeader>();
-   atomic_store(&topBlockPtr_, genesisPair.second);
-   headerMap_.insert(genesisPair);
+
+   map<BinaryData, shared_ptr<BlockHeader>> genesisMap;
+   auto genesisHeader = make_shared<BlockHeader>();
+   genesisMap.insert(make_pair(genesisHash_, genesisHeader));
+   atomic_store(&topBlockPtr_, genesisHeader);
+
+   {
+      unique_lock<mutex> lock(indexMu_);
+      shared_ptr<const HeaderIndex> index = 
+         HeaderIndex().addHeaders(genesisMap);
+      atomic_store(&index_, index);
+   }
    topBlockId_ = 0;
 
    topID_.store(0, memory_order_relaxed);
@@ -167,13 +170,11 @@ shared_ptr<BlockHeader> Blockchain::top() const
 
 shared_ptr<BlockHeader> Blockchain::getGenesisBlock() const
 {
-   auto headermap = headerMap_.get();
-
-   auto iter = headermap->find(genesisHash_);
-   if (iter == headermap->end())
+   auto header = getHeaderIndex()->getByHash(genesisHash_);
+   if (header == nullptr)
       throw runtime_error("missing genesis block header");
 
-   return iter->second;
+   return header;
 }
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(
@@ -185,14 +186,12 @@ const shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(
    Passing a dupId for a forked block will throw.
    */
 
-   auto headermap = headersByHeight_.get();
-
-   auto headerIter = headermap->find(index);
-   if (headerIter == headermap->end())
+   auto header = getHeaderIndex()->getByHeight(index);
+   if (header == nullptr)
       throw std::range_error("Cannot get block at height " + to_string(index));
 
-   if (dupId > 0x7F || headerIter->second->getDuplicateID() == dupId)
-      return (headerIter->second);
+   if (dupId > 0x7F || header->getDuplicateID() == dupId)
+      return header;
 
    //if we get this far, we're looking for a block that isn't on the main chain
    throw std::length_error("Cannot get block at height " + to_string(index) +
@@ -201,7 +200,7 @@ const shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(
 
 bool Blockchain::hasHeaderByHeight(unsigned height) const
 {
-   if (height >= headersByHeight_.size())
+   if (height >= getHeaderIndex()->heightCount())
       return false;
 
    return true;
@@ -209,37 +208,28 @@ bool Blockchain::hasHeaderByHeight(unsigned height) const
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderByHash(HashString const & blkHash) const
 {
-   auto headermap = headerMap_.get();
-
-   auto it = headermap->find(blkHash);
-   if(it == headermap->end())
+   auto header = getHeaderIndex()->getByHash(blkHash.getRef());
+   if(header == nullptr)
       throw std::range_error("Cannot find block with hash " + blkHash.copySwapEndian().toHexStr());
 
-   return it->second;
+   return header;
 }
 
 shared_ptr<BlockHeader> Blockchain::getHeaderById(uint32_t id) const
 {
-   auto headermap = headersById_.get();
-
-   auto headerIter = headermap->find(id);
-   if (headerIter == headermap->end())
+   auto header = getHeaderIndex()->getById(id);
+   if (header == nullptr)
    {
       LOGERR << "cannot find block for id: " << id;
       throw std::range_error("Cannot find block by id");
    }
 
-   return headerIter->second;
+   return header;
 }
 
 bool Blockchain::hasHeaderWithHash(BinaryData const & txHash) const
 {
-   auto headermap = headerMap_.get();
-   auto it = headermap->find(txHash);
-   if (it == headermap->end())
-      return false;
-
-   return true;
+   return getHeaderIndex()->getByHash(txHash.getRef()) != nullptr;
 }
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderPtrForTxRef(const TxRef &txr) const
@@ -278,17 +268,17 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
    // invalid.  Rather than get fancy, just rebuild all which takes less
    // than a second, anyway.
 
-   auto headermap = headerMap_.get();
+   auto index = getHeaderIndex();
 
    if(forceRebuild)
    {
-      for (const auto& headerPair : *headermap)
+      for (const auto& header : index->headers())
       {
-         headerPair.second->difficultySum_  = -1;
-         headerPair.second->blockHeight_ = 0;
-         headerPair.second->isFinishedCalc_ = false;
-         headerPair.second->nextHash_ = BtcUtils::EmptyHash();
-         headerPair.second->isMainBranch_ = false;
+         header->difficultySum_  = -1;
+         header->blockHeight_ = 0;
+         header->isFinishedCalc_ = false;
+         header->nextHash_ = BtcUtils::EmptyHash();
+         header->isMainBranch_ = false;
       }
       topBlockPtr_ = NULL;
    }
@@ -305,11 +295,10 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 
    // If this is the first run, the topBlock is the genesis block
    {
-      auto headermap = headersById_.get();
-      auto topblock_iter = headermap->find(topBlockId_);
-      if (topblock_iter != headermap->end())
+      auto topBlock = index->getById(topBlockId_);
+      if (topBlock != nullptr)
       {
-         atomic_store(&topBlockPtr_, topblock_iter->second);
+         atomic_store(&topBlockPtr_, topBlock);
       }
       else
       {
@@ -322,16 +311,16 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
    
    // Iterate over all blocks, track the maximum difficulty-sum block
    double   maxDiffSum     = prevTopBlock->getDifficultySum();
-   for( auto &header_pair : *headermap)
+   for (auto& header : index->headers())
    {
       // *** Walk down the chain following prevHash fields, until
       //     you find a "solved" block.  Then walk back up and 
       //     fill in the difficulty-sum values (do not set next-
       //     hash ptrs, as we don't know if this is the main branch)
       //     Method returns instantly if block is already "solved"
-      double thisDiffSum = traceChainDown(header_pair.second);
+      double thisDiffSum = traceChainDown(*index, header);
 
-      if (header_pair.second->isOrphan_)
+      if (header->isOrphan_)
       {
          // disregard this block
       }
@@ -340,13 +329,13 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
       else if(thisDiffSum > maxDiffSum)
       {
          maxDiffSum     = thisDiffSum;
-         newTopBlock = header_pair.second;
+         newTopBlock = header;
       }
    }
 
    
    // Walk down the list one more time, set nextHash fields
-   // Also set headersByHeight_;
+   // Also set the height index
    map<unsigned, shared_ptr<BlockHeader>> heightMap;
    bool prevChainStillValid = (newTopBlock == prevTopBlock);
    newTopBlock->nextHash_ = BtcUtils::EmptyHash();
@@ -360,15 +349,15 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
       heightMap[thisHeaderPtr->getBlockHeight()] = thisHeaderPtr;
 
       auto prevHash = thisHeaderPtr->getPrevHashRef();
-      auto childIter = headermap->find(prevHash);
-      if (childIter == headermap->end())
+      auto prevHeader = index->getByHash(prevHash);
+      if (prevHeader == nullptr)
       {
          LOGERR << "failed to get prev header by hash";
          throw runtime_error("failed to get prev header by hash");
       }
 
-      childIter->second->nextHash_ = thisHeaderPtr->getThisHash();
-      thisHeaderPtr = childIter->second;
+      prevHeader->nextHash_ = thisHeaderPtr->getThisHash();
+      thisHeaderPtr = prevHeader;
       if (thisHeaderPtr == prevTopBlock)
          prevChainStillValid = true;
    }
@@ -376,7 +365,12 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
    // Last header in the loop didn't get added (the genesis block on first run)
    thisHeaderPtr->isMainBranch_ = true;
    heightMap[thisHeaderPtr->getBlockHeight()] = thisHeaderPtr;
-   headersByHeight_.update(heightMap);
+   {
+      unique_lock<mutex> lock(indexMu_);
+      shared_ptr<const HeaderIndex> newIndex = 
+         atomic_load(&index_)->setHeights(heightMap);
+      atomic_store(&index_, newIndex);
+   }
 
    topBlockId_ = newTopBlock->getThisID();
    atomic_store(&topBlockPtr_, newTopBlock);
@@ -406,7 +400,8 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 // Start from a node, trace down to the highest solved block, accumulate
 // difficulties and difficultySum values.  Return the difficultySum of 
 // this block.
-double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
+double Blockchain::traceChainDown(
+   const HeaderIndex& index, shared_ptr<BlockHeader> bhpStart)
 {
    /*
    TODO: check difficulty target matches for each block
@@ -416,14 +411,12 @@ double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
       return bhpStart->difficultySum_;
 
    // Prepare some data structures for walking down the chain
-   vector<shared_ptr<BlockHeader>>   headerPtrStack(headerMap_.size());
-   vector<double>         difficultyStack(headerMap_.size());
+   vector<shared_ptr<BlockHeader>>   headerPtrStack(index.size());
+   vector<double>         difficultyStack(index.size());
    uint32_t blkIdx = 0;
 
    // Walk down the chain of prevHash_ values, until we find a block
    // that has a definitive difficultySum value (i.e. >0). 
-   auto headermap = headerMap_.get();
-
    auto thisPtr = bhpStart;
    while( thisPtr->difficultySum_ < 0)
    {
@@ -432,10 +425,10 @@ double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
       headerPtrStack[blkIdx]  = thisPtr;
       blkIdx++;
 
-      auto iter = headermap->find(thisPtr->getPrevHash());
-      if(iter != headermap->end())
+      auto prevPtr = index.getByHash(thisPtr->getPrevHashRef());
+      if(prevPtr != nullptr)
       {
-         thisPtr = iter->second;
+         thisPtr = prevPtr;
       }
       else
       {
@@ -481,13 +474,13 @@ void Blockchain::putBareHeaders(LMDBBlockDatabase *db, bool updateDupID)
    block file is created by Core.
    ***/
 
-   auto headermap = headerMap_.get();
-   for (auto& block : *headermap)
+   auto index = getHeaderIndex();
+   for (auto& block : index->headers())
    {
       StoredHeader sbh;
-      sbh.createFromBlockHeader(*(block.second));
+      sbh.createFromBlockHeader(*block);
       uint8_t dup = db->putBareHeader(sbh, updateDupID);
-      block.second->setDuplicateID(dup);  // make sure headerMap_ and DB agree
+      block->setDuplicateID(dup);  // make sure the index and DB agree
    }
 }
 
@@ -514,7 +507,7 @@ void Blockchain::putNewBareHeaders(LMDBBlockDatabase *db)
          sbh.createFromBlockHeader(*block);
          //don't update SDBI, we'll do it here once instead
          uint8_t dup = db->putBareHeader(sbh, true, false);
-         block->setDuplicateID(dup);  // make sure headerMap_ and DB agree
+         block->setDuplicateID(dup);  // make sure the index and DB agree
          
          if (block->isMainBranch())
             dupIdMap.insert(make_pair(block->blockHeight_, dup));
@@ -646,22 +639,20 @@ set<uint32_t> Blockchain::addBlocksInBulk(
    unique_lock<mutex> lock(mu_);
 
    map<BinaryData, shared_ptr<BlockHeader>> toAddMap;
-   map<unsigned, shared_ptr<BlockHeader>> idMap;
    
    {
-      auto headermap = headerMap_.get();
+      auto index = getHeaderIndex();
 
       for (auto& header_pair : bhMap)
       {
-         auto iter = headermap->find(header_pair.first);
-         if (iter != headermap->end())
+         auto existing = index->getByHash(header_pair.first.getRef());
+         if (existing != nullptr)
          {
-            if (iter->second->dataCopy_.getSize() == HEADER_SIZE)
+            if (existing->dataCopy_.getSize() == HEADER_SIZE)
                continue;
          }
 
          toAddMap.insert(header_pair);
-         idMap[header_pair.second->getThisID()] = header_pair.second;
          if (areNew)
             newlyParsedBlocks_.push_back(header_pair.second);
          returnSet.insert(header_pair.second->getThisID());
@@ -688,8 +679,7 @@ set<uint32_t> Blockchain::addBlocksInBulk(
       topID_.store(topID, memory_order_relaxed);
    }
 
-   headerMap_.update(toAddMap);
-   headersById_.update(idMap);
+   addToIndex(toAddMap);
    return returnSet;
 }
 
@@ -698,16 +688,24 @@ void Blockchain::forceAddBlocksInBulk(
    map<HashString, shared_ptr<BlockHeader>>& bhMap)
 {
    unique_lock<mutex> lock(mu_);
-   map<unsigned, shared_ptr<BlockHeader>> idMap;
 
    for (auto& headerPair : bhMap)
-   {
-      idMap[headerPair.second->getThisID()] = headerPair.second;
       newlyParsedBlocks_.push_back(headerPair.second);
-   }
 
-   headersById_.update(idMap);
-   headerMap_.update(bhMap);
+   addToIndex(bhMap);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void Blockchain::addToIndex(
+   const map<HashString, shared_ptr<BlockHeader>>& bhMap)
+{
+   if (bhMap.size() == 0)
+      return;
+
+   unique_lock<mutex> lock(indexMu_);
+   shared_ptr<const HeaderIndex> newIndex = 
+      atomic_load(&index_)->addHeaders(bhMap);
+   atomic_store(&index_, newIndex);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -715,13 +713,16 @@ map<unsigned, set<unsigned>> Blockchain::mapIDsPerBlockFile(void) const
 {
    unique_lock<mutex> lock(mu_);
 
-   auto headermap = headersById_.get();
+   auto index = getHeaderIndex();
    map<unsigned, set<unsigned>> resultMap;
 
-   for (auto& header : *headermap)
+   for (auto& header : index->headers())
    {
-      auto& result_set = resultMap[header.second->blkFileNum_];
-      result_set.insert(header.second->uniqueID_);
+      if (header->uniqueID_ == UINT32_MAX)
+         continue;
+
+      auto& result_set = resultMap[header->getBlockFileNum()];
+      result_set.insert(header->uniqueID_);
    }
 
    return resultMap;
@@ -730,16 +731,19 @@ map<unsigned, set<unsigned>> Blockchain::mapIDsPerBlockFile(void) const
 /////////////////////////////////////////////////////////////////////////////
 map<unsigned, HeightAndDup> Blockchain::getHeightAndDupMap(void) const
 {
-   auto headermap = headersById_.get();
+   auto index = getHeaderIndex();
    map<unsigned, HeightAndDup> hd_map;
 
-   for (auto& block_pair : *headermap)
+   for (auto& header : index->headers())
    {
-      HeightAndDup hd(block_pair.second->getBlockHeight(), 
-         block_pair.second->getDuplicateID(),
-         block_pair.second->isMainBranch());
+      if (header->getThisID() == UINT32_MAX)
+         continue;
+
+      HeightAndDup hd(header->getBlockHeight(), 
+         header->getDuplicateID(),
+         header->isMainBranch());
 
-      hd_map.insert(make_pair(block_pair.first, hd));
+      hd_map.insert(make_pair(header->getThisID(), hd));
    }
 
    return hd_map;
@@ -17,6 +17,7 @@
 #include "ThreadSafeClasses.h"
 #include "BlockObj.h"
 #include "lmdb_wrapper.h"
+#include "HeaderIndex.h"
 
 #include <memory>
 #include <deque>
@@ -79,14 +80,21 @@ public:
    bool hasHeaderWithHash(BinaryData const & txHash) const;
    const std::shared_ptr<BlockHeader> getHeaderPtrForTxRef(const TxRef &txr) const;
    
-   std::shared_ptr<const std::map<HashString, std::shared_ptr<BlockHeader>>> allHeaders(void) const
+   std::shared_ptr<const HeaderIndex> getHeaderIndex(void) const
    {
-      return headerMap_.get();
+      return std::atomic_load(&index_);
    }
 
    void putBareHeaders(LMDBBlockDatabase *db, bool updateDupID=true);
    void putNewBareHeaders(LMDBBlockDatabase *db);
 
+   //headers not committed to the HEADERS db yet
+   size_t getNewHeaderCount(void) const
+   {
+      std::unique_lock<std::mutex> lock(mu_);
+      return newlyParsedBlocks_.size();
+   }
+
    uint32_t getNewUniqueID(void) { return topID_.fetch_add(1, std::memory_order_relaxed); }
    uint32_t getTopId(void) { return topID_.load(std::memory_order_relaxed); }
    uint32_t getTopIdFromDb(LMDBBlockDatabase*) const;
@@ -103,18 +111,18 @@ private:
    // Start from a node, trace down to the highest solved block, accumulate
    // difficulties and difficultySum values.  Return the difficultySum of 
    // this block.
-   double traceChainDown(std::shared_ptr<BlockHeader> bhpStart);
+   double traceChainDown(const HeaderIndex&, std::shared_ptr<BlockHeader> bhpStart);
+
+   void addToIndex(const std::map<HashString, std::shared_ptr<BlockHeader>>&);
 
 private:
    //TODO: make this whole class thread safe
 
    const BinaryData genesisHash_;
-   Armory::Threading::TransactionalMap<
-      BinaryData, std::shared_ptr<BlockHeader>> headerMap_;
-   Armory::Threading::TransactionalMap<
-      unsigned, std::shared_ptr<BlockHeader>> headersById_;
-   Armory::Threading::TransactionalMap<
-      unsigned, std::shared_ptr<BlockHeader>> headersByHeight_;
+
+   //lockless reads, updates are serialized on indexMu_
+   std::shared_ptr<const HeaderIndex> index_;
+   std::mutex indexMu_;
 
    std::vector<std::shared_ptr<BlockHeader>> newlyParsedBlocks_;
    std::shared_ptr<BlockHeader> topBlockPtr_;
@@ -6,14 +6,27 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <chrono>
+
 #include "BlockchainScanner.h"
 #include "log.h"
 #include "TxHashFilters.h"
 #include "TxOutScrRef.h"
+#include "BlockFilters.h"
+#include "Executor.h"
 
 using namespace std;
 using namespace Armory::Threading;
 
+namespace
+{
+   /////////////////////////////////////////////////////////////////////////////
+   double secondsSince(const chrono::steady_clock::time_point& start)
+   {
+      return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::scan(int32_t scanFrom)
 {
@@ -76,7 +89,28 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
 
    preloadUtxos();
 
-   auto scrRefMap = scrAddrFilter_->getOutScrRefMap();
+   auto scrRefTable = scrAddrFilter_->getOutScrRefTable();
+
+   //small address sets (side scans, rescans of a few wallets) only parse
+   //blocks whose script filter hits
+   useFilters_ = 
+      Armory::Config::DBSettings::blockFilters() &&
+      Armory::Config::DBSettings::getDbType() == ARMORY_DB_FULL &&
+      scrRefTable->size() <= BLOCKFILTER_QUERY_LIMIT;
+   skippedBlocks_.store(0, memory_order_relaxed);
+
+   scriptQuery_.clear();
+   if (useFilters_)
+   {
+      auto addrMap = scrAddrFilter_->getScanFilterAddrMap();
+      scriptQuery_.reserve(addrMap->size());
+      for (auto& addrPair : *addrMap)
+      {
+         if (addrPair.first.empty())
+            continue;
+         scriptQuery_.emplace_back(addrPair.first);
+      }
+   }
 
    //lambdas
    auto commitLambda = [this](void)
@@ -100,26 +134,56 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
    unsigned _count = 0;
    completedBatches_.store(0, memory_order_relaxed);
 
+   if (topBlock->getBlockHeight() - scanFrom > 100)
+   {
+      LOGINFO << "scan memory budget: " <<
+         batchController_.budget() / (1024 * 1024) << "MB, batch size: " <<
+         batchController_.batchSize() / (1024 * 1024) << "MB, queue depth: " <<
+         batchController_.queueDepth();
+   }
+
    //loop until there are no more blocks available
    try
    {
       unsigned firstBlockFileID = UINT32_MAX;
       unsigned targetBlockFileID = UINT32_MAX;
+      set<unsigned> memoryFileIDs;
+
+      auto tallyFileID = [&](unsigned fileID)->void
+      {
+         //in-memory blocks have ids of their own, past the blk files
+         if (MemoryBlockStore::isMemoryFileID(fileID))
+         {
+            memoryFileIDs.insert(fileID);
+            return;
+         }
+
+         if (fileID < firstBlockFileID)
+            firstBlockFileID = fileID;
+
+         if (fileID > targetBlockFileID)
+            targetBlockFileID = fileID;
+      };
 
       while (startHeight <= (int32_t)topBlock->getBlockHeight())
       {
          //figure out how many blocks to pull for this batch
-         //batches try to grab up nBlockFilesPerBatch_ worth of block data
+         //batches try to grab up to the controller's batch size worth of
+         //block data
          unsigned targetHeight = 0;
-         size_t targetSize = BATCH_SIZE;
-         size_t tallySize;
+         size_t targetSize = batchController_.batchSize();
+         size_t tallySize = 0;
+
+         firstBlockFileID = UINT32_MAX;
+         targetBlockFileID = 0;
+         memoryFileIDs.clear();
+
          try
          {
             shared_ptr<BlockHeader> currentHeader =
                blockchain_->getHeaderByHeight(startHeight, 0xFF);
-            firstBlockFileID = currentHeader->getBlockFileNum();
+            tallyFileID(currentHeader->getBlockFileNum());
 
-            targetBlockFileID = 0;
             targetHeight = startHeight;
 
             tallySize = currentHeader->getBlockSize();
@@ -128,12 +192,7 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
             {
                currentHeader = blockchain_->getHeaderByHeight(++targetHeight, 0xFF);
                tallySize += currentHeader->getBlockSize();
-
-               if (currentHeader->getBlockFileNum() < firstBlockFileID)
-                  firstBlockFileID = currentHeader->getBlockFileNum();
-
-               if (currentHeader->getBlockFileNum() > targetBlockFileID)
-                  targetBlockFileID = currentHeader->getBlockFileNum();
+               tallyFileID(currentHeader->getBlockFileNum());
             }
 
          }
@@ -150,8 +209,7 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
             else
             {
                targetHeight = topBlock->getBlockHeight();
-               if (targetBlockFileID < topBlock->getBlockFileNum())
-                  targetBlockFileID = topBlock->getBlockFileNum();
+               tallyFileID(topBlock->getBlockFileNum());
             }
          }
 
@@ -161,21 +219,25 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
          auto&& batch = make_unique<ParserBatch>(
             startHeight, endHeight,
             firstBlockFileID, targetBlockFileID,
-            scrRefMap);
+            scrRefTable);
+         batch->memoryFileIDs_ = memoryFileIDs;
 
 
          completedFutures.push_back(batch->completedPromise_.get_future());
          batch->count_ = _count;
+         batch->size_ = tallySize;
+         batchController_.batchQueued(tallySize);
 
          //post for txout parsing
          outputQueue_.push_back(move(batch));
+         auto queueDepth = batchController_.queueDepth();
          if (_count - completedBatches_.load(memory_order_relaxed) >= 
-            writeQueueDepth_)
+            queueDepth)
          {
             try
             {
                auto futIter = completedFutures.begin() + 
-                  (_count - writeQueueDepth_);
+                  (_count - queueDepth);
                futIter->wait();
             }
             catch (future_error &e)
@@ -220,11 +282,16 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
    {
       auto timeSpent = TIMER_READ_SEC("scan_nocheck");
       LOGINFO << "scanned transaction history in " << timeSpent << "s";
+      LOGINFO << "executor: " << Executor::shared().statsReport();
    }
 
    auto timeSpent = TIMER_READ_SEC("throttling");
    if (timeSpent > 5)
       LOGINFO << "throttling for " << timeSpent << "s";
+
+   auto skipped = skippedBlocks_.load(memory_order_relaxed);
+   if (skipped > 0)
+      LOGINFO << "skipped " << skipped << " blocks through script filters";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -234,11 +301,7 @@ void BlockchainScanner::processOutputs()
    TIMER_RESET("preload");
    TIMER_RESET("outputs");
 
-   auto process_thread = [this](ParserBatch* batch)->void
-   {
-      this->processOutputsThread(batch);
-   };
-
+   auto& executor = Executor::shared();
    map<unsigned, shared_ptr<BlockDataFileMap>> localFileMap;
 
    auto preloadBlockDataFiles = [&](ParserBatch* batch)->void
@@ -248,25 +311,37 @@ void BlockchainScanner::processOutputs()
 
       TIMER_START("preload");
 
-      auto file_id = batch->startBlockFileID_;
-      while (file_id <= batch->targetBlockFileID_)
+      //streamed blocks are read as they get parsed, no file to map
+      if (blockStream_ == nullptr)
       {
-         auto local_iter = localFileMap.find(file_id);
-         if (local_iter != localFileMap.end())
+         auto file_id = batch->startBlockFileID_;
+         while (file_id <= batch->targetBlockFileID_)
          {
-            batch->fileMaps_.insert(
-               make_pair(file_id, local_iter->second));
+            auto local_iter = localFileMap.find(file_id);
+            if (local_iter != localFileMap.end())
+            {
+               batch->fileMaps_.insert(
+                  make_pair(file_id, local_iter->second));
+            }
+            else
+            {
+               batch->fileMaps_.insert(
+                  make_pair(file_id, blockDataLoader_.get(file_id)));
+            }
+
+            ++file_id;
          }
-         else
+
+         for (auto& memory_id : batch->memoryFileIDs_)
          {
             batch->fileMaps_.insert(
-               make_pair(file_id, blockDataLoader_.get(file_id)));
+               make_pair(memory_id, blockDataLoader_.get(memory_id)));
          }
 
-         ++file_id;
+         localFileMap = batch->fileMaps_;
       }
 
-      localFileMap = batch->fileMaps_;
+      loadBlockFilters(batch);
 
       TIMER_STOP("preload");
    };
@@ -288,10 +363,19 @@ void BlockchainScanner::processOutputs()
 
    while (1)
    {
-      //start processing threads
-      vector<thread> thr_vec;
+      //start processing tasks
+      auto batchStart = chrono::steady_clock::now();
+      auto batchPtr = batch.get();
+      vector<future<void>> futures;
       for (unsigned i = 0; i < totalThreadCount_; i++)
-         thr_vec.push_back(thread(process_thread, batch.get()));
+      {
+         futures.emplace_back(executor.submit(
+            ExecutorWorkload_Scan, TaskPriority_Background,
+            [this, batchPtr](void)->void
+            {
+               this->processOutputsThread(batchPtr);
+            }));
+      }
 
       unique_ptr<ParserBatch> nextBatch;
 
@@ -310,12 +394,12 @@ void BlockchainScanner::processOutputs()
       //batch is being processed
       preloadBlockDataFiles(nextBatch.get());
 
-      //wait on threads
-      for (auto& thr : thr_vec)
-      {
-         if (thr.joinable())
-            thr.join();
-      }
+      //wait on tasks
+      for (auto& fut : futures)
+         executor.wait(fut);
+
+      batchController_.stageDone(
+         ScanStage_Outputs, batch->size_, secondsSince(batchStart));
       
       //push first batch for input processing
       inputQueue_.push_back(move(batch));
@@ -343,11 +427,6 @@ void BlockchainScanner::processInputs()
 {
    TIMER_RESET("inputs");
 
-   auto process_thread = [this](ParserBatch* batch)->void
-   {
-      this->processInputsThread(batch);
-   };
-
    while (1)
    {
       unique_ptr<ParserBatch> batch;
@@ -362,6 +441,7 @@ void BlockchainScanner::processInputs()
       }
 
       TIMER_START("inputs");
+      auto batchStart = chrono::steady_clock::now();
 
       //reset counter
       batch->blockCounter_.store(batch->start_, memory_order_relaxed);
@@ -381,19 +461,40 @@ void BlockchainScanner::processInputs()
             hash_map.second.begin(), hash_map.second.end());
       }
 
-      //start processing threads
-      vector<thread> thr_vec;
-      for (unsigned i = 1; i < totalThreadCount_; i++)
-         thr_vec.push_back(thread(process_thread, batch.get()));
-      process_thread(batch.get());
-
-      //wait on threads
-      for (auto& thr : thr_vec)
+      //blocks skipped at the output stage still have to be checked for
+      //spends of our utxos
+      if (useFilters_)
       {
-         if (thr.joinable())
-            thr.join();
+         size_t utxoCount = 0;
+         for (auto& hash_map : utxoMap_)
+            utxoCount += hash_map.second.size();
+
+         batch->parseAllSpends_ = utxoCount > BLOCKFILTER_QUERY_LIMIT;
+         if (!batch->parseAllSpends_)
+         {
+            batch->spendQuery_.reserve(utxoCount);
+            for (auto& hash_map : utxoMap_)
+            {
+               for (auto& utxo_pair : hash_map.second)
+               {
+                  BinaryWriter bw(36);
+                  bw.put_BinaryData(hash_map.first);
+                  bw.put_uint32_t(utxo_pair.first);
+                  batch->spendQuery_.emplace_back(bw.getData());
+               }
+            }
+         }
       }
 
+      //process the batch on the executor
+      auto batchPtr = batch.get();
+      Executor::shared().parallel(
+         ExecutorWorkload_Scan, TaskPriority_Background, totalThreadCount_,
+         [this, batchPtr](unsigned)->void
+         {
+            this->processInputsThread(batchPtr);
+         });
+
       //purge spent outputs from global map
       for (auto& spent_txout : batch->spentOutputs_)
       {
@@ -416,6 +517,9 @@ void BlockchainScanner::processInputs()
             utxoMap_.erase(hash_iter);
       }
 
+      batchController_.stageDone(
+         ScanStage_Inputs, batch->size_, secondsSince(batchStart));
+
       //push for commit
       commitQueue_.push_back(move(batch));
 
@@ -432,10 +536,41 @@ void BlockchainScanner::processInputs()
 shared_ptr<BlockData> BlockchainScanner::getBlockData(
    ParserBatch* batch, unsigned height)
 {
-   //grab block file map
    auto blockheader = blockchain_->getHeaderByHeight(height, 0xFF);
-   auto filenum = blockheader->getBlockFileNum();
-   auto mapIter = batch->fileMaps_.find(filenum);
+
+   auto getID = [blockheader](const BinaryData&)->unsigned int
+   {
+      return blockheader->getThisID();
+   };
+
+   if (blockStream_ != nullptr)
+   {
+      //read the block into a pooled buffer, the block data holds on to it
+      auto slice = blockStream_->read(*blockheader);
+
+      auto bdata = BlockData::deserialize(slice.data_, slice.size_,
+         blockheader, getID, BlockData::CheckHashes::NoChecks);
+      bdata->borrow(move(slice.owner_));
+      return bdata;
+   }
+
+   //grab block file map
+   auto pos = blockheader->getBlockFilePos();
+   auto mapIter = batch->fileMaps_.find(pos.fileNum_);
+   if (mapIter != batch->fileMaps_.end() &&
+      mapIter->second->getPtr() == nullptr &&
+      MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+   {
+      //in-memory block released ahead of the preload, it's on disk now
+      uint64_t offset;
+      auto filemap = blockDataLoader_.getForHeader(*blockheader, offset);
+      auto bdata = BlockData::deserialize(
+         filemap->getPtr() + offset, blockheader->getBlockSize(),
+         blockheader, getID, BlockData::CheckHashes::NoChecks);
+      bdata->borrow(filemap);
+      return bdata;
+   }
+
    if (mapIter == batch->fileMaps_.end())
    {
       LOGERR << "Missing file map for output scan, this is unexpected";
@@ -444,7 +579,7 @@ shared_ptr<BlockData> BlockchainScanner::getBlockData(
       for (auto& file_pair : batch->fileMaps_)
          LOGERR << " --- #" << file_pair.first;
 
-      LOGERR << "Was looking for id #" << filenum;
+      LOGERR << "Was looking for id #" << pos.fileNum_;
 
       throw runtime_error("missing file map");
    }
@@ -452,24 +587,54 @@ shared_ptr<BlockData> BlockchainScanner::getBlockData(
    auto filemap = mapIter->second.get();
 
    //find block and deserialize it
-   auto getID = [blockheader](const BinaryData&)->unsigned int
-   {
-      return blockheader->getThisID();
-   };
-
    auto bdata = BlockData::deserialize(
-      filemap->getPtr() + blockheader->getOffset(),
+      filemap->getPtr() + pos.offset_,
       blockheader->getBlockSize(),
       blockheader, getID, BlockData::CheckHashes::NoChecks);
    return bdata;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BlockchainScanner::loadBlockFilters(ParserBatch* batch)
+{
+   if (Armory::Config::DBSettings::getDbType() != ARMORY_DB_FULL)
+      return;
+
+   auto&& tx = db_->beginTransaction(TXFILTERS, LMDB::ReadOnly);
+   for (unsigned height = batch->start_; height <= batch->end_; height++)
+   {
+      auto header = blockchain_->getHeaderByHeight(height, 0xFF);
+      auto filterRef = db_->getBlockFilterRef(
+         header->getThisID(), header->getThisHashRef());
+      batch->blockFilters_.emplace(height, BinaryData(filterRef));
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool BlockchainScanner::filterMatch(const BlockHeader& header, 
+   const BinaryData& filterData, const vector<BinaryData>& query) const
+{
+   try
+   {
+      GolombFilter filter(header.getThisHashRef(), filterData.getRef());
+      return filter.matchAny(query);
+   }
+   catch (const BlockFilterException& e)
+   {
+      //can't trust a bad filter, parse the block
+      LOGWARN << "invalid filter for block #" << header.getBlockHeight() 
+         << ": " << e.what();
+      return true;
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::processOutputsThread(ParserBatch* batch)
 {
    map<unsigned, shared_ptr<BlockData>> blockMap;
    map<BinaryData, map<unsigned, StoredTxOut>> outputMap;
    map<BinaryData, map<BinaryData, StoredSubHistory>> sshMap;
+   map<uint32_t, pair<BinaryData, BinaryData>> newFilters;
 
    while (1)
    {
@@ -479,6 +644,22 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
       if (currentBlock > batch->end_)
          break;
 
+      auto filterIter = batch->blockFilters_.find(currentBlock);
+      bool hasFilter = filterIter != batch->blockFilters_.end() &&
+         !filterIter->second.empty();
+
+      if (useFilters_ && hasFilter)
+      {
+         auto header = blockchain_->getHeaderByHeight(currentBlock, 0xFF);
+         if (!filterMatch(*header, filterIter->second, scriptQuery_))
+         {
+            //no output of ours in there, the input stage will decide 
+            //whether it needs parsing for spends
+            skippedBlocks_.fetch_add(1, memory_order_relaxed);
+            continue;
+         }
+      }
+
       auto blockdata = getBlockData(batch, currentBlock);
       if (!blockdata->isInitialized())
       {
@@ -488,6 +669,13 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
 
       blockMap.insert(make_pair(currentBlock, blockdata));
 
+      //backfill filters for blocks that predate the filter index
+      if (filterIter != batch->blockFilters_.end() && !hasFilter)
+      {
+         newFilters.emplace(blockdata->uniqueID(), make_pair(
+            blockdata->getHash(), GolombFilter::buildForBlock(*blockdata)));
+      }
+
       //TODO: flag isMultisig
       const auto header = blockdata->header();
 
@@ -506,11 +694,11 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
             auto&& scrRef = BtcUtils::getTxOutScrAddrNoCopy(
                brr.get_BinaryDataRef(scriptSize));
 
-            auto saIter = batch->scriptRefMap_->find(scrRef);
-            if (saIter == batch->scriptRefMap_->end())
+            int scanHeight;
+            if (!batch->scriptRefTable_->find(scrRef, scanHeight))
                continue;
 
-            if (saIter->second >= (int)blockdata->header()->getBlockHeight())
+            if (scanHeight >= (int)blockdata->header()->getBlockHeight())
                continue;
 
             //if we got this far, this txout is ours
@@ -564,6 +752,7 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
 
    batch->blockMap_.insert(blockMap.begin(), blockMap.end());
    batch->outputMap_.insert(outputMap.begin(), outputMap.end());
+   batch->newFilters_.insert(newFilters.begin(), newFilters.end());
 
    for (auto& ssh_pair : sshMap)
    {
@@ -593,14 +782,35 @@ void BlockchainScanner::processInputsThread(ParserBatch* batch)
       if (currentBlock > batch->end_)
          break;
 
+      shared_ptr<BlockData> blockdata;
       auto blockdata_iter = batch->blockMap_.find(currentBlock);
-      if (blockdata_iter == batch->blockMap_.end())
+      if (blockdata_iter != batch->blockMap_.end())
       {
-         LOGERR << "can't find block #" << currentBlock << " in batch";
-         throw runtime_error("missing block");
+         blockdata = blockdata_iter->second;
       }
+      else
+      {
+         auto filterIter = batch->blockFilters_.find(currentBlock);
+         if (!useFilters_ || filterIter == batch->blockFilters_.end())
+         {
+            LOGERR << "can't find block #" << currentBlock << " in batch";
+            throw runtime_error("missing block");
+         }
+
+         //skipped at the output stage, only parse it if the filter
+         //carries one of our outpoints
+         if (!batch->parseAllSpends_)
+         {
+            if (batch->spendQuery_.empty())
+               continue;
 
-      auto blockdata = blockdata_iter->second;
+            auto header = blockchain_->getHeaderByHeight(currentBlock, 0xFF);
+            if (!filterMatch(*header, filterIter->second, batch->spendQuery_))
+               continue;
+         }
+
+         blockdata = getBlockData(batch, currentBlock);
+      }
 
       const auto header = blockdata->header();
       auto& txns = blockdata->getTxns();
@@ -723,9 +933,11 @@ void BlockchainScanner::writeBlockData()
 
    TIMER_RESET("write");
 
+   bool firstBatch = true;
    while (1)
    {
       unique_ptr<ParserBatch> batch;
+      auto waitStart = chrono::steady_clock::now();
       try
       {
          batch = move(commitQueue_.pop_front());
@@ -735,18 +947,22 @@ void BlockchainScanner::writeBlockData()
          break;
       }
 
+      //the wait on the first batch is the pipeline filling up, not the
+      //commit stage outpacing the parsers
+      if (!firstBatch)
+         batchController_.commitIdle(secondsSince(waitStart));
+      firstBatch = false;
+
       TIMER_START("write");
+      auto batchStart = chrono::steady_clock::now();
 
       //start txhint writer thread
       thread writeHintsThreadId = 
          thread(writeHintsLambda, batch.get());
 
-      //sanity check
-      if (batch->blockMap_.size() == 0)
-         continue;
-
-      //serialize data
-      auto topheader = batch->blockMap_.rbegin()->second->getHeaderPtr();
+      //blocks may have been skipped through filters, the batch still 
+      //covers its whole height range
+      auto topheader = blockchain_->getHeaderByHeight(batch->end_, 0xFF);
       if (topheader == nullptr)
       {
          LOGERR << "empty top block header ptr, aborting scan";
@@ -798,28 +1014,36 @@ void BlockchainScanner::writeBlockData()
       {
          //txouts
          auto&& tx = db_->beginTransaction(STXO, LMDB::ReadWrite);
+         auto&& bulkWriter = db_->getBulkWriter(STXO);
 
          for (auto& stxo : serializedStxo)
          { 
             //TODO: dont rewrite utxos, check if they are already in DB first
-            db_->putValue(STXO,
+            bulkWriter.putValue(
                stxo.first.getRef(),
                stxo.second.getDataRef());
          }
+
+         bulkWriter.commit();
       }
 
+      //filters for blocks that predate the index
+      db_->putBlockFilters(batch->newFilters_);
+
       {
          //subssh
          auto&& tx = db_->beginTransaction(SUBSSH, LMDB::ReadWrite);
+         auto&& bulkWriter = db_->getBulkWriter(SUBSSH);
 
          for (auto& subssh : serializedSubSSH)
          {
-            db_->putValue(
-               SUBSSH,
+            bulkWriter.putValue(
                subssh.first.getRef(),
                subssh.second.getDataRef());
          }
 
+         bulkWriter.commit();
+
          //update SUBSSH sdbi
          auto&& sdbi = scrAddrFilter_->getSubSshSDBI();
          sdbi.topBlkHgt_ = topheader->getBlockHeight();
@@ -850,6 +1074,10 @@ void BlockchainScanner::writeBlockData()
 
       topScannedBlockHash_ = topheader->getThisHash();
 
+      batchController_.stageDone(
+         ScanStage_Commit, batch->size_, secondsSince(batchStart));
+      batchController_.batchCommitted(batch->size_);
+
       completedBatches_.fetch_add(1, memory_order_relaxed);
       batch->completedPromise_.set_value(true);
 
@@ -1156,7 +1384,10 @@ void BlockchainScanner::updateSSH(bool force, int32_t startHeight)
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::preloadUtxos()
 {
-   //TODO: check utxos pulled vs scraddrfilter (to reduce dataset for side scans)
+   //only track utxos for the addresses this scan covers, side scans 
+   //would otherwise carry every other wallet's utxos
+   auto scrAddrMap = scrAddrFilter_->getScanFilterAddrMap();
+
    auto&& tx = db_->beginTransaction(STXO, LMDB::ReadOnly);
    auto dbIter = db_->getIterator(STXO);
    dbIter->seekToFirst();
@@ -1170,6 +1401,9 @@ void BlockchainScanner::preloadUtxos()
       if (stxo.spentness_ == TXOUT_SPENT)
          continue;
 
+      if (scrAddrMap->find(stxo.getScrAddress().getRef()) == scrAddrMap->end())
+         continue;
+
       stxo.parentHash_ = move(db_->getTxHashForLdbKey(
          stxo.getDBKeyOfParentTx(false)));
       auto& idMap = utxoMap_[stxo.parentHash_];
@@ -1209,21 +1443,31 @@ void BlockchainScanner::undo(Blockchain::ReorganizationState& reorgState)
          throw runtime_error("reorg failed while tracing back to "
          "branch point");
 
-      auto filenum = blockPtr->getBlockFileNum();
-      auto fileIter = fileMaps.find(filenum);
-      if (fileIter == fileMaps.end())
+      auto pos = blockPtr->getBlockFilePos();
+      shared_ptr<BlockDataFileMap> filemap;
+      uint64_t offset = pos.offset_;
+      if (MemoryBlockStore::isMemoryFileID(pos.fileNum_))
       {
-         fileIter = fileMaps.insert(make_pair(
-            filenum, blockDataLoader_.get(filenum))).first;
+         //in-memory blocks may move to disk, don't cache them
+         filemap = blockDataLoader_.getForHeader(*blockPtr, offset);
       }
+      else
+      {
+         auto fileIter = fileMaps.find(pos.fileNum_);
+         if (fileIter == fileMaps.end())
+         {
+            fileIter = fileMaps.insert(make_pair(
+               pos.fileNum_, blockDataLoader_.get(pos.fileNum_))).first;
+         }
 
-      auto filemap = fileIter->second;
+         filemap = fileIter->second;
+      }
 
       auto getID = [blockPtr]
          (const BinaryData&)->uint32_t {return blockPtr->getThisID(); };
 
       auto bdata = BlockData::deserialize(
-         filemap.get()->getPtr() + blockPtr->getOffset(),
+         filemap.get()->getPtr() + offset,
          blockPtr->getBlockSize(), blockPtr,
          getID, BlockData::CheckHashes::NoChecks);
 
@@ -1449,6 +1693,14 @@ void BlockchainScanner::processFilterHitsThread(
             continue;
          }
 
+         //filter pools are per blk file, the header has to point there
+         auto pos = headerPtr->getBlockFilePos();
+         if (pos.fileNum_ != fileNum)
+         {
+            missedBlocks++;
+            continue;
+         }
+
          auto& filterSet = blockkey.second;
 
          auto getID = [headerPtr](const BinaryData&)->unsigned int
@@ -1459,7 +1711,7 @@ void BlockchainScanner::processFilterHitsThread(
          try
          {
             bdata = BlockData::deserialize(
-               fileptr->getPtr() + headerPtr->getOffset(),
+               fileptr->getPtr() + pos.offset_,
                headerPtr->getBlockSize(),
                headerPtr, getID, BlockData::CheckHashes::NoChecks);
          }
@@ -1674,7 +1926,6 @@ bool BlockchainScanner::resolveTxHashes()
    atomic<int> counter;
    counter.store(resultMap.size() - 1, memory_order_relaxed);
    map<BinaryData, BinaryData> resolverResults;
-   vector<thread> resolverThreads;
 
    auto hashCount = missingHashSet.size();
    ProgressCalculator calc(hashCount);
@@ -1700,7 +1951,7 @@ bool BlockchainScanner::resolveTxHashes()
          calc.fractionCompleted(), calc.remainingSeconds(), count);
    };
 
-   auto resolverThr = [&](void)->void
+   auto resolverThr = [&](unsigned)->void
    {
       processFilterHitsThread(resultsByHash,
          missingHashSet,
@@ -1710,17 +1961,8 @@ bool BlockchainScanner::resolveTxHashes()
    if (reportProgress_)
       progress_(BDMPhase_ResolveHashes, 0, UINT32_MAX, 0);
 
-
-   for (unsigned i = 1; i < totalThreadCount_; i++)
-      resolverThreads.push_back(thread(resolverThr));
-
-   resolverThr();
-
-   for (auto& thr : resolverThreads)
-   {
-      if (thr.joinable())
-         thr.join();
-   }
+   Executor::shared().parallel(ExecutorWorkload_Scan,
+      TaskPriority_Background, totalThreadCount_, resolverThr);
 
    //write the resolved hashes
    {
@@ -18,13 +18,13 @@
 #include "ThreadSafeClasses.h"
 
 #include "SshParser.h"
+#include "ScanBatchController.h"
+#include "BlockStream.h"
 
 #include <future>
 #include <atomic>
 #include <exception>
 
-#define BATCH_SIZE  1024 * 1024 * 512ULL
-
 class ScanningException : public std::runtime_error
 {
 private:
@@ -54,22 +54,40 @@ public:
    const unsigned startBlockFileID_;
    const unsigned targetBlockFileID_;
 
+   //blocks from the node that aren't in the blk files yet
+   std::set<unsigned> memoryFileIDs_;
+
+   //raw block data size
+   size_t size_ = 0;
+
    std::map<unsigned, std::shared_ptr<BlockData>> blockMap_;
    std::map<BinaryData, std::map<unsigned, StoredTxOut>> outputMap_;
    std::map<BinaryData, std::map<BinaryData, StoredSubHistory>> sshMap_;
    std::vector<StoredTxOut> spentOutputs_;
 
-   const std::shared_ptr<std::unordered_map<TxOutScriptRef, int>> scriptRefMap_;
+   //script filters by height, empty for blocks without one in the db or
+   //with one that was written for another block hash
+   std::map<unsigned, BinaryData> blockFilters_;
+
+   //filters built for blocks that had none, block id: (block hash, filter)
+   std::map<uint32_t, std::pair<BinaryData, BinaryData>> newFilters_;
+
+   //tracked outpoints as of the input stage, checked against the filters
+   //of blocks skipped at the output stage
+   std::vector<BinaryData> spendQuery_;
+   bool parseAllSpends_ = false;
+
+   const std::shared_ptr<const ScriptRefTable> scriptRefTable_;
    std::promise<bool> completedPromise_;
    unsigned count_;
 
 public:
    ParserBatch(unsigned start, unsigned end,
       unsigned startID, unsigned endID,
-      std::shared_ptr<std::unordered_map<TxOutScriptRef, int>> scriptRefMap) :
+      std::shared_ptr<const ScriptRefTable> scriptRefTable) :
       start_(start), end_(end), 
       startBlockFileID_(startID), targetBlockFileID_(endID),
-      scriptRefMap_(scriptRefMap)
+      scriptRefTable_(scriptRefTable)
    {
       if (end < start)
          throw std::runtime_error("end > start");
@@ -87,8 +105,11 @@ private:
    ScrAddrFilter* scrAddrFilter_;
    BlockDataLoader blockDataLoader_;
 
+   //set when blocks are streamed rather than mapped with their files
+   std::unique_ptr<BlockStreamReader> blockStream_;
+
    const unsigned totalThreadCount_;
-   const unsigned writeQueueDepth_;
+   ScanBatchController batchController_;
    const unsigned totalBlockFileCount_;
 
    BinaryData topScannedBlockHash_;
@@ -110,6 +131,11 @@ private:
 
    std::atomic<unsigned> completedBatches_;
 
+   //only parse blocks whose filter matches the tracked scripts or outpoints
+   bool useFilters_ = false;
+   std::vector<BinaryData> scriptQuery_;
+   std::atomic<unsigned> skippedBlocks_;
+
 private:
    void writeBlockData(void);
    void processAndCommitTxHints(ParserBatch*);
@@ -127,6 +153,10 @@ private:
    std::shared_ptr<BlockData> getBlockData(
       ParserBatch*, unsigned);
 
+   void loadBlockFilters(ParserBatch*);
+   bool filterMatch(const BlockHeader&, const BinaryData&,
+      const std::vector<BinaryData>&) const;
+
    void processOutputs(void);
    void processOutputsThread(ParserBatch*);
 
@@ -138,14 +168,22 @@ public:
    BlockchainScanner(std::shared_ptr<Blockchain> bc, LMDBBlockDatabase* db,
       ScrAddrFilter* saf,
       BlockFiles& bf,
-      unsigned threadcount, unsigned queue_depth, 
+      unsigned threadcount, unsigned ramUsage, 
       ProgressCallback prg, bool reportProgress) :
       blockchain_(bc), db_(db), scrAddrFilter_(saf),
       blockDataLoader_(bf.folderPath()),
-      totalThreadCount_(threadcount), writeQueueDepth_(queue_depth),
+      totalThreadCount_(threadcount), batchController_(ramUsage),
       totalBlockFileCount_(bf.fileCount()),
       progress_(prg), reportProgress_(reportProgress)
-   {}
+   {
+      if (Armory::Config::DBSettings::streamBlocks())
+      {
+         //free buffers are kept up to the scan's memory budget
+         auto poolSize = batchController_.budget() / BLOCK_STREAM_BUFFER_SIZE;
+         blockStream_ = std::make_unique<BlockStreamReader>(
+            bf.folderPath(), std::max((unsigned)poolSize, 1U));
+      }
+   }
 
    void scan(int32_t startHeight);
    void scan_nocheck(int32_t startHeight);
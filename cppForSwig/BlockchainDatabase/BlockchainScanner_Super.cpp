@@ -132,7 +132,7 @@ void BlockchainScanner_Super::scan()
          auto blockDataBatch = make_unique<BlockDataBatch>(
             startHeight, endHeight, blockFileIDs, 
             BD_ORDER_INCREMENT,
-            &blockDataLoader_, blockchain_);
+            &blockDataLoader_, blockchain_, blockStream_.get());
          auto batch = make_unique<ParserBatch_Ssh>(move(blockDataBatch));
 
          shared_future<bool> batch_fut = batch->completedPromise_.get_future();
@@ -898,7 +898,7 @@ void BlockchainScanner_Super::scanSpentness()
       auto blockDataBatch = make_unique<BlockDataBatch>(
          start, currentHeader->getBlockHeight(), blockFileIDs,
          BD_ORDER_DECREMENT,
-         &blockDataLoader_, blockchain_);
+         &blockDataLoader_, blockchain_, blockStream_.get());
       auto batch = make_unique<ParserBatch_Spentness>(move(blockDataBatch));
       batchFutures.push_back(batch->prom_.get_future());
 
@@ -1382,10 +1382,14 @@ void BlockDataBatch::populateFileMap()
    if (blockDataFileIDs_.size() == 0)
       return;
 
-   for(auto& id : blockDataFileIDs_)
+   //streamed blocks are read as they get parsed, no file to map
+   if (blockStream_ == nullptr)
    {
-      fileMaps_.insert(
-         make_pair(id, blockDataLoader_->get(id)));
+      for(auto& id : blockDataFileIDs_)
+      {
+         fileMaps_.insert(
+            make_pair(id, blockDataLoader_->get(id)));
+      }
    }
 
    auto begin = min(start_, end_);
@@ -1417,33 +1421,45 @@ shared_ptr<BlockData> BlockDataBatch::getBlockData(unsigned height)
       return blockIter->second;
 
    auto blockheader = blockchain_->getHeaderByHeight(height, 0xFF);
-   auto filenum = blockheader->getBlockFileNum();
-   auto mapIter = fileMaps_.find(filenum);
-   if (mapIter == fileMaps_.end())
+   auto getID = [blockheader](const BinaryData&)->unsigned int
    {
-      LOGERR << "Missing file map for output scan, this is unexpected";
+      return blockheader->getThisID();
+   };
 
-      LOGERR << "Has the following block files:";
-      for (auto& file_pair : fileMaps_)
-         LOGERR << " --- #" << file_pair.first;
+   shared_ptr<BlockData> bdata;
+   if (blockStream_ != nullptr)
+   {
+      //read the block into a pooled buffer, the block data holds on to it
+      auto slice = blockStream_->read(*blockheader);
+      bdata = BlockData::deserialize(slice.data_, slice.size_,
+         blockheader, getID, BlockData::CheckHashes::NoChecks);
+      bdata->borrow(move(slice.owner_));
+   }
+   else
+   {
+      auto filenum = blockheader->getBlockFileNum();
+      auto mapIter = fileMaps_.find(filenum);
+      if (mapIter == fileMaps_.end())
+      {
+         LOGERR << "Missing file map for output scan, this is unexpected";
 
-      LOGERR << "Was looking for id #" << filenum;
+         LOGERR << "Has the following block files:";
+         for (auto& file_pair : fileMaps_)
+            LOGERR << " --- #" << file_pair.first;
 
-      throw runtime_error("missing file map");
-   }
+         LOGERR << "Was looking for id #" << filenum;
 
-   auto filemap = mapIter->second.get();
+         throw runtime_error("missing file map");
+      }
 
-   //find block and deserialize it
-   auto getID = [blockheader](const BinaryData&)->unsigned int
-   {
-      return blockheader->getThisID();
-   };
+      auto filemap = mapIter->second.get();
 
-   auto bdata = BlockData::deserialize(
-      filemap->getPtr() + blockheader->getOffset(),
-      blockheader->getBlockSize(),
-      blockheader, getID, BlockData::CheckHashes::NoChecks);
+      //find block and deserialize it
+      bdata = BlockData::deserialize(
+         filemap->getPtr() + blockheader->getOffset(),
+         blockheader->getBlockSize(),
+         blockheader, getID, BlockData::CheckHashes::NoChecks);
+   }
 
    if (!bdata->isInitialized())
    {
@@ -17,6 +17,8 @@
 #include "ThreadSafeClasses.h"
 
 #include "SshParser.h"
+#include "ScanBatchController.h"
+#include "BlockStream.h"
 
 #include <future>
 #include <atomic>
@@ -59,12 +61,16 @@ struct BlockDataBatch
    BlockDataLoader* blockDataLoader_;
    std::shared_ptr<Blockchain> blockchain_;
 
+   //blocks are read into pooled buffers rather than mapped with their file
+   BlockStreamReader* blockStream_;
+
    BlockDataBatch(int start, int end, std::set<unsigned>& ids,
       BLOCKDATA_ORDER order,
-      BlockDataLoader* bdl, std::shared_ptr<Blockchain> bcPtr) :
+      BlockDataLoader* bdl, std::shared_ptr<Blockchain> bcPtr,
+      BlockStreamReader* blockStream = nullptr) :
       order_(order),
       start_(start), end_(end), blockDataFileIDs_(std::move(ids)),
-      blockDataLoader_(bdl), blockchain_(bcPtr)
+      blockDataLoader_(bdl), blockchain_(bcPtr), blockStream_(blockStream)
    {}
 
    void populateFileMap(void);
@@ -166,6 +172,9 @@ private:
    LMDBBlockDatabase* db_;
    BlockDataLoader blockDataLoader_;
 
+   //set when blocks are streamed rather than mapped with their files
+   std::unique_ptr<BlockStreamReader> blockStream_;
+
    Armory::Threading::BlockingQueue<
       std::unique_ptr<ParserBatch_Ssh>> commitQueue_;
    Armory::Threading::BlockingQueue<
@@ -220,14 +229,24 @@ public:
    BlockchainScanner_Super(
       std::shared_ptr<Blockchain> bc, LMDBBlockDatabase* db,
       BlockFiles& bf, bool init,
-      unsigned threadcount, unsigned,
+      unsigned threadcount, unsigned ramUsage,
       ProgressCallback prg, bool reportProgress) :
       init_(init), blockchain_(bc), db_(db),
       blockDataLoader_(bf.folderPath()),
       totalThreadCount_(threadcount), writeQueueDepth_(1/*queue_depth*/),
       totalBlockFileCount_(bf.fileCount()),
       progress_(prg), reportProgress_(reportProgress)
-   {}
+   {
+      if (Armory::Config::DBSettings::streamBlocks())
+      {
+         //free buffers are kept up to the --ram-usage budget. Undo still
+         //maps the files it reads from
+         auto poolSize = (std::max(ramUsage, 1U) * SCAN_RAM_LEVEL_SIZE) / 
+            BLOCK_STREAM_BUFFER_SIZE;
+         blockStream_ = std::make_unique<BlockStreamReader>(
+            bf.folderPath(), std::max((unsigned)poolSize, 1U));
+      }
+   }
 
    void scan(void);
    void scanSpentness(void);
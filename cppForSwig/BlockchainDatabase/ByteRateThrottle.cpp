@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <thread>
+
+#include "ByteRateThrottle.h"
+
+//longest single sleep, so that halt() is noticed promptly
+#define THROTTLE_SLEEP_SLICE_MS 100
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+ByteRateThrottle::ByteRateThrottle(uint64_t bytesPerSecond) :
+   rate_(bytesPerSecond), last_(chrono::steady_clock::now())
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ByteRateThrottle::consume(size_t size)
+{
+   if (halted())
+      return false;
+
+   if (rate_ == 0)
+      return true;
+
+   double wait = 0;
+   {
+      unique_lock<mutex> lock(mu_);
+
+      //refill, capped at a second worth of data
+      auto now = chrono::steady_clock::now();
+      auto elapsed = chrono::duration<double>(now - last_).count();
+      last_ = now;
+      available_ = min(available_ + elapsed * rate_, double(rate_));
+
+      //take the bytes now, sleep off the debt outside the lock. Threads
+      //coming in after this one queue up behind the debt
+      available_ -= size;
+      if (available_ < 0)
+         wait = -available_ / rate_;
+   }
+
+   auto deadline = chrono::steady_clock::now() +
+      chrono::duration_cast<chrono::steady_clock::duration>(
+         chrono::duration<double>(wait));
+
+   while (chrono::steady_clock::now() < deadline)
+   {
+      if (halted())
+         return false;
+
+      auto slice = min(
+         chrono::duration_cast<chrono::milliseconds>(
+            deadline - chrono::steady_clock::now()) + chrono::milliseconds(1),
+         chrono::milliseconds(THROTTLE_SLEEP_SLICE_MS));
+      this_thread::sleep_for(slice);
+   }
+
+   return !halted();
+}
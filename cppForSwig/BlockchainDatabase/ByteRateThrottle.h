@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _BYTERATETHROTTLE_H_
+#define _BYTERATETHROTTLE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+////////////////////////////////////////////////////////////////////////////////
+class ByteRateThrottle
+{
+   /***
+   Caps the rate at which a set of threads goes through data, in bytes per
+   second. Each thread reports what it is about to process and sleeps off
+   whatever exceeds the rate. Up to a second worth of unused rate carries
+   over, so short stalls don't slow the pass down.
+
+   A rate of 0 disables the throttle. halt() wakes up sleepers for good,
+   consume() returns false from there on.
+   ***/
+
+private:
+   const uint64_t rate_;
+
+   std::mutex mu_;
+   double available_ = 0;
+   std::chrono::steady_clock::time_point last_;
+
+   std::atomic<bool> halted_ = { false };
+
+public:
+   ByteRateThrottle(uint64_t bytesPerSecond);
+
+   //blocks until size bytes fit in the rate, false if halted
+   bool consume(size_t size);
+
+   void halt(void) { halted_.store(true, std::memory_order_relaxed); }
+   bool halted(void) const { return halted_.load(std::memory_order_relaxed); }
+
+   uint64_t rate(void) const { return rate_; }
+};
+
+#endif
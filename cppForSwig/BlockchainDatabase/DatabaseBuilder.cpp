@@ -13,11 +13,91 @@
 #include "ScrAddrFilter.h"
 #include "Transactions.h"
 #include "TxHashFilters.h"
+#include "BlockFilters.h"
+#include "Executor.h"
 
 #define REWIND_COUNT 100
 
+//block file maps a tx verification thread keeps around to resolve outputs
+#define VERIFY_FILEMAP_CACHE 32
+
 using namespace std;
 using namespace Armory::Config;
+using namespace Armory::Threading;
+
+namespace
+{
+   //////////////////////////////////////////////////////////////////////////
+   class VerificationProgress
+   {
+      /***
+      Progress of an integrity pass, shared by its threads. Reports at most
+      once a second, a thread that finds another one reporting skips it.
+      ***/
+
+   private:
+      const ProgressCallback& callback_;
+      ProgressCalculator calc_;
+
+      atomic<uint64_t> done_ = { 0 };
+
+      mutex mu_;
+      uint64_t lastReported_ = 0;
+      chrono::steady_clock::time_point lastReport_;
+
+   private:
+      void report(uint64_t done)
+      {
+         calc_.advance(done);
+
+         unsigned remaining = UINT32_MAX;
+         if (calc_.unitsPerSecond() > 0)
+         {
+            remaining = (unsigned)min(
+               calc_.remainingSeconds(), (uint64_t)UINT32_MAX);
+         }
+
+         callback_(BDMPhase_Verification,
+            calc_.fractionCompleted(), remaining, done);
+      }
+
+   public:
+      VerificationProgress(const ProgressCallback& callback, uint64_t total) :
+         callback_(callback), calc_(total)
+      {
+         if (callback_)
+            callback_(BDMPhase_Verification, 0, UINT32_MAX, 0);
+      }
+
+      void advance(uint64_t count)
+      {
+         auto done = done_.fetch_add(count, memory_order_relaxed) + count;
+         if (!callback_)
+            return;
+
+         unique_lock<mutex> lock(mu_, defer_lock);
+         if (!lock.try_lock())
+            return;
+
+         auto now = chrono::steady_clock::now();
+         if (done <= lastReported_ || now - lastReport_ < chrono::seconds(1))
+            return;
+
+         lastReported_ = done;
+         lastReport_ = now;
+         report(done);
+      }
+
+      void finish(void)
+      {
+         if (!callback_)
+            return;
+
+         unique_lock<mutex> lock(mu_);
+         report(done_.load(memory_order_relaxed));
+      }
+   };
+}
 
 /////////////////////////////////////////////////////////////////////////////
 void dumpBlock(
@@ -68,7 +148,8 @@ DatabaseBuilder::DatabaseBuilder(BlockFiles& blockFiles,
    : blockFiles_(blockFiles), blockchain_(bdm.blockchain()),
    db_(bdm.getIFace()), scrAddrFilter_(bdm.getScrAddrFilter()),
    progress_(progress), topBlockOffset_(0, 0),
-   forceRescanSSH_(forceRescanSSH)
+   forceRescanSSH_(forceRescanSSH),
+   verifyThrottle_(DBSettings::verifyRate() * 1024ULL * 1024ULL)
 {}
 
 /////////////////////////////////////////////////////////////////////////////
@@ -107,6 +188,12 @@ void DatabaseBuilder::init()
          rewindHeight = 1;
 
       auto rewindBlock = blockchain_->getHeaderByHeight(rewindHeight, 0xFF);
+      while (MemoryBlockStore::isMemoryFileID(rewindBlock->getBlockFileNum()) &&
+         rewindHeight > 1)
+      {
+         rewindBlock = blockchain_->getHeaderByHeight(--rewindHeight, 0xFF);
+      }
+
       topBlockOffset_.fileID_ = rewindBlock->getBlockFileNum();
       topBlockOffset_.offset_ = rewindBlock->getOffset();
 
@@ -124,9 +211,13 @@ void DatabaseBuilder::init()
    TIMER_STOP("updateblocksindb");
    double updatetime = TIMER_READ_SEC("updateblocksindb");
    LOGINFO << "updated HEADERS db in " << updatetime << "s";
-
-   if (DBSettings::checkTxHints())
-      checkTxHintsIntegrity();
+   LOGINFO << "TXHINTS db size: " << 
+      db_->getDbUsedSize(TXHINTS) / (1024 * 1024) << "MB";
+   if (DBSettings::getDbType() == ARMORY_DB_SUPER)
+   {
+      LOGINFO << "STXO db size: " << 
+         db_->getDbUsedSize(STXO) / (1024 * 1024) << "MB";
+   }
 
    cycleDatabases();
 
@@ -217,6 +308,8 @@ void DatabaseBuilder::init()
       //get fileID for height
       auto topHeader = blockchain_->getHeaderByHeight(sdbi.topBlkHgt_, 0xFF);
       int fileID = topHeader->getBlockFileNum();
+      if (MemoryBlockStore::isMemoryFileID(fileID))
+         fileID = blockFiles_.fileCount() - 1;
       
       //rewind 5 blk files for the good measure
       fileID -= 5;
@@ -248,6 +341,7 @@ BlockOffset DatabaseBuilder::loadBlockHeadersFromDB(
 
    LOGINFO << "Reading headers from db";
    blockchain_->clear();
+   unplacedHeaders_.clear();
 
    unsigned counter = 0;
    BlockOffset topBlockOffet(0, 0);
@@ -271,9 +365,19 @@ BlockOffset DatabaseBuilder::loadBlockHeadersFromDB(
       h->setDuplicateID(dup);
       headerMap.insert(make_pair(h->getThisHash(), h));
 
-      BlockOffset currblock(h->getBlockFileNum(), h->getOffset());
-      if (currblock > topBlockOffet)
-         topBlockOffet = currblock;
+      //Blocks that were in memory at shutdown have no position, the blk
+      //file parse points their headers at the disk copy
+      auto pos = h->getBlockFilePos();
+      if (MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+      {
+         unplacedHeaders_.emplace(h->getThisHash(), h);
+      }
+      else
+      {
+         BlockOffset currblock(pos.fileNum_, pos.offset_);
+         if (currblock > topBlockOffet)
+            topBlockOffet = currblock;
+      }
 
       if ((counter++ % 50000) != 0)
          return;
@@ -286,8 +390,16 @@ BlockOffset DatabaseBuilder::loadBlockHeadersFromDB(
          calc.fractionCompleted(), calc.remainingSeconds(), counter);
    };
 
-   db_->readAllHeaders(callback);
-   LOGINFO << "grabbed all headers in db";
+   if (HeaderSnapshot::read(
+      HeaderSnapshot::getPath(), *blockchain_, db_, callback))
+   {
+      LOGINFO << "grabbed all headers from snapshot";
+   }
+   else
+   {
+      db_->readAllHeaders(callback);
+      LOGINFO << "grabbed all headers in db";
+   }
    blockchain_->addBlocksInBulk(headerMap, false);
 
    LOGINFO << "Found " << headerMap.size() << " headers in db";
@@ -301,6 +413,7 @@ Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
 {
    //preload and prefetch
    BlockDataLoader bdl(blockFiles_.folderPath());
+   loadMemoryHeaders();
 
    unsigned threadcount = min(DBSettings::threadCount(),
       blockFiles_.fileCount() - topBlockOffset_.fileID_);
@@ -376,6 +489,13 @@ Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
          topBlockOffset_ = *blockoffset;
    }
 
+   reconcileMemoryBlocks();
+
+   //pick up blocks the node sent that aren't on disk yet. Supernode
+   //commits hints and stxos from the blk files, it waits on those
+   if (!fullHints)
+      addMemoryBlocks();
+
    //done parsing new blocks, reorg and add to DB
    if (verbose)
       progress_(BDMPhase_OrganizingChain, 0, UINT32_MAX, 0);
@@ -385,6 +505,101 @@ Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
    return reorgState;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::loadMemoryHeaders()
+{
+   memoryHeaders_ = unplacedHeaders_;
+
+   auto&& blocks = MemoryBlockStore::shared().getBlocks();
+   for (auto& block : blocks)
+   {
+      try
+      {
+         auto header = blockchain_->getHeaderByHash(block.second->getHash());
+         if (header->getBlockFileNum() == block.first)
+            memoryHeaders_.emplace(header->getThisHash(), header);
+      }
+      catch (range_error&)
+      {
+         //not ingested yet
+      }
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::reconcileMemoryBlocks()
+{
+   auto& store = MemoryBlockStore::shared();
+   for (auto& header : reconciledHeaders_)
+   {
+      //headers without a height were never written
+      if (header->getBlockHeight() != UINT32_MAX)
+      {
+         StoredHeader sbh;
+         sbh.createFromBlockHeader(*header);
+         db_->putBareHeader(sbh, false, false);
+      }
+
+      store.remove(header->getThisHash());
+      unplacedHeaders_.erase(header->getThisHash());
+   }
+
+   if (!reconciledHeaders_.empty())
+   {
+      LOGINFO << "found " << reconciledHeaders_.size() <<
+         " in-memory block(s) in the blk files";
+   }
+
+   if (!unplacedHeaders_.empty())
+   {
+      LOGWARN << unplacedHeaders_.size() << " block(s) ingested from " <<
+         "memory before the last shutdown are missing from the blk files";
+   }
+
+   reconciledHeaders_.clear();
+   memoryHeaders_.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+unsigned DatabaseBuilder::addMemoryBlocks()
+{
+   /***
+   Adds the blocks the node sent over p2p to the chain, under their in-memory
+   file id, for the ones the blk files haven't yielded yet. The scanner reads
+   them from the store, the next blk file parse moves them to disk.
+   ***/
+
+   auto& store = MemoryBlockStore::shared();
+   auto&& blocks = store.getBlocks();
+
+   map<BinaryData, shared_ptr<BlockHeader>> bhmap;
+   for (auto& block : blocks)
+   {
+      auto& hash = block.second->getHash();
+      if (blockchain_->hasHeaderWithHash(hash))
+      {
+         //got to it through the blk files first
+         auto header = blockchain_->getHeaderByHash(hash);
+         if (header->getBlockFileNum() != block.first)
+            store.remove(hash);
+
+         continue;
+      }
+
+      auto bh = block.second->createBlockHeader();
+      bhmap.emplace(bh->getThisHash(), bh);
+   }
+
+   if (bhmap.empty())
+      return 0;
+
+   auto insertedBlocks = blockchain_->addBlocksInBulk(bhmap, true);
+   LOGINFO << "ingested " << insertedBlocks.size() <<
+      " block(s) from the node ahead of the blk files";
+
+   return insertedBlocks.size();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
    uint16_t fileID, size_t startOffset, shared_ptr<BlockOffset> bo,
@@ -399,8 +614,13 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
 
    map<uint32_t, shared_ptr<BlockData>> bdMap;
 
-   auto getID = [&](const BinaryData&)->uint32_t
+   auto getID = [&](const BinaryData& hash)->uint32_t
    {
+      //blocks already ingested from memory keep their id
+      auto iter = memoryHeaders_.find(hash);
+      if (iter != memoryHeaders_.end())
+         return iter->second->getThisID();
+
       return blockchain_->getNewUniqueID();
    };
 
@@ -464,6 +684,29 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
    //add in bulk
    auto insertedBlocks = blockchain_->addBlocksInBulk(bhmap, true);
 
+   //Blocks ingested from memory are already in the chain. Point their
+   //headers at the blk file and let them into this file's filters.
+   auto filterBlocks = insertedBlocks;
+   if (!memoryHeaders_.empty())
+   {
+      for (auto& bh : bhmap)
+      {
+         auto iter = memoryHeaders_.find(bh.first);
+         if (iter == memoryHeaders_.end())
+            continue;
+
+         //readers see either the memory or the blk file position, never
+         //a mix of both
+         auto& header = iter->second;
+         auto pos = bh.second->getBlockFilePos();
+         header->setBlockFilePos(pos.fileNum_, pos.offset_);
+         filterBlocks.insert(header->getThisID());
+
+         unique_lock<mutex> lock(reconcileMutex_);
+         reconciledHeaders_.push_back(header);
+      }
+   }
+
    if (!fullHints)
    {
       //process filters
@@ -472,7 +715,7 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
          //pull existing file filter bucket from db (if any)
          auto pool = db_->getFilterPoolWriter(fileID);
 
-         if (insertedBlocks.empty())
+         if (filterBlocks.empty())
          {
             if (pool.isValid())
             {
@@ -488,14 +731,27 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
 
          //tally all block filters
          map<uint32_t, shared_ptr<BlockHashVector>> allFilters;
-         for (auto& bdId : insertedBlocks)
+         for (auto& bdId : filterBlocks)
             allFilters.emplace(bdId, bdMap[bdId]->getTxFilter());
 
          //update bucket
          pool.update(allFilters);
 
-         //update db entry
+         //script filters, lets side scans skip irrelevant blocks
+         map<uint32_t, pair<BinaryData, BinaryData>> blockFilters;
+         for (auto& bdId : filterBlocks)
+         {
+            auto& blockdata = *bdMap[bdId];
+            blockFilters.emplace(bdId, make_pair(
+               blockdata.getHash(), GolombFilter::buildForBlock(blockdata)));
+         }
+
+         //The file's pool and its block filters go in a single commit.
+         //Block filters are batched through the bulk writer, the pool is
+         //one key.
+         auto&& filterTx = db_->beginTransaction(TXFILTERS, LMDB::ReadWrite);
          db_->putFilterPoolForFileNum(fileID, pool);
+         db_->putBlockFilters(blockFilters);
       }
    }
    else
@@ -735,17 +991,12 @@ bool DatabaseBuilder::reparseBlkFiles(unsigned fromID)
    unsigned threadcount = min(DBSettings::threadCount(),
       blockFiles_.fileCount() - topBlockOffset_.fileID_);
 
-   vector<thread> tIDs;
-   for (unsigned i = 1; i < threadcount; i++)
-      tIDs.push_back(thread(assessLambda, fromID + i));
-
-   assessLambda(fromID);
-
-   for (auto& tID : tIDs)
-   {
-      if (tID.joinable())
-         tID.join();
-   }
+   Executor::shared().parallel(
+      ExecutorWorkload_Scan, TaskPriority_Background, threadcount,
+      [&assessLambda, fromID](unsigned i)->void
+      {
+         assessLambda(fromID + i);
+      });
 
    //headerMap contains blocks that are either missing from our blockchain 
    //object or are recorded under invalid fileID/offset. Lets forcefully add
@@ -849,8 +1100,8 @@ map<BinaryData, shared_ptr<BlockHeader>> DatabaseBuilder::assessBlkFile(
 void DatabaseBuilder::verifyChain()
 {
    /*
-   builds db (no scanning) with full txhints, then verifies all tx 
-   (consensus and sigs).
+   builds db (no scanning) with full txhints. The tx are verified once the 
+   db is ready, see verifyTransactions.
    */
 
    //list all files in block data folder
@@ -870,9 +1121,6 @@ void DatabaseBuilder::verifyChain()
    auto reorgState = updateBlocksInDB(
       progress_, DBSettings::reportProgress(), true);
    LOGINFO << "updated HEADERS db";
-
-   //verify transactions
-   verifyTransactions();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -948,15 +1196,17 @@ void DatabaseBuilder::commitAllTxHints(
       txhint.second.serializeDBValue(bw);
    }
 
-   //write
+   //write, hint keys are hash prefixes and land all over the db, feeding 
+   //them sorted keeps page splits local
+   auto&& bulkWriter = db_->getBulkWriter(TXHINTS);
+   for (const auto& txhint : serializedHints)
    {
-      for (const auto& txhint : serializedHints)
-      {
-         db_->putValue(TXHINTS,
-            txhint.first.getRef(),
-            txhint.second.getDataRef());
-      }
+      bulkWriter.putValue(
+         txhint.first.getRef(),
+         txhint.second.getDataRef());
    }
+
+   bulkWriter.commit();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -1013,6 +1263,7 @@ void DatabaseBuilder::commitAllStxos(
    }
 
    auto&& tx = db_->beginTransaction(STXO, LMDB::ReadWrite);
+   auto&& bulkWriter = db_->getBulkWriter(STXO);
 
    for (auto& bwPair : serializedStxos)
    {
@@ -1028,13 +1279,22 @@ void DatabaseBuilder::commitAllStxos(
          }
       }
 
-      db_->putValue(
-         STXO, bwPair.first.getRef(), bwPair.second.getDataRef());
+      bulkWriter.putValue(
+         bwPair.first.getRef(), bwPair.second.getDataRef());
+   }
+
+   //stxo keys grow with block height, on a fresh build this is a 
+   //straight append
+   auto&& stats = bulkWriter.commit();
+   if (stats.inserted_ > 0)
+   {
+      LOGDEBUG << "committed " << stats.appended_ << " stxos by append, " <<
+         stats.inserted_ << " by insert";
    }
 }
 
 /////////////////////////////////////////////////////////////////////////////
-void DatabaseBuilder::verifyTransactions()
+void DatabaseBuilder::verifyTransactions(const ProgressCallback& progress)
 {
    struct ParserState
    {
@@ -1062,17 +1322,42 @@ void DatabaseBuilder::verifyTransactions()
 
    auto stateStruct = make_shared<ParserState>();
 
-   auto verifyBlockTx = [&bdl, this, stateStruct](void)->void
+   auto topHeight = blockchain_->top()->getBlockHeight();
+   VerificationProgress verifyProgress(progress, topHeight + 1);
+
+   auto verifyBlockTx = [&, this, stateStruct](void)->void
    {
-      map<unsigned, shared_ptr<BlockDataFileMap>> filePtrMap;
+      //most recently used file maps up front, lookups go through the map
+      typedef list<pair<unsigned, shared_ptr<BlockDataFileMap>>> FileMapList;
+      FileMapList fileMapLRU;
+      map<unsigned, FileMapList::iterator> filePtrMap;
 
-      auto getFileMap = [&bdl, &filePtrMap](unsigned fileNum)->
+      auto getFileMap = [&bdl, &fileMapLRU, &filePtrMap](
+         const BlockHeader& header, uint64_t& offset)->
          shared_ptr<BlockDataFileMap>
       {
-         auto& fmp = filePtrMap[fileNum];
-         if (fmp == nullptr)
-            fmp = bdl.get(fileNum);
+         //in-memory blocks may move to disk, don't cache them
+         auto pos = header.getBlockFilePos();
+         if (MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+            return bdl.getForHeader(header, offset);
+
+         offset = pos.offset_;
+         auto iter = filePtrMap.find(pos.fileNum_);
+         if (iter != filePtrMap.end())
+         {
+            fileMapLRU.splice(fileMapLRU.begin(), fileMapLRU, iter->second);
+            return iter->second->second;
+         }
 
+         if (fileMapLRU.size() >= VERIFY_FILEMAP_CACHE)
+         {
+            filePtrMap.erase(fileMapLRU.back().first);
+            fileMapLRU.pop_back();
+         }
+
+         auto fmp = bdl.get(pos.fileNum_);
+         fileMapLRU.emplace_front(pos.fileNum_, fmp);
+         filePtrMap.emplace(pos.fileNum_, fileMapLRU.begin());
          return fmp;
       };
 
@@ -1123,8 +1408,8 @@ void DatabaseBuilder::verifyTransactions()
                auto txid = brr.get_uint16_t(BE);
 
                //get block data
-               auto blockFileNum = bhPtr->getBlockFileNum();
-               auto fileMap = getFileMap(blockFileNum);
+               uint64_t offset;
+               auto fileMap = getFileMap(*bhPtr, offset);
 
                auto getID = [bhPtr](const BinaryData&)->unsigned int
                {
@@ -1132,7 +1417,7 @@ void DatabaseBuilder::verifyTransactions()
                };
 
                auto bdata = BlockData::deserialize(
-                  fileMap->getPtr() + bhPtr->getOffset(),
+                  fileMap->getPtr() + offset,
                   bhPtr->getBlockSize(),
                   bhPtr, getID, BlockData::CheckHashes::NoChecks);
 
@@ -1175,12 +1460,19 @@ void DatabaseBuilder::verifyTransactions()
 
       auto&& hintdbtx = db_->beginTransaction(TXHINTS, LMDB::ReadOnly);
 
-      while (thisHeight < blockchain_->top()->getBlockHeight())
+      while (!haltVerification_.load(memory_order_relaxed))
       {
          //grab blockheight
          thisHeight = stateStruct->blockHeight_.fetch_add(1, memory_order_relaxed);
+         if (thisHeight > topHeight)
+            break;
+
          auto blockheader = blockchain_->getHeaderByHeight(thisHeight, 0xFF);
-         auto fileMap = getFileMap(blockheader->getBlockFileNum());
+         if (!verifyThrottle_.consume(blockheader->getBlockSize()))
+            break;
+
+         uint64_t offset;
+         auto fileMap = getFileMap(*blockheader, offset);
 
          auto getID = [blockheader](const BinaryData&)->unsigned int
          {
@@ -1188,7 +1480,7 @@ void DatabaseBuilder::verifyTransactions()
          };
 
          auto bdata = BlockData::deserialize(
-            fileMap->getPtr() + blockheader->getOffset(),
+            fileMap->getPtr() + offset,
             blockheader->getBlockSize(),
             blockheader, getID, BlockData::CheckHashes::NoChecks);
 
@@ -1236,6 +1528,7 @@ void DatabaseBuilder::verifyTransactions()
             }
          }
 
+         verifyProgress.advance(1);
          if (thisHeight % 1000 == 0)
          {
             unique_lock<mutex> lock(stateStruct->mu_);
@@ -1263,18 +1556,27 @@ void DatabaseBuilder::verifyTransactions()
       }
    };
 
+   //blocks are streamed from the block files by all threads, the throttle
+   //caps their combined read rate
    vector<thread> parserThrVec;
    for (unsigned i = 1; i < DBSettings::threadCount(); i++)
       parserThrVec.push_back(thread(verifyBlockTx));
 
    verifyBlockTx();
 
-   checkedTransactions_ = stateStruct->parsedCount_.load(memory_order_relaxed);
-
    for (auto& thr : parserThrVec)
       if (thr.joinable())
          thr.join();
 
+   checkedTransactions_ = stateStruct->parsedCount_.load(memory_order_relaxed);
+   verifyProgress.finish();
+
+   if (haltVerification_.load(memory_order_relaxed))
+   {
+      LOGINFO << "chain check halted";
+      return;
+   }
+
    if (stateStruct->unresolvedHashes_.load(memory_order_relaxed) > 0)
       throw runtime_error("checkChain failed with unresolved hash errors");
 
@@ -1532,19 +1834,27 @@ void DatabaseBuilder::cycleDatabases()
 }
 
 /////////////////////////////////////////////////////////////////////////////
-void DatabaseBuilder::checkTxHintsIntegrity()
+unsigned DatabaseBuilder::checkTxHintsIntegrity(
+   const ProgressCallback& progress)
 {
    BlockDataLoader bdl(blockFiles_.folderPath());
-   unsigned threadcount = min(DBSettings::threadCount(),
-      blockFiles_.fileCount());
+   unsigned fileCount = blockFiles_.fileCount();
+   unsigned threadcount = max(min(DBSettings::threadCount(), fileCount), 1U);
 
-   auto fileID = std::make_shared<std::atomic<uint32_t>>();
-   fileID->store(0, std::memory_order_relaxed);
+   VerificationProgress verifyProgress(progress, fileCount);
 
-   auto parserThread = [this, fileID, &bdl]()
+   atomic<unsigned> fileID = { 0 };
+   atomic<unsigned> totalMissed = { 0 };
+
+   auto checkFiles = [&, this](void)->void
    {
-      while (true) {
-         auto counter = fileID->fetch_add(1, std::memory_order_relaxed);
+      while (!haltVerification_.load(memory_order_relaxed))
+      {
+         //each thread maps, checks and releases one file at a time
+         auto counter = fileID.fetch_add(1, memory_order_relaxed);
+         if (counter >= fileCount)
+            return;
+
          if (counter % 25 == 0)
             LOGINFO << "checking txhints for file " << counter;
 
@@ -1553,11 +1863,21 @@ void DatabaseBuilder::checkTxHintsIntegrity()
          if (ptr == nullptr)
             return;
 
-         //tally all blocks in file
+         //tally all blocks in file, throttled block by block so that a 
+         //halt doesn't wait on a whole file worth of rate
          std::list<shared_ptr<BlockData>> bdList;
+         bool halted = false;
          parseBlockFile(ptr, blockfilemappointer->size(),
-            0, [&bdList](const uint8_t* data, size_t size, size_t)->bool
+            0, [this, &bdList, &halted](
+               const uint8_t* data, size_t size, size_t)->bool
             {
+               if (halted || !verifyThrottle_.consume(size))
+               {
+                  //skip the rest of the file
+                  halted = true;
+                  return true;
+               }
+
                try
                {
                   auto bd = BlockData::deserialize(
@@ -1573,48 +1893,62 @@ void DatabaseBuilder::checkTxHintsIntegrity()
             }
          );
 
+         if (halted)
+            return;
+
          //check hashes can be resolved via tx hints db
-         int missedCount = 0;
-         auto dbtx = db_->beginTransaction(TXHINTS, LMDB::ReadOnly);
-         for (const auto& blockData : bdList)
+         unsigned missedCount = 0;
          {
-            //skip blocks not in the main chain
-            auto headerPtr = blockchain_->getHeaderByHash(blockData->getHash());
-            if (headerPtr == nullptr || !headerPtr->isMainBranch())
-               continue;
-
-            const auto& txns = blockData->getTxns();
-            for (const auto& txn : txns)
+            auto dbtx = db_->beginTransaction(TXHINTS, LMDB::ReadOnly);
+            for (const auto& blockData : bdList)
             {
-               auto hash4 = txn->getHash().getSliceRef(0, 4);
-               BinaryRefReader brrHints = db_->getValueRef(
-                  TXHINTS, DB_PREFIX_TXHINTS, hash4);
-
-               uint32_t valSize = brrHints.getSize();
-               if (valSize < 6)
+               //skip blocks not in the main chain
+               shared_ptr<BlockHeader> headerPtr;
+               try
                {
-                  ++missedCount;
-                  return;
+                  headerPtr = blockchain_->getHeaderByHash(blockData->getHash());
                }
+               catch (exception&)
+               {
+                  continue;
+               }
+
+               if (headerPtr == nullptr || !headerPtr->isMainBranch())
+                  continue;
 
-               bool hit = false;
-               uint32_t numHints = (uint32_t)brrHints.get_var_int();
-               for (uint32_t i = 0; i < numHints; i++)
+               const auto& txns = blockData->getTxns();
+               for (const auto& txn : txns)
                {
-                  BinaryDataRef hint = brrHints.get_BinaryDataRef(6);
+                  auto hash4 = txn->getHash().getSliceRef(0, 4);
+                  BinaryRefReader brrHints = db_->getValueRef(
+                     TXHINTS, DB_PREFIX_TXHINTS, hash4);
 
-                  //check this key is on the main branch
-                  auto hintRef = hint.getSliceRef(0, 4);
-                  auto blockId = DBUtils::hgtxToHeight(hintRef);
-                  if (blockId == headerPtr->getThisID())
+                  uint32_t valSize = brrHints.getSize();
+                  if (valSize < 6)
                   {
-                     hit = true;
-                     break;
+                     ++missedCount;
+                     continue;
+                  }
+
+                  bool hit = false;
+                  uint32_t numHints = (uint32_t)brrHints.get_var_int();
+                  for (uint32_t i = 0; i < numHints; i++)
+                  {
+                     BinaryDataRef hint = brrHints.get_BinaryDataRef(6);
+
+                     //check this key is on the main branch
+                     auto hintRef = hint.getSliceRef(0, 4);
+                     auto blockId = DBUtils::hgtxToHeight(hintRef);
+                     if (blockId == headerPtr->getThisID())
+                     {
+                        hit = true;
+                        break;
+                     }
                   }
-               }
 
-               if (!hit)
-                  ++missedCount;
+                  if (!hit)
+                     ++missedCount;
+               }
             }
          }
 
@@ -1622,16 +1956,23 @@ void DatabaseBuilder::checkTxHintsIntegrity()
          {
             LOGERR << "missed " << missedCount << " hashes" <<
                " in file " << counter;
+            totalMissed.fetch_add(missedCount, memory_order_relaxed);
          }
+
+         verifyProgress.advance(1);
       }
    };
 
-   std::vector<std::thread> threads;
-   LOGINFO << "checking txhints for " << blockFiles_.fileCount() <<
+   LOGINFO << "checking txhints for " << fileCount <<
       " files on " << threadcount << " threads";
+   if (verifyThrottle_.rate() > 0)
+      LOGINFO << "capped at " << DBSettings::verifyRate() << "MB/s";
+
+   std::vector<std::thread> threads;
    threads.reserve(threadcount);
-   for (unsigned i=0; i<threadcount; i++)
-      threads.emplace_back(thread(parserThread));
+   for (unsigned i=1; i<threadcount; i++)
+      threads.emplace_back(thread(checkFiles));
+   checkFiles();
 
    for (auto& thr : threads)
    {
@@ -1639,5 +1980,14 @@ void DatabaseBuilder::checkTxHintsIntegrity()
          thr.join();
    }
 
-   LOGINFO << "done checking txhints";
-}
\ No newline at end of file
+   verifyProgress.finish();
+   if (haltVerification_.load(memory_order_relaxed))
+   {
+      LOGINFO << "txhints check halted";
+      return totalMissed.load(memory_order_relaxed);
+   }
+
+   LOGINFO << "done checking txhints, missed " <<
+      totalMissed.load(memory_order_relaxed) << " hashes";
+   return totalMissed.load(memory_order_relaxed);
+}
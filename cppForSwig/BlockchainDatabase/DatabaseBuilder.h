@@ -6,10 +6,14 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <atomic>
+#include <list>
+
 #include "BlockDataMap.h"
 #include "Blockchain.h"
 #include "bdmenums.h"
 #include "Progress.h"
+#include "ByteRateThrottle.h"
 
 class BlockDataManager;
 class ScrAddrFilter;
@@ -32,6 +36,23 @@ private:
    unsigned checkedTransactions_ = 0;
    const bool forceRescanSSH_;
 
+   std::atomic<bool> haltVerification_ = { false };
+
+   //caps the combined read rate of the integrity checks, halted with them
+   ByteRateThrottle verifyThrottle_;
+
+   //headers of blocks ingested from memory, by hash. Read only while the
+   //blk files are parsed
+   std::map<BinaryData, std::shared_ptr<BlockHeader>> memoryHeaders_;
+
+   //headers loaded from the db without a blk file position, for blocks
+   //that were ingested from memory and hadn't hit the disk by shutdown
+   std::map<BinaryData, std::shared_ptr<BlockHeader>> unplacedHeaders_;
+
+   //headers moved to their blk file position during the last parse
+   std::mutex reconcileMutex_;
+   std::vector<std::shared_ptr<BlockHeader>> reconciledHeaders_;
+
 private:
    BlockOffset loadBlockHeadersFromDB(const ProgressCallback &progress);
    
@@ -43,6 +64,9 @@ private:
 
    Blockchain::ReorganizationState updateBlocksInDB(
       const ProgressCallback &progress, bool verbose, bool fullHints);
+   void loadMemoryHeaders(void);
+   void reconcileMemoryBlocks(void);
+   unsigned addMemoryBlocks(void);
    BinaryData initTransactionHistory(int32_t startHeight);
    BinaryData scanHistory(int32_t startHeight, bool reportprogress, bool init);
    void undoHistory(Blockchain::ReorganizationState& reorgState);
@@ -52,7 +76,6 @@ private:
    std::map<BinaryData, std::shared_ptr<BlockHeader>> assessBlkFile(BlockDataLoader& bdl,
       unsigned fileID);
 
-   void verifyTransactions(void);
    void commitAllTxHints(
       const std::map<uint32_t, std::shared_ptr<BlockData>>&,
       const std::set<unsigned>&);
@@ -75,6 +98,22 @@ public:
    void verifyChain(void);
    unsigned getCheckedTxCount(void) const { return checkedTransactions_; }
 
+   //Verifies all tx in the chain (consensus and sigs), throws on failure.
+   //Meant to run once the db is ready, reads are capped by the verify rate
+   //and progress is reported under BDMPhase_Verification
+   void verifyTransactions(const ProgressCallback&);
+
    //void verifyTxFilters(void);
-   void checkTxHintsIntegrity(void);
+
+   //Checks every tx hash in the block files resolves through the txhints
+   //db, returns the count of misses. Safe to run alongside update(),
+   //progress is reported under BDMPhase_Verification
+   unsigned checkTxHintsIntegrity(const ProgressCallback&);
+
+   //stops running integrity checks, wakes up throttled readers
+   void haltVerification(void)
+   { 
+      haltVerification_.store(true, std::memory_order_relaxed); 
+      verifyThrottle_.halt();
+   }
 };
@@ -0,0 +1,515 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+#include "HeaderIndex.h"
+#include "Blockchain.h"
+#include "lmdb_wrapper.h"
+#include "BlockDataMap.h"
+#include "DBUtils.h"
+#include "log.h"
+
+using namespace std;
+
+#define HEADER_SNAPSHOT_MAGIC    "ARMHDRSS"
+#define HEADER_SNAPSHOT_VERSION  2
+#define HEADER_SNAPSHOT_FILENAME "headers.snapshot"
+
+//magic 8, version 4, record size 4, count 4, top height 4, top id 4,
+//top hash 32
+#define HEADER_SNAPSHOT_PREFIX_SIZE 64
+
+//raw header 80, hash 32, id 4, file num 4, offset 8, height 4, tx count 4,
+//block size 4, dup 1, padding 3
+#define HEADER_SNAPSHOT_RECORD_SIZE 144
+
+//the checksum chains the sha256 of each batch of records, see
+//HeaderSnapshot::updateChecksum
+#define HEADER_SNAPSHOT_WRITE_BATCH 10000
+#define HEADER_SNAPSHOT_CHECKSUM_SIZE 32
+
+////////////////////////////////////////////////////////////////////////////////
+////
+//// HeaderIndex
+////
+////////////////////////////////////////////////////////////////////////////////
+bool HeaderIndex::toKey(BinaryDataRef hash, HashKey& key)
+{
+   if (hash.getSize() != key.size())
+      return false;
+
+   memcpy(&key[0], hash.getPtr(), key.size());
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t HeaderIndex::slotFor(const HashKey& key) const
+{
+   //block hashes are uniformly distributed, the leading bytes will do
+   uint64_t val;
+   memcpy(&val, &key[0], sizeof(val));
+   return val & (hashTable_.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t HeaderIndex::findPos(const HashKey& key) const
+{
+   if (hashTable_.size() == 0)
+      return HEADER_INDEX_EMPTY;
+
+   auto mask = hashTable_.size() - 1;
+   auto slot = slotFor(key);
+   while (true)
+   {
+      auto pos = hashTable_[slot];
+      if (pos == HEADER_INDEX_EMPTY)
+         return HEADER_INDEX_EMPTY;
+
+      if (keys_[pos] == key)
+         return pos;
+
+      slot = (slot + 1) & mask;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t HeaderIndex::findPos(const shared_ptr<BlockHeader>& header) const
+{
+   auto id = header->getThisID();
+   if (id < byId_.size())
+   {
+      auto pos = byId_[id];
+      if (pos != HEADER_INDEX_EMPTY && headers_[pos] == header)
+         return pos;
+   }
+
+   HashKey key;
+   if (toKey(header->getThisHashRef(), key))
+   {
+      auto pos = findPos(key);
+      if (pos != HEADER_INDEX_EMPTY && headers_[pos] == header)
+         return pos;
+   }
+
+   //the genesis placeholder has neither id nor hash, it only shows up
+   //while the index is tiny
+   for (size_t i = 0; i < headers_.size(); i++)
+   {
+      if (headers_[i] == header)
+         return i;
+   }
+
+   return HEADER_INDEX_EMPTY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HeaderIndex::growTable()
+{
+   size_t newSize = max(hashTable_.size() * 2, size_t(1024));
+   hashTable_.assign(newSize, HEADER_INDEX_EMPTY);
+
+   auto mask = newSize - 1;
+   for (uint32_t pos = 0; pos < keys_.size(); pos++)
+   {
+      auto slot = slotFor(keys_[pos]);
+      while (hashTable_[slot] != HEADER_INDEX_EMPTY)
+         slot = (slot + 1) & mask;
+      hashTable_.set(slot, pos);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HeaderIndex::setId(uint32_t id, uint32_t pos)
+{
+   if (id == UINT32_MAX)
+      return;
+
+   byId_.grow(id + 1, HEADER_INDEX_EMPTY);
+   byId_.set(id, pos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockHeader> HeaderIndex::getByHash(BinaryDataRef hash) const
+{
+   HashKey key;
+   if (!toKey(hash, key))
+      return nullptr;
+
+   auto pos = findPos(key);
+   if (pos == HEADER_INDEX_EMPTY)
+      return nullptr;
+   return headers_[pos];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockHeader> HeaderIndex::getById(uint32_t id) const
+{
+   if (id >= byId_.size() || byId_[id] == HEADER_INDEX_EMPTY)
+      return nullptr;
+   return headers_[byId_[id]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockHeader> HeaderIndex::getByHeight(uint32_t height) const
+{
+   if (height >= byHeight_.size() || byHeight_[height] == HEADER_INDEX_EMPTY)
+      return nullptr;
+   return headers_[byHeight_[height]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<HeaderIndex> HeaderIndex::addHeaders(
+   const map<BinaryData, shared_ptr<BlockHeader>>& headerMap) const
+{
+   auto newIndex = make_shared<HeaderIndex>(*this);
+
+   for (auto& headerPair : headerMap)
+   {
+      HashKey key;
+      if (!toKey(headerPair.first.getRef(), key))
+         throw runtime_error("invalid header hash length");
+
+      auto pos = newIndex->findPos(key);
+      if (pos != HEADER_INDEX_EMPTY)
+      {
+         //replace, same as TransactionalMap::update
+         newIndex->headers_.set(pos, headerPair.second);
+      }
+      else
+      {
+         pos = newIndex->headers_.size();
+         newIndex->headers_.push_back(headerPair.second);
+         newIndex->keys_.push_back(key);
+
+         //keep the load factor under 1/2
+         if (newIndex->keys_.size() * 2 > newIndex->hashTable_.size())
+         {
+            newIndex->growTable();
+         }
+         else
+         {
+            auto mask = newIndex->hashTable_.size() - 1;
+            auto slot = newIndex->slotFor(key);
+            while (newIndex->hashTable_[slot] != HEADER_INDEX_EMPTY)
+               slot = (slot + 1) & mask;
+            newIndex->hashTable_.set(slot, pos);
+         }
+      }
+
+      newIndex->setId(headerPair.second->getThisID(), pos);
+   }
+
+   return newIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<HeaderIndex> HeaderIndex::setHeights(
+   const map<unsigned, shared_ptr<BlockHeader>>& heightMap) const
+{
+   auto newIndex = make_shared<HeaderIndex>(*this);
+   for (auto& heightPair : heightMap)
+   {
+      auto pos = newIndex->findPos(heightPair.second);
+      if (pos == HEADER_INDEX_EMPTY)
+         throw runtime_error("header missing from index");
+
+      newIndex->byHeight_.grow(heightPair.first + 1, HEADER_INDEX_EMPTY);
+      newIndex->byHeight_.set(heightPair.first, pos);
+   }
+
+   return newIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////
+//// HeaderSnapshot
+////
+////////////////////////////////////////////////////////////////////////////////
+string HeaderSnapshot::getPath()
+{
+   auto path = DatabaseContainer::baseDir_;
+   DBUtils::appendPath(path, HEADER_SNAPSHOT_FILENAME);
+   return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+HeaderSnapshot::DbState HeaderSnapshot::getDbState(
+   const Blockchain& bc, LMDBBlockDatabase* db)
+{
+   DbState state;
+   auto&& sdbi = db->getStoredDBInfo(HEADERS, 0);
+   state.topHash_ = sdbi.topScannedBlkHash_;
+   state.topHeight_ = sdbi.topBlkHgt_;
+   state.topId_ = bc.getTopIdFromDb(db);
+
+   return state;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HeaderSnapshot::updateChecksum(BinaryData& checksum, BinaryDataRef batch)
+{
+   BinaryWriter bw;
+   bw.put_BinaryData(checksum);
+   bw.put_BinaryData(BtcUtils::getSha256(batch));
+   checksum = BtcUtils::getSha256(bw.getData());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HeaderSnapshot::write(const string& path,
+   const Blockchain& bc, LMDBBlockDatabase* db)
+{
+   if (bc.getNewHeaderCount() != 0)
+      throw runtime_error("chain has headers missing from the db");
+
+   auto&& state = getDbState(bc, db);
+   if (state.topHash_.getSize() != 32)
+      throw runtime_error("HEADERS db has no top hash");
+
+   auto index = bc.getHeaderIndex();
+   vector<shared_ptr<BlockHeader>> headers;
+   headers.reserve(index->size());
+   for (auto& header : index->headers())
+   {
+      //skip the genesis placeholder
+      if (!header->isInitialized() || header->getThisID() == UINT32_MAX)
+         continue;
+      headers.push_back(header);
+   }
+
+   auto tmpPath = path + ".tmp";
+   ofstream file(tmpPath, ios::binary | ios::trunc);
+   if (!file.is_open())
+      throw runtime_error("failed to open header snapshot file");
+
+   BinaryWriter bw;
+   bw.put_BinaryData((const uint8_t*)HEADER_SNAPSHOT_MAGIC, 8);
+   bw.put_uint32_t(HEADER_SNAPSHOT_VERSION);
+   bw.put_uint32_t(HEADER_SNAPSHOT_RECORD_SIZE);
+   bw.put_uint32_t(headers.size());
+   bw.put_uint32_t(state.topHeight_);
+   bw.put_uint32_t(state.topId_);
+   bw.put_BinaryData(state.topHash_);
+   bw.put_BinaryData(BinaryData(HEADER_SNAPSHOT_PREFIX_SIZE - bw.getSize()));
+
+   file.write((const char*)bw.getDataRef().getPtr(), bw.getSize());
+   bw.reset();
+
+   BinaryData checksum(HEADER_SNAPSHOT_CHECKSUM_SIZE);
+   checksum.fill(0);
+
+   const BinaryData padding(3);
+   for (size_t i = 0; i < headers.size(); i++)
+   {
+      auto& header = headers[i];
+      bw.put_BinaryDataRef(header->serialize().getRef());
+      bw.put_BinaryDataRef(header->getThisHashRef());
+      bw.put_uint32_t(header->getThisID());
+
+      //in-memory file ids don't survive a restart, leave these unplaced
+      auto pos = header->getBlockFilePos();
+      if (MemoryBlockStore::isMemoryFileID(pos.fileNum_))
+         pos = BlockFilePos();
+
+      bw.put_uint32_t(pos.fileNum_);
+      bw.put_uint64_t(pos.offset_);
+      bw.put_uint32_t(header->getBlockHeight());
+      bw.put_uint32_t(header->getNumTx());
+      bw.put_uint32_t(header->getBlockSize());
+      bw.put_uint8_t(header->getDuplicateID());
+      bw.put_BinaryData(padding);
+
+      if ((i + 1) % HEADER_SNAPSHOT_WRITE_BATCH == 0)
+      {
+         updateChecksum(checksum, bw.getDataRef());
+         file.write((const char*)bw.getDataRef().getPtr(), bw.getSize());
+         bw.reset();
+      }
+   }
+
+   if (bw.getSize() > 0)
+      updateChecksum(checksum, bw.getDataRef());
+   bw.put_BinaryData(checksum);
+
+   file.write((const char*)bw.getDataRef().getPtr(), bw.getSize());
+   file.close();
+   if (file.fail())
+   {
+      remove(tmpPath.c_str());
+      throw runtime_error("failed to write header snapshot");
+   }
+
+   remove(path.c_str());
+   if (rename(tmpPath.c_str(), path.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      throw runtime_error("failed to move header snapshot in place");
+   }
+
+   LOGINFO << "wrote " << headers.size() << " headers to snapshot";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HeaderSnapshot::verify(const uint8_t* records, uint32_t count,
+   const DbState& state)
+{
+   //payload checksum, written after the records
+   const size_t payloadSize = size_t(count) * HEADER_SNAPSHOT_RECORD_SIZE;
+   const size_t batchSize =
+      HEADER_SNAPSHOT_WRITE_BATCH * HEADER_SNAPSHOT_RECORD_SIZE;
+
+   BinaryData checksum(HEADER_SNAPSHOT_CHECKSUM_SIZE);
+   checksum.fill(0);
+   for (size_t offset = 0; offset < payloadSize; offset += batchSize)
+   {
+      updateChecksum(checksum, BinaryDataRef(records + offset,
+         min(batchSize, payloadSize - offset)));
+   }
+
+   BinaryDataRef expected(records + payloadSize, HEADER_SNAPSHOT_CHECKSUM_SIZE);
+   if (checksum.getRef() != expected)
+      throw runtime_error("header snapshot checksum mismatch");
+
+   //heights by hash
+   unordered_map<BinaryDataRef, uint32_t> heights;
+   vector<pair<BinaryDataRef, uint32_t>> parents;
+   heights.reserve(count);
+   parents.reserve(count);
+   for (uint32_t i = 0; i < count; i++)
+   {
+      BinaryRefReader brr(records + size_t(i) * HEADER_SNAPSHOT_RECORD_SIZE,
+         HEADER_SNAPSHOT_RECORD_SIZE);
+      brr.advance(4);
+      auto prevHash = brr.get_BinaryDataRef(32);
+      brr.advance(HEADER_SIZE - 36);
+      auto hash = brr.get_BinaryDataRef(32);
+      brr.advance(16);
+      auto height = brr.get_uint32_t();
+
+      heights[hash] = height;
+      parents.emplace_back(prevHash, height);
+   }
+
+   //every header but the genesis block chains to one in the snapshot, one
+   //height down
+   for (auto& parent : parents)
+   {
+      if (parent.second == 0)
+         continue;
+
+      auto iter = heights.find(parent.first);
+      if (iter == heights.end() || iter->second + 1 != parent.second)
+         throw runtime_error("header snapshot chain mismatch");
+   }
+
+   auto topIter = heights.find(state.topHash_.getRef());
+   if (topIter == heights.end() || topIter->second != state.topHeight_)
+      throw runtime_error("header snapshot is missing the db top");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool HeaderSnapshot::read(const string& path,
+   const Blockchain& bc, LMDBBlockDatabase* db,
+   const function<void(shared_ptr<BlockHeader>, uint32_t, uint8_t)>& callback)
+{
+   if (!DBUtils::fileExists(path, 0))
+      return false;
+
+   FileMap fileMap;
+   try
+   {
+      fileMap = DBUtils::getMmapOfFile(path);
+   }
+   catch (exception&)
+   {
+      remove(path.c_str());
+      return false;
+   }
+
+   auto cleanup = [&fileMap, &path](void)->void
+   {
+      fileMap.unmap();
+
+      //single use, the next clean shutdown writes a fresh one
+      remove(path.c_str());
+   };
+
+   try
+   {
+      if (fileMap.size_ < HEADER_SNAPSHOT_PREFIX_SIZE)
+         throw runtime_error("header snapshot too short");
+
+      BinaryRefReader brr(fileMap.filePtr_, HEADER_SNAPSHOT_PREFIX_SIZE);
+      auto magic = brr.get_BinaryDataRef(8);
+      if (magic != BinaryDataRef((const uint8_t*)HEADER_SNAPSHOT_MAGIC, 8))
+         throw runtime_error("header snapshot magic mismatch");
+
+      if (brr.get_uint32_t() != HEADER_SNAPSHOT_VERSION ||
+         brr.get_uint32_t() != HEADER_SNAPSHOT_RECORD_SIZE)
+         throw runtime_error("header snapshot version mismatch");
+
+      auto count = brr.get_uint32_t();
+      if (fileMap.size_ != HEADER_SNAPSHOT_PREFIX_SIZE +
+         size_t(count) * HEADER_SNAPSHOT_RECORD_SIZE +
+         HEADER_SNAPSHOT_CHECKSUM_SIZE)
+         throw runtime_error("header snapshot size mismatch");
+
+      //the snapshot is only good if no header made it to the db since
+      DbState snapshotState;
+      snapshotState.topHeight_ = brr.get_uint32_t();
+      snapshotState.topId_ = brr.get_uint32_t();
+      snapshotState.topHash_ = brr.get_BinaryData(32);
+
+      auto&& dbState = getDbState(bc, db);
+      if (dbState.topHash_ != snapshotState.topHash_ ||
+         dbState.topHeight_ != snapshotState.topHeight_ ||
+         dbState.topId_ != snapshotState.topId_)
+         throw runtime_error("header snapshot is stale");
+
+      verify(fileMap.filePtr_ + HEADER_SNAPSHOT_PREFIX_SIZE, count,
+         snapshotState);
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "ignoring header snapshot: " << e.what();
+      cleanup();
+      return false;
+   }
+
+   //the hashes were computed from the same db content when the snapshot
+   //was written, don't hash the headers again
+   auto ptr = fileMap.filePtr_ + HEADER_SNAPSHOT_PREFIX_SIZE;
+   auto end = fileMap.filePtr_ + fileMap.size_ - HEADER_SNAPSHOT_CHECKSUM_SIZE;
+   for (; ptr < end; ptr += HEADER_SNAPSHOT_RECORD_SIZE)
+   {
+      BinaryRefReader brr(ptr, HEADER_SNAPSHOT_RECORD_SIZE);
+      auto rawHeader = brr.get_BinaryDataRef(HEADER_SIZE);
+      auto hash = brr.get_BinaryDataRef(32);
+
+      auto header = make_shared<BlockHeader>();
+      header->unserializeWithHash(rawHeader, hash);
+
+      auto id = brr.get_uint32_t();
+      header->setUniqueID(id);
+      auto fileNum = brr.get_uint32_t();
+      header->setBlockFilePos(fileNum, brr.get_uint64_t());
+
+      auto height = brr.get_uint32_t();
+      header->setNumTx(brr.get_uint32_t());
+      header->setBlockSize(brr.get_uint32_t());
+      auto dup = brr.get_uint8_t();
+
+      callback(header, height, dup);
+   }
+
+   cleanup();
+   return true;
+}
@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _HEADERINDEX_H_
+#define _HEADERINDEX_H_
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <array>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "BinaryData.h"
+#include "BlockObj.h"
+
+class Blockchain;
+class LMDBBlockDatabase;
+
+#define HEADER_INDEX_EMPTY UINT32_MAX
+
+#ifndef UNIT_TESTS
+#define HEADER_INDEX_CHUNK_BITS 12
+#else
+#define HEADER_INDEX_CHUNK_BITS 4
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class ChunkedVector
+{
+   /***
+   Vector split in fixed size chunks that copies share. A copy owns none of
+   its chunks, the first write to a chunk clones it. Copying the vector and
+   changing a few entries costs a few chunks instead of the whole vector.
+   
+   Only grows, entries are never removed.
+   ***/
+
+private:
+   static const size_t chunkSize_ = size_t(1) << HEADER_INDEX_CHUNK_BITS;
+   static const size_t chunkMask_ = chunkSize_ - 1;
+
+   std::vector<std::shared_ptr<std::vector<T>>> chunks_;
+   std::vector<bool> owned_;
+   size_t size_ = 0;
+
+private:
+   std::vector<T>& getChunk(size_t id)
+   {
+      if (!owned_[id])
+      {
+         auto chunk = std::make_shared<std::vector<T>>();
+         chunk->reserve(chunkSize_);
+         chunk->insert(chunk->end(), 
+            chunks_[id]->begin(), chunks_[id]->end());
+
+         chunks_[id] = chunk;
+         owned_[id] = true;
+      }
+
+      return *chunks_[id];
+   }
+
+public:
+   class const_iterator
+   {
+   private:
+      const ChunkedVector* vec_;
+      size_t pos_;
+
+   public:
+      const_iterator(const ChunkedVector* vec, size_t pos) :
+         vec_(vec), pos_(pos)
+      {}
+
+      const T& operator*(void) const { return (*vec_)[pos_]; }
+      const_iterator& operator++(void) { ++pos_; return *this; }
+      bool operator!=(const const_iterator& rhs) const
+      { return pos_ != rhs.pos_; }
+   };
+
+public:
+   ChunkedVector(void) {}
+   ChunkedVector(const ChunkedVector& rhs) :
+      chunks_(rhs.chunks_), owned_(rhs.chunks_.size(), false),
+      size_(rhs.size_)
+   {}
+
+   ChunkedVector& operator=(const ChunkedVector&) = delete;
+
+   size_t size(void) const { return size_; }
+   const T& operator[](size_t pos) const
+   {
+      return (*chunks_[pos >> HEADER_INDEX_CHUNK_BITS])[pos & chunkMask_];
+   }
+
+   const_iterator begin(void) const { return const_iterator(this, 0); }
+   const_iterator end(void) const { return const_iterator(this, size_); }
+
+   void set(size_t pos, const T& val)
+   {
+      getChunk(pos >> HEADER_INDEX_CHUNK_BITS)[pos & chunkMask_] = val;
+   }
+
+   void push_back(const T& val)
+   {
+      if ((size_ & chunkMask_) == 0)
+      {
+         chunks_.push_back(std::make_shared<std::vector<T>>());
+         chunks_.back()->reserve(chunkSize_);
+         owned_.push_back(true);
+      }
+
+      getChunk(size_ >> HEADER_INDEX_CHUNK_BITS).push_back(val);
+      ++size_;
+   }
+
+   //grows to count entries, never shrinks
+   void grow(size_t count, const T& val)
+   {
+      while (size_ < count)
+         push_back(val);
+   }
+
+   void assign(size_t count, const T& val)
+   {
+      chunks_.clear();
+      owned_.clear();
+      size_ = 0;
+      grow(count, val);
+   }
+
+   //chunks still shared with the source of the copy, for unit tests
+   size_t sharedChunkCount(void) const
+   {
+      size_t count = 0;
+      for (size_t i = 0; i < owned_.size(); i++)
+      {
+         if (!owned_[i])
+            ++count;
+      }
+      return count;
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class HeaderIndex
+{
+   /***
+   Immutable view of the known block headers.
+
+   Headers sit in an arena in insertion order. Hashes are resolved
+   through an open addressing table of arena positions, heights and ids
+   through dense vectors of arena positions.
+
+   Updates return a modified copy of the index, Blockchain swaps the
+   current pointer atomically so readers never take a lock (same scheme as
+   TransactionalMap). All members are chunked vectors, a copy only clones
+   the chunks an update touches, so a new block costs a few chunks rather
+   than a copy of every vector.
+
+   The arena holds shared_ptr<BlockHeader>, not the headers themselves:
+   Blockchain hands out header pointers and relies on their identity.
+   ***/
+
+public:
+   typedef std::array<uint8_t, 32> HashKey;
+
+private:
+   ChunkedVector<std::shared_ptr<BlockHeader>> headers_;
+   ChunkedVector<HashKey> keys_;
+
+   //arena positions, HEADER_INDEX_EMPTY for empty slots
+   ChunkedVector<uint32_t> hashTable_;
+   ChunkedVector<uint32_t> byId_;
+   ChunkedVector<uint32_t> byHeight_;
+
+private:
+   static bool toKey(BinaryDataRef, HashKey&);
+   size_t slotFor(const HashKey&) const;
+   uint32_t findPos(const HashKey&) const;
+   uint32_t findPos(const std::shared_ptr<BlockHeader>&) const;
+
+   void growTable(void);
+   void setId(uint32_t id, uint32_t pos);
+
+public:
+   HeaderIndex(void) {}
+
+   size_t size(void) const { return headers_.size(); }
+   const ChunkedVector<std::shared_ptr<BlockHeader>>& headers(void) const
+   { return headers_; }
+
+   std::shared_ptr<BlockHeader> getByHash(BinaryDataRef) const;
+   std::shared_ptr<BlockHeader> getById(uint32_t) const;
+   std::shared_ptr<BlockHeader> getByHeight(uint32_t) const;
+   size_t heightCount(void) const { return byHeight_.size(); }
+
+   //inserts or replaces headers by hash
+   std::shared_ptr<HeaderIndex> addHeaders(
+      const std::map<BinaryData, std::shared_ptr<BlockHeader>>&) const;
+
+   //sets the main branch header for these heights, other heights are kept
+   std::shared_ptr<HeaderIndex> setHeights(
+      const std::map<unsigned, std::shared_ptr<BlockHeader>>&) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class HeaderSnapshot
+{
+   /***
+   Flat file copy of the header arena, written on clean shutdown so the
+   next startup doesn't have to deserialize and hash every header in the
+   HEADERS db.
+
+   The file carries the HEADERS db top hash, height and top block id at the
+   time it was written, and a checksum of the header records. It is only
+   used if the checksum holds, the records chain up by prev hash to the db
+   top and the db still has the same top. It is deleted once read: a run
+   that ends without writing a new one falls back to the db on the next
+   start.
+   ***/
+
+private:
+   struct DbState
+   {
+      BinaryData topHash_;
+      uint32_t topHeight_ = UINT32_MAX;
+      uint32_t topId_ = 0;
+   };
+
+   static DbState getDbState(const Blockchain&, LMDBBlockDatabase*);
+   static void updateChecksum(BinaryData&, BinaryDataRef);
+
+   //throws if the records fail the checksum or the chain checks
+   static void verify(const uint8_t*, uint32_t, const DbState&);
+
+public:
+   static std::string getPath(void);
+
+   static void write(const std::string& path,
+      const Blockchain&, LMDBBlockDatabase*);
+
+   //returns false if there is no valid snapshot, callback gets the same
+   //arguments as with LMDBBlockDatabase::readAllHeaders
+   static bool read(const std::string& path,
+      const Blockchain&, LMDBBlockDatabase*,
+      const std::function<void(
+         std::shared_ptr<BlockHeader>, uint32_t, uint8_t)>&);
+};
+
+#endif
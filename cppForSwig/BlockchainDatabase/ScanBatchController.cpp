@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "ScanBatchController.h"
+#include "log.h"
+
+using namespace std;
+
+namespace
+{
+   /////////////////////////////////////////////////////////////////////////////
+   string toMB(double bytes)
+   {
+      stringstream ss;
+      ss << (uint64_t)(bytes / (1024.0 * 1024.0)) << "MB";
+      return ss.str();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ScanBatchController::ScanBatchController(unsigned ramLevel, MemoryProbe probe) :
+   budget_(max(ramLevel, 1U) * SCAN_RAM_LEVEL_SIZE),
+   memoryProbe_(probe != nullptr ? probe : MemoryProbe(residentMemory)),
+   baseline_(memoryProbe_())
+{
+   //a batch per queue slot plus the one being parsed
+   unsigned depth = min(max(ramLevel, 1U), (unsigned)SCAN_QUEUE_DEPTH_MAX);
+   size_t size = budget_ / (depth + 1);
+   size = min(max(size, (size_t)SCAN_BATCH_SIZE_MIN), (size_t)SCAN_BATCH_SIZE_MAX);
+   depth = min(depth, maxDepthFor(size));
+
+   batchSize_.store(size, memory_order_relaxed);
+   queueDepth_.store(depth, memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned ScanBatchController::maxDepthFor(size_t batchSize) const
+{
+   auto depth = budget_ / batchSize;
+   if (depth <= 1)
+      return 1;
+
+   return (unsigned)min(depth - 1, (size_t)SCAN_QUEUE_DEPTH_MAX);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t ScanBatchController::memoryUsage()
+{
+   auto current = memoryProbe_();
+   if (current == 0)
+      return inflight_;
+
+   if (current < baseline_)
+      return 0;
+
+   return current - baseline_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ScanBatchController::batchQueued(size_t size)
+{
+   unique_lock<mutex> lock(mu_);
+   inflight_ += size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ScanBatchController::stageDone(
+   ScanStage stage, size_t size, double seconds)
+{
+   if (stage >= ScanStage_Count)
+      return;
+
+   unique_lock<mutex> lock(mu_);
+   stages_[stage].bytes_ += size;
+   stages_[stage].seconds_ += seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ScanBatchController::commitIdle(double seconds)
+{
+   unique_lock<mutex> lock(mu_);
+   commitIdle_ += seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ScanBatchController::batchCommitted(size_t size)
+{
+   unique_lock<mutex> lock(mu_);
+   inflight_ -= min(size, inflight_);
+   adjust();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ScanBatchController::adjust()
+{
+   auto usage = memoryUsage();
+   auto size = batchSize_.load(memory_order_relaxed);
+   auto depth = queueDepth_.load(memory_order_relaxed);
+
+   auto rates = [this](void)->string
+   {
+      const char* names[] = { "outputs", "inputs", "commit" };
+
+      stringstream ss;
+      for (unsigned i = 0; i < ScanStage_Count; i++)
+      {
+         if (i > 0)
+            ss << ", ";
+
+         ss << names[i] << ": ";
+         if (stages_[i].seconds_ > 0)
+            ss << toMB(stages_[i].bytes_ / stages_[i].seconds_) << "/s";
+         else
+            ss << "n/a";
+      }
+
+      return ss.str();
+   };
+
+   auto commitBusy = stages_[ScanStage_Commit].seconds_;
+   double idleRatio = 0;
+   if (commitBusy + commitIdle_ > 0)
+      idleRatio = commitIdle_ / (commitBusy + commitIdle_);
+
+   if (usage > budget_)
+   {
+      auto newSize = max(size / 2, (size_t)SCAN_BATCH_SIZE_MIN);
+      auto newDepth = max(depth, 2U) - 1;
+
+      if (newSize != size || newDepth != depth)
+      {
+         LOGINFO << "scan memory use at " << toMB(usage) << " over " <<
+            toMB(budget_) << " budget, batch size: " << toMB(newSize) <<
+            ", queue depth: " << newDepth << " (" << rates() << ")";
+      }
+
+      size = newSize;
+      depth = newDepth;
+      cooldown_ = SCAN_GROW_COOLDOWN;
+   }
+   else if (cooldown_ > 0)
+   {
+      --cooldown_;
+   }
+   else if (idleRatio > 0.5 && usage < budget_ / 2)
+   {
+      auto newSize = min(size + size / 2, (size_t)SCAN_BATCH_SIZE_MAX);
+      auto newDepth = min(depth + 1, maxDepthFor(newSize));
+
+      //a bigger batch that doesn't leave room for the current queue
+      //is not worth it
+      if (newDepth < depth)
+      {
+         newSize = size;
+         newDepth = min(depth + 1, maxDepthFor(size));
+      }
+
+      if (newSize != size || newDepth != depth)
+      {
+         LOGINFO << "commit idle " << (unsigned)(idleRatio * 100) <<
+            "% of the time, batch size: " << toMB(newSize) <<
+            ", queue depth: " << newDepth << " (" << rates() << ")";
+      }
+
+      size = newSize;
+      depth = newDepth;
+   }
+
+   batchSize_.store(size, memory_order_relaxed);
+   queueDepth_.store(depth, memory_order_relaxed);
+
+   //stats cover a single batch
+   for (auto& stage : stages_)
+      stage = StageStats();
+   commitIdle_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t ScanBatchController::residentMemory()
+{
+#ifdef __linux__
+   //statm is in pages: size resident shared ...
+   ifstream statm("/proc/self/statm");
+   size_t total = 0, resident = 0, shared = 0;
+   if (!(statm >> total >> resident >> shared))
+      return 0;
+
+   if (shared > resident)
+      return 0;
+
+   return (resident - shared) * (size_t)sysconf(_SC_PAGESIZE);
+#else
+   return 0;
+#endif
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SCANBATCHCONTROLLER_H_
+#define _SCANBATCHCONTROLLER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+//memory budget per --ram-usage level
+#define SCAN_RAM_LEVEL_SIZE (1024 * 1024 * 128ULL)
+
+#define SCAN_BATCH_SIZE_MIN (1024 * 1024 * 16ULL)
+#define SCAN_BATCH_SIZE_MAX (1024 * 1024 * 1024ULL)
+#define SCAN_QUEUE_DEPTH_MAX 16
+
+//batches to wait after a shrink before growing again
+#define SCAN_GROW_COOLDOWN 4
+
+enum ScanStage
+{
+   ScanStage_Outputs,
+   ScanStage_Inputs,
+   ScanStage_Commit,
+   ScanStage_Count
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class ScanBatchController
+{
+   /***
+   Sizes the scanner's batches (raw block data per batch) and the number of
+   batches queued ahead of the commit stage, from the --ram-usage budget and
+   the throughput of each scan stage.
+
+   Memory use is the growth of the process' anonymous resident memory since
+   the scan started. Mapped block files are left out, the kernel can drop
+   those pages on its own. Where that figure isn't available, the raw size
+   of the batches in flight stands in for it.
+
+   The controller reevaluates after each committed batch. Over budget, the
+   batch size is halved and the queue shortened by one. Under half the
+   budget with the commit stage idle for most of the last batch (the
+   parsers are the bottleneck), batches grow by half and the queue deepens
+   by one, as long as the queue still fits the budget.
+   ***/
+
+public:
+   typedef std::function<size_t(void)> MemoryProbe;
+
+private:
+   struct StageStats
+   {
+      double bytes_ = 0;
+      double seconds_ = 0;
+   };
+
+   const size_t budget_;
+   const MemoryProbe memoryProbe_;
+   const size_t baseline_;
+
+   std::atomic<size_t> batchSize_;
+   std::atomic<unsigned> queueDepth_;
+
+   std::mutex mu_;
+   StageStats stages_[ScanStage_Count];
+   double commitIdle_ = 0;
+   size_t inflight_ = 0;
+   unsigned cooldown_ = 0;
+
+private:
+   size_t memoryUsage(void);
+   unsigned maxDepthFor(size_t batchSize) const;
+   void adjust(void);
+
+public:
+   //budget is ramLevel * SCAN_RAM_LEVEL_SIZE. The probe returns memory use
+   //in bytes, 0 if it isn't available. Defaults to the process' anonymous
+   //resident memory
+   ScanBatchController(unsigned ramLevel, MemoryProbe probe = nullptr);
+
+   size_t batchSize(void) const
+   { return batchSize_.load(std::memory_order_relaxed); }
+   unsigned queueDepth(void) const
+   { return queueDepth_.load(std::memory_order_relaxed); }
+   size_t budget(void) const { return budget_; }
+
+   void batchQueued(size_t size);
+   void stageDone(ScanStage, size_t size, double seconds);
+   void commitIdle(double seconds);
+
+   //reevaluates batch size and queue depth
+   void batchCommitted(size_t size);
+
+   static size_t residentMemory(void);
+};
+
+#endif
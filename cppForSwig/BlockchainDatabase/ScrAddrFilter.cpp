@@ -17,6 +17,7 @@
 #include "TxOutScrRef.h"
 
 #include <thread>
+#include <chrono>
 #include <google/protobuf/message.h>
 
 
@@ -205,6 +206,27 @@ void ScrAddrFilter::setSSHLastScanned(set<BinaryDataRef>& addrSet,
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void ScrAddrFilter::setSSHBirthHeights(const map<BinaryDataRef, unsigned>& addrMap)
+{
+   auto&& tx = lmdb_->beginTransaction(SSH, LMDB::ReadWrite);
+   for (auto& addrPair : addrMap)
+   {
+      if (addrPair.second == 0)
+         continue;
+
+      //leave addresses with history in the db alone
+      StoredScriptHistory ssh;
+      lmdb_->getStoredScriptHistorySummary(ssh, addrPair.first);
+      if (ssh.isInitialized())
+         continue;
+
+      ssh.uniqueKey_ = addrPair.first;
+      ssh.scanHeight_ = addrPair.second - 1;
+      lmdb_->putStoredScriptHistorySummary(ssh);
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void ScrAddrFilter::setSSHLastScanned(unsigned height)
 {
@@ -271,102 +293,81 @@ void ScrAddrFilter::pushAddressBatch(shared_ptr<AddressBatch> batch)
 ///////////////////////////////////////////////////////////////////////////////
 void ScrAddrFilter::registrationThread()
 {
+   shared_ptr<AddressBatch> nextBatch;
+
    while (1)
    {
       shared_ptr<AddressBatch> batch;
-      try
+      if (nextBatch != nullptr)
       {
-         batch = move(registrationStack_.pop_front());
+         batch = move(nextBatch);
       }
-      catch (Armory::Threading::StopBlockingLoop&)
+      else
       {
-         //end loop condition
-         break;
+         try
+         {
+            batch = move(registrationStack_.pop_front());
+         }
+         catch (Armory::Threading::StopBlockingLoop&)
+         {
+            //end loop condition
+            break;
+         }
       }
 
       switch (batch->type_)
       {
       case AddressBatch_register:
       {
+         vector<shared_ptr<RegistrationBatch>> batches;
          auto batchPtr = dynamic_pointer_cast<RegistrationBatch>(batch);
          if (batchPtr == nullptr)
             throw runtime_error("unexpected batch ptr type");
-
-         if (Armory::Config::DBSettings::getDbType() == ARMORY_DB_SUPER)
+         batches.push_back(batchPtr);
+
+         //a side scan is expensive. When other registrations are already
+         //queued behind this one (i.e. a client registering all its wallets
+         //on startup), give the rest of the burst a chance to land so they
+         //are served by the same scan. A lone registration doesn't wait
+         if (!batchPtr->isNew_ && registrationStack_.count() > 0 &&
+            bdmIsRunning() &&
+            Armory::Config::DBSettings::getDbType() != ARMORY_DB_SUPER)
          {
-            //no scanning required in supernode, just update the address map
-            auto&& scaSet = updateAddrMap(batchPtr->scrAddrSet_, 0, false);
-            batchPtr->callback_(scaSet);
-            continue;
+            this_thread::sleep_for(
+               chrono::milliseconds(REGISTRATION_SETTLE_MS));
          }
 
-         //filter out collisions
-         set<BinaryDataRef> addrSet;
+         //merge all queued registrations, stop at the first unregistration
+         //to preserve ordering
+         while (1)
          {
-            auto scraddrmap = scanFilterAddrMap_->get();
-            for (auto& sa : batchPtr->scrAddrSet_)
+            shared_ptr<AddressBatch> queued;
+            try
             {
-               BinaryData sabd(sa);
-               auto iter = scraddrmap->find(sa);
-               if (iter != scraddrmap->end())
-                  continue;
-
-               addrSet.insert(sa);
+               queued = move(registrationStack_.pop_front(false));
+            }
+            catch (Armory::Threading::IsEmpty&)
+            {
+               break;
+            }
+            catch (Armory::Threading::StopBlockingLoop&)
+            {
+               break;
             }
-         }
-
-         if (addrSet.size() == 0 || !bdmIsRunning())
-         {
-            //all addresses are already registered
-            //or db isn't running yet
-            auto&& scaSet = updateAddrMap(batchPtr->scrAddrSet_, 0, false);
-            batchPtr->callback_(scaSet);
-            continue;
-         }
 
-         LOGINFO << "Starting address registration process";
+            if (queued->type_ != AddressBatch_register)
+            {
+               nextBatch = move(queued);
+               break;
+            }
 
-         //BDM is initialized and maintenance thread is running, scan batch
-         uint32_t topBlockHeight = blockchain()->top()->getBlockHeight();
-         
-         if (batchPtr->isNew_)
-         {
-            //batch is flagged as new, all addresses within it are assumed
-            //clean of history. Update the map and continue
-            auto&& scaSet = updateAddrMap(batchPtr->scrAddrSet_, 0, false);
-            setSSHLastScanned(addrSet, topBlockHeight);
-            batchPtr->callback_(scaSet);
-            continue;
+            auto queuedPtr = dynamic_pointer_cast<RegistrationBatch>(queued);
+            if (queuedPtr == nullptr)
+               throw runtime_error("unexpected batch ptr type");
+            batches.push_back(queuedPtr);
          }
 
-         //scan the batch
-         vector<string> walletIDs;
-         walletIDs.push_back(batchPtr->walletID_);
-         auto saf = getNew(SIDESCAN_ID);
-         saf->updateAddrMap(addrSet, 0, false);
-         saf->applyBlockRangeToDB(0, walletIDs, true);
-
-         //merge with main address filter
-         set<BinaryDataRef> newAddrSet;
-         auto newMap = saf->scanFilterAddrMap_->get();
-         for (auto& saPair : *newMap)
-            newAddrSet.insert(saPair.first);
-         scanFilterAddrMap_->update(*newMap);
-         updateAddressMerkleInDB();
-
-         //final scan to sync all addresses to same height
-         applyBlockRangeToDB(topBlockHeight + 1, walletIDs, false);
-         
-         //cleanup
-         saf->cleanUpSdbis();
-
-         //notify
-         for (const auto& wID : walletIDs)
-            LOGINFO << "Completed scan of wallet " << wID;
-
-         auto&& scaSet = updateAddrMap(batchPtr->scrAddrSet_, 0, false);
-         batchPtr->callback_(scaSet);
-         
+         processRegistrations(batches);
          break;
       }
 
@@ -389,6 +390,135 @@ void ScrAddrFilter::registrationThread()
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void ScrAddrFilter::processRegistrations(
+   const vector<shared_ptr<RegistrationBatch>>& batches)
+{
+   auto finalize = [this](RegistrationBatch& batch)->void
+   {
+      auto&& scaSet = updateAddrMap(batch.scrAddrSet_, 0, false);
+      batch.callback_(scaSet);
+   };
+
+   if (Armory::Config::DBSettings::getDbType() == ARMORY_DB_SUPER ||
+      !bdmIsRunning())
+   {
+      //no scanning required in supernode, just update the address map
+      //if the db isn't running yet, the initial scan will cover these
+      for (auto& batchPtr : batches)
+         finalize(*batchPtr);
+      return;
+   }
+
+   //BDM is initialized and maintenance thread is running
+   uint32_t topBlockHeight = blockchain()->top()->getBlockHeight();
+
+   //filter out collisions, merge the rest into one scan map 
+   //<address, birth height>
+   map<BinaryDataRef, unsigned> scanMap;
+   set<BinaryDataRef> newAddrSet;
+   vector<shared_ptr<RegistrationBatch>> scanBatches;
+   {
+      auto scraddrmap = scanFilterAddrMap_->get();
+      for (auto& batchPtr : batches)
+      {
+         set<BinaryDataRef> addrSet;
+         for (auto& sa : batchPtr->scrAddrSet_)
+         {
+            if (scraddrmap->find(sa) != scraddrmap->end() ||
+               newAddrSet.find(sa) != newAddrSet.end())
+               continue;
+
+            addrSet.insert(sa);
+         }
+
+         if (addrSet.empty())
+         {
+            //all addresses are already registered
+            finalize(*batchPtr);
+            continue;
+         }
+
+         if (batchPtr->isNew_)
+         {
+            //batch is flagged as new, all addresses within it are assumed
+            //clean of history. Update the map and move on
+            setSSHLastScanned(addrSet, topBlockHeight);
+            newAddrSet.insert(addrSet.begin(), addrSet.end());
+            finalize(*batchPtr);
+            continue;
+         }
+
+         for (auto& sa : addrSet)
+         {
+            auto height = batchPtr->getBirthHeight(sa);
+            auto insertIter = scanMap.emplace(sa, height);
+            if (!insertIter.second && insertIter.first->second > height)
+               insertIter.first->second = height;
+         }
+
+         scanBatches.push_back(batchPtr);
+      }
+   }
+
+   if (scanBatches.empty())
+      return;
+
+   set<BinaryDataRef> addrSet;
+   unsigned scanFrom = UINT32_MAX;
+   for (auto& addrPair : scanMap)
+   {
+      addrSet.insert(addrPair.first);
+      scanFrom = min(scanFrom, addrPair.second);
+   }
+
+   if (scanFrom > topBlockHeight + 1)
+      scanFrom = topBlockHeight + 1;
+
+   vector<string> walletIDs;
+   {
+      set<string> idSet;
+      for (auto& batchPtr : scanBatches)
+      {
+         if (idSet.insert(batchPtr->walletID_).second)
+            walletIDs.push_back(batchPtr->walletID_);
+      }
+   }
+
+   LOGINFO << "Starting address registration process for " <<
+      scanBatches.size() << " batch(es), " << addrSet.size() << 
+      " addresses, from height #" << scanFrom;
+
+   //addresses without history are flagged as scanned up to their birth 
+   //height, the scanner ignores outputs below that
+   setSSHBirthHeights(scanMap);
+
+   //scan the batch, the scanner only parses blocks whose script
+   //filter matches these addresses or the outpoints they receive
+   auto saf = getNew(SIDESCAN_ID);
+   sideScanCount_.fetch_add(1, memory_order_relaxed);
+   saf->updateAddrMap(addrSet, 0, false);
+   saf->applyBlockRangeToDB(scanFrom, walletIDs, true);
+
+   //merge with main address filter
+   auto newMap = saf->scanFilterAddrMap_->get();
+   scanFilterAddrMap_->update(*newMap);
+   updateAddressMerkleInDB();
+
+   //final scan to sync all addresses to same height
+   applyBlockRangeToDB(topBlockHeight + 1, walletIDs, false);
+   
+   //cleanup
+   saf->cleanUpSdbis();
+
+   //notify
+   for (const auto& wID : walletIDs)
+      LOGINFO << "Completed scan of wallet " << wID;
+
+   for (auto& batchPtr : scanBatches)
+      finalize(*batchPtr);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 int32_t ScrAddrFilter::scanFrom() const
 {
@@ -505,24 +635,42 @@ bool ScrAddrFilter::hasNewAddresses(void) const
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-shared_ptr<unordered_map<TxOutScriptRef, int>> ScrAddrFilter::getOutScrRefMap()
+shared_ptr<const ScriptRefTable> ScrAddrFilter::getOutScrRefTable()
 {
    getScrAddrCurrentSyncState();
-   auto outset = make_shared<unordered_map<TxOutScriptRef, int>>();
-
    auto scrAddrMap = scanFilterAddrMap_->get();
 
+   unique_lock<mutex> lock(scrRefTableMutex_);
+
+   //same address set as the last build, only refresh the scan heights
+   if (scrRefTable_ != nullptr && scrAddrMap == scrRefTableSnapshot_)
+   {
+      vector<int> heights;
+      heights.reserve(scrRefTable_->size());
+      for (auto& scrAddr : *scrAddrMap)
+      {
+         if (scrAddr.first.empty())
+            continue;
+         heights.push_back(scrAddr.second->scannedHeight_);
+      }
+
+      scrRefTable_ = make_shared<ScriptRefTable>(*scrRefTable_, move(heights));
+      return scrRefTable_;
+   }
+
+   vector<pair<BinaryDataRef, int>> entries;
+   entries.reserve(scrAddrMap->size());
    for (auto& scrAddr : *scrAddrMap)
    {
       if (scrAddr.first.empty())
          continue;
 
-      TxOutScriptRef scrRef;
-      scrRef.setRef(scrAddr.first);
-      outset->emplace(move(scrRef), scrAddr.second->scannedHeight_);
+      entries.emplace_back(scrAddr.first, scrAddr.second->scannedHeight_);
    }
 
-   return outset;
+   scrRefTable_ = make_shared<ScriptRefTable>(entries);
+   scrRefTableSnapshot_ = scrAddrMap;
+   return scrRefTable_;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -26,9 +26,13 @@
 #include "StoredBlockObj.h"
 #include "lmdb_wrapper.h"
 #include "Blockchain.h"
+#include "ScriptRefTable.h"
 
 #define SIDESCAN_ID 0x100000ff
 
+//grace period for registrations to pile up before a side scan starts
+#define REGISTRATION_SETTLE_MS 250
+
 namespace google
 {
    namespace protobuf
@@ -64,9 +68,22 @@ struct RegistrationBatch : public AddressBatch
    bool isNew_;
    std::string walletID_;
 
+   //optional birth heights, there is no history for these addresses below 
+   //them. Addresses without an entry are scanned from the genesis block
+   std::map<BinaryDataRef, unsigned> addrBirthHeights_;
+
    RegistrationBatch(void) : 
       AddressBatch(AddressBatch_register)
    {}
+
+   unsigned getBirthHeight(BinaryDataRef scrAddr) const
+   {
+      auto iter = addrBirthHeights_.find(scrAddr);
+      if (iter != addrBirthHeights_.end())
+         return iter->second;
+
+      return 0;
+   }
 };
 
 ////
@@ -156,6 +173,10 @@ class ScrAddrFilter
 
    4) Signal the wallet that the address is ready. Wallet object will take it
    up from there.
+
+   Registrations queued while a side scan runs are merged and served by a
+   single scan, starting at the lowest birth height in the set. Callbacks
+   still fire per batch.
    ***/
    
 private:
@@ -169,6 +190,13 @@ private:
       std::shared_ptr<AddressBatch>> registrationStack_;
 
    std::thread thr_;
+   std::atomic<unsigned> sideScanCount_ = { 0 };
+
+   //output lookup table, rebuilt when the address map changes
+   std::mutex scrRefTableMutex_;
+   std::shared_ptr<const std::map<BinaryDataRef, 
+      std::shared_ptr<AddrAndHash>>> scrRefTableSnapshot_;
+   std::shared_ptr<const ScriptRefTable> scrRefTable_;
 
 public:
    std::mutex mergeLock_;
@@ -176,6 +204,8 @@ public:
 private:
    static void cleanUpPreviousChildren(LMDBBlockDatabase* lmdb);
    void registrationThread(void);
+   void processRegistrations(
+      const std::vector<std::shared_ptr<RegistrationBatch>>&);
 
    std::shared_ptr<Armory::Threading::TransactionalMap<
       BinaryDataRef, std::shared_ptr<AddrAndHash>>> getZcFilterMapPtr(void) const
@@ -186,6 +216,7 @@ private:
    std::set<BinaryDataRef> updateAddrMap(
       const std::set<BinaryDataRef>&, unsigned, bool );
    void setSSHLastScanned(std::set<BinaryDataRef>&, unsigned);
+   void setSSHBirthHeights(const std::map<BinaryDataRef, unsigned>&);
 
 protected:
    std::function<void(
@@ -218,8 +249,14 @@ public:
       return scanFilterAddrMap_->size();
    }
 
+   //side scans run for post init registrations since startup
+   unsigned getSideScanCount(void) const
+   {
+      return sideScanCount_.load(std::memory_order_relaxed);
+   }
+
    ////
-   std::shared_ptr<std::unordered_map<TxOutScriptRef, int>> getOutScrRefMap(void);
+   std::shared_ptr<const ScriptRefTable> getOutScrRefTable(void);
    int32_t scanFrom(void) const;
    void pushAddressBatch(std::shared_ptr<AddressBatch>);
 
@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCRIPTTABLE_SSE2
+#endif
+
+#include "ScriptRefTable.h"
+#include "TxOutScrRef.h"
+
+using namespace std;
+
+#define CTRL_EMPTY ((int8_t)0x80)
+
+namespace
+{
+   //split block bloom salts, one per word in a block
+   const uint32_t bloomSalts[8] = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U };
+
+   /////////////////////////////////////////////////////////////////////////////
+   inline uint64_t fmix64(uint64_t k)
+   {
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdULL;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ULL;
+      k ^= k >> 33;
+      return k;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   inline unsigned countTrailingZeros(uint32_t val)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctz(val);
+#else
+      unsigned count = 0;
+      while ((val & 1) == 0)
+      {
+         val >>= 1;
+         ++count;
+      }
+      return count;
+#endif
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   uint64_t nextPow2(uint64_t val)
+   {
+      uint64_t result = 1;
+      while (result < val)
+         result <<= 1;
+      return result;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   //bitmasks of the slots in a group that carry the tag, and of empty slots
+   inline void probeGroup(const int8_t* ctrl, int8_t tag,
+      uint32_t& matches, uint32_t& empties)
+   {
+#ifdef SCRIPTTABLE_SSE2
+      auto group = _mm_loadu_si128((const __m128i*)ctrl);
+      matches = (uint32_t)_mm_movemask_epi8(
+         _mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+      empties = (uint32_t)_mm_movemask_epi8(group);
+#else
+      matches = 0;
+      empties = 0;
+      for (unsigned i = 0; i < SCRIPTTABLE_GROUP_WIDTH; i++)
+      {
+         if (ctrl[i] == tag)
+            matches |= 1U << i;
+         else if (ctrl[i] == CTRL_EMPTY)
+            empties |= 1U << i;
+      }
+#endif
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ScriptRefTable::ScriptRefTable(
+   const vector<pair<BinaryDataRef, int>>& entries) :
+   index_(buildIndex(entries))
+{
+   heights_.reserve(entries.size());
+   for (auto& entry : entries)
+      heights_.push_back(entry.second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ScriptRefTable::ScriptRefTable(const ScriptRefTable& base, vector<int> heights) :
+   index_(base.index_), heights_(move(heights))
+{
+   if (heights_.size() != base.heights_.size())
+      throw runtime_error("height count mismatch");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<const ScriptRefTable::Index> ScriptRefTable::buildIndex(
+   const vector<pair<BinaryDataRef, int>>& entries)
+{
+   if (entries.size() >= UINT32_MAX)
+      throw runtime_error("too many scripts");
+
+   auto index = make_shared<Index>();
+   uint64_t count = entries.size();
+
+   //pack keys
+   size_t totalSize = 0;
+   for (auto& entry : entries)
+   {
+      if (entry.first.getSize() == 0)
+         throw runtime_error("empty scrAddr");
+      totalSize += entry.first.getSize();
+   }
+
+   if (totalSize >= UINT32_MAX)
+      throw runtime_error("script keys too large");
+
+   index->keys_.resize(totalSize);
+   index->offsets_.reserve(count + 1);
+   size_t offset = 0;
+   for (auto& entry : entries)
+   {
+      index->offsets_.push_back((uint32_t)offset);
+      memcpy(index->keys_.getPtr() + offset,
+         entry.first.getPtr(), entry.first.getSize());
+      offset += entry.first.getSize();
+   }
+   index->offsets_.push_back((uint32_t)offset);
+
+   //bloom: 256 bits per block
+   auto blockCount = nextPow2(
+      (count * SCRIPTTABLE_BLOOM_BITS_PER_KEY + 255) / 256);
+   index->bloom_.resize(blockCount * 8, 0);
+   index->bloomMask_ = blockCount - 1;
+
+   //table: keep the load under 7/8 so that every probe sequence ends on
+   //a group with an empty slot
+   auto slotCount = (count * 8 + 6) / 7;
+   auto groupCount = nextPow2(
+      (slotCount + SCRIPTTABLE_GROUP_WIDTH - 1) / SCRIPTTABLE_GROUP_WIDTH);
+   if (groupCount * SCRIPTTABLE_GROUP_WIDTH <= count)
+      groupCount *= 2;
+
+   index->ctrl_.resize(groupCount * SCRIPTTABLE_GROUP_WIDTH, CTRL_EMPTY);
+   index->slots_.resize(groupCount * SCRIPTTABLE_GROUP_WIDTH, 0);
+   index->groupMask_ = groupCount - 1;
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      auto key = entries[i].first;
+      auto script = key.getSliceRef(1, key.getSize() - 1);
+      auto hash = hashKey(key.getPtr()[0], script);
+
+      //bloom
+      auto block = &index->bloom_[((hash >> 32) & index->bloomMask_) * 8];
+      for (unsigned y = 0; y < 8; y++)
+         block[y] |= 1U << (((uint32_t)hash * bloomSalts[y]) >> 27);
+
+      //table
+      auto tag = (int8_t)(hash & 0x7F);
+      auto group = (hash >> 7) & index->groupMask_;
+      for (uint64_t step = 1;; step++)
+      {
+         auto ctrl = &index->ctrl_[group * SCRIPTTABLE_GROUP_WIDTH];
+
+         uint32_t matches, empties;
+         probeGroup(ctrl, tag, matches, empties);
+
+         while (matches != 0)
+         {
+            auto slot = countTrailingZeros(matches);
+            auto entryId = index->slots_[
+               group * SCRIPTTABLE_GROUP_WIDTH + slot];
+            if (entries[entryId].first == key)
+               throw runtime_error("duplicate scrAddr");
+            matches &= matches - 1;
+         }
+
+         if (empties != 0)
+         {
+            auto slot = countTrailingZeros(empties);
+            ctrl[slot] = tag;
+            index->slots_[group * SCRIPTTABLE_GROUP_WIDTH + slot] = i;
+            break;
+         }
+
+         group = (group + step) & index->groupMask_;
+      }
+   }
+
+   return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptRefTable::bloomCheck(uint64_t hash) const
+{
+   auto block = &index_->bloom_[((hash >> 32) & index_->bloomMask_) * 8];
+
+   uint32_t missing = 0;
+   for (unsigned i = 0; i < 8; i++)
+   {
+      auto mask = 1U << (((uint32_t)hash * bloomSalts[i]) >> 27);
+      missing |= ~block[i] & mask;
+   }
+
+   return missing == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptRefTable::keyMatch(
+   uint32_t entry, uint8_t type, BinaryDataRef script) const
+{
+   auto start = index_->offsets_[entry];
+   auto size = index_->offsets_[entry + 1] - start;
+   if (size != script.getSize() + 1)
+      return false;
+
+   auto ptr = index_->keys_.getPtr() + start;
+   if (ptr[0] != type)
+      return false;
+
+   return memcmp(ptr + 1, script.getPtr(), script.getSize()) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptRefTable::find(const TxOutScriptRef& scrRef, int& height) const
+{
+   auto type = (uint8_t)scrRef.type_;
+   auto hash = hashKey(type, scrRef.scriptRef_);
+   if (!bloomCheck(hash))
+      return false;
+
+   auto tag = (int8_t)(hash & 0x7F);
+   auto group = (hash >> 7) & index_->groupMask_;
+   for (uint64_t step = 1;; step++)
+   {
+      auto ctrl = &index_->ctrl_[group * SCRIPTTABLE_GROUP_WIDTH];
+
+      uint32_t matches, empties;
+      probeGroup(ctrl, tag, matches, empties);
+
+      while (matches != 0)
+      {
+         auto slot = countTrailingZeros(matches);
+         auto entry = index_->slots_[group * SCRIPTTABLE_GROUP_WIDTH + slot];
+         if (keyMatch(entry, type, scrRef.scriptRef_))
+         {
+            height = heights_[entry];
+            return true;
+         }
+
+         matches &= matches - 1;
+      }
+
+      if (empties != 0)
+         return false;
+
+      group = (group + step) & index_->groupMask_;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ScriptRefTable::find(BinaryDataRef scrAddr, int& height) const
+{
+   if (scrAddr.getSize() == 0)
+      return false;
+
+   TxOutScriptRef scrRef;
+   scrRef.setRef(scrAddr);
+   return find(scrRef, height);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64_t ScriptRefTable::hashKey(uint8_t type, BinaryDataRef script)
+{
+   /*
+   Script keys are hash160/hash256 for all standard types, the leading and
+   trailing 8 bytes carry plenty of entropy. Multisig keys and OP_RETURN
+   payloads are not uniform, the finalizer rounds take care of those.
+   */
+
+   auto ptr = script.getPtr();
+   auto size = script.getSize();
+
+   uint64_t head = 0, tail = 0;
+   if (size >= 8)
+   {
+      memcpy(&head, ptr, 8);
+      memcpy(&tail, ptr + size - 8, 8);
+   }
+   else if (size > 0)
+   {
+      memcpy(&head, ptr, size);
+   }
+
+   uint64_t hash = ((uint64_t)type << 56) ^ (uint64_t)size;
+   hash = fmix64(hash ^ head);
+   hash = fmix64(hash ^ tail);
+   return hash;
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SCRIPTREFTABLE_H_
+#define _SCRIPTREFTABLE_H_
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "BinaryData.h"
+
+//slots per probing group, one control byte each
+#define SCRIPTTABLE_GROUP_WIDTH 16
+
+//bloom prefilter budget, ~0.1% false positives at 16 bits per script
+#define SCRIPTTABLE_BLOOM_BITS_PER_KEY 16
+
+struct TxOutScriptRef;
+
+////////////////////////////////////////////////////////////////////////////////
+class ScriptRefTable
+{
+   /***
+   Read only lookup table for the scanner's output matching, maps scrAddr
+   (prefix byte | script hash) to the ssh scan height of that address.
+
+   Scripts are hashed once. The high half of the hash picks a block in a
+   split block bloom filter that rejects most misses off a single cache
+   line. Survivors probe an open addressing table: groups of 16 one byte
+   tags (7 low hash bits, high bit flags an empty slot) are compared in one
+   go (SSE2 when available), only tag hits compare the full key.
+
+   The key index is immutable and shared between tables built off the same
+   address set, so that heights can be refreshed without rehashing.
+   ***/
+
+private:
+   struct Index
+   {
+      //bloom, 8 x 32bit words per block
+      std::vector<uint32_t> bloom_;
+      uint64_t bloomMask_ = 0;
+
+      //control bytes and entry id per slot
+      std::vector<int8_t> ctrl_;
+      std::vector<uint32_t> slots_;
+      uint64_t groupMask_ = 0;
+
+      //packed scrAddr keys, entry i is [offsets_[i], offsets_[i+1])
+      BinaryData keys_;
+      std::vector<uint32_t> offsets_;
+   };
+
+   std::shared_ptr<const Index> index_;
+   std::vector<int> heights_;
+
+private:
+   static std::shared_ptr<const Index> buildIndex(
+      const std::vector<std::pair<BinaryDataRef, int>>&);
+
+   bool bloomCheck(uint64_t hash) const;
+   bool keyMatch(uint32_t entry, uint8_t type, BinaryDataRef script) const;
+
+public:
+   //build from scrAddr, scan height pairs. Keys have to be unique and not
+   //empty, throws std::runtime_error otherwise
+   ScriptRefTable(const std::vector<std::pair<BinaryDataRef, int>>&);
+
+   //share the key index of an existing table, heights have to be in the
+   //same order as the entries the base table was built from
+   ScriptRefTable(const ScriptRefTable& base, std::vector<int> heights);
+
+   size_t size(void) const { return heights_.size(); }
+
+   //false if the script is not tracked, sets height otherwise
+   bool find(const TxOutScriptRef&, int& height) const;
+   bool find(BinaryDataRef scrAddr, int& height) const;
+
+   static uint64_t hashKey(uint8_t type, BinaryDataRef script);
+};
+
+#endif
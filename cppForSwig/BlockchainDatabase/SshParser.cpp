@@ -175,34 +175,11 @@ void ShardedSshParser::updateSsh()
    LOGINFO << "updating SSH";
    auto now = chrono::system_clock::now();
 
-   commitedBoundsCounter_.store(0, memory_order_relaxed);
-   fetchBoundsCounter_.store(0, memory_order_relaxed);
-
    //initialize bounds vector
    firstShard_ = db_->getShardIdForHeight(firstHeight_);
    setupBounds();
 
-
-   //parser lambda
-   auto ssh_lambda = [this](void)->void
-   {
-      parseSshThread();
-   };
-
-   vector<thread> threads;
-   unsigned count = threadCount_;
-   if (threadCount_ > 1)
-      --count;
-   for (unsigned i = 0; i < count; i++)
-      threads.push_back(thread(ssh_lambda));
-
-   putSSH();
-
-   for (auto& thr : threads)
-   {
-      if (thr.joinable())
-         thr.join();
-   }
+   run();
 
    chrono::duration<double> length = chrono::system_clock::now() - now;
    LOGINFO << "Updated SSH in " << length.count() << "s";
@@ -211,73 +188,219 @@ void ShardedSshParser::updateSsh()
 ////////////////////////////////////////////////////////////////////////////////
 void ShardedSshParser::undo()
 {
-   commitedBoundsCounter_.store(0, memory_order_relaxed);
-   fetchBoundsCounter_.store(0, memory_order_relaxed);
-
    //initialize
    firstShard_ = db_->getShardIdForHeight(firstHeight_);
    undo_ = true;
    setupBounds();
 
+   run();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void ShardedSshParser::run()
+{
+   fetchBoundsCounter_.store(0, memory_order_relaxed);
+   completedBoundsCounter_.store(0, memory_order_relaxed);
+   parserFailed_.store(false, memory_order_relaxed);
+
+   //one record queue per parser thread, this thread is the writer
+   unsigned count = threadCount_;
+   if (count > 1)
+      --count;
+
+   queues_.clear();
+   for (unsigned i = 0; i < count; i++)
+   {
+      queues_.push_back(
+         make_unique<SshRecordQueue>(SSH_RECORD_QUEUE_SIZE));
+   }
+
    //parser lambda
-   auto ssh_lambda = [this](void)->void
+   vector<exception_ptr> errors(count);
+   auto ssh_lambda = [this, &errors](unsigned index)->void
    {
-      parseSshThread();
+      try
+      {
+         parseSshThread(index);
+      }
+      catch (...)
+      {
+         //stop the writer and the other parsers
+         errors[index] = current_exception();
+         parserFailed_.store(true, memory_order_relaxed);
+         for (auto& queue : queues_)
+            queue->markDone();
+      }
+
+      queues_[index]->markDone();
    };
 
    vector<thread> threads;
-   for (unsigned i = 1; i < threadCount_; i++)
-      threads.push_back(thread(ssh_lambda));
-   putSSH();
+   for (unsigned i = 0; i < count; i++)
+      threads.push_back(thread(ssh_lambda, i));
+
+   exception_ptr writeError;
+   try
+   {
+      putSSH();
+   }
+   catch (...)
+   {
+      //unblock the parsers
+      writeError = current_exception();
+      for (auto& queue : queues_)
+         queue->markDone();
+   }
 
    for (auto& thr : threads)
    {
       if (thr.joinable())
          thr.join();
    }
+
+   queues_.clear();
+   boundsVector_.clear();
+
+   if (writeError != nullptr)
+      rethrow_exception(writeError);
+
+   for (auto& error : errors)
+   {
+      if (error != nullptr)
+         rethrow_exception(error);
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void ShardedSshParser::putSSH()
 {
+   /***
+   Each queue is sorted, merge them on the fly and write the result in key
+   order. Keys past the last entry in the ssh db at the start of the run 
+   don't exist yet and can be appended, which is the bulk of the writes 
+   on an initial build.
+
+   The write txn is committed before waiting on a parser, so it never blocks
+   other writers on parsing. If a parser fails, the batch in flight is 
+   rolled back, run() rethrows the parser's error.
+   ***/
+
+   BinaryData lastDbKey;
+   {
+      auto tx = db_->beginTransaction(SSH, LMDB::ReadOnly);
+      auto dbIter = db_->getIterator(SSH);
+      if (dbIter->seekToLast())
+         lastDbKey = dbIter->getKey();
+   }
+
    auto len = boundsVector_.size();
-   auto increment = len / 100;
+   unsigned lastProgress = 0;
 
-   for (unsigned i = 0; i < len; i++)
-   {
-      auto batch = boundsVector_[i].get();
-      batch->fut_.wait();
+   unique_ptr<DbTransaction> tx;
+   size_t batchCount = 0;
+   uint64_t appendCount = 0;
+   uint64_t writeCount = 0;
 
-      if (batch->serializedSsh_.size() > 0)
+   try
+   {
+      while (true)
       {
-         auto tx = db_->beginTransaction(SSH, LMDB::ReadWrite);
-         for (auto& ssh_pair : batch->serializedSsh_)
+         if (parserFailed_.load(memory_order_relaxed))
+            break;
+
+         //commit before waiting on a queue
+         if (tx != nullptr)
          {
-            if (ssh_pair.second.getSize() > 0)
+            for (auto& queue : queues_)
             {
-               db_->putValue(SSH,
-                  ssh_pair.first.getRef(),
-                  ssh_pair.second.getDataRef());
+               if (queue->ready())
+                  continue;
+
+               tx.reset();
+               batchCount = 0;
+               break;
             }
-            else
+         }
+
+         //grab the queue with the smallest head
+         SshRecordQueue* minQueue = nullptr;
+         const SshRecord* minRecord = nullptr;
+         for (auto& queue : queues_)
+         {
+            auto record = queue->front();
+            if (record == nullptr)
+               continue;
+
+            if (minRecord == nullptr || record->key_ < minRecord->key_)
             {
-               db_->deleteValue(SSH, ssh_pair.first.getRef());
+               minRecord = record;
+               minQueue = queue.get();
             }
          }
-      }
 
-      commitedBoundsCounter_.fetch_add(1, memory_order_relaxed);
-      writeThreadCV_.notify_all();
+         //a parser may have failed while we waited
+         if (minQueue == nullptr || parserFailed_.load(memory_order_relaxed))
+            break;
+
+         auto&& record = minQueue->pop();
+         if (tx == nullptr)
+            tx = db_->beginTransaction(SSH, LMDB::ReadWrite);
+
+         if (record.value_.getSize() == 0)
+         {
+            //nothing to delete past the end of the db
+            if (!(lastDbKey < record.key_))
+               db_->deleteValue(SSH, record.key_.getRef());
+         }
+         else if (lastDbKey < record.key_)
+         {
+            db_->appendValue(SSH, record.key_.getRef(), record.value_.getRef());
+            ++appendCount;
+         }
+         else
+         {
+            db_->putValue(SSH, record.key_.getRef(), record.value_.getRef());
+         }
+
+         ++writeCount;
+         if (++batchCount < SSH_WRITE_BATCH_SIZE)
+            continue;
+
+         //commit
+         tx.reset();
+         batchCount = 0;
 
-      //release bound ptr
-      auto batch_mv = move(boundsVector_[i]);
+         if (len == 0)
+            continue;
+
+         auto completed = completedBoundsCounter_.load(memory_order_relaxed);
+         auto progress = unsigned(float(completed) / float(len) * 100.0f);
+         if (progress != lastProgress)
+         {
+            LOGINFO << "ssh scan progress: " << progress << "%";
+            lastProgress = progress;
+         }
+      }
 
-      if (increment!=0 && i%increment == 0)
+      if (parserFailed_.load(memory_order_relaxed))
       {
-         float progress = float(i) / float(len);
-         LOGINFO << "ssh scan progress: " << progress * 100.0f << "%";
+         if (tx != nullptr)
+            tx->rollback();
+         LOGWARN << "ssh parser failed, dropped " << batchCount <<
+            " pending ssh entries";
+         return;
       }
    }
+   catch (...)
+   {
+      if (tx != nullptr)
+         tx->rollback();
+      throw;
+   }
+
+   tx.reset();
+   LOGINFO << "wrote " << writeCount << " ssh entries (" << 
+      appendCount << " appended)";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -479,16 +602,10 @@ void ShardedSshParser::mapSubSshDBThread(unsigned index)
 ////////////////////////////////////////////////////////////////////////////////
 SshBounds* ShardedSshParser::getNext()
 {
-   //if write queue is too long, wait on condvar, otherwise break
-   while (fetchBoundsCounter_.load(memory_order_relaxed) - 
-          commitedBoundsCounter_.load(memory_order_relaxed) > 
-          threadCount_ * 2)
-   {
-      unique_lock<mutex> lock(cvMutex_);
-      writeThreadCV_.wait(lock);
-   }
+   //no throttling here, the record queues apply backpressure on parsers
+   if (parserFailed_.load(memory_order_relaxed))
+      return nullptr;
 
-   //increment counter, grab bound ptr from vector
    auto id = fetchBoundsCounter_.fetch_add(1, memory_order_relaxed);
    if (id >= boundsVector_.size())
       return nullptr;
@@ -498,8 +615,10 @@ SshBounds* ShardedSshParser::getNext()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void ShardedSshParser::parseSshThread()
+void ShardedSshParser::parseSshThread(unsigned index)
 {
+   auto& queue = *queues_[index];
+
    //get top batch id
    auto&& subssh_sdbi = db_->getStoredDBInfo(SUBSSH, 0);
    auto id_max = subssh_sdbi.metaInt_;
@@ -770,31 +889,105 @@ void ShardedSshParser::parseSshThread()
          }
       }
 
-      //serialize result
-      bounds->serializeResult(sshMap);
+      //hand the result over to the writer
       bounds->time_ = chrono::system_clock::now() - now;
-
-      //flag as completed
-      bounds->completed_->set_value(true);
+      bounds->serializeResult(sshMap, queue);
+      completedBoundsCounter_.fetch_add(1, memory_order_relaxed);
    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void SshBounds::serializeResult(map<BinaryDataRef, StoredScriptHistory>& sshMap)
+void SshBounds::serializeResult(
+   map<BinaryDataRef, StoredScriptHistory>& sshMap, SshRecordQueue& queue)
 {
+   //sshMap is ordered by scrAddr, so are the records we push
    for (auto& ssh_pair : sshMap)
    {
+      SshRecord record;
+
       BinaryWriter bw_key(1 + ssh_pair.first.getSize());
       bw_key.put_uint8_t(DB_PREFIX_SCRIPT);
       bw_key.put_BinaryDataRef(ssh_pair.first);
+      record.key_ = bw_key.getData();
 
-      auto& bw = serializedSsh_[bw_key.getData()];
+      BinaryWriter bw;
       ssh_pair.second.serializeDBValue(bw, ARMORY_DB_SUPER);
+      record.value_ = bw.getData();
+
+      queue.push(move(record));
    }
 
    sshMap.clear();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//// SshRecordQueue
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void SshRecordQueue::push(SshRecord&& record)
+{
+   unique_lock<mutex> lock(mu_);
+   while (count_ == ring_.size() && !done_)
+      cv_.wait(lock);
+
+   //writer is gone
+   if (done_)
+      return;
+
+   auto pos = (head_ + count_) % ring_.size();
+   ring_[pos] = move(record);
+   ++count_;
+
+   cv_.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SshRecordQueue::markDone()
+{
+   unique_lock<mutex> lock(mu_);
+   done_ = true;
+   cv_.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const SshRecord* SshRecordQueue::front()
+{
+   unique_lock<mutex> lock(mu_);
+   while (count_ == 0)
+   {
+      if (done_)
+         return nullptr;
+
+      cv_.wait(lock);
+   }
+
+   //only the writer pops, the head entry stays put until it does
+   return &ring_[head_];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+SshRecord SshRecordQueue::pop()
+{
+   unique_lock<mutex> lock(mu_);
+   if (count_ == 0)
+      throw runtime_error("pop on empty ssh record queue");
+
+   auto record = move(ring_[head_]);
+   head_ = (head_ + 1) % ring_.size();
+   --count_;
+
+   cv_.notify_all();
+   return record;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SshRecordQueue::ready()
+{
+   unique_lock<mutex> lock(mu_);
+   return count_ > 0 || done_;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 shared_ptr<SshMapping> SshMapping::getMappingForKey(uint8_t key)
 {
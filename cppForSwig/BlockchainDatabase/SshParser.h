@@ -11,6 +11,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <mutex>
 
 #include "lmdb_wrapper.h"
 #include "Blockchain.h"
@@ -18,40 +19,68 @@
 
 #ifndef UNIT_TESTS
 #define SSH_BOUNDS_BATCH_SIZE 100000
+#define SSH_RECORD_QUEUE_SIZE 65536
+#define SSH_WRITE_BATCH_SIZE 250000
 #else
 #define SSH_BOUNDS_BATCH_SIZE 2
+#define SSH_RECORD_QUEUE_SIZE 4
+#define SSH_WRITE_BATCH_SIZE 8
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
-struct SshBatch
+struct SshRecord
 {
-   std::unique_ptr<std::promise<bool>> waitOnWriter_ = nullptr;
-   const unsigned shardId_;
-   std::map<BinaryData, BinaryWriter> serializedSsh_;
+   BinaryData key_;
 
-   SshBatch(unsigned shardId) :
-      shardId_(shardId)
+   //empty value means the ssh entry should be deleted
+   BinaryData value_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class SshRecordQueue
+{
+   /***
+   Bounded ring of serialized ssh records, one per parser thread. The parser
+   blocks when the ring is full, the writer blocks when it's empty. A parser 
+   grabs bounds in ascending order and each bound is emitted sorted, so the 
+   records in a queue are always sorted by key.
+   ***/
+
+private:
+   std::vector<SshRecord> ring_;
+   size_t head_ = 0;
+   size_t count_ = 0;
+   bool done_ = false;
+
+   std::mutex mu_;
+   std::condition_variable cv_;
+
+public:
+   SshRecordQueue(size_t capacity) :
+      ring_(capacity)
    {}
+
+   //parser side
+   void push(SshRecord&&);
+   void markDone(void);
+
+   //writer side, front returns nullptr once the queue is done and drained
+   const SshRecord* front(void);
+   SshRecord pop(void);
+
+   //true if front won't block
+   bool ready(void);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 struct SshBounds
 {
    std::pair<BinaryData, BinaryData> bounds_;
-   std::map<BinaryData, BinaryWriter> serializedSsh_;
    std::chrono::duration<double> time_;
    uint64_t count_ = 0;
 
-   std::unique_ptr<std::promise<bool>> completed_;
-   std::shared_future<bool> fut_;
-
-   SshBounds(void)
-   {
-      completed_ = std::make_unique<std::promise<bool>>();
-      fut_ = completed_->get_future();
-   }
-
-   void serializeResult(std::map<BinaryDataRef, StoredScriptHistory>&);
+   void serializeResult(
+      std::map<BinaryDataRef, StoredScriptHistory>&, SshRecordQueue&);
 };
 
 struct SshMapping
@@ -78,16 +107,17 @@ private:
    bool undo_ = false;
 
    std::vector<std::unique_ptr<SshBounds>> boundsVector_;
+   std::vector<std::unique_ptr<SshRecordQueue>> queues_;
 
-   std::atomic<unsigned> commitedBoundsCounter_;
    std::atomic<unsigned> fetchBoundsCounter_;
-   std::condition_variable writeThreadCV_;
-   std::mutex cvMutex_;
+   std::atomic<unsigned> completedBoundsCounter_;
+   std::atomic<bool> parserFailed_;
 
    std::atomic<unsigned> mapCount_;
    std::vector<SshMapping> mappingResults_;
 
 private:
+   void run(void);
    void putSSH(void);
    SshBounds* getNext();
    
@@ -95,7 +125,7 @@ private:
    void setupBounds();
    SshMapping mapSubSshDB();
    void mapSubSshDBThread(unsigned);
-   void parseSshThread(void);
+   void parseSshThread(unsigned);
 
 public:
    ShardedSshParser(
@@ -211,8 +211,19 @@ void DBBlock::createFromBlockHeader(const BlockHeader & bh)
    isMainBranch_ = bh.isMainBranch();
    hasBlockHeader_ = true;
 
-   fileID_ = bh.getBlockFileNum();
-   offset_ = bh.getOffset();
+   //Blocks ingested from memory have no blk file position yet. Their file
+   //id is transient, it would point at another block after a restart.
+   auto pos = bh.getBlockFilePos();
+   if (pos.fileNum_ >= UINT16_MAX)
+   {
+      fileID_ = UINT16_MAX;
+      offset_ = SIZE_MAX;
+   }
+   else
+   {
+      fileID_ = pos.fileNum_;
+      offset_ = pos.offset_;
+   }
 
    uniqueID_ = bh.getThisID();
 }
@@ -497,12 +508,25 @@ BlockHeader DBBlock::getBlockHeaderCopy(void) const
    bh.setBlockSize(numBytes_);
    bh.setDuplicateID(duplicateID_);
 
-   bh.setBlockFileNum(fileID_);
-   bh.setBlockFileOffset(offset_);
+   auto pos = getBlockFilePos();
+   bh.setBlockFilePos(pos.fileNum_, pos.offset_);
 
    return bh;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+BlockFilePos DBBlock::getBlockFilePos() const
+{
+   BlockFilePos pos;
+   if (fileID_ != UINT16_MAX)
+   {
+      pos.fileNum_ = fileID_;
+      pos.offset_ = offset_;
+   }
+
+   return pos;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 BinaryData DBBlock::getSerializedBlockHeader(void) const
 {
@@ -319,6 +319,9 @@ public:
    bool isInitialized(void) const {return dataCopy_.getSize() > 0;}
    bool isNull(void) const {return !isInitialized(); }
    BlockHeader getBlockHeaderCopy(void) const;
+
+   //no position for blocks that weren't on disk yet
+   BlockFilePos getBlockFilePos(void) const;
    BinaryData getSerializedBlockHeader(void) const;
    void createFromBlockHeader(const BlockHeader & bh);
 
@@ -376,6 +379,8 @@ public:
    
    bool hasBlockHeader_=false;
 
+   //UINT16_MAX for blocks that weren't in the blk files when this was
+   //written, see getBlockFilePos
    size_t offset_;
    uint16_t fileID_;
 
@@ -41,7 +41,7 @@ const set<DB_SELECT> LMDBBlockDatabase::supernodeDBs_({});
 const map<string, size_t> LMDBBlockDatabase::mapSizes_ = {
    {"headers", 50 * 1024 * 1024 * 1024ULL},
    {"blkdata", 50 * 1024 * 1024ULL},
-   {"history", 50 * 1024 * 1024ULL},
+   {"history", 4 * 1024 * 1024 * 1024ULL},
    {"txhints", 50 * 1024 * 1024 * 1024ULL},
    {"ssh",   2000 * 1024 * 1024 * 1024ULL},
    {"subssh", 2000 * 1024 * 1024 * 1024ULL},
@@ -814,6 +814,15 @@ void LMDBBlockDatabase::putValue(DB_SELECT db,
    putValue(db, bw.getDataRef(), value);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::appendValue(DB_SELECT db,
+                                    BinaryDataRef key,
+                                    BinaryDataRef value)
+{
+   auto dbPtr = getDbPtr(db);
+   dbPtr->appendValue(key, value);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Delete value based on BinaryData key.  If batch writing, pass in the batch
 void LMDBBlockDatabase::deleteValue(DB_SELECT db, 
@@ -847,48 +856,122 @@ bool LMDBBlockDatabase::fillStoredSubHistory(
    {
       auto subsshtx = beginTransaction(SUBSSH, LMDB::ReadOnly);
       auto subsshIter = getIterator(SUBSSH);
+      return readSubHistory(subsshIter.get(), ssh, start, end);
+   }     
+}
 
-      BinaryWriter dbkey_withHgtX;
-      dbkey_withHgtX.put_uint8_t(DB_PREFIX_SCRIPT);
-      dbkey_withHgtX.put_BinaryData(ssh.uniqueKey_);
+////////////////////////////////////////////////////////////////////////////////
+bool LMDBBlockDatabase::readSubHistory(LDBIter* subsshIter,
+   StoredScriptHistory& ssh, unsigned start, unsigned end) const
+{
+   BinaryWriter dbkey_withHgtX;
+   dbkey_withHgtX.put_uint8_t(DB_PREFIX_SCRIPT);
+   dbkey_withHgtX.put_BinaryData(ssh.uniqueKey_);
 
-      if (start != 0)
-      {
-         dbkey_withHgtX.put_BinaryData(DBUtils::heightAndDupToHgtx(start, 0));
-      }
+   if (start != 0)
+   {
+      dbkey_withHgtX.put_BinaryData(DBUtils::heightAndDupToHgtx(start, 0));
+   }
 
-      if (!subsshIter->seekTo(dbkey_withHgtX.getDataRef()))
-         return false;
-      // Now start iterating over the sub histories
-      map<BinaryData, StoredSubHistory>::iterator iter;
-      size_t numTxioRead = 0;
-      do
-      {
-         size_t _sz = subsshIter->getKeyRef().getSize();
-         BinaryDataRef keyNoPrefix = subsshIter->getKeyRef().getSliceRef(1, _sz - 1);
-         if (!keyNoPrefix.startsWith(ssh.uniqueKey_))
-            break;
+   if (!subsshIter->seekTo(dbkey_withHgtX.getDataRef()))
+      return false;
+   // Now start iterating over the sub histories
+   do
+   {
+      size_t _sz = subsshIter->getKeyRef().getSize();
+      BinaryDataRef keyNoPrefix = subsshIter->getKeyRef().getSliceRef(1, _sz - 1);
+      if (!keyNoPrefix.startsWith(ssh.uniqueKey_))
+         break;
+
+      pair<BinaryData, StoredSubHistory> keyValPair;
+      keyValPair.first = keyNoPrefix.getSliceCopy(_sz - 5, 4);
+      keyValPair.second.unserializeDBKey(subsshIter->getKeyRef());
 
-         pair<BinaryData, StoredSubHistory> keyValPair;
-         keyValPair.first = keyNoPrefix.getSliceCopy(_sz - 5, 4);
-         keyValPair.second.unserializeDBKey(subsshIter->getKeyRef());
+      //iter is at the right ssh, make sure hgtX <= endBlock
+      if (keyValPair.second.height_ > end)
+         break;
+
+      //skip invalid dupIDs
+      if (keyValPair.second.dupID_ !=
+         getValidDupIDForHeight(keyValPair.second.height_))
+         continue;
+
+      keyValPair.second.unserializeDBValue(subsshIter->getValueReader());
+      ssh.subHistMap_.insert(keyValPair);
+   } while (subsshIter->advanceAndRead(DB_PREFIX_SCRIPT));
+
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+map<BinaryDataRef, StoredScriptHistory> 
+LMDBBlockDatabase::getStoredScriptHistoryBatch(
+   set<BinaryDataRef>::const_iterator begin,
+   set<BinaryDataRef>::const_iterator end,
+   uint32_t startBlock, size_t maxTxioCount) const
+{
+   /*
+   The set is sorted, so the summary and sub history cursors only ever move 
+   forward and hit neighbouring pages, instead of opening a transaction and 
+   cursor pair per address.
+   */
+
+   map<BinaryDataRef, StoredScriptHistory> result;
+   size_t txioCount = 0;
 
-         //iter is at the right ssh, make sure hgtX <= endBlock
-         if (keyValPair.second.height_ > end)
+   auto addSsh = [&result, &txioCount](
+      BinaryDataRef scrAddr, StoredScriptHistory& ssh)->void
+   {
+      for (auto& subssh : ssh.subHistMap_)
+         txioCount += subssh.second.txioMap_.size();
+      result.emplace(scrAddr, move(ssh));
+   };
+
+   if (getDbType() == ARMORY_DB_SUPER)
+   {
+      //sub histories are sharded by batch id, no sweep to be had here
+      for (auto iter = begin; iter != end; ++iter)
+      {
+         if (txioCount >= maxTxioCount)
             break;
 
-         //skip invalid dupIDs
-         if (keyValPair.second.dupID_ !=
-            getValidDupIDForHeight(keyValPair.second.height_))
+         StoredScriptHistory ssh;
+         if (!getStoredScriptHistorySummary(ssh, *iter))
             continue;
 
-         keyValPair.second.unserializeDBValue(subsshIter->getValueReader());
-         iter = ssh.subHistMap_.insert(keyValPair).first;
-         numTxioRead += iter->second.txioMap_.size();
-      } while (subsshIter->advanceAndRead(DB_PREFIX_SCRIPT));
+         if (!fillStoredSubHistory_Super(ssh, startBlock, UINT32_MAX))
+            continue;
 
-      return true;
-   }     
+         addSsh(*iter, ssh);
+      }
+
+      return result;
+   }
+
+   auto sshTx = beginTransaction(SSH, LMDB::ReadOnly);
+   auto subsshTx = beginTransaction(SUBSSH, LMDB::ReadOnly);
+   auto sshIter = getIterator(SSH);
+   auto subsshIter = getIterator(SUBSSH);
+
+   for (auto iter = begin; iter != end; ++iter)
+   {
+      if (txioCount >= maxTxioCount)
+         break;
+
+      if (!sshIter->seekToExact(DB_PREFIX_SCRIPT, *iter))
+         continue;
+
+      StoredScriptHistory ssh;
+      ssh.unserializeDBKey(sshIter->getKeyRef());
+      ssh.unserializeDBValue(sshIter->getValueRef());
+
+      if (!readSubHistory(subsshIter.get(), ssh, startBlock, UINT32_MAX))
+         continue;
+
+      addSsh(*iter, ssh);
+   }
+
+   return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1252,8 +1335,8 @@ void LMDBBlockDatabase::readAllHeaders(
       regHead->setBlockSize(sbh.numBytes_);
       regHead->setNumTx(sbh.numTx_);
 
-      regHead->setBlockFileNum(sbh.fileID_);
-      regHead->setBlockFileOffset(sbh.offset_);
+      auto pos = sbh.getBlockFilePos();
+      regHead->setBlockFilePos(pos.fileNum_, pos.offset_);
       regHead->setUniqueID(sbh.uniqueID_);
 
       if (sbh.thisHash_ != regHead->getThisHash())
@@ -1734,14 +1817,15 @@ Tx LMDBBlockDatabase::getFullTxCopy(
    //open block file
    BlockDataLoader bdl(blkFolder_);
 
-   auto fileMapPtr = bdl.get(bhPtr->getBlockFileNum());
+   uint64_t offset;
+   auto fileMapPtr = bdl.getForHeader(*bhPtr, offset);
    auto dataPtr = fileMapPtr->getPtr();
 
    auto getID = [bhPtr]
       (const BinaryData&)->uint32_t {return bhPtr->getThisID(); };
 
    auto block = BlockData::deserialize(
-      dataPtr + bhPtr->getOffset(),
+      dataPtr + offset,
       bhPtr->getBlockSize(), bhPtr, getID,
       BlockData::CheckHashes::NoChecks);
 
@@ -1960,9 +2044,10 @@ bool LMDBBlockDatabase::getStoredHeader(
       //open block file
       BlockDataLoader bdl(blkFolder_);
 
-      auto fileMapPtr = bdl.get(bh->getBlockFileNum());
+      uint64_t offset;
+      auto fileMapPtr = bdl.getForHeader(*bh, offset);
       auto dataPtr = fileMapPtr->getPtr();
-      BinaryRefReader brr(dataPtr + bh->getOffset(), bh->getBlockSize());
+      BinaryRefReader brr(dataPtr + offset, bh->getBlockSize());
 
       if (withTx)
          sbh.unserializeFullBlock(brr, false, false);
@@ -1996,9 +2081,10 @@ BinaryData LMDBBlockDatabase::getRawBlock(shared_ptr<BlockHeader> bh) const
    //open block file
    BlockDataLoader bdl(blkFolder_);
 
-   auto fileMapPtr = bdl.get(bh->getBlockFileNum());
+   uint64_t offset;
+   auto fileMapPtr = bdl.getForHeader(*bh, offset);
    auto dataPtr = fileMapPtr->getPtr();
-   return BinaryData(dataPtr + bh->getOffset(), bh->getBlockSize());
+   return BinaryData(dataPtr + offset, bh->getBlockSize());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2929,6 +3015,58 @@ void LMDBBlockDatabase::putFilterPoolForFileNum(
    putValue(TXFILTERS, key, data);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BinaryDataRef LMDBBlockDatabase::getBlockFilterRef(
+   uint32_t blockId, BinaryDataRef blockHash) const
+{
+   /*
+   Block ids are assigned as headers are loaded, an id can end up on 
+   another block than the one the filter was built for. Filters carry 
+   the hash of their block, a mismatch reads as a missing filter.
+   */
+
+   auto key = DBUtils::getBlockFilterKey(blockId);
+   auto val = getValueNoCopy(TXFILTERS, key.getRef());
+   if (val.getSize() <= 32 || val.getSliceRef(0, 32) != blockHash)
+      return BinaryDataRef();
+
+   return val.getSliceRef(32, val.getSize() - 32);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::putBlockFilters(
+   const map<uint32_t, pair<BinaryData, BinaryData>>& filters)
+{
+   if (filters.empty())
+      return;
+
+   //keys are big endian block ids, the map walks them in db order
+   vector<pair<BinaryData, BinaryWriter>> serializedFilters;
+   serializedFilters.reserve(filters.size());
+   for (auto& filterPair : filters)
+   {
+      if (filterPair.second.first.getSize() != 32)
+         throw runtime_error("invalid block hash for filter");
+
+      serializedFilters.emplace_back(
+         DBUtils::getBlockFilterKey(filterPair.first), BinaryWriter());
+      auto& bw = serializedFilters.back().second;
+      bw.put_BinaryData(filterPair.second.first);
+      bw.put_BinaryData(filterPair.second.second);
+   }
+
+   auto tx = beginTransaction(TXFILTERS, LMDB::ReadWrite);
+   auto&& bulkWriter = getBulkWriter(TXFILTERS);
+   for (auto& filterPair : serializedFilters)
+   {
+      bulkWriter.putValue(
+         filterPair.first.getRef(),
+         filterPair.second.getDataRef());
+   }
+
+   bulkWriter.commit();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 void LMDBBlockDatabase::putMissingHashes(
    const set<BinaryData>& hashSet, uint32_t id)
@@ -3154,6 +3292,14 @@ void DBPair::putValue(BinaryDataRef key,BinaryDataRef value)
       CharacterArrayRef(value.getSize(), value.getPtr()));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void DBPair::appendValue(BinaryDataRef key, BinaryDataRef value)
+{
+   db_.append(
+      CharacterArrayRef(key.getSize(), key.getPtr()),
+      CharacterArrayRef(value.getSize(), value.getPtr()));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void DBPair::deleteValue(BinaryDataRef key)
 {
@@ -3260,6 +3406,14 @@ void DatabaseContainer_Single::putValue(
    db_.putValue(key, value);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void DatabaseContainer_Single::appendValue(
+   BinaryDataRef key,
+   BinaryDataRef value)
+{
+   db_.appendValue(key, value);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void DatabaseContainer_Single::deleteValue(BinaryDataRef key)
 {
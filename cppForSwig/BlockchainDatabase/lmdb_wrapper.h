@@ -233,16 +233,47 @@ public:
 
    BinaryDataRef getValue(BinaryDataRef keyWithPrefix) const;
    void putValue(BinaryDataRef key, BinaryDataRef value);
+   void appendValue(BinaryDataRef key, BinaryDataRef value);
    void deleteValue(BinaryDataRef key);
    
    std::unique_ptr<LDBIter_Single> getIterator(void);
+   LMDB::BulkLoader getBulkLoader(void) { return db_.bulkLoader(); }
    unsigned getId(void) const { return id_; }
 
    bool isOpen(void) const;
+   size_t getUsedSize(void) const { return env_.getUsedSize(); }
 
    LMDBEnv* getEnv(void) { return &env_; }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class DbBulkWriter
+{
+   /***
+   Collects writes to a single db and commits them sorted, appending what 
+   sorts past the end of the db. Keys and values are not copied, they have 
+   to outlive commit(). Requires a ReadWrite transaction on the db.
+   ***/
+
+private:
+   LMDB::BulkLoader loader_;
+
+public:
+   DbBulkWriter(LMDB::BulkLoader&& loader) :
+      loader_(std::move(loader))
+   {}
+
+   void putValue(BinaryDataRef key, BinaryDataRef value)
+   {
+      loader_.add(
+         CharacterArrayRef(key.getSize(), key.getPtr()),
+         CharacterArrayRef(value.getSize(), value.getPtr()));
+   }
+
+   size_t size(void) const { return loader_.size(); }
+   LMDB::BulkLoader::Stats commit(void) { return loader_.commit(); }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class DbTransaction
@@ -252,6 +283,9 @@ public:
    {}
 
    virtual ~DbTransaction(void) = 0;
+
+   //drop the writes, the destructor commits otherwise
+   virtual void rollback(void) = 0;
 };
 
 ////////
@@ -264,6 +298,8 @@ public:
    DbTransaction_Single(LMDBEnv::Transaction&& dbtx) :
       dbtx_(std::move(dbtx))
    {}
+
+   void rollback(void) { dbtx_.rollback(); }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -300,7 +336,10 @@ public:
    
    virtual BinaryDataRef getValue(BinaryDataRef keyWithPrefix) const = 0;
    virtual void putValue(BinaryDataRef key, BinaryDataRef value) = 0;
+   virtual void appendValue(BinaryDataRef key, BinaryDataRef value) = 0;
    virtual void deleteValue(BinaryDataRef key) = 0;
+   virtual LMDB::BulkLoader getBulkLoader(void) = 0;
+   virtual size_t getUsedSize(void) const = 0;
 
    virtual StoredDBInfo getStoredDBInfo(uint32_t id) = 0;
    virtual void putStoredDBInfo(StoredDBInfo const & sdbi, uint32_t id) = 0;
@@ -332,7 +371,10 @@ public:
 
    BinaryDataRef getValue(BinaryDataRef key) const;
    void putValue(BinaryDataRef key, BinaryDataRef value);
+   void appendValue(BinaryDataRef key, BinaryDataRef value);
    void deleteValue(BinaryDataRef key);
+   LMDB::BulkLoader getBulkLoader(void) { return db_.getBulkLoader(); }
+   size_t getUsedSize(void) const { return db_.getUsedSize(); }
 
    StoredDBInfo getStoredDBInfo(uint32_t id);
    void putStoredDBInfo(StoredDBInfo const & sdbi, uint32_t id);
@@ -504,6 +546,24 @@ public:
    void putValue(DB_SELECT db, BinaryData const & key, BinaryData const & value);
    void putValue(DB_SELECT db, DB_PREFIX pref, BinaryDataRef key, BinaryDataRef value);
 
+   /////////////////////////////////////////////////////////////////////////////
+   // Append to the end of the db, key has to sort after the current last key
+   void appendValue(DB_SELECT db, BinaryDataRef key, BinaryDataRef value);
+
+   /////////////////////////////////////////////////////////////////////////////
+   // Sorted batch writes, see DbBulkWriter
+   DbBulkWriter getBulkWriter(DB_SELECT db) const
+   {
+      auto dbObj = getDbPtr(db);
+      return DbBulkWriter(dbObj->getBulkLoader());
+   }
+
+   size_t getDbUsedSize(DB_SELECT db) const
+   {
+      auto dbObj = getDbPtr(db);
+      return dbObj->getUsedSize();
+   }
+
    /////////////////////////////////////////////////////////////////////////////
    // Put value based on BinaryData key.  If batch writing, pass in the batch
    void deleteValue(DB_SELECT db, BinaryDataRef key);
@@ -619,6 +679,13 @@ public:
       uint32_t startBlock = 0,
       uint32_t endBlock = UINT32_MAX) const;
 
+   //sorted sweep over a range of scrAddr in a single read transaction, 
+   //stops past the address that exceeds maxTxioCount. Does not set UTXO flags
+   std::map<BinaryDataRef, StoredScriptHistory> getStoredScriptHistoryBatch(
+      std::set<BinaryDataRef>::const_iterator begin,
+      std::set<BinaryDataRef>::const_iterator end,
+      uint32_t startBlock = 0, size_t maxTxioCount = SIZE_MAX) const;
+
    bool getStoredSubHistoryAtHgtX(StoredSubHistory& subssh,
       const BinaryDataRef scrAddrStr, const BinaryData& hgtX) const;
    
@@ -705,6 +772,14 @@ public:
    void putMissingHashes(const std::set<BinaryData>&, uint32_t);
    std::set<BinaryData> getMissingHashes(uint32_t) const;
 
+   //per block GCS filters, keyed by block id and stored along with the 
+   //block hash. get requires an open TXFILTERS transaction, returns an 
+   //empty ref for missing filters or if the stored hash doesn't match.
+   //put takes block id: (block hash, filter)
+   BinaryDataRef getBlockFilterRef(uint32_t, BinaryDataRef) const;
+   void putBlockFilters(
+      const std::map<uint32_t, std::pair<BinaryData, BinaryData>>&);
+
    ////
    void updateHeightToIdMap(std::map<unsigned, unsigned>& idmap)
    {
@@ -714,6 +789,8 @@ public:
    void loadHeightToIdMap();
    unsigned getShardIdForHeight(unsigned) const;
    unsigned getNextShardIdForHeight(unsigned) const;
+   bool readSubHistory(LDBIter*, StoredScriptHistory&, 
+      unsigned, unsigned) const;
 
 public:
    std::map<DB_SELECT, std::shared_ptr<DatabaseContainer>> dbMap_;
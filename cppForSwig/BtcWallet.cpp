@@ -37,6 +37,14 @@ bool BtcWallet::hasScrAddress(const BinaryDataRef& scrAddr) const
    return (addrMap->find(scrAddr) != addrMap->end());
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BtcWallet::BtcWallet(BlockDataViewer* bdv, const string ID) :
+   bdvPtr_(bdv), walletID_(ID),
+   ledgerCache_(
+      bdv != nullptr ? bdv->getDB() : nullptr, 
+      bdv != nullptr ? &bdv->blockchain() : nullptr)
+{}
+
 /////////////////////////////////////////////////////////////////////////////
 set<BinaryDataRef> BtcWallet::getAddrSet() const
 {
@@ -272,14 +280,21 @@ vector<UTXO> BtcWallet::getSpendableTxOutListForValue(uint64_t val)
    prepareTxOutHistory(val);
    LMDBBlockDatabase *db = bdvPtr_->getDB();
 
-   //start a RO txn to grab the txouts from DB
-   auto&& tx = db->beginTransaction(STXO, LMDB::ReadOnly);
-
    vector<UTXO> utxoList;
    uint32_t blk = bdvPtr_->getTopBlockHeight();
 
    auto addrMap = scrAddrMap_.get();
 
+   /***
+   Collect the spendable txios across all addresses first, then pull the 
+   txouts and tx hashes in key order, one read txn each, rather than 
+   interleaving STXO and TXHINTS seeks per txio.
+   ***/
+
+   vector<BinaryData> txoutKeys;
+   map<BinaryData, StoredTxOut> stxoMap;
+   map<BinaryData, BinaryData> hashMap;
+
    for (const auto& scrAddr : *addrMap)
    {
       const auto& txioMap = scrAddr.second->getPreparedTxOutList();
@@ -290,18 +305,40 @@ vector<UTXO> BtcWallet::getSpendableTxOutListForValue(uint64_t val)
             continue;
 
          auto&& txout_key = txioPair.second.getDBKeyOfOutput();
-         StoredTxOut stxo;
-         db->getStoredTxOut(stxo, txout_key);
-         auto hash = db->getTxHashForLdbKey(txout_key.getSliceRef(0, 6));
-
-         UTXO utxo(
-            stxo.getValue(), stxo.getHeight(), 
-            stxo.txIndex_, stxo.txOutIndex_, 
-            hash, stxo.getScriptRef());
-         utxoList.emplace_back(move(utxo));
+         stxoMap.emplace(txout_key, StoredTxOut());
+         hashMap.emplace(txout_key.getSliceCopy(0, 6), BinaryData());
+         txoutKeys.emplace_back(move(txout_key));
       }
    }
 
+   {
+      auto&& tx = db->beginTransaction(STXO, LMDB::ReadOnly);
+      for (auto& stxoPair : stxoMap)
+         db->getStoredTxOut(stxoPair.second, stxoPair.first);
+   }
+
+   {
+      unique_ptr<DbTransaction> hintsTx;
+      if (db->getDbType() != ARMORY_DB_SUPER)
+         hintsTx = db->beginTransaction(TXHINTS, LMDB::ReadOnly);
+
+      for (auto& hashPair : hashMap)
+         hashPair.second = db->getTxHashForLdbKey(hashPair.first);
+   }
+
+   utxoList.reserve(txoutKeys.size());
+   for (auto& txout_key : txoutKeys)
+   {
+      auto& stxo = stxoMap[txout_key];
+      auto& hash = hashMap[txout_key.getSliceRef(0, 6)];
+
+      UTXO utxo(
+         stxo.getValue(), stxo.getHeight(), 
+         stxo.txIndex_, stxo.txOutIndex_, 
+         hash, stxo.getScriptRef());
+      utxoList.emplace_back(move(utxo));
+   }
+
    //Shipped a list of TxOuts, time to reset the entire TxOut history, since 
    //we dont know if any TxOut will be spent
 
@@ -492,6 +529,12 @@ bool BtcWallet::scanWallet(ScanWalletStruct& scanInfo, int32_t updateID)
       auto&& tx = bdvPtr_->getDB()->beginTransaction(SSH, LMDB::ReadOnly);
       balance_ = getFullBalanceFromDB(updateID);
    }
+
+   if (scanInfo.reorg_ && scanInfo.branchPoint_ != UINT32_MAX)
+      ledgerCache_.truncate(walletID_, scanInfo.branchPoint_ + 1);
+
+   if (scanInfo.action_ == BDV_Init || scanInfo.action_ == BDV_NewBlock)
+      ledgerCache_.setTop(scanInfo.endBlock_);
   
    if (scanInfo.saStruct_.scrAddrToTxioKeys_.size() != 0 ||
       (scanInfo.saStruct_.invalidatedZcKeys_ != nullptr && 
@@ -709,6 +752,21 @@ map<BinaryData, LedgerEntry> BtcWallet::updateWalletLedgersFromTxio(
       walletID_, bdvPtr_->getDB(), &bdvPtr_->blockchain(), bdvPtr_->zcContainer());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+map<BinaryData, LedgerEntry> BtcWallet::getLedgersForRange(
+   uint32_t start, uint32_t end)
+{
+   auto computeLedgers = [this](uint32_t rangeStart, uint32_t rangeEnd)->
+      map<BinaryData, LedgerEntry>
+   {
+      auto&& txioMap = this->getTxioForRange(rangeStart, rangeEnd);
+      return this->updateWalletLedgersFromTxio(txioMap, rangeStart, rangeEnd);
+   };
+
+   return ledgerCache_.getLedgers(
+      walletID_, scrAddrMap_.get(), start, end, computeLedgers);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 const ScrAddrObj* BtcWallet::getScrAddrObjByKey(const BinaryData& key) const
 {
@@ -752,14 +810,15 @@ shared_ptr<const map<BinaryData, LedgerEntry>> BtcWallet::getHistoryPage(
    if (pageId >= getHistoryPageCount())
       throw std::range_error("pageID is out of range");
 
+   //ledgers come out of the ledger cache, which pulls txios on its own
    auto getTxio = 
-      [this](uint32_t start, uint32_t end)->map<BinaryData, TxIOPair>
-   { return this->getTxioForRange(start, end); };
+      [](uint32_t, uint32_t)->map<BinaryData, TxIOPair>
+   { return map<BinaryData, TxIOPair>(); };
 
    auto computeLedgers = [this](
-      const map<BinaryData, TxIOPair>& txioMap, uint32_t start, uint32_t end)->
+      const map<BinaryData, TxIOPair>&, uint32_t start, uint32_t end)->
       map<BinaryData, LedgerEntry>
-   { return this->updateWalletLedgersFromTxio(txioMap, start, end); };
+   { return this->getLedgersForRange(start, end); };
 
    return histPages_.getPageLedgerMap(getTxio, computeLedgers, pageId, updateID_);
 }
@@ -779,6 +838,21 @@ vector<LedgerEntry> BtcWallet::getHistoryPageAsVector(uint32_t pageId)
    return ledgerVec;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+vector<LedgerEntry> BtcWallet::getHistoryFromCursor(
+   BinaryData& token, unsigned count)
+{
+   if (!bdvPtr_->isBDMRunning())
+      return vector<LedgerEntry>();
+
+   auto getLedgers = [this](uint32_t start, uint32_t end)->
+      map<BinaryData, LedgerEntry>
+   { return this->getLedgersForRange(start, end); };
+
+   return HistoryPager::getPageFromCursor(token, count,
+      histPages_.getSSHsummary(), &bdvPtr_->blockchain(), getLedgers);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BtcWallet::needsRefresh(bool refresh)
 { 
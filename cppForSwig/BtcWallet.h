@@ -20,6 +20,7 @@
 #include "bdmenums.h"
 #include "ThreadSafeClasses.h"
 #include "TxClasses.h"
+#include "LedgerCache.h"
 
 class BlockDataManager;
 class BlockDataViewer;
@@ -32,6 +33,7 @@ struct ScanWalletStruct
    unsigned startBlock_;
    unsigned endBlock_ = UINT32_MAX;
    bool reorg_ = false;
+   unsigned branchPoint_ = UINT32_MAX;
 
    ScanAddressStruct saStruct_;
 };
@@ -49,9 +51,7 @@ class BtcWallet
    static const uint32_t MIN_UTXO_PER_TXN = 100;
 
 public:
-   BtcWallet(BlockDataViewer* bdv, const std::string ID)
-      : bdvPtr_(bdv), walletID_(ID)
-   {}
+   BtcWallet(BlockDataViewer* bdv, const std::string ID);
 
    ~BtcWallet(void)
    {}
@@ -100,6 +100,7 @@ public:
 
    std::shared_ptr<const std::map<BinaryData, LedgerEntry>> getHistoryPage(uint32_t);
    std::vector<LedgerEntry> getHistoryPageAsVector(uint32_t);
+   std::vector<LedgerEntry> getHistoryFromCursor(BinaryData& token, unsigned);
    size_t getHistoryPageCount(void) const { return histPages_.getPageCount(); }
 
    void needsRefresh(bool refresh);
@@ -144,6 +145,7 @@ private:
    { return histPages_.getSSHsummary(); }
 
    std::map<BinaryData, TxIOPair> getTxioForRange(uint32_t, uint32_t) const;
+   std::map<BinaryData, LedgerEntry> getLedgersForRange(uint32_t, uint32_t);
    void unregister(void) { isRegistered_ = false; }
    void resetTxOutHistory(void);
    void resetCounters(void);
@@ -163,6 +165,9 @@ private:
    //wallet id
    std::string walletID_;
 
+   //persisted ledgers, feeds the history pages
+   LedgerCache ledgerCache_;
+
    uint64_t                      balance_ = 0;
 
    //set to true to add wallet paged history to global ledgers 
@@ -252,6 +252,9 @@ bool RemoteCallback::processNotifications(
             if (newblock.has_branch_height())
                bdmNotif.branchHeight_ = newblock.branch_height();
 
+            if (newBlockLambda_)
+               newBlockLambda_(bdmNotif.height_, bdmNotif.branchHeight_);
+
             run(move(bdmNotif));
          }
 
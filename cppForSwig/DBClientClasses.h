@@ -243,6 +243,10 @@ struct BdmNotification
 ///////////////////////////////////////////////////////////////////////////////
 class RemoteCallback
 {
+private:
+   //(new top, branch point), branch point is UINT32_MAX if there was no reorg
+   std::function<void(unsigned, unsigned)> newBlockLambda_;
+
 public:
    RemoteCallback(void) {}
    virtual ~RemoteCallback(void) = 0;
@@ -257,6 +261,12 @@ public:
    virtual void disconnected(void) = 0;
 
    bool processNotifications(std::shared_ptr<::Codec_BDVCommand::BDVCallback>);
+
+   //runs ahead of run() for new block notifications, set before connecting
+   void setNewBlockLambda(std::function<void(unsigned, unsigned)> lbd)
+   {
+      newBlockLambda_ = lbd;
+   }
 };
 
 #endif
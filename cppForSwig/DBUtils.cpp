@@ -288,6 +288,15 @@ BinaryData DBUtils::getFilterPoolKey(uint32_t filenum)
    return WRITE_UINT32_BE(bucketKey);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BinaryData DBUtils::getBlockFilterKey(uint32_t blockId)
+{
+   BinaryWriter bw(5);
+   bw.put_uint8_t(DB_PREFIX_BLOCKFILTER);
+   bw.put_uint32_t(blockId, BE);
+   return bw.getData();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 BinaryData DBUtils::getMissingHashesKey(uint32_t id)
 {
@@ -40,7 +40,11 @@ enum DB_PREFIX
    DB_PREFIX_POOL,
    DB_PREFIX_MISSING_HASHES,
    DB_PREFIX_SUBSSH,
-   DB_PREFIX_TEMPSCRIPT
+   DB_PREFIX_TEMPSCRIPT,
+   DB_PREFIX_BLOCKFILTER,
+   DB_PREFIX_LEDGER,
+   DB_PREFIX_LEDGERMETA,
+   DB_PREFIX_LEDGERADDRS
 };
 
 struct FileMap
@@ -146,6 +150,7 @@ public:
 
    static BinaryData getFilterPoolKey(uint32_t filenum);
    static BinaryData getMissingHashesKey(uint32_t id);
+   static BinaryData getBlockFilterKey(uint32_t blockId);
 
    static bool fileExists(const std::string& path, int mode);
 
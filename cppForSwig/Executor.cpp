@@ -0,0 +1,332 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <sstream>
+#include <iomanip>
+
+#include "Executor.h"
+#include "log.h"
+
+using namespace std;
+using namespace Armory::Threading;
+
+namespace
+{
+   //pool and worker index of the calling thread
+   thread_local const Executor* currentPool_ = nullptr;
+   thread_local int currentWorkerId_ = -1;
+
+   const char* workloadName(ExecutorWorkload workload)
+   {
+      switch (workload)
+      {
+      case ExecutorWorkload_Scan:
+         return "scan";
+
+      case ExecutorWorkload_ZeroConf:
+         return "zc";
+
+      case ExecutorWorkload_Clients:
+         return "clients";
+
+      case ExecutorWorkload_Maintenance:
+         return "maintenance";
+
+      default:
+         return "unknown";
+      }
+   }
+
+   uint64_t nanosecondsSince(const chrono::steady_clock::time_point& start)
+   {
+      return chrono::duration_cast<chrono::nanoseconds>(
+         chrono::steady_clock::now() - start).count();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Executor::Executor(unsigned threadCount) :
+   start_(chrono::steady_clock::now())
+{
+   pending_.store(0, memory_order_relaxed);
+   nextWorker_.store(0, memory_order_relaxed);
+   run_.store(true, memory_order_relaxed);
+
+   threadCount = max(threadCount, 1U);
+   for (unsigned i = 0; i < threadCount; i++)
+      workers_.emplace_back(make_unique<Worker>());
+
+   //all deques have to exist before the first worker goes looking for work
+   for (unsigned i = 0; i < threadCount; i++)
+      workers_[i]->thread_ = thread(&Executor::workerLoop, this, i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Executor::~Executor()
+{
+   {
+      unique_lock<mutex> lock(sleepMutex_);
+      run_.store(false, memory_order_release);
+   }
+   sleepCondVar_.notify_all();
+
+   for (auto& worker : workers_)
+   {
+      if (worker->thread_.joinable())
+         worker->thread_.join();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int Executor::currentWorker() const
+{
+   if (currentPool_ != this)
+      return -1;
+
+   return currentWorkerId_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Executor::post(ExecutorWorkload workload, TaskPriority priority,
+   function<void(void)> func)
+{
+   if (workload >= ExecutorWorkload_Count)
+      throw runtime_error("invalid executor workload");
+   if (priority >= TaskPriority_Count)
+      throw runtime_error("invalid task priority");
+
+   Task task;
+   task.func_ = move(func);
+   task.workload_ = workload;
+   task.queued_ = chrono::steady_clock::now();
+
+   //workers keep what they spawn, the rest is spread over the pool
+   auto workerId = currentWorker();
+   if (workerId == -1)
+      workerId = nextWorker_.fetch_add(1, memory_order_relaxed) % workers_.size();
+
+   {
+      auto& worker = *workers_[workerId];
+      unique_lock<mutex> lock(worker.mu_);
+      worker.queues_[priority].emplace_back(move(task));
+   }
+
+   {
+      //sleepers check pending_ under this lock
+      unique_lock<mutex> lock(sleepMutex_);
+      pending_.fetch_add(1, memory_order_release);
+   }
+   sleepCondVar_.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Executor::popFromWorker(
+   Worker& worker, TaskPriority priority, bool owner, Task& task)
+{
+   unique_lock<mutex> lock(worker.mu_);
+   auto& queue = worker.queues_[priority];
+   if (queue.empty())
+      return false;
+
+   //the owner takes its latest background task, its data is most likely
+   //still in cache. Everything else goes in order
+   if (owner && priority != TaskPriority_Interactive)
+   {
+      task = move(queue.back());
+      queue.pop_back();
+   }
+   else
+   {
+      task = move(queue.front());
+      queue.pop_front();
+   }
+
+   pending_.fetch_sub(1, memory_order_relaxed);
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Executor::popTask(unsigned workerId, Task& task)
+{
+   if (pending_.load(memory_order_acquire) == 0)
+      return false;
+
+   for (unsigned prio = 0; prio < TaskPriority_Count; prio++)
+   {
+      auto priority = (TaskPriority)prio;
+      if (popFromWorker(*workers_[workerId], priority, true, task))
+         return true;
+
+      for (unsigned i = 1; i < workers_.size(); i++)
+      {
+         auto victim = (workerId + i) % workers_.size();
+         if (popFromWorker(*workers_[victim], priority, false, task))
+            return true;
+      }
+   }
+
+   return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Executor::runTask(Task& task)
+{
+   auto& counters = counters_[task.workload_];
+   counters.queuedNs_.fetch_add(
+      nanosecondsSince(task.queued_), memory_order_relaxed);
+
+   auto start = chrono::steady_clock::now();
+   try
+   {
+      task.func_();
+   }
+   catch (exception& e)
+   {
+      logTaskError(e.what());
+   }
+   catch (...)
+   {
+      logTaskError("unknown exception");
+   }
+
+   counters.busyNs_.fetch_add(nanosecondsSince(start), memory_order_relaxed);
+   counters.tasks_.fetch_add(1, memory_order_relaxed);
+
+   //release the closure's captures on this thread
+   task.func_ = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Executor::workerLoop(unsigned workerId)
+{
+   currentPool_ = this;
+   currentWorkerId_ = workerId;
+
+   while (true)
+   {
+      Task task;
+      if (popTask(workerId, task))
+      {
+         runTask(task);
+         continue;
+      }
+
+      unique_lock<mutex> lock(sleepMutex_);
+      if (!run_.load(memory_order_acquire))
+         break;
+
+      //a task may be posted between the failed pop and here, the timeout
+      //covers a steal racing with the owner's pop
+      sleepCondVar_.wait_for(lock, chrono::milliseconds(100), [this](void)->bool
+      {
+         return pending_.load(memory_order_acquire) > 0 ||
+            !run_.load(memory_order_acquire);
+      });
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Executor::parallel(ExecutorWorkload workload, TaskPriority priority,
+   unsigned count, const function<void(unsigned)>& func)
+{
+   if (count == 0)
+      return;
+
+   vector<future<void>> futures;
+   for (unsigned i = 1; i < count; i++)
+   {
+      futures.emplace_back(submit(workload, priority,
+         [&func, i](void)->void { func(i); }));
+   }
+
+   exception_ptr eptr = nullptr;
+   try
+   {
+      func(0);
+   }
+   catch (...)
+   {
+      eptr = current_exception();
+   }
+
+   //func is captured by reference, every task has to be done before
+   //this returns, failed or not
+   for (auto& fut : futures)
+   {
+      wait(fut);
+      try
+      {
+         fut.get();
+      }
+      catch (...)
+      {
+         if (eptr == nullptr)
+            eptr = current_exception();
+      }
+   }
+
+   if (eptr != nullptr)
+      rethrow_exception(eptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ExecutorStats Executor::getStats(ExecutorWorkload workload) const
+{
+   if (workload >= ExecutorWorkload_Count)
+      throw runtime_error("invalid executor workload");
+
+   auto& counters = counters_[workload];
+
+   ExecutorStats stats;
+   stats.tasks_ = counters.tasks_.load(memory_order_relaxed);
+   stats.busySeconds_ =
+      double(counters.busyNs_.load(memory_order_relaxed)) / 1e9;
+   stats.queuedSeconds_ =
+      double(counters.queuedNs_.load(memory_order_relaxed)) / 1e9;
+   return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+string Executor::statsReport() const
+{
+   auto capacity =
+      double(nanosecondsSince(start_)) / 1e9 * workers_.size();
+
+   stringstream ss;
+   ss << workers_.size() << " workers";
+   for (unsigned i = 0; i < ExecutorWorkload_Count; i++)
+   {
+      auto stats = getStats((ExecutorWorkload)i);
+      if (stats.tasks_ == 0)
+         continue;
+
+      ss << ", " << workloadName((ExecutorWorkload)i) << ": " <<
+         stats.tasks_ << " tasks, " << fixed << setprecision(1);
+
+      if (capacity > 0)
+         ss << stats.busySeconds_ * 100.0 / capacity << "% busy, ";
+
+      ss << setprecision(3) <<
+         stats.queuedSeconds_ * 1000.0 / stats.tasks_ << "ms avg wait";
+   }
+
+   return ss.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Executor& Executor::shared()
+{
+   static Executor executor(thread::hardware_concurrency());
+   return executor;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Executor::logTaskError(const string& what)
+{
+   LOGERR << "executor task failed with error: " << what;
+}
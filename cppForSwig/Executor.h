@@ -0,0 +1,475 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _H_EXECUTOR_
+#define _H_EXECUTOR_
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <future>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#include "ThreadSafeClasses.h"
+
+namespace Armory
+{
+   namespace Threading
+   {
+      //higher priorities are served first, at task granularity
+      enum TaskPriority
+      {
+         TaskPriority_Interactive,
+         TaskPriority_Normal,
+         TaskPriority_Background,
+         TaskPriority_Count
+      };
+
+      //subsystems tasks are accounted to
+      enum ExecutorWorkload
+      {
+         ExecutorWorkload_Scan,
+         ExecutorWorkload_ZeroConf,
+         ExecutorWorkload_Clients,
+         ExecutorWorkload_Maintenance,
+         ExecutorWorkload_Count
+      };
+
+      //////////////////////////////////////////////////////////////////////////
+      struct ExecutorStats
+      {
+         uint64_t tasks_ = 0;
+
+         //time spent running tasks, summed over workers
+         double busySeconds_ = 0;
+
+         //time tasks spent queued before a worker picked them up
+         double queuedSeconds_ = 0;
+      };
+
+      //////////////////////////////////////////////////////////////////////////
+      class Executor
+      {
+         /***
+         Fixed size pool of workers shared by the db's subsystems, to keep the
+         total thread count in line with the core count.
+
+         Each worker owns a deque per priority. Tasks posted from a worker go
+         to its own deques, others are spread round robin. A worker serves
+         the highest priority available: its own deque first (fifo for
+         interactive tasks, lifo otherwise for cache locality), then steals
+         from the front of the other workers' deques, before moving down a
+         priority level.
+
+         Tasks should not block on anything but other executor tasks. Use
+         wait() or parallel() for that, which run queued tasks while the
+         awaited ones complete, rather than sitting on a worker.
+         ***/
+
+      private:
+         struct Task
+         {
+            std::function<void(void)> func_;
+            ExecutorWorkload workload_;
+            std::chrono::steady_clock::time_point queued_;
+         };
+
+         struct Worker
+         {
+            std::mutex mu_;
+            std::deque<Task> queues_[TaskPriority_Count];
+            std::thread thread_;
+         };
+
+         struct WorkloadCounters
+         {
+            std::atomic<uint64_t> tasks_;
+            std::atomic<uint64_t> busyNs_;
+            std::atomic<uint64_t> queuedNs_;
+
+            WorkloadCounters(void)
+            {
+               tasks_.store(0, std::memory_order_relaxed);
+               busyNs_.store(0, std::memory_order_relaxed);
+               queuedNs_.store(0, std::memory_order_relaxed);
+            }
+         };
+
+      private:
+         std::vector<std::unique_ptr<Worker>> workers_;
+         WorkloadCounters counters_[ExecutorWorkload_Count];
+         const std::chrono::steady_clock::time_point start_;
+
+         std::atomic<size_t> pending_;
+         std::atomic<unsigned> nextWorker_;
+         std::atomic<bool> run_;
+
+         std::mutex sleepMutex_;
+         std::condition_variable sleepCondVar_;
+
+      private:
+         void workerLoop(unsigned);
+         bool popTask(unsigned, Task&);
+         bool popFromWorker(Worker&, TaskPriority, bool, Task&);
+         void runTask(Task&);
+
+         //index of the calling thread in this pool, -1 if it isn't a worker
+         int currentWorker(void) const;
+
+      public:
+         Executor(unsigned threadCount);
+         ~Executor(void);
+
+         Executor(const Executor&) = delete;
+         Executor& operator=(const Executor&) = delete;
+
+         unsigned threadCount(void) const { return workers_.size(); }
+
+         void post(ExecutorWorkload, TaskPriority, std::function<void(void)>);
+
+         template<typename F>
+         auto submit(ExecutorWorkload workload, TaskPriority priority, F&& f)
+            -> std::future<decltype(f())>
+         {
+            typedef decltype(f()) R;
+            auto task = std::make_shared<std::packaged_task<R(void)>>(
+               std::forward<F>(f));
+            auto fut = task->get_future();
+
+            post(workload, priority, [task](void)->void { (*task)(); });
+            return fut;
+         }
+
+         //Runs queued tasks on the calling thread while fut isn't ready,
+         //if the caller is a worker. Blocks on fut otherwise.
+         template<typename R>
+         void wait(std::future<R>& fut)
+         {
+            auto workerId = currentWorker();
+            if (workerId == -1)
+            {
+               fut.wait();
+               return;
+            }
+
+            while (fut.wait_for(std::chrono::seconds(0)) !=
+               std::future_status::ready)
+            {
+               Task task;
+               if (popTask(workerId, task))
+               {
+                  runTask(task);
+                  continue;
+               }
+
+               fut.wait_for(std::chrono::milliseconds(1));
+            }
+         }
+
+         //Runs func(0) to func(count - 1) concurrently and returns once
+         //all are done. func(0) runs on the calling thread. Rethrows the
+         //first exception once every call has returned.
+         void parallel(ExecutorWorkload, TaskPriority,
+            unsigned count, const std::function<void(unsigned)>& func);
+
+         ExecutorStats getStats(ExecutorWorkload) const;
+
+         //per workload share of the pool's capacity since it started
+         std::string statsReport(void) const;
+
+         //process wide instance, one worker per hardware thread
+         static Executor& shared(void);
+
+         static void logTaskError(const std::string&);
+      };
+
+      //////////////////////////////////////////////////////////////////////////
+      class DrainGroup
+      {
+         /***
+         Caps the combined drain tasks of the DrainQueues started with it.
+         A drainer giving up its slot reschedules every queue in the group,
+         entries held back by the cap are picked up once a slot frees.
+         ***/
+
+      private:
+         std::atomic<unsigned> active_;
+         const unsigned maxActive_;
+
+         std::mutex mu_;
+         std::map<const void*, std::function<void(void)>> schedulers_;
+
+      public:
+         DrainGroup(unsigned maxActive) :
+            maxActive_(std::max(maxActive, 1U))
+         {
+            active_.store(0, std::memory_order_relaxed);
+         }
+
+         bool acquire(void)
+         {
+            auto active = active_.load();
+            while (active < maxActive_)
+            {
+               if (active_.compare_exchange_weak(active, active + 1))
+                  return true;
+            }
+
+            return false;
+         }
+
+         void release(void)
+         {
+            active_.fetch_sub(1);
+
+            std::unique_lock<std::mutex> lock(mu_);
+            for (auto& scheduler : schedulers_)
+               scheduler.second();
+         }
+
+         unsigned getMaxActive(void) const { return maxActive_; }
+
+         void addQueue(const void* key, std::function<void(void)> scheduler)
+         {
+            std::unique_lock<std::mutex> lock(mu_);
+            schedulers_[key] = scheduler;
+         }
+
+         void removeQueue(const void* key)
+         {
+            std::unique_lock<std::mutex> lock(mu_);
+            schedulers_.erase(key);
+         }
+      };
+
+      //////////////////////////////////////////////////////////////////////////
+      template <typename T> class DrainQueue
+      {
+         /***
+         Queue served by executor tasks in place of dedicated consumer
+         threads. Pushing an entry starts a drain task, unless maxActive of
+         them are already running. Drain tasks process entries until the
+         queue runs dry, then return their worker to the pool.
+
+         Pushes past completed() or terminate() are dropped, like
+         BlockingQueue.
+
+         Queues started with the same DrainGroup also share its cap.
+         ***/
+
+      private:
+         Executor& executor_;
+         const ExecutorWorkload workload_;
+         const TaskPriority priority_;
+
+         std::function<void(T)> process_;
+         std::atomic<bool> started_;
+
+         Queue<T> queue_;
+         std::atomic<size_t> pending_;
+         std::atomic<unsigned> active_;
+         std::atomic<unsigned> maxActive_;
+         std::shared_ptr<DrainGroup> group_;
+
+         std::atomic<bool> stopped_;
+         std::atomic<bool> terminated_;
+
+         std::mutex mu_;
+         std::condition_variable condVar_;
+
+      private:
+         bool acquireSlot(void)
+         {
+            auto active = active_.load();
+            while (active < maxActive_.load())
+            {
+               if (!active_.compare_exchange_weak(active, active + 1))
+                  continue;
+
+               if (group_ == nullptr || group_->acquire())
+                  return true;
+
+               active_.fetch_sub(1);
+               return false;
+            }
+
+            return false;
+         }
+
+         void releaseSlot(void)
+         {
+            active_.fetch_sub(1);
+            if (group_ != nullptr)
+               group_->release();
+         }
+
+         void schedule(void)
+         {
+            if (!started_.load(std::memory_order_acquire))
+               return;
+
+            while (pending_.load() > 0 && acquireSlot())
+            {
+               executor_.post(workload_, priority_,
+                  [this](void)->void { this->drain(); });
+
+               //one drainer per pending entry at most
+               if (active_.load() >= pending_.load())
+                  break;
+            }
+         }
+
+         void drain(void)
+         {
+            while (true)
+            {
+               while (!terminated_.load(std::memory_order_acquire))
+               {
+                  try
+                  {
+                     auto entry = queue_.pop_front();
+                     pending_.fetch_sub(1);
+
+                     process_(std::move(entry));
+                  }
+                  catch (IsEmpty&)
+                  {
+                     break;
+                  }
+                  catch (std::exception& e)
+                  {
+                     Executor::logTaskError(e.what());
+                  }
+                  catch (...)
+                  {
+                     Executor::logTaskError("unknown exception");
+                  }
+               }
+
+               //Release the slot. A push may have raced the empty pop and
+               //failed to get a slot, check for entries under the lock so
+               //that the last drainer out picks them up.
+               std::unique_lock<std::mutex> lock(mu_);
+               releaseSlot();
+               if (!terminated_.load(std::memory_order_acquire) &&
+                  pending_.load() > 0 && acquireSlot())
+                  continue;
+
+               condVar_.notify_all();
+               return;
+            }
+         }
+
+         void waitOnDrainers(bool untilEmpty)
+         {
+            if (!started_.load(std::memory_order_acquire))
+               return;
+
+            std::unique_lock<std::mutex> lock(mu_);
+            condVar_.wait(lock, [this, untilEmpty](void)->bool
+            {
+               if (active_.load() > 0)
+                  return false;
+
+               return !untilEmpty || pending_.load() == 0;
+            });
+         }
+
+      public:
+         DrainQueue(Executor& executor,
+            ExecutorWorkload workload, TaskPriority priority) :
+            executor_(executor), workload_(workload), priority_(priority)
+         {
+            started_.store(false, std::memory_order_relaxed);
+            pending_.store(0, std::memory_order_relaxed);
+            active_.store(0, std::memory_order_relaxed);
+            maxActive_.store(1, std::memory_order_relaxed);
+            stopped_.store(false, std::memory_order_relaxed);
+            terminated_.store(false, std::memory_order_relaxed);
+         }
+
+         ~DrainQueue(void)
+         {
+            terminate();
+         }
+
+         //entries pushed before start are held until then
+         void start(std::function<void(T)> process, unsigned maxActive,
+            std::shared_ptr<DrainGroup> group = nullptr)
+         {
+            process_ = process;
+            maxActive_.store(std::max(maxActive, 1U));
+
+            group_ = group;
+            if (group_ != nullptr)
+               group_->addQueue(this, [this](void)->void { schedule(); });
+
+            started_.store(true, std::memory_order_release);
+            schedule();
+         }
+
+         void setMaxActive(unsigned maxActive)
+         {
+            maxActive_.store(std::max(maxActive, 1U));
+            schedule();
+         }
+
+         unsigned getMaxActive(void) const
+         {
+            return maxActive_.load();
+         }
+
+         void push_back(T&& obj)
+         {
+            if (stopped_.load(std::memory_order_acquire))
+               return;
+
+            //count the entry first so that a drainer never sees it
+            //before it's accounted for
+            pending_.fetch_add(1);
+            queue_.push_back(std::move(obj));
+            schedule();
+         }
+
+         size_t count(void) const
+         {
+            return pending_.load();
+         }
+
+         //stop taking entries, returns once the queue is drained
+         void completed(void)
+         {
+            stopped_.store(true, std::memory_order_release);
+            waitOnDrainers(true);
+         }
+
+         //stop taking entries, drop the pending ones, returns once the
+         //running drainers are done with their current entry
+         void terminate(void)
+         {
+            stopped_.store(true, std::memory_order_release);
+            terminated_.store(true, std::memory_order_release);
+            if (group_ != nullptr)
+               group_->removeQueue(this);
+            waitOnDrainers(false);
+
+            queue_.clear();
+            pending_.store(0);
+         }
+      };
+   }; //namespace Threading
+}; //namespace Armory
+
+#endif
@@ -5,10 +5,15 @@
 //  See LICENSE-ATI or http://www.gnu.org/licenses/agpl.html                  //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+
 #include "HistoryPager.h"
+#include "BlockchainDatabase/Blockchain.h"
 
 using namespace std;
 
+#define HISTORYCURSOR_SIZE 45
+
 uint32_t HistoryPager::txnPerPage_ = 100;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,4 +285,177 @@ uint32_t HistoryPager::getPageIdForBlockHeight(uint32_t blk) const
 void HistoryPager::sortPages(vector<shared_ptr<Page>>& pages)
 {
    std::sort(pages.begin(), pages.end(), Page::comparator);
-}
\ No newline at end of file
+}
+////////////////////////////////////////////////////////////////////////////////
+vector<LedgerEntry> HistoryPager::getPageFromCursor(BinaryData& token,
+   unsigned count, const map<uint32_t, uint32_t>& summary,
+   const Blockchain* bc,
+   const function<map<BinaryData, LedgerEntry>(uint32_t, uint32_t)>& getLedgers)
+{
+   if (count == 0)
+      throw runtime_error("invalid history page size");
+
+   HistoryCursor cursor;
+   bool firstPage = token.empty();
+   if (firstPage)
+   {
+      auto top = bc->top();
+      cursor.cutoffHeight_ = top->getBlockHeight();
+      cursor.cutoffHash_ = top->getThisHash();
+   }
+   else
+   {
+      cursor.unserialize(token.getRef());
+
+      //the block the first page was pinned to has to be on the main chain
+      shared_ptr<BlockHeader> header;
+      try
+      {
+         header = bc->getHeaderByHeight(cursor.cutoffHeight_, 0xFF);
+      }
+      catch (exception&)
+      {}
+
+      if (header == nullptr || header->getThisHash() != cursor.cutoffHash_)
+         throw runtime_error("history cursor invalidated by reorg");
+   }
+
+   /*
+   Pull ledgers in height windows, walking down from the cursor. Each window
+   is sized off the ssh summary to cover what is left of the page. The
+   summary counts txios rather than ledgers, so a window can come up short,
+   in which case the next one picks up right below it.
+   */
+
+   uint32_t hi = UINT32_MAX;
+   if (!firstPage)
+      hi = min(cursor.height_, cursor.cutoffHeight_);
+
+   vector<LedgerEntry> result;
+   bool exhausted = false;
+   while (true)
+   {
+      uint32_t lo = 0;
+      uint32_t total = 0;
+      auto iter = summary.upper_bound(min(hi, cursor.cutoffHeight_));
+      while (iter != summary.begin())
+      {
+         --iter;
+         total += iter->second;
+         if (total + result.size() >= count)
+         {
+            lo = iter->first;
+            break;
+         }
+      }
+
+      auto&& ledgers = getLedgers(lo, hi);
+      for (auto& lePair : ledgers)
+      {
+         auto& le = lePair.second;
+         auto height = le.getBlockNum();
+
+         //zc only go on the first page
+         if (height == UINT32_MAX)
+         {
+            if (firstPage)
+               result.push_back(move(le));
+            continue;
+         }
+
+         if (height > cursor.cutoffHeight_)
+            continue;
+
+         if (!firstPage)
+         {
+            if (height > cursor.height_ ||
+               (height == cursor.height_ && le.getIndex() >= cursor.index_))
+               continue;
+         }
+
+         result.push_back(move(le));
+      }
+
+      if (lo == 0)
+      {
+         exhausted = true;
+         break;
+      }
+
+      if (result.size() >= count)
+         break;
+
+      hi = lo - 1;
+   }
+
+   LedgerEntry_DescendingOrder desc;
+   sort(result.begin(), result.end(), desc);
+
+   //windows cover full heights, cut the page to size without splitting
+   //entries sharing a position (group ledgers) and without splitting zc
+   bool truncated = false;
+   if (result.size() > count)
+   {
+      size_t last = count;
+      while (last < result.size())
+      {
+         if (result[last].getBlockNum() != UINT32_MAX &&
+            result[last - 1] > result[last])
+            break;
+
+         ++last;
+      }
+
+      if (last < result.size())
+      {
+         result.erase(result.begin() + last, result.end());
+         truncated = true;
+      }
+   }
+
+   if (exhausted && !truncated)
+   {
+      token.clear();
+      return result;
+   }
+
+   auto& lastEntry = result.back();
+   cursor.height_ = lastEntry.getBlockNum();
+   cursor.index_ = lastEntry.getIndex();
+   token = cursor.serialize();
+
+   return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+BinaryData HistoryCursor::serialize() const
+{
+   if (cutoffHash_.getSize() != 32)
+      throw runtime_error("invalid history cursor");
+
+   BinaryWriter bw;
+   bw.put_uint8_t(HISTORYCURSOR_VERSION);
+   bw.put_uint32_t(cutoffHeight_);
+   bw.put_BinaryData(cutoffHash_);
+   bw.put_uint32_t(height_);
+   bw.put_uint32_t(index_);
+
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void HistoryCursor::unserialize(BinaryDataRef data)
+{
+   if (data.getSize() != HISTORYCURSOR_SIZE)
+      throw runtime_error("invalid history cursor");
+
+   BinaryRefReader brr(data);
+   if (brr.get_uint8_t() != HISTORYCURSOR_VERSION)
+      throw runtime_error("unsupported history cursor version");
+
+   cutoffHeight_ = brr.get_uint32_t();
+   cutoffHash_ = brr.get_BinaryData(32);
+   height_ = brr.get_uint32_t();
+   index_ = brr.get_uint32_t();
+}
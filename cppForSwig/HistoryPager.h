@@ -17,9 +17,37 @@
 #include "LedgerEntry.h"
 #include "BlockchainDatabase/BlockObj.h"
 
+#define HISTORYCURSOR_VERSION 1
+#define HISTORYCURSOR_DEFAULT_PAGE_SIZE 100
+#define HISTORYCURSOR_MAX_PAGE_SIZE 1000
+
+class Blockchain;
+
 class AlreadyPagedException
 {};
 
+////////////////////////////////////////////////////////////////////////////////
+struct HistoryCursor
+{
+   /***
+   Continuation token for cursor based history paging. Pins the chain
+   height and hash the first page was served at along with the position
+   of the last entry served. Continuation pages only return entries below
+   that position, new blocks and zc do not shift them. A reorg past the
+   pinned height invalidates the cursor.
+   ***/
+
+   uint32_t cutoffHeight_ = UINT32_MAX;
+   BinaryData cutoffHash_;
+
+   //last served entry, continuation starts strictly below it
+   uint32_t height_ = UINT32_MAX;
+   uint32_t index_ = UINT32_MAX;
+
+   BinaryData serialize(void) const;
+   void unserialize(BinaryDataRef);
+};
+
 class HistoryPager
 {
 private:
@@ -98,6 +126,17 @@ public:
    uint32_t getBlockInVicinity(uint32_t blk) const;
    uint32_t getPageIdForBlockHeight(uint32_t) const;
 
+   //Entries in descending (height, index) order, up to count of them,
+   //following the position in token. An empty token starts from the top
+   //of the chain, zc first. Token is set to the continuation for the next
+   //page, or cleared once the history is exhausted. Ledgers are pulled in
+   //height windows sized off the ssh summary.
+   static std::vector<LedgerEntry> getPageFromCursor(BinaryData& token,
+      unsigned count, const std::map<uint32_t, uint32_t>& summary,
+      const Blockchain*,
+      const std::function<std::map<BinaryData, LedgerEntry>(
+         uint32_t, uint32_t)>& getLedgers);
+
    bool isInitiliazed(void) const
    {
       return isInitialized_->load(std::memory_order_relaxed);
@@ -17,29 +17,59 @@ JSON_value::~JSON_value()
 {}
 
 ////////////////////////////////////////////////////////////////////////////////
-string JSON_encode(JSON_object& json_obj)
+namespace
 {
-   //make sure json_obj has jsonrpc, params and id key
-   auto rpciter = json_obj.keyval_pairs_.find(string("jsonrpc"));
-   if (rpciter == json_obj.keyval_pairs_.end())
-      json_obj.add_pair("jsonrpc", "2.0");
-
-   auto paramsiter = json_obj.keyval_pairs_.find(string("params"));
-   if (paramsiter == json_obj.keyval_pairs_.end())
+   void prepareRequest(JSON_object& json_obj)
    {
-      JSON_array arr;
-      json_obj.add_pair("params", arr);
+      //make sure json_obj has jsonrpc, params and id key
+      auto rpciter = json_obj.keyval_pairs_.find(string("jsonrpc"));
+      if (rpciter == json_obj.keyval_pairs_.end())
+         json_obj.add_pair("jsonrpc", "2.0");
+
+      auto paramsiter = json_obj.keyval_pairs_.find(string("params"));
+      if (paramsiter == json_obj.keyval_pairs_.end())
+      {
+         JSON_array arr;
+         json_obj.add_pair("params", arr);
+      }
+
+      auto iditer = json_obj.keyval_pairs_.find(string("id"));
+      if (iditer == json_obj.keyval_pairs_.end())
+         json_obj.add_pair("id", json_obj.id_);
    }
+}
 
-   auto iditer = json_obj.keyval_pairs_.find(string("id"));
-   if (iditer == json_obj.keyval_pairs_.end())
-      json_obj.add_pair("id", json_obj.id_);
+////////////////////////////////////////////////////////////////////////////////
+string JSON_encode(JSON_object& json_obj)
+{
+   prepareRequest(json_obj);
 
    stringstream ss;
    json_obj.serialize(ss);
    return ss.str();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+string JSON_encode(vector<shared_ptr<JSON_object>>& json_batch)
+{
+   //JSON-RPC 2.0 batch: an array of requests, answered by an array of
+   //replies in no particular order, matched back to requests by id
+   stringstream ss;
+   ss << "[";
+
+   for (unsigned i = 0; i < json_batch.size(); i++)
+   {
+      if (i > 0)
+         ss << ", ";
+
+      prepareRequest(*json_batch[i]);
+      json_batch[i]->serialize(ss);
+   }
+
+   ss << "]";
+   return ss.str();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void JSON_object::serialize(ostream& s) const
 {
@@ -369,6 +399,29 @@ JSON_object JSON_decode(const string& json_str)
    return obj;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+map<int, shared_ptr<JSON_object>> JSON_decodeBatch(const string& json_str)
+{
+   JSON_StreamParser parser;
+   parser.push(json_str);
+   if (!parser.isComplete())
+      throw JSON_Exception("incomplete json reply");
+
+   map<int, shared_ptr<JSON_object>> result;
+   auto&& objects = parser.popObjects();
+   for (auto& obj : objects)
+   {
+      auto idVal = obj->getValForKey("id");
+      auto id_obj = dynamic_pointer_cast<JSON_number>(idVal);
+      if (id_obj == nullptr)
+         continue;
+
+      result.emplace(int(id_obj->val_), obj);
+   }
+
+   return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 shared_ptr<JSON_value> JSON_object::getValForKey(const string& key)
 {
@@ -405,3 +458,135 @@ bool JSON_object::isResponseValid(int id)
 
    return true;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// JSON_StreamParser
+//
+////////////////////////////////////////////////////////////////////////////////
+void JSON_StreamParser::push(const char* ptr, size_t len)
+{
+   if (complete_ || len == 0)
+      return;
+
+   buffer_.append(ptr, len);
+
+   while (pos_ < buffer_.size() && !complete_)
+   {
+      auto c = buffer_[pos_];
+
+      if (inString_)
+      {
+         if (escaped_)
+            escaped_ = false;
+         else if (c == '\\')
+            escaped_ = true;
+         else if (c == '\"')
+            inString_ = false;
+
+         ++pos_;
+         continue;
+      }
+
+      switch (c)
+      {
+      case '\"':
+      {
+         inString_ = true;
+         break;
+      }
+
+      case '[':
+      {
+         if (!started_)
+         {
+            //top level array, this is a batch reply
+            started_ = true;
+            baseDepth_ = 1;
+         }
+
+         ++depth_;
+         break;
+      }
+
+      case '{':
+      {
+         if (!started_)
+         {
+            started_ = true;
+            baseDepth_ = 0;
+         }
+
+         if (depth_ == baseDepth_)
+            objStart_ = pos_;
+
+         ++depth_;
+         break;
+      }
+
+      case '}':
+      {
+         if (depth_ == 0)
+            throw JSON_Exception("unbalanced json object");
+
+         --depth_;
+         if (depth_ == baseDepth_ && objStart_ != SIZE_MAX)
+         {
+            decodeObject(objStart_, pos_ + 1);
+            objStart_ = SIZE_MAX;
+
+            if (baseDepth_ == 0)
+               complete_ = true;
+         }
+
+         break;
+      }
+
+      case ']':
+      {
+         if (depth_ == 0)
+            throw JSON_Exception("unbalanced json array");
+
+         --depth_;
+         if (depth_ == 0 && baseDepth_ == 1)
+            complete_ = true;
+
+         break;
+      }
+
+      default:
+         break;
+      }
+
+      ++pos_;
+   }
+
+   //drop whatever was consumed, keep the object currently being read
+   auto keepFrom = pos_;
+   if (objStart_ != SIZE_MAX)
+   {
+      keepFrom = objStart_;
+      objStart_ = 0;
+   }
+
+   buffer_.erase(0, keepFrom);
+   pos_ -= keepFrom;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JSON_StreamParser::decodeObject(size_t start, size_t end)
+{
+   auto obj = make_shared<JSON_object>();
+   stringstream ss(buffer_.substr(start, end - start));
+   obj->unserialize(ss);
+
+   objects_.push_back(move(obj));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vector<shared_ptr<JSON_object>> JSON_StreamParser::popObjects()
+{
+   vector<shared_ptr<JSON_object>> result;
+   result.swap(objects_);
+   return result;
+}
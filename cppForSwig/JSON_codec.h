@@ -15,10 +15,14 @@
 #include <string>
 #include <map>
 #include <sstream>
+#include <cstdint>
 
 #define FEE_STRAT_CONSERVATIVE   "CONSERVATIVE"
 #define FEE_STRAT_ECONOMICAL     "ECONOMICAL"
 
+//conf targets of fee schedules
+#define FEE_SCHEDULE_TARGETS     { 2, 3, 4, 5, 6, 10, 20 }
+
 enum JSON_StateEnum
 {
    JSON_null,
@@ -232,7 +236,47 @@ struct JSON_array : public JSON_value
    void unserialize(std::istream&);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class JSON_StreamParser
+{
+   /***
+   Incremental decoder for JSON-RPC replies. Takes the response body in
+   arbitrary chunks and hands out each top level object as soon as its
+   closing brace is seen. Handles both single object replies and JSON-RPC 2.0
+   batch arrays, in which case every array entry is yielded on its own.
+   ***/
+
+private:
+   std::string buffer_;
+   size_t pos_ = 0;
+   size_t objStart_ = SIZE_MAX;
+
+   unsigned depth_ = 0;
+   unsigned baseDepth_ = 0;
+   bool inString_ = false;
+   bool escaped_ = false;
+   bool started_ = false;
+   bool complete_ = false;
+
+   std::vector<std::shared_ptr<JSON_object>> objects_;
+
+private:
+   void decodeObject(size_t, size_t);
+
+public:
+   void push(const char*, size_t);
+   void push(const std::string& str) { push(str.c_str(), str.size()); }
+
+   std::vector<std::shared_ptr<JSON_object>> popObjects(void);
+   bool isBatch(void) const { return baseDepth_ == 1; }
+   bool isComplete(void) const { return complete_; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
 std::string JSON_encode(JSON_object& json_obj);
+std::string JSON_encode(std::vector<std::shared_ptr<JSON_object>>& json_batch);
 JSON_object JSON_decode(const std::string& json_str);
+std::map<int, std::shared_ptr<JSON_object>> JSON_decodeBatch(
+   const std::string& json_str);
 
 #endif
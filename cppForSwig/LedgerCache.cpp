@@ -0,0 +1,799 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <set>
+#include <ctime>
+
+#include "LedgerCache.h"
+#include "DBUtils.h"
+#include "BlockchainDatabase/lmdb_wrapper.h"
+#include "BlockchainDatabase/Blockchain.h"
+
+using namespace std;
+
+#define LEDGERCACHE_ID_LENGTH 8
+
+//how stale lastUsed_ gets before a read only page refreshes it
+#define LEDGERCACHE_TOUCH_INTERVAL (24 * 3600ULL)
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////LedgerCache::Meta
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::Meta::serialize() const
+{
+   BinaryWriter bw;
+   bw.put_uint8_t(LEDGERCACHE_VERSION);
+   bw.put_BinaryData(cacheId_);
+   bw.put_uint32_t(tipHeight_);
+   bw.put_var_int(tipHash_.getSize());
+   bw.put_BinaryData(tipHash_);
+   bw.put_var_int(addrDigest_.getSize());
+   bw.put_BinaryData(addrDigest_);
+   bw.put_uint64_t(lastUsed_);
+
+   bw.put_var_int(ranges_.size());
+   for (auto& range : ranges_)
+   {
+      bw.put_uint32_t(range.first);
+      bw.put_uint32_t(range.second);
+   }
+
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::Meta::unserialize(BinaryDataRef data)
+{
+   BinaryRefReader brr(data);
+   if (brr.get_uint8_t() != LEDGERCACHE_VERSION)
+      throw runtime_error("ledger cache version mismatch");
+
+   cacheId_ = brr.get_BinaryData(LEDGERCACHE_ID_LENGTH);
+   tipHeight_ = brr.get_uint32_t();
+   auto hashLen = brr.get_var_int();
+   tipHash_ = brr.get_BinaryData(hashLen);
+   auto digestLen = brr.get_var_int();
+   addrDigest_ = brr.get_BinaryData(digestLen);
+   lastUsed_ = brr.get_uint64_t();
+
+   ranges_.clear();
+   auto count = brr.get_var_int();
+   for (uint64_t i = 0; i < count; i++)
+   {
+      auto start = brr.get_uint32_t();
+      auto end = brr.get_uint32_t();
+      ranges_.emplace(start, end);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::Meta::addRange(uint32_t start, uint32_t end)
+{
+   //merge with overlapping and adjacent ranges
+   auto iter = ranges_.upper_bound(start);
+   if (iter != ranges_.begin())
+   {
+      auto prevIter = prev(iter);
+      if (prevIter->second == UINT32_MAX || prevIter->second + 1 >= start)
+      {
+         start = prevIter->first;
+         end = max(end, prevIter->second);
+         iter = ranges_.erase(prevIter);
+      }
+   }
+
+   while (iter != ranges_.end() &&
+      (end == UINT32_MAX || iter->first <= end + 1))
+   {
+      end = max(end, iter->second);
+      iter = ranges_.erase(iter);
+   }
+
+   ranges_.emplace(start, end);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::Meta::capRanges(uint32_t height)
+{
+   //drop everything at and above height
+   auto iter = ranges_.lower_bound(height);
+   ranges_.erase(iter, ranges_.end());
+
+   if (!ranges_.empty())
+   {
+      auto& last = *ranges_.rbegin();
+      if (last.second >= height)
+         last.second = height - 1;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////LedgerCache
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::computeCacheId(const string& walletID)
+{
+   BinaryWriter bw;
+   bw.put_var_int(walletID.size());
+   bw.put_String(walletID);
+
+   auto&& hash = BtcUtils::getHash256(bw.getDataRef());
+   return hash.getSliceCopy(0, LEDGERCACHE_ID_LENGTH);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::computeAddrDigest(const WalletAddrMap& addrMap)
+{
+   BinaryWriter bw;
+   for (auto& addrPair : addrMap)
+   {
+      bw.put_var_int(addrPair.first.getSize());
+      bw.put_BinaryDataRef(addrPair.first);
+   }
+
+   return BtcUtils::getHash256(bw.getDataRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<mutex> LedgerCache::getWalletMutex(const string& walletID)
+{
+   static mutex registryMu;
+   static map<string, weak_ptr<mutex>> registry;
+
+   unique_lock<mutex> lock(registryMu);
+   auto iter = registry.begin();
+   while (iter != registry.end())
+   {
+      if (iter->second.expired() && iter->first != walletID)
+         iter = registry.erase(iter);
+      else
+         ++iter;
+   }
+
+   auto& entry = registry[walletID];
+   auto mu = entry.lock();
+   if (mu == nullptr)
+   {
+      mu = make_shared<mutex>();
+      entry = mu;
+   }
+
+   return mu;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::setWalletID(const string& walletID)
+{
+   if (!cacheId_.empty())
+      return;
+
+   cacheId_ = computeCacheId(walletID);
+   walletMu_ = getWalletMutex(walletID);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::getMetaKey(const string& walletID)
+{
+   BinaryWriter bw;
+   bw.put_uint8_t(DB_PREFIX_LEDGERMETA);
+   bw.put_String(walletID);
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::getCachePrefix(
+   DB_PREFIX prefix, const BinaryData& cacheId)
+{
+   BinaryWriter bw;
+   bw.put_uint8_t(prefix);
+   bw.put_BinaryData(cacheId);
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerCache::getLedgerKey(uint32_t height) const
+{
+   BinaryWriter bw;
+   bw.put_uint8_t(DB_PREFIX_LEDGER);
+   bw.put_BinaryData(cacheId_);
+   bw.put_BinaryData(DBUtils::heightAndDupToHgtx(height, 0));
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LedgerCache::Meta LedgerCache::loadMeta(const string& walletID)
+{
+   //callers hold walletMu_
+   Meta meta;
+   bool hasMeta = false;
+   bool valid = false;
+
+   {
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      auto&& metaKey = getMetaKey(walletID);
+      auto data = db_->getValueNoCopy(HISTORY, metaKey.getRef());
+      if (data.getSize() > 0)
+      {
+         hasMeta = true;
+         try
+         {
+            meta.unserialize(data);
+            valid = meta.cacheId_ == cacheId_;
+         }
+         catch (exception&)
+         {}
+      }
+   }
+
+   if (!hasMeta)
+   {
+      meta.cacheId_ = cacheId_;
+      return meta;
+   }
+
+   if (!valid)
+   {
+      //unreadable meta, nothing under this cache id can be trusted
+      LOGWARN << "invalid ledger cache meta for wallet " << walletID;
+
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+      eraseLedgers(0);
+      erasePrefix(db_, getCachePrefix(DB_PREFIX_LEDGERADDRS, cacheId_));
+
+      meta = Meta();
+      meta.cacheId_ = cacheId_;
+      return meta;
+   }
+
+   return meta;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LedgerCache::isTipOnChain(const Meta& meta) const
+{
+   if (meta.tipHeight_ == UINT32_MAX)
+      return true;
+
+   try
+   {
+      auto header = bc_->getHeaderByHeight(meta.tipHeight_, 0xFF);
+      return header->getThisHash() == meta.tipHash_;
+   }
+   catch (exception&)
+   {}
+
+   return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::putMeta(const string& walletID, Meta& meta)
+{
+   //callers hold walletMu_ and a HISTORY write tx
+   meta.tipHeight_ = UINT32_MAX;
+   meta.tipHash_.clear();
+   meta.lastUsed_ = time(0);
+
+   if (!meta.ranges_.empty())
+   {
+      auto tipHeight = meta.ranges_.rbegin()->second;
+      try
+      {
+         auto header = bc_->getHeaderByHeight(tipHeight, 0xFF);
+         meta.tipHeight_ = tipHeight;
+         meta.tipHash_ = header->getThisHash();
+      }
+      catch (exception&)
+      {
+         //can't anchor the cache, next load will start over
+         eraseLedgers(0);
+         meta.ranges_.clear();
+      }
+   }
+
+   auto&& metaKey = getMetaKey(walletID);
+   auto&& data = meta.serialize();
+   db_->putValue(HISTORY, metaKey.getRef(), data.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::syncAddresses(const string& walletID, Meta& meta)
+{
+   //callers hold walletMu_
+   if (meta.addrDigest_ == addrDigest_)
+      return;
+
+   //diff the current address set against the one the cache was built for
+   auto&& addrPrefix = getCachePrefix(DB_PREFIX_LEDGERADDRS, cacheId_);
+   set<BinaryData> stored;
+   {
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      auto dbIter = db_->getIterator(HISTORY);
+      if (dbIter->seekToStartsWith(addrPrefix.getRef()))
+      {
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(addrPrefix.getRef()))
+               break;
+
+            stored.emplace(key.getSliceRef(
+               addrPrefix.getSize(), key.getSize() - addrPrefix.getSize()));
+         }
+         while (dbIter->advanceAndRead());
+      }
+   }
+
+   vector<BinaryDataRef> added;
+   for (auto& addrPair : *addrMapSnapshot_)
+   {
+      if (stored.erase(addrPair.first) == 0)
+         added.push_back(addrPair.first);
+   }
+
+   //what's left in stored was removed from the wallet
+   bool removed = !stored.empty();
+
+   //lowest height the new addresses have history at
+   uint32_t fromHeight = UINT32_MAX;
+   if (removed)
+   {
+      fromHeight = 0;
+   }
+   else if (!added.empty() && !meta.ranges_.empty())
+   {
+      try
+      {
+         auto&& tx = db_->beginTransaction(SSH, LMDB::ReadOnly);
+         for (auto& scrAddr : added)
+         {
+            auto&& summary = db_->getSSHSummary(scrAddr);
+            if (!summary.empty())
+               fromHeight = min(fromHeight, summary.begin()->first);
+         }
+      }
+      catch (exception&)
+      {
+         fromHeight = 0;
+      }
+   }
+
+   auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+   if (fromHeight != UINT32_MAX)
+   {
+      eraseLedgers(fromHeight);
+      meta.capRanges(fromHeight);
+   }
+
+   if (removed)
+   {
+      erasePrefix(db_, addrPrefix.getRef());
+      added.clear();
+      for (auto& addrPair : *addrMapSnapshot_)
+         added.push_back(addrPair.first);
+   }
+
+   for (auto& scrAddr : added)
+   {
+      BinaryWriter bw;
+      bw.put_BinaryData(addrPrefix);
+      bw.put_BinaryDataRef(scrAddr);
+      db_->putValue(HISTORY, bw.getDataRef(), BinaryDataRef());
+   }
+
+   meta.addrDigest_ = addrDigest_;
+   putMeta(walletID, meta);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::erasePrefix(LMDBBlockDatabase* db, BinaryDataRef prefix)
+{
+   //callers hold a HISTORY write tx
+   vector<BinaryData> keys;
+   {
+      auto dbIter = db->getIterator(HISTORY);
+      if (dbIter->seekToStartsWith(prefix))
+      {
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(prefix))
+               break;
+
+            keys.emplace_back(key);
+         }
+         while (dbIter->advanceAndRead());
+      }
+   }
+
+   for (auto& key : keys)
+      db->deleteValue(HISTORY, key.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::eraseLedgers(uint32_t fromHeight)
+{
+   //callers hold a HISTORY write tx
+   auto&& prefix = getCachePrefix(DB_PREFIX_LEDGER, cacheId_);
+
+   vector<BinaryData> keys;
+   {
+      auto&& startKey = getLedgerKey(fromHeight);
+      auto dbIter = db_->getIterator(HISTORY);
+      if (dbIter->seekTo(startKey.getRef()))
+      {
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(prefix.getRef()))
+               break;
+
+            keys.emplace_back(key);
+         }
+         while (dbIter->advanceAndRead());
+      }
+   }
+
+   for (auto& key : keys)
+      db_->deleteValue(HISTORY, key.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::readLedgers(uint32_t start, uint32_t end,
+   const string& walletID, map<BinaryData, LedgerEntry>& result) const
+{
+   auto&& prefix = getCachePrefix(DB_PREFIX_LEDGER, cacheId_);
+
+   auto&& startKey = getLedgerKey(start);
+   auto dbIter = db_->getIterator(HISTORY);
+   if (!dbIter->seekTo(startKey.getRef()))
+      return;
+
+   do
+   {
+      auto key = dbIter->getKeyRef();
+      if (!key.startsWith(prefix.getRef()) ||
+         key.getSize() != prefix.getSize() + 6)
+         break;
+
+      auto ledgerKey = key.getSliceRef(prefix.getSize(), 6);
+      BinaryData hgtx(ledgerKey.getSliceRef(0, 4));
+      if (DBUtils::hgtxToHeight(hgtx) > end)
+         break;
+
+      try
+      {
+         result.emplace(ledgerKey,
+            LedgerEntry::unserialize(dbIter->getValueRef(), walletID));
+      }
+      catch (exception&)
+      {
+         LOGWARN << "failed to deser cached ledger";
+      }
+   }
+   while (dbIter->advanceAndRead());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::writeLedgers(
+   const map<BinaryData, LedgerEntry>& ledgers, uint32_t end)
+{
+   for (auto& lePair : ledgers)
+   {
+      if (lePair.second.getBlockNum() > end || lePair.first.getSize() != 6)
+         continue;
+
+      BinaryWriter bw;
+      bw.put_uint8_t(DB_PREFIX_LEDGER);
+      bw.put_BinaryData(cacheId_);
+      bw.put_BinaryData(lePair.first);
+
+      auto&& data = lePair.second.serialize();
+      db_->putValue(HISTORY, bw.getDataRef(), data.getRef());
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+map<BinaryData, LedgerEntry> LedgerCache::getLedgers(
+   const string& walletID, shared_ptr<const WalletAddrMap> addrMap,
+   uint32_t start, uint32_t end, const ComputeLedgers& compute)
+{
+   if (db_ == nullptr || bc_ == nullptr || addrMap == nullptr)
+      return compute(start, end);
+
+   auto top = top_.load(memory_order_relaxed);
+   if (top == UINT32_MAX || start > top)
+      return compute(start, end);
+
+   unique_lock<mutex> lock(mu_);
+   setWalletID(walletID);
+   if (addrMap != addrMapSnapshot_)
+   {
+      addrMapSnapshot_ = addrMap;
+      addrDigest_ = computeAddrDigest(*addrMap);
+   }
+
+   //other BDVs may load this wallet id, hold its lock from the meta read
+   //to the meta write
+   unique_lock<mutex> walletLock(*walletMu_);
+   auto meta = loadMeta(walletID);
+   if (!isTipOnChain(meta))
+   {
+      LOGINFO << "ledger cache tip is off chain, dropping cache for " <<
+         walletID;
+
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+      eraseLedgers(0);
+      meta.ranges_.clear();
+      putMeta(walletID, meta);
+   }
+
+   syncAddresses(walletID, meta);
+
+   //split [start, cacheEnd] in cached and missing ranges
+   auto cacheEnd = min(end, top);
+   vector<pair<uint32_t, uint32_t>> hits, gaps;
+
+   uint32_t cursor = start;
+   auto iter = meta.ranges_.upper_bound(start);
+   if (iter != meta.ranges_.begin())
+      --iter;
+
+   while (cursor <= cacheEnd)
+   {
+      if (iter == meta.ranges_.end() || iter->first > cursor)
+      {
+         uint32_t gapEnd = cacheEnd;
+         if (iter != meta.ranges_.end())
+            gapEnd = min(cacheEnd, iter->first - 1);
+
+         gaps.emplace_back(cursor, gapEnd);
+         cursor = gapEnd + 1;
+         continue;
+      }
+
+      if (iter->second < cursor)
+      {
+         ++iter;
+         continue;
+      }
+
+      auto hitEnd = min(cacheEnd, iter->second);
+      hits.emplace_back(cursor, hitEnd);
+      cursor = hitEnd + 1;
+      ++iter;
+   }
+
+   map<BinaryData, LedgerEntry> result;
+   if (!hits.empty())
+   {
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      for (auto& hit : hits)
+         readLedgers(hit.first, hit.second, walletID, result);
+   }
+
+   if (!gaps.empty())
+   {
+      vector<map<BinaryData, LedgerEntry>> computed;
+      for (auto& gap : gaps)
+         computed.emplace_back(compute(gap.first, gap.second));
+
+      if (db_->getDbUsedSize(HISTORY) < LEDGERCACHE_MAX_DB_SIZE)
+      {
+         auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+         for (unsigned i = 0; i < gaps.size(); i++)
+         {
+            writeLedgers(computed[i], gaps[i].second);
+            meta.addRange(gaps[i].first, gaps[i].second);
+         }
+
+         putMeta(walletID, meta);
+      }
+      else
+      {
+         static atomic<bool> warned = { false };
+         if (!warned.exchange(true))
+            LOGWARN << "HISTORY db is full, no longer caching ledgers";
+      }
+
+      for (auto& ledgers : computed)
+         result.insert(ledgers.begin(), ledgers.end());
+   }
+   else if (uint64_t(time(0)) > meta.lastUsed_ + LEDGERCACHE_TOUCH_INTERVAL)
+   {
+      auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+      putMeta(walletID, meta);
+   }
+
+   walletLock.unlock();
+   lock.unlock();
+
+   //zc and heights past the last notified block
+   if (end > cacheEnd)
+   {
+      auto&& tail = compute(cacheEnd + 1, end);
+      result.insert(tail.begin(), tail.end());
+   }
+
+   return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LedgerCache::truncate(const string& walletID, uint32_t height)
+{
+   if (db_ == nullptr || bc_ == nullptr)
+      return;
+
+   unique_lock<mutex> lock(mu_);
+   setWalletID(walletID);
+
+   unique_lock<mutex> walletLock(*walletMu_);
+   auto meta = loadMeta(walletID);
+   if (meta.ranges_.empty())
+      return;
+
+   //no tip check, the tip is above the branch point on a reorg, putMeta
+   //anchors the capped ranges to the new chain
+   auto&& tx = db_->beginTransaction(HISTORY, LMDB::ReadWrite);
+   eraseLedgers(height);
+   meta.capRanges(height);
+   putMeta(walletID, meta);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned LedgerCache::collectGarbage(LMDBBlockDatabase* db, uint64_t expiry)
+{
+   if (db == nullptr)
+      return 0;
+
+   BinaryData metaPrefix(1);
+   metaPrefix.getPtr()[0] = DB_PREFIX_LEDGERMETA;
+   uint64_t now = time(0);
+
+   //find the expired caches
+   vector<string> expired;
+   {
+      auto&& tx = db->beginTransaction(HISTORY, LMDB::ReadOnly);
+      auto dbIter = db->getIterator(HISTORY);
+      if (dbIter->seekToStartsWith(metaPrefix.getRef()))
+      {
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(metaPrefix.getRef()))
+               break;
+
+            Meta meta;
+            try
+            {
+               meta.unserialize(dbIter->getValueRef());
+               if (meta.lastUsed_ + expiry >= now)
+                  continue;
+            }
+            catch (exception&)
+            {}
+
+            auto walletID = key.getSliceRef(1, key.getSize() - 1);
+            expired.emplace_back(walletID.toCharPtr(), walletID.getSize());
+         }
+         while (dbIter->advanceAndRead());
+      }
+   }
+
+   //keep loaded wallets from reading a meta that is going away
+   vector<shared_ptr<mutex>> mutexes;
+   vector<unique_lock<mutex>> locks;
+   for (auto& walletID : expired)
+   {
+      mutexes.emplace_back(getWalletMutex(walletID));
+      locks.emplace_back(*mutexes.back());
+   }
+
+   auto&& tx = db->beginTransaction(HISTORY, LMDB::ReadWrite);
+
+   //drop expired metas, collect the live cache ids
+   unsigned count = 0;
+   set<BinaryData> expiredSet;
+   for (auto& walletID : expired)
+      expiredSet.emplace(getMetaKey(walletID));
+
+   set<BinaryData> live;
+   vector<BinaryData> deadMetas;
+   {
+      auto dbIter = db->getIterator(HISTORY);
+      if (dbIter->seekToStartsWith(metaPrefix.getRef()))
+      {
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(metaPrefix.getRef()))
+               break;
+
+            Meta meta;
+            bool valid = false;
+            try
+            {
+               meta.unserialize(dbIter->getValueRef());
+               valid = true;
+            }
+            catch (exception&)
+            {}
+
+            bool isExpired = expiredSet.find(key) != expiredSet.end() &&
+               (!valid || meta.lastUsed_ + expiry < now);
+
+            if (!isExpired && valid)
+               live.insert(meta.cacheId_);
+            else if (isExpired)
+               deadMetas.emplace_back(key);
+         }
+         while (dbIter->advanceAndRead());
+      }
+   }
+
+   for (auto& key : deadMetas)
+   {
+      db->deleteValue(HISTORY, key.getRef());
+      ++count;
+   }
+
+   //sweep ledgers and address sets that have no live meta
+   auto sweep = [db, &live](DB_PREFIX prefix)->void
+   {
+      BinaryData prefixKey(1);
+      prefixKey.getPtr()[0] = prefix;
+
+      vector<BinaryData> keys;
+      {
+         auto dbIter = db->getIterator(HISTORY);
+         if (!dbIter->seekToStartsWith(prefixKey.getRef()))
+            return;
+
+         do
+         {
+            auto key = dbIter->getKeyRef();
+            if (!key.startsWith(prefixKey.getRef()))
+               break;
+
+            if (key.getSize() >= 1 + LEDGERCACHE_ID_LENGTH)
+            {
+               BinaryData cacheId(key.getSliceRef(1, LEDGERCACHE_ID_LENGTH));
+               if (live.find(cacheId) != live.end())
+               {
+                  //skip past this cache
+                  BinaryData nextKey(key.getSliceRef(
+                     0, 1 + LEDGERCACHE_ID_LENGTH));
+                  unsigned i = nextKey.getSize() - 1;
+                  while (i > 0 && ++nextKey.getPtr()[i] == 0)
+                     --i;
+
+                  if (i == 0 || !dbIter->seekTo(nextKey.getRef()))
+                     break;
+                  continue;
+               }
+            }
+
+            keys.emplace_back(key);
+            if (!dbIter->advanceAndRead())
+               break;
+         }
+         while (true);
+      }
+
+      for (auto& key : keys)
+         db->deleteValue(HISTORY, key.getRef());
+   };
+
+   sweep(DB_PREFIX_LEDGER);
+   sweep(DB_PREFIX_LEDGERADDRS);
+
+   return count;
+}
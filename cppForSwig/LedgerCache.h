@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016-2021, goatpig                                          //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+#ifndef _LEDGER_CACHE_H
+#define _LEDGER_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+#include "BinaryData.h"
+#include "LedgerEntry.h"
+#include "ScrAddrObj.h"
+#include "DBUtils.h"
+
+#define LEDGERCACHE_VERSION 2
+
+#ifndef UNIT_TESTS
+#define LEDGERCACHE_MAX_DB_SIZE (3 * 1024 * 1024 * 1024ULL)
+#else
+#define LEDGERCACHE_MAX_DB_SIZE (64 * 1024 * 1024ULL)
+#endif
+
+//caches of wallets that weren't loaded for that long are dropped
+#define LEDGERCACHE_EXPIRY (30 * 24 * 3600ULL)
+
+class LMDBBlockDatabase;
+class Blockchain;
+
+typedef std::map<BinaryDataRef, std::shared_ptr<ScrAddrObj>> WalletAddrMap;
+
+////////////////////////////////////////////////////////////////////////////////
+class LedgerCache
+{
+   /***
+   Materialized wallet ledgers, persisted in the HISTORY db.
+
+   Entries are keyed by cache id | hgtx | txIndex, the cache id is derived
+   from the wallet id alone. A meta entry per wallet id carries the height
+   ranges that have been materialized, the hash of the highest cached block,
+   a digest of the address set the ledgers were computed for and the last
+   time the cache was used. The address set itself is kept under its own
+   prefix, one key per address.
+
+   Ledgers are computed once per height range, on the first page that
+   covers it, and read back from the db afterwards. Only heights up to
+   the last block the wallet was notified of are cached, zc and anything
+   above that are always computed. Reorgs truncate the cache at the
+   branch point. A cached tip that fell off the main chain while the
+   wallet was not loaded drops the whole cache.
+
+   New addresses truncate the cache from the lowest height they have
+   history at, addresses without history leave it untouched. Removed
+   addresses drop the whole cache.
+
+   Several BDVs may load the same wallet id, the meta is read, updated and
+   written back under a process wide lock per wallet id. No ledgers are
+   written once the HISTORY db grows past LEDGERCACHE_MAX_DB_SIZE.
+   collectGarbage drops caches that weren't used within the expiry window,
+   along with orphaned entries.
+   ***/
+
+public:
+   struct Meta
+   {
+      BinaryData cacheId_;
+      uint32_t tipHeight_ = UINT32_MAX;
+      BinaryData tipHash_;
+      BinaryData addrDigest_;
+      uint64_t lastUsed_ = 0;
+
+      //start -> end, inclusive
+      std::map<uint32_t, uint32_t> ranges_;
+
+      BinaryData serialize(void) const;
+      void unserialize(BinaryDataRef);
+
+      void addRange(uint32_t start, uint32_t end);
+      void capRanges(uint32_t height);
+   };
+
+   typedef std::function<std::map<BinaryData, LedgerEntry>(
+      uint32_t, uint32_t)> ComputeLedgers;
+
+private:
+   LMDBBlockDatabase* const db_;
+   const Blockchain* const bc_;
+
+   std::mutex mu_;
+   std::shared_ptr<const WalletAddrMap> addrMapSnapshot_;
+   BinaryData addrDigest_;
+   BinaryData cacheId_;
+   std::shared_ptr<std::mutex> walletMu_;
+
+   std::atomic<uint32_t> top_ = { UINT32_MAX };
+
+private:
+   static std::shared_ptr<std::mutex> getWalletMutex(const std::string&);
+   void setWalletID(const std::string&);
+
+   static BinaryData getMetaKey(const std::string& walletID);
+   static BinaryData getCachePrefix(DB_PREFIX, const BinaryData& cacheId);
+   BinaryData getLedgerKey(uint32_t height) const;
+
+   Meta loadMeta(const std::string& walletID);
+   void putMeta(const std::string& walletID, Meta&);
+   bool isTipOnChain(const Meta&) const;
+
+   void syncAddresses(const std::string& walletID, Meta&);
+   void eraseLedgers(uint32_t fromHeight);
+   static void erasePrefix(LMDBBlockDatabase*, BinaryDataRef prefix);
+
+   void readLedgers(uint32_t start, uint32_t end, const std::string& walletID,
+      std::map<BinaryData, LedgerEntry>&) const;
+   void writeLedgers(const std::map<BinaryData, LedgerEntry>&, uint32_t end);
+
+public:
+   LedgerCache(LMDBBlockDatabase* db, const Blockchain* bc) :
+      db_(db), bc_(bc)
+   {}
+
+   //highest height ledgers can be cached for
+   void setTop(uint32_t height)
+   { top_.store(height, std::memory_order_relaxed); }
+
+   //ledgers for [start, end], computes and stores the uncached ranges
+   std::map<BinaryData, LedgerEntry> getLedgers(
+      const std::string& walletID, std::shared_ptr<const WalletAddrMap>,
+      uint32_t start, uint32_t end, const ComputeLedgers&);
+
+   //drop cached ledgers from height up
+   void truncate(const std::string& walletID, uint32_t height);
+
+   static BinaryData computeCacheId(const std::string& walletID);
+   static BinaryData computeAddrDigest(const WalletAddrMap&);
+
+   //drop caches not used for expiry seconds and entries without a meta,
+   //returns the count of caches dropped
+   static unsigned collectGarbage(LMDBBlockDatabase*, uint64_t expiry);
+};
+
+#endif
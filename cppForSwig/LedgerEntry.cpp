@@ -346,6 +346,69 @@ map<BinaryData, LedgerEntry> LedgerEntry::computeLedgerMap(
    return leMap;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LedgerEntry::serialize() const
+{
+   uint8_t flags = 0;
+   if (isCoinbase_)
+      flags |= 0x01;
+   if (isSentToSelf_)
+      flags |= 0x02;
+   if (isChangeBack_)
+      flags |= 0x04;
+   if (isOptInRBF_)
+      flags |= 0x08;
+   if (usesWitness_)
+      flags |= 0x10;
+   if (isChainedZC_)
+      flags |= 0x20;
+
+   BinaryWriter bw;
+   bw.put_uint64_t((uint64_t)value_);
+   bw.put_uint32_t(blockNum_);
+   bw.put_var_int(txHash_.getSize());
+   bw.put_BinaryData(txHash_);
+   bw.put_uint32_t(index_);
+   bw.put_uint32_t(txTime_);
+   bw.put_uint8_t(flags);
+
+   bw.put_var_int(scrAddrSet_.size());
+   for (auto& scrAddr : scrAddrSet_)
+   {
+      bw.put_var_int(scrAddr.getSize());
+      bw.put_BinaryData(scrAddr);
+   }
+
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LedgerEntry LedgerEntry::unserialize(BinaryDataRef data, const string& ID)
+{
+   BinaryRefReader brr(data);
+
+   auto value = (int64_t)brr.get_uint64_t();
+   auto blockNum = brr.get_uint32_t();
+   auto hashSize = brr.get_var_int();
+   auto txHash = brr.get_BinaryData(hashSize);
+   auto index = brr.get_uint32_t();
+   auto txTime = brr.get_uint32_t();
+   auto flags = brr.get_uint8_t();
+
+   LedgerEntry le(ID, value, blockNum, txHash, index, txTime,
+      (flags & 0x01) != 0, (flags & 0x02) != 0, (flags & 0x04) != 0,
+      (flags & 0x08) != 0, (flags & 0x10) != 0, (flags & 0x20) != 0);
+
+   auto count = brr.get_var_int();
+   for (uint64_t i = 0; i < count; i++)
+   {
+      auto len = brr.get_var_int();
+      le.scrAddrSet_.insert(brr.get_BinaryData(len));
+   }
+
+   return le;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void LedgerEntry::fillMessage(::Codec_LedgerEntry::LedgerEntry* msg) const
 {
@@ -146,6 +146,10 @@ public:
    { return scrAddrSet_; }
 
    void fillMessage(::Codec_LedgerEntry::LedgerEntry* msg) const;
+
+   //db storage, the ID is not carried
+   BinaryData serialize(void) const;
+   static LedgerEntry unserialize(BinaryDataRef, const std::string& ID);
    
 public:
 
@@ -204,16 +208,28 @@ public:
       return getPageCount_();
    }
 
+   //cursor based paging, see HistoryPager::getPageFromCursor
+   std::vector<LedgerEntry> getHistoryFromCursor(
+      BinaryData& token, unsigned count)
+   {
+      if (!getHistoryFromCursor_)
+         throw std::runtime_error("delegate does not support cursor paging");
+      return getHistoryFromCursor_(token, count);
+   }
+
 private:
    LedgerDelegate(
       std::function<std::vector<LedgerEntry>(uint32_t)> getHist,
       std::function<uint32_t(uint32_t)> getBlock,
       std::function<uint32_t(uint32_t)> getPageId,
-      std::function<uint32_t(void)> getPageCount) :
+      std::function<uint32_t(void)> getPageCount,
+      std::function<std::vector<LedgerEntry>(BinaryData&, unsigned)>
+         getFromCursor = nullptr) :
       getHistoryPage_(getHist),
       getBlockInVicinity_(getBlock),
       getPageIdForBlockHeight_(getPageId),
-      getPageCount_(getPageCount)
+      getPageCount_(getPageCount),
+      getHistoryFromCursor_(getFromCursor)
    {}
 
 private:
@@ -221,6 +237,8 @@ private:
    const std::function<uint32_t(uint32_t)>            getBlockInVicinity_;
    const std::function<uint32_t(uint32_t)>            getPageIdForBlockHeight_;
    const std::function<uint32_t(void)>                getPageCount_;
+   const std::function<std::vector<LedgerEntry>(BinaryData&, unsigned)>
+      getHistoryFromCursor_;
 };
 
 #endif
@@ -12,6 +12,8 @@
 #include "BDM_Server.h"
 #include "BIP15x_Handshake.h"
 
+#include <google/protobuf/io/coded_stream.h>
+
 using namespace std;
 using namespace google::protobuf;
 using namespace Armory::Threading;
@@ -115,18 +117,19 @@ int WebSocketServer::callback(
       instance->clients_->unregisterBDV(bdr.toHexStr());
       instance->eraseId(session_data->id_, wsi);
 
-      if (instance->pendingWrites_.empty())
+      auto& service = instance->getServiceThread(wsi);
+      if (service.pendingWrites_.empty())
          break;
 
       //pending write queue iterator is always set entering the 
       //lws callback unless the pending write set is empty
-      if (instance->pendingWritesIter_ != instance->pendingWrites_.end() &&
-         *instance->pendingWritesIter_ == wsi)
+      if (service.pendingWritesIter_ != service.pendingWrites_.end() &&
+         *service.pendingWritesIter_ == wsi)
       {
-         instance->pendingWritesIter_++;
+         service.pendingWritesIter_++;
       }
       
-      instance->pendingWrites_.erase(wsi);
+      service.pendingWrites_.erase(wsi);
       break;
    }
 
@@ -144,14 +147,15 @@ int WebSocketServer::callback(
    case LWS_CALLBACK_SERVER_WRITEABLE:
    {
       auto wsPtr = WebSocketServer::getInstance();
+      auto& service = wsPtr->getServiceThread(wsi);
       
-      if (wsPtr->pendingWrites_.empty() ||
-         wsPtr->pendingWritesIter_ == wsPtr->pendingWrites_.end())
+      if (service.pendingWrites_.empty() ||
+         service.pendingWritesIter_ == service.pendingWrites_.end())
       {
          break;
       }
 
-      if (wsi != *wsPtr->pendingWritesIter_)
+      if (wsi != *service.pendingWritesIter_)
       {
          /*
          Sanity check: skip over lws pollin callbacks that are not 
@@ -161,22 +165,30 @@ int WebSocketServer::callback(
          break;
       }
 
-      auto iter = wsPtr->writeMap_.find(wsi);
-      if (iter == wsPtr->writeMap_.end())
+      auto iter = service.writeMap_.find(wsi);
+      if (iter == service.writeMap_.end())
       {
-         wsPtr->pendingWrites_.erase(wsPtr->pendingWritesIter_++);
+         service.pendingWrites_.erase(service.pendingWritesIter_++);
          LOGWARN << "incrementing over missing wsi write list";
          break;
       }
 
-      if (iter->second.empty())
+      auto& socketWrites = iter->second;
+      if (socketWrites.queue_->isClosed())
       {
-         wsPtr->pendingWrites_.erase(wsPtr->pendingWritesIter_++);
+         //client stopped reading or can't be written to, lws closes the 
+         //socket
+         return -1;
+      }
+
+      if (socketWrites.packets_.empty())
+      {
+         service.pendingWrites_.erase(service.pendingWritesIter_++);
          LOGWARN << "incrementing over empty wsi write list";
          break;
       }
 
-      auto& theList = iter->second.front();
+      auto& theList = socketWrites.packets_.front();
       auto& packet = theList.front();
       auto body = (uint8_t*)packet.getPtr() + LWS_PRE;
 
@@ -191,18 +203,21 @@ int WebSocketServer::callback(
             " bytes, sent " << m << " bytes";
       }
 
+      //lws copies what it can't send right away, recycle the fragment
+      socketWrites.queue_->removeSocketBytes(packet.getSize());
+      FragmentBufferPool::instance().release(move(packet));
       theList.pop_front();
       if (theList.empty())
       {
-         iter->second.pop_front();
-         if (iter->second.empty())
+         socketWrites.packets_.pop_front();
+         if (socketWrites.packets_.empty())
          {
-            wsPtr->pendingWrites_.erase(wsPtr->pendingWritesIter_++);
+            service.pendingWrites_.erase(service.pendingWritesIter_++);
             break;
          }
       }
 
-      ++wsPtr->pendingWritesIter_;
+      ++service.pendingWritesIter_;
       break;
    }
 
@@ -319,7 +334,7 @@ void WebSocketServer::shutdown()
    if (instance->run_.load(memory_order_relaxed) == 0)
       return;
 
-   instance->msgQueue_.terminate();
+   instance->writeReadyQueue_.terminate();
    instance->clientConnectionInterruptQueue_.terminate();
    instance->clients_->shutdown();
    instance->run_.store(0, memory_order_relaxed);
@@ -366,6 +381,27 @@ void WebSocketServer::setIsReady()
    {}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void WebSocketServer::serviceLoop(unsigned tsi)
+{
+   auto& service = *serviceThreads_[tsi];
+   int n = 0;
+
+   try
+   {
+      while (run_.load(memory_order_relaxed) != 0 && n >= 0)
+      {
+         n = lws_service_tsi(contextPtr_, 10000, tsi);
+         updateWriteMap(service);
+      }
+   }
+   catch(exception& e)
+   {
+      LOGERR << "server lws service thread " << tsi << 
+         " choked: " << e.what();
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void WebSocketServer::webSocketService(int port)
 {
@@ -374,7 +410,6 @@ void WebSocketServer::webSocketService(int port)
    const char *iface = nullptr;
    int uid = -1, gid = -1;
    int opts = 0;
-   int n = 0;
 
    memset(&info, 0, sizeof info);
    info.port = port;
@@ -391,27 +426,41 @@ void WebSocketServer::webSocketService(int port)
    //info.ip_limit_ah = 24; /* for testing */
    //info.ip_limit_wsi = 105; /* for testing */
 
+   //lws spreads accepted sockets over its service threads
+   info.count_threads = Armory::Config::NetworkSettings::listenThreads();
+
    contextPtr_ = lws_create_context(&info);
    if (contextPtr_ == nullptr)
       throw LWS_Error("failed to create LWS context");
 
+   //lws caps the thread count to what it was built for (LWS_MAX_SMP)
+   auto threadCount = lws_get_count_threads(contextPtr_);
+   if (threadCount < 1)
+      threadCount = 1;
+   for (int i = 0; i < threadCount; i++)
+   {
+      auto service = make_unique<ServiceThread>();
+      service->pendingWritesIter_ = service->pendingWrites_.begin();
+      serviceThreads_.emplace_back(move(service));
+   }
+
    vhost = lws_create_vhost(contextPtr_, &info);
    if (vhost == nullptr)
       throw LWS_Error("failed to create vhost");
 
-   pendingWritesIter_ = pendingWrites_.begin();
+   LOGINFO << "running " << threadCount << " lws service threads";
    run_.store(1, memory_order_relaxed);
-   try
-   {
-      while (run_.load(memory_order_relaxed) != 0 && n >= 0)
-      {
-         n = lws_service(contextPtr_, 10000);
-         updateWriteMap();
-      }
-   }
-   catch(exception& e)
+
+   //this thread services the first slot
+   vector<thread> serviceThreads;
+   for (int i = 1; i < threadCount; i++)
+      serviceThreads.emplace_back(thread(&WebSocketServer::serviceLoop, this, i));
+   serviceLoop(0);
+
+   for (auto& thr : serviceThreads)
    {
-      LOGERR << "server lws service choked: " << e.what();
+      if (thr.joinable())
+         thr.join();
    }
 
    LOGINFO << "cleaning up lws server";
@@ -511,14 +560,56 @@ void WebSocketServer::clientInterruptThread()
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebSocketServer::write(const uint64_t& id, const uint32_t& msgid,
-   shared_ptr<Message> message)
+   shared_ptr<Message> message, shared_ptr<const BinaryData> serialized)
 {
    if (message == nullptr)
       return;
 
-   auto msg = make_unique<PendingMessage>(id, msgid, message);
    auto instance = getInstance();
-   instance->msgQueue_.push_back(move(msg));
+   auto statemap = instance->getConnectionStateMap();
+   auto stateIter = statemap->find(id);
+   if (stateIter == statemap->end())
+      return;
+
+   auto msg = make_unique<PendingMessage>(id, msgid, message, serialized);
+   auto& writeQueue = stateIter->second.writeQueue_;
+   if (writeQueue->push(move(msg)))
+   {
+      instance->writeReadyQueue_.push_back(uint64_t(id));
+   }
+   else if (writeQueue->isClosed())
+   {
+      instance->closeClientSocket(
+         const_cast<ClientConnection&>(stateIter->second));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+map<uint64_t, WriteQueueStats> WebSocketServer::getWriteQueueStats()
+{
+   map<uint64_t, WriteQueueStats> result;
+   auto instance = getInstance();
+   auto statemap = instance->getConnectionStateMap();
+   for (auto& statePair : *statemap)
+      result.emplace(statePair.first, statePair.second.writeQueue_->getStats());
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<size_t> WebSocketServer::getServiceThreadLoads()
+{
+   auto instance = getInstance();
+   vector<size_t> result(instance->serviceThreads_.size(), 0);
+   auto statemap = instance->getConnectionStateMap();
+   for (auto& statePair : *statemap)
+   {
+      auto serviceThread = statePair.second.serviceThread_;
+      if (serviceThread < result.size())
+         ++result[serviceThread];
+   }
+
+   return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -526,45 +617,36 @@ void WebSocketServer::prepareWriteThread()
 {
    while (true)
    {
-      unique_ptr<PendingMessage> msg;
+      uint64_t clientId;
       try
       {
-         msg = msgQueue_.pop_front();
+         clientId = writeReadyQueue_.pop_front();
       }
       catch (StopBlockingLoop&)
       {
          break;
       }
 
-      if (msg == nullptr)
-         continue;
-
       auto statemap = getConnectionStateMap();
-      auto stateIter = statemap->find(msg->id_);
+      auto stateIter = statemap->find(clientId);
       if (stateIter == statemap->end())
          continue;
       auto statePtr = const_cast<ClientConnection*>(&stateIter->second);
 
-      //grab state object lock
-      unsigned zero = 0;
-      if(!statePtr->writeLock_->compare_exchange_weak(zero, 1))
-      { 
-         msgQueue_.push_back(move(msg));
-         continue;
-      }
-
       if (!statePtr->bip151Connection_->connectionComplete())
       {
          //aead session uninitialized, kill connection
-         return;
+         closeClientSocket(*statePtr);
+         continue;
       }
 
-      //check for rekey
+      auto connPtr = statePtr->bip151Connection_.get();
+      auto checkRekey = [this, statePtr, connPtr](size_t size)->void
       {
          bool needs_rekey = false;
          auto rightnow = chrono::system_clock::now();
 
-         if (statePtr->bip151Connection_->rekeyNeeded(msg->message_->ByteSizeLong()))
+         if (connPtr->rekeyNeeded(size))
          {
             needs_rekey = true;
          }
@@ -575,54 +657,128 @@ void WebSocketServer::prepareWriteThread()
             if (time_sec.count() >= AEAD_REKEY_INVERVAL_SECONDS)
                needs_rekey = true;
          }
-         
-         if (needs_rekey)
-         {
-            //create rekey packet
-            BinaryData rekeyPacket(BIP151PUBKEYSIZE);
-            memset(rekeyPacket.getPtr(), 0, BIP151PUBKEYSIZE);
-            
-            SerializedMessage ws_msg;
-            ws_msg.construct(
-               rekeyPacket.getDataVector(), 
-               statePtr->bip151Connection_.get(),
-               ArmoryAEAD::BIP151_PayloadType::Rekey);
 
-            //push to write map
-            writeToSocket(statePtr->wsiPtr_, ws_msg);
+         if (!needs_rekey)
+            return;
 
-            //rekey outer bip151 channel
-            statePtr->bip151Connection_->rekeyOuterSession();
+         //create rekey packet
+         BinaryData rekeyPacket(BIP151PUBKEYSIZE);
+         memset(rekeyPacket.getPtr(), 0, BIP151PUBKEYSIZE);
 
-            //set outkey timepoint to rightnow
-            statePtr->outKeyTimePoint_ = rightnow;
-         }
-      }
+         SerializedMessage ws_msg;
+         ws_msg.construct(
+            rekeyPacket.getDataVector(), connPtr,
+            ArmoryAEAD::BIP151_PayloadType::Rekey);
+
+         //push to write map
+         writeToSocket(*statePtr, ws_msg);
+
+         //rekey outer bip151 channel
+         connPtr->rekeyOuterSession();
+
+         //set outkey timepoint to rightnow
+         statePtr->outKeyTimePoint_ = rightnow;
+      };
 
-      //serialize arg
-      vector<uint8_t> serializedData;
-      if (msg->message_->ByteSizeLong() > 0)
+      //small messages for clients that support it are packed together
+      bool batching = (statePtr->capabilities_->load(memory_order_relaxed) &
+         BIP15X_CAPABILITY_BATCH) != 0;
+      WebSocketMessageBatch packetBatch;
+
+      auto flushBatch = [this, statePtr, connPtr, &packetBatch, 
+         &checkRekey](void)->void
       {
-         serializedData.resize(msg->message_->ByteSizeLong());
-         auto result = msg->message_->SerializeToArray(
-            &serializedData[0], serializedData.size());
-         if (!result)
+         if (packetBatch.empty())
+            return;
+
+         checkRekey(packetBatch.size());
+         SerializedMessage ws_msg;
+         try
+         {
+            ws_msg.construct(packetBatch, connPtr);
+         }
+         catch (const runtime_error& e)
          {
-            LOGERR << "failed to serialize message";
+            LOGERR << "failed to serialize batch: " << e.what();
             return;
          }
-      }
 
-      SerializedMessage ws_msg;
-      ws_msg.construct(
-         serializedData, statePtr->bip151Connection_.get(),
-         ArmoryAEAD::BIP151_PayloadType::FragmentHeader, msg->msgid_);
+         writeToSocket(*statePtr, ws_msg);
+      };
 
-      //push to write map
-      writeToSocket(statePtr->wsiPtr_, ws_msg);
+      /*
+      This thread owns the client queue until it reschedules it, so 
+      messages are serialized in order. Once the batch is written, the 
+      client goes to the back of the ready queue if it has more pending.
+      */
+      auto&& messages = statePtr->writeQueue_->pop(CLIENT_WRITE_BATCH);
+      bool waited = false;
+      while (!messages.empty())
+      {
+         for (auto& msg : messages)
+         {
+            if (batching && WebSocketMessageBatch::isBatchable(msg->size()))
+            {
+               auto addToBatch = [&packetBatch, &msg](void)->bool
+               {
+                  if (msg->serialized_ != nullptr)
+                     return packetBatch.add(
+                        msg->msgid_, msg->serialized_->getRef());
+                  return packetBatch.add(msg->msgid_, *msg->message_);
+               };
+
+               if (addToBatch())
+                  continue;
+
+               //batch is full
+               flushBatch();
+               if (addToBatch())
+                  continue;
+            }
+
+            //large message, flush pending batch first to preserve order
+            flushBatch();
+            checkRekey(msg->size());
+
+            //serialize straight into the outgoing fragments, shared 
+            //payloads only need to be copied in and encrypted
+            SerializedMessage ws_msg;
+            try
+            {
+               if (msg->serialized_ != nullptr)
+               {
+                  ws_msg.construct(msg->serialized_->getRef(), connPtr,
+                     ArmoryAEAD::BIP151_PayloadType::FragmentHeader,
+                     msg->msgid_);
+               }
+               else
+               {
+                  ws_msg.construct(*msg->message_, connPtr, msg->msgid_);
+               }
+            }
+            catch (const runtime_error& e)
+            {
+               LOGERR << "failed to serialize message: " << e.what();
+               continue;
+            }
+
+            //push to write map
+            writeToSocket(*statePtr, ws_msg);
+         }
+
+         //give a burst of small replies a moment to fill the batch, once
+         if (packetBatch.empty() || waited)
+            break;
 
-      //reset lock
-      statePtr->writeLock_->store(0);
+         waited = true;
+         messages = statePtr->writeQueue_->pop(CLIENT_WRITE_BATCH,
+            chrono::microseconds(CLIENT_BATCH_DELAY_US));
+      }
+
+      flushBatch();
+
+      if (statePtr->writeQueue_->reschedule())
+         writeReadyQueue_.push_back(move(clientId));
    }
 }
 
@@ -648,17 +804,21 @@ shared_ptr<const map<uint64_t, ClientConnection>>
 void WebSocketServer::addId(const uint64_t& id, struct lws* ptr)
 {
    auto&& lbds = getAuthPeerLambda();
-   auto&& write_pair = make_pair(
-      id, ClientConnection(ptr, id, lbds, oneWayAuth_));
+   ClientConnection client(ptr, lws_get_tsi(ptr), id, lbds, oneWayAuth_);
+
+   SocketWrites socketWrites;
+   socketWrites.queue_ = client.writeQueue_;
+   getServiceThread(ptr).writeMap_.emplace(ptr, move(socketWrites));
+
+   auto&& write_pair = make_pair(id, move(client));
    clientStateMap_.insert(move(write_pair));
-   writeMap_.emplace(ptr, list<list<BinaryData>>());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebSocketServer::eraseId(const uint64_t& id, struct lws* ptr)
 {
    clientStateMap_.erase(id);
-   writeMap_.erase(ptr);
+   getServiceThread(ptr).writeMap_.erase(ptr);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -701,31 +861,71 @@ void WebSocketServer::closeClientConnection(uint64_t id)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void WebSocketServer::writeToSocket(struct lws* ptr, SerializedMessage& msg)
+void WebSocketServer::closeClientSocket(ClientConnection& client)
+{
+   /***
+   Closes the write queue, which also unschedules it, and stops processing 
+   the client's commands. An empty packet list gets the service thread to 
+   ask lws for a write callback on the socket, which closes it.
+   ***/
+   if (!client.writeQueue_->close())
+      return;
+
+   client.closeConnection();
+
+   auto&& thePair = make_pair(client.wsiPtr_, list<BinaryData>());
+   serviceThreads_[client.serviceThread_]->writeQueue_.push_back(move(thePair));
+   lws_cancel_service(contextPtr_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebSocketServer::writeToSocket(
+   ClientConnection& client, SerializedMessage& msg)
 {
    list<BinaryData> packetList;
+   size_t size = 0;
    while (!msg.isDone())
+   {
       packetList.emplace_back(move(msg.consumeNextPacket()));
+      size += packetList.back().getSize();
+   }
+
+   //released by the lws write callback
+   client.writeQueue_->addSocketBytes(size);
 
-   auto&& thePair = make_pair(ptr, move(packetList));
-   writeQueue_.push_back(move(thePair));
+   auto&& thePair = make_pair(client.wsiPtr_, move(packetList));
+   serviceThreads_[client.serviceThread_]->writeQueue_.push_back(move(thePair));
+
+   //wakes up all service threads, the others have nothing to flush and 
+   //go back to sleep
    lws_cancel_service(contextPtr_);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void WebSocketServer::updateWriteMap()
+WebSocketServer::ServiceThread& WebSocketServer::getServiceThread(
+   struct lws* wsi)
+{
+   auto tsi = lws_get_tsi(wsi);
+   if (tsi < 0 || tsi >= (int)serviceThreads_.size())
+      throw LWS_Error("invalid service thread index");
+
+   return *serviceThreads_[tsi];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebSocketServer::updateWriteMap(ServiceThread& service)
 {
    try 
    {
       while (true)
       {
-         auto&& packetList = writeQueue_.pop_front();
-         auto iter = writeMap_.find(packetList.first);
-         if (iter == writeMap_.end())
+         auto&& packetList = service.writeQueue_.pop_front();
+         auto iter = service.writeMap_.find(packetList.first);
+         if (iter == service.writeMap_.end())
             continue;
 
-         iter->second.emplace_back(move(packetList.second));
-         pendingWrites_.insert(packetList.first);
+         iter->second.packets_.emplace_back(move(packetList.second));
+         service.pendingWrites_.insert(packetList.first);
          break;
       }
    }
@@ -733,13 +933,13 @@ void WebSocketServer::updateWriteMap()
    {}
 
    //round robin write activation
-   if (pendingWrites_.empty())
+   if (service.pendingWrites_.empty())
       return;
 
-   if (pendingWritesIter_ == pendingWrites_.end())
-      pendingWritesIter_ = pendingWrites_.begin();
+   if (service.pendingWritesIter_ == service.pendingWrites_.end())
+      service.pendingWritesIter_ = service.pendingWrites_.begin();
 
-   lws_callback_on_writable(*pendingWritesIter_);
+   lws_callback_on_writable(*service.pendingWritesIter_);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -748,17 +948,21 @@ void WebSocketServer::updateWriteMap()
 //
 ///////////////////////////////////////////////////////////////////////////////
 ClientConnection::ClientConnection(
-   struct lws *wsi, uint64_t id, AuthPeersLambdas& lbds, bool isOneWayAuth) :
-   wsiPtr_(wsi), id_(id)
+   struct lws *wsi, unsigned serviceThread, uint64_t id, 
+   AuthPeersLambdas& lbds, bool isOneWayAuth) :
+   wsiPtr_(wsi), serviceThread_(serviceThread), id_(id)
 {
    bip151Connection_ = std::make_shared<BIP151Connection>(lbds, isOneWayAuth);
 
-   writeLock_ = std::make_shared<std::atomic<unsigned>>();
-   writeLock_->store(0);
+   writeQueue_ = std::make_shared<ClientWriteQueue>(
+      size_t(Armory::Config::NetworkSettings::clientWriteLimit()) * 1024 * 1024);
 
    readLock_ = std::make_shared<std::atomic<unsigned>>();
    readLock_->store(0);
 
+   capabilities_ = std::make_shared<std::atomic<uint32_t>>();
+   capabilities_->store(0, std::memory_order_relaxed);
+
    readQueue_ = std::make_shared<Queue<BinaryData>>();
 
    run_ = std::make_shared<std::atomic<int>>();
@@ -927,7 +1131,7 @@ void ClientConnection::processAEADHandshake(BinaryData msg)
       aeadMsg.construct(msg, connPtr, type);
 
       auto instance = WebSocketServer::getInstance();
-      instance->writeToSocket(wsiPtr_, aeadMsg);
+      instance->writeToSocket(*this, aeadMsg);
    };
 
    auto processHandshake = [this, &writeToClient](const BinaryData& msgdata)->bool
@@ -962,6 +1166,19 @@ void ClientConnection::processAEADHandshake(BinaryData msg)
          break;
       }
 
+      case ArmoryAEAD::BIP151_PayloadType::Capabilities:
+      {
+         //client answer to our announce, only valid once authenticated
+         if (bip151Connection_->getBIP150State() != BIP150State::SUCCESS)
+            return false;
+
+         auto capabilities = 
+            ArmoryAEAD::BIP15x_Handshake::deserializeCapabilities(dataBdr);
+         capabilities_->store(
+            capabilities & BIP15X_CAPABILITIES, memory_order_relaxed);
+         return true;
+      }
+
       default:
          break;
       }
@@ -979,6 +1196,14 @@ void ClientConnection::processAEADHandshake(BinaryData msg)
       case ArmoryAEAD::HandshakeState::Completed:
       {
          outKeyTimePoint_ = chrono::system_clock::now();
+
+         //announce optional features, clients that don't know about them
+         //drop the packet
+         writeToClient(
+            ArmoryAEAD::BIP15x_Handshake::serializeCapabilities(
+               BIP15X_CAPABILITIES),
+            ArmoryAEAD::BIP151_PayloadType::Capabilities,
+            true);
          return true;
       }
 
@@ -995,4 +1220,290 @@ void ClientConnection::processAEADHandshake(BinaryData msg)
 void ClientConnection::closeConnection()
 {
    run_->store(-1, memory_order_relaxed);
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ClientWriteQueue
+//
+///////////////////////////////////////////////////////////////////////////////
+bool ClientWriteQueue::applyBackpressure(unique_ptr<PendingMessage>& msg)
+{
+   /***
+   Only callbacks are bulk traffic, replies are waited on by the client.
+   Returns false if the message was entirely absorbed (coalesced or dropped).
+   ***/
+   if (msg->msgid_ != WEBSOCKET_CALLBACK_ID)
+      return true;
+
+   auto callback = dynamic_pointer_cast<
+      ::Codec_BDVCommand::BDVCallback>(msg->message_);
+   if (callback == nullptr)
+      return true;
+
+   auto isTransient = [](const ::Codec_BDVCommand::Notification& notif)->bool
+   {
+      switch (notif.type())
+      {
+      case ::Codec_BDVCommand::progress:
+      case ::Codec_BDVCommand::nodestatus:
+         return true;
+
+      default:
+         return false;
+      }
+   };
+
+   //size of a notification within its callback: tag, length, payload
+   auto wireSize = [](const ::Codec_BDVCommand::Notification& notif)->size_t
+   {
+      auto len = notif.ByteSizeLong();
+      return 1 + ::google::protobuf::io::CodedOutputStream::VarintSize64(len) 
+         + len;
+   };
+
+   //coalesce with the last queued callback if it is still pending
+   if (!messages_.empty() && messages_.back()->msgid_ == WEBSOCKET_CALLBACK_ID)
+   {
+      auto last = messages_.back().get();
+      auto lastCallback = dynamic_pointer_cast<
+         ::Codec_BDVCommand::BDVCallback>(last->message_);
+
+      if (mergeTarget_ != last && lastCallback != nullptr)
+      {
+         //the first merge copies the callback, notification objects may be 
+         //shared between clients. The copy is this queue's own from there on
+         releaseMergeTarget();
+
+         auto merged = make_shared<::Codec_BDVCommand::BDVCallback>();
+         for (auto& notif : lastCallback->notification())
+         {
+            if (isTransient(notif))
+            {
+               transients_[notif.type()] = 
+                  make_shared<::Codec_BDVCommand::Notification>(notif);
+               continue;
+            }
+
+            *merged->add_notification() = notif;
+         }
+
+         last->message_ = merged;
+         last->serialized_.reset();
+         mergeTarget_ = last;
+      }
+   }
+
+   if (!messages_.empty() && mergeTarget_ == messages_.back().get())
+   {
+      //transient notifications are superseded by the most recent one of 
+      //their type, the older ones are dropped
+      auto last = mergeTarget_;
+      auto merged = static_cast<::Codec_BDVCommand::BDVCallback*>(
+         last->message_.get());
+
+      for (auto& notif : callback->notification())
+      {
+         auto size = wireSize(notif);
+         if (isTransient(notif))
+         {
+            auto& transient = transients_[notif.type()];
+            if (transient != nullptr)
+            {
+               auto olderSize = wireSize(*transient);
+               queuedBytes_ -= min(olderSize, queuedBytes_);
+               last->queuedSize_ -= min(olderSize, last->queuedSize_);
+            }
+
+            transient = make_shared<::Codec_BDVCommand::Notification>(notif);
+         }
+         else
+         {
+            *merged->add_notification() = notif;
+         }
+
+         queuedBytes_ += size;
+         last->queuedSize_ += size;
+      }
+
+      ++coalesced_;
+      return false;
+   }
+
+   //nothing to coalesce with, strip transient notifications
+   auto stripped = make_shared<::Codec_BDVCommand::BDVCallback>();
+   for (auto& notif : callback->notification())
+   {
+      if (isTransient(notif))
+         continue;
+      *stripped->add_notification() = notif;
+   }
+
+   if (stripped->notification_size() == callback->notification_size())
+      return true;
+
+   ++dropped_;
+   if (stripped->notification_size() == 0)
+      return false;
+
+   msg->message_ = stripped;
+   msg->serialized_.reset();
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ClientWriteQueue::push(unique_ptr<PendingMessage> msg)
+{
+   unique_lock<mutex> lock(mu_);
+   if (isClosed())
+      return false;
+
+   auto pending = queuedBytes_ + socketBytes_.load(memory_order_relaxed);
+   if (pending > hardLimit_)
+   {
+      LOGWARN << "client write queue over hard limit (" << pending <<
+         " bytes pending), closing connection";
+      closed_.store(true, memory_order_relaxed);
+      clear();
+      cv_.notify_all();
+      return false;
+   }
+
+   if (pending > limit_)
+   {
+      if (!overLimit_)
+      {
+         LOGWARN << "client write queue over limit (" << pending <<
+            " bytes pending), throttling notifications";
+         overLimit_ = true;
+      }
+
+      if (!applyBackpressure(msg))
+         return false;
+   }
+   else
+   {
+      overLimit_ = false;
+   }
+
+   msg->queuedSize_ = msg->size();
+   queuedBytes_ += msg->queuedSize_;
+   messages_.emplace_back(move(msg));
+   cv_.notify_all();
+
+   if (scheduled_)
+      return false;
+
+   scheduled_ = true;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<unique_ptr<PendingMessage>> ClientWriteQueue::pop(unsigned count)
+{
+   vector<unique_ptr<PendingMessage>> result;
+   unique_lock<mutex> lock(mu_);
+   while (!messages_.empty() && result.size() < count)
+   {
+      auto& msg = messages_.front();
+      queuedBytes_ -= min(msg->queuedSize_, queuedBytes_);
+      if (msg.get() == mergeTarget_)
+         releaseMergeTarget();
+
+      result.emplace_back(move(msg));
+      messages_.pop_front();
+   }
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<unique_ptr<PendingMessage>> ClientWriteQueue::pop(
+   unsigned count, chrono::microseconds timeout)
+{
+   {
+      unique_lock<mutex> lock(mu_);
+      if (messages_.empty())
+      {
+         cv_.wait_for(lock, timeout, 
+            [this](void)->bool { return !messages_.empty() || isClosed(); });
+      }
+   }
+
+   return pop(count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ClientWriteQueue::reschedule()
+{
+   unique_lock<mutex> lock(mu_);
+   if (!messages_.empty())
+      return true;
+
+   scheduled_ = false;
+   return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ClientWriteQueue::releaseMergeTarget()
+{
+   //the callback leaves the queue or stops being merged into, its latest 
+   //transient notifications go at its end
+   if (mergeTarget_ != nullptr)
+   {
+      auto merged = static_cast<::Codec_BDVCommand::BDVCallback*>(
+         mergeTarget_->message_.get());
+      for (auto& transient : transients_)
+         *merged->add_notification() = *transient.second;
+   }
+
+   mergeTarget_ = nullptr;
+   transients_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ClientWriteQueue::clear()
+{
+   messages_.clear();
+   queuedBytes_ = 0;
+   mergeTarget_ = nullptr;
+   transients_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ClientWriteQueue::close()
+{
+   unique_lock<mutex> lock(mu_);
+   if (closed_.exchange(true, memory_order_relaxed))
+      return false;
+
+   clear();
+   cv_.notify_all();
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ClientWriteQueue::addSocketBytes(size_t size)
+{
+   socketBytes_.fetch_add(size, memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ClientWriteQueue::removeSocketBytes(size_t size)
+{
+   socketBytes_.fetch_sub(size, memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WriteQueueStats ClientWriteQueue::getStats() const
+{
+   WriteQueueStats stats;
+
+   unique_lock<mutex> lock(mu_);
+   stats.messages_ = messages_.size();
+   stats.bytes_ = queuedBytes_ + socketBytes_.load(memory_order_relaxed);
+   stats.dropped_ = dropped_;
+   stats.coalesced_ = coalesced_;
+
+   return stats;
+}
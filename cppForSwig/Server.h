@@ -14,6 +14,9 @@
 #include <memory>
 #include <atomic>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 #include "WebSocketMessage.h"
 #include "libwebsockets.h"
@@ -31,9 +34,25 @@
 
 #define SERVER_AUTH_PEER_FILENAME "server.peers"
 
+//messages a write thread serializes for a client before moving on
+#define CLIENT_WRITE_BATCH 8
+
+//how long a write thread holds a partial batch packet open for more small
+//replies to come in, in microseconds
+#define CLIENT_BATCH_DELAY_US 200
+
+//a client with this many times its write limit pending isn't reading, past
+//that its connection is closed
+#define CLIENT_WRITE_HARD_LIMIT_FACTOR 4
+
 class Clients;
 class BlockDataManagerThread;
 
+namespace Codec_BDVCommand
+{
+   class Notification;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 struct per_session_data__http {
    lws_fop_fd_t fop_fd;
@@ -75,10 +94,111 @@ struct PendingMessage
    const uint32_t msgid_;
    std::shared_ptr <::google::protobuf::Message> message_;
 
+   //message_ serialized ahead of time, shared between clients, only
+   //encryption is left to do per connection
+   std::shared_ptr<const BinaryData> serialized_;
+
+   //bytes accounted for this message in its client queue
+   size_t queuedSize_ = 0;
+
    PendingMessage(uint64_t id, uint32_t msgid, 
-      std::shared_ptr<::google::protobuf::Message> msg) :
-      id_(id), msgid_(msgid), message_(msg)
+      std::shared_ptr<::google::protobuf::Message> msg,
+      std::shared_ptr<const BinaryData> serialized = nullptr) :
+      id_(id), msgid_(msgid), message_(msg), serialized_(serialized)
    {}
+
+   size_t size(void) const
+   {
+      if (serialized_ != nullptr)
+         return serialized_->getSize();
+      return message_->ByteSizeLong();
+   }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct WriteQueueStats
+{
+   size_t messages_ = 0;
+   size_t bytes_ = 0;
+   size_t dropped_ = 0;
+   size_t coalesced_ = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class ClientWriteQueue
+{
+   /***
+   Ordered outbound queue of a client connection.
+
+   A queue is scheduled on the server's write threads as a whole: push()
+   reports when the queue needs to be scheduled, the thread that pops it
+   keeps it until reschedule() says it's empty. This keeps replies in order
+   without locking the connection, and threads move on to other clients 
+   after CLIENT_WRITE_BATCH messages.
+
+   Pending bytes cover both messages waiting to be serialized and packets
+   waiting on the socket. Past the limit, callbacks are coalesced into the 
+   last queued callback and superseded progress/node status notifications
+   are dropped. Replies are never dropped. Past the hard limit the client
+   isn't reading at all: the queue closes, drops everything it holds and
+   the server closes the connection.
+   ***/
+
+private:
+   mutable std::mutex mu_;
+   std::condition_variable cv_;
+   std::deque<std::unique_ptr<PendingMessage>> messages_;
+   bool scheduled_ = false;
+   bool overLimit_ = false;
+   std::atomic<bool> closed_ = { false };
+
+   const size_t limit_;
+   const size_t hardLimit_;
+   size_t queuedBytes_ = 0;
+   std::atomic<size_t> socketBytes_ = { 0 };
+
+   size_t dropped_ = 0;
+   size_t coalesced_ = 0;
+
+   //last queued callback once it's this queue's own copy, callbacks are 
+   //merged into it in place. Its transient notifications are held by type
+   //and appended when it's popped.
+   PendingMessage* mergeTarget_ = nullptr;
+   std::map<int, std::shared_ptr<::Codec_BDVCommand::Notification>> 
+      transients_;
+
+private:
+   bool applyBackpressure(std::unique_ptr<PendingMessage>&);
+   void releaseMergeTarget(void);
+   void clear(void);
+
+public:
+   ClientWriteQueue(size_t limit) :
+      limit_(limit), hardLimit_(limit * CLIENT_WRITE_HARD_LIMIT_FACTOR)
+   {}
+
+   //returns true if the caller has to schedule the queue
+   bool push(std::unique_ptr<PendingMessage>);
+   std::vector<std::unique_ptr<PendingMessage>> pop(unsigned);
+
+   //waits up to the timeout for a message if the queue is empty, only for 
+   //the thread the queue is scheduled on
+   std::vector<std::unique_ptr<PendingMessage>> pop(
+      unsigned, std::chrono::microseconds);
+
+   //returns false and unschedules the queue if it is empty
+   bool reschedule(void);
+
+   void addSocketBytes(size_t);
+   void removeSocketBytes(size_t);
+
+   //drops pending messages and refuses new ones, the connection is to be
+   //closed. Returns false if the queue was closed already
+   bool close(void);
+   bool isClosed(void) const 
+   { return closed_.load(std::memory_order_relaxed); }
+
+   WriteQueueStats getStats(void) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -87,13 +207,20 @@ struct ClientConnection
 public:
    struct lws *wsiPtr_ = nullptr;
 
+   //lws service thread the socket is pinned to
+   const unsigned serviceThread_;
+
 private:
    const uint64_t id_;
    BinaryData readLeftOverData_;
 
 public:
    std::shared_ptr<BIP151Connection> bip151Connection_;
-   std::shared_ptr<std::atomic<unsigned>> writeLock_, readLock_;
+   std::shared_ptr<std::atomic<unsigned>> readLock_;
+   std::shared_ptr<ClientWriteQueue> writeQueue_;
+
+   //BIP15X_CAPABILITY flags the client accepted
+   std::shared_ptr<std::atomic<uint32_t>> capabilities_;
    std::chrono::time_point<std::chrono::system_clock> outKeyTimePoint_;
    std::shared_ptr<std::atomic<int>> run_;
 
@@ -103,7 +230,7 @@ private:
    void processAEADHandshake(BinaryData);
 
 public:
-   ClientConnection(struct lws*, uint64_t, AuthPeersLambdas&, bool);
+   ClientConnection(struct lws*, unsigned, uint64_t, AuthPeersLambdas&, bool);
 
    void closeConnection(void);
    void processReadQueue(std::shared_ptr<Clients>);
@@ -127,25 +254,47 @@ private:
    std::atomic<unsigned> run_;
    std::promise<bool> isReadyProm_;
 
-   Armory::Threading::BlockingQueue<std::unique_ptr<PendingMessage>> msgQueue_;
+   //ids of clients with pending messages, see ClientWriteQueue
+   Armory::Threading::BlockingQueue<uint64_t> writeReadyQueue_;
    Armory::Threading::BlockingQueue<uint64_t> clientConnectionInterruptQueue_;
 
    std::shared_ptr<Armory::Wallets::AuthorizedPeers> authorizedPeers_;
-   std::map<struct lws*, std::list<std::list<BinaryData>>> writeMap_;
    lws_context* contextPtr_;
-   Armory::Threading::Queue<std::pair<struct lws*, std::list<BinaryData>>> writeQueue_;
 
-   std::set<struct lws*> pendingWrites_;
-   std::set<struct lws*>::const_iterator pendingWritesIter_;
+   struct SocketWrites
+   {
+      std::shared_ptr<ClientWriteQueue> queue_;
+      std::list<std::list<BinaryData>> packets_;
+   };
+
+   struct ServiceThread
+   {
+      /***
+      State of a lws service thread. lws pins each socket to the thread 
+      that accepted it, all callbacks for that socket run on it. Only
+      writeQueue_ is fed from other threads.
+      ***/
+
+      std::map<struct lws*, SocketWrites> writeMap_;
+      Armory::Threading::Queue<
+         std::pair<struct lws*, std::list<BinaryData>>> writeQueue_;
+
+      std::set<struct lws*> pendingWrites_;
+      std::set<struct lws*>::const_iterator pendingWritesIter_;
+   };
+
+   //sized once the lws context is up, not resized afterwards
+   std::vector<std::unique_ptr<ServiceThread>> serviceThreads_;
    
    //default to 2-way auth
    bool oneWayAuth_ = false;
 
 public:
-   void writeToSocket(struct lws*, SerializedMessage&);
+   void writeToSocket(ClientConnection&, SerializedMessage&);
 
 private:
    void webSocketService(int port);
+   void serviceLoop(unsigned);
    void commandThread(void);
    void setIsReady(void);
 
@@ -153,9 +302,11 @@ private:
 
    AuthPeersLambdas getAuthPeerLambda(void) const;
    void closeClientConnection(uint64_t);
+   void closeClientSocket(ClientConnection&);
    void clientInterruptThread(void);
 
-   void updateWriteMap(void);
+   void updateWriteMap(ServiceThread&);
+   ServiceThread& getServiceThread(struct lws*);
 
 public:
    WebSocketServer(void);
@@ -172,7 +323,12 @@ public:
    static SecureBinaryData getPublicKey(void);
 
    static void write(const uint64_t&, const uint32_t&,
-      std::shared_ptr<::google::protobuf::Message>);
+      std::shared_ptr<::google::protobuf::Message>,
+      std::shared_ptr<const BinaryData> serialized = nullptr);
+   static std::map<uint64_t, WriteQueueStats> getWriteQueueStats(void);
+
+   //connected clients per lws service thread
+   static std::vector<size_t> getServiceThreadLoads(void);
 
    std::shared_ptr<const std::map<uint64_t, ClientConnection>>
       getConnectionStateMap(void) const;
@@ -43,4 +43,12 @@ public:
 
 };
 
+//the peer stopped responding, as opposed to closing the connection
+struct SocketTimeout : public SocketError
+{
+public:
+   SocketTimeout(const std::string& e) : SocketError(e)
+   {}
+};
+
 #endif
@@ -833,14 +833,22 @@ vector<uint8_t> SimpleSocket::readFromSocket(void)
    pfd.fd = sockfd_;
    pfd.events = POLLIN;
 
-   int timeout = 100;
+   //a peer that stops responding without closing would keep us here 
+   //forever, give up once SOCKET_READ_TIMEOUT_MS have passed without data
+   auto deadline = chrono::steady_clock::now() + 
+      chrono::milliseconds(SOCKET_READ_TIMEOUT_MS);
 
    while (1)
    {
+      auto timeLeft = chrono::duration_cast<chrono::milliseconds>(
+         deadline - chrono::steady_clock::now()).count();
+      if (timeLeft <= 0)
+         throw SocketTimeout("socket read timed out");
+
 #ifdef _WIN32
-      auto status = WSAPoll(&pfd, 1, timeout);
+      auto status = WSAPoll(&pfd, 1, (int)min<int64_t>(timeLeft, 100));
 #else
-      auto status = poll(&pfd, 1, timeout);
+      auto status = poll(&pfd, 1, (int)min<int64_t>(timeLeft, 100));
 #endif
 
       if (status == 0)
@@ -932,7 +940,84 @@ vector<uint8_t> SimpleSocket::readFromSocket(void)
 ///////////////////////////////////////////////////////////////////////////////
 int SimpleSocket::writeToSocket(vector<uint8_t>& payload)
 {
-   return send(sockfd_, (char*)&payload[0], payload.size(), 0);
+   //a peer closing a kept alive socket should fail the write, not raise 
+   //SIGPIPE
+#ifdef MSG_NOSIGNAL
+   int flags = MSG_NOSIGNAL;
+#else
+   int flags = 0;
+#endif
+
+   //the socket is non blocking, loop over partial writes. A peer that stops
+   //reading without closing would keep us here forever, so give up once 
+   //SOCKET_WRITE_TIMEOUT_MS have passed without the payload going through
+   auto deadline = chrono::steady_clock::now() + 
+      chrono::milliseconds(SOCKET_WRITE_TIMEOUT_MS);
+
+   size_t total = 0;
+   while (total < payload.size())
+   {
+      auto sent = send(sockfd_, (char*)&payload[0] + total, 
+         payload.size() - total, flags);
+
+      if (sent < 0)
+      {
+#ifdef _WIN32
+         auto errornum = WSAGetLastError();
+         if (errornum != WSAEWOULDBLOCK)
+#else
+         auto errornum = errno;
+         if (errornum != EAGAIN && errornum != EWOULDBLOCK && 
+            errornum != EINTR)
+#endif
+         {
+            LOGERR << "send error: " << errornum;
+            return -1;
+         }
+
+         auto timeLeft = chrono::duration_cast<chrono::milliseconds>(
+            deadline - chrono::steady_clock::now()).count();
+         if (timeLeft <= 0)
+         {
+            LOGERR << "socket write timed out";
+            return -1;
+         }
+
+         struct pollfd pfd;
+         pfd.fd = sockfd_;
+         pfd.events = POLLOUT;
+         pfd.revents = 0;
+#ifdef _WIN32
+         auto status = WSAPoll(&pfd, 1, (int)min<int64_t>(timeLeft, 100));
+#else
+         auto status = poll(&pfd, 1, (int)min<int64_t>(timeLeft, 100));
+#endif
+         if (status < 0)
+         {
+#ifdef _WIN32
+            LOGERR << "poll error: " << WSAGetLastError();
+            return -1;
+#else
+            if (errno != EINTR)
+            {
+               LOGERR << "poll error: " << errno;
+               return -1;
+            }
+#endif
+         }
+         else if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+         {
+            //the peer is gone, don't wait for the timeout
+            return -1;
+         }
+
+         continue;
+      }
+
+      total += sent;
+   }
+
+   return total;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
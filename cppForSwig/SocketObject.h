@@ -29,6 +29,20 @@
 #include "SocketIncludes.h"
 #include "BinaryData.h"
 
+//how long a blocking write may wait on a full socket buffer before failing
+#ifndef UNIT_TESTS
+#define SOCKET_WRITE_TIMEOUT_MS 30000
+#else
+#define SOCKET_WRITE_TIMEOUT_MS 2000
+#endif
+
+//how long a blocking read may wait on the peer before failing
+#ifndef UNIT_TESTS
+#define SOCKET_READ_TIMEOUT_MS 120000
+#else
+#define SOCKET_READ_TIMEOUT_MS 2000
+#endif
+
    
 typedef std::function<bool(std::vector<uint8_t>, std::exception_ptr)>  ReadCallback;
 
@@ -153,7 +167,7 @@ class SimpleSocket : public SocketPrototype
 protected:
    SOCKET sockfd_ = SOCK_MAX;
 
-private:
+protected:
    int writeToSocket(std::vector<uint8_t>&);
 
 public:
@@ -77,6 +77,7 @@ bool HttpSocket::processPacket(
 
       string header_str((char*)&httpData[0], currentRead_.header_len_);
       currentRead_.get_content_len(header_str);
+      keepAlive_ = PacketData::get_keep_alive(header_str);
    }
 
    //no content-length header was found, abort
@@ -136,11 +137,79 @@ void HttpSocket::pushPayload(
    unique_ptr<Socket_WritePayload> write_payload,
    shared_ptr<Socket_ReadPayload> read_payload)
 {
+   if (write_payload == nullptr)
+      return;
+
    auto&& str = write_payload->serializeToText();
-   auto strPayload = make_unique<WritePayload_StringPassthrough>();
-   strPayload->data_ = move(getHttpPayload(str.c_str(), str.size()));
+   auto&& httpStr = getHttpPayload(str.c_str(), str.size());
+
+   vector<uint8_t> data(httpStr.begin(), httpStr.end());
+   if (writeToSocket(data) != (int)data.size())
+   {
+      keepAlive_ = false;
+      throw HttpError("failed to write http request");
+   }
+
+   if (read_payload == nullptr)
+      return;
 
-   SimpleSocket::pushPayload(move(strPayload), read_payload);
+   //the connection is kept alive across requests, so read until the
+   //advertised content-length is in rather than stopping at the first
+   //recv burst
+   vector<uint8_t> body;
+   while (true)
+   {
+      vector<uint8_t> packet;
+      try
+      {
+         packet = readFromSocket();
+      }
+      catch (SocketTimeout&)
+      {
+         //the response may still come in, this connection can't be reused
+         keepAlive_ = false;
+         currentRead_.clear();
+         throw;
+      }
+
+      if (packet.size() == 0)
+      {
+         keepAlive_ = false;
+         currentRead_.clear();
+         throw HttpError("connection closed by remote");
+      }
+
+      if (processPacket(packet, body))
+         break;
+   }
+
+   BinaryDataRef bdr;
+   if (body.size() != 0)
+      bdr.setRef(&body[0], body.size());
+
+   read_payload->callbackReturn_->callback(bdr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool HttpSocket::isAlive()
+{
+   if (sockfd_ == SOCK_MAX || !keepAlive_)
+      return false;
+
+   //an idle keep-alive connection has nothing to read, if it polls as
+   //readable the remote hung up on us
+   struct pollfd pfd;
+   pfd.fd = sockfd_;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+
+#ifdef _WIN32
+   auto status = WSAPoll(&pfd, 1, 0);
+#else
+   auto status = poll(&pfd, 1, 0);
+#endif
+
+   return status == 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -167,16 +236,10 @@ void HttpSocket::respond(vector<uint8_t>& payload)
 ///////////////////////////////////////////////////////////////////////////////
 void CallbackReturn_HttpBody::callback(BinaryDataRef ref)
 {
+   //HttpSocket strips the http header before handing the body over
    string body;
    if (ref.getSize() != 0)
-   {
-      auto offset = HttpSocket::getHttpBodyOffset(
-         ref.toCharPtr(), ref.getSize());
-
-      if (offset != SIZE_MAX)
-         body = move(string(
-            ref.toCharPtr() + offset, ref.getSize() - offset));
-   }
+      body = move(string(ref.toCharPtr(), ref.getSize()));
 
    userCallbackLambda_(move(body));
 }
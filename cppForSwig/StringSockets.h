@@ -10,6 +10,7 @@
 #define _H_STRING_SOCKETS
 
 #include <string.h>
+#include <algorithm>
 #include "SocketObject.h"
 #include "HttpMessage.h"
 
@@ -41,7 +42,7 @@ private:
          }
          else
          {
-            if (content_length_ + header_len_ > httpData_.size())
+            if (content_length_ + header_len_ < httpData_.size())
             {
                std::vector<uint8_t> leftOverData;
                leftOverData.insert(leftOverData.end(),
@@ -60,6 +61,18 @@ private:
          header_len_ = SIZE_MAX;
       }
 
+      static bool get_keep_alive(const std::string& header_str)
+      {
+         //HTTP/1.1 connections are persistent unless flagged otherwise
+         std::string http10("HTTP/1.0");
+         if (header_str.compare(0, http10.size(), http10) == 0)
+            return false;
+
+         std::string lower(header_str);
+         std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+         return lower.find("connection: close") == std::string::npos;
+      }
+
       void get_content_len(const std::string& header_str)
       {
          std::string err504("HTTP/1.1 504");
@@ -88,6 +101,7 @@ private:
 
 private:
    PacketData currentRead_;
+   bool keepAlive_ = true;
    std::unique_ptr<HttpMessage> messageWithPrecacheHeaders_;
    Armory::Threading::Queue<std::shared_ptr<Socket_ReadPayload>> readStack_;
 
@@ -107,6 +121,9 @@ public:
       std::shared_ptr<Socket_ReadPayload>);
    virtual void respond(std::vector<uint8_t>&);
 
+   //false once the remote closed the connection or asked us to
+   bool isAlive(void);
+
    void precacheHttpHeader(std::string& header)
    {
       messageWithPrecacheHeaders_->addHeader(std::move(header));
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <condition_variable>
 #include <deque>
+#include <algorithm>
 
 namespace Armory
 {
@@ -1015,6 +1016,242 @@ namespace Armory
             return count_.load(std::memory_order_relaxed);
          }
       };
+      //////////////////////////////////////////////////////////////////////////
+      template<typename T, typename U> class PersistentMap
+      {
+         /*
+         - immutable AVL tree with path copying: writes copy the O(log n)
+           nodes on the path to the modified key and share everything else
+         - copying the map is O(1), copies never see each other's writes
+         - lookups are O(log n) and take heterogeneous keys (anything 
+           comparable to T with operator<)
+
+         Not thread safe for concurrent writes to a same instance. Reading
+         a copy while the original is written to is safe.
+         */
+
+      private:
+         struct Node
+         {
+            const T key_;
+            const U val_;
+            const std::shared_ptr<const Node> left_;
+            const std::shared_ptr<const Node> right_;
+            const unsigned height_;
+
+            Node(const T& key, const U& val,
+               std::shared_ptr<const Node> left,
+               std::shared_ptr<const Node> right) :
+               key_(key), val_(val),
+               left_(std::move(left)), right_(std::move(right)),
+               height_(1 + std::max(
+                  PersistentMap<T, U>::height(left_), 
+                  PersistentMap<T, U>::height(right_)))
+            {}
+         };
+
+         using NodePtr = std::shared_ptr<const Node>;
+
+      private:
+         NodePtr root_;
+         size_t count_ = 0;
+
+      private:
+         static unsigned height(const NodePtr& node)
+         {
+            if (node == nullptr)
+               return 0;
+            return node->height_;
+         }
+
+         static NodePtr make(const T& key, const U& val,
+            NodePtr left, NodePtr right)
+         {
+            return std::make_shared<const Node>(
+               key, val, std::move(left), std::move(right));
+         }
+
+         static NodePtr rebalance(const T& key, const U& val,
+            NodePtr left, NodePtr right)
+         {
+            auto hl = height(left);
+            auto hr = height(right);
+
+            if (hl > hr + 1)
+            {
+               //left heavy
+               if (height(left->left_) >= height(left->right_))
+               {
+                  return make(left->key_, left->val_, left->left_,
+                     make(key, val, left->right_, std::move(right)));
+               }
+
+               auto& lr = left->right_;
+               return make(lr->key_, lr->val_,
+                  make(left->key_, left->val_, left->left_, lr->left_),
+                  make(key, val, lr->right_, std::move(right)));
+            }
+            else if (hr > hl + 1)
+            {
+               //right heavy
+               if (height(right->right_) >= height(right->left_))
+               {
+                  return make(right->key_, right->val_,
+                     make(key, val, std::move(left), right->left_),
+                     right->right_);
+               }
+
+               auto& rl = right->left_;
+               return make(rl->key_, rl->val_,
+                  make(key, val, std::move(left), rl->left_),
+                  make(right->key_, right->val_, rl->right_, right->right_));
+            }
+
+            return make(key, val, std::move(left), std::move(right));
+         }
+
+         static NodePtr insertNode(const NodePtr& node,
+            const T& key, const U& val, bool& added)
+         {
+            if (node == nullptr)
+            {
+               added = true;
+               return make(key, val, nullptr, nullptr);
+            }
+
+            if (key < node->key_)
+            {
+               return rebalance(node->key_, node->val_,
+                  insertNode(node->left_, key, val, added), node->right_);
+            }
+            else if (node->key_ < key)
+            {
+               return rebalance(node->key_, node->val_,
+                  node->left_, insertNode(node->right_, key, val, added));
+            }
+
+            //replace value in place, tree shape doesn't change
+            return make(node->key_, val, node->left_, node->right_);
+         }
+
+         static NodePtr eraseMin(const NodePtr& node, NodePtr& minNode)
+         {
+            if (node->left_ == nullptr)
+            {
+               minNode = node;
+               return node->right_;
+            }
+
+            return rebalance(node->key_, node->val_,
+               eraseMin(node->left_, minNode), node->right_);
+         }
+
+         template<typename K>
+         static NodePtr eraseNode(const NodePtr& node,
+            const K& key, bool& erased)
+         {
+            if (node == nullptr)
+               return nullptr;
+
+            if (key < node->key_)
+            {
+               auto left = eraseNode(node->left_, key, erased);
+               if (!erased)
+                  return node;
+               return rebalance(node->key_, node->val_,
+                  std::move(left), node->right_);
+            }
+            else if (node->key_ < key)
+            {
+               auto right = eraseNode(node->right_, key, erased);
+               if (!erased)
+                  return node;
+               return rebalance(node->key_, node->val_,
+                  node->left_, std::move(right));
+            }
+
+            erased = true;
+            if (node->left_ == nullptr)
+               return node->right_;
+            if (node->right_ == nullptr)
+               return node->left_;
+
+            NodePtr minNode;
+            auto right = eraseMin(node->right_, minNode);
+            return rebalance(minNode->key_, minNode->val_,
+               node->left_, std::move(right));
+         }
+
+         template<typename F>
+         static void walk(const NodePtr& node, const F& func)
+         {
+            if (node == nullptr)
+               return;
+
+            walk(node->left_, func);
+            func(node->key_, node->val_);
+            walk(node->right_, func);
+         }
+
+      public:
+         template<typename K>
+         const U* find(const K& key) const
+         {
+            auto node = root_.get();
+            while (node != nullptr)
+            {
+               if (key < node->key_)
+                  node = node->left_.get();
+               else if (node->key_ < key)
+                  node = node->right_.get();
+               else
+                  return &node->val_;
+            }
+
+            return nullptr;
+         }
+
+         //inserts or replaces, returns true if the key is new
+         bool insert(const T& key, const U& val)
+         {
+            bool added = false;
+            root_ = insertNode(root_, key, val, added);
+            if (added)
+               ++count_;
+
+            return added;
+         }
+
+         template<typename K>
+         bool erase(const K& key)
+         {
+            bool erased = false;
+            root_ = eraseNode(root_, key, erased);
+            if (erased)
+               --count_;
+
+            return erased;
+         }
+
+         //in order traversal
+         template<typename F>
+         void forEach(const F& func) const
+         {
+            walk(root_, func);
+         }
+
+         void clear(void)
+         {
+            root_.reset();
+            count_ = 0;
+         }
+
+         size_t size(void) const { return count_; }
+         bool empty(void) const { return count_ == 0; }
+
+         //longest root to leaf path, i.e. worst case lookup depth
+         unsigned depth(void) const { return height(root_); }
+      };
    }; //namespace Threading
 }; //namespace Armory
 
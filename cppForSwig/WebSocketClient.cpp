@@ -444,6 +444,7 @@ int WebSocketClient::callback(struct lws *wsi,
          LOGERR << "packet is " << packet.getSize() <<
             " bytes, sent " << m << " bytes";
       }
+      FragmentBufferPool::instance().release(move(packet));
 
       if (instance->currentWriteMessage_.isDone())
       {
@@ -506,6 +507,27 @@ void WebSocketClient::readService()
          payload.resize(payload.getSize() - POLY1305MACLEN);
       }
 
+      //batched replies, each entry is a complete message
+      if (payload.getSize() > 4 &&
+         WebSocketMessagePartial::getPacketType(payload.getRef()) ==
+            ArmoryAEAD::BIP151_PayloadType::Batch)
+      {
+         if (bip151Connection_->getBIP150State() != BIP150State::SUCCESS)
+         {
+            LOGWARN << "encryption layer is uninitialized, aborting connection";
+            shutdown();
+            return;
+         }
+
+         vector<WebSocketMessagePartial> messages;
+         if (!WebSocketMessagePartial::parseBatch(payload.getRef(), messages))
+            continue;
+
+         for (auto& msgObj : messages)
+            processReadMessage(msgObj);
+         continue;
+      }
+
       //deser packet
       auto payloadRef = currentReadMessage_.insertDataAndGetRef(payload);
       auto result = 
@@ -540,51 +562,48 @@ void WebSocketClient::readService()
          return;
       }
 
-      //figure out request id, fulfill promise
-      auto& msgid = currentReadMessage_.message_.getId();
-      switch (msgid)
-      {
-      case WEBSOCKET_CALLBACK_ID:
-      {
-         if (callbackPtr_ == nullptr)
-         {
-            currentReadMessage_.reset();
-            continue;
-         }
+      processReadMessage(currentReadMessage_.message_);
+      currentReadMessage_.reset();
+   }
+}
 
-         auto msgptr = make_shared<::Codec_BDVCommand::BDVCallback>();
-         if (!currentReadMessage_.message_.getMessage(msgptr.get()))
-         {
-            currentReadMessage_.reset();
-            continue;
-         }
+////////////////////////////////////////////////////////////////////////////////
+void WebSocketClient::processReadMessage(const WebSocketMessagePartial& msgObj)
+{
+   //figure out request id, fulfill promise
+   auto& msgid = msgObj.getId();
+   switch (msgid)
+   {
+   case WEBSOCKET_CALLBACK_ID:
+   {
+      if (callbackPtr_ == nullptr)
+         return;
 
-         callbackPtr_->processNotifications(msgptr);
-         currentReadMessage_.reset();
+      auto msgptr = make_shared<::Codec_BDVCommand::BDVCallback>();
+      if (!msgObj.getMessage(msgptr.get()))
+         return;
 
-         break;
-      }
+      callbackPtr_->processNotifications(msgptr);
+      break;
+   }
 
-      default:
-         auto readMap = readPackets_.get();
-         auto iter = readMap->find(msgid);
-         if (iter != readMap->end())
-         {
-            auto& msgObjPtr = iter->second;
-            auto callbackPtr = dynamic_cast<CallbackReturn_WebSocket*>(
-               msgObjPtr->payload_->callbackReturn_.get());
-            if (callbackPtr == nullptr)
-               continue;
+   default:
+      auto readMap = readPackets_.get();
+      auto iter = readMap->find(msgid);
+      if (iter != readMap->end())
+      {
+         auto& msgObjPtr = iter->second;
+         auto callbackPtr = dynamic_cast<CallbackReturn_WebSocket*>(
+            msgObjPtr->payload_->callbackReturn_.get());
+         if (callbackPtr == nullptr)
+            return;
 
-            callbackPtr->callback(currentReadMessage_.message_);
-            readPackets_.erase(msgid);
-            currentReadMessage_.reset();
-         }
-         else
-         {
-            LOGWARN << "invalid msg id";
-            currentReadMessage_.reset();
-         }
+         callbackPtr->callback(msgObj);
+         readPackets_.erase(msgid);
+      }
+      else
+      {
+         LOGWARN << "invalid msg id";
       }
    }
 }
@@ -162,6 +162,7 @@ private:
    void writeService(void);
    void service(lws_context*);
    bool processAEADHandshake(const WebSocketMessagePartial&);
+   void processReadMessage(const WebSocketMessagePartial&);
    void promptUser(const BinaryDataRef&, const std::string&);
 
 public:
@@ -15,6 +15,257 @@
 using namespace std;
 using namespace ::google::protobuf::io;
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// FragmentBufferPool
+//
+////////////////////////////////////////////////////////////////////////////////
+FragmentBufferPool& FragmentBufferPool::instance()
+{
+   static FragmentBufferPool pool;
+   return pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData FragmentBufferPool::get(size_t size)
+{
+   BinaryData result;
+   {
+      unique_lock<mutex> lock(mu_);
+      if (!buffers_.empty())
+      {
+         result = move(buffers_.back());
+         buffers_.pop_back();
+      }
+   }
+
+   //resize within the original capacity doesn't reallocate
+   if (result.getSize() == 0)
+      result.resize(WEBSOCKET_MESSAGE_PACKET_SIZE);
+   result.resize(size);
+   return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FragmentBufferPool::release(BinaryData&& data)
+{
+   if (data.getSize() == 0 || data.getSize() > WEBSOCKET_MESSAGE_PACKET_SIZE)
+      return;
+
+   unique_lock<mutex> lock(mu_);
+   if (buffers_.size() >= WEBSOCKET_FRAGMENT_POOL_SIZE)
+      return;
+   buffers_.emplace_back(move(data));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t FragmentBufferPool::size()
+{
+   unique_lock<mutex> lock(mu_);
+   return buffers_.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FragmentWriter
+//
+////////////////////////////////////////////////////////////////////////////////
+FragmentWriter::FragmentWriter(
+   size_t payloadSize, BIP151Connection* connPtr, uint32_t id) :
+   connPtr_(connPtr), id_(id), payloadSize_(payloadSize)
+{
+   //see WebSocketMessageCodec::serialize for the layout
+   static size_t payload_room =
+      WEBSOCKET_MESSAGE_PACKET_SIZE - LWS_PRE - POLY1305MACLEN - 9;
+   if (payloadSize_ <= payload_room)
+      return;
+
+   isSinglePacket_ = false;
+
+   //2 extra bytes for fragment count
+   size_t header_room = payload_room - 2;
+   size_t left_over = payloadSize_ - header_room;
+
+   //1 extra bytes for fragment count < 253
+   size_t fragment_room = payload_room - 1;
+   size_t fragment_count = left_over / fragment_room + 1;
+   if (fragment_count >= 253)
+   {
+      left_over -= 252 * fragment_room;
+
+      //3 extra bytes for fragment count >= 253
+      fragment_room = payload_room - 3;
+      fragment_count = 253 + left_over / fragment_room;
+   }
+
+   if (left_over % fragment_room != 0)
+      ++fragment_count;
+
+   if (fragment_count > UINT16_MAX)
+      throw runtime_error("payload too large for serialization");
+   fragmentCount_ = (uint16_t)fragment_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FragmentWriter::~FragmentWriter()
+{
+   for (auto& fragment : fragments_)
+      FragmentBufferPool::instance().release(move(fragment));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FragmentWriter::openFragment()
+{
+   size_t index = fragments_.size();
+   if (index >= fragmentCount_)
+      throw runtime_error("fragment count overflow");
+
+   size_t overhead;
+   size_t room;
+   if (isSinglePacket_)
+   {
+      overhead = LWS_PRE + POLY1305MACLEN + 9;
+      room = payloadSize_;
+   }
+   else if (index == 0)
+   {
+      overhead = LWS_PRE + POLY1305MACLEN + 11;
+      room = WEBSOCKET_MESSAGE_PACKET_SIZE - overhead;
+   }
+   else
+   {
+      overhead = LWS_PRE + POLY1305MACLEN + (index < 253 ? 10 : 12);
+      room = min(
+         WEBSOCKET_MESSAGE_PACKET_SIZE - overhead, payloadSize_ - written_);
+   }
+
+   fragments_.emplace_back(
+      FragmentBufferPool::instance().get(overhead + room));
+   payloadOffset_ = overhead - POLY1305MACLEN;
+   fragmentPos_ = 0;
+   fragmentRoom_ = room;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FragmentWriter::sealFragment()
+{
+   if (fragments_.empty())
+      return;
+
+   auto index = fragments_.size() - 1;
+   auto& data = fragments_.back();
+   auto ptr = data.getPtr() + LWS_PRE;
+
+   /***
+   Header, right behind the payload:
+    uint32_t packet size (excludes itself and the mac)
+    uint8_t type
+    uint32_t msgid
+    uint16_t fragment count (fragmented header)
+    varint fragment id (fragments)
+   ***/
+   uint32_t packet_size = data.getSize() - LWS_PRE - POLY1305MACLEN - 4;
+   memcpy(ptr, &packet_size, 4);
+
+   ArmoryAEAD::BIP151_PayloadType type;
+   if (isSinglePacket_)
+      type = ArmoryAEAD::BIP151_PayloadType::SinglePacket;
+   else if (index == 0)
+      type = ArmoryAEAD::BIP151_PayloadType::FragmentHeader;
+   else
+      type = ArmoryAEAD::BIP151_PayloadType::FragmentPacket;
+   ptr[4] = (uint8_t)type;
+   memcpy(ptr + 5, &id_, 4);
+
+   if (!isSinglePacket_)
+   {
+      if (index == 0)
+      {
+         memcpy(ptr + 9, &fragmentCount_, 2);
+      }
+      else if (index < 253)
+      {
+         ptr[9] = (uint8_t)index;
+      }
+      else
+      {
+         uint16_t frag_id = index;
+         ptr[9] = 0xFD;
+         memcpy(ptr + 10, &frag_id, 2);
+      }
+   }
+
+   //encrypt in place if possible
+   size_t plainTextLen = data.getSize() - LWS_PRE - POLY1305MACLEN;
+   size_t cipherTextLen = data.getSize() - LWS_PRE;
+   if (connPtr_ != nullptr)
+   {
+      if (connPtr_->assemblePacket(
+         ptr, plainTextLen, ptr, cipherTextLen) != 0)
+      {
+         //failed to encrypt, abort
+         throw runtime_error("failed to encrypt packet, aborting");
+      }
+   }
+   else
+   {
+      data.resize(cipherTextLen);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool FragmentWriter::Next(void** data, int* size)
+{
+   if (fragments_.empty() || fragmentPos_ == fragmentRoom_)
+   {
+      if (written_ >= payloadSize_)
+         return false;
+
+      //current fragment is full
+      sealFragment();
+      openFragment();
+   }
+
+   auto& fragment = fragments_.back();
+   *data = fragment.getPtr() + payloadOffset_ + fragmentPos_;
+   *size = fragmentRoom_ - fragmentPos_;
+
+   fragmentPos_ = fragmentRoom_;
+   written_ += *size;
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FragmentWriter::BackUp(int count)
+{
+   if (count < 0 || (size_t)count > fragmentPos_)
+      throw runtime_error("invalid backup count");
+
+   fragmentPos_ -= count;
+   written_ -= count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+vector<BinaryData> FragmentWriter::finalize()
+{
+   //empty payload still yields a single packet
+   if (fragments_.empty())
+      openFragment();
+
+   if (written_ != payloadSize_ || fragmentPos_ != fragmentRoom_ ||
+      fragments_.size() != fragmentCount_)
+   {
+      throw runtime_error("payload size mismatch");
+   }
+
+   sealFragment();
+
+   //the caller owns the fragments from here on
+   vector<BinaryData> result;
+   result.swap(fragments_);
+   return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // WebSocketMessageCodec
@@ -118,134 +369,46 @@ vector<BinaryData> WebSocketMessageCodec::serialize(
      nbytes payload fragment
    ***/
    
-   //encrypt lambda
-   vector<BinaryData> result;
-   auto encryptAndAdd = [connPtr, &result](BinaryData& data)
-   {
-      size_t plainTextLen = data.getSize() - LWS_PRE - POLY1305MACLEN;
-      size_t cipherTextLen = data.getSize() - LWS_PRE;
-
-      if (connPtr != nullptr)
-      {
-         if (connPtr->assemblePacket(
-            data.getPtr() + LWS_PRE, plainTextLen,
-            data.getPtr() + LWS_PRE, cipherTextLen) != 0)
-         {
-            //failed to encrypt, abort
-            throw runtime_error("failed to encrypt packet, aborting");
-         }
-      }
-      else
-      {
-         data.resize(cipherTextLen);
-      }
-
-      result.emplace_back(data);
-   };
-   
-   auto data_len = payload.getSize();
-   static size_t payload_room = 
-      WEBSOCKET_MESSAGE_PACKET_SIZE - LWS_PRE - POLY1305MACLEN - 9;
-   if (data_len <= payload_room)
+   FragmentWriter writer(payload.getSize(), connPtr, id);
+   size_t pos = 0;
+   void* data;
+   int size;
+   while (pos < payload.getSize() && writer.Next(&data, &size))
    {
-      //single packet serialization
-      uint32_t size = data_len + 5;
-      BinaryData plainText(LWS_PRE + POLY1305MACLEN + 9 + data_len);
-
-      memcpy(plainText.getPtr() + LWS_PRE, &size, 4);
-      memset(plainText.getPtr() + LWS_PRE + 4,
-         (uint8_t)ArmoryAEAD::BIP151_PayloadType::SinglePacket, 1);
-      memcpy(plainText.getPtr() + LWS_PRE + 5, &id, 4);
-
-      if (!payload.empty())
-         memcpy(plainText.getPtr() + LWS_PRE + 9, payload.getPtr(), data_len);
-
-      encryptAndAdd(plainText);
+      size_t len = min((size_t)size, payload.getSize() - pos);
+      memcpy(data, payload.getPtr() + pos, len);
+      writer.BackUp(size - len);
+      pos += len;
    }
-   else
-   {
-      //2 extra bytes for fragment count
-      uint32_t header_room = payload_room - 2;
-      size_t left_over = data_len - header_room;
-      
-      //1 extra bytes for fragment count < 253
-      size_t fragment_room = payload_room - 1;
-      uint32_t fragment_count32 = left_over / fragment_room + 1;
-      if (fragment_count32 >= 253)
-      {
-         left_over -= 252 * fragment_room;
-         
-         //3 extra bytes for fragment count >= 253
-         fragment_room = payload_room - 3; 
-         fragment_count32 = 253 + left_over / fragment_room;
-      }
-
-      if (left_over % fragment_room != 0)
-         ++fragment_count32;
-
-      if (fragment_count32 > UINT16_MAX)
-         throw runtime_error("payload too large for serialization");
-      uint16_t fragment_count = (uint16_t)fragment_count32;
-
-      BinaryData header_packet(WEBSOCKET_MESSAGE_PACKET_SIZE);
-
-      //-2 for fragment count
-      size_t pos = payload_room - 2;
-
-      //+4 to shave off payload size, +1 for type
-      header_room = payload_room + 5; 
-
-      memcpy(header_packet.getPtr() + LWS_PRE, &header_room, 4);
-      memset(header_packet.getPtr() + LWS_PRE + 4,
-         (uint8_t)ArmoryAEAD::BIP151_PayloadType::FragmentHeader, 1);
-      memcpy(header_packet.getPtr() + LWS_PRE + 5, &id, 4);
-      memcpy(header_packet.getPtr() + LWS_PRE + 9, &fragment_count, 2);
-      memcpy(header_packet.getPtr() + LWS_PRE + 11, payload.getPtr(), pos);
-      encryptAndAdd(header_packet);
-
-      size_t fragment_overhead = 10 + LWS_PRE + POLY1305MACLEN;
-      for (unsigned i = 1; i < fragment_count; i++)
-      {
-         if (i == 253)
-            fragment_overhead += 2;
-
-         //figure out data size
-         size_t data_size = min(
-            WEBSOCKET_MESSAGE_PACKET_SIZE - fragment_overhead, 
-            data_len - pos);
 
-         BinaryData fragment_packet(data_size + fragment_overhead);
-         uint32_t packet_size = 
-            data_size + fragment_overhead - LWS_PRE - POLY1305MACLEN - 4;
-
-         memcpy(fragment_packet.getPtr() + LWS_PRE, &packet_size, 4);
-         memset(fragment_packet.getPtr() + LWS_PRE + 4,
-            (uint8_t)ArmoryAEAD::BIP151_PayloadType::FragmentPacket, 1);
-         memcpy(fragment_packet.getPtr() + LWS_PRE + 5, &id, 4);
+   return writer.finalize();
+}
 
-         size_t offset = LWS_PRE + 9;
-         if (i < 253)
-         {
-            uint8_t frag_id = i;
-            memcpy(fragment_packet.getPtr() + offset, &frag_id, 1);
-            ++offset;
-         }
-         else
-         {
-            uint16_t frag_id = i;
-            fragment_packet.getPtr()[offset++] = 0xFD;
-            memcpy(fragment_packet.getPtr() + offset, &frag_id, 2);
-            offset += 2;
-         }
+////////////////////////////////////////////////////////////////////////////////
+vector<BinaryData> WebSocketMessageCodec::serialize(
+   const ::google::protobuf::Message& msg, BIP151Connection* connPtr,
+   uint32_t id)
+{
+   /***
+   Same layout as the payload version, but the message is serialized
+   directly into the fragments instead of going through a flat buffer
+   first.
+   ***/
 
-         memcpy(fragment_packet.getPtr() + offset, payload.getPtr() + pos, data_size);
-         pos += data_size;
+   auto len = msg.ByteSizeLong();
+   if (len > INT32_MAX)
+      throw runtime_error("payload too large for serialization");
 
-         encryptAndAdd(fragment_packet);
-      }
+   FragmentWriter writer(len, connPtr, id);
+   if (len > 0)
+   {
+      CodedOutputStream cos(&writer);
+      msg.SerializeWithCachedSizes(&cos);
+      if (cos.HadError())
+         throw runtime_error("failed to serialize message");
    }
 
-   return result;
+   return writer.finalize();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -304,6 +467,130 @@ uint32_t WebSocketMessageCodec::getMessageId(const BinaryDataRef& packet)
    return *(uint32_t*)(packet.getPtr() + 4);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// WebSocketMessageBatch
+//
+///////////////////////////////////////////////////////////////////////////////
+WebSocketMessageBatch::~WebSocketMessageBatch()
+{
+   FragmentBufferPool::instance().release(move(packet_));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint8_t* WebSocketMessageBatch::reserve(uint32_t id, size_t size)
+{
+   //entries sit between the packet header and the mac
+   static const size_t entry_room =
+      WEBSOCKET_MESSAGE_PACKET_SIZE - LWS_PRE - POLY1305MACLEN - 5;
+
+   size_t varint_len = size < 0xFD ? 1 : 3;
+   if (pos_ + 4 + varint_len + size > entry_room)
+      return nullptr;
+
+   if (packet_.getSize() == 0)
+   {
+      packet_ = FragmentBufferPool::instance().get(
+         WEBSOCKET_MESSAGE_PACKET_SIZE);
+   }
+
+   auto offset = LWS_PRE + 5 + pos_;
+   auto ptr = packet_.getPtr() + offset;
+   memcpy(ptr, &id, 4);
+   if (varint_len == 1)
+   {
+      ptr[4] = (uint8_t)size;
+   }
+   else
+   {
+      uint16_t size16 = (uint16_t)size;
+      ptr[4] = 0xFD;
+      memcpy(ptr + 5, &size16, 2);
+   }
+
+   if (count_ == 0)
+   {
+      firstId_ = id;
+      firstOffset_ = offset + 4 + varint_len;
+      firstSize_ = size;
+   }
+
+   pos_ += 4 + varint_len + size;
+   ++count_;
+   return ptr + 4 + varint_len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool WebSocketMessageBatch::add(uint32_t id, const BinaryDataRef& payload)
+{
+   auto ptr = reserve(id, payload.getSize());
+   if (ptr == nullptr)
+      return false;
+
+   if (payload.getSize() > 0)
+      memcpy(ptr, payload.getPtr(), payload.getSize());
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool WebSocketMessageBatch::add(
+   uint32_t id, const ::google::protobuf::Message& msg)
+{
+   auto ptr = reserve(id, msg.ByteSizeLong());
+   if (ptr == nullptr)
+      return false;
+
+   msg.SerializeWithCachedSizesToArray(ptr);
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<BinaryData> WebSocketMessageBatch::serialize(BIP151Connection* connPtr)
+{
+   if (count_ == 0)
+      throw runtime_error("cannot serialize empty batch");
+
+   vector<BinaryData> result;
+   if (count_ == 1)
+   {
+      //lone message, no point in the batch framing
+      BinaryDataRef payload(packet_.getPtr() + firstOffset_, firstSize_);
+      result = WebSocketMessageCodec::serialize(payload, connPtr,
+         ArmoryAEAD::BIP151_PayloadType::SinglePacket, firstId_);
+      FragmentBufferPool::instance().release(move(packet_));
+   }
+   else
+   {
+      auto ptr = packet_.getPtr() + LWS_PRE;
+      uint32_t packet_size = pos_ + 1;
+      memcpy(ptr, &packet_size, 4);
+      ptr[4] = (uint8_t)ArmoryAEAD::BIP151_PayloadType::Batch;
+
+      size_t plainTextLen = pos_ + 5;
+      size_t cipherTextLen = plainTextLen + POLY1305MACLEN;
+      if (connPtr != nullptr)
+      {
+         packet_.resize(LWS_PRE + cipherTextLen);
+         if (connPtr->assemblePacket(
+            ptr, plainTextLen, ptr, cipherTextLen) != 0)
+         {
+            throw runtime_error("failed to encrypt packet, aborting");
+         }
+      }
+      else
+      {
+         packet_.resize(LWS_PRE + plainTextLen);
+      }
+
+      result.emplace_back(move(packet_));
+   }
+
+   packet_.clear();
+   pos_ = 0;
+   count_ = 0;
+   return result;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // SerializedMessage
@@ -324,6 +611,21 @@ void SerializedMessage::construct(const BinaryDataRef& data,
       WebSocketMessageCodec::serialize(data, connPtr, type, id));
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void SerializedMessage::construct(const ::google::protobuf::Message& msg,
+   BIP151Connection* connPtr, uint32_t id)
+{
+   packets_ = move(
+      WebSocketMessageCodec::serialize(msg, connPtr, id));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SerializedMessage::construct(
+   WebSocketMessageBatch& batch, BIP151Connection* connPtr)
+{
+   packets_ = move(batch.serialize(connPtr));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 BinaryData SerializedMessage::consumeNextPacket()
 {
@@ -394,6 +696,7 @@ bool WebSocketMessagePartial::parsePacket(const BinaryDataRef& dataRef)
    case ArmoryAEAD::BIP151_PayloadType::Challenge:
    case ArmoryAEAD::BIP151_PayloadType::Reply:
    case ArmoryAEAD::BIP151_PayloadType::Propose:
+   case ArmoryAEAD::BIP151_PayloadType::Capabilities:
    {
       return parseMessageWithoutId(dataSlice);
    }
@@ -572,4 +875,49 @@ unsigned WebSocketMessagePartial::getMessageId(const BinaryDataRef& bdr)
    }
 
    return UINT32_MAX;
-}
\ No newline at end of file
+}
+///////////////////////////////////////////////////////////////////////////////
+bool WebSocketMessagePartial::parseBatch(const BinaryDataRef& bdr,
+   vector<WebSocketMessagePartial>& result)
+{
+   /*
+   uint32_t packet size
+   uint8_t type (Batch)
+   for each message:
+    uint32_t msgid
+    varint size
+    nbytes payload
+   */
+
+   try
+   {
+      BinaryRefReader brr(bdr);
+      auto packetlen = brr.get_uint32_t();
+      if (packetlen != brr.getSizeRemaining())
+         return false;
+
+      auto type = (ArmoryAEAD::BIP151_PayloadType)brr.get_uint8_t();
+      if (type != ArmoryAEAD::BIP151_PayloadType::Batch)
+         return false;
+
+      while (brr.getSizeRemaining() > 0)
+      {
+         WebSocketMessagePartial msg;
+         msg.type_ = ArmoryAEAD::BIP151_PayloadType::SinglePacket;
+         msg.id_ = brr.get_uint32_t();
+
+         auto size = brr.get_var_int();
+         msg.packets_.emplace(make_pair(0, brr.get_BinaryDataRef(size)));
+         msg.packetCount_ = 1;
+
+         result.emplace_back(move(msg));
+      }
+   }
+   catch (const runtime_error&)
+   {
+      LOGERR << "invalid batch packet";
+      return false;
+   }
+
+   return true;
+}
@@ -12,9 +12,12 @@
 #include <stdexcept>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "BinaryData.h"
 #include <google/protobuf/message.h>
+#include <google/protobuf/io/zero_copy_stream.h>
 #include "SocketObject.h"
 
 #include "BIP150_151.h"
@@ -24,6 +27,11 @@
 #define WEBSOCKET_AEAD_HANDSHAKE_ID 0xFFFFFFFD
 #define WEBSOCKET_MAGIC_WORD 0x56E1
 #define AEAD_REKEY_INVERVAL_SECONDS 600
+#define WEBSOCKET_FRAGMENT_POOL_SIZE 1024
+
+//messages up to this size are packed into batch packets when the peer 
+//supports it, see WebSocketMessageBatch
+#define WEBSOCKET_BATCH_MAX_ENTRY_SIZE 256
 
 class LWS_Error : public std::runtime_error
 {
@@ -38,10 +46,82 @@ namespace ArmoryAEAD
    enum class BIP151_PayloadType : uint8_t;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class FragmentBufferPool
+{
+   /***
+   Recycles outgoing fragment buffers. Sockets hand fragments back once 
+   lws_write is done with them, so steady state serialization doesn't hit 
+   the allocator.
+   ***/
+
+private:
+   std::mutex mu_;
+   std::vector<BinaryData> buffers_;
+
+public:
+   static FragmentBufferPool& instance(void);
+
+   //buffer of this size, content is undefined
+   BinaryData get(size_t);
+   void release(BinaryData&&);
+   size_t size(void);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class FragmentWriter : public ::google::protobuf::io::ZeroCopyOutputStream
+{
+   /***
+   Lays out a payload of known size across websocket fragments (same wire
+   format as WebSocketMessageCodec::serialize) and hands out the payload
+   area of each fragment, so protobuf serializes straight into them. 
+   
+   Fragments are pooled, have LWS_PRE headroom and are sealed (header + 
+   in place AEAD) once full. Fragments not handed out by finalize (the
+   serializer threw partway) go back to the pool on destruction.
+   ***/
+
+private:
+   BIP151Connection* connPtr_;
+   const uint32_t id_;
+   const size_t payloadSize_;
+   bool isSinglePacket_ = true;
+   uint16_t fragmentCount_ = 1;
+
+   std::vector<BinaryData> fragments_;
+   size_t written_ = 0;
+
+   //current fragment
+   size_t payloadOffset_ = 0;
+   size_t fragmentPos_ = 0;
+   size_t fragmentRoom_ = 0;
+
+private:
+   void openFragment(void);
+   void sealFragment(void);
+
+public:
+   FragmentWriter(size_t payloadSize, BIP151Connection*, uint32_t id);
+   ~FragmentWriter(void);
+
+   FragmentWriter(const FragmentWriter&) = delete;
+   FragmentWriter& operator=(const FragmentWriter&) = delete;
+
+   bool Next(void** data, int* size) override;
+   void BackUp(int count) override;
+   int64_t ByteCount(void) const override { return written_; }
+
+   //seals the last fragment, throws if fewer bytes than announced were 
+   //written
+   std::vector<BinaryData> finalize(void);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class WebSocketMessageCodec
 {
 public:
+   static std::vector<BinaryData> serialize(
+      const ::google::protobuf::Message&, BIP151Connection*, uint32_t);
    static std::vector<BinaryData> serialize(
       const BinaryDataRef&, BIP151Connection*,
       ArmoryAEAD::BIP151_PayloadType, uint32_t);
@@ -62,6 +142,56 @@ public:
       ::google::protobuf::Message*);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class WebSocketMessageBatch
+{
+   /***
+   Packs several small msgid tagged messages into a single packet, so a 
+   burst of small replies costs one frame and one AEAD tag instead of one 
+   per message:
+
+    uint32_t packet size
+    uint8_t type (Batch)
+    for each message:
+     uint32_t msgid
+     varint size
+     nbytes payload
+
+   Only sent to peers that announced BIP15X_CAPABILITY_BATCH. 
+   ***/
+
+private:
+   //pooled packet buffer, payload area starts at LWS_PRE
+   BinaryData packet_;
+   size_t pos_ = 0;
+   unsigned count_ = 0;
+
+   //first entry, sent as a single packet if it ends up alone
+   uint32_t firstId_ = 0;
+   size_t firstOffset_ = 0;
+   size_t firstSize_ = 0;
+
+private:
+   uint8_t* reserve(uint32_t id, size_t size);
+
+public:
+   ~WebSocketMessageBatch(void);
+
+   //these return false if the message doesn't fit, serialize first
+   bool add(uint32_t id, const BinaryDataRef&);
+   bool add(uint32_t id, const ::google::protobuf::Message&);
+
+   static bool isBatchable(size_t size)
+   { return size <= WEBSOCKET_BATCH_MAX_ENTRY_SIZE; }
+
+   bool empty(void) const { return count_ == 0; }
+   unsigned count(void) const { return count_; }
+   size_t size(void) const { return pos_; }
+
+   //seals the packet and resets the batch
+   std::vector<BinaryData> serialize(BIP151Connection*);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class SerializedMessage
 {
@@ -77,6 +207,9 @@ public:
       ArmoryAEAD::BIP151_PayloadType, uint32_t id = 0);
    void construct(const BinaryDataRef& data, BIP151Connection*,
       ArmoryAEAD::BIP151_PayloadType, uint32_t id = 0);
+   void construct(const ::google::protobuf::Message&, BIP151Connection*,
+      uint32_t id);
+   void construct(WebSocketMessageBatch&, BIP151Connection*);
 
    bool isDone(void) const { return index_ >= packets_.size(); }
    BinaryData consumeNextPacket(void);
@@ -116,6 +249,11 @@ public:
 
    static ArmoryAEAD::BIP151_PayloadType getPacketType(const BinaryDataRef&);
    static unsigned getMessageId(const BinaryDataRef&);
+
+   //splits a Batch packet into single packet messages, these reference the
+   //packet data
+   static bool parseBatch(const BinaryDataRef&, 
+      std::vector<WebSocketMessagePartial>&);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,7 +40,9 @@ ZeroConfContainer::ZeroConfContainer(LMDBBlockDatabase* db,
 {
    zcEnabled_.store(false, memory_order_relaxed);
 
-   zcPreprocessQueue_ = make_shared<PreprocessQueue>();
+   zcPreprocessQueue_ = make_shared<PreprocessQueue>(
+      Executor::shared(), ExecutorWorkload_ZeroConf, TaskPriority_Normal);
+   feeHistogram_ = make_shared<ZcFeeHistogram>();
 
    //register ZC callbacks
    auto processInvTx = [this](vector<InvEntry> entryVec)->void
@@ -216,7 +218,9 @@ map<BinaryData, shared_ptr<ParsedTx>> ZeroConfContainer::purge(
 
    map<BinaryData, shared_ptr<ParsedTx>> txsToReparse;
 
-   if (db_ == nullptr || outPointsSpentByKey_.empty())
+   //blocks still need parsed to clear mined txs from the fee histogram
+   if (db_ == nullptr || 
+      (outPointsSpentByKey_.empty() && feeHistogram_->getTxCount() == 0))
       return {};
 
    set<BinaryData> keysToDelete;
@@ -276,6 +280,10 @@ map<BinaryData, shared_ptr<ParsedTx>> ZeroConfContainer::purge(
       for (unsigned txid = 1; txid < txns.size(); txid++)
       {
          auto& txn = txns[txid];
+
+         //mined txs leave the fee histogram
+         feeHistogram_->dropTxByHash(txn->getHash());
+
          for (unsigned iin = 0; iin < txn->txins_.size(); iin++)
          {
             auto txInRef = txn->getTxInRef(iin);
@@ -301,6 +309,7 @@ map<BinaryData, shared_ptr<ParsedTx>> ZeroConfContainer::purge(
 
    //drop the invalidated ZCs
    auto invalidatedZCs = dropZCs(ss, keysToDelete);
+   feeHistogram_->expire(FEE_HISTOGRAM_EXPIRY_SEC);
 
    //reset direct descendants' unconfirmed input resolution
    for (auto& zcPtr : invalidatedZCs)
@@ -363,6 +372,7 @@ map<BinaryData, shared_ptr<ParsedTx>> ZeroConfContainer::dropZC(
       keyToSpentScrAddr_.erase(key);
       keyToFundedScrAddr_.erase(key);
       allZcTxHashes_.erase(txPtr->getTxHash());
+      feeHistogram_->dropTx(zcPair.first);
    }
 
    return droppedZCs;
@@ -458,8 +468,7 @@ void ZeroConfContainer::parseNewZC(ZcActionStruct zcAction)
 {
    bool notify = true;
 
-   auto ss = MempoolSnapshot::copy(
-      snapshot_, MEMPOOL_DEPTH, POOL_MERGE_THRESHOLD);
+   auto ss = MempoolSnapshot::copy(snapshot_);
 
    map<BinaryData, shared_ptr<ParsedTx>> zcMap;
    map<BinaryData, shared_ptr<WatcherTxBody>> watcherMap;
@@ -539,7 +548,7 @@ void ZeroConfContainer::parseNewZC(
    }
 
    if (ss == nullptr)
-      ss = make_shared<MempoolSnapshot>(MEMPOOL_DEPTH, POOL_MERGE_THRESHOLD);
+      ss = make_shared<MempoolSnapshot>();
 
    for (auto& newZCPair : zcMap)
    {
@@ -574,6 +583,10 @@ void ZeroConfContainer::parseNewZC(
       //parse the zc
       auto&& filterResult = filterTransaction(newZCPair.second, ss);
 
+      //the fee histogram covers the whole mempool, not just our wallets
+      if (newZCPair.second->status() != ParsedTxStatus::Invalid)
+         feeHistogram_->addTx(*newZCPair.second);
+
       //check for replacement
       invalidatedTx = checkForCollisions(filterResult.outPointsSpentByKey_, ss);
 
@@ -761,6 +774,7 @@ map<BinaryData, shared_ptr<ParsedTx>> ZeroConfContainer::checkForCollisions(
 void ZeroConfContainer::clear()
 {
    snapshot_.reset();
+   feeHistogram_->clear();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1070,6 +1084,13 @@ void ZeroConfContainer::init(shared_ptr<ScrAddrFilter> saf, bool clearMempool)
 
    parserThreads_.push_back(thread(updateZcThread));
    parserThreads_.push_back(thread(invTxThread));
+
+   //zc packets are parsed on the shared executor
+   auto processZcPacketLbd = [this](shared_ptr<ZcGetPacket> packet)->void
+   {
+      processZcPacket(move(packet));
+   };
+   zcPreprocessQueue_->start(processZcPacketLbd, 1);
    increaseParserThreadPool(1);
 
    zcEnabled_.store(true, memory_order_relaxed);
@@ -1213,55 +1234,42 @@ void ZeroConfContainer::handleInvTx()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ZeroConfContainer::handleZcProcessingStructThread(void)
+void ZeroConfContainer::processZcPacket(shared_ptr<ZcGetPacket> packet)
 {
-   while (1)
+   switch (packet->type_)
    {
-      shared_ptr<ZcGetPacket> packet;
-      try
-      {
-         packet = move(zcPreprocessQueue_->pop_front());
-      }
-      catch (StopBlockingLoop&)
-      {
-         break;
-      }
-
-      switch (packet->type_)
-      {
-      case ZcGetPacketType_Request:
-      {
-         auto request = dynamic_pointer_cast<RequestZcPacket>(packet);
-         if (request != nullptr)
-            requestTxFromNode(*request);
+   case ZcGetPacketType_Request:
+   {
+      auto request = dynamic_pointer_cast<RequestZcPacket>(packet);
+      if (request != nullptr)
+         requestTxFromNode(*request);
 
-         break;
-      }
+      break;
+   }
 
-      case ZcGetPacketType_Payload:
-      {
-         auto payloadTx = dynamic_pointer_cast<ProcessPayloadTxPacket>(packet);
-         if (payloadTx == nullptr)
-            throw runtime_error("unexpected payload type");
+   case ZcGetPacketType_Payload:
+   {
+      auto payloadTx = dynamic_pointer_cast<ProcessPayloadTxPacket>(packet);
+      if (payloadTx == nullptr)
+         throw runtime_error("unexpected payload type");
 
-         processPayloadTx(payloadTx);
-         break;
-      }
+      processPayloadTx(payloadTx);
+      break;
+   }
 
-      case ZcGetPacketType_Broadcast:
-      {
-         auto broadcastPacket = dynamic_pointer_cast<ZcBroadcastPacket>(packet);
-         if (broadcastPacket == nullptr)
-            break;
-            
-         pushZcPacketThroughP2P(*broadcastPacket);
+   case ZcGetPacketType_Broadcast:
+   {
+      auto broadcastPacket = dynamic_pointer_cast<ZcBroadcastPacket>(packet);
+      if (broadcastPacket == nullptr)
          break;
-      }
+         
+      pushZcPacketThroughP2P(*broadcastPacket);
+      break;
+   }
 
-      default:
-         break;
-      } //switch
-   } //while
+   default:
+      break;
+   } //switch
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1566,17 +1574,15 @@ void ZeroConfContainer::increaseParserThreadPool(unsigned count)
 {
    unique_lock<mutex> lock(parserThreadMutex_);
 
-   //start Zc parser thread
-   auto processZcThread = [this](void)->void
-   {
-      handleZcProcessingStructThread();
-   };
-
-   for (unsigned i = parserThreadCount_; i < count; i++)
-      parserThreads_.push_back(thread(processZcThread));
+   //parsers are executor tasks, this only raises how many of them can
+   //work the preprocess queue concurrently
+   count = min(count, maxZcThreadCount_);
+   if (count <= parserThreadCount_)
+      return;
 
-   parserThreadCount_ = parserThreads_.size();
-   LOGINFO << "now running " << parserThreadCount_ << " zc parser threads";
+   zcPreprocessQueue_->setMaxActive(count);
+   parserThreadCount_ = count;
+   LOGINFO << "now running up to " << parserThreadCount_ << " zc parsers";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1781,6 +1787,16 @@ unsigned ZeroConfContainer::getMergeCount(void) const
    return ss->getMergeCount();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+MempoolStats ZeroConfContainer::getMempoolStats(void) const
+{
+   auto ss = getSnapshot();
+   if (ss == nullptr)
+      return {};
+
+   return ss->getStats();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //// ZcActionQueue
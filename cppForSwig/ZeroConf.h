@@ -20,6 +20,7 @@
 #include <memory>
 
 #include "ThreadSafeClasses.h"
+#include "Executor.h"
 #include "BitcoinP2p.h"
 #include "BlockchainDatabase/lmdb_wrapper.h"
 #include "BlockchainDatabase/Blockchain.h"
@@ -30,14 +31,6 @@
 
 #define GETZC_THREADCOUNT 5
 
-#ifdef UNIT_TESTS
-   #define MEMPOOL_DEPTH         1
-   #define POOL_MERGE_THRESHOLD  10
-#else
-   #define MEMPOOL_DEPTH         4
-   #define POOL_MERGE_THRESHOLD  10000
-#endif
-
 #define ZC_BUFFER_LIFETIME_SEC 1
 #ifndef UNIT_TESTS
    #define ZC_BUFFER_SIZE_THRESHOLD 30
@@ -307,7 +300,7 @@ struct ZcActionStruct
    Blockchain::ReorganizationState reorgState_;
 };
 
-typedef Armory::Threading::BlockingQueue<std::shared_ptr<ZcGetPacket>> PreprocessQueue;
+typedef Armory::Threading::DrainQueue<std::shared_ptr<ZcGetPacket>> PreprocessQueue;
 
 ////////////////////////////////////////////////////////////////////////////////
 class ZcActionQueue
@@ -425,6 +418,8 @@ private:
    std::map<BinaryData, std::shared_ptr<WatcherTxBody>> watcherMap_;
    ArmoryMutex watcherMapMutex_;
 
+   std::shared_ptr<ZcFeeHistogram> feeHistogram_;
+
    unsigned mergeCount_ = 0;
 
 private:
@@ -444,7 +439,7 @@ private:
       std::shared_ptr<MempoolSnapshot>);
 
    void processTxGetDataReply(std::unique_ptr<Payload>);
-   void handleZcProcessingStructThread(void);
+   void processZcPacket(std::shared_ptr<ZcGetPacket>);
    void requestTxFromNode(RequestZcPacket&);
    void processPayloadTx(std::shared_ptr<ProcessPayloadTxPacket>);
 
@@ -530,6 +525,9 @@ public:
    std::vector<UTXO> getZcUTXOsForKey(const std::set<BinaryData>&) const;
 
    std::shared_ptr<MempoolSnapshot> getSnapshot(void) const;
+   MempoolStats getMempoolStats(void) const;
+   std::shared_ptr<ZcFeeHistogram> getFeeHistogram(void) const
+   { return feeHistogram_; }
 
    //for unit tests
    unsigned getMergeCount(void) const;
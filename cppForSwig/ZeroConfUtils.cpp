@@ -6,10 +6,14 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cmath>
+#include <ctime>
+
 #include "ZeroConfUtils.h"
 #include "ZeroConfNotifications.h"
 #include "BlockchainDatabase/ScrAddrFilter.h"
 #include "BlockchainDatabase/lmdb_wrapper.h"
+#include "JSON_codec.h"
 
 using namespace std;
 using namespace Armory::Config;
@@ -599,30 +603,18 @@ const BinaryData& ParsedTx::getTxHash(void) const
 //
 ///////////////////////////////////////////////////////////////////////////////
 /***
-Mempool data is a chain of objects with a front object and cascading parents.
-Requested data is first fetched from the front object first then trough parents
-in a descending fashion, until the value closest to the front is returned, or
-no value is found.
-
-In maps, a key match with an empty value signifies a deletion.
+Mempool data is a set of persistent maps. Copying a MempoolData shares the
+maps' nodes with the original, writes only copy the path to the modified
+key. Lookups are a single tree descent regardless of how many snapshots
+have been derived from one another.
 
-scrAddrMap_ is handled differently.
+scrAddrMap_ values are sets that are copied on write, see KeySet.
 ***/
 
 ///////////////////////////////////////////////////////////////////////////////
-unsigned MempoolData::getParentCount() const
-{
-   auto parentPtr = parent_;
-   unsigned count = 0;
-
-   while (parentPtr != nullptr)
-   {
-      parentPtr = parentPtr->parent_;
-      ++count;
-   }
-
-   return count;
-}
+MempoolData::MempoolData() :
+   gen_(make_shared<Generation>())
+{}
 
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolData::copyFrom(const MempoolData& orig)
@@ -633,158 +625,88 @@ void MempoolData::copyFrom(const MempoolData& orig)
    scrAddrMap_ = orig.scrAddrMap_;
    txioMap_ = orig.txioMap_;
 
-   parent_ = orig.parent_;
+   /*
+   Key sets are now shared, neither side may modify them in place. The
+   original may be copied by several threads at once, it is only flagged
+   through its generation, never written to.
+   */
+   orig.gen_->shared_.store(true, memory_order_release);
+   gen_ = make_shared<Generation>();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 shared_ptr<ParsedTx> MempoolData::getTx(BinaryDataRef key) const
 {
-   auto iter = txMap_.find(key);
-   if (iter == txMap_.end())
-   {
-      if (parent_ != nullptr)
-         return parent_->getTx(key);
-
+   auto txPtr = txMap_.find(key);
+   if (txPtr == nullptr)
       return nullptr;
-   }
 
-   return iter->second;
+   return *txPtr;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 BinaryDataRef MempoolData::getKeyForHash(BinaryDataRef hash) const
 {
-   auto iter = txHashToDBKey_.find(hash);
-   if (iter == txHashToDBKey_.end())
-   {
-      if (parent_ != nullptr)
-         return parent_->getKeyForHash(hash);
-
+   auto keyPtr = txHashToDBKey_.find(hash);
+   if (keyPtr == nullptr)
       return {};
-   }
 
-   return iter->second;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-/***
-The scrAddrMap_ needs special handling:
-
-   * This map carries the txio keys affecting each scrAddr. A same scrAddr may
-     be affected by several parents so to get the true set of relevant txio
-     keys, history across all parents needs to be merged together first. This 
-     creates copies on each read. To avoid this, we "bring forward" the txio
-     keys from the nearest parent when the front MempoolData is missing the
-     requested for scrAddr.
-***/
-set<BinaryData>* MempoolData::getTxioKeysFromParent(
-   BinaryDataRef scrAddr) const
-{
-   if (parent_ == nullptr)
-      return nullptr;
-
-   auto iter = parent_->scrAddrMap_.find(scrAddr);
-   if (iter != parent_->scrAddrMap_.end())
-      return &(iter->second);
-
-   return parent_->getTxioKeysFromParent(scrAddr);
+   return *keyPtr;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 set<BinaryData>& MempoolData::getTxioKeysForScrAddr_NoThrow(
    BinaryDataRef scrAddr)
 {
-   auto iter = scrAddrMap_.find(scrAddr);
-   if (iter == scrAddrMap_.end())
-   {
-      //we don't have a key set for this scrAddr, look in parents
-      auto parentSet = getTxioKeysFromParent(scrAddr);
-
-      //copy the parent's set
-      set<BinaryData> localKeySet;
-      if (parentSet != nullptr)
-         localKeySet = *parentSet;
-
-      //insert into our own scrAddrMap whether we have a parent set or not
-      auto insertIter = scrAddrMap_.emplace(scrAddr, move(localKeySet));
-
-      //finally, set the iterator to the new entry
-      iter = insertIter.first;
-   }
-
-   return iter->second;
+   //this instance was copied, the sets it created are shared from now on
+   if (gen_->shared_.load(memory_order_acquire))
+      gen_ = make_shared<Generation>();
+
+   auto keySetPtr = scrAddrMap_.find(scrAddr);
+   if (keySetPtr != nullptr && (*keySetPtr)->gen_ == gen_)
+      return (*keySetPtr)->keys_;
+
+   //the set is missing or shared with another snapshot, copy it
+   auto newKeySet = make_shared<KeySet>();
+   newKeySet->gen_ = gen_;
+   if (keySetPtr != nullptr)
+      newKeySet->keys_ = (*keySetPtr)->keys_;
+
+   scrAddrMap_.insert(scrAddr, newKeySet);
+   return newKeySet->keys_;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 const set<BinaryData>& MempoolData::getTxioKeysForScrAddr(
    BinaryDataRef scrAddr) const
 {
-   auto iter = scrAddrMap_.find(scrAddr);
-   if (iter == scrAddrMap_.end())
-   {
-      if (parent_ != nullptr)
-         return parent_->getTxioKeysForScrAddr(scrAddr);
-
-      throw range_error("");
-   }
-
-   if (iter->second.empty())
+   auto keySetPtr = scrAddrMap_.find(scrAddr);
+   if (keySetPtr == nullptr || (*keySetPtr)->keys_.empty())
       throw range_error("");
    
-   return iter->second;
+   return (*keySetPtr)->keys_;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 shared_ptr<const TxIOPair> MempoolData::getTxio(BinaryDataRef key) const
 {
-   auto iter = txioMap_.find(key);
-   if (iter == txioMap_.end())
-   {
-      if (parent_ != nullptr)
-         return parent_->getTxio(key);
-
+   auto txioPtr = txioMap_.find(key);
+   if (txioPtr == nullptr)
       return nullptr;
-   }
 
-   return const_pointer_cast<TxIOPair>(iter->second);
+   return *txioPtr;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 bool MempoolData::isTxOutSpentByZC(BinaryDataRef key) const
 {
-   auto iter = txOutsSpentByZC_.find(key);
-   if (iter == txOutsSpentByZC_.end())
-   {
-      if (parent_ != nullptr)
-         return parent_->isTxOutSpentByZC(key);
-
-      return false;
-   }
-
-   return iter->second;
+   return txOutsSpentByZC_.find(key) != nullptr;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolData::dropFromSpentTxOuts(BinaryDataRef key)
 {
-   bool inParents = false;
-   if (parent_ != nullptr)
-      inParents = parent_->isTxOutSpentByZC(key);
-
-   if (!inParents)
-   {
-      txOutsSpentByZC_.erase(key);
-      return;
-   }
-
-   auto iter = txOutsSpentByZC_.find(key);
-   if (iter == txOutsSpentByZC_.end())
-   {
-      auto insertIter = txOutsSpentByZC_.emplace(key, false);
-      iter = insertIter.first;
-   }
-
-   iter->second = false;
+   txOutsSpentByZC_.erase(key);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -809,28 +731,7 @@ void MempoolData::dropFromScrAddrMap(
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolData::dropTxHashToDBKey(BinaryDataRef hash)
 {
-   bool hasHash = false;
-   if (parent_ != nullptr)
-   {
-      auto key = parent_->getKeyForHash(hash);
-      if (!key.empty())
-         hasHash = true;
-   }
-
-   if (!hasHash)
-   {
-      txHashToDBKey_.erase(hash);
-      return;
-   }
-
-   auto iter = txHashToDBKey_.find(hash);
-   if (iter == txHashToDBKey_.end())
-   {
-      auto insertIter = txHashToDBKey_.emplace(hash, BinaryDataRef());
-      iter = insertIter.first;
-   }
-
-   iter->second.reset();
+   txHashToDBKey_.erase(hash);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -846,7 +747,7 @@ void MempoolData::dropTxiosForZC(BinaryDataRef key)
       bw.put_BinaryData(key);
       bw.put_uint16_t(i, BE);
 
-      txioMap_[bw.getData()] = nullptr;
+      txioMap_.erase(bw.getDataRef());
    }
 }
 
@@ -870,7 +771,7 @@ void MempoolData::dropTxioInputs(
       if (!txioPtr->hasTxOutZC())
       {
          //if the txout is mined, remove it entirely
-         txioMap_[spentTxoutKey] = nullptr;
+         txioMap_.erase(spentTxoutKey);
       }
       else
       {
@@ -880,7 +781,7 @@ void MempoolData::dropTxioInputs(
          */
          auto newTxio = make_shared<TxIOPair>(*(txioPtr));
          newTxio->setTxIn(BinaryData());
-         txioMap_[spentTxoutKey] = newTxio;
+         txioMap_.insert(spentTxoutKey, newTxio);
       }
    }
 }
@@ -888,170 +789,18 @@ void MempoolData::dropTxioInputs(
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolData::dropTx(BinaryDataRef key)
 {
-   bool inParents = false;
-   if (parent_ != nullptr)
-   {
-      auto txPtr = parent_->getTx(key);
-      if (txPtr != nullptr)
-         inParents = true;
-   }
-
-   if (!inParents)
-   {
-      txMap_.erase(key);
-      return;
-   }
-
-   auto iter = txMap_.find(key);
-   if (iter == txMap_.end())
-   {
-      auto insertIter = txMap_.emplace(key, nullptr);
-      iter = insertIter.first;
-   }
-
-   iter->second = nullptr;
+   txMap_.erase(key);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-shared_ptr<MempoolData> MempoolData::mergeWithParent(
-   shared_ptr<MempoolData> ptr)
+unsigned MempoolData::getLookupDepth() const
 {
-   if (ptr->parent_ == nullptr)
-      return ptr;
-
-   auto newObj = make_shared<MempoolData>();
-   
-   //tx hashes
-   {
-      newObj->txHashToDBKey_ = ptr->txHashToDBKey_;
-      for (const auto& hashPair : ptr->parent_->txHashToDBKey_)
-         newObj->txHashToDBKey_.emplace(hashPair);
-
-      auto hashIter = newObj->txHashToDBKey_.begin();
-      while (hashIter != newObj->txHashToDBKey_.end())
-      {
-         if (hashIter->second.empty())
-         {
-            if (ptr->parent_->parent_ != nullptr)
-            {
-               if (ptr->parent_->parent_->getKeyForHash(hashIter->first).empty())
-               {
-                  newObj->txHashToDBKey_.erase(hashIter++);
-                  continue;
-               }
-            }
-         }
-
-         ++hashIter;
-      }
-   }
-
-   //tx map
-   {
-      newObj->txMap_ = ptr->txMap_;
-      for (const auto& txPair : ptr->parent_->txMap_)
-         newObj->txMap_.emplace(txPair);
-
-      auto txIter = newObj->txMap_.begin();
-      while (txIter != newObj->txMap_.end())
-      {
-         if (txIter->second == nullptr)
-         {
-            if (ptr->parent_->parent_ != nullptr)
-            {
-               if (ptr->parent_->parent_->getTx(txIter->first) == nullptr)
-               {
-                  newObj->txMap_.erase(txIter++);
-                  continue;
-               }
-            }
-         }
-
-         ++txIter;
-      }
-   }
-
-   //txouts spentness
-   {
-      newObj->txOutsSpentByZC_ = ptr->txOutsSpentByZC_;
-      for (const auto& keyPair : ptr->parent_->txOutsSpentByZC_)
-         newObj->txOutsSpentByZC_.emplace(keyPair);
-
-      auto keyIter = newObj->txOutsSpentByZC_.begin();
-      while (keyIter != newObj->txOutsSpentByZC_.end())
-      {
-         if (!keyIter->second)
-         {
-            if (ptr->parent_->parent_ != nullptr)
-            {
-               if (!ptr->parent_->parent_->isTxOutSpentByZC(keyIter->first))
-               {
-                  newObj->txOutsSpentByZC_.erase(keyIter++);
-                  continue;
-               }
-            }
-         }
-
-         ++keyIter;
-      }
-   }
-
-   //scrAddr map
-   {
-      newObj->scrAddrMap_ = ptr->scrAddrMap_;
-      for (const auto& addrPair : ptr->parent_->scrAddrMap_)
-         newObj->scrAddrMap_.emplace(addrPair);
-
-      auto addrIter = newObj->scrAddrMap_.begin();
-      while (addrIter != newObj->scrAddrMap_.end())
-      {
-         if (addrIter->second.empty())
-         {
-            if (ptr->parent_->parent_ != nullptr)
-            {
-               try
-               {
-                  ptr->parent_->parent_->getTxioKeysForScrAddr(addrIter->first);
-               }
-               catch (range_error&)
-               {
-                  newObj->scrAddrMap_.erase(addrIter++);
-                  continue;
-               }
-            }
-         }
-
-         ++addrIter;
-      }
-   }
-
-   //txio map
-   {
-      newObj->txioMap_ = ptr->txioMap_;
-      for (const auto& txioPair : ptr->parent_->txioMap_)
-         newObj->txioMap_.emplace(txioPair);
-      
-      auto txioIter = newObj->txioMap_.begin();
-      while (txioIter != newObj->txioMap_.end())
-      {
-         if (txioIter->second == nullptr)
-         {
-            if (ptr->parent_->parent_ != nullptr)
-            {
-               if (ptr->parent_->parent_->getTxio(txioIter->first) == nullptr)
-               {
-                  newObj->txioMap_.erase(txioIter++);
-                  continue;
-               }
-            }
-         }
-
-         ++txioIter;
-      }
-   }
-
-   newObj->parent_ = ptr->parent_->parent_;
-   return newObj;
+   return max({
+      txHashToDBKey_.depth(),
+      txMap_.depth(),
+      txOutsSpentByZC_.depth(),
+      scrAddrMap_.depth(),
+      txioMap_.depth() });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1059,8 +808,7 @@ shared_ptr<MempoolData> MempoolData::mergeWithParent(
 // MempoolSnapshot
 //
 ///////////////////////////////////////////////////////////////////////////////
-MempoolSnapshot::MempoolSnapshot(unsigned depth, unsigned threshold) :
-   depth_(depth), threshold_(threshold)
+MempoolSnapshot::MempoolSnapshot()
 {
    data_ = make_shared<MempoolData>();
 }
@@ -1068,7 +816,14 @@ MempoolSnapshot::MempoolSnapshot(unsigned depth, unsigned threshold) :
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolSnapshot::preprocessZcMap(LMDBBlockDatabase* db)
 {
-   ::preprocessZcMap(data_->txMap_, db);
+   map<BinaryData, shared_ptr<ParsedTx>> zcMap;
+   data_->txMap_.forEach(
+      [&zcMap](const BinaryData& key, const shared_ptr<ParsedTx>& txPtr)
+   {
+      zcMap.emplace(key, txPtr);
+   });
+
+   ::preprocessZcMap(zcMap, db);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1293,6 +1048,7 @@ map<BinaryData, std::shared_ptr<ParsedTx>> MempoolSnapshot::dropZc(
 
    //save this tx as dropped from the mempool and return
    droppedZc.emplace(txPtr->getKeyRef(), txPtr);
+   hasStagedData_ = true;
    return droppedZc;
 }
 
@@ -1304,12 +1060,12 @@ void MempoolSnapshot::stageNewZC(
    const auto& txHash = zcPtr->getTxHash();
 
    //set tx and hash to key entry
-   data_->txHashToDBKey_[txHash.getRef()] = dbKey.getRef();
-   data_->txMap_[dbKey.getRef()] = zcPtr;
+   data_->txHashToDBKey_.insert(txHash.getRef(), dbKey.getRef());
+   data_->txMap_.insert(dbKey, zcPtr);
 
    //merge spent outpoints
    for (auto& txoutkey : filteredData.txOutsSpentByZC_)
-      data_->txOutsSpentByZC_.emplace(txoutkey, true);
+      data_->txOutsSpentByZC_.insert(txoutkey, true);
 
    //updated txio and scraddr maps
    for (auto& saTxios : filteredData.scrAddrTxioMap_)
@@ -1321,7 +1077,7 @@ void MempoolSnapshot::stageNewZC(
          keySet.emplace(txioPair.first);
 
          //add to txio map
-         data_->txioMap_[txioPair.first] = txioPair.second;
+         data_->txioMap_.insert(txioPair.first, txioPair.second);
       }
    }
 
@@ -1330,17 +1086,20 @@ void MempoolSnapshot::stageNewZC(
    auto zcId = brrKey.get_uint32_t(BE);
    if (zcId > topID_)
       topID_ = zcId;
+
+   hasStagedData_ = true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 shared_ptr<MempoolSnapshot> MempoolSnapshot::copy(
-   shared_ptr<MempoolSnapshot> ss, unsigned pool, unsigned threshold)
+   shared_ptr<MempoolSnapshot> ss)
 {
-   auto ssCopy = make_shared<MempoolSnapshot>(pool, threshold);
+   auto ssCopy = make_shared<MempoolSnapshot>();
    if (ss != nullptr)
    {
       ssCopy->topID_ = ss->topID_;
       ssCopy->mergeCount_ = ss->mergeCount_;
+      ssCopy->hasStagedData_ = ss->hasStagedData_;
       ssCopy->data_->copyFrom(*ss->data_);
    }
 
@@ -1350,56 +1109,349 @@ shared_ptr<MempoolSnapshot> MempoolSnapshot::copy(
 ///////////////////////////////////////////////////////////////////////////////
 void MempoolSnapshot::commitNewZCs()
 {
-   //figure out depth and size of each mempool obj, merge if necessary
-   if (data_->txioMap_.empty() &&
-      data_->scrAddrMap_.empty() &&
-      data_->txioMap_.empty())
-   {
+   /*
+   Staged zc are written straight to the persistent maps, there is no
+   parent chain to collapse anymore. Committing only seals the batch for
+   the stats.
+   */
+   if (!hasStagedData_)
       return;
+
+   hasStagedData_ = false;
+   ++mergeCount_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MempoolStats MempoolSnapshot::getStats() const
+{
+   MempoolStats stats;
+   stats.mergeCount_ = mergeCount_;
+   stats.lookupDepth_ = data_->getLookupDepth();
+   stats.txCount_ = data_->txMap_.size();
+   stats.txioCount_ = data_->txioMap_.size();
+   stats.scrAddrCount_ = data_->scrAddrMap_.size();
+
+   return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ZcFeeHistogram
+//
+///////////////////////////////////////////////////////////////////////////////
+ZcFeeHistogram::ZcFeeHistogram() :
+   buckets_(FEE_HISTOGRAM_BUCKET_COUNT, 0)
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned ZcFeeHistogram::getBucket(float satPerVByte)
+{
+   //bucket 0 is for anything under 1 sat/vB
+   if (satPerVByte < 1.0f)
+      return 0;
+
+   auto id = unsigned(log(satPerVByte) / log(FEE_HISTOGRAM_SPACING)) + 1;
+   return min(id, unsigned(FEE_HISTOGRAM_BUCKET_COUNT - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+float ZcFeeHistogram::getBucketFloor(unsigned id)
+{
+   if (id == 0)
+      return 0.0f;
+
+   return pow(FEE_HISTOGRAM_SPACING, float(id - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::setBucket(Entry& entry)
+{
+   //gather unconfirmed ancestors
+   uint64_t packageFee = entry.fee_;
+   uint64_t packageVsize = entry.vsize_;
+
+   set<BinaryData> visited;
+   vector<const BinaryData*> toVisit;
+   for (auto& parent : entry.parents_)
+      toVisit.push_back(&parent);
+
+   while (!toVisit.empty() && visited.size() < FEE_HISTOGRAM_MAX_ANCESTORS)
+   {
+      auto keyPtr = toVisit.back();
+      toVisit.pop_back();
+
+      if (!visited.insert(*keyPtr).second)
+         continue;
+
+      auto iter = entries_.find(*keyPtr);
+      if (iter == entries_.end())
+         continue;
+
+      packageFee += iter->second.fee_;
+      packageVsize += iter->second.vsize_;
+
+      for (auto& parent : iter->second.parents_)
+         toVisit.push_back(&parent);
    }
 
-   auto newData = make_shared<MempoolData>();
-   newData->parent_ = data_;
+   float ownRate = float(entry.fee_) / float(entry.vsize_);
+   float packageRate = float(packageFee) / float(packageVsize);
+
+   entry.bucket_ = getBucket(min(ownRate, packageRate));
+   buckets_[entry.bucket_] += entry.vsize_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::rebucketDescendants(const set<BinaryData>& children)
+{
+   set<BinaryData> visited;
+   vector<BinaryData> toVisit(children.begin(), children.end());
 
-   if (newData->getParentCount() > depth_)
+   while (!toVisit.empty() && visited.size() < FEE_HISTOGRAM_MAX_ANCESTORS)
    {
-      auto toMerge = newData->parent_;
+      auto key = move(toVisit.back());
+      toVisit.pop_back();
 
-      //find the first parent above the size threshold, use
-      //first parent otherwise
-      auto objPtr = toMerge;
-      while (objPtr != nullptr)
-      {
-         if (objPtr->txioMap_.size() > threshold_ && objPtr->parent_ != nullptr)
-         {
-            toMerge = objPtr;
-            break;
-         }
+      auto iter = entries_.find(key);
+      if (iter == entries_.end())
+         continue;
 
-         objPtr = objPtr->parent_;
-      }
+      if (!visited.insert(key).second)
+         continue;
 
-      //merge this data with its parent
-      if (toMerge != nullptr)
-      {
-         auto mergedData = MempoolData::mergeWithParent(toMerge);
+      auto& entry = iter->second;
+      buckets_[entry.bucket_] -= entry.vsize_;
+      setBucket(entry);
 
-         //replace parent with the newly merged data
-         auto objPtr = newData;
-         while (objPtr != nullptr)
-         {
-            if (objPtr->parent_ == toMerge)
-            {
-               objPtr->parent_ = mergedData;
-               break;
-            }
+      toVisit.insert(toVisit.end(),
+         entry.children_.begin(), entry.children_.end());
+   }
+}
 
-            objPtr = objPtr->parent_;
-         }
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::dropEntry(map<BinaryData, Entry>::iterator iter)
+{
+   auto& entry = iter->second;
+   buckets_[entry.bucket_] -= entry.vsize_;
+   totalVsize_ -= entry.vsize_;
+
+   for (auto& parent : entry.parents_)
+   {
+      auto parentIter = entries_.find(parent);
+      if (parentIter != entries_.end())
+         parentIter->second.children_.erase(iter->first);
+   }
+
+   for (auto& child : entry.children_)
+   {
+      auto childIter = entries_.find(child);
+      if (childIter != entries_.end())
+         childIter->second.parents_.erase(iter->first);
+   }
+
+   auto children = move(entry.children_);
+   hashToKey_.erase(entry.hash_);
+   entries_.erase(iter);
+
+   //children lost an ancestor, their package rate changed
+   rebucketDescendants(children);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ZcFeeHistogram::addTx(const ParsedTx& parsedTx)
+{
+   if (!parsedTx.tx_.isInitialized() ||
+      parsedTx.inputs_.empty() || parsedTx.outputs_.empty())
+      return false;
+
+   uint64_t valIn = 0;
+   for (auto& input : parsedTx.inputs_)
+   {
+      if (input.value_ == UINT64_MAX)
+         return false;
+      valIn += input.value_;
+   }
+
+   uint64_t valOut = 0;
+   for (auto& output : parsedTx.outputs_)
+   {
+      if (output.value_ == UINT64_MAX)
+         return false;
+      valOut += output.value_;
+   }
+
+   if (valIn < valOut)
+      return false;
+
+   auto vsize = parsedTx.tx_.getTxWeight();
+   if (vsize == 0)
+      return false;
+
+   Entry entry;
+   entry.hash_ = parsedTx.getTxHash();
+   entry.fee_ = valIn - valOut;
+   entry.vsize_ = vsize;
+   entry.time_ = time(0);
+
+   unique_lock<mutex> lock(mu_);
+   if (hashToKey_.find(entry.hash_) != hashToKey_.end())
+      return false;
 
-         ++mergeCount_;
+   //link with unconfirmed parents
+   for (auto& input : parsedTx.inputs_)
+   {
+      if (!input.opRef_.isZc())
+         continue;
+
+      auto parentKey = input.opRef_.getDbTxKeyRef();
+      auto parentIter = entries_.find(parentKey);
+      if (parentIter == entries_.end())
+         continue;
+
+      entry.parents_.insert(parentIter->first);
+   }
+
+   auto insertIter = entries_.emplace(parsedTx.getKey(), move(entry));
+   if (!insertIter.second)
+      return false;
+
+   auto& newEntry = insertIter.first->second;
+   for (auto& parent : newEntry.parents_)
+      entries_[parent].children_.insert(parsedTx.getKey());
+
+   hashToKey_.emplace(newEntry.hash_, parsedTx.getKey());
+   totalVsize_ += newEntry.vsize_;
+   setBucket(newEntry);
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::dropTx(BinaryDataRef zcKey)
+{
+   unique_lock<mutex> lock(mu_);
+   auto iter = entries_.find(zcKey);
+   if (iter == entries_.end())
+      return;
+
+   dropEntry(iter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::dropTxByHash(BinaryDataRef txHash)
+{
+   unique_lock<mutex> lock(mu_);
+   auto hashIter = hashToKey_.find(txHash);
+   if (hashIter == hashToKey_.end())
+      return;
+
+   auto iter = entries_.find(hashIter->second);
+   if (iter == entries_.end())
+   {
+      hashToKey_.erase(hashIter);
+      return;
+   }
+
+   dropEntry(iter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::expire(uint64_t maxAgeSec)
+{
+   auto now = uint64_t(time(0));
+
+   unique_lock<mutex> lock(mu_);
+   auto iter = entries_.begin();
+   while (iter != entries_.end())
+   {
+      if (iter->second.time_ + maxAgeSec >= now)
+      {
+         ++iter;
+         continue;
       }
+
+      //dropEntry invalidates the iterator
+      auto key = iter->first;
+      dropEntry(iter);
+      iter = entries_.upper_bound(key);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZcFeeHistogram::clear()
+{
+   unique_lock<mutex> lock(mu_);
+   entries_.clear();
+   hashToKey_.clear();
+   buckets_.assign(FEE_HISTOGRAM_BUCKET_COUNT, 0);
+   totalVsize_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+float ZcFeeHistogram::estimateFeeByte(
+   unsigned confTarget, const string& strategy) const
+{
+   if (confTarget == 0)
+      confTarget = 1;
+
+   /*
+   Conservative estimates assume blocks come in half as fast as expected,
+   i.e. only half the block space within the target is available to us.
+   */
+   uint64_t capacity = confTarget * FEE_HISTOGRAM_BLOCK_VSIZE;
+   if (strategy == FEE_STRAT_CONSERVATIVE)
+      capacity /= 2;
+
+   unique_lock<mutex> lock(mu_);
+   if (entries_.empty())
+      return -1.0f;
+
+   //fill blocks from the top, outbid the bucket that overflows the capacity
+   uint64_t cumulated = 0;
+   float satPerVByte = 1.0f;
+   for (int i = FEE_HISTOGRAM_BUCKET_COUNT - 1; i >= 0; i--)
+   {
+      cumulated += buckets_[i];
+      if (cumulated < capacity)
+         continue;
+
+      satPerVByte = max(getBucketFloor(unsigned(i) + 1), 1.0f);
+      break;
+   }
+
+   //sat/vB to BTC/kvB
+   return satPerVByte * 1000.0f / 100000000.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+map<unsigned, float> ZcFeeHistogram::getFeeSchedule(
+   const string& strategy) const
+{
+   static const vector<unsigned> confTargets = FEE_SCHEDULE_TARGETS;
+
+   map<unsigned, float> result;
+   for (auto& target : confTargets)
+   {
+      auto feeByte = estimateFeeByte(target, strategy);
+      if (feeByte < 0.0f)
+         return {};
+
+      result.emplace(target, feeByte);
    }
 
-   data_ = move(newData);
-}
\ No newline at end of file
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t ZcFeeHistogram::getTxCount() const
+{
+   unique_lock<mutex> lock(mu_);
+   return entries_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t ZcFeeHistogram::getTotalVsize() const
+{
+   unique_lock<mutex> lock(mu_);
+   return totalVsize_;
+}
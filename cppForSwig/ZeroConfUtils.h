@@ -11,7 +11,11 @@
 
 #include <map>
 #include <set>
+#include <mutex>
+#include <atomic>
+#include <string>
 #include "BinaryData.h"
+#include "ThreadSafeClasses.h"
 #include "BlockchainDatabase/txio.h"
 
 class LMDBBlockDatabase;
@@ -201,32 +205,55 @@ struct MempoolData
    */
 
 public:
+   /*
+   scrAddr txio key sets are copied on write. A set is only modified in
+   place by the MempoolData instance that created it (gen_ matches), until
+   that instance is copied. Copying flags the source's generation as shared
+   instead of writing to the source, the next write on either side then
+   moves on to a fresh generation.
+   */
+   struct Generation
+   {
+      std::atomic<bool> shared_ = { false };
+   };
 
+   struct KeySet
+   {
+      std::set<BinaryData> keys_;
+      std::shared_ptr<Generation> gen_;
+   };
+
+public:
    //TODO: shouldn't use references for txHashes anymore
-   std::map<BinaryDataRef, BinaryDataRef> txHashToDBKey_; //<txHash, zcKey>
-   std::map<BinaryData, std::shared_ptr<ParsedTx>> txMap_; //<zcKey, zcTx>
-   
-   //<txOutKey, bool> (true for valid, false for dropped)
-   std::map<BinaryData, bool> txOutsSpentByZC_;
+   //<txHash, zcKey>
+   Armory::Threading::PersistentMap<BinaryDataRef, BinaryDataRef> txHashToDBKey_;
+
+   //<zcKey, zcTx>
+   Armory::Threading::PersistentMap<
+      BinaryData, std::shared_ptr<ParsedTx>> txMap_;
+
+   //<txOutKey, true>
+   Armory::Threading::PersistentMap<BinaryData, bool> txOutsSpentByZC_;
 
    //<scrAddr, <txOutKey>>
-   std::map<BinaryData, std::set<BinaryData>> scrAddrMap_;
+   Armory::Threading::PersistentMap<
+      BinaryData, std::shared_ptr<KeySet>> scrAddrMap_;
 
    //<zcKey/txKey, txio>>
-   std::map<BinaryData, std::shared_ptr<TxIOPair>> txioMap_;
+   Armory::Threading::PersistentMap<
+      BinaryData, std::shared_ptr<TxIOPair>> txioMap_;
 
-   std::shared_ptr<MempoolData> parent_;
+private:
+   std::shared_ptr<Generation> gen_;
 
 public:
-   unsigned getParentCount(void) const;
+   MempoolData(void);
 
    ////
-   std::set<BinaryData>* getTxioKeysFromParent(BinaryDataRef) const;
    std::set<BinaryData>& getTxioKeysForScrAddr_NoThrow(BinaryDataRef);
    const std::set<BinaryData>& getTxioKeysForScrAddr(BinaryDataRef) const;
    std::shared_ptr<const TxIOPair> getTxio(BinaryDataRef) const;
 
-
    void copyFrom(const MempoolData&);
 
    std::shared_ptr<ParsedTx> getTx(BinaryDataRef) const;
@@ -243,18 +270,30 @@ public:
    void dropTx(BinaryDataRef);
 
    ////
-   static std::shared_ptr<MempoolData> mergeWithParent(
-      std::shared_ptr<MempoolData>);
+   unsigned getLookupDepth(void) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct MempoolStats
+{
+   //commits that folded staged zc into the snapshot
+   unsigned mergeCount_ = 0;
+
+   //worst case tree depth across the snapshot maps
+   unsigned lookupDepth_ = 0;
+
+   size_t txCount_ = 0;
+   size_t txioCount_ = 0;
+   size_t scrAddrCount_ = 0;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 class MempoolSnapshot
 {
 private:
-   unsigned depth_;
-   unsigned threshold_;
    std::shared_ptr<MempoolData> data_;
    unsigned topID_ = 0;
+   bool hasStagedData_ = false;
 
    //for unit tests
    unsigned mergeCount_ = 0;
@@ -264,10 +303,9 @@ private:
    std::set<BinaryData> findChildren(BinaryDataRef);
 
 public:
-   MempoolSnapshot(unsigned, unsigned);
+   MempoolSnapshot(void);
    static std::shared_ptr<MempoolSnapshot> copy(
-      std::shared_ptr<MempoolSnapshot>,
-      unsigned, unsigned);
+      std::shared_ptr<MempoolSnapshot>);
 
    const std::set<BinaryData>& getTxioKeysForScrAddr(BinaryDataRef) const;
    std::map<BinaryDataRef, std::shared_ptr<const TxIOPair>>
@@ -292,6 +330,87 @@ public:
    void commitNewZCs(void);
 
    unsigned getMergeCount(void) const { return mergeCount_; }
+   MempoolStats getStats(void) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+#define FEE_HISTOGRAM_SPACING       1.05f
+#define FEE_HISTOGRAM_BUCKET_COUNT  200
+#define FEE_HISTOGRAM_MAX_ANCESTORS 25
+#define FEE_HISTOGRAM_EXPIRY_SEC    1209600 //2 weeks, as bitcoind
+
+#ifndef UNIT_TESTS
+#define FEE_HISTOGRAM_BLOCK_VSIZE   996000ULL
+#else
+#define FEE_HISTOGRAM_BLOCK_VSIZE   4000ULL
+#endif
+
+class ZcFeeHistogram
+{
+   /***
+   Fee rate histogram of the mempool, updated as zc come and go.
+
+   Buckets are spaced exponentially by FEE_HISTOGRAM_SPACING from 1 sat/vB
+   and carry the vsize of the txs whose effective fee rate falls in them. 
+   The effective fee rate of a tx is the lower of its own rate and the rate
+   of its package (itself and its unconfirmed ancestors), i.e. what a miner
+   gets for including it.
+
+   Estimates walk the buckets from the top, filling blocks of
+   FEE_HISTOGRAM_BLOCK_VSIZE, and return the rate that makes it within the
+   target. Rates are returned in BTC/kvB, as estimatesmartfee does.
+
+   Only txs with fully resolved input values can be accounted for.
+
+   The zc container feeds it from startup, so estimates are available from
+   the first request on, without the node's estimatesmartfee.
+   ***/
+
+private:
+   struct Entry
+   {
+      BinaryData hash_;
+      uint64_t fee_;
+      uint64_t vsize_;
+      uint64_t time_;
+      unsigned bucket_;
+
+      std::set<BinaryData> parents_;
+      std::set<BinaryData> children_;
+   };
+
+   mutable std::mutex mu_;
+
+   //<zcKey, entry>
+   std::map<BinaryData, Entry> entries_;
+   std::map<BinaryData, BinaryData> hashToKey_;
+
+   std::vector<uint64_t> buckets_;
+   uint64_t totalVsize_ = 0;
+
+private:
+   static unsigned getBucket(float);
+   static float getBucketFloor(unsigned);
+
+   void setBucket(Entry&);
+   void rebucketDescendants(const std::set<BinaryData>&);
+   void dropEntry(std::map<BinaryData, Entry>::iterator);
+
+public:
+   ZcFeeHistogram(void);
+
+   bool addTx(const ParsedTx&);
+   void dropTx(BinaryDataRef);
+   void dropTxByHash(BinaryDataRef);
+   void expire(uint64_t);
+   void clear(void);
+
+   //returns -1 if the histogram is empty
+   float estimateFeeByte(unsigned, const std::string&) const;
+   std::map<unsigned, float> getFeeSchedule(const std::string&) const;
+
+   size_t getTxCount(void) const;
+   uint64_t getTotalVsize(void) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
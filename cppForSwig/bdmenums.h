@@ -36,7 +36,10 @@ enum BDMPhase
    BDMPhase_Balance,
    BDMPhase_SearchHashes,
    BDMPhase_ResolveHashes,
-   BDMPhase_Completed
+   BDMPhase_Completed,
+
+   //background integrity checks, the db is serving in the meantime
+   BDMPhase_Verification
 };
 
 enum BDMAction
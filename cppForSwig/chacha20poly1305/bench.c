@@ -2,6 +2,7 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "chacha.h"
 #include "chachapoly_aead.h"
 #include "poly1305.h"
 
@@ -80,6 +81,23 @@ static void run_benchmark(char *name, void (*benchmark)(void *),
   printf("ns\n");
 }
 
+/* best of count runs, in GB/s for bytes processed per run */
+static void run_throughput(const char *name, const char *backend,
+                           void (*benchmark)(void *), void *data, int count,
+                           uint64_t bytes) {
+  int i;
+  double min = HUGE_VAL;
+  for (i = 0; i < count; i++) {
+    double begin = gettimedouble();
+    benchmark(data);
+    double total = gettimedouble() - begin;
+    if (total < min) {
+      min = total;
+    }
+  }
+  printf("%s [%s]: %.2f GB/s\n", name, backend, bytes / min / 1e9);
+}
+
 static void bench_chacha_ivsetup(void *data) {
   struct chacha_ctx *ctx = (struct chacha_ctx *)data;
   int i;
@@ -133,6 +151,75 @@ static void bench_chacha20poly1305_crypt(void *data) {
   }
 }
 
+#define THROUGHPUT_ITER 30
+
+static uint8_t throughput_buffer[1000 * 1000 + 16];
+
+static void bench_chacha_encrypt_bulk(void *data) {
+  struct chacha_ctx *ctx = (struct chacha_ctx *)data;
+  int i;
+  for (i = 0; i < THROUGHPUT_ITER; i++) {
+    chacha_encrypt_bytes(ctx, throughput_buffer, throughput_buffer,
+                         BUFFER_SIZE);
+  }
+}
+
+static void bench_poly1305_auth_bulk(void *data) {
+  uint8_t poly1305_tag[16] = {0};
+  int i;
+  (void)data;
+  for (i = 0; i < THROUGHPUT_ITER; i++) {
+    poly1305_auth(poly1305_tag, throughput_buffer, BUFFER_SIZE, testkey);
+  }
+}
+
+static void bench_chacha20poly1305_crypt_bulk(void *data) {
+  struct chachapolyaead_ctx *ctx = (struct chachapolyaead_ctx *)data;
+  int i;
+  for (i = 0; i < THROUGHPUT_ITER; i++) {
+    chacha20poly1305_crypt(ctx, i, throughput_buffer, throughput_buffer,
+                           BUFFER_SIZE - 4, 4, 1);
+  }
+}
+
+static void run_throughput_benchmarks(void) {
+  struct chacha_ctx ctx_chacha;
+  struct chachapolyaead_ctx aead_ctx;
+  const uint64_t bytes = BUFFER_SIZE * THROUGHPUT_ITER;
+  int backend;
+
+  chacha_keysetup(&ctx_chacha, testkey, 256);
+  chacha_ivsetup(&ctx_chacha, testnonce, NULL);
+  chacha20poly1305_init(&aead_ctx, aead_keys, 64);
+
+  for (backend = 0; backend < CHACHA_BACKEND_COUNT; backend++) {
+    if (chacha_set_backend(backend) < 0)
+      continue;
+    run_throughput("chacha_encrypt 1MB", chacha_backend_name(backend),
+                   bench_chacha_encrypt_bulk, &ctx_chacha, 10, bytes);
+  }
+  chacha_set_backend(CHACHA_BACKEND_BEST);
+
+  for (backend = 0; backend < POLY1305_BACKEND_COUNT; backend++) {
+    if (poly1305_set_backend(backend) < 0)
+      continue;
+    run_throughput("poly1305_auth 1MB", poly1305_backend_name(backend),
+                   bench_poly1305_auth_bulk, NULL, 10, bytes);
+  }
+  poly1305_set_backend(POLY1305_BACKEND_BEST);
+
+  for (backend = 0; backend < CHACHA_BACKEND_COUNT; backend++) {
+    char name[64];
+    if (chacha_set_backend(backend) < 0)
+      continue;
+    snprintf(name, sizeof(name), "%s+%s", chacha_backend_name(backend),
+             poly1305_backend_name(poly1305_get_backend()));
+    run_throughput("chacha20poly1305_crypt 1MB", name,
+                   bench_chacha20poly1305_crypt_bulk, &aead_ctx, 10, bytes);
+  }
+  chacha_set_backend(CHACHA_BACKEND_BEST);
+}
+
 int main(void) {
   struct chacha_ctx ctx_chacha;
   struct chachapolyaead_ctx aead_ctx;
@@ -148,5 +235,6 @@ int main(void) {
                 NULL, &aead_ctx, 20, 4000000);
   run_benchmark("chacha20poly1305_crypt 1MB", bench_chacha20poly1305_crypt,
                 NULL, NULL, &aead_ctx, 20, 30);
+  run_throughput_benchmarks();
   return 0;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@ Public domain.
 */
 
 #include "chacha.h"
+#include "chacha_simd.h"
 
 /* $OpenBSD: chacha.c,v 1.1 2013/11/21 00:45:44 djm Exp $ */
 
@@ -81,7 +82,8 @@ void chacha_ivsetup(chacha_ctx *x, const u8 *iv, const u8 *counter) {
   x->input[15] = U8TO32_LITTLE(iv + 4);
 }
 
-void chacha_encrypt_bytes(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes) {
+static void chacha_encrypt_bytes_scalar(chacha_ctx *x, const u8 *m, u8 *c,
+                                        u32 bytes) {
   u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   u32 j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
   u8 *ctarget = NULL;
@@ -213,3 +215,99 @@ void chacha_encrypt_bytes(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes) {
     m += 64;
   }
 }
+
+/* backend selection, a single int so concurrent first uses are benign */
+
+static int chacha_backend = CHACHA_BACKEND_BEST;
+
+static const char *chacha_backend_names[CHACHA_BACKEND_COUNT] = {
+    "scalar", "sse2", "avx2", "neon"};
+
+int chacha_backend_supported(int backend) {
+  switch (backend) {
+  case CHACHA_BACKEND_SCALAR:
+    return 1;
+
+#ifdef CHACHA_HAVE_SSE2
+  case CHACHA_BACKEND_SSE2:
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("sse2");
+#else
+    return 1; /* baseline on x64 */
+#endif
+#endif
+
+#ifdef CHACHA_HAVE_AVX2
+  case CHACHA_BACKEND_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+
+#ifdef CHACHA_HAVE_NEON
+  case CHACHA_BACKEND_NEON:
+    return 1;
+#endif
+
+  default:
+    return 0;
+  }
+}
+
+static chacha_blocks_fn chacha_backend_blocks(int backend) {
+  switch (backend) {
+#ifdef CHACHA_HAVE_SSE2
+  case CHACHA_BACKEND_SSE2:
+    return chacha_blocks_sse2;
+#endif
+#ifdef CHACHA_HAVE_AVX2
+  case CHACHA_BACKEND_AVX2:
+    return chacha_blocks_avx2;
+#endif
+#ifdef CHACHA_HAVE_NEON
+  case CHACHA_BACKEND_NEON:
+    return chacha_blocks_neon;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+int chacha_set_backend(int backend) {
+  if (backend == CHACHA_BACKEND_BEST) {
+    for (backend = CHACHA_BACKEND_COUNT - 1; backend > 0; --backend) {
+      if (chacha_backend_supported(backend))
+        break;
+    }
+  } else if (!chacha_backend_supported(backend)) {
+    return -1;
+  }
+
+  chacha_backend = backend;
+  return backend;
+}
+
+int chacha_get_backend(void) {
+  if (chacha_backend == CHACHA_BACKEND_BEST)
+    chacha_set_backend(CHACHA_BACKEND_BEST);
+  return chacha_backend;
+}
+
+const char *chacha_backend_name(int backend) {
+  if (backend < 0 || backend >= CHACHA_BACKEND_COUNT)
+    return "unknown";
+  return chacha_backend_names[backend];
+}
+
+void chacha_encrypt_bytes(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes) {
+  /* the vector backends need at least 4 blocks */
+  if (bytes >= 4 * CHACHA_BLOCKLEN) {
+    chacha_blocks_fn blocks = chacha_backend_blocks(chacha_get_backend());
+    if (blocks != NULL) {
+      size_t done = blocks(x->input, m, c, bytes);
+      m += done;
+      c += done;
+      bytes -= (u32)done;
+    }
+  }
+
+  chacha_encrypt_bytes_scalar(x, m, c, bytes);
+}
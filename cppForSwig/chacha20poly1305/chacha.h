@@ -22,6 +22,25 @@ struct chacha_ctx {
 #define CHACHA_STATELEN (CHACHA_NONCELEN + CHACHA_CTRLEN)
 #define CHACHA_BLOCKLEN 64
 
+/*
+ * Keystream backends. chacha_encrypt_bytes runs whole multiples of the
+ * backend's block count through it and finishes with the scalar code, all
+ * backends produce the same output. The best supported backend is picked
+ * on first use, chacha_set_backend can override it (tests, benchmarks).
+ */
+#define CHACHA_BACKEND_SCALAR 0
+#define CHACHA_BACKEND_SSE2 1
+#define CHACHA_BACKEND_AVX2 2
+#define CHACHA_BACKEND_NEON 3
+#define CHACHA_BACKEND_COUNT 4
+#define CHACHA_BACKEND_BEST -1
+
+int chacha_backend_supported(int backend);
+/* returns the selected backend, -1 if it is not supported on this cpu */
+int chacha_set_backend(int backend);
+int chacha_get_backend(void);
+const char *chacha_backend_name(int backend);
+
 #if !defined(_MSC_VER) && !defined(__GNUC__)
 void chacha_keysetup(struct chacha_ctx *x, const uint8_t *k, uint32_t kbits)
     __attribute__((__bounded__(__minbytes__, 2, CHACHA_MINKEYLEN)));
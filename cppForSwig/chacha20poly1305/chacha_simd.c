@@ -0,0 +1,313 @@
+/*
+ * Multi-block ChaCha20 for SSE2 (4 blocks), AVX2 (8 blocks) and NEON
+ * (4 blocks).
+ *
+ * Each vector holds the same state word for all the blocks in flight, so
+ * the double rounds are the scalar quarter rounds applied lane-wise. The
+ * blocks only differ in their counter words (input[12..13], a 64-bit
+ * little endian counter). After the rounds the lanes are transposed back
+ * into consecutive 64 byte blocks and xored with the message.
+ *
+ * The output is bit for bit identical to chacha_encrypt_bytes, m and c may
+ * alias.
+ */
+
+#include "chacha_simd.h"
+
+#define CHACHA_SIMD_DOUBLEROUNDS(QR, x)                                        \
+  do {                                                                         \
+    int i_;                                                                    \
+    for (i_ = 0; i_ < 10; ++i_) {                                              \
+      QR(x[0], x[4], x[8], x[12]);                                             \
+      QR(x[1], x[5], x[9], x[13]);                                             \
+      QR(x[2], x[6], x[10], x[14]);                                            \
+      QR(x[3], x[7], x[11], x[15]);                                            \
+      QR(x[0], x[5], x[10], x[15]);                                            \
+      QR(x[1], x[6], x[11], x[12]);                                            \
+      QR(x[2], x[7], x[8], x[13]);                                             \
+      QR(x[3], x[4], x[9], x[14]);                                             \
+    }                                                                          \
+  } while (0)
+
+static uint64_t chacha_simd_counter(const uint32_t input[16]) {
+  return (uint64_t)input[12] | ((uint64_t)input[13] << 32);
+}
+
+static void chacha_simd_set_counter(uint32_t input[16], uint64_t ctr) {
+  input[12] = (uint32_t)ctr;
+  input[13] = (uint32_t)(ctr >> 32);
+}
+
+/******************************************************************************/
+#ifdef CHACHA_HAVE_SSE2
+#include <emmintrin.h>
+
+/*
+ * SSE2 is baseline on x86_64 but not on i386, where the backend is only
+ * picked once the cpu check passes
+ */
+#if defined(__GNUC__)
+#define CHACHA_SSE2 __attribute__((target("sse2")))
+#else
+#define CHACHA_SSE2
+#endif
+
+#define ROTL_SSE2(v, n)                                                        \
+  _mm_or_si128(_mm_slli_epi32((v), (n)), _mm_srli_epi32((v), 32 - (n)))
+
+#define QR_SSE2(a, b, c, d)                                                    \
+  do {                                                                         \
+    a = _mm_add_epi32(a, b);                                                   \
+    d = ROTL_SSE2(_mm_xor_si128(d, a), 16);                                    \
+    c = _mm_add_epi32(c, d);                                                   \
+    b = ROTL_SSE2(_mm_xor_si128(b, c), 12);                                    \
+    a = _mm_add_epi32(a, b);                                                   \
+    d = ROTL_SSE2(_mm_xor_si128(d, a), 8);                                     \
+    c = _mm_add_epi32(c, d);                                                   \
+    b = ROTL_SSE2(_mm_xor_si128(b, c), 7);                                     \
+  } while (0)
+
+/* words w..w+3 of the 4 blocks, xored into 16 bytes of each block */
+CHACHA_SSE2 static void chacha_sse2_store(__m128i a, __m128i b, __m128i c,
+                                          __m128i d, const uint8_t *m,
+                                          uint8_t *out) {
+  __m128i t0 = _mm_unpacklo_epi32(a, b);
+  __m128i t1 = _mm_unpacklo_epi32(c, d);
+  __m128i t2 = _mm_unpackhi_epi32(a, b);
+  __m128i t3 = _mm_unpackhi_epi32(c, d);
+  __m128i blk[4];
+  int i;
+
+  blk[0] = _mm_unpacklo_epi64(t0, t1);
+  blk[1] = _mm_unpackhi_epi64(t0, t1);
+  blk[2] = _mm_unpacklo_epi64(t2, t3);
+  blk[3] = _mm_unpackhi_epi64(t2, t3);
+
+  for (i = 0; i < 4; ++i) {
+    __m128i msg = _mm_loadu_si128((const __m128i *)(m + 64 * i));
+    _mm_storeu_si128((__m128i *)(out + 64 * i), _mm_xor_si128(msg, blk[i]));
+  }
+}
+
+CHACHA_SSE2 size_t chacha_blocks_sse2(uint32_t input[16], const uint8_t *m,
+                                      uint8_t *c, size_t bytes) {
+  uint64_t ctr = chacha_simd_counter(input);
+  size_t done = 0;
+  __m128i j[16], x[16];
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    j[i] = _mm_set1_epi32((int)input[i]);
+
+  while (bytes - done >= 256) {
+    j[12] = _mm_set_epi32((int)(uint32_t)(ctr + 3), (int)(uint32_t)(ctr + 2),
+                          (int)(uint32_t)(ctr + 1), (int)(uint32_t)ctr);
+    j[13] = _mm_set_epi32(
+        (int)(uint32_t)((ctr + 3) >> 32), (int)(uint32_t)((ctr + 2) >> 32),
+        (int)(uint32_t)((ctr + 1) >> 32), (int)(uint32_t)(ctr >> 32));
+
+    for (i = 0; i < 16; ++i)
+      x[i] = j[i];
+    CHACHA_SIMD_DOUBLEROUNDS(QR_SSE2, x);
+    for (i = 0; i < 16; ++i)
+      x[i] = _mm_add_epi32(x[i], j[i]);
+
+    for (i = 0; i < 4; ++i) {
+      chacha_sse2_store(x[4 * i], x[4 * i + 1], x[4 * i + 2], x[4 * i + 3],
+                        m + done + 16 * i, c + done + 16 * i);
+    }
+
+    ctr += 4;
+    done += 256;
+  }
+
+  chacha_simd_set_counter(input, ctr);
+  return done;
+}
+#endif /* CHACHA_HAVE_SSE2 */
+
+/******************************************************************************/
+#ifdef CHACHA_HAVE_AVX2
+#include <immintrin.h>
+
+#define CHACHA_AVX2 __attribute__((target("avx2")))
+
+#define ROTL_AVX2(v, n)                                                        \
+  _mm256_or_si256(_mm256_slli_epi32((v), (n)), _mm256_srli_epi32((v), 32 - (n)))
+
+/* 16 and 8 bit rotations are byte shuffles */
+#define QR_AVX2(a, b, c, d)                                                    \
+  do {                                                                         \
+    a = _mm256_add_epi32(a, b);                                                \
+    d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);                    \
+    c = _mm256_add_epi32(c, d);                                                \
+    b = ROTL_AVX2(_mm256_xor_si256(b, c), 12);                                 \
+    a = _mm256_add_epi32(a, b);                                                \
+    d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8);                     \
+    c = _mm256_add_epi32(c, d);                                                \
+    b = ROTL_AVX2(_mm256_xor_si256(b, c), 7);                                  \
+  } while (0)
+
+/*
+ * words w..w+3 of the 8 blocks: 128 bit lane 0 holds blocks 0-3, lane 1
+ * blocks 4-7, the unpacks transpose both lanes independently
+ */
+CHACHA_AVX2 static void chacha_avx2_transpose(__m256i a, __m256i b, __m256i c,
+                                              __m256i d, __m256i out[4]) {
+  __m256i t0 = _mm256_unpacklo_epi32(a, b);
+  __m256i t1 = _mm256_unpacklo_epi32(c, d);
+  __m256i t2 = _mm256_unpackhi_epi32(a, b);
+  __m256i t3 = _mm256_unpackhi_epi32(c, d);
+
+  out[0] = _mm256_unpacklo_epi64(t0, t1);
+  out[1] = _mm256_unpackhi_epi64(t0, t1);
+  out[2] = _mm256_unpacklo_epi64(t2, t3);
+  out[3] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+/* words w..w+7 of the 8 blocks, xored into 32 bytes of each block */
+CHACHA_AVX2 static void chacha_avx2_store(const __m256i lo[4],
+                                          const __m256i hi[4],
+                                          const uint8_t *m, uint8_t *out) {
+  int i;
+
+  for (i = 0; i < 4; ++i) {
+    __m256i blk = _mm256_permute2x128_si256(lo[i], hi[i], 0x20);
+    __m256i msg = _mm256_loadu_si256((const __m256i *)(m + 64 * i));
+    _mm256_storeu_si256((__m256i *)(out + 64 * i),
+                        _mm256_xor_si256(msg, blk));
+
+    blk = _mm256_permute2x128_si256(lo[i], hi[i], 0x31);
+    msg = _mm256_loadu_si256((const __m256i *)(m + 64 * (i + 4)));
+    _mm256_storeu_si256((__m256i *)(out + 64 * (i + 4)),
+                        _mm256_xor_si256(msg, blk));
+  }
+}
+
+CHACHA_AVX2 size_t chacha_blocks_avx2(uint32_t input[16], const uint8_t *m,
+                                      uint8_t *c, size_t bytes) {
+  const __m256i rot16 = _mm256_set_epi8(
+      13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9,
+      8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+  const __m256i rot8 = _mm256_set_epi8(
+      14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, 14, 13, 12, 15, 10,
+      9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+  uint64_t ctr = chacha_simd_counter(input);
+  size_t done = 0;
+  __m256i j[16], x[16], lo[4], hi[4];
+  uint32_t ctrlo[8], ctrhi[8];
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    j[i] = _mm256_set1_epi32((int)input[i]);
+
+  while (bytes - done >= 512) {
+    for (i = 0; i < 8; ++i) {
+      ctrlo[i] = (uint32_t)(ctr + i);
+      ctrhi[i] = (uint32_t)((ctr + i) >> 32);
+    }
+    j[12] = _mm256_loadu_si256((const __m256i *)ctrlo);
+    j[13] = _mm256_loadu_si256((const __m256i *)ctrhi);
+
+    for (i = 0; i < 16; ++i)
+      x[i] = j[i];
+    CHACHA_SIMD_DOUBLEROUNDS(QR_AVX2, x);
+    for (i = 0; i < 16; ++i)
+      x[i] = _mm256_add_epi32(x[i], j[i]);
+
+    /* bytes 0-31 of each block, then bytes 32-63 */
+    chacha_avx2_transpose(x[0], x[1], x[2], x[3], lo);
+    chacha_avx2_transpose(x[4], x[5], x[6], x[7], hi);
+    chacha_avx2_store(lo, hi, m + done, c + done);
+
+    chacha_avx2_transpose(x[8], x[9], x[10], x[11], lo);
+    chacha_avx2_transpose(x[12], x[13], x[14], x[15], hi);
+    chacha_avx2_store(lo, hi, m + done + 32, c + done + 32);
+
+    ctr += 8;
+    done += 512;
+  }
+
+  _mm256_zeroupper();
+  chacha_simd_set_counter(input, ctr);
+  return done;
+}
+#endif /* CHACHA_HAVE_AVX2 */
+
+/******************************************************************************/
+#ifdef CHACHA_HAVE_NEON
+#include <arm_neon.h>
+
+#define ROTL_NEON(v, n) vsriq_n_u32(vshlq_n_u32((v), (n)), (v), 32 - (n))
+#define ROTL16_NEON(v)                                                         \
+  vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(v)))
+
+#define QR_NEON(a, b, c, d)                                                    \
+  do {                                                                         \
+    a = vaddq_u32(a, b);                                                       \
+    d = ROTL16_NEON(veorq_u32(d, a));                                          \
+    c = vaddq_u32(c, d);                                                       \
+    b = ROTL_NEON(veorq_u32(b, c), 12);                                        \
+    a = vaddq_u32(a, b);                                                       \
+    d = ROTL_NEON(veorq_u32(d, a), 8);                                         \
+    c = vaddq_u32(c, d);                                                       \
+    b = ROTL_NEON(veorq_u32(b, c), 7);                                         \
+  } while (0)
+
+/* words w..w+3 of the 4 blocks, xored into 16 bytes of each block */
+static void chacha_neon_store(uint32x4_t a, uint32x4_t b, uint32x4_t c,
+                              uint32x4_t d, const uint8_t *m, uint8_t *out) {
+  uint32x4x2_t ab = vtrnq_u32(a, b);
+  uint32x4x2_t cd = vtrnq_u32(c, d);
+  uint32x4_t blk[4];
+  int i;
+
+  blk[0] = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+  blk[1] = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+  blk[2] = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+  blk[3] = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+
+  for (i = 0; i < 4; ++i) {
+    uint8x16_t msg = vld1q_u8(m + 64 * i);
+    vst1q_u8(out + 64 * i, veorq_u8(msg, vreinterpretq_u8_u32(blk[i])));
+  }
+}
+
+size_t chacha_blocks_neon(uint32_t input[16], const uint8_t *m, uint8_t *c,
+                          size_t bytes) {
+  uint64_t ctr = chacha_simd_counter(input);
+  size_t done = 0;
+  uint32x4_t j[16], x[16];
+  uint32_t ctrlo[4], ctrhi[4];
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    j[i] = vdupq_n_u32(input[i]);
+
+  while (bytes - done >= 256) {
+    for (i = 0; i < 4; ++i) {
+      ctrlo[i] = (uint32_t)(ctr + i);
+      ctrhi[i] = (uint32_t)((ctr + i) >> 32);
+    }
+    j[12] = vld1q_u32(ctrlo);
+    j[13] = vld1q_u32(ctrhi);
+
+    for (i = 0; i < 16; ++i)
+      x[i] = j[i];
+    CHACHA_SIMD_DOUBLEROUNDS(QR_NEON, x);
+    for (i = 0; i < 16; ++i)
+      x[i] = vaddq_u32(x[i], j[i]);
+
+    for (i = 0; i < 4; ++i) {
+      chacha_neon_store(x[4 * i], x[4 * i + 1], x[4 * i + 2], x[4 * i + 3],
+                        m + done + 16 * i, c + done + 16 * i);
+    }
+
+    ctr += 4;
+    done += 256;
+  }
+
+  chacha_simd_set_counter(input, ctr);
+  return done;
+}
+#endif /* CHACHA_HAVE_NEON */
@@ -0,0 +1,48 @@
+/*
+ * Multi-block ChaCha20 keystream generators, see chacha_simd.c.
+ * Internal to chacha.c, use chacha_set_backend() to select one.
+ */
+
+#ifndef CHACHA_SIMD_H
+#define CHACHA_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHACHA_HAVE_SSE2 1
+#define CHACHA_HAVE_AVX2 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#define CHACHA_HAVE_SSE2 1
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) &&                          \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CHACHA_HAVE_NEON 1
+#endif
+
+/*
+ * Xor as many whole multiples of the backend's lane count blocks of
+ * keystream as fit in bytes into c, advance the block counter in
+ * input[12..13] accordingly. Returns the number of bytes processed, the
+ * caller finishes the tail with the scalar code.
+ */
+typedef size_t (*chacha_blocks_fn)(uint32_t input[16], const uint8_t *m,
+                                   uint8_t *c, size_t bytes);
+
+#ifdef CHACHA_HAVE_SSE2
+size_t chacha_blocks_sse2(uint32_t input[16], const uint8_t *m, uint8_t *c,
+                          size_t bytes);
+#endif
+
+#ifdef CHACHA_HAVE_AVX2
+size_t chacha_blocks_avx2(uint32_t input[16], const uint8_t *m, uint8_t *c,
+                          size_t bytes);
+#endif
+
+#ifdef CHACHA_HAVE_NEON
+size_t chacha_blocks_neon(uint32_t input[16], const uint8_t *m, uint8_t *c,
+                          size_t bytes);
+#endif
+
+#endif /* CHACHA_SIMD_H */
@@ -6,6 +6,7 @@
 /* $OpenBSD: poly1305.c,v 1.3 2013/12/19 22:57:13 djm Exp $ */
 
 #include "poly1305.h"
+#include "poly1305_simd.h"
 
 #define mul32x32_64(a, b) ((uint64_t)(a) * (b))
 
@@ -21,8 +22,14 @@
     (p)[3] = (uint8_t)((v) >> 24);                                             \
   } while (0)
 
-void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m,
-                   size_t inlen, const unsigned char key[POLY1305_KEYLEN]) {
+/*
+ * blocks, when set, absorbs the leading groups of full blocks before the
+ * scalar loop takes over
+ */
+static void poly1305_auth_donna32(unsigned char out[POLY1305_TAGLEN],
+                                  const unsigned char *m, size_t inlen,
+                                  const unsigned char key[POLY1305_KEYLEN],
+                                  poly1305_blocks_fn blocks) {
   uint32_t t0, t1, t2, t3;
   uint32_t h0, h1, h2, h3, h4;
   uint32_t r0, r1, r2, r3, r4;
@@ -67,6 +74,20 @@ void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m,
   h3 = 0;
   h4 = 0;
 
+  if (blocks != NULL) {
+    uint32_t hv[5] = {0, 0, 0, 0, 0};
+    const uint32_t rv[5] = {r0, r1, r2, r3, r4};
+    size_t done = blocks(hv, rv, m, inlen);
+
+    h0 = hv[0];
+    h1 = hv[1];
+    h2 = hv[2];
+    h3 = hv[3];
+    h4 = hv[4];
+    m += done;
+    inlen -= done;
+  }
+
   /* full blocks */
   if (inlen < 16)
     goto poly1305_donna_atmost15bytes;
@@ -196,3 +217,234 @@ poly1305_donna_finish:
   f3 += (f2 >> 32);
   U32TO8_LE(&out[12], f3);
 }
+
+/*
+ * poly1305-donna-64.h from https://github.com/floodyberry/poly1305-donna
+ */
+
+#if defined(__SIZEOF_INT128__)
+#define POLY1305_HAVE_DONNA64 1
+
+typedef unsigned __int128 poly1305_u128;
+
+#define U8TO64_LE(p)                                                           \
+  ((uint64_t)U8TO32_LE(p) | ((uint64_t)U8TO32_LE((p) + 4) << 32))
+
+#define U64TO8_LE(p, v)                                                        \
+  do {                                                                         \
+    U32TO8_LE((p), (uint32_t)(v));                                             \
+    U32TO8_LE((p) + 4, (uint32_t)((v) >> 32));                                 \
+  } while (0)
+
+#define MUL128(a, b) ((poly1305_u128)(a) * (b))
+
+static void poly1305_blocks_donna64(uint64_t h[3], const uint64_t r[3],
+                                    const unsigned char *m, size_t bytes,
+                                    uint64_t hibit) {
+  const uint64_t r0 = r[0], r1 = r[1], r2 = r[2];
+  const uint64_t s1 = r1 * (5 << 2);
+  const uint64_t s2 = r2 * (5 << 2);
+  uint64_t h0 = h[0], h1 = h[1], h2 = h[2];
+  uint64_t c, t0, t1;
+  poly1305_u128 d0, d1, d2;
+
+  while (bytes >= 16) {
+    t0 = U8TO64_LE(m + 0);
+    t1 = U8TO64_LE(m + 8);
+
+    h0 += t0 & 0xfffffffffff;
+    h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffff;
+    h2 += ((t1 >> 24) & 0x3ffffffffff) | hibit;
+
+    d0 = MUL128(h0, r0) + MUL128(h1, s2) + MUL128(h2, s1);
+    d1 = MUL128(h0, r1) + MUL128(h1, r0) + MUL128(h2, s2);
+    d2 = MUL128(h0, r2) + MUL128(h1, r1) + MUL128(h2, r0);
+
+    c = (uint64_t)(d0 >> 44);
+    h0 = (uint64_t)d0 & 0xfffffffffff;
+    d1 += c;
+    c = (uint64_t)(d1 >> 44);
+    h1 = (uint64_t)d1 & 0xfffffffffff;
+    d2 += c;
+    c = (uint64_t)(d2 >> 42);
+    h2 = (uint64_t)d2 & 0x3ffffffffff;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= 0xfffffffffff;
+    h1 += c;
+
+    m += 16;
+    bytes -= 16;
+  }
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+}
+
+static void poly1305_auth_donna64(unsigned char out[POLY1305_TAGLEN],
+                                  const unsigned char *m, size_t inlen,
+                                  const unsigned char key[POLY1305_KEYLEN]) {
+  uint64_t r[3], h[3] = {0, 0, 0};
+  uint64_t h0, h1, h2, g0, g1, g2, c, t0, t1;
+  unsigned char mp[16];
+  size_t full = inlen & ~(size_t)15;
+  size_t j;
+
+  /* clamp key */
+  t0 = U8TO64_LE(key + 0);
+  t1 = U8TO64_LE(key + 8);
+  r[0] = t0 & 0xffc0fffffff;
+  r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffff;
+  r[2] = (t1 >> 24) & 0x00ffffffc0f;
+
+  poly1305_blocks_donna64(h, r, m, full, (uint64_t)1 << 40);
+
+  /* final bytes */
+  if (inlen != full) {
+    for (j = 0; j < inlen - full; j++)
+      mp[j] = m[full + j];
+    mp[j++] = 1;
+    for (; j < 16; j++)
+      mp[j] = 0;
+    poly1305_blocks_donna64(h, r, mp, 16, 0);
+  }
+
+  /* fully carry h */
+  h0 = h[0];
+  h1 = h[1];
+  h2 = h[2];
+
+  c = h1 >> 44;
+  h1 &= 0xfffffffffff;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= 0x3ffffffffff;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= 0xfffffffffff;
+  h1 += c;
+  c = h1 >> 44;
+  h1 &= 0xfffffffffff;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= 0x3ffffffffff;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= 0xfffffffffff;
+  h1 += c;
+
+  /* compute h + -p */
+  g0 = h0 + 5;
+  c = g0 >> 44;
+  g0 &= 0xfffffffffff;
+  g1 = h1 + c;
+  c = g1 >> 44;
+  g1 &= 0xfffffffffff;
+  g2 = h2 + c - ((uint64_t)1 << 42);
+
+  /* select h if h < p, or h + -p if h >= p */
+  c = (g2 >> 63) - 1;
+  g0 &= c;
+  g1 &= c;
+  g2 &= c;
+  c = ~c;
+  h0 = (h0 & c) | g0;
+  h1 = (h1 & c) | g1;
+  h2 = (h2 & c) | g2;
+
+  /* h = (h + pad) */
+  t0 = U8TO64_LE(key + 16);
+  t1 = U8TO64_LE(key + 24);
+  h0 += t0 & 0xfffffffffff;
+  c = h0 >> 44;
+  h0 &= 0xfffffffffff;
+  h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffff) + c;
+  c = h1 >> 44;
+  h1 &= 0xfffffffffff;
+  h2 += ((t1 >> 24) & 0x3ffffffffff) + c;
+  h2 &= 0x3ffffffffff;
+
+  h0 = h0 | (h1 << 44);
+  h1 = (h1 >> 20) | (h2 << 24);
+
+  U64TO8_LE(&out[0], h0);
+  U64TO8_LE(&out[8], h1);
+}
+#endif /* __SIZEOF_INT128__ */
+
+/* backend selection */
+
+static int poly1305_backend = POLY1305_BACKEND_BEST;
+
+int poly1305_backend_supported(int backend) {
+  switch (backend) {
+  case POLY1305_BACKEND_DONNA32:
+    return 1;
+#ifdef POLY1305_HAVE_DONNA64
+  case POLY1305_BACKEND_DONNA64:
+    return 1;
+#endif
+#ifdef POLY1305_HAVE_AVX2
+  case POLY1305_BACKEND_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return 0;
+  }
+}
+
+int poly1305_set_backend(int backend) {
+  /*
+   * donna64 only wins with some compilers and cpus, it has to be picked
+   * explicitly
+   */
+  if (backend == POLY1305_BACKEND_BEST) {
+    backend = poly1305_backend_supported(POLY1305_BACKEND_AVX2)
+                  ? POLY1305_BACKEND_AVX2
+                  : POLY1305_BACKEND_DONNA32;
+  } else if (!poly1305_backend_supported(backend)) {
+    return -1;
+  }
+
+  poly1305_backend = backend;
+  return backend;
+}
+
+int poly1305_get_backend(void) {
+  if (poly1305_backend == POLY1305_BACKEND_BEST)
+    poly1305_set_backend(POLY1305_BACKEND_BEST);
+  return poly1305_backend;
+}
+
+const char *poly1305_backend_name(int backend) {
+  switch (backend) {
+  case POLY1305_BACKEND_DONNA32:
+    return "donna32";
+  case POLY1305_BACKEND_DONNA64:
+    return "donna64";
+  case POLY1305_BACKEND_AVX2:
+    return "avx2";
+  default:
+    return "unknown";
+  }
+}
+
+void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m,
+                   size_t inlen, const unsigned char key[POLY1305_KEYLEN]) {
+  switch (poly1305_get_backend()) {
+#ifdef POLY1305_HAVE_DONNA64
+  case POLY1305_BACKEND_DONNA64:
+    poly1305_auth_donna64(out, m, inlen, key);
+    return;
+#endif
+#ifdef POLY1305_HAVE_AVX2
+  case POLY1305_BACKEND_AVX2:
+    poly1305_auth_donna32(out, m, inlen, key, poly1305_blocks_avx2);
+    return;
+#endif
+  default:
+    poly1305_auth_donna32(out, m, inlen, key, NULL);
+    return;
+  }
+}
@@ -14,6 +14,25 @@
 #define POLY1305_KEYLEN 32
 #define POLY1305_TAGLEN 16
 
+/*
+ * poly1305_auth backends: donna32 uses 26 bit limbs and 32x32->64 bit
+ * products, donna64 44 bit limbs and 64x64->128 bit products (needs a
+ * compiler with unsigned __int128). avx2 runs donna32 on 4 blocks at a time
+ * for messages of 64 bytes and more. avx2 is picked when the cpu has it,
+ * donna32 otherwise.
+ */
+#define POLY1305_BACKEND_DONNA32 0
+#define POLY1305_BACKEND_DONNA64 1
+#define POLY1305_BACKEND_AVX2 2
+#define POLY1305_BACKEND_COUNT 3
+#define POLY1305_BACKEND_BEST -1
+
+int poly1305_backend_supported(int backend);
+/* returns the selected backend, -1 if it is not supported */
+int poly1305_set_backend(int backend);
+int poly1305_get_backend(void);
+const char *poly1305_backend_name(int backend);
+
 #if !defined(_MSC_VER) && !defined(__GNUC__)
 void poly1305_auth(uint8_t out[POLY1305_TAGLEN], const uint8_t *m, size_t inlen,
                    const uint8_t key[POLY1305_KEYLEN])
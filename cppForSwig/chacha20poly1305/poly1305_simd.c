@@ -0,0 +1,214 @@
+/*
+ * Multi-block Poly1305 for AVX2 (4 blocks).
+ *
+ * Poly1305 evaluates h = (...((m1 * r + m2) * r + m3) * r ...) mod 2^130-5,
+ * one block at a time. Split over 4 lanes, lane i takes blocks i, i+4,
+ * i+8... and multiplies by r^4 between them, so each lane is a Horner
+ * evaluation in r^4. The last group multiplies the lanes by r^4, r^3, r^2
+ * and r instead, which lines every block up with the power of r it gets in
+ * the sequential evaluation, and the lanes are summed back into h.
+ *
+ * Limbs are the 26 bit ones of poly1305-donna-32, one 64 bit lane per
+ * block so the 32x32->64 bit products of the scalar code map to
+ * _mm256_mul_epu32. The output is bit for bit identical to the scalar code.
+ */
+
+#include "poly1305_simd.h"
+
+#ifdef POLY1305_HAVE_AVX2
+
+/* a * b mod 2^130-5, carried back to 26 bit limbs */
+static void poly1305_simd_mul(uint32_t out[5], const uint32_t a[5],
+                              const uint32_t b[5]) {
+  const uint32_t s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+  uint64_t t[5], c;
+  uint32_t h0, h1, h2, h3, h4;
+
+  t[0] = (uint64_t)a[0] * b[0] + (uint64_t)a[1] * s4 + (uint64_t)a[2] * s3 +
+         (uint64_t)a[3] * s2 + (uint64_t)a[4] * s1;
+  t[1] = (uint64_t)a[0] * b[1] + (uint64_t)a[1] * b[0] + (uint64_t)a[2] * s4 +
+         (uint64_t)a[3] * s3 + (uint64_t)a[4] * s2;
+  t[2] = (uint64_t)a[0] * b[2] + (uint64_t)a[1] * b[1] +
+         (uint64_t)a[2] * b[0] + (uint64_t)a[3] * s4 + (uint64_t)a[4] * s3;
+  t[3] = (uint64_t)a[0] * b[3] + (uint64_t)a[1] * b[2] +
+         (uint64_t)a[2] * b[1] + (uint64_t)a[3] * b[0] + (uint64_t)a[4] * s4;
+  t[4] = (uint64_t)a[0] * b[4] + (uint64_t)a[1] * b[3] +
+         (uint64_t)a[2] * b[2] + (uint64_t)a[3] * b[1] + (uint64_t)a[4] * b[0];
+
+  h0 = (uint32_t)t[0] & 0x3ffffff;
+  c = t[0] >> 26;
+  t[1] += c;
+  h1 = (uint32_t)t[1] & 0x3ffffff;
+  c = t[1] >> 26;
+  t[2] += c;
+  h2 = (uint32_t)t[2] & 0x3ffffff;
+  c = t[2] >> 26;
+  t[3] += c;
+  h3 = (uint32_t)t[3] & 0x3ffffff;
+  c = t[3] >> 26;
+  t[4] += c;
+  h4 = (uint32_t)t[4] & 0x3ffffff;
+  c = t[4] >> 26;
+  h0 += (uint32_t)c * 5;
+  h1 += h0 >> 26;
+  h0 &= 0x3ffffff;
+
+  out[0] = h0;
+  out[1] = h1;
+  out[2] = h2;
+  out[3] = h3;
+  out[4] = h4;
+}
+
+/******************************************************************************/
+#include <immintrin.h>
+
+#define POLY1305_AVX2 __attribute__((target("avx2")))
+
+/* h = h * r mod 2^130-5 lane-wise, s holds 5 * r for limbs 1 to 4 */
+#define POLY1305_MUL_AVX2(h, r, s)                                             \
+  do {                                                                         \
+    __m256i d0_, d1_, d2_, d3_, d4_, c_;                                       \
+    d0_ = _mm256_add_epi64(                                                    \
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(h[0], r[0]),        \
+                                          _mm256_mul_epu32(h[1], s[4])),       \
+                         _mm256_add_epi64(_mm256_mul_epu32(h[2], s[3]),        \
+                                          _mm256_mul_epu32(h[3], s[2]))),      \
+        _mm256_mul_epu32(h[4], s[1]));                                         \
+    d1_ = _mm256_add_epi64(                                                    \
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(h[0], r[1]),        \
+                                          _mm256_mul_epu32(h[1], r[0])),       \
+                         _mm256_add_epi64(_mm256_mul_epu32(h[2], s[4]),        \
+                                          _mm256_mul_epu32(h[3], s[3]))),      \
+        _mm256_mul_epu32(h[4], s[2]));                                         \
+    d2_ = _mm256_add_epi64(                                                    \
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(h[0], r[2]),        \
+                                          _mm256_mul_epu32(h[1], r[1])),       \
+                         _mm256_add_epi64(_mm256_mul_epu32(h[2], r[0]),        \
+                                          _mm256_mul_epu32(h[3], s[4]))),      \
+        _mm256_mul_epu32(h[4], s[3]));                                         \
+    d3_ = _mm256_add_epi64(                                                    \
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(h[0], r[3]),        \
+                                          _mm256_mul_epu32(h[1], r[2])),       \
+                         _mm256_add_epi64(_mm256_mul_epu32(h[2], r[1]),        \
+                                          _mm256_mul_epu32(h[3], r[0]))),      \
+        _mm256_mul_epu32(h[4], s[4]));                                         \
+    d4_ = _mm256_add_epi64(                                                    \
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(h[0], r[4]),        \
+                                          _mm256_mul_epu32(h[1], r[3])),       \
+                         _mm256_add_epi64(_mm256_mul_epu32(h[2], r[2]),        \
+                                          _mm256_mul_epu32(h[3], r[1]))),      \
+        _mm256_mul_epu32(h[4], r[0]));                                         \
+                                                                               \
+    c_ = _mm256_srli_epi64(d0_, 26);                                           \
+    h[0] = _mm256_and_si256(d0_, mask);                                        \
+    d1_ = _mm256_add_epi64(d1_, c_);                                           \
+    c_ = _mm256_srli_epi64(d1_, 26);                                           \
+    h[1] = _mm256_and_si256(d1_, mask);                                        \
+    d2_ = _mm256_add_epi64(d2_, c_);                                           \
+    c_ = _mm256_srli_epi64(d2_, 26);                                           \
+    h[2] = _mm256_and_si256(d2_, mask);                                        \
+    d3_ = _mm256_add_epi64(d3_, c_);                                           \
+    c_ = _mm256_srli_epi64(d3_, 26);                                           \
+    h[3] = _mm256_and_si256(d3_, mask);                                        \
+    d4_ = _mm256_add_epi64(d4_, c_);                                           \
+    c_ = _mm256_srli_epi64(d4_, 26);                                           \
+    h[4] = _mm256_and_si256(d4_, mask);                                        \
+    h[0] = _mm256_add_epi64(h[0],                                              \
+                            _mm256_add_epi64(c_, _mm256_slli_epi64(c_, 2)));   \
+    c_ = _mm256_srli_epi64(h[0], 26);                                          \
+    h[0] = _mm256_and_si256(h[0], mask);                                       \
+    h[1] = _mm256_add_epi64(h[1], c_);                                         \
+  } while (0)
+
+POLY1305_AVX2 size_t poly1305_blocks_avx2(uint32_t h[5], const uint32_t r[5],
+                                          const unsigned char *m,
+                                          size_t bytes) {
+  const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+  const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+  const size_t groups = bytes / 64;
+  uint32_t r2[5], r3[5], r4[5];
+  __m256i vh[5], vr4[5], vs4[5], vrl[5], vsl[5];
+  uint64_t lanes[4], t[5], c;
+  size_t g;
+  int i;
+
+  if (groups == 0)
+    return 0;
+
+  poly1305_simd_mul(r2, r, r);
+  poly1305_simd_mul(r3, r2, r);
+  poly1305_simd_mul(r4, r3, r);
+
+  /* r^4 in every lane, the last group gets r^4, r^3, r^2, r */
+  for (i = 0; i < 5; ++i) {
+    vr4[i] = _mm256_set1_epi64x(r4[i]);
+    vs4[i] = _mm256_set1_epi64x((uint64_t)r4[i] * 5);
+    vrl[i] = _mm256_set_epi64x(r[i], r2[i], r3[i], r4[i]);
+    vsl[i] = _mm256_set_epi64x((uint64_t)r[i] * 5, (uint64_t)r2[i] * 5,
+                               (uint64_t)r3[i] * 5, (uint64_t)r4[i] * 5);
+  }
+
+  /* the running h goes in with the first block */
+  for (i = 0; i < 5; ++i)
+    vh[i] = _mm256_set_epi64x(0, 0, 0, h[i]);
+
+  for (g = 0; g < groups; ++g, m += 64) {
+    /* bytes 0-7 and 8-15 of the 4 blocks, in block order */
+    __m256i a = _mm256_loadu_si256((const __m256i *)m);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(m + 32));
+    __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b),
+                                          _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b),
+                                          _MM_SHUFFLE(3, 1, 2, 0));
+
+    vh[0] = _mm256_add_epi64(vh[0], _mm256_and_si256(lo, mask));
+    vh[1] = _mm256_add_epi64(
+        vh[1], _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask));
+    vh[2] = _mm256_add_epi64(
+        vh[2], _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52),
+                                                _mm256_slli_epi64(hi, 12)),
+                                mask));
+    vh[3] = _mm256_add_epi64(
+        vh[3], _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask));
+    vh[4] = _mm256_add_epi64(
+        vh[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit));
+
+    if (g + 1 < groups)
+      POLY1305_MUL_AVX2(vh, vr4, vs4);
+    else
+      POLY1305_MUL_AVX2(vh, vrl, vsl);
+  }
+
+  /* sum the lanes */
+  for (i = 0; i < 5; ++i) {
+    _mm256_storeu_si256((__m256i *)lanes, vh[i]);
+    t[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  _mm256_zeroupper();
+
+  c = t[0] >> 26;
+  t[0] &= 0x3ffffff;
+  t[1] += c;
+  c = t[1] >> 26;
+  t[1] &= 0x3ffffff;
+  t[2] += c;
+  c = t[2] >> 26;
+  t[2] &= 0x3ffffff;
+  t[3] += c;
+  c = t[3] >> 26;
+  t[3] &= 0x3ffffff;
+  t[4] += c;
+  c = t[4] >> 26;
+  t[4] &= 0x3ffffff;
+  t[0] += c * 5;
+  c = t[0] >> 26;
+  t[0] &= 0x3ffffff;
+  t[1] += c;
+
+  for (i = 0; i < 5; ++i)
+    h[i] = (uint32_t)t[i];
+
+  return groups * 64;
+}
+#endif /* POLY1305_HAVE_AVX2 */
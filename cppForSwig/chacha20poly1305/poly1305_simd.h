@@ -0,0 +1,30 @@
+/*
+ * Multi-block Poly1305, see poly1305_simd.c.
+ * Internal to poly1305.c, use poly1305_set_backend() to select one.
+ */
+
+#ifndef POLY1305_SIMD_H
+#define POLY1305_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POLY1305_HAVE_AVX2 1
+#endif
+
+/*
+ * Absorb as many whole groups of 4 full 16 byte blocks as fit in bytes into
+ * h, in the 26 bit limbs of poly1305-donna-32 (r is the clamped key in the
+ * same limbs). Returns the number of bytes processed, the caller finishes
+ * the remaining blocks and the tag with the scalar code.
+ */
+typedef size_t (*poly1305_blocks_fn)(uint32_t h[5], const uint32_t r[5],
+                                     const unsigned char *m, size_t bytes);
+
+#ifdef POLY1305_HAVE_AVX2
+size_t poly1305_blocks_avx2(uint32_t h[5], const uint32_t r[5],
+                            const unsigned char *m, size_t bytes);
+#endif
+
+#endif /* POLY1305_SIMD_H */
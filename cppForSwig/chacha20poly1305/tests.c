@@ -124,14 +124,11 @@ static const struct poly1305_testvector poly1305_testvectors[] = {
      {0xa6, 0xf7, 0x45, 0x00, 0x8f, 0x81, 0xc9, 0x16, 0xa2, 0x0d, 0xcc, 0x74,
       0xee, 0xf2, 0xb2, 0xf0}}};
 
-int main(void) {
+static void test_chacha20_vectors(void) {
   struct chacha_ctx ctx;
-  uint8_t iv[8] = {0, 0, 0, 0, 0, 0, 0, 0};
   unsigned int i = 0;
   uint8_t keystream[512];
-  uint8_t poly1305_tag[16];
 
-  /* test chacha20 */
   for (i = 0;
        i < (sizeof(chacha20_testvectors) / sizeof(chacha20_testvectors[0]));
        i++) {
@@ -142,8 +139,12 @@ int main(void) {
     assert(memcmp(keystream, chacha20_testvectors[i].resulting_keystream,
                   chacha20_testvectors[i].keystream_check_size) == 0);
   }
+}
+
+static void test_poly1305_vectors(void) {
+  unsigned int i = 0;
+  uint8_t poly1305_tag[16];
 
-  /* test poly1305 */
   for (i = 0;
        i < (sizeof(poly1305_testvectors) / sizeof(poly1305_testvectors[0]));
        i++) {
@@ -153,8 +154,127 @@ int main(void) {
                   poly1305_testvectors[i].key);
     assert(memcmp(poly1305_tag, poly1305_testvectors[i].resulting_tag, 16) ==
            0);
-    int i = 100;
   }
+}
+
+/*
+   Every backend against the scalar code, on lengths that leave a tail for
+   the scalar path and with the block counter wrapping its low word.
+*/
+#define CROSSCHECK_MAXLEN 2100
+
+static void encrypt_with_backend(int backend, uint32_t ctrlow, uint8_t *out,
+                                 const uint8_t *in, uint32_t len) {
+  static const uint8_t key[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                  12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22,
+                                  23, 24, 25, 26, 27, 28, 29, 30, 31, 32};
+  static const uint8_t nonce[8] = {8, 7, 6, 5, 4, 3, 2, 1};
+  uint8_t ctr[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  struct chacha_ctx ctx;
+  uint32_t split = len / 3;
+
+  ctr[0] = (uint8_t)ctrlow;
+  ctr[1] = (uint8_t)(ctrlow >> 8);
+  ctr[2] = (uint8_t)(ctrlow >> 16);
+  ctr[3] = (uint8_t)(ctrlow >> 24);
+
+  chacha_set_backend(backend);
+  chacha_keysetup(&ctx, key, 256);
+  chacha_ivsetup(&ctx, nonce, ctr);
+
+  /* 2 calls: the counter has to carry over between them */
+  split -= split % CHACHA_BLOCKLEN;
+  chacha_encrypt_bytes(&ctx, in, out, split);
+  chacha_encrypt_bytes(&ctx, in + split, out + split, len - split);
+}
+
+static void test_backends_match(void) {
+  static uint8_t input[CROSSCHECK_MAXLEN];
+  static uint8_t expected[CROSSCHECK_MAXLEN];
+  static uint8_t result[CROSSCHECK_MAXLEN];
+  uint8_t key[POLY1305_KEYLEN];
+  uint8_t tag_expected[POLY1305_TAGLEN], tag_result[POLY1305_TAGLEN];
+  const uint32_t ctrlows[2] = {0, 0xfffffffd};
+  uint32_t len, i;
+  int backend;
+
+  for (i = 0; i < CROSSCHECK_MAXLEN; i++)
+    input[i] = (uint8_t)(i * 31 + 7);
+  for (i = 0; i < POLY1305_KEYLEN; i++)
+    key[i] = (uint8_t)(0xff - i * 3);
+
+  for (backend = 1; backend < CHACHA_BACKEND_COUNT; backend++) {
+    if (!chacha_backend_supported(backend))
+      continue;
+
+    for (i = 0; i < 2; i++) {
+      for (len = 0; len < CROSSCHECK_MAXLEN; len += 13) {
+        encrypt_with_backend(CHACHA_BACKEND_SCALAR, ctrlows[i], expected,
+                             input, len);
+        encrypt_with_backend(backend, ctrlows[i], result, input, len);
+        assert(memcmp(expected, result, len) == 0);
+
+        /* in place */
+        memcpy(result, input, len);
+        encrypt_with_backend(backend, ctrlows[i], result, result, len);
+        assert(memcmp(expected, result, len) == 0);
+      }
+    }
+  }
+
+  for (backend = 1; backend < POLY1305_BACKEND_COUNT; backend++) {
+    if (!poly1305_backend_supported(backend))
+      continue;
+
+    for (len = 0; len < CROSSCHECK_MAXLEN; len += 7) {
+      poly1305_set_backend(POLY1305_BACKEND_DONNA32);
+      poly1305_auth(tag_expected, input, len, key);
+      poly1305_set_backend(backend);
+      poly1305_auth(tag_result, input, len, key);
+      assert(memcmp(tag_expected, tag_result, POLY1305_TAGLEN) == 0);
+    }
+
+    /* all ones message and key, limbs at their largest */
+    memset(result, 0xff, CROSSCHECK_MAXLEN);
+    memset(key, 0xff, POLY1305_KEYLEN);
+    for (len = 0; len < CROSSCHECK_MAXLEN; len += 16) {
+      poly1305_set_backend(POLY1305_BACKEND_DONNA32);
+      poly1305_auth(tag_expected, result, len, key);
+      poly1305_set_backend(backend);
+      poly1305_auth(tag_result, result, len, key);
+      assert(memcmp(tag_expected, tag_result, POLY1305_TAGLEN) == 0);
+    }
+
+    for (i = 0; i < POLY1305_KEYLEN; i++)
+      key[i] = (uint8_t)(0xff - i * 3);
+  }
+
+  chacha_set_backend(CHACHA_BACKEND_BEST);
+  poly1305_set_backend(POLY1305_BACKEND_BEST);
+}
+
+int main(void) {
+  int backend;
+
+  /* test chacha20 */
+  for (backend = 0; backend < CHACHA_BACKEND_COUNT; backend++) {
+    if (chacha_set_backend(backend) < 0)
+      continue;
+    printf("chacha20 backend: %s\n", chacha_backend_name(backend));
+    test_chacha20_vectors();
+  }
+  chacha_set_backend(CHACHA_BACKEND_BEST);
+
+  /* test poly1305 */
+  for (backend = 0; backend < POLY1305_BACKEND_COUNT; backend++) {
+    if (poly1305_set_backend(backend) < 0)
+      continue;
+    printf("poly1305 backend: %s\n", poly1305_backend_name(backend));
+    test_poly1305_vectors();
+  }
+  poly1305_set_backend(POLY1305_BACKEND_BEST);
+
+  test_backends_match();
 
   /* test chacha20poly1305 AEAD */
   struct chachapolyaead_ctx aead_ctx;
@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include "../ThreadSafeClasses.h"
+#include "../BlockchainDatabase/HeaderIndex.h"
 
 using namespace std;
 
@@ -695,6 +696,228 @@ TEST_F(ContainerTests, TimedStackTest_Concurrent)
    EXPECT_EQ(theStack.count(), 0ULL);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, PersistentMap)
+{
+   PersistentMap<unsigned, unsigned> theMap;
+   map<unsigned, unsigned> refMap;
+
+   //insert in a scrambled order
+   for (unsigned i = 0; i < 1000; i++)
+   {
+      auto key = (i * 7919) % 1000;
+      EXPECT_TRUE(theMap.insert(key, i));
+      refMap.emplace(key, i);
+   }
+
+   EXPECT_EQ(theMap.size(), 1000ULL);
+
+   //AVL tree: height stays under 1.44 * log2(n)
+   EXPECT_LE(theMap.depth(), 15U);
+
+   //copies are independent from one another
+   auto mapCopy = theMap;
+   for (unsigned i = 0; i < 1000; i += 2)
+      EXPECT_TRUE(mapCopy.erase(i));
+   EXPECT_FALSE(mapCopy.erase(0U));
+   EXPECT_FALSE(mapCopy.insert(1, 12345));
+
+   EXPECT_EQ(theMap.size(), 1000ULL);
+   EXPECT_EQ(mapCopy.size(), 500ULL);
+
+   for (auto& refPair : refMap)
+   {
+      auto valPtr = theMap.find(refPair.first);
+      ASSERT_NE(valPtr, nullptr);
+      EXPECT_EQ(*valPtr, refPair.second);
+
+      valPtr = mapCopy.find(refPair.first);
+      if (refPair.first % 2 == 0)
+      {
+         EXPECT_EQ(valPtr, nullptr);
+         continue;
+      }
+
+      ASSERT_NE(valPtr, nullptr);
+      if (refPair.first == 1)
+         EXPECT_EQ(*valPtr, 12345U);
+      else
+         EXPECT_EQ(*valPtr, refPair.second);
+   }
+
+   //in order traversal
+   vector<unsigned> keys;
+   mapCopy.forEach([&keys](const unsigned& key, const unsigned&)
+   {
+      keys.push_back(key);
+   });
+
+   ASSERT_EQ(keys.size(), 500ULL);
+   for (unsigned i = 0; i < keys.size(); i++)
+      EXPECT_EQ(keys[i], i * 2 + 1);
+
+   mapCopy.clear();
+   EXPECT_TRUE(mapCopy.empty());
+   EXPECT_EQ(theMap.size(), 1000ULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, HeaderIndex)
+{
+   auto randomData = [](size_t len)->BinaryData
+   {
+      BinaryData data(len);
+      for (size_t i = 0; i < len; i++)
+         data.getPtr()[i] = rand() % 256;
+      return data;
+   };
+
+   //fake headers, the index doesn't care about their content
+   vector<shared_ptr<BlockHeader>> headers;
+   for (unsigned i = 0; i < 5000; i++)
+   {
+      auto header = make_shared<BlockHeader>();
+      header->unserializeWithHash(randomData(HEADER_SIZE), randomData(32));
+      header->setUniqueID(i);
+      headers.push_back(header);
+   }
+
+   //add in batches, like Blockchain::addBlocksInBulk
+   auto index = make_shared<HeaderIndex>();
+   vector<shared_ptr<HeaderIndex>> snapshots;
+   for (unsigned i = 0; i < headers.size(); i += 1000)
+   {
+      map<BinaryData, shared_ptr<BlockHeader>> headerMap;
+      for (unsigned y = i; y < i + 1000; y++)
+         headerMap.emplace(headers[y]->getThisHash(), headers[y]);
+
+      index = index->addHeaders(headerMap);
+      snapshots.push_back(index);
+   }
+
+   ASSERT_EQ(index->size(), headers.size());
+   for (auto& header : headers)
+   {
+      EXPECT_EQ(index->getByHash(header->getThisHashRef()), header);
+      EXPECT_EQ(index->getById(header->getThisID()), header);
+   }
+
+   EXPECT_EQ(index->getByHash(randomData(32)), nullptr);
+   EXPECT_EQ(index->getByHash(randomData(20)), nullptr);
+   EXPECT_EQ(index->getById(5000), nullptr);
+
+   //the arena holds each header once, batches in insertion order
+   unsigned arenaPos = 0;
+   set<shared_ptr<BlockHeader>> arenaHeaders;
+   for (auto& header : index->headers())
+   {
+      EXPECT_EQ(header->getThisID() / 1000, arenaPos++ / 1000);
+      arenaHeaders.insert(header);
+   }
+   EXPECT_EQ(arenaPos, headers.size());
+   EXPECT_EQ(arenaHeaders.size(), headers.size());
+
+   //earlier copies don't see later additions
+   EXPECT_EQ(snapshots[0]->size(), 1000ULL);
+   EXPECT_EQ(snapshots[0]->getByHash(headers[4999]->getThisHashRef()), nullptr);
+   EXPECT_EQ(snapshots[0]->getByHash(headers[999]->getThisHashRef()), headers[999]);
+
+   //replacing by hash keeps the arena position
+   auto replacement = make_shared<BlockHeader>();
+   replacement->unserializeWithHash(
+      headers[10]->serialize().getRef(), headers[10]->getThisHashRef());
+   unsigned replacementId = 10;
+   replacement->setUniqueID(replacementId);
+
+   map<BinaryData, shared_ptr<BlockHeader>> replaceMap;
+   replaceMap.emplace(headers[10]->getThisHash(), replacement);
+   auto replaced = index->addHeaders(replaceMap);
+   EXPECT_EQ(replaced->size(), headers.size());
+   EXPECT_EQ(replaced->getByHash(headers[10]->getThisHashRef()), replacement);
+   EXPECT_EQ(replaced->getById(10), replacement);
+   EXPECT_EQ(index->getById(10), headers[10]);
+
+   //heights, later updates only touch the heights they carry
+   map<unsigned, shared_ptr<BlockHeader>> heightMap;
+   for (unsigned i = 0; i < 100; i++)
+      heightMap[i] = headers[i];
+   index = index->setHeights(heightMap);
+   EXPECT_EQ(index->heightCount(), 100ULL);
+
+   heightMap.clear();
+   heightMap[50] = headers[4000];
+   heightMap[100] = headers[4001];
+   index = index->setHeights(heightMap);
+
+   EXPECT_EQ(index->heightCount(), 101ULL);
+   EXPECT_EQ(index->getByHeight(49), headers[49]);
+   EXPECT_EQ(index->getByHeight(50), headers[4000]);
+   EXPECT_EQ(index->getByHeight(100), headers[4001]);
+   EXPECT_EQ(index->getByHeight(101), nullptr);
+
+   //headers have to be indexed before they get a height
+   heightMap.clear();
+   heightMap[0] = make_shared<BlockHeader>();
+   EXPECT_THROW(index->setHeights(heightMap), runtime_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, ChunkedVector)
+{
+   const size_t chunkSize = size_t(1) << HEADER_INDEX_CHUNK_BITS;
+   const size_t count = chunkSize * 6 + 4;
+   const size_t chunkCount = 7;
+
+   ChunkedVector<uint32_t> vec;
+   for (size_t i = 0; i < count; i++)
+      vec.push_back(i);
+   EXPECT_EQ(vec.size(), count);
+   EXPECT_EQ(vec.sharedChunkCount(), 0ULL);
+
+   //copies share every chunk until they write to it
+   ChunkedVector<uint32_t> vecCopy(vec);
+   EXPECT_EQ(vecCopy.sharedChunkCount(), chunkCount);
+
+   vecCopy.set(5, 1000);
+   vecCopy.push_back(2000);
+   EXPECT_EQ(vecCopy.sharedChunkCount(), chunkCount - 2);
+
+   EXPECT_EQ(vec[5], 5U);
+   EXPECT_EQ(vecCopy[5], 1000U);
+   EXPECT_EQ(vec.size(), count);
+   EXPECT_EQ(vecCopy.size(), count + 1);
+   EXPECT_EQ(vecCopy[count], 2000U);
+
+   //unwritten entries read the same
+   size_t pos = 0;
+   for (auto& val : vec)
+   {
+      if (pos != 5)
+      {
+         EXPECT_EQ(vecCopy[pos], val);
+      }
+      ++pos;
+   }
+   EXPECT_EQ(pos, count);
+
+   //growing fills in new chunks
+   ChunkedVector<uint32_t> grown(vec);
+   grown.grow(count + chunkSize, UINT32_MAX);
+   EXPECT_EQ(grown.size(), count + chunkSize);
+   EXPECT_EQ(grown[count + chunkSize - 1], UINT32_MAX);
+   EXPECT_EQ(grown[count - 1], uint32_t(count - 1));
+   EXPECT_EQ(grown.sharedChunkCount(), chunkCount - 1);
+
+   //never shrinks
+   grown.grow(1, 0);
+   EXPECT_EQ(grown.size(), count + chunkSize);
+
+   grown.assign(3, 7);
+   EXPECT_EQ(grown.size(), 3ULL);
+   EXPECT_EQ(grown.sharedChunkCount(), 0ULL);
+   EXPECT_EQ(vec.size(), count);
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 GTEST_API_ int main(int argc, char **argv)
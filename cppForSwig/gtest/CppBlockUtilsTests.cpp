@@ -12,6 +12,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "TestUtils.h"
 #include "hkdf.h"
+#include "../BlockchainDatabase/BlockDataMap.h"
+#include "../BlockchainDatabase/BlockFilters.h"
 
 using namespace std;
 using namespace Armory::Signer;
@@ -402,19 +404,21 @@ protected:
    BlockDataManagerThread *theBDMt_;
    Clients* clients_;
 
-   void initBDM(void)
+   void initBDM(const vector<string>& extraArgs = {})
    {
       Armory::Config::reset();
       DBSettings::setServiceType(SERVICE_UNITTEST);
-      Armory::Config::parseArgs({
+
+      vector<string> args {
          "--datadir=./fakehomedir",
          "--dbdir=./ldbtestdir",
          "--satoshi-datadir=./blkfiletest",
          "--public",
          "--db-type=DB_FULL",
          "--thread-count=3",
-         "--public"},
-         Armory::Config::ProcessType::DB);
+         "--public"};
+      args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+      Armory::Config::parseArgs(args, Armory::Config::ProcessType::DB);
 
       DBTestUtils::init();
             
@@ -477,6 +481,11 @@ protected:
       theBDMt_ = nullptr;
       clients_ = nullptr;
 
+      //the in-memory block store is process wide
+      auto& store = MemoryBlockStore::shared();
+      for (auto& block : store.getBlocks())
+         store.remove(block.second->getHash());
+
       DBUtils::removeDirectory(blkdir_);
       DBUtils::removeDirectory(homedir_);
       DBUtils::removeDirectory("./ldbtestdir");
@@ -725,6 +734,190 @@ TEST_F(BlockUtilsFull, Load4Blocks_Plus2)
    wltLB2.reset();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load4Blocks_Plus2_FromMemory)
+{
+   TestUtils::setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+
+   //wait on signals
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   //the node sends block 4 ahead of the blk files
+   auto blockchain = theBDMt_->bdm()->blockchain();
+   auto getID = [blockchain](const BinaryData&)->unsigned int
+   {
+      return blockchain->getNewUniqueID();
+   };
+
+   auto& store = MemoryBlockStore::shared();
+   auto fileID4 = store.add(TestUtils::getRawBlock("4"), getID);
+   ASSERT_TRUE(MemoryBlockStore::isMemoryFileID(fileID4));
+
+   DBTestUtils::triggerNewBlockNotification(theBDMt_);
+   DBTestUtils::waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_EQ(blockchain->top()->getBlockHeight(), 4U);
+   auto header4 = blockchain->getHeaderByHash(TestChain::blkHash4);
+   EXPECT_EQ(header4->getBlockFileNum(), fileID4);
+   EXPECT_EQ(iface_->getFullTxCopy(0, header4).serialize(),
+      TestUtils::getTx(4, 0));
+
+   //the in-memory position isn't written to the db
+   StoredHeader sbh;
+   ASSERT_TRUE(iface_->getBareHeader(sbh, TestChain::blkHash4));
+   EXPECT_EQ(sbh.getBlockFilePos().fileNum_, UINT32_MAX);
+
+   //block 4 hits the disk with block 5, its header moves to the blk file
+   auto offset4 = BtcUtils::GetFileSize(blk0dat_) + 8;
+   TestUtils::appendBlocks({ "4", "5" }, blk0dat_);
+   DBTestUtils::triggerNewBlockNotification(theBDMt_);
+   DBTestUtils::waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_EQ(blockchain->top()->getBlockHeight(), 5U);
+   EXPECT_EQ(header4->getBlockFileNum(), 0U);
+   EXPECT_EQ(header4->getOffset(), offset4);
+   EXPECT_EQ(store.count(), 0U);
+   EXPECT_EQ(iface_->getFullTxCopy(0, header4).serialize(),
+      TestUtils::getTx(4, 0));
+
+   ASSERT_TRUE(iface_->getBareHeader(sbh, TestChain::blkHash4));
+   EXPECT_EQ(sbh.getBlockFilePos().fileNum_, 0U);
+   EXPECT_EQ(sbh.getBlockFilePos().offset_, offset4);
+
+   //same as Load5Blocks
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrF);
+   EXPECT_EQ(scrObj->getFullBalance(),  5*COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load4Blocks_Plus2_FromMemory_Restart)
+{
+   TestUtils::setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+
+   //wait on signals
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   //block 4 comes from memory
+   auto blockchain = theBDMt_->bdm()->blockchain();
+   auto getID = [blockchain](const BinaryData&)->unsigned int
+   {
+      return blockchain->getNewUniqueID();
+   };
+
+   auto& store = MemoryBlockStore::shared();
+   auto fileID4 = store.add(TestUtils::getRawBlock("4"), getID);
+   ASSERT_TRUE(MemoryBlockStore::isMemoryFileID(fileID4));
+
+   DBTestUtils::triggerNewBlockNotification(theBDMt_);
+   DBTestUtils::waitOnNewBlockSignal(clients_, bdvID);
+   EXPECT_EQ(blockchain->top()->getBlockHeight(), 4U);
+
+   //shutdown bdm
+   bdvPtr.reset();
+   blockchain.reset();
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   //a new process starts with an empty store, the node wrote the blocks
+   //to disk in the meantime
+   store.remove(TestChain::blkHash4);
+   auto offset4 = BtcUtils::GetFileSize(blk0dat_) + 8;
+   TestUtils::appendBlocks({ "4", "5" }, blk0dat_);
+
+   //restart bdm
+   initBDM();
+
+   theBDMt_->start(DBSettings::initMode());
+   bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   //block 4 is read from the blk file, not from a stale in-memory id
+   blockchain = theBDMt_->bdm()->blockchain();
+   EXPECT_EQ(blockchain->top()->getBlockHeight(), 5U);
+   auto header4 = blockchain->getHeaderByHash(TestChain::blkHash4);
+   EXPECT_EQ(header4->getBlockFileNum(), 0U);
+   EXPECT_EQ(header4->getOffset(), offset4);
+   EXPECT_EQ(iface_->getFullTxCopy(0, header4).serialize(),
+      TestUtils::getTx(4, 0));
+
+   StoredHeader sbh;
+   ASSERT_TRUE(iface_->getBareHeader(sbh, TestChain::blkHash4));
+   EXPECT_EQ(sbh.getBlockFilePos().fileNum_, 0U);
+
+   //same as Load5Blocks
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrF);
+   EXPECT_EQ(scrObj->getFullBalance(),  5*COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsFull, Load5Blocks_FullReorg)
 {
@@ -806,6 +999,301 @@ TEST_F(BlockUtilsFull, Load5Blocks_FullReorg)
    EXPECT_EQ(wltLB2->getFullBalance(), 10*COIN);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_FilteredSideScan)
+{
+   /*
+   Side scan a wallet that only shows up in a few blocks. The scan skips
+   the blocks whose script filter misses the wallet and has to end up
+   with the same balances and history as a scan parsing every block.
+   */
+
+   vector<BinaryData> scrAddrVec1;
+   scrAddrVec1.push_back(TestChain::scrAddrB);
+   scrAddrVec1.push_back(TestChain::scrAddrC);
+   scrAddrVec1.push_back(TestChain::scrAddrD);
+
+   vector<BinaryData> scrAddrVec2;
+   scrAddrVec2.push_back(TestChain::scrAddrA);
+   scrAddrVec2.push_back(TestChain::scrAddrE);
+
+   typedef tuple<uint64_t, uint64_t, uint64_t> Balances;
+   typedef tuple<uint32_t, uint32_t, BinaryData, int64_t> LedgerKey;
+
+   struct ScanResult
+   {
+      map<BinaryData, Balances> balances_;
+      vector<LedgerKey> history_;
+      unsigned filterMisses_ = 0;
+   };
+
+   auto runScan = [&, this](void)->ScanResult
+   {
+      theBDMt_->start(DBSettings::initMode());
+      auto&& bdvID = DBTestUtils::registerBDV(
+         clients_, BitcoinSettings::getMagicBytes());
+      DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec1, "wallet1");
+
+      auto bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+      DBTestUtils::goOnline(clients_, bdvID);
+      DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+      //not a new wallet, registering it side scans the chain
+      DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec2, "wallet2");
+      auto wlt2 = bdvPtr->getWalletOrLockbox(wallet2id);
+
+      ScanResult result;
+      auto bc = theBDMt_->bdm()->blockchain();
+      auto top = bc->top()->getBlockHeight();
+      for (auto& scrAddr : scrAddrVec2)
+      {
+         auto scrObj = wlt2->getScrAddrObjByKey(scrAddr);
+         result.balances_.emplace(scrAddr, make_tuple(
+            scrObj->getFullBalance(), 
+            scrObj->getSpendableBalance(top),
+            scrObj->getUnconfirmedBalance(top, 1)));
+      }
+
+      for (auto& le : wlt2->getHistoryPageAsVector(0))
+      {
+         result.history_.push_back(make_tuple(
+            le.getBlockNum(), le.getIndex(), le.getTxHash(), le.getValue()));
+      }
+
+      //blocks the filtered scan gets to skip
+      {
+         auto&& tx = iface_->beginTransaction(TXFILTERS, LMDB::ReadOnly);
+         for (unsigned i = 0; i <= top; i++)
+         {
+            auto header = bc->getHeaderByHeight(i, 0xFF);
+            auto filterRef = iface_->getBlockFilterRef(
+               header->getThisID(), header->getThisHashRef());
+            EXPECT_FALSE(filterRef.empty());
+
+            GolombFilter filter(header->getThisHashRef(), filterRef);
+            if (!filter.matchAny(scrAddrVec2))
+               ++result.filterMisses_;
+         }
+      }
+
+      //shutdown bdm
+      wlt2.reset();
+      bdvPtr.reset();
+      clients_->exitRequestLoop();
+      clients_->shutdown();
+
+      delete clients_;
+      delete theBDMt_;
+      clients_ = nullptr;
+      theBDMt_ = nullptr;
+
+      return result;
+   };
+
+   //filters on
+   auto&& filtered = runScan();
+   EXPECT_GT(filtered.filterMisses_, 0U);
+
+   //fresh db, every block parsed
+   DBUtils::removeDirectory(ldbdir_);
+   mkdir(ldbdir_);
+   initBDM({ "--no-block-filters" });
+   ASSERT_FALSE(DBSettings::blockFilters());
+
+   auto&& full = runScan();
+   EXPECT_EQ(full.filterMisses_, filtered.filterMisses_);
+
+   EXPECT_EQ(filtered.balances_, full.balances_);
+   EXPECT_EQ(get<0>(filtered.balances_[TestChain::scrAddrA]), 50 * COIN);
+   EXPECT_EQ(get<0>(filtered.balances_[TestChain::scrAddrE]), 30 * COIN);
+
+   ASSERT_FALSE(full.history_.empty());
+   EXPECT_EQ(filtered.history_, full.history_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_HistoryCursor)
+{
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+
+   //wait on signals
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+   auto bc = theBDMt_->bdm()->blockchain();
+
+   typedef tuple<uint32_t, uint32_t, BinaryData> LedgerKey;
+   auto getKey = [](const LedgerEntry& le)->LedgerKey
+   {
+      return make_tuple(le.getBlockNum(), le.getIndex(), le.getTxHash());
+   };
+
+   //walk the wallet history 2 entries at a time, no duplicates, no gaps
+   set<LedgerKey> expected;
+   {
+      auto&& fullHistory = wlt->getHistoryPageAsVector(0);
+      ASSERT_GT(fullHistory.size(), 4U);
+      for (auto& le : fullHistory)
+         expected.insert(getKey(le));
+   }
+
+   {
+      set<LedgerKey> walked;
+      BinaryData token;
+      unsigned pageCount = 0;
+      do
+      {
+         auto&& page = wlt->getHistoryFromCursor(token, 2);
+         EXPECT_LE(page.size(), 2U);
+         for (auto& le : page)
+            EXPECT_TRUE(walked.insert(getKey(le)).second);
+
+         ASSERT_LT(++pageCount, 100U);
+      }
+      while (!token.empty());
+
+      EXPECT_EQ(walked, expected);
+   }
+
+   //synthetic history pinned on the chain, 3 entries per height
+   map<uint32_t, uint32_t> summary;
+   map<BinaryData, LedgerEntry> ledgers;
+   auto addLedger = [&ledgers, &summary](uint32_t height, uint32_t index)->void
+   {
+      BinaryWriter bw;
+      if (height == UINT32_MAX)
+         bw.put_BinaryData(DBUtils::ZeroConfHeader_);
+      else
+         bw.put_BinaryData(DBUtils::heightAndDupToHgtx(height, 0));
+      bw.put_uint16_t(index, BE);
+
+      LedgerEntry le("synthetic", COIN, height,
+         BtcUtils::getHash256(bw.getData()), index, 1500000000,
+         false, false, false, false, false, false);
+      ledgers.emplace(bw.getData(), le);
+
+      if (height != UINT32_MAX)
+         ++summary[height];
+   };
+
+   for (uint32_t height = 1; height <= 5; height++)
+   {
+      for (uint32_t index = 0; index < 3; index++)
+         addLedger(height, index);
+   }
+
+   auto getLedgers = [&ledgers](uint32_t start, uint32_t end)->
+      map<BinaryData, LedgerEntry>
+   {
+      map<BinaryData, LedgerEntry> result;
+      for (auto& lePair : ledgers)
+      {
+         auto height = lePair.second.getBlockNum();
+         if (height >= start && height <= end)
+            result.insert(lePair);
+      }
+      return result;
+   };
+
+   auto walk = [&](BinaryData& token)->vector<vector<LedgerKey>>
+   {
+      vector<vector<LedgerKey>> pages;
+      do
+      {
+         auto&& page = HistoryPager::getPageFromCursor(
+            token, 4, summary, bc.get(), getLedgers);
+
+         vector<LedgerKey> keys;
+         for (auto& le : page)
+            keys.push_back(getKey(le));
+         pages.push_back(keys);
+
+         if (pages.size() > 100)
+            break;
+      }
+      while (!token.empty());
+
+      return pages;
+   };
+
+   BinaryData baselineToken;
+   auto&& baseline = walk(baselineToken);
+   ASSERT_EQ(baseline.size(), 4U);
+
+   set<LedgerKey> baselineKeys;
+   for (auto& page : baseline)
+   {
+      for (auto& key : page)
+         EXPECT_TRUE(baselineKeys.insert(key).second);
+   }
+   EXPECT_EQ(baselineKeys.size(), 15U);
+
+   //first page, then a zc and a block's worth of entries show up
+   BinaryData token;
+   auto&& firstPage = HistoryPager::getPageFromCursor(
+      token, 4, summary, bc.get(), getLedgers);
+   ASSERT_EQ(firstPage.size(), 4U);
+   ASSERT_FALSE(token.empty());
+
+   addLedger(UINT32_MAX, 0);
+   for (uint32_t index = 0; index < 3; index++)
+      addLedger(6, index);
+
+   //the continuation pages are the same as before
+   auto&& pages = walk(token);
+   ASSERT_EQ(pages.size(), baseline.size() - 1);
+   for (unsigned i = 0; i < pages.size(); i++)
+      EXPECT_EQ(pages[i], baseline[i + 1]);
+
+   //a new walk picks up the zc, ahead of mined entries
+   BinaryData newToken;
+   auto&& newPage = HistoryPager::getPageFromCursor(
+      newToken, 4, summary, bc.get(), getLedgers);
+   ASSERT_FALSE(newPage.empty());
+   EXPECT_EQ(newPage[0].getBlockNum(), UINT32_MAX);
+
+   //reorg past the pinned height invalidates the cursor
+   token.clear();
+   HistoryPager::getPageFromCursor(token, 4, summary, bc.get(), getLedgers);
+   ASSERT_FALSE(token.empty());
+
+   BinaryData wltToken;
+   wlt->getHistoryFromCursor(wltToken, 2);
+   ASSERT_FALSE(wltToken.empty());
+
+   TestUtils::setBlocks({ "0", "1", "2", "3", "4", "5", "4A" }, blk0dat_);
+   DBTestUtils::triggerNewBlockNotification(theBDMt_);
+
+   TestUtils::appendBlocks({ "5A" }, blk0dat_);
+   DBTestUtils::triggerNewBlockNotification(theBDMt_);
+   DBTestUtils::waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_THROW(HistoryPager::getPageFromCursor(
+      token, 4, summary, bc.get(), getLedgers), runtime_error);
+   EXPECT_THROW(wlt->getHistoryFromCursor(wltToken, 2), runtime_error);
+
+   //a fresh cursor works on the new chain
+   wltToken.clear();
+   auto&& reorgPage = wlt->getHistoryFromCursor(wltToken, 2);
+   EXPECT_FALSE(reorgPage.empty());
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsFull, Load5Blocks_DoubleReorg)
 {
@@ -1454,6 +1942,150 @@ TEST_F(BlockUtilsFull, Load5Blocks_SideScan)
    EXPECT_EQ(wlt->getFullBalance(), 205 * COIN);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_SideScan_Merged)
+{
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   auto saf = theBDMt_->bdm()->getScrAddrFilter();
+   auto scanCount = saf->getSideScanCount();
+
+   //hold the registration thread on a batch that needs no scan while the
+   //others queue up behind it
+   promise<bool> enteredProm, holdProm;
+   auto enteredFut = enteredProm.get_future();
+   auto holdFut = holdProm.get_future();
+
+   auto holdBatch = make_shared<RegistrationBatch>();
+   holdBatch->scrAddrSet_.insert(TestChain::scrAddrA.getRef());
+   holdBatch->isNew_ = false;
+   holdBatch->walletID_ = "hold";
+   holdBatch->callback_ = [&enteredProm, &holdFut](set<BinaryDataRef>&)->void
+   {
+      enteredProm.set_value(true);
+      holdFut.wait();
+   };
+   saf->pushAddressBatch(holdBatch);
+   enteredFut.wait();
+
+   //3 registrations, F has a birth height past its history
+   vector<shared_ptr<promise<bool>>> doneProms;
+   auto pushBatch = [&saf, &doneProms](
+      const BinaryData& scrAddr, const string& wltID, unsigned birth)->void
+   {
+      auto doneProm = make_shared<promise<bool>>();
+      doneProms.push_back(doneProm);
+
+      auto batch = make_shared<RegistrationBatch>();
+      batch->scrAddrSet_.insert(scrAddr.getRef());
+      batch->isNew_ = false;
+      batch->walletID_ = wltID;
+      if (birth != 0)
+         batch->addrBirthHeights_[scrAddr.getRef()] = birth;
+      batch->callback_ = [doneProm](set<BinaryDataRef>&)->void
+      {
+         doneProm->set_value(true);
+      };
+      saf->pushAddressBatch(batch);
+   };
+
+   pushBatch(TestChain::scrAddrD, "wallet2", 0);
+   pushBatch(TestChain::scrAddrE, "wallet3", 0);
+   pushBatch(TestChain::scrAddrF, "wallet4", 6);
+   holdProm.set_value(true);
+
+   for (auto& doneProm : doneProms)
+      doneProm->get_future().wait();
+
+   //one side scan served all 3
+   EXPECT_EQ(saf->getSideScanCount(), scanCount + 1);
+
+   auto addrMap = saf->getScanFilterAddrMap();
+   EXPECT_NE(addrMap->find(TestChain::scrAddrD), addrMap->end());
+   EXPECT_NE(addrMap->find(TestChain::scrAddrE), addrMap->end());
+   EXPECT_NE(addrMap->find(TestChain::scrAddrF), addrMap->end());
+
+   auto getBalance = [this](const BinaryData& scrAddr)->uint64_t
+   {
+      auto&& tx = iface_->beginTransaction(SSH, LMDB::ReadOnly);
+      StoredScriptHistory ssh;
+      iface_->getStoredScriptHistorySummary(ssh, scrAddr);
+      return ssh.getScriptBalance();
+   };
+
+   EXPECT_EQ(getBalance(TestChain::scrAddrD), 65 * COIN);
+   EXPECT_EQ(getBalance(TestChain::scrAddrE), 30 * COIN);
+
+   //F's history is below its birth height, the scan skipped it
+   EXPECT_EQ(getBalance(TestChain::scrAddrF), 0U);
+   {
+      auto&& tx = iface_->beginTransaction(SSH, LMDB::ReadOnly);
+      EXPECT_TRUE(iface_->getSSHSummary(TestChain::scrAddrF).empty());
+   }
+
+   //a lone registration still gets its own scan
+   scrAddrVec.clear();
+   scrAddrVec.push_back(TestChain::lb1ScrAddr);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet5");
+   EXPECT_EQ(saf->getSideScanCount(), scanCount + 2);
+   EXPECT_EQ(getBalance(TestChain::lb1ScrAddr), 5 * COIN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_SideScan_BirthHeight)
+{
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = DBTestUtils::getBDV(clients_, bdvID);
+
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   //wallet birth height past all of D's history
+   scrAddrVec.clear();
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet2", 6);
+
+   //birth height below all of E's history
+   scrAddrVec.clear();
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet3", 1);
+
+   auto wlt2 = bdvPtr->getWalletOrLockbox(wallet2id);
+   auto wlt3 = bdvPtr->getWalletOrLockbox("wallet3");
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt2->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 0U);
+   EXPECT_EQ(wlt2->getFullBalance(), 0U);
+
+   scrObj = wlt3->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30 * COIN);
+   EXPECT_EQ(wlt3->getFullBalance(), 30 * COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt2.reset();
+   wlt3.reset();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsFull, Load5Blocks_GetUtxos)
 {
@@ -1644,6 +2276,353 @@ TEST_F(BlockUtilsFull, Load5Blocks_CheckWalletFilters)
    EXPECT_EQ(wlt2_count, 0U);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_LedgerCache)
+{
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   auto bc = theBDMt_->bdm()->blockchain();
+   const string walletID("ledgerCacheWallet");
+
+   //an address without history
+   BinaryData scrAddrX = TestChain::scrAddrA;
+   scrAddrX.getPtr()[1] ^= 0xFF;
+
+   //lowest height scrAddrA has history at
+   uint32_t heightA;
+   {
+      auto&& tx = iface_->beginTransaction(SSH, LMDB::ReadOnly);
+      auto&& summary = iface_->getSSHSummary(TestChain::scrAddrA);
+      ASSERT_FALSE(summary.empty());
+      heightA = summary.begin()->first;
+   }
+   ASSERT_LE(heightA, 5U);
+
+   auto makeAddrMap = [this, bc](const vector<BinaryData>& addrVec)->
+      shared_ptr<const WalletAddrMap>
+   {
+      auto addrMap = make_shared<WalletAddrMap>();
+      for (auto& addr : addrVec)
+      {
+         auto addrObj = make_shared<ScrAddrObj>(
+            iface_, bc.get(), nullptr, addr.getRef());
+         addrMap->emplace(addrObj->getScrAddr(), addrObj);
+      }
+      return addrMap;
+   };
+
+   //one ledger per height, records which ranges get computed
+   vector<pair<uint32_t, uint32_t>> calls;
+   auto compute = [&calls, &walletID](uint32_t start, uint32_t end)->
+      map<BinaryData, LedgerEntry>
+   {
+      calls.emplace_back(start, end);
+      map<BinaryData, LedgerEntry> result;
+      for (uint32_t i = start; i <= end; i++)
+      {
+         BinaryWriter bw;
+         bw.put_BinaryData(DBUtils::heightAndDupToHgtx(i, 0));
+         bw.put_uint16_t(0, BE);
+         LedgerEntry le(walletID, i * COIN, i, BtcUtils::getHash256(bw.getData()),
+            0, 1500000000 + i, false, false, false, false, false, false);
+         result.emplace(bw.getData(), le);
+      }
+      return result;
+   };
+
+   auto checkLedgers = [](const map<BinaryData, LedgerEntry>& ledgers,
+      uint32_t start, uint32_t end)->void
+   {
+      ASSERT_EQ(ledgers.size(), end - start + 1);
+      auto height = start;
+      for (auto& lePair : ledgers)
+      {
+         EXPECT_EQ(lePair.second.getBlockNum(), height);
+         EXPECT_EQ(lePair.second.getValue(), int64_t(height * COIN));
+         ++height;
+      }
+   };
+
+   auto countLedgerKeys = [this, &walletID](void)->unsigned
+   {
+      BinaryWriter bw;
+      bw.put_uint8_t(DB_PREFIX_LEDGER);
+      bw.put_BinaryData(LedgerCache::computeCacheId(walletID));
+      auto prefix = bw.getDataRef();
+
+      unsigned count = 0;
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      auto dbIter = iface_->getIterator(HISTORY);
+      if (dbIter->seekToStartsWith(prefix))
+      {
+         do
+         {
+            if (!dbIter->getKeyRef().startsWith(prefix))
+               break;
+            ++count;
+         }
+         while (dbIter->advanceAndRead());
+      }
+      return count;
+   };
+
+   BinaryWriter bwMetaKey;
+   bwMetaKey.put_uint8_t(DB_PREFIX_LEDGERMETA);
+   bwMetaKey.put_String(walletID);
+   auto metaKey = bwMetaKey.getData();
+
+   auto getMeta = [this, &metaKey](void)->LedgerCache::Meta
+   {
+      LedgerCache::Meta meta;
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      meta.unserialize(iface_->getValueNoCopy(HISTORY, metaKey.getRef()));
+      return meta;
+   };
+
+   auto putMeta = [this, &metaKey](const LedgerCache::Meta& meta)->void
+   {
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadWrite);
+      auto&& data = meta.serialize();
+      iface_->putValue(HISTORY, metaKey.getRef(), data.getRef());
+   };
+
+   auto mapBC = makeAddrMap({ TestChain::scrAddrB, TestChain::scrAddrC });
+   auto mapBCX = makeAddrMap(
+      { TestChain::scrAddrB, TestChain::scrAddrC, scrAddrX });
+   auto mapABCX = makeAddrMap({ TestChain::scrAddrA,
+      TestChain::scrAddrB, TestChain::scrAddrC, scrAddrX });
+   auto mapABC = makeAddrMap(
+      { TestChain::scrAddrA, TestChain::scrAddrB, TestChain::scrAddrC });
+
+   LedgerCache cache(iface_, bc.get());
+
+   //nothing is cached before the top is set
+   checkLedgers(cache.getLedgers(walletID, mapBC, 0, 5, compute), 0, 5);
+   EXPECT_EQ(countLedgerKeys(), 0U);
+   cache.setTop(5);
+
+   //first page computes, second one reads back
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapBC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(0U, 5U));
+   EXPECT_EQ(countLedgerKeys(), 6U);
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapBC, 0, 5, compute), 0, 5);
+   EXPECT_TRUE(calls.empty());
+
+   //heights past the top are always computed
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapBC, 2, 7, compute), 2, 7);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(6U, 7U));
+   EXPECT_EQ(countLedgerKeys(), 6U);
+
+   //truncate, only the dropped heights are recomputed
+   cache.truncate(walletID, 3);
+   EXPECT_EQ(countLedgerKeys(), 3U);
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapBC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(3U, 5U));
+
+   //a new address without history keeps the cache
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapBCX, 0, 5, compute), 0, 5);
+   EXPECT_TRUE(calls.empty());
+
+   //a new address with history truncates from its first height
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABCX, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(heightA, 5U));
+
+   //a removed address drops the cache
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(0U, 5U));
+
+   //another instance of the same wallet id shares the cache
+   {
+      LedgerCache cache2(iface_, bc.get());
+      cache2.setTop(5);
+
+      calls.clear();
+      checkLedgers(cache2.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+      EXPECT_TRUE(calls.empty());
+
+      //and sees address set changes from the other side
+      calls.clear();
+      checkLedgers(cache2.getLedgers(walletID, mapBC, 0, 5, compute), 0, 5);
+      ASSERT_EQ(calls.size(), 1U);
+      EXPECT_EQ(calls[0], make_pair(0U, 5U));
+   }
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(heightA, 5U));
+
+   //a cached tip that isn't on the main chain anymore drops the cache
+   {
+      auto meta = getMeta();
+      EXPECT_EQ(meta.tipHeight_, 5U);
+      meta.tipHash_ = CryptoPRNG::generateRandom(32);
+      putMeta(meta);
+   }
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(0U, 5U));
+   EXPECT_EQ(countLedgerKeys(), 6U);
+
+   //live caches survive garbage collection, orphans don't
+   BinaryWriter bwOrphan;
+   bwOrphan.put_uint8_t(DB_PREFIX_LEDGER);
+   bwOrphan.put_BinaryData(LedgerCache::computeCacheId("orphan"));
+   bwOrphan.put_BinaryData(DBUtils::heightAndDupToHgtx(1, 0));
+   bwOrphan.put_uint16_t(0, BE);
+   {
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadWrite);
+      iface_->putValue(HISTORY, bwOrphan.getDataRef(), BinaryData(4).getRef());
+   }
+
+   EXPECT_EQ(LedgerCache::collectGarbage(iface_, LEDGERCACHE_EXPIRY), 0U);
+   EXPECT_EQ(countLedgerKeys(), 6U);
+   {
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      EXPECT_EQ(iface_->getValueNoCopy(
+         HISTORY, bwOrphan.getDataRef()).getSize(), 0U);
+   }
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+   EXPECT_TRUE(calls.empty());
+
+   //expired caches are dropped
+   {
+      auto meta = getMeta();
+      meta.lastUsed_ = 1;
+      putMeta(meta);
+   }
+
+   EXPECT_EQ(LedgerCache::collectGarbage(iface_, LEDGERCACHE_EXPIRY), 1U);
+   EXPECT_EQ(countLedgerKeys(), 0U);
+   {
+      auto&& tx = iface_->beginTransaction(HISTORY, LMDB::ReadOnly);
+      EXPECT_EQ(iface_->getValueNoCopy(HISTORY, metaKey.getRef()).getSize(), 0U);
+   }
+
+   calls.clear();
+   checkLedgers(cache.getLedgers(walletID, mapABC, 0, 5, compute), 0, 5);
+   ASSERT_EQ(calls.size(), 1U);
+   EXPECT_EQ(calls[0], make_pair(0U, 5U));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsFull, Load5Blocks_LedgerCache_Concurrent)
+{
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   DBTestUtils::registerWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   auto bc = theBDMt_->bdm()->blockchain();
+   const string walletID("ledgerCacheWallet");
+
+   auto makeAddrMap = [this, bc](const vector<BinaryData>& addrVec)->
+      shared_ptr<const WalletAddrMap>
+   {
+      auto addrMap = make_shared<WalletAddrMap>();
+      for (auto& addr : addrVec)
+      {
+         auto addrObj = make_shared<ScrAddrObj>(
+            iface_, bc.get(), nullptr, addr.getRef());
+         addrMap->emplace(addrObj->getScrAddr(), addrObj);
+      }
+      return addrMap;
+   };
+
+   auto compute = [&walletID](uint32_t start, uint32_t end)->
+      map<BinaryData, LedgerEntry>
+   {
+      map<BinaryData, LedgerEntry> result;
+      for (uint32_t i = start; i <= end; i++)
+      {
+         BinaryWriter bw;
+         bw.put_BinaryData(DBUtils::heightAndDupToHgtx(i, 0));
+         bw.put_uint16_t(0, BE);
+         LedgerEntry le(walletID, i * COIN, i, BtcUtils::getHash256(bw.getData()),
+            0, 1500000000 + i, false, false, false, false, false, false);
+         result.emplace(bw.getData(), le);
+      }
+      return result;
+   };
+
+   //BDVs loading the same wallet id with different address sets keep
+   //invalidating each other, no page may come back with holes
+   auto mapBC = makeAddrMap({ TestChain::scrAddrB, TestChain::scrAddrC });
+   auto mapABC = makeAddrMap(
+      { TestChain::scrAddrA, TestChain::scrAddrB, TestChain::scrAddrC });
+
+   atomic<unsigned> failures = { 0 };
+   auto worker = [&](shared_ptr<const WalletAddrMap> addrMap)->void
+   {
+      LedgerCache cache(iface_, bc.get());
+      cache.setTop(5);
+
+      for (unsigned i = 0; i < 50; i++)
+      {
+         if (i % 10 == 5)
+            cache.truncate(walletID, i % 6);
+
+         auto&& ledgers = cache.getLedgers(walletID, addrMap, 0, 5, compute);
+         if (ledgers.size() != 6)
+         {
+            ++failures;
+            continue;
+         }
+
+         uint32_t height = 0;
+         for (auto& lePair : ledgers)
+         {
+            if (lePair.second.getBlockNum() != height++)
+               ++failures;
+         }
+      }
+   };
+
+   vector<thread> threads;
+   for (unsigned i = 0; i < 4; i++)
+      threads.emplace_back(worker, i % 2 ? mapBC : mapABC);
+
+   for (auto& thr : threads)
+      thr.join();
+
+   EXPECT_EQ(failures.load(), 0U);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 class WebSocketTests_1Way : public ::testing::Test
 {
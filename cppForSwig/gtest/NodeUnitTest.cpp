@@ -997,6 +997,44 @@ void NodeRPC_UnitTest::stallNextZc(unsigned seconds)
    zcStalls_.push_back(seconds);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void NodeRPC_UnitTest::setFeeEstimate(
+   unsigned confTarget, const string& strategy, float feeByte)
+{
+   //the cache is swapped whole, as aggregateFeeEstimates does
+   auto newCache = make_shared<CoreRPC::EstimateCache>();
+   auto cachePtr = atomic_load(&currentEstimateCache_);
+   if (cachePtr != nullptr)
+      *newCache = *cachePtr;
+
+   CoreRPC::FeeEstimateResult fer;
+   fer.smartFee_ = true;
+   fer.feeByte_ = feeByte;
+   (*newCache)[strategy][confTarget] = fer;
+
+   atomic_store(&currentEstimateCache_, newCache);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CoreRPC::FeeEstimateResult NodeRPC_UnitTest::getFeeByte(
+   unsigned confTarget, const string& strategy)
+{
+   //empty result for targets that weren't set
+   auto cachePtr = atomic_load(&currentEstimateCache_);
+   if (cachePtr == nullptr)
+      return CoreRPC::FeeEstimateResult();
+
+   auto iterStrat = cachePtr->find(strategy);
+   if (iterStrat == cachePtr->end())
+      return CoreRPC::FeeEstimateResult();
+
+   auto iterTarget = iterStrat->second.find(confTarget);
+   if (iterTarget == iterStrat->second.end())
+      return CoreRPC::FeeEstimateResult();
+
+   return iterTarget->second;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 int NodeRPC_UnitTest::broadcastTx(const BinaryDataRef& rawTx, string&)
 {
@@ -165,11 +165,11 @@ public:
    int broadcastTx(const BinaryDataRef&, std::string&) override;
 
    CoreRPC::FeeEstimateResult getFeeByte(
-      unsigned, const std::string&) override
-   { return CoreRPC::FeeEstimateResult(); }
+      unsigned, const std::string&) override;
 
    //locals
    void stallNextZc(unsigned);
+   void setFeeEstimate(unsigned, const std::string&, float);
 };
 
 #endif
\ No newline at end of file
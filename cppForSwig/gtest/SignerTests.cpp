@@ -297,6 +297,9 @@ TEST_F(SignerTest, DISABLED_CheckChain_Test)
       EXPECT_TRUE(false);
    }
 
+   //the tx are verified on the integrity check thread
+   bdm.startIntegrityCheck(TestUtils::nullProgress);
+   bdm.waitOnIntegrityCheck();
    EXPECT_EQ(bdm.getCheckedTxCount(), 20U);
 }
 
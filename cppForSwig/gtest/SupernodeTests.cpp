@@ -228,19 +228,21 @@ protected:
    BlockDataManagerThread *theBDMt_;
    Clients* clients_;
 
-   void initBDM(void)
+   void initBDM(const vector<string>& extraArgs = {})
    {
       DBTestUtils::init();
 
       Armory::Config::reset();
       DBSettings::setServiceType(SERVICE_UNITTEST);
-      Armory::Config::parseArgs({
+
+      vector<string> args {
          "--datadir=./fakehomedir",
          "--dbdir=./ldbtestdir",
          "--satoshi-datadir=./blkfiletest",
          "--db-type=DB_SUPER",
-         "--thread-count=3"},
-         Armory::Config::ProcessType::DB);
+         "--thread-count=3"};
+      args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+      Armory::Config::parseArgs(args, Armory::Config::ProcessType::DB);
 
       theBDMt_ = new BlockDataManagerThread();
       iface_ = theBDMt_->bdm()->getIFace();
@@ -379,6 +381,68 @@ TEST_F(BlockUtilsSuper, Load5Blocks)
    EXPECT_EQ(ssh.totalTxioCount_, 2U);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsSuper, Load5Blocks_StreamBlocks)
+{
+   //same as Load5Blocks, with blocks read into pooled buffers instead of
+   //mapped with their files
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   initBDM({ "--stream-blocks" });
+   ASSERT_TRUE(DBSettings::streamBlocks());
+
+   theBDMt_->start(DBSettings::initMode());
+   auto&& bdvID = DBTestUtils::registerBDV(clients_, BitcoinSettings::getMagicBytes());
+   DBTestUtils::goOnline(clients_, bdvID);
+   DBTestUtils::waitOnBDMReady(clients_, bdvID);
+
+   StoredScriptHistory ssh;
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrA);
+   EXPECT_EQ(ssh.getScriptBalance(), 50 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 50 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 1U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrB);
+   EXPECT_EQ(ssh.getScriptBalance(), 70 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 230 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 12U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrC);
+   EXPECT_EQ(ssh.getScriptBalance(), 20 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 75 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 6U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrD);
+   EXPECT_EQ(ssh.getScriptBalance(), 65 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 65 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 4U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrE);
+   EXPECT_EQ(ssh.getScriptBalance(), 30 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 30 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 2U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::scrAddrF);
+   EXPECT_EQ(ssh.getScriptBalance(), 5 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 45 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 7U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::lb1ScrAddr);
+   EXPECT_EQ(ssh.getScriptBalance(), 5 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 15 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 3U);
+
+   iface_->getStoredScriptHistory(ssh, TestChain::lb2ScrAddr);
+   EXPECT_EQ(ssh.getScriptBalance(), 30 * COIN);
+   EXPECT_EQ(ssh.getScriptReceived(), 40 * COIN);
+   EXPECT_EQ(ssh.totalTxioCount_, 4U);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsSuper, Load5Blocks_ReloadBDM)
 {
@@ -2123,6 +2187,10 @@ protected:
    BlockDataManagerThread *theBDMt_;
    PassphraseLambda authPeersPassLbd_;
 
+   //appended to the fixture's command line
+   virtual vector<string> extraArgs(void) const { return {}; }
+
+   /////////////////////////////////////////////////////////////////////////////
    void initBDM(void)
    {
       theBDMt_ = new BlockDataManagerThread();
@@ -2165,15 +2233,17 @@ protected:
       startupBIP150CTX(4);
 
       DBSettings::setServiceType(SERVICE_UNITTEST_WITHWS);
-      Armory::Config::parseArgs({
+      vector<string> args {
          "--datadir=./fakehomedir",
          "--dbdir=./ldbtestdir",
          "--satoshi-datadir=./blkfiletest",
          "--db-type=DB_SUPER",
          "--thread-count=3",
          "--public",
-         "--cookie"},
-         Armory::Config::ProcessType::DB);
+         "--cookie" };
+      auto&& extra = extraArgs();
+      args.insert(args.end(), extra.begin(), extra.end());
+      Armory::Config::parseArgs(args, Armory::Config::ProcessType::DB);
 
       //setup auth peers for server and client
       authPeersPassLbd_ = [](const set<EncryptionKeyId>&)->SecureBinaryData
@@ -3167,6 +3237,171 @@ TEST_F(WebSocketTests, DISABLED_WebSocketStack_ParallelAsync_ShutdownClients)
    theBDMt_ = nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class WebSocketTests_ListenThreads : public WebSocketTests
+{
+protected:
+   vector<string> extraArgs(void) const override
+   {
+      return { "--listen-threads=4" };
+   }
+};
+
+////////
+TEST_F(WebSocketTests_ListenThreads, DISABLED_WebSocketStack_ManyClients)
+{
+   /***
+   Load generator: connects thousands of authenticated clients to a server
+   spread over several lws service threads, keeps them all connected and 
+   has every one of them run a few requests concurrently.
+
+   Each client has its own socket and lws context on top of the server 
+   side socket, raise the fd limit (ulimit -n) before running this.
+   ***/
+
+   const unsigned clientCount = 2000;
+   const unsigned workerCount = 64;
+
+   WebSocketServer::initAuthPeers(authPeersPassLbd_);
+   WebSocketServer::start(theBDMt_, true);
+   auto&& serverPubkey = WebSocketServer::getPublicKey();
+   theBDMt_->start(DBSettings::initMode());
+
+   vector<shared_ptr<AsyncClient::BlockDataViewer>> bdvVec(clientCount);
+   vector<shared_ptr<DBTestUtils::UTCallback>> callbackVec(clientCount);
+   atomic<unsigned> counter = { 0 };
+   atomic<unsigned> failures = { 0 };
+
+   //connect & register all clients
+   auto connectLbd = [&](void)->void
+   {
+      while (true)
+      {
+         auto id = counter.fetch_add(1, memory_order_relaxed);
+         if (id >= clientCount)
+            return;
+
+         auto pCallback = make_shared<DBTestUtils::UTCallback>();
+         auto bdvObj = AsyncClient::BlockDataViewer::getNewBDV(
+            "127.0.0.1", NetworkSettings::listenPort(), 
+            Armory::Config::getDataDir(),
+            authPeersPassLbd_, 
+            NetworkSettings::ephemeralPeers(), true, //public server
+            pCallback);
+         bdvObj->addPublicKey(serverPubkey);
+         if (!bdvObj->connectToRemote())
+         {
+            failures.fetch_add(1, memory_order_relaxed);
+            continue;
+         }
+
+         bdvObj->registerWithDB(BitcoinSettings::getMagicBytes());
+         bdvObj->goOnline();
+         pCallback->waitOnSignal(BDMAction_Ready);
+
+         bdvVec[id] = bdvObj;
+         callbackVec[id] = pCallback;
+      }
+   };
+
+   vector<thread> thrV;
+   for (unsigned i = 0; i < workerCount; i++)
+      thrV.push_back(thread(connectLbd));
+   for (auto& thr : thrV)
+      thr.join();
+   thrV.clear();
+   ASSERT_EQ(failures.load(), 0U);
+
+   auto&& queueStats = WebSocketServer::getWriteQueueStats();
+   EXPECT_EQ(queueStats.size(), clientCount);
+
+   //clients are spread over every service thread
+   auto listenThreads = NetworkSettings::listenThreads();
+   ASSERT_GT(listenThreads, 1U);
+
+   auto&& threadLoads = WebSocketServer::getServiceThreadLoads();
+   ASSERT_EQ(threadLoads.size(), listenThreads);
+
+   size_t total = 0;
+   for (auto& load : threadLoads)
+   {
+      EXPECT_GE(load, clientCount / (listenThreads * 2));
+      total += load;
+   }
+   EXPECT_EQ(total, clientCount);
+
+   //all clients request concurrently
+   const unsigned requestCount = 10;
+   counter.store(0, memory_order_relaxed);
+   auto requestLbd = [&](void)->void
+   {
+      while (true)
+      {
+         auto id = counter.fetch_add(1, memory_order_relaxed);
+         if (id >= clientCount)
+            return;
+
+         vector<shared_ptr<promise<BinaryData>>> promV;
+         for (unsigned i = 0; i < requestCount; i++)
+         {
+            auto prom = make_shared<promise<BinaryData>>();
+            auto getHeader = [prom](ReturnMessage<BinaryData> msg)->void
+            {
+               try
+               {
+                  prom->set_value(msg.get());
+               }
+               catch (...)
+               {
+                  prom->set_exception(current_exception());
+               }
+            };
+
+            bdvVec[id]->getHeaderByHeight(i % 6, getHeader);
+            promV.push_back(prom);
+         }
+
+         for (auto& prom : promV)
+         {
+            try
+            {
+               auto header = prom->get_future().get();
+               if (header.getSize() != HEADER_SIZE)
+                  failures.fetch_add(1, memory_order_relaxed);
+            }
+            catch (...)
+            {
+               failures.fetch_add(1, memory_order_relaxed);
+            }
+         }
+      }
+   };
+
+   for (unsigned i = 0; i < workerCount; i++)
+      thrV.push_back(thread(requestLbd));
+   for (auto& thr : thrV)
+      thr.join();
+   thrV.clear();
+   EXPECT_EQ(failures.load(), 0U);
+
+   for (auto& bdvObj : bdvVec)
+      bdvObj->unregisterFromDB();
+   bdvVec.clear();
+   callbackVec.clear();
+
+   auto&& bdvObj2 = AsyncClient::BlockDataViewer::getNewBDV(
+      "127.0.0.1", NetworkSettings::listenPort(), Armory::Config::getDataDir(),
+      authPeersPassLbd_, NetworkSettings::ephemeralPeers(), true, nullptr);
+   bdvObj2->addPublicKey(serverPubkey);
+   bdvObj2->connectToRemote();
+
+   bdvObj2->shutdown(NetworkSettings::cookie());
+   WebSocketServer::waitOnShutdown();
+
+   delete theBDMt_;
+   theBDMt_ = nullptr;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(WebSocketTests, WebSocketStack_ManyLargeWallets)
 {
@@ -3469,6 +3704,109 @@ TEST_F(WebSocketTests, WebSocketStack_AddrOpLoop)
       EXPECT_EQ(iterAddrF->second.size(), 4ULL);
       EXPECT_EQ(computeBalance(iterAddrF->second), 5 * COIN);
 
+      //same query in small pages
+      {
+         auto pagesProm = make_shared<promise<vector<OutpointBatch>>>();
+         auto pagesFut = pagesProm->get_future();
+         auto pages = make_shared<vector<OutpointBatch>>();
+         auto pageLbd = [pagesProm, pages](
+            ReturnMessage<OutpointBatch> batch)->void
+         {
+            pages->push_back(batch.get());
+            if (pages->back().token_.empty())
+               pagesProm->set_value(*pages);
+         };
+
+         bdvObj->getOutpointsForAddresses(
+            scrAddrSet, 0, UINT32_MAX, 5, pageLbd);
+         auto&& pageVec = pagesFut.get();
+         EXPECT_GT(pageVec.size(), 1ULL);
+
+         map<BinaryData, vector<OutpointData>> merged;
+         for (auto& page : pageVec)
+         {
+            for (auto& opPair : page.outpoints_)
+            {
+               //pages break on address boundaries
+               EXPECT_TRUE(merged.emplace(opPair).second);
+            }
+         }
+
+         EXPECT_EQ(pageVec.back().heightCutoff_, addrOp.heightCutoff_);
+         ASSERT_EQ(merged.size(), addrOp.outpoints_.size());
+         for (auto& opPair : addrOp.outpoints_)
+         {
+            auto iter = merged.find(opPair.first);
+            ASSERT_NE(iter, merged.end());
+            EXPECT_EQ(iter->second.size(), opPair.second.size());
+            EXPECT_EQ(computeBalance(iter->second), 
+               computeBalance(opPair.second));
+         }
+      }
+
+      //batched utxo query matches the per address one
+      for (auto withZc : { false, true })
+      {
+         auto batchProm = make_shared<promise<map<BinaryData, vector<UTXO>>>>();
+         auto batchFut = batchProm->get_future();
+         auto batchLbd = [batchProm](
+            ReturnMessage<map<BinaryData, vector<UTXO>>> msg)->void
+         {
+            batchProm->set_value(msg.get());
+         };
+
+         bdvObj->getUTXOsForAddresses(scrAddrSet, withZc, batchLbd);
+         auto&& utxoMap = batchFut.get();
+         EXPECT_FALSE(utxoMap.empty());
+
+         for (auto& scrAddr : scrAddrSet)
+         {
+            auto utxoProm = make_shared<promise<vector<UTXO>>>();
+            auto utxoFut = utxoProm->get_future();
+            auto utxoLbd = [utxoProm](ReturnMessage<vector<UTXO>> msg)->void
+            {
+               utxoProm->set_value(msg.get());
+            };
+
+            bdvObj->getUTXOsForAddress(scrAddr, withZc, utxoLbd);
+            auto&& utxoVec = utxoFut.get();
+
+            auto iter = utxoMap.find(scrAddr);
+            if (utxoVec.empty())
+            {
+               EXPECT_EQ(iter, utxoMap.end());
+               continue;
+            }
+
+            ASSERT_NE(iter, utxoMap.end());
+            ASSERT_EQ(iter->second.size(), utxoVec.size());
+            for (unsigned i = 0; i < utxoVec.size(); i++)
+            {
+               EXPECT_EQ(iter->second[i].txHash_, utxoVec[i].txHash_);
+               EXPECT_EQ(iter->second[i].txOutIndex_, utxoVec[i].txOutIndex_);
+               EXPECT_EQ(iter->second[i].value_, utxoVec[i].value_);
+               EXPECT_EQ(iter->second[i].txHeight_, utxoVec[i].txHeight_);
+            }
+         }
+
+         //confirmed utxos line up with the unspent outpoints
+         if (withZc)
+            continue;
+
+         for (auto& opPair : addrOp.outpoints_)
+         {
+            uint64_t utxoTotal = 0;
+            auto iter = utxoMap.find(opPair.first);
+            if (iter != utxoMap.end())
+            {
+               for (auto& utxo : iter->second)
+                  utxoTotal += utxo.getValue();
+            }
+
+            EXPECT_EQ(utxoTotal, computeBalance(opPair.second));
+         }
+      }
+
       //check zc outputs
       auto zcAddrOp = getAddrOp(UINT32_MAX, 0);
       ASSERT_EQ(zcAddrOp.outpoints_.size(), loopCount + 1);
@@ -137,6 +137,21 @@ namespace TestUtils
          concatFile(dataDir + "/blk_" + f + ".dat", to);
    }
 
+   /////////////////////////////////////////////////////////////////////////////
+   BinaryData getRawBlock(const std::string& name)
+   {
+      std::ifstream blkfile(dataDir + "/blk_" + name + ".dat", ios::binary);
+      blkfile.seekg(0, ios::end);
+      auto size = blkfile.tellg();
+      blkfile.seekg(0, ios::beg);
+
+      BinaryData data(size);
+      blkfile.read((char*)data.getPtr(), size);
+
+      //skip the magic word and block size
+      return data.getSliceCopy(8, data.getSize() - 8);
+   }
+
    /////////////////////////////////////////////////////////////////////////////
    void nullProgress(unsigned, double, unsigned, unsigned)
    {}
@@ -238,13 +253,16 @@ namespace DBTestUtils
 
    /////////////////////////////////////////////////////////////////////////////
    void registerWallet(Clients* clients, const string& bdvId,
-      const vector<BinaryData>& scrAddrs, const string& wltName)
+      const vector<BinaryData>& scrAddrs, const string& wltName,
+      unsigned birthHeight)
    {
       auto message = make_shared<BDVCommand>();
       message->set_method(Methods::registerWallet);
       message->set_bdvid(bdvId);
       message->set_walletid(wltName);
       message->set_flag(false);
+      if (birthHeight != 0)
+         message->set_height(birthHeight);
       auto&& id = CryptoPRNG::generateRandom(5).toHexStr();
       message->set_hash(id);
 
@@ -574,6 +592,15 @@ namespace DBTestUtils
       zcDelays_.push_back(delay);
    }
 
+   /////////////////////////////////////////////////////////////////////////////
+   unsigned getMempoolDepthBound(const MempoolStats& stats)
+   {
+      //AVL trees are at most 1.44 * log2(n + 2) deep, none of the snapshot
+      //maps is larger than the sum of the reported sizes
+      auto count = stats.txCount_ + stats.txioCount_ + stats.scrAddrCount_;
+      return unsigned(1.4405 * log2(double(count + 2)));
+   }
+
    /////////////////////////////////////////////////////////////////////////////
    pair<BinaryData, BinaryData> getAddrAndPubKeyFromPrivKey(
       BinaryData privKey, bool compressed)
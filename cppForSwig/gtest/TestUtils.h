@@ -101,6 +101,9 @@ namespace TestUtils
    void concatFile(const std::string &from, const std::string &to);
    void appendBlocks(const std::vector<std::string> &files, const std::string &to);
    void setBlocks(const std::vector<std::string> &files, const std::string &to);
+
+   //block from the test chain, without its blk file prefix
+   BinaryData getRawBlock(const std::string& name);
    void nullProgress(unsigned, double, unsigned, unsigned);
    BinaryData getTx(unsigned height, unsigned id);
 
@@ -124,7 +127,8 @@ namespace DBTestUtils
    const std::shared_ptr<BDV_Server_Object> getBDV(Clients* clients, const std::string& id);
    
    void registerWallet(Clients* clients, const std::string& bdvId,
-      const std::vector<BinaryData>& scrAddrs, const std::string& wltName);
+      const std::vector<BinaryData>& scrAddrs, const std::string& wltName,
+      unsigned birthHeight = 0);
    void regLockbox(Clients* clients, const std::string& bdvId,
       const std::vector<BinaryData>& scrAddrs, const std::string& wltName);
 
@@ -167,6 +171,9 @@ namespace DBTestUtils
 
    void pushNewZc(BlockDataManagerThread* bdmt, const ZcVector& zcVec, bool stage = false);
    void setNextZcPushDelay(unsigned);
+
+   //worst case lookup depth of the mempool snapshot maps for their size
+   unsigned getMempoolDepthBound(const MempoolStats&);
    std::pair<BinaryData, BinaryData> getAddrAndPubKeyFromPrivKey(
       BinaryData privKey, bool compressed = false);
 
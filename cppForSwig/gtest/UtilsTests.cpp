@@ -14,10 +14,20 @@
 #include "TestUtils.h"
 #include "hkdf.h"
 #include "BlockchainDatabase/TxHashFilters.h"
+#include "BlockchainDatabase/BlockFilters.h"
+#include "BlockchainDatabase/ScriptRefTable.h"
+#include "BlockchainDatabase/ScanBatchController.h"
+#include "BlockchainDatabase/ByteRateThrottle.h"
+#include "BlockchainDatabase/BlockStream.h"
+#include "BlockchainDatabase/SshParser.h"
+#include "Executor.h"
+#include "SocketWritePayload.h"
+#include "BIP15x_Handshake.h"
 
 using namespace std;
 using namespace Armory::Signer;
 using namespace Armory::Config;
+using namespace Armory::Threading;
 using namespace Armory::Wallets::Encryption;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -5998,6 +6008,104 @@ TEST_F(LMDBTest, PutGetStoredTxHints)
    EXPECT_EQ(   sths.preferredDBKey_.getSize(), 0ULL);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, BulkWriter_MatchesPutValue)
+{
+   ASSERT_TRUE(standardOpenDBs());
+
+   //same hints, one half through putValue, the other through the bulk 
+   //writer, out of order and interleaved with the first half
+   vector<pair<BinaryData, BinaryData>> hints;
+   for (uint32_t i = 0; i < 40; i++)
+   {
+      BinaryWriter bwKey;
+      bwKey.put_uint8_t((uint8_t)DB_PREFIX_TXHINTS);
+      bwKey.put_uint32_t((i * 7) % 40, BE);
+
+      BinaryWriter bwVal;
+      bwVal.put_uint8_t(1);
+      bwVal.put_uint32_t(i, BE);
+      bwVal.put_uint16_t(0, BE);
+      hints.push_back(make_pair(bwKey.getData(), bwVal.getData()));
+   }
+
+   {
+      auto&& tx = iface_->beginTransaction(TXHINTS, LMDB::ReadWrite);
+      for (unsigned i = 0; i < hints.size(); i += 2)
+         iface_->putValue(TXHINTS, hints[i].first, hints[i].second);
+   }
+
+   LMDB::BulkLoader::Stats stats;
+   {
+      auto&& tx = iface_->beginTransaction(TXHINTS, LMDB::ReadWrite);
+      auto&& bulkWriter = iface_->getBulkWriter(TXHINTS);
+      for (unsigned i = 1; i < hints.size(); i += 2)
+      {
+         bulkWriter.putValue(
+            hints[i].first.getRef(), hints[i].second.getRef());
+      }
+
+      EXPECT_EQ(bulkWriter.size(), 20U);
+      stats = bulkWriter.commit();
+   }
+   EXPECT_EQ(stats.appended_ + stats.inserted_, 20U);
+
+   //readers see both halves the same way
+   auto&& tx = iface_->beginTransaction(TXHINTS, LMDB::ReadOnly);
+   for (auto& hint : hints)
+   {
+      EXPECT_EQ(iface_->getValueNoCopy(TXHINTS, hint.first), hint.second);
+
+      StoredTxHints sths;
+      ASSERT_TRUE(iface_->getStoredTxHints(
+         sths, hint.first.getSliceRef(1, 4)));
+      ASSERT_EQ(sths.dbKeyList_.size(), 1U);
+      EXPECT_EQ(sths.preferredDBKey_, hint.second.getSliceRef(1, 6));
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, BlockFilters_HashCheck)
+{
+   ASSERT_TRUE(standardOpenDBs());
+
+   BinaryData hashA(32), hashB(32);
+   memset(hashA.getPtr(), 0xaa, 32);
+   memset(hashB.getPtr(), 0xbb, 32);
+
+   map<uint32_t, pair<BinaryData, BinaryData>> filters;
+   filters.emplace(5, make_pair(hashA, READHEX("0102")));
+   filters.emplace(6, make_pair(hashB, READHEX("030405")));
+   iface_->putBlockFilters(filters);
+
+   {
+      auto&& tx = iface_->beginTransaction(TXFILTERS, LMDB::ReadOnly);
+      EXPECT_EQ(iface_->getBlockFilterRef(5, hashA), READHEX("0102"));
+      EXPECT_EQ(iface_->getBlockFilterRef(6, hashB), READHEX("030405"));
+
+      //id carried over to another block, or no filter at all
+      EXPECT_TRUE(iface_->getBlockFilterRef(5, hashB).empty());
+      EXPECT_TRUE(iface_->getBlockFilterRef(6, hashA).empty());
+      EXPECT_TRUE(iface_->getBlockFilterRef(7, hashA).empty());
+   }
+
+   //rebuilt for the block now holding that id
+   filters.clear();
+   filters.emplace(5, make_pair(hashB, READHEX("06")));
+   iface_->putBlockFilters(filters);
+
+   {
+      auto&& tx = iface_->beginTransaction(TXFILTERS, LMDB::ReadOnly);
+      EXPECT_TRUE(iface_->getBlockFilterRef(5, hashA).empty());
+      EXPECT_EQ(iface_->getBlockFilterRef(5, hashB), READHEX("06"));
+   }
+
+   //needs a full block hash
+   filters.clear();
+   filters.emplace(8, make_pair(READHEX("aabb"), READHEX("06")));
+   EXPECT_THROW(iface_->putBlockFilters(filters), runtime_error);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class TxRefTest : public ::testing::Test
@@ -6652,75 +6760,2517 @@ TEST_F(TestTxHashFilters, FilterALot)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-class KdfTests : public ::testing::Test
+class BlockFilterTests : public ::testing::Test
 {
 protected:
    virtual void SetUp(void)
    {}
+
+   vector<BinaryData> randomElements(unsigned count, size_t len)
+   {
+      vector<BinaryData> result;
+      for (unsigned i = 0; i < count; i++)
+         result.emplace_back(CryptoPRNG::generateRandom(len));
+      return result;
+   }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-TEST_F(KdfTests, Romix)
+TEST_F(BlockFilterTests, SipHash)
 {
-   uint32_t targetUnlock_ms = 2000;
+   //reference vectors, key 00..0f, message 00..(len-1)
+   uint64_t k0 = 0x0706050403020100ULL;
+   uint64_t k1 = 0x0f0e0d0c0b0a0908ULL;
 
-   //create a KDF object
-   KeyDerivationFunction_Romix kdfRom(targetUnlock_ms);
-   EXPECT_GE(kdfRom.memTarget(), 8092);
+   BinaryData msg;
+   EXPECT_EQ(GolombFilter::sipHash(k0, k1, msg.getRef()),
+      0x726fdb47dd0e0e31ULL);
+
+   for (uint8_t i = 0; i < 8; i++)
+      msg.append(i);
+   EXPECT_EQ(GolombFilter::sipHash(k0, k1, msg.getRef()),
+      0x93f5f5799a932462ULL);
+
+   for (uint8_t i = 8; i < 15; i++)
+      msg.append(i);
+   EXPECT_EQ(GolombFilter::sipHash(k0, k1, msg.getRef()),
+      0xa129ca6149be45e5ULL);
+}
 
-   //derive key with it, check it takes over 2sec
-   auto keyToDerive = SecureBinaryData::fromString("0123456789AB");
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockFilterTests, MatchAndSerialize)
+{
+   auto blockHash = CryptoPRNG::generateRandom(32);
+   auto elements = randomElements(1000, 21);
+
+   //duplicates are dropped
+   auto withDupes = elements;
+   withDupes.insert(withDupes.end(), elements.begin(), elements.begin() + 10);
+
+   GolombFilter filter(blockHash.getRef(), withDupes);
+   EXPECT_EQ(filter.size(), 1000U);
+
+   auto serialized = filter.serialize();
+   GolombFilter readBack(blockHash.getRef(), serialized.getRef());
+   EXPECT_EQ(readBack.size(), 1000U);
+   EXPECT_EQ(readBack.serialize(), serialized);
+
+   //no false negatives
+   for (auto& element : elements)
+      ASSERT_TRUE(readBack.match(element.getRef()));
+
+   //false positive rate is 1/M per queried element
+   auto others = randomElements(1000, 21);
+   unsigned hits = 0;
+   for (auto& other : others)
    {
-      auto start = chrono::system_clock::now();
-      auto derivedKey = kdfRom.deriveKey(keyToDerive);
-      auto end = chrono::system_clock::now();
+      if (readBack.match(other.getRef()))
+         ++hits;
+   }
+   EXPECT_LE(hits, 1U);
+
+   //matchAny
+   EXPECT_EQ(readBack.matchAny(others), hits > 0);
+   others.push_back(elements[500]);
+   EXPECT_TRUE(readBack.matchAny(others));
+   EXPECT_TRUE(readBack.matchAny({ elements.front() }));
+   EXPECT_TRUE(readBack.matchAny({ elements.back() }));
+   EXPECT_FALSE(readBack.matchAny({}));
+
+   //filters are keyed by block hash
+   auto otherHash = CryptoPRNG::generateRandom(32);
+   GolombFilter wrongKey(otherHash.getRef(), serialized.getRef());
+   unsigned wrongHits = 0;
+   for (auto& element : elements)
+   {
+      if (wrongKey.match(element.getRef()))
+         ++wrongHits;
+   }
+   EXPECT_LE(wrongHits, 1U);
+}
 
-      EXPECT_NE(derivedKey, keyToDerive);
-      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
-      EXPECT_GE(diff.count(), targetUnlock_ms);
-      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockFilterTests, Malformed)
+{
+   auto blockHash = CryptoPRNG::generateRandom(32);
+
+   //empty set
+   GolombFilter emptyFilter(blockHash.getRef(), vector<BinaryData>());
+   EXPECT_EQ(emptyFilter.size(), 0U);
+   GolombFilter emptyRead(
+      blockHash.getRef(), emptyFilter.serialize().getRef());
+   EXPECT_FALSE(emptyRead.matchAny(randomElements(10, 21)));
+
+   //missing data
+   EXPECT_THROW(GolombFilter(blockHash.getRef(), BinaryDataRef()),
+      BlockFilterException);
+
+   //short key
+   EXPECT_THROW(GolombFilter(
+      blockHash.getSliceRef(0, 8), emptyFilter.serialize().getRef()),
+      BlockFilterException);
+
+   //truncated stream
+   auto elements = randomElements(100, 21);
+   GolombFilter filter(blockHash.getRef(), elements);
+   auto serialized = filter.serialize();
+   auto truncated = serialized.getSliceCopy(0, serialized.getSize() / 2);
+
+   GolombFilter badFilter(blockHash.getRef(), truncated.getRef());
+   unsigned overruns = 0;
+   for (auto& element : elements)
+   {
+      try
+      {
+         badFilter.match(element.getRef());
+      }
+      catch (const BlockFilterException&)
+      {
+         ++overruns;
+      }
    }
-   kdfRom.prettyPrint();
+   EXPECT_GT(overruns, 0U);
 
-   //deser kdf object into a copy, check it load correctly
-   auto serializedKdf = kdfRom.serialize();
-   auto kdfCopy = KeyDerivationFunction::deserialize(serializedKdf);
-   auto kdfRom2 = dynamic_pointer_cast<KeyDerivationFunction_Romix>(kdfCopy);
-   ASSERT_NE(kdfRom2, nullptr);
-   EXPECT_TRUE(kdfRom.isSame(kdfRom2.get()));
+   //header only
+   auto headerOnly = serialized.getSliceCopy(0, 1);
+   EXPECT_THROW(GolombFilter(blockHash.getRef(), headerOnly.getRef()),
+      BlockFilterException);
+}
 
-   //derive key with kdf copy, check it takes over 2sec
+////////////////////////////////////////////////////////////////////////////////
+class ScriptRefTableTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {}
+
+   vector<BinaryData> randomScrAddrs(unsigned count)
    {
-      auto start = chrono::system_clock::now();
-      auto derivedKey = kdfRom2->deriveKey(keyToDerive);
-      auto end = chrono::system_clock::now();
+      const uint8_t prefixes[] = { 
+         SCRIPT_PREFIX_HASH160, SCRIPT_PREFIX_P2SH, 
+         SCRIPT_PREFIX_P2WPKH, SCRIPT_PREFIX_P2WSH };
 
-      EXPECT_NE(derivedKey, keyToDerive);
-      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
-      EXPECT_GE(diff.count(), targetUnlock_ms);
-      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+      vector<BinaryData> result;
+      for (unsigned i = 0; i < count; i++)
+      {
+         auto prefix = prefixes[i % 4];
+         size_t len = prefix == SCRIPT_PREFIX_P2WSH ? 32 : 20;
+
+         BinaryData scrAddr(1);
+         scrAddr.getPtr()[0] = prefix;
+         scrAddr.append(CryptoPRNG::generateRandom(len));
+         result.emplace_back(move(scrAddr));
+      }
+
+      return result;
    }
-   kdfRom2->prettyPrint();
+};
 
-   //create kdf with same params but its own salt
-   KeyDerivationFunction_Romix kdfRom3(
-      kdfRom.iterations(),
-      kdfRom.memTarget(),
-      CryptoPRNG::generateRandom(32)
-   );
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ScriptRefTableTests, Lookup)
+{
+   auto scrAddrs = randomScrAddrs(5000);
 
-   //derive key with 3rd kdf, check it takes over 2sec
+   vector<pair<BinaryDataRef, int>> entries;
+   for (unsigned i = 0; i < scrAddrs.size(); i++)
+      entries.emplace_back(scrAddrs[i].getRef(), i);
+
+   ScriptRefTable table(entries);
+   ASSERT_EQ(table.size(), scrAddrs.size());
+
+   for (unsigned i = 0; i < scrAddrs.size(); i++)
    {
-      auto start = chrono::system_clock::now();
-      auto derivedKey = kdfRom3.deriveKey(keyToDerive);
-      auto end = chrono::system_clock::now();
+      int height = -1;
+      ASSERT_TRUE(table.find(scrAddrs[i].getRef(), height));
+      EXPECT_EQ(height, (int)i);
+   }
 
-      EXPECT_NE(derivedKey, keyToDerive);
-      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
-      EXPECT_GE(diff.count(), targetUnlock_ms);
-      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+   //same script under another prefix
+   {
+      auto scrAddr = scrAddrs[0];
+      scrAddr.getPtr()[0] = SCRIPT_PREFIX_NONSTD;
+      int height;
+      EXPECT_FALSE(table.find(scrAddr.getRef(), height));
    }
-   kdfRom3.prettyPrint();
+
+   //misses
+   auto misses = randomScrAddrs(20000);
+   for (auto& miss : misses)
+   {
+      int height;
+      EXPECT_FALSE(table.find(miss.getRef(), height));
+   }
+
+   //refreshed heights share the key index
+   vector<int> heights;
+   for (unsigned i = 0; i < scrAddrs.size(); i++)
+      heights.push_back(i * 2);
+
+   ScriptRefTable refreshed(table, heights);
+   for (unsigned i = 0; i < scrAddrs.size(); i++)
+   {
+      int height = -1;
+      ASSERT_TRUE(refreshed.find(scrAddrs[i].getRef(), height));
+      EXPECT_EQ(height, (int)i * 2);
+
+      table.find(scrAddrs[i].getRef(), height);
+      EXPECT_EQ(height, (int)i);
+   }
+
+   heights.pop_back();
+   EXPECT_THROW(ScriptRefTable(table, heights), runtime_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ScriptRefTableTests, Invalid)
+{
+   auto scrAddrs = randomScrAddrs(10);
+
+   //empty table
+   {
+      vector<pair<BinaryDataRef, int>> entries;
+      ScriptRefTable table(entries);
+
+      int height;
+      EXPECT_EQ(table.size(), 0U);
+      EXPECT_FALSE(table.find(scrAddrs[0].getRef(), height));
+   }
+
+   //duplicate
+   {
+      vector<pair<BinaryDataRef, int>> entries;
+      for (auto& scrAddr : scrAddrs)
+         entries.emplace_back(scrAddr.getRef(), 0);
+      entries.emplace_back(scrAddrs[3].getRef(), 1);
+
+      EXPECT_THROW(ScriptRefTable table(entries), runtime_error);
+   }
+
+   //empty key
+   {
+      vector<pair<BinaryDataRef, int>> entries;
+      entries.emplace_back(scrAddrs[0].getRef(), 0);
+      entries.emplace_back(BinaryDataRef(), 0);
+
+      EXPECT_THROW(ScriptRefTable table(entries), runtime_error);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LedgerEntryTests, Serialize)
+{
+   auto txHash = CryptoPRNG::generateRandom(32);
+   LedgerEntry le("wallet1", -150000, 123456, txHash, 42, 1500000000,
+      false, true, false, true, true, false);
+
+   auto&& data = le.serialize();
+   auto le2 = LedgerEntry::unserialize(data.getRef(), "wallet2");
+
+   EXPECT_EQ(le2.getWalletID(), "wallet2");
+   EXPECT_EQ(le2.getValue(), -150000);
+   EXPECT_EQ(le2.getBlockNum(), 123456U);
+   EXPECT_EQ(le2.getTxHash(), txHash);
+   EXPECT_EQ(le2.getIndex(), 42U);
+   EXPECT_EQ(le2.getTxTime(), 1500000000U);
+   EXPECT_FALSE(le2.isCoinbase());
+   EXPECT_TRUE(le2.isSentToSelf());
+   EXPECT_FALSE(le2.isChangeBack());
+   EXPECT_TRUE(le2.isOptInRBF());
+   EXPECT_TRUE(le2.usesWitness());
+   EXPECT_FALSE(le2.isChainedZC());
+   EXPECT_TRUE(le2.getScrAddrList().empty());
+
+   //truncated
+   auto truncated = data.getSliceRef(0, data.getSize() - 1);
+   EXPECT_ANY_THROW(LedgerEntry::unserialize(truncated, "wallet1"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LedgerCacheTests, MetaRanges)
+{
+   LedgerCache::Meta meta;
+
+   //disjoint ranges stay apart
+   meta.addRange(10, 20);
+   meta.addRange(30, 40);
+   ASSERT_EQ(meta.ranges_.size(), 2U);
+
+   //adjacent ranges merge
+   meta.addRange(21, 25);
+   ASSERT_EQ(meta.ranges_.size(), 2U);
+   EXPECT_EQ(meta.ranges_.begin()->first, 10U);
+   EXPECT_EQ(meta.ranges_.begin()->second, 25U);
+
+   //a range covering a gap merges both sides
+   meta.addRange(26, 29);
+   ASSERT_EQ(meta.ranges_.size(), 1U);
+   EXPECT_EQ(meta.ranges_.begin()->first, 10U);
+   EXPECT_EQ(meta.ranges_.begin()->second, 40U);
+
+   //overlap on the low side, contained range
+   meta.addRange(5, 12);
+   meta.addRange(15, 18);
+   ASSERT_EQ(meta.ranges_.size(), 1U);
+   EXPECT_EQ(meta.ranges_.begin()->first, 5U);
+   EXPECT_EQ(meta.ranges_.begin()->second, 40U);
+
+   meta.addRange(0, 0);
+   meta.addRange(50, 60);
+   ASSERT_EQ(meta.ranges_.size(), 3U);
+
+   //cap inside a range
+   meta.capRanges(35);
+   ASSERT_EQ(meta.ranges_.size(), 2U);
+   EXPECT_EQ(meta.ranges_.rbegin()->first, 5U);
+   EXPECT_EQ(meta.ranges_.rbegin()->second, 34U);
+
+   //cap on a range start
+   meta.capRanges(5);
+   ASSERT_EQ(meta.ranges_.size(), 1U);
+   EXPECT_EQ(meta.ranges_.begin()->first, 0U);
+   EXPECT_EQ(meta.ranges_.begin()->second, 0U);
+
+   meta.capRanges(0);
+   EXPECT_TRUE(meta.ranges_.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LedgerCacheTests, MetaSerialize)
+{
+   LedgerCache::Meta meta;
+   meta.cacheId_ = LedgerCache::computeCacheId("wallet1");
+   meta.tipHeight_ = 1234;
+   meta.tipHash_ = CryptoPRNG::generateRandom(32);
+   meta.addrDigest_ = CryptoPRNG::generateRandom(32);
+   meta.lastUsed_ = 1600000000;
+   meta.addRange(0, 100);
+   meta.addRange(200, 1234);
+
+   auto&& data = meta.serialize();
+   LedgerCache::Meta meta2;
+   meta2.unserialize(data.getRef());
+
+   EXPECT_EQ(meta2.cacheId_, meta.cacheId_);
+   EXPECT_EQ(meta2.tipHeight_, meta.tipHeight_);
+   EXPECT_EQ(meta2.tipHash_, meta.tipHash_);
+   EXPECT_EQ(meta2.addrDigest_, meta.addrDigest_);
+   EXPECT_EQ(meta2.lastUsed_, meta.lastUsed_);
+   EXPECT_EQ(meta2.ranges_, meta.ranges_);
+
+   //the cache id only depends on the wallet id
+   EXPECT_EQ(LedgerCache::computeCacheId("wallet1"), meta.cacheId_);
+   EXPECT_NE(LedgerCache::computeCacheId("wallet2"), meta.cacheId_);
+
+   //other versions are rejected
+   data.getPtr()[0] = LEDGERCACHE_VERSION - 1;
+   EXPECT_ANY_THROW(meta2.unserialize(data.getRef()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ScanBatchControllerTests, Adjust)
+{
+   const size_t mb = 1024 * 1024;
+   size_t memory = 1000 * mb;
+   auto probe = [&memory](void)->size_t { return memory; };
+
+   //4 levels: 512MB budget, 4 queued batches + 1 in flight
+   ScanBatchController controller(4, probe);
+   EXPECT_EQ(controller.budget(), 512 * mb);
+   EXPECT_EQ(controller.queueDepth(), 4U);
+   auto size = controller.batchSize();
+   EXPECT_EQ(size, 512 * mb / 5);
+
+   //idle commit stage, but the queue already fills the budget
+   controller.stageDone(ScanStage_Commit, size, 1.0);
+   controller.commitIdle(3.0);
+   controller.batchCommitted(size);
+   EXPECT_EQ(controller.batchSize(), size);
+   EXPECT_EQ(controller.queueDepth(), 4U);
+
+   //over budget: shrink
+   memory = 1600 * mb;
+   controller.batchCommitted(size);
+   EXPECT_EQ(controller.batchSize(), size / 2);
+   EXPECT_EQ(controller.queueDepth(), 3U);
+
+   //no growth during the cooldown
+   memory = 1000 * mb;
+   for (unsigned i = 0; i < SCAN_GROW_COOLDOWN; i++)
+   {
+      controller.stageDone(ScanStage_Commit, size, 1.0);
+      controller.commitIdle(3.0);
+      controller.batchCommitted(size);
+      EXPECT_EQ(controller.batchSize(), size / 2);
+      EXPECT_EQ(controller.queueDepth(), 3U);
+   }
+
+   //busy commit stage: hold
+   controller.stageDone(ScanStage_Commit, size, 3.0);
+   controller.commitIdle(1.0);
+   controller.batchCommitted(size);
+   EXPECT_EQ(controller.batchSize(), size / 2);
+   EXPECT_EQ(controller.queueDepth(), 3U);
+
+   //idle commit stage: grow
+   controller.stageDone(ScanStage_Commit, size, 1.0);
+   controller.commitIdle(3.0);
+   controller.batchCommitted(size);
+   EXPECT_EQ(controller.batchSize(), size / 2 + size / 4);
+   EXPECT_EQ(controller.queueDepth(), 4U);
+
+   //shrinking stops at the floor
+   memory = 100000 * mb;
+   for (unsigned i = 0; i < 10; i++)
+      controller.batchCommitted(size);
+   EXPECT_EQ(controller.batchSize(), SCAN_BATCH_SIZE_MIN);
+   EXPECT_EQ(controller.queueDepth(), 1U);
+
+   //no probe, in flight data stands in for memory use
+   ScanBatchController noProbe(1, [](void)->size_t { return 0; });
+   EXPECT_EQ(noProbe.queueDepth(), 1U);
+   noProbe.batchQueued(200 * mb);
+   noProbe.batchCommitted(0);
+   EXPECT_EQ(noProbe.batchSize(), 64 * mb / 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ByteRateThrottleTests, Consume)
+{
+   auto elapsed = [](chrono::steady_clock::time_point start)->double
+   {
+      return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   };
+
+   //no rate, no wait
+   ByteRateThrottle unthrottled(0);
+   auto start = chrono::steady_clock::now();
+   for (unsigned i = 0; i < 1000; i++)
+      EXPECT_TRUE(unthrottled.consume(1024 * 1024));
+   EXPECT_LT(elapsed(start), 0.1);
+
+   //1MB/s: 4 threads going through 100KB each, 5 times
+   ByteRateThrottle throttle(1024 * 1024);
+   auto consumeLbd = [&throttle](void)->void
+   {
+      for (unsigned i = 0; i < 5; i++)
+         EXPECT_TRUE(throttle.consume(100 * 1024));
+   };
+
+   start = chrono::steady_clock::now();
+   vector<thread> threads;
+   for (unsigned i = 0; i < 4; i++)
+      threads.emplace_back(consumeLbd);
+   for (auto& thr : threads)
+      thr.join();
+
+   auto spent = elapsed(start);
+   EXPECT_GE(spent, 1.8);
+   EXPECT_LT(spent, 3.0);
+
+   //halting wakes up sleepers
+   ByteRateThrottle slow(1024);
+   auto halter = thread([&slow](void)->void
+   {
+      this_thread::sleep_for(chrono::milliseconds(50));
+      slow.halt();
+   });
+
+   start = chrono::steady_clock::now();
+   EXPECT_FALSE(slow.consume(1024 * 1024));
+   EXPECT_LT(elapsed(start), 1.0);
+   halter.join();
+
+   EXPECT_TRUE(slow.halted());
+   EXPECT_FALSE(slow.consume(1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(MemoryBlockStoreTests, AddAndServe)
+{
+   auto genesis = READHEX(
+      "0100000000000000000000000000000000000000000000000000000000000000"
+      "000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa"
+      "4b1e5e4a29ab5f49ffff001d1dac2b7c01010000000100000000000000000000"
+      "00000000000000000000000000000000000000000000ffffffff4d04ffff001d"
+      "0104455468652054696d65732030332f4a616e2f32303039204368616e63656c"
+      "6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f75742066"
+      "6f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe554827"
+      "1967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4"
+      "f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000");
+   auto genesisHash = READHEX(
+      "6fe28c0ab6f1b372c1a6a246ae63f74f931e8365e15a089c68d6190000000000");
+
+   unsigned nextID = 10;
+   auto getID = [&nextID](const BinaryData&)->unsigned int
+   {
+      return nextID++;
+   };
+
+   auto& store = MemoryBlockStore::shared();
+   ASSERT_EQ(store.count(), 0U);
+
+   //tampered tx fails the merkle check
+   auto tampered = genesis;
+   tampered.getPtr()[200] ^= 1;
+   EXPECT_EQ(store.add(tampered, getID), UINT32_MAX);
+
+   auto fileID = store.add(genesis, getID);
+   ASSERT_TRUE(MemoryBlockStore::isMemoryFileID(fileID));
+   EXPECT_EQ(store.add(genesis, getID), UINT32_MAX);
+   EXPECT_EQ(store.count(), 1U);
+
+   //parsed, with the file position the chain update gives its header
+   auto&& blocks = store.getBlocks();
+   ASSERT_EQ(blocks.size(), 1U);
+   auto header = blocks[fileID]->createBlockHeader();
+   EXPECT_EQ(header->getThisHash(), genesisHash);
+   EXPECT_EQ(header->getBlockFileNum(), fileID);
+   EXPECT_EQ(header->getOffset(), 0U);
+   EXPECT_EQ(header->getBlockSize(), genesis.getSize());
+   EXPECT_EQ(header->getThisID(), 11U);
+
+   //served by block data loaders, whatever their folder
+   BlockDataLoader bdl("/nonexistent");
+   auto fileMap = bdl.get(fileID);
+   ASSERT_NE(fileMap->getPtr(), nullptr);
+   EXPECT_EQ(BinaryData(fileMap->getPtr(), fileMap->size()), genesis);
+
+   //released blocks come back empty, file ids aren't reused
+   store.remove(genesisHash);
+   EXPECT_EQ(store.count(), 0U);
+   EXPECT_EQ(bdl.get(fileID)->getPtr(), nullptr);
+   EXPECT_EQ(fileMap->size(), genesis.getSize());
+
+   auto newID = store.add(genesis, getID);
+   EXPECT_GT(newID, fileID);
+   store.remove(genesisHash);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(MemoryBlockStoreTests, FilePosNotPersisted)
+{
+   auto genesis = READHEX(
+      "0100000000000000000000000000000000000000000000000000000000000000"
+      "000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa"
+      "4b1e5e4a29ab5f49ffff001d1dac2b7c01010000000100000000000000000000"
+      "00000000000000000000000000000000000000000000ffffffff4d04ffff001d"
+      "0104455468652054696d65732030332f4a616e2f32303039204368616e63656c"
+      "6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f75742066"
+      "6f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe554827"
+      "1967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4"
+      "f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000");
+
+   auto getID = [](const BinaryData&)->unsigned int { return 0; };
+
+   auto& store = MemoryBlockStore::shared();
+   auto fileID = store.add(genesis, getID);
+   ASSERT_TRUE(MemoryBlockStore::isMemoryFileID(fileID));
+   auto header = store.getBlocks()[fileID]->createBlockHeader();
+   store.remove(header->getThisHash());
+
+   //in-memory ids are written out as no position
+   StoredHeader sbh;
+   sbh.createFromBlockHeader(*header);
+   BinaryWriter bw;
+   sbh.serializeDBValue(bw, HEADERS, ARMORY_DB_FULL);
+
+   StoredHeader sbhRead;
+   sbhRead.unserializeDBValue(HEADERS, bw.getData());
+   EXPECT_EQ(sbhRead.getBlockFilePos().fileNum_, UINT32_MAX);
+   EXPECT_FALSE(sbhRead.getBlockHeaderCopy().hasFilePos());
+
+   //blk file positions go through
+   header->setBlockFilePos(3, 1234);
+   sbh.createFromBlockHeader(*header);
+   bw.reset();
+   sbh.serializeDBValue(bw, HEADERS, ARMORY_DB_FULL);
+   sbhRead.unserializeDBValue(HEADERS, bw.getData());
+   EXPECT_EQ(sbhRead.getBlockFilePos().fileNum_, 3U);
+   EXPECT_EQ(sbhRead.getBlockFilePos().offset_, 1234U);
+
+   //readers never see the file of one position with the offset of another
+   atomic<bool> run;
+   run.store(true);
+   thread writer([&header, &run, fileID](void)->void
+   {
+      while (run.load())
+      {
+         header->setBlockFilePos(fileID, 0);
+         header->setBlockFilePos(3, 1234);
+      }
+   });
+
+   unsigned mixed = 0;
+   for (unsigned i = 0; i < 1000000; i++)
+   {
+      auto pos = header->getBlockFilePos();
+      if (pos.fileNum_ == fileID && pos.offset_ != 0)
+         ++mixed;
+      else if (pos.fileNum_ == 3 && pos.offset_ != 1234)
+         ++mixed;
+   }
+
+   run.store(false);
+   writer.join();
+   EXPECT_EQ(mixed, 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(BlockStreamTests, ReadSlices)
+{
+   string blkdir("./blkstreamtest");
+   DBUtils::removeDirectory(blkdir);
+   mkdir(blkdir);
+
+   //blk file of 3 "blocks", the last one larger than a pool buffer
+   BinaryData block1 = READHEX("0011223344556677");
+   BinaryData block2 = READHEX("8899aabbccddeeff0123");
+   BinaryData block3(BLOCK_STREAM_BUFFER_SIZE + 16);
+   for (size_t i = 0; i < block3.getSize(); i++)
+      block3.getPtr()[i] = i % 251;
+
+   {
+      BinaryWriter bw;
+      bw.put_BinaryData(block1);
+      bw.put_BinaryData(block2);
+      bw.put_BinaryData(block3);
+
+      ofstream blkFile(
+         BtcUtils::getBlkFilename(blkdir, 0), ios::binary | ios::out);
+      blkFile.write(
+         (const char*)bw.getData().getPtr(), bw.getData().getSize());
+   }
+
+   BlockStreamReader reader(blkdir, 1);
+   auto pool = reader.pool();
+   const uint8_t* firstBuffer = nullptr;
+
+   {
+      //small blocks are packed in the same buffer
+      auto slice1 = reader.read(0, 0, block1.getSize());
+      auto slice2 = reader.read(0, block1.getSize(), block2.getSize());
+      EXPECT_EQ(BinaryData(slice1.data_, slice1.size_), block1);
+      EXPECT_EQ(BinaryData(slice2.data_, slice2.size_), block2);
+      EXPECT_EQ(slice1.owner_, slice2.owner_);
+      EXPECT_EQ(slice2.data_, slice1.data_ + block1.getSize());
+      firstBuffer = slice1.data_;
+
+      //oversized blocks get a buffer of their own
+      auto slice3 = reader.read(0,
+         block1.getSize() + block2.getSize(), block3.getSize());
+      EXPECT_EQ(BinaryData(slice3.data_, slice3.size_), block3);
+      EXPECT_NE(slice3.owner_, slice1.owner_);
+
+      //reads past the end of the file throw
+      EXPECT_THROW(reader.read(0,
+         block1.getSize() + block2.getSize() + 1, block3.getSize()),
+         runtime_error);
+      EXPECT_THROW(reader.read(1, 0, 8), runtime_error);
+      EXPECT_EQ(pool->freeCount(), 0U);
+
+      //the current buffer is held by the reader, not just its slices
+      slice1.owner_.reset();
+      slice2.owner_.reset();
+      EXPECT_EQ(pool->freeCount(), 0U);
+   }
+
+   //overflowing the current buffer moves on to a new one, the old one
+   //goes back to the pool once its slices are released
+   {
+      auto slice = reader.read(0, 0, BLOCK_STREAM_BUFFER_SIZE);
+      auto blkData = block1 + block2 + block3;
+      EXPECT_EQ(BinaryData(slice.data_, slice.size_),
+         blkData.getSliceCopy(0, BLOCK_STREAM_BUFFER_SIZE));
+      EXPECT_EQ(pool->freeCount(), 1U);
+   }
+
+   //and is recycled for the next one, the full buffer takes its spot
+   {
+      auto slice = reader.read(0, 0, block1.getSize());
+      EXPECT_EQ(slice.data_, firstBuffer);
+      EXPECT_EQ(BinaryData(slice.data_, slice.size_), block1);
+      EXPECT_EQ(pool->freeCount(), 1U);
+   }
+
+   DBUtils::removeDirectory(blkdir);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ExecutorTests, Parallel)
+{
+   Executor executor(4);
+   EXPECT_EQ(executor.threadCount(), 4U);
+
+   //every index runs once
+   vector<atomic<unsigned>> hits(64);
+   for (auto& hit : hits)
+      hit.store(0);
+
+   executor.parallel(ExecutorWorkload_Scan, TaskPriority_Background, 64,
+      [&hits](unsigned i)->void { hits[i].fetch_add(1); });
+
+   for (auto& hit : hits)
+      EXPECT_EQ(hit.load(), 1U);
+
+   //nested calls help out instead of waiting on a worker
+   atomic<unsigned> nested;
+   nested.store(0);
+   executor.parallel(ExecutorWorkload_Scan, TaskPriority_Background, 8,
+      [&executor, &nested](unsigned)->void
+      {
+         executor.parallel(ExecutorWorkload_Scan, TaskPriority_Background, 8,
+            [&nested](unsigned)->void { nested.fetch_add(1); });
+      });
+   EXPECT_EQ(nested.load(), 64U);
+
+   //exceptions are rethrown once all calls are done
+   atomic<unsigned> done;
+   done.store(0);
+   EXPECT_THROW(executor.parallel(
+      ExecutorWorkload_Scan, TaskPriority_Background, 16,
+      [&done](unsigned i)->void
+      {
+         this_thread::sleep_for(chrono::milliseconds(1));
+         done.fetch_add(1);
+         if (i == 5)
+            throw runtime_error("failed");
+      }), runtime_error);
+   EXPECT_EQ(done.load(), 16U);
+
+   auto fut = executor.submit(ExecutorWorkload_ZeroConf, TaskPriority_Normal,
+      [](void)->int { return 42; });
+   EXPECT_EQ(fut.get(), 42);
+
+   //tasks are accounted for after they return, give the last ones a moment
+   const uint64_t scanTasks = 63 + 7 + 8 * 7 + 15;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      if (executor.getStats(ExecutorWorkload_Scan).tasks_ == scanTasks &&
+         executor.getStats(ExecutorWorkload_ZeroConf).tasks_ == 1)
+         break;
+
+      this_thread::sleep_for(chrono::milliseconds(10));
+   }
+
+   auto stats = executor.getStats(ExecutorWorkload_Scan);
+   EXPECT_EQ(stats.tasks_, scanTasks);
+   EXPECT_GT(stats.busySeconds_, 0);
+   EXPECT_EQ(executor.getStats(ExecutorWorkload_ZeroConf).tasks_, 1U);
+   EXPECT_EQ(executor.getStats(ExecutorWorkload_Clients).tasks_, 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ExecutorTests, Priority)
+{
+   Executor executor(1);
+
+   //hold the only worker while the queue fills up
+   promise<void> gate;
+   auto gateFut = gate.get_future().share();
+   executor.post(ExecutorWorkload_Maintenance, TaskPriority_Interactive,
+      [gateFut](void)->void { gateFut.wait(); });
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   mutex mu;
+   vector<int> order;
+   auto record = [&mu, &order](int val)->function<void(void)>
+   {
+      return [&mu, &order, val](void)->void
+      {
+         unique_lock<mutex> lock(mu);
+         order.push_back(val);
+      };
+   };
+
+   executor.post(ExecutorWorkload_Scan, TaskPriority_Background, record(3));
+   executor.post(ExecutorWorkload_ZeroConf, TaskPriority_Normal, record(2));
+   executor.post(ExecutorWorkload_Clients, TaskPriority_Interactive, record(1));
+   executor.post(ExecutorWorkload_Clients, TaskPriority_Interactive, record(11));
+
+   gate.set_value();
+   for (unsigned i = 0; i < 100; i++)
+   {
+      {
+         unique_lock<mutex> lock(mu);
+         if (order.size() == 4)
+            break;
+      }
+
+      this_thread::sleep_for(chrono::milliseconds(10));
+   }
+
+   //interactive tasks in order, then normal, then background
+   unique_lock<mutex> lock(mu);
+   ASSERT_EQ(order.size(), 4U);
+   EXPECT_EQ(order[0], 1);
+   EXPECT_EQ(order[1], 11);
+   EXPECT_EQ(order[2], 2);
+   EXPECT_EQ(order[3], 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ExecutorTests, DrainQueue)
+{
+   Executor executor(4);
+   DrainQueue<unsigned> queue(
+      executor, ExecutorWorkload_Clients, TaskPriority_Interactive);
+
+   //entries pushed before start are held
+   queue.push_back(0);
+   this_thread::sleep_for(chrono::milliseconds(20));
+   EXPECT_EQ(queue.count(), 1U);
+
+   atomic<unsigned> sum, active, maxActive;
+   sum.store(0);
+   active.store(0);
+   maxActive.store(0);
+
+   auto process = [&](unsigned val)->void
+   {
+      auto current = active.fetch_add(1) + 1;
+      auto seen = maxActive.load();
+      while (current > seen && !maxActive.compare_exchange_weak(seen, current));
+
+      this_thread::sleep_for(chrono::microseconds(200));
+      sum.fetch_add(val);
+      active.fetch_sub(1);
+   };
+
+   queue.start(process, 2);
+   for (unsigned i = 1; i <= 200; i++)
+      queue.push_back(move(i));
+
+   queue.completed();
+   EXPECT_EQ(sum.load(), 200U * 201U / 2);
+   EXPECT_EQ(queue.count(), 0U);
+   EXPECT_LE(maxActive.load(), 2U);
+
+   //stopped queues drop new entries
+   queue.push_back(1000);
+   this_thread::sleep_for(chrono::milliseconds(20));
+   EXPECT_EQ(sum.load(), 200U * 201U / 2);
+
+   //terminate drops pending entries
+   DrainQueue<unsigned> slowQueue(
+      executor, ExecutorWorkload_ZeroConf, TaskPriority_Normal);
+   atomic<unsigned> processed;
+   processed.store(0);
+   slowQueue.start([&processed](unsigned)->void
+   {
+      this_thread::sleep_for(chrono::milliseconds(10));
+      processed.fetch_add(1);
+   }, 1);
+
+   for (unsigned i = 0; i < 100; i++)
+      slowQueue.push_back(move(i));
+   slowQueue.terminate();
+   EXPECT_LT(processed.load(), 100U);
+   EXPECT_EQ(slowQueue.count(), 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ExecutorTests, DrainGroup)
+{
+   Executor executor(4);
+   DrainQueue<unsigned> queue1(
+      executor, ExecutorWorkload_Clients, TaskPriority_Interactive);
+   DrainQueue<unsigned> queue2(
+      executor, ExecutorWorkload_Clients, TaskPriority_Interactive);
+
+   atomic<unsigned> sum, active, maxActive;
+   sum.store(0);
+   active.store(0);
+   maxActive.store(0);
+
+   auto process = [&](unsigned val)->void
+   {
+      auto current = active.fetch_add(1) + 1;
+      auto seen = maxActive.load();
+      while (current > seen && !maxActive.compare_exchange_weak(seen, current));
+
+      this_thread::sleep_for(chrono::microseconds(200));
+      sum.fetch_add(val);
+      active.fetch_sub(1);
+   };
+
+   //each queue may run 2 drainers, the group caps them at 2 combined
+   auto group = make_shared<DrainGroup>(2);
+   queue1.start(process, 2, group);
+   queue2.start(process, 2, group);
+   for (unsigned i = 1; i <= 200; i++)
+   {
+      unsigned val = i;
+      if (i % 2 == 0)
+         queue1.push_back(move(val));
+      else
+         queue2.push_back(move(val));
+   }
+
+   //entries held back by the cap are picked up once the other queue
+   //gives a slot back
+   queue1.completed();
+   queue2.completed();
+   EXPECT_EQ(sum.load(), 200U * 201U / 2);
+   EXPECT_EQ(queue1.count() + queue2.count(), 0U);
+   EXPECT_LE(maxActive.load(), 2U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ExecutorTests, BDV_ProcessGate)
+{
+   struct GatePacket
+   {
+      unsigned bdv_;
+      unsigned id_;
+      bool ownsGate_ = false;
+   };
+
+   Executor executor(4);
+   DrainQueue<shared_ptr<GatePacket>> queue(
+      executor, ExecutorWorkload_Clients, TaskPriority_Interactive);
+
+   BDV_ProcessGate<shared_ptr<GatePacket>> gates[2];
+   atomic<unsigned> active[2];
+   atomic<unsigned> calls, parked, overlaps;
+   active[0].store(0);
+   active[1].store(0);
+   calls.store(0);
+   parked.store(0);
+   overlaps.store(0);
+
+   mutex mu;
+   vector<unsigned> processed[2];
+
+   auto process = [&](shared_ptr<GatePacket> packet)->void
+   {
+      calls.fetch_add(1);
+      auto& gate = gates[packet->bdv_];
+      if (!packet->ownsGate_ && !gate.enter(packet))
+      {
+         parked.fetch_add(1);
+         return;
+      }
+
+      if (active[packet->bdv_].fetch_add(1) != 0)
+         overlaps.fetch_add(1);
+
+      this_thread::sleep_for(chrono::microseconds(300));
+      {
+         unique_lock<mutex> lock(mu);
+         processed[packet->bdv_].push_back(packet->id_);
+      }
+
+      active[packet->bdv_].fetch_sub(1);
+      auto next = gate.leave();
+      if (next != nullptr)
+         queue.push_back(move(next));
+   };
+
+   queue.start(process, 4);
+   for (unsigned i = 0; i < 200; i++)
+   {
+      auto packet = make_shared<GatePacket>();
+      packet->bdv_ = i % 2;
+      packet->id_ = i;
+      queue.push_back(move(packet));
+   }
+
+   //wait on the hand offs
+   for (unsigned i = 0; i < 500; i++)
+   {
+      {
+         unique_lock<mutex> lock(mu);
+         if (processed[0].size() + processed[1].size() == 200)
+            break;
+      }
+      this_thread::sleep_for(chrono::milliseconds(10));
+   }
+   queue.completed();
+
+   //every packet ran once, never two at a time for a bdv
+   EXPECT_EQ(overlaps.load(), 0U);
+   ASSERT_EQ(processed[0].size(), 100U);
+   ASSERT_EQ(processed[1].size(), 100U);
+
+   for (unsigned i = 0; i < 2; i++)
+   {
+      set<unsigned> ids(processed[i].begin(), processed[i].end());
+      EXPECT_EQ(ids.size(), 100U);
+      EXPECT_EQ(gates[i].parkedCount(), 0U);
+   }
+
+   //parked packets are only picked up again on hand off, no spinning
+   EXPECT_EQ(calls.load(), 200U + parked.load());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(LedgerEntryTests, HistoryCursor)
+{
+   HistoryCursor cursor;
+   cursor.cutoffHeight_ = 650000;
+   cursor.cutoffHash_ = CryptoPRNG::generateRandom(32);
+   cursor.height_ = 649870;
+   cursor.index_ = 12;
+
+   auto&& token = cursor.serialize();
+
+   HistoryCursor cursor2;
+   cursor2.unserialize(token.getRef());
+   EXPECT_EQ(cursor2.cutoffHeight_, 650000U);
+   EXPECT_EQ(cursor2.cutoffHash_, cursor.cutoffHash_);
+   EXPECT_EQ(cursor2.height_, 649870U);
+   EXPECT_EQ(cursor2.index_, 12U);
+
+   //truncated
+   EXPECT_ANY_THROW(cursor2.unserialize(
+      token.getSliceRef(0, token.getSize() - 1)));
+
+   //unknown version
+   auto badVersion = token;
+   badVersion.getPtr()[0] ^= 0xFF;
+   EXPECT_ANY_THROW(cursor2.unserialize(badVersion.getRef()));
+
+   //needs a block hash
+   HistoryCursor noHash;
+   EXPECT_ANY_THROW(noHash.serialize());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class KdfTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(KdfTests, Romix)
+{
+   uint32_t targetUnlock_ms = 2000;
+
+   //create a KDF object
+   KeyDerivationFunction_Romix kdfRom(targetUnlock_ms);
+   EXPECT_GE(kdfRom.memTarget(), 8092);
+
+   //derive key with it, check it takes over 2sec
+   auto keyToDerive = SecureBinaryData::fromString("0123456789AB");
+   {
+      auto start = chrono::system_clock::now();
+      auto derivedKey = kdfRom.deriveKey(keyToDerive);
+      auto end = chrono::system_clock::now();
+
+      EXPECT_NE(derivedKey, keyToDerive);
+      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
+      EXPECT_GE(diff.count(), targetUnlock_ms);
+      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+   }
+   kdfRom.prettyPrint();
+
+   //deser kdf object into a copy, check it load correctly
+   auto serializedKdf = kdfRom.serialize();
+   auto kdfCopy = KeyDerivationFunction::deserialize(serializedKdf);
+   auto kdfRom2 = dynamic_pointer_cast<KeyDerivationFunction_Romix>(kdfCopy);
+   ASSERT_NE(kdfRom2, nullptr);
+   EXPECT_TRUE(kdfRom.isSame(kdfRom2.get()));
+
+   //derive key with kdf copy, check it takes over 2sec
+   {
+      auto start = chrono::system_clock::now();
+      auto derivedKey = kdfRom2->deriveKey(keyToDerive);
+      auto end = chrono::system_clock::now();
+
+      EXPECT_NE(derivedKey, keyToDerive);
+      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
+      EXPECT_GE(diff.count(), targetUnlock_ms);
+      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+   }
+   kdfRom2->prettyPrint();
+
+   //create kdf with same params but its own salt
+   KeyDerivationFunction_Romix kdfRom3(
+      kdfRom.iterations(),
+      kdfRom.memTarget(),
+      CryptoPRNG::generateRandom(32)
+   );
+
+   //derive key with 3rd kdf, check it takes over 2sec
+   {
+      auto start = chrono::system_clock::now();
+      auto derivedKey = kdfRom3.deriveKey(keyToDerive);
+      auto end = chrono::system_clock::now();
+
+      EXPECT_NE(derivedKey, keyToDerive);
+      auto diff = chrono::duration_cast<chrono::milliseconds>(end - start);
+      EXPECT_GE(diff.count(), targetUnlock_ms);
+      EXPECT_LE(diff.count(), targetUnlock_ms + 1000);
+   }
+   kdfRom3.prettyPrint();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class JsonRpcTests : public ::testing::Test
+{
+protected:
+   SOCKET listenFd_ = SOCK_MAX;
+   string port_;
+   thread serverThr_;
+
+   atomic<unsigned> acceptCount_;
+   atomic<unsigned> requestCount_;
+
+protected:
+   virtual void SetUp(void)
+   {
+      acceptCount_.store(0);
+      requestCount_.store(0);
+
+      //stub http server on an ephemeral port
+      listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+      ASSERT_NE(listenFd_, SOCK_MAX);
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = 0;
+
+      ASSERT_EQ(::bind(listenFd_, (struct sockaddr*)&addr, sizeof(addr)), 0);
+      ASSERT_EQ(::listen(listenFd_, 4), 0);
+
+      socklen_t len = sizeof(addr);
+      ASSERT_EQ(getsockname(listenFd_, (struct sockaddr*)&addr, &len), 0);
+      port_ = to_string(ntohs(addr.sin_port));
+   }
+
+   virtual void TearDown(void)
+   {
+      if (serverThr_.joinable())
+         serverThr_.join();
+
+      SocketPrototype::closeSocket(listenFd_);
+   }
+
+   //Serves requestTotal http requests, accepting new connections as clients 
+   //drop theirs. Replies are written in small chunks so the client has to 
+   //stitch them back together. closeAfter > 0 flags the reply with 
+   //"Connection: close" and hangs up after that many requests.
+   void startServer(function<string(const string&)> replyLbd, 
+      unsigned requestTotal, unsigned closeAfter = 0)
+   {
+      auto serverLbd = [this, replyLbd, requestTotal, closeAfter](void)->void
+      {
+         while (requestCount_.load() < requestTotal)
+         {
+            auto clientFd = accept(listenFd_, nullptr, nullptr);
+            if (clientFd == SOCK_MAX || clientFd < 0)
+               return;
+            ++acceptCount_;
+
+            string data;
+            unsigned served = 0;
+            while (requestCount_.load() < requestTotal)
+            {
+               //read one full request
+               size_t bodyOffset = SIZE_MAX;
+               int contentLength = -1;
+               while (true)
+               {
+                  if (bodyOffset == SIZE_MAX)
+                  {
+                     bodyOffset = HttpSocket::getHttpBodyOffset(
+                        data.c_str(), data.size());
+
+                     if (bodyOffset != SIZE_MAX)
+                     {
+                        auto pos = data.find("Content-Length: ");
+                        if (pos == string::npos || pos > bodyOffset)
+                           return;
+                        contentLength = atoi(data.c_str() + pos + 16);
+                     }
+                  }
+
+                  if (bodyOffset != SIZE_MAX && 
+                     data.size() >= bodyOffset + contentLength)
+                     break;
+
+                  char buf[1024];
+                  auto readAmt = recv(clientFd, buf, sizeof(buf), 0);
+                  if (readAmt <= 0)
+                     break;
+                  data.append(buf, readAmt);
+               }
+
+               if (bodyOffset == SIZE_MAX || 
+                  data.size() < bodyOffset + contentLength)
+                  break;
+
+               auto body = data.substr(bodyOffset, contentLength);
+               data.erase(0, bodyOffset + contentLength);
+
+               ++served;
+               bool doClose = closeAfter != 0 && served >= closeAfter;
+
+               auto replyBody = replyLbd(body);
+               stringstream reply;
+               reply << "HTTP/1.1 200 OK\r\n";
+               reply << "Content-Type: application/json\r\n";
+               if (doClose)
+                  reply << "Connection: close\r\n";
+               reply << "Content-Length: " << replyBody.size() << "\r\n\r\n";
+               reply << replyBody;
+
+               auto replyStr = reply.str();
+               for (size_t i = 0; i < replyStr.size(); i += 16)
+               {
+                  auto chunk = min(replyStr.size() - i, size_t(16));
+                  send(clientFd, replyStr.c_str() + i, chunk, 0);
+                  this_thread::sleep_for(chrono::milliseconds(1));
+               }
+
+               ++requestCount_;
+               if (doClose)
+                  break;
+            }
+
+            SocketPrototype::closeSocket(clientFd);
+         }
+      };
+
+      serverThr_ = thread(serverLbd);
+   }
+
+   static string query(HttpSocket& sock, const string& request)
+   {
+      auto write_payload = make_unique<WritePayload_StringPassthrough>();
+      write_payload->data_ = request;
+
+      string result;
+      auto callback = [&result](string body)->void
+      {
+         result = move(body);
+      };
+
+      auto read_payload = make_shared<Socket_ReadPayload>();
+      read_payload->callbackReturn_ =
+         make_unique<CallbackReturn_HttpBody>(callback);
+      sock.pushPayload(move(write_payload), read_payload);
+
+      return result;
+   }
+
+   //replies to every request in a batch with its id as the result
+   static string batchReply(const string& body)
+   {
+      JSON_StreamParser parser;
+      parser.push(body);
+
+      stringstream ss;
+      if (parser.isBatch())
+         ss << "[";
+
+      auto&& requests = parser.popObjects();
+      for (unsigned i = 0; i < requests.size(); i++)
+      {
+         auto idPtr = dynamic_pointer_cast<JSON_number>(
+            requests[i]->getValForKey("id"));
+
+         if (i > 0)
+            ss << ", ";
+         ss << "{\"result\": " << int(idPtr->val_) << 
+            ", \"error\": null, \"id\": " << int(idPtr->val_) << "}";
+      }
+
+      if (parser.isBatch())
+         ss << "]";
+      ss << "\n";
+      return ss.str();
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, StreamParser)
+{
+   string reply = "[{\"result\": {\"feerate\": 0.0001, \"blocks\": 2}, "
+      "\"error\": null, \"id\": 5}, {\"result\": null, \"error\": "
+      "{\"code\": -32601, \"message\": \"Method \\\"x}\\\" not found\"}, "
+      "\"id\": 6}]\n";
+
+   //feed it one byte at a time, objects should pop as they complete
+   JSON_StreamParser parser;
+   vector<shared_ptr<JSON_object>> objects;
+   for (unsigned i = 0; i < reply.size(); i++)
+   {
+      parser.push(reply.c_str() + i, 1);
+
+      auto&& popped = parser.popObjects();
+      objects.insert(objects.end(), popped.begin(), popped.end());
+
+      if (i == reply.size() / 2)
+      {
+         EXPECT_FALSE(parser.isComplete());
+         EXPECT_EQ(objects.size(), 1U);
+      }
+   }
+
+   EXPECT_TRUE(parser.isBatch());
+   EXPECT_TRUE(parser.isComplete());
+   ASSERT_EQ(objects.size(), 2U);
+   EXPECT_TRUE(objects[0]->isResponseValid(5));
+   EXPECT_FALSE(objects[1]->isResponseValid(6));
+
+   auto errorObj = dynamic_pointer_cast<JSON_object>(
+      objects[1]->getValForKey("error"));
+   ASSERT_NE(errorObj, nullptr);
+   auto msgObj = dynamic_pointer_cast<JSON_string>(
+      errorObj->getValForKey("message"));
+   ASSERT_NE(msgObj, nullptr);
+   EXPECT_EQ(msgObj->val_, "Method \\\"x}\\\" not found");
+
+   //by id
+   auto&& byId = JSON_decodeBatch(reply);
+   ASSERT_EQ(byId.size(), 2U);
+   EXPECT_NE(byId.find(5), byId.end());
+   EXPECT_NE(byId.find(6), byId.end());
+
+   //single object replies go through the same path
+   auto&& single = JSON_decodeBatch(
+      "{\"result\": 12, \"error\": null, \"id\": 3}");
+   ASSERT_EQ(single.size(), 1U);
+   EXPECT_TRUE(single.begin()->second->isResponseValid(3));
+
+   //truncated reply
+   EXPECT_THROW(JSON_decodeBatch(reply.substr(0, reply.size() - 4)), 
+      JSON_Exception);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, KeepAliveBatch)
+{
+   startServer(batchReply, 3);
+
+   HttpSocket sock("127.0.0.1", port_);
+   ASSERT_TRUE(sock.connectToRemote());
+
+   //single request
+   {
+      JSON_object request;
+      request.add_pair("method", "getblockcount");
+
+      auto&& reply = JSON_decode(query(sock, JSON_encode(request)));
+      EXPECT_TRUE(reply.isResponseValid(request.id_));
+   }
+
+   //2 batches over the same connection
+   for (unsigned i = 0; i < 2; i++)
+   {
+      vector<shared_ptr<JSON_object>> requests;
+      for (unsigned y = 0; y < 14; y++)
+      {
+         auto request = make_shared<JSON_object>();
+         request->add_pair("method", "estimatesmartfee");
+         requests.push_back(request);
+      }
+
+      auto&& replies = JSON_decodeBatch(query(sock, JSON_encode(requests)));
+      ASSERT_EQ(replies.size(), requests.size());
+
+      for (auto& request : requests)
+      {
+         auto iter = replies.find(request->id_);
+         ASSERT_NE(iter, replies.end());
+         EXPECT_TRUE(iter->second->isResponseValid(request->id_));
+      }
+   }
+
+   EXPECT_TRUE(sock.isAlive());
+   sock.shutdown();
+
+   serverThr_.join();
+   EXPECT_EQ(requestCount_.load(), 3U);
+   EXPECT_EQ(acceptCount_.load(), 1U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, ConnectionClose)
+{
+   startServer(batchReply, 3, 2);
+
+   HttpSocket sock("127.0.0.1", port_);
+   ASSERT_TRUE(sock.connectToRemote());
+
+   for (unsigned i = 0; i < 2; i++)
+   {
+      JSON_object request;
+      request.add_pair("method", "getblockcount");
+
+      auto&& reply = JSON_decode(query(sock, JSON_encode(request)));
+      EXPECT_TRUE(reply.isResponseValid(request.id_));
+   }
+
+   //server flagged the connection for closing
+   EXPECT_FALSE(sock.isAlive());
+
+   //a new connection picks up where the old one left
+   HttpSocket sock2("127.0.0.1", port_);
+   ASSERT_TRUE(sock2.connectToRemote());
+
+   JSON_object request;
+   request.add_pair("method", "getblockcount");
+   auto&& reply = JSON_decode(query(sock2, JSON_encode(request)));
+   EXPECT_TRUE(reply.isResponseValid(request.id_));
+
+   sock2.shutdown();
+   serverThr_.join();
+   EXPECT_EQ(acceptCount_.load(), 2U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, SocketPool)
+{
+   startServer(batchReply, 5, 3);
+
+   unsigned openCount = 0;
+   auto openLbd = [this, &openCount](void)->unique_ptr<HttpSocket>
+   {
+      auto sock = make_unique<HttpSocket>("127.0.0.1", port_);
+      if (!sock->connectToRemote())
+         throw runtime_error("failed to connect");
+
+      ++openCount;
+      return sock;
+   };
+
+   CoreRPC::RpcSocketPool pool(openLbd);
+
+   //the server hangs up after the 3rd request on a connection
+   vector<bool> expectReused = { false, true, true, false, true };
+   for (unsigned i = 0; i < expectReused.size(); i++)
+   {
+      bool reused = false;
+      auto sock = pool.get(reused);
+      EXPECT_EQ(reused, expectReused[i]);
+
+      JSON_object request;
+      request.add_pair("method", "getblockcount");
+      auto&& reply = JSON_decode(query(*sock, JSON_encode(request)));
+      EXPECT_TRUE(reply.isResponseValid(request.id_));
+
+      //the server closes the connection once it's done
+      if (i == expectReused.size() - 1)
+         serverThr_.join();
+
+      pool.put(move(sock));
+   }
+
+   EXPECT_EQ(openCount, 2U);
+   EXPECT_EQ(acceptCount_.load(), 2U);
+
+   //dead sockets aren't pooled
+   EXPECT_EQ(pool.size(), 0U);
+   pool.put(make_unique<HttpSocket>("127.0.0.1", port_));
+   EXPECT_EQ(pool.size(), 0U);
+
+   //a pooled connection the node drops is replaced on checkout
+   auto closeProm = make_shared<promise<void>>();
+   auto closeFut = closeProm->get_future();
+   auto serverLbd = [this, &closeFut](void)->void
+   {
+      auto clientFd = accept(listenFd_, nullptr, nullptr);
+      if (clientFd == SOCK_MAX || clientFd < 0)
+         return;
+
+      ++acceptCount_;
+      closeFut.wait();
+      SocketPrototype::closeSocket(clientFd);
+   };
+   serverThr_ = thread(serverLbd);
+
+   {
+      bool reused = true;
+      auto sock = pool.get(reused);
+      EXPECT_FALSE(reused);
+      pool.put(move(sock));
+      EXPECT_EQ(pool.size(), 1U);
+   }
+
+   closeProm->set_value();
+   serverThr_.join();
+
+   {
+      bool reused = true;
+      auto sock = pool.get(reused);
+      EXPECT_FALSE(reused);
+      EXPECT_EQ(openCount, 4U);
+      EXPECT_EQ(pool.size(), 0U);
+      pool.put(move(sock));
+   }
+
+   EXPECT_EQ(pool.size(), 1U);
+   pool.clear();
+   EXPECT_EQ(pool.size(), 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, WriteTimeout)
+{
+   //the connection sits in the listen backlog, nobody ever reads from it
+   HttpSocket sock("127.0.0.1", port_);
+   ASSERT_TRUE(sock.connectToRemote());
+
+   string request(64 * 1024 * 1024, 'a');
+   auto start = chrono::steady_clock::now();
+   EXPECT_THROW(query(sock, request), HttpError);
+   auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start).count();
+
+   EXPECT_GE(elapsed, SOCKET_WRITE_TIMEOUT_MS - 100);
+   EXPECT_LT(elapsed, SOCKET_WRITE_TIMEOUT_MS + 3000);
+   EXPECT_FALSE(sock.isAlive());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, WriteToClosedPeer)
+{
+   //the peer hangs up without reading, the write fails without waiting on 
+   //the timeout
+   auto serverLbd = [this](void)->void
+   {
+      auto clientFd = accept(listenFd_, nullptr, nullptr);
+      if (clientFd == SOCK_MAX || clientFd < 0)
+         return;
+
+      ++acceptCount_;
+      SocketPrototype::closeSocket(clientFd);
+   };
+   serverThr_ = thread(serverLbd);
+
+   HttpSocket sock("127.0.0.1", port_);
+   ASSERT_TRUE(sock.connectToRemote());
+   serverThr_.join();
+
+   string request(64 * 1024 * 1024, 'a');
+   auto start = chrono::steady_clock::now();
+   EXPECT_THROW(query(sock, request), HttpError);
+   auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start).count();
+
+   EXPECT_LT(elapsed, SOCKET_WRITE_TIMEOUT_MS);
+   EXPECT_EQ(acceptCount_.load(), 1U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(JsonRpcTests, ReadTimeout)
+{
+   //the peer takes the request but never replies, nor hangs up
+   auto serverLbd = [this](void)->void
+   {
+      auto clientFd = accept(listenFd_, nullptr, nullptr);
+      if (clientFd == SOCK_MAX || clientFd < 0)
+         return;
+
+      ++acceptCount_;
+      char buf[1024];
+      while (recv(clientFd, buf, sizeof(buf), 0) > 0);
+      SocketPrototype::closeSocket(clientFd);
+   };
+   serverThr_ = thread(serverLbd);
+
+   {
+      HttpSocket sock("127.0.0.1", port_);
+      ASSERT_TRUE(sock.connectToRemote());
+
+      auto start = chrono::steady_clock::now();
+      EXPECT_THROW(query(sock, "{\"method\": \"getblockcount\"}"),
+         SocketTimeout);
+      auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+         chrono::steady_clock::now() - start).count();
+
+      EXPECT_GE(elapsed, SOCKET_READ_TIMEOUT_MS - 100);
+      EXPECT_LT(elapsed, SOCKET_READ_TIMEOUT_MS + 3000);
+
+      //the late reply would land on the next request, don't reuse it
+      EXPECT_FALSE(sock.isAlive());
+   }
+
+   serverThr_.join();
+   EXPECT_EQ(acceptCount_.load(), 1U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class LmdbTxTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {
+      homedir_ = string("./fakehomedir");
+      DBUtils::removeDirectory(homedir_);
+      mkdir(homedir_);
+
+      env_.open(homedir_ + "/lmdbtx", MDB_NOTLS);
+      env_.setMapSize(10 * 1024 * 1024ULL);
+      db_.open(&env_, "test");
+   }
+
+   virtual void TearDown(void)
+   {
+      db_.close();
+      env_.close();
+      DBUtils::removeDirectory(homedir_);
+   }
+
+   void putValue(const string& key, uint32_t val)
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadWrite);
+      db_.insert(CharacterArrayRef(key),
+         CharacterArrayRef(sizeof(val), (const uint8_t*)&val));
+   }
+
+   uint32_t getValue(const string& key)
+   {
+      auto&& data = db_.get_NoCopy(CharacterArrayRef(key));
+      if (data.len != sizeof(uint32_t))
+         throw runtime_error("missing value");
+
+      uint32_t val;
+      memcpy(&val, data.data, sizeof(val));
+      return val;
+   }
+
+   string homedir_;
+   LMDBEnv env_;
+   LMDB db_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LmdbTxTests, ReadTxnReuse)
+{
+   putValue("a", 1);
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_EQ(getValue("a"), 1U);
+   }
+
+   //the parked read txn is renewed on the next read, has to see the new 
+   //snapshot
+   putValue("a", 2);
+   putValue("b", 3);
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_EQ(getValue("a"), 2U);
+
+      //nested txns share the thread's txn
+      {
+         LMDBEnv::Transaction tx2(&env_, LMDB::ReadOnly);
+         EXPECT_EQ(getValue("b"), 3U);
+      }
+
+      auto iter = db_.begin();
+      unsigned count = 0;
+      while (iter.isValid())
+      {
+         ++count;
+         ++iter;
+      }
+      EXPECT_EQ(count, 2U);
+   }
+
+   //iterators can't outlive their txn
+   EXPECT_THROW(db_.begin(), runtime_error);
+
+   //no ReadWrite within ReadOnly
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_THROW(LMDBEnv::Transaction(&env_, LMDB::ReadWrite), LMDBException);
+      EXPECT_EQ(getValue("a"), 2U);
+   }
+
+   putValue("a", 4);
+   LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+   EXPECT_EQ(getValue("a"), 4U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LmdbTxTests, ConcurrentReaders)
+{
+   //short read txns from many threads against a live writer, reports the 
+   //read txn throughput
+   const unsigned readerCount = 
+      max(thread::hardware_concurrency(), 4U);
+   const unsigned txPerReader = 20000;
+
+   putValue("counter", 0);
+
+   atomic<bool> done{false};
+   atomic<unsigned> errors{0};
+   auto writer = [&](void)->void
+   {
+      uint32_t counter = 0;
+      while (!done.load(memory_order_relaxed))
+         putValue("counter", ++counter);
+   };
+
+   auto reader = [&](void)->void
+   {
+      uint32_t last = 0;
+      for (unsigned i = 0; i < txPerReader; i++)
+      {
+         LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+         auto val = getValue("counter");
+
+         //snapshots only move forward
+         if (val < last)
+            errors.fetch_add(1, memory_order_relaxed);
+         last = val;
+      }
+   };
+
+   thread writerThr(writer);
+
+   auto start = chrono::steady_clock::now();
+   vector<thread> readers;
+   for (unsigned i = 0; i < readerCount; i++)
+      readers.push_back(thread(reader));
+
+   for (auto& thr : readers)
+      thr.join();
+   auto elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+   done.store(true, memory_order_relaxed);
+   writerThr.join();
+
+   EXPECT_EQ(errors.load(), 0U);
+   cout << readerCount << " readers, " << 
+      double(readerCount * txPerReader) / elapsed << " read txns/s" << endl;
+
+   //reader threads are gone, their states went with them
+   LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+   EXPECT_GT(getValue("counter"), 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LmdbTxTests, Rollback)
+{
+   putValue("a", 1);
+
+   //top level
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadWrite);
+      putValue("a", 2);
+      putValue("b", 3);
+      EXPECT_EQ(getValue("b"), 3U);
+
+      tx.rollback();
+
+      //rollback is final, the destructor has nothing left to commit
+      tx.commit();
+   }
+
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_EQ(getValue("a"), 1U);
+      EXPECT_THROW(getValue("b"), runtime_error);
+   }
+
+   //a nested rollback aborts the outermost tx
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadWrite);
+      putValue("b", 3);
+      {
+         LMDBEnv::Transaction tx2(&env_, LMDB::ReadWrite);
+         putValue("c", 4);
+         tx2.rollback();
+      }
+
+      putValue("d", 5);
+   }
+
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_EQ(getValue("a"), 1U);
+      EXPECT_THROW(getValue("b"), runtime_error);
+      EXPECT_THROW(getValue("c"), runtime_error);
+      EXPECT_THROW(getValue("d"), runtime_error);
+   }
+
+   //the abort doesn't carry over to the next tx
+   putValue("b", 3);
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      EXPECT_EQ(getValue("b"), 3U);
+      
+      //nothing to undo on a read
+      tx.rollback();
+   }
+
+   LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+   EXPECT_EQ(getValue("b"), 3U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LmdbTxTests, BulkLoader_RoundTrip)
+{
+   //reference db, fed through regular puts
+   LMDBEnv refEnv;
+   refEnv.open(homedir_ + "/lmdbtx_ref", MDB_NOTLS);
+   refEnv.setMapSize(10 * 1024 * 1024ULL);
+   LMDB refDb(&refEnv, "test");
+
+   auto putRef = [&refEnv, &refDb](const string& key, const string& val)
+   {
+      LMDBEnv::Transaction tx(&refEnv, LMDB::ReadWrite);
+      refDb.insert(CharacterArrayRef(key), CharacterArrayRef(val));
+   };
+
+   //same starting content in both dbs
+   vector<pair<string, string>> seed;
+   for (unsigned i = 10; i < 50; i += 2)
+      seed.push_back(make_pair(to_string(i), "seed" + to_string(i)));
+
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadWrite);
+      for (auto& kv : seed)
+      {
+         db_.insert(CharacterArrayRef(kv.first), CharacterArrayRef(kv.second));
+         putRef(kv.first, kv.second);
+      }
+   }
+
+   //unsorted batch: keys between existing ones, overwrites of existing 
+   //keys, keys past the end and repeated keys, the last one wins. The 
+   //loader doesn't copy, the data has to stay put until commit
+   vector<pair<string, string>> batch;
+   for (unsigned i = 90; i > 50; i -= 3)
+      batch.push_back(make_pair(to_string(i), "new" + to_string(i)));
+   for (unsigned i = 11; i < 50; i += 4)
+      batch.push_back(make_pair(to_string(i), "new" + to_string(i)));
+   batch.push_back(make_pair("20", "over20"));
+   batch.push_back(make_pair("87", "first87"));
+   batch.push_back(make_pair("87", "last87"));
+   batch.push_back(make_pair("15", "last15"));
+
+   LMDB::BulkLoader::Stats stats;
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadWrite);
+      auto loader = db_.bulkLoader();
+      for (auto& kv : batch)
+         loader.add(CharacterArrayRef(kv.first), CharacterArrayRef(kv.second));
+      EXPECT_EQ(loader.size(), batch.size());
+
+      stats = loader.commit();
+   }
+
+   for (auto& kv : batch)
+      putRef(kv.first, kv.second);
+
+   //51 to 90 sort past "48", everything else goes through regular puts,
+   //duplicates are only written once
+   EXPECT_EQ(stats.appended_, 14U);
+   EXPECT_EQ(stats.inserted_, 11U);
+
+   //both dbs carry the same content
+   {
+      LMDBEnv::Transaction tx(&env_, LMDB::ReadOnly);
+      LMDBEnv::Transaction refTx(&refEnv, LMDB::ReadOnly);
+
+      auto iter = db_.begin();
+      auto refIter = refDb.begin();
+      unsigned count = 0;
+      while (refIter.isValid())
+      {
+         ASSERT_TRUE(iter.isValid());
+         
+         string key((char*)iter.key().mv_data, iter.key().mv_size);
+         string refKey((char*)refIter.key().mv_data, refIter.key().mv_size);
+         EXPECT_EQ(key, refKey);
+
+         string val((char*)iter.value().mv_data, iter.value().mv_size);
+         string refVal(
+            (char*)refIter.value().mv_data, refIter.value().mv_size);
+         EXPECT_EQ(val, refVal);
+
+         ++iter;
+         ++refIter;
+         ++count;
+      }
+
+      EXPECT_FALSE(iter.isValid());
+      EXPECT_EQ(count, 20U + 14U + 10U);
+
+      auto&& data87 = db_.get_NoCopy(CharacterArrayRef(string("87")));
+      EXPECT_EQ(string(data87.data, data87.len), "last87");
+      auto&& data20 = db_.get_NoCopy(CharacterArrayRef(string("20")));
+      EXPECT_EQ(string(data20.data, data20.len), "over20");
+   }
+
+   //commit needs a write tx
+   {
+      string key("99"), val("99");
+      auto loader = db_.bulkLoader();
+      loader.add(CharacterArrayRef(key), CharacterArrayRef(val));
+      EXPECT_THROW(loader.commit(), LMDBException);
+   }
+
+   refDb.close();
+   refEnv.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(SshRecordQueueTests, Ready)
+{
+   SshRecordQueue queue(2);
+   EXPECT_FALSE(queue.ready());
+
+   SshRecord record;
+   record.key_ = READHEX("01");
+   queue.push(move(record));
+   EXPECT_TRUE(queue.ready());
+   ASSERT_NE(queue.front(), nullptr);
+   EXPECT_EQ(queue.pop().key_, READHEX("01"));
+
+   //drained, front would block
+   EXPECT_FALSE(queue.ready());
+
+   //a full queue blocks the parser until the writer pops
+   record.key_ = READHEX("02");
+   queue.push(move(record));
+   record.key_ = READHEX("03");
+   queue.push(move(record));
+
+   atomic<bool> pushed{false};
+   thread parser([&queue, &pushed](void)->void
+   {
+      SshRecord rec;
+      rec.key_ = READHEX("04");
+      queue.push(move(rec));
+      pushed.store(true);
+   });
+
+   this_thread::sleep_for(chrono::milliseconds(50));
+   EXPECT_FALSE(pushed.load());
+   EXPECT_EQ(queue.pop().key_, READHEX("02"));
+   parser.join();
+   EXPECT_TRUE(pushed.load());
+
+   //done with records left, front drains them first
+   queue.markDone();
+   EXPECT_TRUE(queue.ready());
+   EXPECT_EQ(queue.pop().key_, READHEX("03"));
+   EXPECT_EQ(queue.pop().key_, READHEX("04"));
+   EXPECT_TRUE(queue.ready());
+   EXPECT_EQ(queue.front(), nullptr);
+
+   //pushes past done are dropped
+   record.key_ = READHEX("05");
+   queue.push(move(record));
+   EXPECT_EQ(queue.front(), nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class WebSocketCodecTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {}
+
+   ::Codec_BDVCommand::BDVCommand makeCommand(size_t len)
+   {
+      ::Codec_BDVCommand::BDVCommand cmd;
+      cmd.set_method(::Codec_BDVCommand::registerWallet);
+      cmd.set_bdvid("abcdef");
+      
+      //spread the payload over a few entries
+      while (len > 0)
+      {
+         auto chunk = min(len, size_t(3000));
+         cmd.add_bindata(CryptoPRNG::generateRandom(chunk).toBinStr());
+         len -= chunk;
+      }
+
+      return cmd;
+   }
+
+   void reassemble(const vector<BinaryData>& packets,
+      ::google::protobuf::Message& msg)
+   {
+      WebSocketMessagePartial partial;
+      for (auto& packet : packets)
+      {
+         ASSERT_TRUE(partial.parsePacket(packet.getSliceRef(
+            LWS_PRE, packet.getSize() - LWS_PRE)));
+      }
+
+      ASSERT_TRUE(partial.isReady());
+      EXPECT_EQ(partial.getId(), 12U);
+      ASSERT_TRUE(partial.getMessage(&msg));
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(WebSocketCodecTests, ZeroCopyMatchesFlat)
+{
+   //empty, single packet, 2 fragments, more than 253 fragments
+   vector<size_t> sizes = { 0, 100, 1400, 3000, 500000 };
+   for (auto& size : sizes)
+   {
+      auto cmd = makeCommand(size);
+      auto flat = cmd.SerializeAsString();
+      
+      auto&& flatPackets = WebSocketMessageCodec::serialize(flat, nullptr,
+         ArmoryAEAD::BIP151_PayloadType::FragmentHeader, 12);
+      auto&& zcPackets = WebSocketMessageCodec::serialize(cmd, nullptr, 12);
+
+      ASSERT_EQ(flatPackets.size(), zcPackets.size());
+      for (unsigned i = 0; i < flatPackets.size(); i++)
+      {
+         EXPECT_EQ(
+            flatPackets[i].getSliceRef(LWS_PRE, 
+               flatPackets[i].getSize() - LWS_PRE),
+            zcPackets[i].getSliceRef(LWS_PRE, 
+               zcPackets[i].getSize() - LWS_PRE));
+      }
+
+      ::Codec_BDVCommand::BDVCommand result;
+      reassemble(zcPackets, result);
+      EXPECT_EQ(result.SerializeAsString(), flat);
+
+      //recycle, next round draws from the pool
+      for (auto& packet : zcPackets)
+         FragmentBufferPool::instance().release(move(packet));
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(WebSocketCodecTests, AbandonedFragmentsGoBackToPool)
+{
+   auto& pool = FragmentBufferPool::instance();
+   size_t poolSize;
+
+   {
+      //serialization stops after 2 fragments, never finalized
+      FragmentWriter writer(3000, nullptr, 12);
+      void* data;
+      int size;
+      ASSERT_TRUE(writer.Next(&data, &size));
+      ASSERT_TRUE(writer.Next(&data, &size));
+      poolSize = pool.size();
+   }
+
+   EXPECT_EQ(pool.size(),
+      min(poolSize + 2, size_t(WEBSOCKET_FRAGMENT_POOL_SIZE)));
+
+   //finalized fragments belong to the caller
+   {
+      FragmentWriter writer(100, nullptr, 12);
+      void* data;
+      int size;
+      ASSERT_TRUE(writer.Next(&data, &size));
+      ASSERT_EQ(size, 100);
+      memset(data, 0, size);
+
+      auto&& packets = writer.finalize();
+      ASSERT_EQ(packets.size(), 1U);
+      poolSize = pool.size();
+   }
+
+   EXPECT_EQ(pool.size(), poolSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(WebSocketCodecTests, Batch)
+{
+   //lone message goes out as a regular single packet
+   {
+      auto cmd = makeCommand(50);
+      WebSocketMessageBatch batch;
+      ASSERT_TRUE(batch.add(12, cmd));
+
+      auto&& packets = batch.serialize(nullptr);
+      ASSERT_EQ(packets.size(), 1U);
+      EXPECT_EQ(WebSocketMessagePartial::getPacketType(
+         packets[0].getSliceRef(LWS_PRE, packets[0].getSize() - LWS_PRE)),
+         ArmoryAEAD::BIP151_PayloadType::SinglePacket);
+
+      ::Codec_BDVCommand::BDVCommand result;
+      reassemble(packets, result);
+      EXPECT_EQ(result.SerializeAsString(), cmd.SerializeAsString());
+      EXPECT_TRUE(batch.empty());
+   }
+
+   //fill a batch until it refuses a message
+   WebSocketMessageBatch batch;
+   vector<string> payloads;
+   while (true)
+   {
+      auto cmd = makeCommand(payloads.size() % 2 == 0 ? 20 : 200);
+      auto id = (uint32_t)payloads.size();
+      bool added;
+      if (id % 3 == 0)
+      {
+         //shared payloads are added serialized
+         auto flat = cmd.SerializeAsString();
+         added = batch.add(id, BinaryDataRef(
+            (const uint8_t*)flat.c_str(), flat.size()));
+      }
+      else
+      {
+         added = batch.add(id, cmd);
+      }
+
+      if (!added)
+         break;
+      payloads.push_back(cmd.SerializeAsString());
+   }
+
+   ASSERT_GT(payloads.size(), 2U);
+   EXPECT_EQ(batch.count(), payloads.size());
+
+   auto&& packets = batch.serialize(nullptr);
+   ASSERT_EQ(packets.size(), 1U);
+   EXPECT_LE(packets[0].getSize(), size_t(WEBSOCKET_MESSAGE_PACKET_SIZE));
+
+   auto packetRef = packets[0].getSliceRef(
+      LWS_PRE, packets[0].getSize() - LWS_PRE);
+   EXPECT_EQ(WebSocketMessagePartial::getPacketType(packetRef),
+      ArmoryAEAD::BIP151_PayloadType::Batch);
+
+   //regular parsing rejects batches
+   WebSocketMessagePartial partial;
+   EXPECT_FALSE(partial.parsePacket(packetRef));
+
+   vector<WebSocketMessagePartial> messages;
+   ASSERT_TRUE(WebSocketMessagePartial::parseBatch(packetRef, messages));
+   ASSERT_EQ(messages.size(), payloads.size());
+   for (unsigned i = 0; i < messages.size(); i++)
+   {
+      EXPECT_EQ(messages[i].getId(), i);
+      ASSERT_TRUE(messages[i].isReady());
+
+      ::Codec_BDVCommand::BDVCommand result;
+      ASSERT_TRUE(messages[i].getMessage(&result));
+      EXPECT_EQ(result.SerializeAsString(), payloads[i]);
+   }
+
+   //truncated batch
+   messages.clear();
+   BinaryData truncated(packetRef.getSliceRef(0, packetRef.getSize() - 1));
+   uint32_t truncatedLen = truncated.getSize() - 4;
+   memcpy(truncated.getPtr(), &truncatedLen, 4);
+   EXPECT_FALSE(WebSocketMessagePartial::parseBatch(
+      truncated.getRef(), messages));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class ClientWriteQueueTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {}
+
+   unique_ptr<PendingMessage> makeCallback(
+      const vector<::Codec_BDVCommand::NotificationType>& types)
+   {
+      auto callback = make_shared<::Codec_BDVCommand::BDVCallback>();
+      for (auto& type : types)
+      {
+         auto notif = callback->add_notification();
+         notif->set_type(type);
+         notif->set_requestid(string(100, 'a'));
+      }
+
+      return make_unique<PendingMessage>(1, WEBSOCKET_CALLBACK_ID, callback);
+   }
+
+   unique_ptr<PendingMessage> makeReply(uint32_t msgid, size_t size)
+   {
+      auto reply = make_shared<::Codec_CommonTypes::BinaryData>();
+      reply->set_data(string(size, 'b'));
+      return make_unique<PendingMessage>(1, msgid, reply);
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientWriteQueueTests, Scheduling)
+{
+   ClientWriteQueue queue(1024 * 1024);
+
+   //first push schedules, following ones don't
+   EXPECT_TRUE(queue.push(makeReply(1, 10)));
+   for (unsigned i = 2; i <= 10; i++)
+      EXPECT_FALSE(queue.push(makeReply(i, 10)));
+
+   //batches come out in order, queue stays scheduled until drained
+   uint32_t expected = 1;
+   for (unsigned i = 0; i < 3; i++)
+   {
+      auto&& batch = queue.pop(4);
+      EXPECT_EQ(batch.size(), i < 2 ? 4U : 2U);
+      for (auto& msg : batch)
+         EXPECT_EQ(msg->msgid_, expected++);
+
+      EXPECT_EQ(queue.reschedule(), i < 2);
+   }
+
+   EXPECT_EQ(queue.getStats().messages_, 0U);
+   EXPECT_EQ(queue.getStats().bytes_, 0U);
+
+   //unscheduled, next push schedules again
+   EXPECT_TRUE(queue.push(makeReply(1, 10)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientWriteQueueTests, Backpressure)
+{
+   ClientWriteQueue queue(1000);
+
+   //socket side is backed up
+   queue.addSocketBytes(2000);
+
+   //replies are always queued
+   EXPECT_TRUE(queue.push(makeReply(1, 500)));
+   EXPECT_EQ(queue.getStats().messages_, 1U);
+
+   //progress only callback with nothing to coalesce with is dropped
+   EXPECT_FALSE(queue.push(makeCallback({ ::Codec_BDVCommand::progress })));
+   EXPECT_EQ(queue.getStats().messages_, 1U);
+   EXPECT_EQ(queue.getStats().dropped_, 1U);
+
+   //mixed callback is stripped of its progress notification
+   queue.push(makeCallback(
+      { ::Codec_BDVCommand::progress, ::Codec_BDVCommand::zc }));
+   EXPECT_EQ(queue.getStats().messages_, 2U);
+   EXPECT_EQ(queue.getStats().dropped_, 2U);
+
+   //following callbacks are coalesced, only the last progress is kept
+   queue.push(makeCallback({ ::Codec_BDVCommand::progress }));
+   queue.push(makeCallback(
+      { ::Codec_BDVCommand::newblock, ::Codec_BDVCommand::progress }));
+   EXPECT_EQ(queue.getStats().messages_, 2U);
+   EXPECT_EQ(queue.getStats().coalesced_, 2U);
+
+   auto&& batch = queue.pop(10);
+   ASSERT_EQ(batch.size(), 2U);
+   EXPECT_EQ(batch[0]->msgid_, 1U);
+
+   auto callback = dynamic_pointer_cast<::Codec_BDVCommand::BDVCallback>(
+      batch[1]->message_);
+   ASSERT_NE(callback, nullptr);
+   ASSERT_EQ(callback->notification_size(), 3);
+   EXPECT_EQ(callback->notification(0).type(), ::Codec_BDVCommand::zc);
+   EXPECT_EQ(callback->notification(1).type(), ::Codec_BDVCommand::newblock);
+   EXPECT_EQ(callback->notification(2).type(), ::Codec_BDVCommand::progress);
+
+   //socket drained, callbacks go through untouched
+   queue.removeSocketBytes(2000);
+   queue.push(makeCallback({ ::Codec_BDVCommand::progress }));
+   queue.push(makeCallback({ ::Codec_BDVCommand::progress }));
+   EXPECT_EQ(queue.getStats().messages_, 2U);
+   EXPECT_EQ(queue.getStats().coalesced_, 2U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientWriteQueueTests, HardLimit)
+{
+   ClientWriteQueue queue(1000);
+   queue.addSocketBytes(2000);
+
+   //callbacks keep being merged into the same queued callback
+   EXPECT_TRUE(queue.push(makeCallback({ ::Codec_BDVCommand::zc })));
+   for (unsigned i = 0; i < 100; i++)
+   {
+      EXPECT_FALSE(queue.push(makeCallback(
+         { ::Codec_BDVCommand::progress, ::Codec_BDVCommand::nodestatus })));
+   }
+
+   EXPECT_EQ(queue.getStats().messages_, 1U);
+   EXPECT_EQ(queue.getStats().coalesced_, 100U);
+   EXPECT_FALSE(queue.isClosed());
+
+   //replies aren't dropped but can't grow the queue past the hard limit
+   unsigned count = 0;
+   while (!queue.isClosed() && count < 100)
+   {
+      queue.push(makeReply(++count, 500));
+   }
+
+   ASSERT_TRUE(queue.isClosed());
+   EXPECT_LT(count, 10U);
+   EXPECT_EQ(queue.getStats().messages_, 0U);
+   EXPECT_EQ(queue.getStats().bytes_, 2000U);
+
+   //closed queue takes nothing
+   EXPECT_FALSE(queue.push(makeReply(1, 10)));
+   EXPECT_EQ(queue.getStats().messages_, 0U);
+   EXPECT_TRUE(queue.pop(10).empty());
+   EXPECT_FALSE(queue.close());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientWriteQueueTests, SharedCallback)
+{
+   //broadcast notification is built and serialized once
+   vector<string> walletIds = { "wlt1", "wlt2" };
+   shared_ptr<BDV_Notification> progress = 
+      make_shared<BDV_Notification_Progress>(
+         BDMPhase_BlockData, 0.5, 10, 100, walletIds);
+
+   auto shared1 = BDV_Server_Object::getSharedCallback(progress);
+   auto shared2 = BDV_Server_Object::getSharedCallback(progress);
+   ASSERT_NE(shared1, nullptr);
+   EXPECT_EQ(shared1, shared2);
+
+   ::Codec_BDVCommand::BDVCallback parsed;
+   ASSERT_TRUE(parsed.ParseFromArray(
+      shared1->payload_->getPtr(), shared1->payload_->getSize()));
+   ASSERT_EQ(parsed.notification_size(), 1);
+   EXPECT_EQ(parsed.notification(0).type(), ::Codec_BDVCommand::progress);
+   EXPECT_EQ(parsed.notification(0).progress().id_size(), 2);
+   EXPECT_EQ(parsed.SerializeAsString(), shared1->message_->SerializeAsString());
+
+   //per bdv notifications aren't shared
+   shared_ptr<BDV_Notification> refresh = 
+      make_shared<BDV_Notification_Refresh>(
+         "bdv", BDV_refreshSkipRescan, READHEX("0102"));
+   EXPECT_EQ(BDV_Server_Object::getSharedCallback(refresh), nullptr);
+
+   //queued shared payloads are accounted by their serialized size
+   ClientWriteQueue queue(1024 * 1024);
+   queue.push(make_unique<PendingMessage>(
+      1, WEBSOCKET_CALLBACK_ID, shared1->message_, shared1->payload_));
+   EXPECT_EQ(queue.getStats().bytes_, shared1->payload_->getSize());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class ClientCacheTests : public ::testing::Test
+{
+protected:
+   virtual void SetUp(void)
+   {}
+
+   //bare 1-in 1-out tx, the locktime makes it unique
+   shared_ptr<Tx> makeTx(uint32_t locktime, unsigned height)
+   {
+      BinaryWriter bw;
+      bw.put_uint32_t(1);
+      bw.put_var_int(1);
+      bw.put_BinaryData(BtcUtils::EmptyHash());
+      bw.put_uint32_t(0);
+      bw.put_var_int(0);
+      bw.put_uint32_t(UINT32_MAX);
+      bw.put_var_int(1);
+      bw.put_uint64_t(1000);
+      bw.put_var_int(0);
+      bw.put_uint32_t(locktime);
+
+      auto tx = make_shared<Tx>(bw.getData());
+      tx->setTxHeight(height);
+      return tx;
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientCacheTests, LRU)
+{
+   AsyncClient::LRUCache<unsigned, unsigned> lru(3);
+   lru.put(1, 10);
+   lru.put(2, 20);
+   lru.put(3, 30);
+
+   //bump 1, 2 is now the oldest entry
+   EXPECT_EQ(lru.get(1), 10U);
+   lru.put(4, 40);
+   EXPECT_EQ(lru.size(), 3U);
+   EXPECT_FALSE(lru.contains(2));
+   EXPECT_THROW(lru.get(2), AsyncClient::NoMatch);
+
+   //overwrite bumps too
+   lru.put(3, 31);
+   lru.put(5, 50);
+   EXPECT_FALSE(lru.contains(1));
+   EXPECT_EQ(lru.get(3), 31U);
+   EXPECT_EQ(lru.get(4), 40U);
+   EXPECT_EQ(lru.get(5), 50U);
+
+   lru.eraseIf([](const unsigned& key, const unsigned&)->bool
+   {
+      return key > 3;
+   });
+   EXPECT_EQ(lru.size(), 1U);
+   EXPECT_TRUE(lru.contains(3));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientCacheTests, Bounded)
+{
+   AsyncClient::ClientCache cache(4, 4);
+   for (unsigned i = 0; i < 10; i++)
+   {
+      cache.insertTx(makeTx(i, 100 + i));
+      cache.insertRawHeader(100 + i, BinaryData(HEADER_SIZE), cache.epoch());
+   }
+
+   EXPECT_EQ(cache.txCount(), 4U);
+   EXPECT_EQ(cache.headerCount(), 4U);
+
+   EXPECT_THROW(cache.getTx(makeTx(0, 0)->getThisHash()), AsyncClient::NoMatch);
+   EXPECT_THROW(cache.getRawHeader(105), AsyncClient::NoMatch);
+   EXPECT_EQ(cache.getTx(makeTx(9, 0)->getThisHash())->getTxHeight(), 109U);
+   EXPECT_EQ(cache.getRawHeader(106).getSize(), HEADER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientCacheTests, Reorg)
+{
+   AsyncClient::ClientCache cache;
+
+   auto txLow = makeTx(1, 100);
+   auto txHigh = makeTx(2, 105);
+   auto txZc = makeTx(3, UINT32_MAX);
+   cache.insertTx(txLow);
+   cache.insertTx(txHigh);
+   cache.insertTx(txZc);
+
+   auto epoch = cache.epoch();
+   for (unsigned i = 100; i <= 105; i++)
+      cache.insertRawHeader(i, BinaryData(HEADER_SIZE), epoch);
+   cache.insertHeightForTxHash(txLow->getThisHash(), 100, epoch);
+   cache.insertHeightForTxHash(txHigh->getThisHash(), 105, epoch);
+
+   //chain branches off at 102
+   cache.reorg(102);
+   EXPECT_NE(cache.epoch(), epoch);
+
+   EXPECT_NE(cache.getTx(txLow->getThisHash()), nullptr);
+   EXPECT_NE(cache.getTx(txZc->getThisHash()), nullptr);
+   EXPECT_THROW(cache.getTx(txHigh->getThisHash()), AsyncClient::NoMatch);
+
+   EXPECT_EQ(cache.headerCount(), 3U);
+   EXPECT_EQ(cache.getRawHeader(102).getSize(), HEADER_SIZE);
+   EXPECT_THROW(cache.getRawHeader(103), AsyncClient::NoMatch);
+
+   EXPECT_EQ(cache.getHeightForTxHash(txLow->getThisHash()), 100U);
+   EXPECT_THROW(cache.getHeightForTxHash(txHigh->getThisHash()), 
+      AsyncClient::NoMatch);
+
+   //replies to requests from before the reorg are not cached
+   cache.insertRawHeader(104, BinaryData(HEADER_SIZE), epoch);
+   EXPECT_THROW(cache.getRawHeader(104), AsyncClient::NoMatch);
+   cache.insertRawHeader(104, BinaryData(HEADER_SIZE), cache.epoch());
+   EXPECT_EQ(cache.getRawHeader(104).getSize(), HEADER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ClientCacheTests, Coalescing)
+{
+   auto cache = make_shared<AsyncClient::ClientCache>();
+   auto hash = makeTx(1, 100)->getThisHash();
+
+   atomic<unsigned> counter = { 0 };
+   auto prom = make_shared<promise<void>>();
+   auto fut = prom->get_future();
+   AsyncClient::TxCallback callback = 
+      [&counter, prom](ReturnMessage<AsyncClient::TxResult> rm)->void
+   {
+      try
+      {
+         rm.get();
+      }
+      catch (ClientMessageError& e)
+      {
+         EXPECT_EQ(e.errorCode(), 
+            (int)ArmoryErrorCodes::ClientCache_Dropped);
+      }
+
+      if (counter.fetch_add(1) == 2)
+         prom->set_value();
+   };
+
+   //only the first caller sends the request
+   EXPECT_TRUE(cache->addPendingTx(hash, callback));
+   EXPECT_FALSE(cache->addPendingTx(hash, callback));
+   EXPECT_FALSE(cache->addPendingTx(hash, callback));
+
+   //request is dropped without a reply, all callers get the error
+   {
+      AsyncClient::CallbackReturn_Tx cbReturn(cache, hash);
+   }
+
+   ASSERT_EQ(fut.wait_for(chrono::seconds(10)), future_status::ready);
+   EXPECT_EQ(counter.load(), 3U);
+   EXPECT_TRUE(cache->popPendingTx(hash).empty());
+
+   //next call is a new request
+   EXPECT_TRUE(cache->addPendingTx(hash, callback));
+   EXPECT_EQ(cache->popPendingTx(hash).size(), 1U);
+
+   //same for headers
+   AsyncClient::RawHeaderCallback headerCallback = 
+      [](ReturnMessage<BinaryData>)->void {};
+   EXPECT_TRUE(cache->addPendingHeader(10, headerCallback));
+   EXPECT_FALSE(cache->addPendingHeader(10, headerCallback));
+   EXPECT_TRUE(cache->addPendingHeader(11, headerCallback));
+   EXPECT_EQ(cache->popPendingHeaders(10).size(), 2U);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
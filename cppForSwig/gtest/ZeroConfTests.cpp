@@ -658,12 +658,10 @@ protected:
    ZeroConfCallbacks_Tests zcCallbacks_;
 };
 
-//TODO: copy snapshot, force merge, check it matches original
-
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, Stage)
 {
-   MempoolSnapshot snapshot(1, 2);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    //filter the tx
@@ -681,7 +679,7 @@ TEST_F(ZeroConfTests_Mempool, Stage)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, Commit)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    //filter the tx
@@ -705,7 +703,7 @@ TEST_F(ZeroConfTests_Mempool, Commit)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, Drop)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    //filter the tx
@@ -732,7 +730,7 @@ TEST_F(ZeroConfTests_Mempool, Drop)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, CommitAndDrop)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    //filter the tx
@@ -767,7 +765,7 @@ TEST_F(ZeroConfTests_Mempool, CommitAndDrop)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, Stage2_Drop1)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    {
@@ -809,7 +807,7 @@ TEST_F(ZeroConfTests_Mempool, Stage2_Drop1)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, Stage2_Commit_Drop1)
 {
-   MempoolSnapshot snapshot(1, 2);
+   MempoolSnapshot snapshot;
    EXPECT_EQ(snapshot.getTopZcID(), 0U);
 
    {
@@ -865,10 +863,201 @@ TEST_F(ZeroConfTests_Mempool, Stage2_Commit_Drop1)
    EXPECT_EQ(snapshot.getTopZcID(), 2U);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_Mempool, CopyIsolation)
+{
+   auto snapshot = make_shared<MempoolSnapshot>();
+
+   {
+      //add tx0 & tx1
+      auto filterResult = filterParsedTx(
+         txs_[0].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[0].txPtr_, filterResult);
+
+      auto filterResult1 = filterParsedTx(
+         txs_[1].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[1].txPtr_, filterResult1);
+   }
+
+   snapshot->commitNewZCs();
+   EXPECT_EQ(snapshot->getMergeCount(), 1U);
+
+   //copy, drop tx0 from the copy
+   auto ssCopy = MempoolSnapshot::copy(snapshot);
+   auto droppedZCs = ssCopy->dropZc(zcKeys_[0]);
+   ASSERT_EQ(droppedZCs.size(), 1ULL);
+   ssCopy->commitNewZCs();
+
+   EXPECT_TRUE(checkIsDropped(*ssCopy, 0));
+   EXPECT_TRUE(checkTxIsStaged(*ssCopy, 1));
+
+   //original is untouched
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 0));
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 1));
+
+   //add tx2 to the original, copy should not see it
+   {
+      auto filterResult2 = filterParsedTx(
+         txs_[2].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[2].txPtr_, filterResult2);
+   }
+
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 2));
+   EXPECT_FALSE(ssCopy->hasHash(zcHashes_[2]));
+
+   auto stats = snapshot->getStats();
+   EXPECT_EQ(stats.txCount_, 3ULL);
+   EXPECT_GE(stats.lookupDepth_, 1U);
+
+   auto statsCopy = ssCopy->getStats();
+   EXPECT_EQ(statsCopy.txCount_, 1ULL);
+   EXPECT_EQ(statsCopy.mergeCount_, 2U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_Mempool, CopyChain)
+{
+   auto snapshot = make_shared<MempoolSnapshot>();
+
+   {
+      //add tx0 & tx1
+      auto filterResult = filterParsedTx(
+         txs_[0].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[0].txPtr_, filterResult);
+
+      auto filterResult1 = filterParsedTx(
+         txs_[1].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[1].txPtr_, filterResult1);
+   }
+
+   snapshot->commitNewZCs();
+   auto base = snapshot;
+
+   //derive 100 snapshots from one another, staging and dropping tx3 in turn
+   for (unsigned i = 0; i < 100; i++)
+   {
+      auto ssCopy = MempoolSnapshot::copy(snapshot);
+      if (i % 2 == 0)
+      {
+         auto filterResult3 = filterParsedTx(
+            txs_[3].txPtr_, mainAddrMap_, &zcCallbacks_);
+         ssCopy->stageNewZC(txs_[3].txPtr_, filterResult3);
+
+         EXPECT_TRUE(checkTxIsStaged(*ssCopy, 3));
+         EXPECT_TRUE(checkTxOutIsSpent(*ssCopy, 1, 1).startsWith(zcKeys_[3]));
+      }
+      else
+      {
+         auto droppedZCs = ssCopy->dropZc(zcKeys_[3]);
+         EXPECT_EQ(droppedZCs.size(), 1ULL);
+
+         EXPECT_FALSE(ssCopy->hasHash(zcHashes_[3]));
+         EXPECT_TRUE(checkTxOutIsSpent(*ssCopy, 1, 1).empty());
+      }
+
+      ssCopy->commitNewZCs();
+
+      //the snapshot it was derived from is untouched
+      EXPECT_EQ(snapshot->hasHash(zcHashes_[3]), i % 2 == 1);
+      snapshot = ssCopy;
+   }
+
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 0));
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 1));
+   EXPECT_FALSE(snapshot->hasHash(zcHashes_[3]));
+
+   EXPECT_TRUE(checkTxIsStaged(*base, 0));
+   EXPECT_TRUE(checkTxIsStaged(*base, 1));
+   EXPECT_FALSE(base->hasHash(zcHashes_[3]));
+   EXPECT_TRUE(checkTxOutIsSpent(*base, 1, 1).empty());
+
+   //lookups don't get deeper with the length of the copy chain. Only the
+   //commits that staged zc count as merges
+   auto stats = snapshot->getStats();
+   EXPECT_EQ(stats.mergeCount_, 51U);
+   EXPECT_LE(stats.lookupDepth_, DBTestUtils::getMempoolDepthBound(stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_Mempool, ConcurrentCopies)
+{
+   auto snapshot = make_shared<MempoolSnapshot>();
+
+   {
+      //add tx0 & tx1
+      auto filterResult = filterParsedTx(
+         txs_[0].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[0].txPtr_, filterResult);
+
+      auto filterResult1 = filterParsedTx(
+         txs_[1].txPtr_, mainAddrMap_, &zcCallbacks_);
+      snapshot->stageNewZC(txs_[1].txPtr_, filterResult1);
+   }
+
+   snapshot->commitNewZCs();
+
+   //several threads copy the same snapshot and modify their copy: even 
+   //threads add tx3, odd threads drop tx1
+   const unsigned threadCount = 8;
+   vector<FilteredZeroConfData> filterResults;
+   for (unsigned i = 0; i < threadCount; i++)
+   {
+      filterResults.emplace_back(filterParsedTx(
+         txs_[3].txPtr_, mainAddrMap_, &zcCallbacks_));
+   }
+
+   vector<shared_ptr<MempoolSnapshot>> copies(threadCount);
+   auto copyLbd = [&](unsigned id)->void
+   {
+      for (unsigned i = 0; i < 50; i++)
+      {
+         auto ssCopy = MempoolSnapshot::copy(snapshot);
+         if (id % 2 == 0)
+            ssCopy->stageNewZC(txs_[3].txPtr_, filterResults[id]);
+         else
+            ssCopy->dropZc(zcKeys_[1]);
+
+         ssCopy->commitNewZCs();
+         copies[id] = ssCopy;
+      }
+   };
+
+   vector<thread> threads;
+   for (unsigned i = 0; i < threadCount; i++)
+      threads.emplace_back(copyLbd, i);
+   for (auto& thr : threads)
+      thr.join();
+
+   //the original is untouched
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 0));
+   EXPECT_TRUE(checkTxIsStaged(*snapshot, 1));
+   EXPECT_FALSE(snapshot->hasHash(zcHashes_[3]));
+   EXPECT_TRUE(checkTxOutIsSpent(*snapshot, 1, 1).empty());
+
+   for (unsigned i = 0; i < threadCount; i++)
+   {
+      auto& ssCopy = copies[i];
+      ASSERT_NE(ssCopy, nullptr);
+      EXPECT_TRUE(checkTxIsStaged(*ssCopy, 0));
+
+      if (i % 2 == 0)
+      {
+         EXPECT_TRUE(checkTxIsStaged(*ssCopy, 1));
+         EXPECT_TRUE(checkTxIsStaged(*ssCopy, 3));
+         EXPECT_TRUE(checkTxOutIsSpent(*ssCopy, 1, 1).startsWith(zcKeys_[3]));
+      }
+      else
+      {
+         EXPECT_TRUE(checkIsDropped(*ssCopy, 1));
+         EXPECT_FALSE(ssCopy->hasHash(zcHashes_[3]));
+      }
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, StageChildren)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
 
    {
       //add tx0
@@ -949,7 +1138,7 @@ TEST_F(ZeroConfTests_Mempool, StageChildren)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, StageChildren_Commit)
 {
-   MempoolSnapshot snapshot(1, 2);
+   MempoolSnapshot snapshot;
 
    {
       //add tx0
@@ -1067,7 +1256,7 @@ TEST_F(ZeroConfTests_Mempool, StageChildren_Commit)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, DropParent)
 {
-   MempoolSnapshot snapshot(2, 4);
+   MempoolSnapshot snapshot;
 
    {
       //add tx0
@@ -1140,7 +1329,7 @@ TEST_F(ZeroConfTests_Mempool, DropParent)
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(ZeroConfTests_Mempool, DropParent_Commit)
 {
-   MempoolSnapshot snapshot(1, 2);
+   MempoolSnapshot snapshot;
 
    {
       //add tx0
@@ -1247,6 +1436,230 @@ TEST_F(ZeroConfTests_Mempool, DropParent_Commit)
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   //zc of known vsize paying satPerVByte, optionally spending zc parentId
+   BinaryData getFeeTestKey(unsigned id)
+   {
+      BinaryWriter bw;
+      bw.put_BinaryData(DBUtils::ZeroConfHeader_);
+      bw.put_uint32_t(id, BE);
+      return bw.getData();
+   }
+
+   BinaryData getFeeTestHash(unsigned id)
+   {
+      return BtcUtils::getHash256(getFeeTestKey(id));
+   }
+
+   uint64_t getFeeTestVsize(void)
+   {
+      Tx tx(TestUtils::getTx(5, 1));
+      return tx.getTxWeight();
+   }
+
+   shared_ptr<ParsedTx> makeFeeTestTx(
+      unsigned id, float satPerVByte, unsigned parentId = UINT32_MAX)
+   {
+      auto key = getFeeTestKey(id);
+      auto txPtr = make_shared<ParsedTx>(key);
+      txPtr->tx_ = Tx(TestUtils::getTx(5, 1));
+      txPtr->setTxHash(getFeeTestHash(id));
+
+      ParsedTxIn txIn;
+      txIn.value_ = 10 * COIN;
+      if (parentId != UINT32_MAX)
+         txIn.opRef_.setDbKey(getFeeTestKey(parentId));
+      txPtr->inputs_.push_back(txIn);
+
+      ParsedTxOut txOut;
+      txOut.value_ = 10 * COIN - 
+         uint64_t(satPerVByte * txPtr->tx_.getTxWeight());
+      txPtr->outputs_.push_back(txOut);
+
+      txPtr->state_ = ParsedTxStatus::Resolved;
+      return txPtr;
+   }
+
+   //estimates are in BTC/kvB
+   float toSatPerVByte(float feeByte)
+   {
+      return feeByte * 100000000.0f / 1000.0f;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class ZeroConfTests_FeeHistogram : public ::testing::Test
+{
+protected:
+   uint64_t vsize_;
+   unsigned tierSize_;
+
+   virtual void SetUp(void)
+   {
+      LOGDISABLESTDOUT();
+
+      //each tier is a bit over a block worth of vsize
+      vsize_ = getFeeTestVsize();
+      tierSize_ = FEE_HISTOGRAM_BLOCK_VSIZE / vsize_ + 1;
+      ASSERT_LT(vsize_ * 4, FEE_HISTOGRAM_BLOCK_VSIZE);
+   }
+
+   virtual void TearDown(void)
+   {
+      LOGENABLESTDOUT();
+   }
+
+   unsigned addTier(ZcFeeHistogram& hist, unsigned firstId,
+      float satPerVByte, unsigned firstParentId = UINT32_MAX)
+   {
+      for (unsigned i = 0; i < tierSize_; i++)
+      {
+         auto parentId = firstParentId;
+         if (parentId != UINT32_MAX)
+            parentId += i;
+
+         EXPECT_TRUE(hist.addTx(
+            *makeFeeTestTx(firstId + i, satPerVByte, parentId)));
+      }
+
+      return firstId + tierSize_;
+   }
+
+   //estimates land on the floor of the bucket above the rate
+   void expectRate(float feeByte, float satPerVByte)
+   {
+      auto rate = toSatPerVByte(feeByte);
+      EXPECT_GT(rate, satPerVByte);
+      EXPECT_LT(rate, satPerVByte * FEE_HISTOGRAM_SPACING * 1.001f);
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_FeeHistogram, Estimates)
+{
+   ZcFeeHistogram hist;
+   EXPECT_EQ(hist.estimateFeeByte(2, FEE_STRAT_ECONOMICAL), -1.0f);
+   EXPECT_TRUE(hist.getFeeSchedule(FEE_STRAT_ECONOMICAL).empty());
+
+   addTier(hist, 1000, 50.0f);
+   addTier(hist, 2000, 20.0f);
+   addTier(hist, 3000, 5.0f);
+   EXPECT_EQ(hist.getTxCount(), tierSize_ * 3);
+   EXPECT_EQ(hist.getTotalVsize(), tierSize_ * 3 * vsize_);
+
+   //economical: a block per target
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 50.0f);
+   expectRate(hist.estimateFeeByte(2, FEE_STRAT_ECONOMICAL), 20.0f);
+   expectRate(hist.estimateFeeByte(3, FEE_STRAT_ECONOMICAL), 5.0f);
+   EXPECT_FLOAT_EQ(toSatPerVByte(
+      hist.estimateFeeByte(4, FEE_STRAT_ECONOMICAL)), 1.0f);
+
+   //conservative: half a block per target
+   expectRate(hist.estimateFeeByte(2, FEE_STRAT_CONSERVATIVE), 50.0f);
+   expectRate(hist.estimateFeeByte(4, FEE_STRAT_CONSERVATIVE), 20.0f);
+   expectRate(hist.estimateFeeByte(6, FEE_STRAT_CONSERVATIVE), 5.0f);
+   EXPECT_FLOAT_EQ(toSatPerVByte(
+      hist.estimateFeeByte(8, FEE_STRAT_CONSERVATIVE)), 1.0f);
+
+   //schedule covers the node's targets
+   auto&& schedule = hist.getFeeSchedule(FEE_STRAT_ECONOMICAL);
+   vector<unsigned> targets = FEE_SCHEDULE_TARGETS;
+   ASSERT_EQ(schedule.size(), targets.size());
+   for (auto& target : targets)
+   {
+      auto iter = schedule.find(target);
+      ASSERT_NE(iter, schedule.end());
+      EXPECT_FLOAT_EQ(iter->second, 
+         hist.estimateFeeByte(target, FEE_STRAT_ECONOMICAL));
+   }
+   expectRate(schedule[2], 20.0f);
+   expectRate(schedule[3], 5.0f);
+   EXPECT_FLOAT_EQ(toSatPerVByte(schedule[10]), 1.0f);
+
+   //the top tier is mined
+   for (unsigned i = 0; i < tierSize_; i++)
+      hist.dropTxByHash(getFeeTestHash(1000 + i));
+   EXPECT_EQ(hist.getTxCount(), tierSize_ * 2);
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 20.0f);
+
+   //the next one is evicted
+   for (unsigned i = 0; i < tierSize_; i++)
+      hist.dropTx(getFeeTestKey(2000 + i));
+   EXPECT_EQ(hist.getTotalVsize(), tierSize_ * vsize_);
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 5.0f);
+
+   hist.clear();
+   EXPECT_EQ(hist.getTxCount(), 0U);
+   EXPECT_EQ(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), -1.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_FeeHistogram, PackageRate)
+{
+   ZcFeeHistogram hist;
+
+   //high fee children pull cheap parents, they are mined together
+   addTier(hist, 1000, 2.0f);
+   addTier(hist, 2000, 50.0f, 1000);
+   EXPECT_EQ(hist.getTxCount(), tierSize_ * 2);
+
+   //the children go at the package rate
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 26.0f);
+   expectRate(hist.estimateFeeByte(2, FEE_STRAT_ECONOMICAL), 2.0f);
+
+   //once the parents are mined, the children stand on their own
+   for (unsigned i = 0; i < tierSize_; i++)
+      hist.dropTxByHash(getFeeTestHash(1000 + i));
+   EXPECT_EQ(hist.getTxCount(), tierSize_);
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 50.0f);
+
+   //a cheap child doesn't get a lift from its parent
+   hist.clear();
+   addTier(hist, 1000, 50.0f);
+   addTier(hist, 2000, 5.0f, 1000);
+   expectRate(hist.estimateFeeByte(1, FEE_STRAT_ECONOMICAL), 50.0f);
+   expectRate(hist.estimateFeeByte(2, FEE_STRAT_ECONOMICAL), 5.0f);
+
+   //dropping a parent takes nothing else with it
+   hist.dropTx(getFeeTestKey(1000));
+   EXPECT_EQ(hist.getTxCount(), tierSize_ * 2 - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_FeeHistogram, Rejects)
+{
+   ZcFeeHistogram hist;
+
+   //unresolved input value
+   auto txPtr = makeFeeTestTx(1, 10.0f);
+   txPtr->inputs_[0].value_ = UINT64_MAX;
+   EXPECT_FALSE(hist.addTx(*txPtr));
+
+   //spends more than it has
+   txPtr = makeFeeTestTx(1, 10.0f);
+   txPtr->outputs_[0].value_ = 11 * COIN;
+   EXPECT_FALSE(hist.addTx(*txPtr));
+
+   //once per tx
+   txPtr = makeFeeTestTx(1, 10.0f);
+   EXPECT_TRUE(hist.addTx(*txPtr));
+   EXPECT_FALSE(hist.addTx(*txPtr));
+   EXPECT_EQ(hist.getTxCount(), 1U);
+   EXPECT_EQ(hist.getTotalVsize(), vsize_);
+
+   //stale entries expire
+   hist.expire(FEE_HISTOGRAM_EXPIRY_SEC);
+   EXPECT_EQ(hist.getTxCount(), 1U);
+
+   this_thread::sleep_for(chrono::milliseconds(1100));
+   hist.expire(0);
+   EXPECT_EQ(hist.getTxCount(), 0U);
+   EXPECT_EQ(hist.getTotalVsize(), 0U);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 class ZeroConfTests_FullNode : public ::testing::Test
 {
@@ -1796,7 +2209,10 @@ TEST_F(ZeroConfTests_FullNode, Load3Blocks_ZC_Plus3_TestLedgers)
    EXPECT_EQ(iface_->getStoredZcTx(zcStx4, zcKey), false);
    dbtx.reset();
 
-   EXPECT_GE(theBDMt_->bdm()->zeroConfCont()->getMergeCount(), 1U);
+   //however many snapshots were derived from one another, lookups are a 
+   //single balanced tree descent
+   auto stats = theBDMt_->bdm()->zeroConfCont()->getMempoolStats();
+   EXPECT_LE(stats.lookupDepth_, DBTestUtils::getMempoolDepthBound(stats));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1875,6 +2291,11 @@ TEST_F(ZeroConfTests_FullNode, Load3Blocks_ZCchain)
    DBTestUtils::pushNewZc(theBDMt_, zc1Vec);
    DBTestUtils::waitOnNewZcSignal(clients_, bdvID);
 
+   //the fee histogram is fed before any fee estimate is asked for
+   auto hist = theBDMt_->bdm()->zeroConfCont()->getFeeHistogram();
+   EXPECT_EQ(hist->getTxCount(), 1U);
+   EXPECT_GT(hist->estimateFeeByte(2, FEE_STRAT_ECONOMICAL), 0.0f);
+
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
    EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
@@ -1985,7 +2406,10 @@ TEST_F(ZeroConfTests_FullNode, Load3Blocks_ZCchain)
    EXPECT_EQ(le.getBlockNum(), 5U);
    EXPECT_FALSE(le.isChainedZC());
 
-   EXPECT_GE(theBDMt_->bdm()->zeroConfCont()->getMergeCount(), 1U);
+   //however many snapshots were derived from one another, lookups are a 
+   //single balanced tree descent
+   auto stats = theBDMt_->bdm()->zeroConfCont()->getMempoolStats();
+   EXPECT_LE(stats.lookupDepth_, DBTestUtils::getMempoolDepthBound(stats));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3867,6 +4291,62 @@ TEST_F(ZeroConfTests_FullNode, TwoZC_CheckLedgers)
    EXPECT_EQ(zc3_count, 1U);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ZeroConfTests_FullNode, FeeEstimates_Blend)
+{
+   auto bdm = theBDMt_->bdm();
+   auto rpcNode = dynamic_pointer_cast<NodeRPC_UnitTest>(
+      NetworkSettings::rpcNode());
+   ASSERT_NE(rpcNode, nullptr);
+
+   //no estimates on either side
+   EXPECT_THROW(bdm->getFeeByte(2, FEE_STRAT_CONSERVATIVE), CoreRPC::RpcError);
+   EXPECT_THROW(bdm->getFeeSchedule(FEE_STRAT_CONSERVATIVE), CoreRPC::RpcError);
+
+   //node only
+   rpcNode->setFeeEstimate(2, FEE_STRAT_CONSERVATIVE, 0.0002f);
+   rpcNode->setFeeEstimate(2, FEE_STRAT_ECONOMICAL, 0.0002f);
+   EXPECT_FLOAT_EQ(
+      bdm->getFeeByte(2, FEE_STRAT_CONSERVATIVE).feeByte_, 0.0002f);
+
+   auto&& nodeSchedule = bdm->getFeeSchedule(FEE_STRAT_CONSERVATIVE);
+   ASSERT_EQ(nodeSchedule.size(), 1U);
+   EXPECT_FLOAT_EQ(nodeSchedule[2].feeByte_, 0.0002f);
+
+   //a bit over a block worth of 50 sat/vB txs in the mempool
+   auto hist = bdm->zeroConfCont()->getFeeHistogram();
+   auto vsize = getFeeTestVsize();
+   for (unsigned i = 0; i <= FEE_HISTOGRAM_BLOCK_VSIZE / vsize; i++)
+      ASSERT_TRUE(hist->addTx(*makeFeeTestTx(1000 + i, 50.0f)));
+
+   //conservative takes the highest
+   auto mempoolFeeByte = hist->estimateFeeByte(2, FEE_STRAT_CONSERVATIVE);
+   EXPECT_GT(toSatPerVByte(mempoolFeeByte), 50.0f);
+   EXPECT_FLOAT_EQ(
+      bdm->getFeeByte(2, FEE_STRAT_CONSERVATIVE).feeByte_, mempoolFeeByte);
+
+   //economical takes the average, the mempool clears in 2 blocks at 1 sat/vB
+   mempoolFeeByte = hist->estimateFeeByte(2, FEE_STRAT_ECONOMICAL);
+   EXPECT_FLOAT_EQ(toSatPerVByte(mempoolFeeByte), 1.0f);
+   EXPECT_FLOAT_EQ(bdm->getFeeByte(2, FEE_STRAT_ECONOMICAL).feeByte_,
+      (mempoolFeeByte + 0.0002f) / 2.0f);
+
+   //mempool only
+   EXPECT_FLOAT_EQ(bdm->getFeeByte(3, FEE_STRAT_CONSERVATIVE).feeByte_,
+      hist->estimateFeeByte(3, FEE_STRAT_CONSERVATIVE));
+
+   //the schedule covers all targets, blended where the node has them
+   auto&& schedule = bdm->getFeeSchedule(FEE_STRAT_CONSERVATIVE);
+   vector<unsigned> targets = FEE_SCHEDULE_TARGETS;
+   ASSERT_EQ(schedule.size(), targets.size());
+   EXPECT_FLOAT_EQ(schedule[2].feeByte_, 
+      hist->estimateFeeByte(2, FEE_STRAT_CONSERVATIVE));
+   EXPECT_TRUE(schedule[2].smartFee_);
+   EXPECT_FLOAT_EQ(schedule[10].feeByte_, 
+      hist->estimateFeeByte(10, FEE_STRAT_CONSERVATIVE));
+   EXPECT_FALSE(schedule[10].smartFee_);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class ZeroConfTests_Supernode : public ::testing::Test
@@ -5147,7 +5627,10 @@ TEST_F(ZeroConfTests_Supernode, ZC_MineAfter1Block)
    EXPECT_EQ(zc1.getTxHeight(), 6U);
    EXPECT_EQ(zc2.getTxHeight(), 7U);
 
-   EXPECT_GE(theBDMt_->bdm()->zeroConfCont()->getMergeCount(), 1U);
+   //however many snapshots were derived from one another, lookups are a 
+   //single balanced tree descent
+   auto stats = theBDMt_->bdm()->zeroConfCont()->getMempoolStats();
+   EXPECT_LE(stats.lookupDepth_, DBTestUtils::getMempoolDepthBound(stats));
 }
 
 
@@ -7568,7 +8051,10 @@ TEST_F(ZeroConfTests_Supernode_WebSocket, ZcUpdate_RBFLowFee)
    WebSocketServer::waitOnShutdown();
 
    EXPECT_EQ(theBDMt_->bdm()->zeroConfCont()->getMatcherMapSize(), 0U);
-   EXPECT_GE(theBDMt_->bdm()->zeroConfCont()->getMergeCount(), 1U);
+   //however many snapshots were derived from one another, lookups are a 
+   //single balanced tree descent
+   auto stats = theBDMt_->bdm()->zeroConfCont()->getMempoolStats();
+   EXPECT_LE(stats.lookupDepth_, DBTestUtils::getMempoolDepthBound(stats));
 
    delete theBDMt_;
    theBDMt_ = nullptr;
@@ -12570,8 +13056,6 @@ GTEST_API_ int main(int argc, char **argv)
 #endif
 
    cout << "Running with following parameters:" << endl;
-   cout << "   MEMPOOL_DEPTH: " << MEMPOOL_DEPTH << endl;
-   cout << "   POOL_MERGE_THRESHOLD: " << POOL_MERGE_THRESHOLD << endl;
    cout << "   COINBASE_MATURITY: " << COINBASE_MATURITY << endl;
 
    CryptoECDSA::setupContext();
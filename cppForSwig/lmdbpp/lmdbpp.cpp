@@ -26,6 +26,109 @@ static std::string errorString(int rc)
    return mdb_strerror(rc);
 }
 
+namespace
+{
+   struct ThreadTxSlot
+   {
+      uint64_t envId_;
+      std::weak_ptr<LMDBThreadTxRegistry> registry_;
+      std::shared_ptr<LMDBThreadTxInfo> txInfo_;
+   };
+
+   struct ThreadTxSlots
+   {
+      std::vector<ThreadTxSlot> slots_;
+
+      ~ThreadTxSlots()
+      {
+         //the thread is going away, free its idle read txns and drop its 
+         //states from the envs that are still open
+         for (auto& slot : slots_)
+         {
+            auto registry = slot.registry_.lock();
+            if (registry == nullptr)
+               continue;
+
+            std::unique_lock<std::mutex> lock(registry->mu_);
+            auto idleTxn = slot.txInfo_->idleReadTxn_.exchange(nullptr);
+            if (idleTxn != nullptr)
+               mdb_txn_abort(idleTxn);
+
+            auto& txInfos = registry->txInfos_;
+            auto iter = std::find(txInfos.begin(), txInfos.end(), slot.txInfo_);
+            if (iter != txInfos.end())
+               txInfos.erase(iter);
+         }
+      }
+   };
+
+   thread_local ThreadTxSlots threadTxSlots_;
+   std::atomic<uint64_t> envIdCounter_{0};
+}
+
+unsigned LMDBThreadTxRegistry::reclaimIdleTxns()
+{
+   unsigned count = 0;
+   std::unique_lock<std::mutex> lock(mu_);
+   for (auto& txInfo : txInfos_)
+   {
+      auto idleTxn = txInfo->idleReadTxn_.exchange(nullptr);
+      if (idleTxn == nullptr)
+         continue;
+
+      mdb_txn_abort(idleTxn);
+      ++count;
+   }
+
+   return count;
+}
+
+LMDBThreadTxInfo* LMDBEnv::getThreadTxInfo()
+{
+   auto& slots = threadTxSlots_.slots_;
+   for (auto& slot : slots)
+   {
+      if (slot.envId_ == envId_)
+         return slot.txInfo_.get();
+   }
+
+   if (txRegistry_ == nullptr)
+      throw LMDBException("Cannot start transaction without db env");
+
+   //first tx for this env on this thread, prune slots of closed envs
+   slots.erase(std::remove_if(slots.begin(), slots.end(),
+      [](const ThreadTxSlot& slot)->bool
+      { return slot.registry_.expired(); }), slots.end());
+
+   ThreadTxSlot slot;
+   slot.envId_ = envId_;
+   slot.registry_ = txRegistry_;
+   slot.txInfo_ = std::make_shared<LMDBThreadTxInfo>();
+
+   {
+      std::unique_lock<std::mutex> lock(txRegistry_->mu_);
+      txRegistry_->txInfos_.push_back(slot.txInfo_);
+   }
+
+   slots.push_back(slot);
+   return slots.back().txInfo_.get();
+}
+
+LMDBThreadTxInfo* LMDBEnv::getOpenThreadTxInfo()
+{
+   for (auto& slot : threadTxSlots_.slots_)
+   {
+      if (slot.envId_ != envId_)
+         continue;
+
+      if (slot.txInfo_->transactionLevel_ == 0)
+         return nullptr;
+      return slot.txInfo_.get();
+   }
+
+   return nullptr;
+}
+
 inline void LMDB::Iterator::checkHasDb() const
 {
    if (!db_)
@@ -64,20 +167,11 @@ inline void LMDB::Iterator::checkOk() const
 
 void LMDB::Iterator::openCursor()
 {
-   auto tID = std::this_thread::get_id();
-   LMDBEnv *const _env = db_->env;
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   
-   auto txnIter = _env->txForThreads_.find(tID);
-   if (txnIter == _env->txForThreads_.end())
+   auto txInfo = db_->env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw std::runtime_error("Iterator must be created within Transaction");
    
-   lock.unlock();
-   
-   if (txnIter->second.transactionLevel_ == 0)
-      throw std::runtime_error("Iterator must be created within Transaction");
-   
-   txnPtr_ = &txnIter->second;
+   txnPtr_ = txInfo;
   
    int rc = mdb_cursor_open(txnPtr_->txn_, db_->dbi, &csr_);
    if (rc != MDB_SUCCESS)
@@ -359,8 +453,6 @@ void LMDBEnv::open(const char *filename, unsigned flags)
    if (isOpen())
       throw std::logic_error("Database environment already open (close it first)");
 
-   txForThreads_.clear();
-   
    int rc;
 
    rc = mdb_env_create(&dbenv);
@@ -382,12 +474,21 @@ void LMDBEnv::open(const char *filename, unsigned flags)
    }
 
    filename_ = std::string(filename);
+   envId_ = ++envIdCounter_;
+   txRegistry_ = std::make_shared<LMDBThreadTxRegistry>();
 }
 
 void LMDBEnv::close()
 {
    if (dbenv)
    {
+      //idle read txns have to go before the env
+      if (txRegistry_ != nullptr)
+      {
+         txRegistry_->reclaimIdleTxns();
+         txRegistry_.reset();
+      }
+
       mdb_env_close(dbenv);
       dbenv = nullptr;
    }
@@ -419,6 +520,17 @@ void LMDBEnv::compactCopy(const std::string& fname)
    }
 }
 
+size_t LMDBEnv::getUsedSize() const
+{
+   MDB_envinfo info;
+   MDB_stat stat;
+
+   if (mdb_env_info(dbenv, &info) != MDB_SUCCESS ||
+      mdb_env_stat(dbenv, &stat) != MDB_SUCCESS)
+      throw LMDBException("failed to get env info");
+
+   return (info.me_last_pgno + 1) * stat.ms_psize;
+}
 
 LMDBEnv::Transaction::Transaction(LMDBEnv *_env, LMDB::Mode mode)
    : env(_env), mode_(mode)
@@ -472,21 +584,23 @@ void LMDBEnv::Transaction::begin()
    
    began = true;
 
-   auto tID = std::this_thread::get_id();
-   
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   LMDBThreadTxInfo& thTx = env->txForThreads_[tID];
-   lock.unlock();
+   if (!env->dbenv)
+   {
+      began = false;
+      throw LMDBException("Cannot start transaction without db env");
+   }
+
+   LMDBThreadTxInfo& thTx = *env->getThreadTxInfo();
    
    if (thTx.transactionLevel_ != 0 && mode_ == LMDB::ReadWrite && thTx.mode_ == LMDB::ReadOnly)
+   {
+      began = false;
       throw LMDBException("Cannot access ReadOnly Transaction in ReadWrite mode");
+   }
    
    if (thTx.transactionLevel_++ != 0)
       return;
       
-   if (!env->dbenv)
-      throw LMDBException("Cannot start transaction without db env");
-      
    int modef = MDB_RDONLY;
    thTx.mode_ = LMDB::ReadOnly;
    
@@ -495,13 +609,33 @@ void LMDBEnv::Transaction::begin()
       modef = 0;
       thTx.mode_ = LMDB::ReadWrite;
    }
+   else
+   {
+      //recycle the txn parked by the last read on this thread
+      auto idleTxn = thTx.idleReadTxn_.exchange(nullptr);
+      if (idleTxn != nullptr)
+      {
+         if (mdb_txn_renew(idleTxn) == MDB_SUCCESS)
+         {
+            thTx.txn_ = idleTxn;
+            return;
+         }
+
+         mdb_txn_abort(idleTxn);
+      }
+   }
 
    int rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx.txn_);
+   if (rc == MDB_READERS_FULL && env->txRegistry_->reclaimIdleTxns() > 0)
+   {
+      //reader slots are held by other threads' idle txns, free them
+      rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx.txn_);
+   }
+
    if (rc != MDB_SUCCESS)
    {
-      lock.lock();
-      env->txForThreads_.erase(tID);
-      lock.unlock();
+      thTx.txn_ = nullptr;
+      thTx.transactionLevel_ = 0;
       
       began = false;
       throw LMDBException("Failed to create transaction (" + errorString(rc) +")");
@@ -520,6 +654,16 @@ void LMDBEnv::Transaction::open(LMDBEnv *_env, LMDB::Mode mode)
 }
 
 void LMDBEnv::Transaction::commit()
+{
+   end(false);
+}
+
+void LMDBEnv::Transaction::rollback()
+{
+   end(true);
+}
+
+void LMDBEnv::Transaction::end(bool abort)
 {
    if (!began)
       return;
@@ -527,39 +671,61 @@ void LMDBEnv::Transaction::commit()
    began=false;
 
    //look for an existing transaction in this thread
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw LMDBException("Transaction bound to unknown thread");
-   lock.unlock();
 
-   LMDBThreadTxInfo& thTx = txnIter->second;
+   LMDBThreadTxInfo& thTx = *txInfo;
 
    if (thTx.transactionLevel_-- == 1)
    {
-      int rc = mdb_txn_commit(thTx.txn_);
+      auto txn = thTx.txn_;
+      thTx.txn_ = nullptr;
+
+      if (thTx.mode_ == LMDB::ReadOnly)
+      {
+         //read cursors outlive their txn, close them before parking it
+         for (LMDB::Iterator *i : thTx.iterators_)
+         {
+            if (i->csr_ != nullptr)
+               mdb_cursor_close(i->csr_);
+            i->hasTx=false;
+            i->csr_=nullptr;
+         }
+         thTx.iterators_.clear();
+
+         mdb_txn_reset(txn);
+         auto prevTxn = thTx.idleReadTxn_.exchange(txn);
+         if (prevTxn != nullptr)
+            mdb_txn_abort(prevTxn);
+         return;
+      }
+
+      //write cursors are freed along with their txn
+      int rc = MDB_SUCCESS;
+      if (abort || thTx.aborted_)
+         mdb_txn_abort(txn);
+      else
+         rc = mdb_txn_commit(txn);
+      thTx.aborted_ = false;
       
       for (LMDB::Iterator *i : thTx.iterators_)
       {
          i->hasTx=false;
          i->csr_=nullptr;
       }
+      thTx.iterators_.clear();
       
       if (rc != MDB_SUCCESS)
       {
          throw LMDBException("Failed to close env tx (" + errorString(rc) +")");
       }
-      
-      lock.lock();
-      env->txForThreads_.erase(txnIter);
    }
-}
-
-void LMDBEnv::Transaction::rollback()
-{
-   throw std::runtime_error("unimplemented");
+   else if (abort && thTx.mode_ == LMDB::ReadWrite)
+   {
+      //nested, the outermost tx aborts the txn
+      thTx.aborted_ = true;
+   }
 }
 
 LMDB::~LMDB()
@@ -579,10 +745,14 @@ void LMDB::close()
 {
    if (dbi != 0)
    {
+      if (env->txRegistry_ != nullptr)
       {
-         std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-         if (!env->txForThreads_.empty())
-            throw std::runtime_error("Tried to close database with open txes");
+         std::unique_lock<std::mutex> lock(env->txRegistry_->mu_);
+         for (auto& txInfo : env->txRegistry_->txInfos_)
+         {
+            if (txInfo->transactionLevel_ != 0)
+               throw std::runtime_error("Tried to close database with open txes");
+         }
       }
       mdb_dbi_close(env->dbenv, dbi);
       dbi=0;
@@ -605,15 +775,11 @@ void LMDB::open(LMDBEnv *_env, const std::string &name)
    this->env = _env;
    
    LMDBEnv::Transaction tx(_env);
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   auto txnIter = _env->txForThreads_.find(tID);
-
-   if (txnIter == _env->txForThreads_.end())
+   auto txInfo = _env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
-   int rc = mdb_open(txnIter->second.txn_, name.c_str(), MDB_CREATE, &dbi);
+   int rc = mdb_open(txInfo->txn_, name.c_str(), MDB_CREATE, &dbi);
    if (rc != MDB_SUCCESS)
    {
       // cleanup here
@@ -629,17 +795,11 @@ void LMDB::insert(
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mval = { value.len, const_cast<char*>(value.data) };
 
-   auto tID = std::this_thread::get_id();
-
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
 
-   int rc = mdb_put(txnIter->second.txn_, dbi, &mkey, &mval, 0);
+   int rc = mdb_put(txInfo->txn_, dbi, &mkey, &mval, 0);
    if (rc == MDB_SUCCESS)
       return;
 
@@ -648,18 +808,111 @@ void LMDB::insert(
    throw LMDBException("Failed to insert (" + errorString(rc) + ")");
 }
 
-void LMDB::erase(const CharacterArrayRef& key)
+void LMDB::append(
+   const CharacterArrayRef& key,
+   const CharacterArrayRef& value
+)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
+   MDB_val mkey = { key.len, const_cast<char*>(key.data) };
+   MDB_val mval = { value.len, const_cast<char*>(value.data) };
+
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
+      throw LMDBException("Failed to append: need transaction");
+
+   int rc = mdb_put(txInfo->txn_, dbi, &mkey, &mval, MDB_APPEND);
+   if (rc == MDB_SUCCESS)
+      return;
 
-   if (txnIter == env->txForThreads_.end())
+   //MDB_KEYEXIST: key does not sort after the last key in the db
+   throw LMDBException("Failed to append (" + errorString(rc) + ")");
+}
+
+void LMDB::BulkLoader::add(
+   const CharacterArrayRef& key,
+   const CharacterArrayRef& value
+)
+{
+   MDB_val mkey = { key.len, const_cast<char*>(key.data) };
+   MDB_val mval = { value.len, const_cast<char*>(value.data) };
+   entries_.push_back(std::make_pair(mkey, mval));
+}
+
+LMDB::BulkLoader::Stats LMDB::BulkLoader::commit()
+{
+   Stats stats;
+   if (entries_.empty())
+      return stats;
+
+   auto txInfo = db_->env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
+      throw LMDBException("Failed to bulk insert: need transaction");
+
+   auto txn = txInfo->txn_;
+   auto dbi = db_->dbi;
+
+   //stable so that the last write to a key stays last
+   std::stable_sort(entries_.begin(), entries_.end(),
+      [txn, dbi](const std::pair<MDB_val, MDB_val>& lhs,
+         const std::pair<MDB_val, MDB_val>& rhs)->bool
+   {
+      return mdb_cmp(txn, dbi, &lhs.first, &rhs.first) < 0;
+   });
+
+   MDB_cursor* csr;
+   int rc = mdb_cursor_open(txn, dbi, &csr);
+   if (rc != MDB_SUCCESS)
+      throw LMDBException("Failed to open cursor (" + errorString(rc) + ")");
+
+   //copy the last key, cursor puts may move the page it lives on
+   std::string lastKey;
+   MDB_val lastKeyVal, lastDataVal;
+   bool appending = true;
+   if (mdb_cursor_get(csr, &lastKeyVal, &lastDataVal, MDB_LAST) == MDB_SUCCESS)
+   {
+      lastKey.assign((char*)lastKeyVal.mv_data, lastKeyVal.mv_size);
+      appending = false;
+   }
+   MDB_val lastKeyCopy = { lastKey.size(), &lastKey[0] };
+
+   for (size_t i = 0; i < entries_.size(); i++)
+   {
+      auto& entry = entries_[i];
+      if (i + 1 < entries_.size() &&
+         mdb_cmp(txn, dbi, &entry.first, &entries_[i + 1].first) == 0)
+         continue;
+
+      if (!appending && mdb_cmp(txn, dbi, &entry.first, &lastKeyCopy) > 0)
+         appending = true;
+
+      rc = mdb_cursor_put(
+         csr, &entry.first, &entry.second, appending ? MDB_APPEND : 0);
+      if (rc != MDB_SUCCESS)
+      {
+         mdb_cursor_close(csr);
+         entries_.clear();
+         throw LMDBException("Failed to bulk insert (" + errorString(rc) + ")");
+      }
+
+      if (appending)
+         ++stats.appended_;
+      else
+         ++stats.inserted_;
+   }
+
+   mdb_cursor_close(csr);
+   entries_.clear();
+   return stats;
+}
+
+void LMDB::erase(const CharacterArrayRef& key)
+{
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
-   int rc = mdb_del(txnIter->second.txn_, dbi, &mkey, 0);
+   int rc = mdb_del(txInfo->txn_, dbi, &mkey, 0);
    if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
    {
       std::cout << "failed to erase data, returned following error string: " << errorString(rc) << std::endl;
@@ -669,13 +922,9 @@ void LMDB::erase(const CharacterArrayRef& key)
 
 void LMDB::wipe(const CharacterArrayRef& key)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
 
    try
    {
@@ -690,7 +939,7 @@ void LMDB::wipe(const CharacterArrayRef& key)
    }   
 
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
-   int rc = mdb_del(txnIter->second.txn_, dbi, &mkey, 0); // , MDB_WIPE_DATA);
+   int rc = mdb_del(txInfo->txn_, dbi, &mkey, 0); // , MDB_WIPE_DATA);
    if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
    {
       std::cout << "failed to erase data, returned following error string: " << errorString(rc) << std::endl;
@@ -712,23 +961,14 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 {
    //simple get without the use of iterators
 
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw std::runtime_error("Need transaction to get data");
-   
-   /*
-   TODO: this is slow, set get routines within the tx directly to avoid 
-   locking the txmap
-   */
-   lock.unlock(); 
 
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mdata = { 0, 0 };
 
-   int rc = mdb_get(txnIter->second.txn_, dbi, &mkey, &mdata);
+   int rc = mdb_get(txInfo->txn_, dbi, &mkey, &mdata);
    if (rc == MDB_NOTFOUND)
       return CharacterArrayRef(0, (char*)nullptr);
    
@@ -741,16 +981,11 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 
 void LMDB::drop(void)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto txInfo = env->getOpenThreadTxInfo();
+   if (txInfo == nullptr)
       throw std::runtime_error("Need transaction to get data");
 
-   lock.unlock();
-
-   if (mdb_drop(txnIter->second.txn_, dbi, 0) != MDB_SUCCESS)
+   if (mdb_drop(txInfo->txn_, dbi, 0) != MDB_SUCCESS)
       throw std::runtime_error("Failed to drop DB!");
 }
 
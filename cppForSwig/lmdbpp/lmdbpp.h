@@ -14,6 +14,8 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include "lmdb.h"
 
 struct MDB_env;
@@ -172,6 +174,32 @@ public:
       const MDB_val& value() const { return val_; }
    };
    
+   // Batches writes to this db within the current thread's write
+   // transaction. On commit the batch is sorted with the db's key
+   // comparator. Entries sorting before the last key in the db go in
+   // with regular cursor puts, everything past it is appended
+   // (MDB_APPEND), which fills pages sequentially instead of splitting
+   // them. Keys and values are not copied, they have to outlive commit().
+   // The last entry added for a given key wins.
+   class BulkLoader
+   {
+      LMDB *db_=nullptr;
+      std::vector<std::pair<MDB_val, MDB_val>> entries_;
+
+   public:
+      struct Stats
+      {
+         size_t appended_ = 0;
+         size_t inserted_ = 0;
+      };
+
+      BulkLoader(LMDB *db) : db_(db) { }
+
+      void add(const CharacterArrayRef& key, const CharacterArrayRef& value);
+      size_t size() const { return entries_.size(); }
+      Stats commit();
+   };
+
    LMDB() { }
    LMDB(LMDBEnv *_env, const std::string &name=std::string())
    {
@@ -194,6 +222,14 @@ public:
       const CharacterArrayRef& value
    );
    
+   // append a value at the end of the database. The key has to sort
+   // after every key already in there, this skips the btree search and
+   // fills pages sequentially
+   void append(
+      const CharacterArrayRef& key,
+      const CharacterArrayRef& value
+   );
+   
    // delete the entry with the given key, doing nothing
    // if such a key does not exist
    void erase(const CharacterArrayRef& key);
@@ -237,6 +273,9 @@ public:
    // become a valid entry
    Iterator cursor() const
       { return end(); }
+
+   BulkLoader bulkLoader()
+      { return BulkLoader(this); }
 private:
 
    LMDB(const LMDB &nocopy);
@@ -247,9 +286,29 @@ struct LMDBThreadTxInfo
 {
    MDB_txn *txn_=nullptr;
 
+   //read-only txn parked with mdb_txn_reset, the next read-only begin on 
+   //this thread renews it instead of creating a new one. Only the owning 
+   //thread stores to it, other threads may only exchange it out to abort it
+   std::atomic<MDB_txn*> idleReadTxn_{nullptr};
+
    std::vector<LMDB::Iterator*> iterators_;
-   unsigned transactionLevel_=0;
+   std::atomic<unsigned> transactionLevel_{0};
    LMDB::Mode mode_;
+
+   //set by a rollback on a nested ReadWrite tx, the outermost tx aborts
+   //instead of committing
+   bool aborted_ = false;
+};
+
+//per env list of the thread tx states, lets the env reclaim idle read txns 
+//and check for open txes without going through each thread's local storage
+struct LMDBThreadTxRegistry
+{
+   std::mutex mu_;
+   std::vector<std::shared_ptr<LMDBThreadTxInfo>> txInfos_;
+
+   //aborts all idle read txns, returns how many were freed
+   unsigned reclaimIdleTxns(void);
 };
 
 
@@ -263,11 +322,20 @@ private:
    unsigned dbCount_ = 1;
 
    std::string filename_;
-   std::mutex threadTxMutex_;
-   std::unordered_map<std::thread::id, LMDBThreadTxInfo> txForThreads_;
+
+   //tx states live in thread local storage, keyed by this id. It is unique
+   //per open() so slots left over from a closed env are never matched
+   uint64_t envId_ = 0;
+   std::shared_ptr<LMDBThreadTxRegistry> txRegistry_;
    
    friend class LMDB;
 
+   //this thread's tx state for the env, created on first use
+   LMDBThreadTxInfo* getThreadTxInfo(void);
+   
+   //this thread's tx state if it has a transaction open, nullptr otherwise
+   LMDBThreadTxInfo* getOpenThreadTxInfo(void);
+
 public:
    class Transaction
    {
@@ -298,13 +366,18 @@ public:
       void commit();
       // rollback the transaction, if it exists, doing nothing otherwise.
       // All modifications made since this transaction began are removed.
-      // After this function completes, no transaction exists
+      // After this function completes, no transaction exists. Nested 
+      // transactions share the thread's txn, rolling back a nested one 
+      // aborts the whole txn when the outermost transaction ends
       void rollback();
       // start a new transaction. If one already exists, do nothing
       void begin();
 
    private:
       Transaction(const Transaction&); // no copies
+
+      // shared by commit and rollback
+      void end(bool abort);
    };
 
    LMDBEnv() { }
@@ -324,6 +397,9 @@ public:
    const std::string& getFilename(void) const { return filename_; }
    void setMapSize(size_t);
    void compactCopy(const std::string& fname);
+
+   // bytes of the map actually in use
+   size_t getUsedSize(void) const;
    
 private:
    LMDBEnv(const LMDBEnv&); // disallow copy
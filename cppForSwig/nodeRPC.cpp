@@ -59,7 +59,8 @@ map<unsigned, FeeEstimateResult> NodeRPCInterface::getFeeSchedule(
 // NodeRPC
 //
 ////////////////////////////////////////////////////////////////////////////////
-NodeRPC::NodeRPC()
+NodeRPC::NodeRPC() :
+   socketPool_([this](void)->unique_ptr<HttpSocket>{ return openSocket(); })
 {
    //start fee estimate polling thread
    auto pollLbd = [this](void)->void
@@ -104,6 +105,19 @@ void NodeRPC::resetAuthString()
 {
    ReentrantLock lock(this);
    basicAuthString64_.clear();
+
+   //pooled sockets carry the old auth header
+   socketPool_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unique_ptr<HttpSocket> NodeRPC::openSocket()
+{
+   auto sock = make_unique<HttpSocket>("127.0.0.1", NetworkSettings::rpcPort());
+   if (!setupConnection(*sock))
+      throw RpcError("node_down");
+
+   return sock;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -244,7 +258,7 @@ string NodeRPC::getAuthString()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-float NodeRPC::queryFeeByte(HttpSocket& sock, unsigned blocksToConfirm)
+float NodeRPC::queryFeeByte(unsigned blocksToConfirm)
 {
    ReentrantLock lock(this);
 
@@ -256,7 +270,7 @@ float NodeRPC::queryFeeByte(HttpSocket& sock, unsigned blocksToConfirm)
 
    json_obj.add_pair("params", json_array);
 
-   auto&& response = queryRPC(sock, json_obj);
+   auto&& response = queryRPC(json_obj);
    auto&& response_obj = JSON_decode(response);
 
    if (!response_obj.isResponseValid(json_obj.id_))
@@ -272,41 +286,31 @@ float NodeRPC::queryFeeByte(HttpSocket& sock, unsigned blocksToConfirm)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-FeeEstimateResult NodeRPC::queryFeeByteSmart(HttpSocket& sock,
-   unsigned& confTarget, string& strategy)
+shared_ptr<JSON_object> NodeRPC::getFeeByteSmartRequest(
+   unsigned confTarget, const string& strategy)
 {
-   auto fallback = [this, &confTarget, &sock](void)->FeeEstimateResult
-   {
-      FeeEstimateResult fer;
-      fer.smartFee_ = false;
-      auto feeByteSimple = queryFeeByte(sock, confTarget);
-      if (feeByteSimple == -1.0f)
-         fer.error_ = "error";
-      else
-         fer.feeByte_ = feeByteSimple;
-
-      return fer;
-   };
-
-   FeeEstimateResult fer;
-
-   ReentrantLock lock(this);
-
-   JSON_object json_obj;
-   json_obj.add_pair("method", "estimatesmartfee");
+   auto json_obj = make_shared<JSON_object>();
+   json_obj->add_pair("method", "estimatesmartfee");
 
    auto json_array = make_shared<JSON_array>();
    json_array->add_value(confTarget);
-   if(strategy == FEE_STRAT_CONSERVATIVE || strategy == FEE_STRAT_ECONOMICAL)
-      json_array->add_value(strategy);
-
-   json_obj.add_pair("params", json_array);
+   if (strategy == FEE_STRAT_CONSERVATIVE || strategy == FEE_STRAT_ECONOMICAL)
+   {
+      string strat(strategy);
+      json_array->add_value(strat);
+   }
 
-   auto&& response = queryRPC(sock, json_obj);
-   auto&& response_obj = JSON_decode(response);
+   json_obj->add_pair("params", json_array);
+   return json_obj;
+}
 
-   if (!response_obj.isResponseValid(json_obj.id_))
-      return fallback();
+////////////////////////////////////////////////////////////////////////////////
+bool NodeRPC::processFeeByteSmart(JSON_object& response_obj, int id,
+   unsigned& confTarget, FeeEstimateResult& fer)
+{
+   //returns false if the caller should fall back to estimatefee
+   if (!response_obj.isResponseValid(id))
+      return false;
 
    auto resultPairObj = response_obj.getValForKey("result");
    auto resultPairPtr = dynamic_pointer_cast<JSON_object>(resultPairObj);
@@ -337,7 +341,7 @@ FeeEstimateResult NodeRPC::queryFeeByteSmart(HttpSocket& sock,
       if (resultPairPtr == nullptr)
       {
          //fallback to the estimatefee if the method is missing
-         return fallback();
+         return false;
       }
       else
       {
@@ -347,7 +351,7 @@ FeeEstimateResult NodeRPC::queryFeeByteSmart(HttpSocket& sock,
       }
    }
 
-   return fer;
+   return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -377,15 +381,22 @@ FeeEstimateResult NodeRPC::getFeeByte(
 void NodeRPC::aggregateFeeEstimates()
 {
    //get fee/byte for 2-3-4-5-6-10-20 confs on both strategies
-   static vector<unsigned> confTargets = { 2, 3, 4, 5, 6, 10, 20 };
-   static vector<string> strategies = { 
+   static const vector<unsigned> confTargets = FEE_SCHEDULE_TARGETS;
+   static const vector<string> strategies = { 
       FEE_STRAT_CONSERVATIVE, FEE_STRAT_ECONOMICAL };
 
-   HttpSocket sock("127.0.0.1", NetworkSettings::rpcPort());
-   if (!setupConnection(sock))
-      throw RpcError("aggregateFeeEstimates: failed to setup RPC socket");
+   //all estimates go out in a single batch
+   vector<shared_ptr<JSON_object>> requests;
+   for (auto& strat : strategies)
+   {
+      for (auto& target : confTargets)
+         requests.push_back(getFeeByteSmartRequest(target, strat));
+   }
+
+   auto&& replies = queryBatchRPC(requests);
 
    auto newCache = make_shared<EstimateCache>();
+   auto requestIter = requests.begin();
 
    for (auto& strat : strategies)
    {
@@ -393,17 +404,26 @@ void NodeRPC::aggregateFeeEstimates()
          make_pair(strat, map<unsigned, FeeEstimateResult>()));
       auto& newMap = insertIter.first->second;
 
-      for (auto& target : confTargets)
+      for (auto target : confTargets)
       {
-         try
-         {
-            auto&& result = queryFeeByteSmart(sock, target, strat);
-            newMap.insert(make_pair(target, move(result)));
-         }
-         catch (ConfMismatch&)
+         auto& request = *requestIter++;
+
+         FeeEstimateResult fer;
+         auto replyIter = replies.find(request->id_);
+         if (replyIter == replies.end() || 
+            !processFeeByteSmart(
+               *replyIter->second, request->id_, target, fer))
          {
-            break;
+            //no smart fee from this node, fallback to estimatefee
+            fer = FeeEstimateResult();
+            auto feeByteSimple = queryFeeByte(target);
+            if (feeByteSimple == -1.0f)
+               fer.error_ = "error";
+            else
+               fer.feeByte_ = feeByteSimple;
          }
+
+         newMap.insert(make_pair(target, move(fer)));
       }
    }
 
@@ -607,21 +627,60 @@ void NodeRPC::shutdown()
    LOGINFO << responseStr->val_;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+string NodeRPC::queryRPC(const string& request)
+{
+   while (true)
+   {
+      bool reused = false;
+      auto sock = socketPool_.get(reused);
+
+      try
+      {
+         auto&& response = queryRPC(*sock, request);
+         socketPool_.put(move(sock));
+         return response;
+      }
+      catch (SocketTimeout&)
+      {
+         //the node stalled, the socket is dropped rather than pooled. 
+         //Don't wait on it again with a fresh one.
+         throw;
+      }
+      catch (SocketError&)
+      {
+         //the node may have dropped a pooled connection since we last used 
+         //it, try again. A fresh socket failing is a real error.
+         if (!reused)
+            throw;
+      }
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 string NodeRPC::queryRPC(JSON_object& request)
 {
-   HttpSocket sock("127.0.0.1", NetworkSettings::rpcPort());
-   if (!setupConnection(sock))
-      throw RpcError("node_down");
+   return queryRPC(JSON_encode(request));
+}
 
-   return queryRPC(sock, request);
+////////////////////////////////////////////////////////////////////////////////
+map<int, shared_ptr<JSON_object>> NodeRPC::queryBatchRPC(
+   vector<shared_ptr<JSON_object>>& requests)
+{
+   return JSON_decodeBatch(queryRPC(JSON_encode(requests)));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 string NodeRPC::queryRPC(HttpSocket& sock, JSON_object& request)
+{
+   return queryRPC(sock, JSON_encode(request));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+string NodeRPC::queryRPC(HttpSocket& sock, const string& request)
 {
    auto write_payload = make_unique<WritePayload_StringPassthrough>();
-   write_payload->data_ = move(JSON_encode(request));
+   write_payload->data_ = request;
 
    auto promPtr = make_shared<promise<string>>();
    auto fut = promPtr->get_future();
@@ -631,7 +690,7 @@ string NodeRPC::queryRPC(HttpSocket& sock, JSON_object& request)
       promPtr->set_value(move(body));
    };
 
-   auto read_payload = make_shared<Socket_ReadPayload>(request.id_);
+   auto read_payload = make_shared<Socket_ReadPayload>();
    read_payload->callbackReturn_ = 
       make_unique<CallbackReturn_HttpBody>(callback);
    sock.pushPayload(move(write_payload), read_payload);
@@ -715,6 +774,60 @@ NodeRPC::~NodeRPC()
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// RpcSocketPool
+//
+////////////////////////////////////////////////////////////////////////////////
+unique_ptr<HttpSocket> RpcSocketPool::get(bool& reused)
+{
+   {
+      unique_lock<mutex> lock(mu_);
+      while (!sockets_.empty())
+      {
+         //most recently used first, it is the least likely to have timed out
+         auto sock = move(sockets_.back());
+         sockets_.pop_back();
+
+         if (sock->isAlive())
+         {
+            reused = true;
+            return sock;
+         }
+      }
+   }
+
+   reused = false;
+   return openLbd_();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RpcSocketPool::put(unique_ptr<HttpSocket> sock)
+{
+   if (sock == nullptr || !sock->isAlive())
+      return;
+
+   unique_lock<mutex> lock(mu_);
+   if (sockets_.size() >= RPC_SOCKET_POOL_SIZE)
+      return;
+
+   sockets_.push_back(move(sock));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RpcSocketPool::clear()
+{
+   unique_lock<mutex> lock(mu_);
+   sockets_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t RpcSocketPool::size()
+{
+   unique_lock<mutex> lock(mu_);
+   return sockets_.size();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // NodeChainStatus
@@ -11,6 +11,7 @@
 
 #include <mutex>
 #include <memory>
+#include <deque>
 #include <string>
 #include <functional>
 
@@ -23,6 +24,8 @@
 #include "ReentrantLock.h"
 #include "ArmoryConfig.h"
 
+#define RPC_SOCKET_POOL_SIZE 4
+
 namespace CoreRPC
 {
    /***
@@ -173,6 +176,31 @@ public:
       const std::string& strategy); 
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class RpcSocketPool
+{
+   /***
+   Idle keep-alive connections to the node, most recently used last. Sockets
+   the node closed in the meantime are dropped on checkout. openLbd_ creates
+   and sets up a new connection, it throws if the node can't be reached.
+   ***/
+
+private:
+   std::mutex mu_;
+   std::deque<std::unique_ptr<HttpSocket>> sockets_;
+   const std::function<std::unique_ptr<HttpSocket>(void)> openLbd_;
+
+public:
+   RpcSocketPool(std::function<std::unique_ptr<HttpSocket>(void)> lbd) :
+      openLbd_(lbd)
+   {}
+
+   std::unique_ptr<HttpSocket> get(bool& reused);
+   void put(std::unique_ptr<HttpSocket>);
+   void clear(void);
+   size_t size(void);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 class NodeRPC : public NodeRPCInterface
 {
@@ -186,17 +214,28 @@ private:
    std::vector<std::thread> thrVec_;
    std::atomic<bool> run_ = { true };
 
+   //idle keep-alive connections to the node
+   RpcSocketPool socketPool_;
+
 private:
    std::string getAuthString(void);
    std::string getDatadir(void);
 
+   std::unique_ptr<HttpSocket> openSocket(void);
+
+   std::string queryRPC(const std::string&);
    std::string queryRPC(JSON_object&);
+   std::string queryRPC(HttpSocket&, const std::string&);
    std::string queryRPC(HttpSocket&, JSON_object&);
+   std::map<int, std::shared_ptr<JSON_object>> queryBatchRPC(
+      std::vector<std::shared_ptr<JSON_object>>&);
    void pollThread(void);
    
-   float queryFeeByte(HttpSocket&, unsigned);
-   FeeEstimateResult queryFeeByteSmart(HttpSocket&,
-      unsigned& confTarget, std::string& strategy);
+   float queryFeeByte(unsigned);
+   static std::shared_ptr<JSON_object> getFeeByteSmartRequest(
+      unsigned confTarget, const std::string& strategy);
+   static bool processFeeByteSmart(JSON_object&, int id,
+      unsigned& confTarget, FeeEstimateResult&);
    void aggregateFeeEstimates(void);
    void resetAuthString(void);
    bool updateChainStatus(void);